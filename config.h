@@ -26,10 +26,33 @@
 // Stepper Motor
 #define CONFIG_STEPPER_STEP_PIN     29      // GPIO pin for step signal
 
+// TMC2209 UART (TX and RX joined through 1k to PDN_UART)
+#define CONFIG_TMC2209_UART         uart0
+#define CONFIG_TMC2209_TX_PIN       0
+#define CONFIG_TMC2209_RX_PIN       1
+#define CONFIG_TMC2209_ADDRESS      0       // MS1/MS2 strapping address
+
+// Hall-effect flow sensor on the pump outlet (closed-loop dosing)
+#define CONFIG_FLOW_METER_ENABLED   0       // Set to 1 when a sensor is fitted
+#define CONFIG_FLOW_METER_PIN       5
+#define CONFIG_FLOW_METER_PULSES_PER_LITRE 5880  // YF-S401 class sensor; calibrate against a measuring jug
+
+// ADC inputs, sampled continuously by the ADC service (channel n = GPIO 26+n)
+#define CONFIG_ADC_BATTERY_CHANNEL  1       // GPIO 27, battery through a 1/3 divider
+#define CONFIG_ADC_SOIL_CHANNEL_MASK 0x04   // Soil-moisture probes: GPIO 28 (GPIO 26 is BAT_EN, 29 the step pin)
+#define CONFIG_ADC_RATE_HZ          1000    // Samples per second per channel
+
+// QMI8658 IMU (reservoir tilt, knocks), drained from its FIFO in batches
+#define CONFIG_IMU_INT_PIN          -1      // GPIO wired to the IMU's INT1, -1 = poll the FIFO status
+
 // MCP23017 I/O Expander
 #define CONFIG_MCP23017_ADDRESS     0x27    // I2C address
 #define CONFIG_MCP23017_ENABLE_PIN  0       // Pin A0 for stepper enable
 #define CONFIG_MCP23017_STATUS_PIN  1       // Pin A1 for status LED
+#define CONFIG_VALVE_FIRST_PIN      0       // Zone valves on B0 upwards (zone n = Bn)
+#define CONFIG_VALVE_ZONE_COUNT     4       // Number of zone valves
+#define CONFIG_VALVE_MANIFOLD_FIRST_ADDRESS 0x20  // Further expanders with 16 valves each (zones 4-19, 20-35, ...)
+#define CONFIG_VALVE_MANIFOLD_COUNT 0       // Manifold expanders fitted (0-7, not overlapping the address above)
 
 // ============================================================================
 // Stepper Motor Configuration
@@ -48,6 +71,8 @@
 #define CONFIG_STEPPER_MICROSTEPS       8       // 1/8 microstepping
 #define CONFIG_STEPPER_FULL_STEPS_REV   200     // Full steps per revolution
 #define CONFIG_STEPPER_STEPS_PER_REV    (CONFIG_STEPPER_FULL_STEPS_REV * CONFIG_STEPPER_MICROSTEPS)
+#define CONFIG_STEPPER_CRUISE_MICROSTEPS 4      // Coarser resolution above the fine frequency range (TMC2209 UART)
+#define CONFIG_STEPPER_COARSE_MAX_FREQ_HZ 16000 // Default maximum step frequency with the microstep switch
 
 // ============================================================================
 // User Interface Configuration
@@ -76,6 +101,27 @@
 #define CONFIG_RTC_MIN_YEAR_OFFSET      124     // 2024 (years since 1900)
 #define CONFIG_RTC_MAX_YEAR_OFFSET      130     // 2030 (years since 1900)
 
+// ============================================================================
+// Scheduler Configuration
+// ============================================================================
+
+// Re-read the RTC this often to correct drift of the timer-based clock
+#define CONFIG_SCHEDULER_RESYNC_MS      600000  // 10 minutes
+
+// Watering events are fired by the PCF85063 alarm
+#define CONFIG_RTC_INT_PIN              -1      // GPIO wired to the RTC's INT output, -1 = poll the alarm flag
+#define CONFIG_RTC_ALARM_POLL_MS        1000    // Alarm flag check over I2C when INT is not wired
+#define CONFIG_SCHEDULER_STORED_RULES   32      // Rules kept in the settings store (ids 0 upwards)
+#define CONFIG_SCHEDULER_MAX_INTERVAL_MIN 525600 // Longest ":every" interval (a year)
+
+// Sensor history: moisture, battery and temperature go to the time-series store this often
+#define CONFIG_HISTORY_SAMPLE_MS        10000   // 10 seconds
+
+// Pump that scheduled watering is dispensed with
+#define CONFIG_DOSING_PUMP              0
+#define CONFIG_PUMP_TUNING_ZONE         0       // Zone valve opened while tuning the pump speed
+#define CONFIG_PUMP_CALIBRATION_ZONE    0       // Zone valve opened for a calibration run (collect its outflow)
+
 // ============================================================================
 // Logging Configuration
 // ============================================================================
@@ -97,10 +143,14 @@
 
 // Main loop timing
 #define CONFIG_MAIN_LOOP_DELAY_MS       5       // Main loop delay
+#define CONFIG_MAIN_LOOP_IDLE_MS        100     // Longest wait while locked and the pump is idle (any interrupt ends it)
 
 // Update intervals
 #define CONFIG_LVGL_UPDATE_INTERVAL_MS  5       // LVGL timer handler interval
 
+// USB host commands
+#define CONFIG_USB_LINE_LENGTH          64      // Longest ':' command line (with arguments)
+
 // ============================================================================
 // Version Information
 // ============================================================================
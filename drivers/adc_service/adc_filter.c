@@ -0,0 +1,68 @@
+/**
+ * PicoFlora ADC Filters Implementation
+ */
+
+#include "adc_filter.h"
+
+// Compare-exchange: a gets the smaller, b the larger (compiles to conditional moves)
+#define SORT2(a, b) do { \
+    uint16_t lo_ = (a) < (b) ? (a) : (b); \
+    uint16_t hi_ = (a) < (b) ? (b) : (a); \
+    (a) = lo_; \
+    (b) = hi_; \
+} while (0)
+
+uint16_t adc_filter_median3(uint16_t *v) {
+    SORT2(v[0], v[1]);
+    SORT2(v[1], v[2]);
+    SORT2(v[0], v[1]);
+    return v[1];
+}
+
+uint16_t adc_filter_median5(uint16_t *v) {
+    SORT2(v[0], v[1]); SORT2(v[3], v[4]); SORT2(v[0], v[3]);
+    SORT2(v[1], v[4]); SORT2(v[1], v[2]); SORT2(v[2], v[3]);
+    SORT2(v[1], v[2]);
+    return v[2];
+}
+
+uint16_t adc_filter_median9(uint16_t *v) {
+    // Partial network: only v[4] ends up in its sorted place
+    SORT2(v[1], v[2]); SORT2(v[4], v[5]); SORT2(v[7], v[8]);
+    SORT2(v[0], v[1]); SORT2(v[3], v[4]); SORT2(v[6], v[7]);
+    SORT2(v[1], v[2]); SORT2(v[4], v[5]); SORT2(v[7], v[8]);
+    SORT2(v[0], v[3]); SORT2(v[5], v[8]); SORT2(v[4], v[7]);
+    SORT2(v[3], v[6]); SORT2(v[1], v[4]); SORT2(v[2], v[5]);
+    SORT2(v[4], v[7]); SORT2(v[4], v[2]); SORT2(v[6], v[4]);
+    SORT2(v[4], v[2]);
+    return v[4];
+}
+
+uint32_t adc_filter_ema_step(uint32_t state_q8, uint16_t sample, uint8_t shift) {
+    // state += (sample - state) / 2^shift, in signed arithmetic so falling inputs track too
+    int32_t error = (int32_t)((uint32_t)sample << ADC_FILTER_EMA_FRAC_BITS) - (int32_t)state_q8;
+    return (uint32_t)((int32_t)state_q8 + (error >> shift));
+}
+
+uint16_t adc_filter_ema(const uint16_t *samples, uint32_t count, uint8_t shift) {
+    if (count == 0) {
+        return 0;
+    }
+    uint32_t state_q8 = (uint32_t)samples[0] << ADC_FILTER_EMA_FRAC_BITS;
+    for (uint32_t i = 1; i < count; i++) {
+        state_q8 = adc_filter_ema_step(state_q8, samples[i], shift);
+    }
+    return (uint16_t)((state_q8 + (1u << (ADC_FILTER_EMA_FRAC_BITS - 1))) >> ADC_FILTER_EMA_FRAC_BITS);
+}
+
+uint32_t adc_filter_decimate(const uint16_t *samples, uint32_t count, uint8_t extra_bits) {
+    uint32_t needed = 1u << (2 * extra_bits);
+    if (extra_bits > 8 || count < needed) {
+        return 0;
+    }
+    uint32_t sum = 0;
+    for (uint32_t i = count - needed; i < count; i++) {
+        sum += samples[i];
+    }
+    return sum >> extra_bits;
+}
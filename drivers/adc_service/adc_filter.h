@@ -0,0 +1,39 @@
+/**
+ * PicoFlora ADC Filters
+ *
+ * Fixed-point filters over a window of 12-bit ADC samples, run on demand by
+ * the ADC service. They are pure functions (no hardware, no state), so they
+ * build and run on the host as well.
+ *
+ * - Median: fixed compare-exchange networks, no data-dependent branches and
+ *   a known cost (19 exchanges for 9 samples against up to 36 for a bubble sort).
+ * - EMA: exponential moving average with alpha = 1 / 2^shift, carried in Q8
+ *   so small steps are not lost to truncation.
+ * - Decimation: 4^n samples summed and shifted right by n gives n extra bits
+ *   of resolution (the noise must span at least one LSB for that to help).
+ */
+
+#ifndef ADC_FILTER_H
+#define ADC_FILTER_H
+
+#include <stdint.h>
+
+// Configuration
+#define ADC_FILTER_EMA_FRAC_BITS 8          // Fraction bits of the EMA state
+
+// Median of exactly 3, 5 or 9 samples; the arrays are reordered in place
+uint16_t adc_filter_median3(uint16_t *v);
+uint16_t adc_filter_median5(uint16_t *v);
+uint16_t adc_filter_median9(uint16_t *v);
+
+// EMA state step: state and result in Q8 (ADC counts * 256)
+uint32_t adc_filter_ema_step(uint32_t state_q8, uint16_t sample, uint8_t shift);
+
+// EMA over samples oldest first, seeded with the first; rounded to ADC counts
+uint16_t adc_filter_ema(const uint16_t *samples, uint32_t count, uint8_t shift);
+
+// Oversample and decimate the last 4^extra_bits samples: a (12 + extra_bits)-bit result.
+// Returns 0 when fewer samples are given.
+uint32_t adc_filter_decimate(const uint16_t *samples, uint32_t count, uint8_t extra_bits);
+
+#endif // ADC_FILTER_H
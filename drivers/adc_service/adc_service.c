@@ -0,0 +1,235 @@
+/**
+ * PicoFlora ADC Service Implementation
+ */
+
+#include "adc_service.h"
+#include "adc_filter.h"
+#include "pico/stdlib.h"
+#include "hardware/adc.h"
+#include "hardware/dma.h"
+#include "hardware/clocks.h"
+#include "../logging/logging.h"
+#include <stdio.h>
+
+#define ADC_FIRST_GPIO 26
+#define ADC_VREF_MV 3300
+
+// Interleaved samples: row r holds one sample of every channel, in round-robin order
+static uint16_t samples[ADC_SERVICE_CHANNELS * ADC_SERVICE_DEPTH];
+
+// Service state
+static struct {
+    bool running;
+    uint8_t channel_mask;
+    uint8_t channel_count;
+    int8_t slot[ADC_SERVICE_CHANNELS];      // Position in the row, -1 = not sampled
+    uint32_t length;                        // Samples in the buffer (DEPTH rows)
+    uint32_t rate_hz;                       // Per channel
+    uint64_t start_us;
+    int data_dma;
+    int rewind_dma;
+    uint16_t *rewind_addr;                  // Read by the rewind channel
+} adc;
+
+bool adc_service_init(uint8_t channel_mask, uint32_t rate_hz) {
+    channel_mask &= (1u << ADC_SERVICE_CHANNELS) - 1;
+    if (adc.running || channel_mask == 0 || rate_hz == 0) {
+        return false;
+    }
+
+    uint8_t count = 0;
+    for (uint8_t ch = 0; ch < ADC_SERVICE_CHANNELS; ch++) {
+        adc.slot[ch] = (channel_mask & (1u << ch)) ? (int8_t)count++ : -1;
+    }
+
+    // One conversion takes 96 ADC clocks, so 48 MHz gives 500k samples/s shared by all channels
+    uint32_t total_hz = rate_hz * count;
+    uint32_t adc_hz = clock_get_hz(clk_adc);
+    if (total_hz > adc_hz / 96) {
+        LOG_HW_ERROR("ADC rate %lu Hz x %u channels is above the converter limit", rate_hz, count);
+        return false;
+    }
+
+    int data_dma = dma_claim_unused_channel(false);
+    int rewind_dma = dma_claim_unused_channel(false);
+    if (data_dma < 0 || rewind_dma < 0) {
+        if (data_dma >= 0) {
+            dma_channel_unclaim((uint)data_dma);
+        }
+        LOG_HW_ERROR("No free DMA channels for the ADC service");
+        return false;
+    }
+
+    adc.channel_mask = channel_mask;
+    adc.channel_count = count;
+    adc.length = (uint32_t)count * ADC_SERVICE_DEPTH;
+    adc.rate_hz = rate_hz;
+    adc.data_dma = data_dma;
+    adc.rewind_dma = rewind_dma;
+    adc.rewind_addr = samples;
+
+    adc_init();
+    for (uint8_t ch = 0; ch < ADC_SERVICE_CHANNELS; ch++) {
+        if (adc.slot[ch] < 0) {
+            continue;
+        }
+        if (ch == ADC_SERVICE_TEMP_CHANNEL) {
+            adc_set_temp_sensor_enabled(true);
+        } else {
+            adc_gpio_init(ADC_FIRST_GPIO + ch);
+        }
+    }
+
+    // Round robin starts after the selected input, so start at the lowest one to keep slot order
+    uint8_t first = 0;
+    while (adc.slot[first] < 0) {
+        first++;
+    }
+    adc_select_input(first);
+    adc_set_round_robin(channel_mask);
+    adc_fifo_setup(true, true, 1, false, false);
+    adc_fifo_drain();
+    adc_set_clkdiv((float)adc_hz / (float)total_hz - 1.0f);
+
+    // FIFO -> buffer, paced by the ADC; at the end, chains to the rewind channel
+    dma_channel_config data_config = dma_channel_get_default_config((uint)data_dma);
+    channel_config_set_transfer_data_size(&data_config, DMA_SIZE_16);
+    channel_config_set_read_increment(&data_config, false);
+    channel_config_set_write_increment(&data_config, true);
+    channel_config_set_dreq(&data_config, DREQ_ADC);
+    channel_config_set_chain_to(&data_config, (uint)rewind_dma);
+    dma_channel_configure((uint)data_dma, &data_config, samples, &adc_hw->fifo, adc.length, false);
+
+    // Rewind: write the buffer start to the data channel's write address trigger, restarting it
+    dma_channel_config rewind_config = dma_channel_get_default_config((uint)rewind_dma);
+    channel_config_set_transfer_data_size(&rewind_config, DMA_SIZE_32);
+    channel_config_set_read_increment(&rewind_config, false);
+    channel_config_set_write_increment(&rewind_config, false);
+    dma_channel_configure((uint)rewind_dma, &rewind_config,
+                          &dma_channel_hw_addr((uint)data_dma)->al2_write_addr_trig,
+                          &adc.rewind_addr, 1, false);
+
+    dma_channel_start((uint)data_dma);
+    adc.start_us = time_us_64();
+    adc_run(true);
+    adc.running = true;
+
+    LOG_HW_INFO("ADC service: channels 0x%02X at %lu Hz each (DMA %d/%d, %lu samples)",
+                channel_mask, rate_hz, data_dma, rewind_dma, adc.length);
+    return true;
+}
+
+bool adc_service_is_running(void) {
+    return adc.running;
+}
+
+// Copy up to 'count' of the newest samples of a channel, oldest first; returns how many
+static uint32_t read_window(uint8_t channel, uint16_t *out, uint32_t count) {
+    if (!adc.running || channel >= ADC_SERVICE_CHANNELS || adc.slot[channel] < 0) {
+        return 0;
+    }
+
+    // Only what has been converted since init (the buffer starts out zeroed)
+    uint64_t converted = (time_us_64() - adc.start_us) * adc.rate_hz / 1000000;
+    if (count > ADC_SERVICE_DEPTH) {
+        count = ADC_SERVICE_DEPTH;
+    }
+    if (count > converted) {
+        count = (uint32_t)converted;
+    }
+    if (count == 0) {
+        return 0;
+    }
+
+    // The data channel's write pointer is the next slot to fill; the end means it is being rewound
+    uint32_t write_addr = (uint32_t)dma_channel_hw_addr((uint)adc.data_dma)->write_addr;
+    uint32_t write_index = (write_addr - (uint32_t)(uintptr_t)samples) / sizeof(uint16_t);
+    if (write_index >= adc.length) {
+        write_index = 0;
+    }
+
+    // Newest complete row for this channel, then one row back per older sample
+    uint32_t slot = (uint32_t)adc.slot[channel];
+    uint32_t row = write_index / adc.channel_count;
+    if (slot >= write_index % adc.channel_count) {
+        row = (row + ADC_SERVICE_DEPTH - 1) % ADC_SERVICE_DEPTH;
+    }
+    for (uint32_t i = count; i-- > 0;) {
+        out[i] = samples[row * adc.channel_count + slot];
+        row = (row + ADC_SERVICE_DEPTH - 1) % ADC_SERVICE_DEPTH;
+    }
+    return count;
+}
+
+uint16_t adc_service_get_latest(uint8_t channel) {
+    uint16_t sample;
+    return read_window(channel, &sample, 1) ? sample : 0;
+}
+
+uint16_t adc_service_get_median(uint8_t channel) {
+    uint16_t window[ADC_SERVICE_MEDIAN];
+    uint32_t count = read_window(channel, window, ADC_SERVICE_MEDIAN);
+    if (count < ADC_SERVICE_MEDIAN) {
+        return count ? window[count - 1] : 0;
+    }
+#if ADC_SERVICE_MEDIAN == 9
+    return adc_filter_median9(window);
+#elif ADC_SERVICE_MEDIAN == 5
+    return adc_filter_median5(window);
+#else
+    return adc_filter_median3(window);
+#endif
+}
+
+uint16_t adc_service_get_average(uint8_t channel) {
+    uint16_t window[ADC_SERVICE_DEPTH];
+    uint32_t count = read_window(channel, window, ADC_SERVICE_DEPTH);
+    return adc_filter_ema(window, count, ADC_SERVICE_EMA_SHIFT);
+}
+
+uint32_t adc_service_get_oversampled(uint8_t channel, uint8_t extra_bits) {
+    if (extra_bits > ADC_SERVICE_MAX_EXTRA_BITS) {
+        extra_bits = ADC_SERVICE_MAX_EXTRA_BITS;
+    }
+    uint16_t window[ADC_SERVICE_DEPTH];
+    uint32_t count = read_window(channel, window, 1u << (2 * extra_bits));
+    if (count < (1u << (2 * extra_bits))) {
+        // Shortly after init: the newest sample, scaled to the same range
+        return count ? (uint32_t)window[count - 1] << extra_bits : 0;
+    }
+    return adc_filter_decimate(window, count, extra_bits);
+}
+
+uint32_t adc_service_to_mv(uint32_t counts, uint8_t bits) {
+    return (uint32_t)(((uint64_t)counts * ADC_VREF_MV) >> bits);
+}
+
+int32_t adc_service_temperature_mc(void) {
+    // RP2350 datasheet: T = 27 - (Vbe - 0.706 V) / 1.721 mV per degree
+    uint32_t counts = adc_service_get_oversampled(ADC_SERVICE_TEMP_CHANNEL, ADC_SERVICE_MAX_EXTRA_BITS);
+    int64_t vbe_uv = (int64_t)(((uint64_t)counts * ADC_VREF_MV * 1000) >> (12 + ADC_SERVICE_MAX_EXTRA_BITS));
+    return (int32_t)(27000 - (vbe_uv - 706000) * 1000 / 1721);
+}
+
+void adc_service_dump(void) {
+    if (!adc.running) {
+        printf("ADC not running\n");
+        return;
+    }
+    uint32_t write_addr = (uint32_t)dma_channel_hw_addr((uint)adc.data_dma)->write_addr;
+    printf("ADC channels=0x%02X rate_hz=%lu dma=%d/%d samples=%lu write_index=%lu\n",
+           adc.channel_mask, adc.rate_hz, adc.data_dma, adc.rewind_dma, adc.length,
+           (write_addr - (uint32_t)(uintptr_t)samples) / sizeof(uint16_t));
+    for (uint8_t ch = 0; ch < ADC_SERVICE_CHANNELS; ch++) {
+        if (adc.slot[ch] < 0) {
+            continue;
+        }
+        uint32_t oversampled = adc_service_get_oversampled(ch, ADC_SERVICE_MAX_EXTRA_BITS);
+        printf("ADC ch=%u latest=%u median=%u average=%u oversampled=%lu mv=%lu\n",
+               ch, adc_service_get_latest(ch), adc_service_get_median(ch), adc_service_get_average(ch),
+               oversampled, adc_service_to_mv(oversampled, 12 + ADC_SERVICE_MAX_EXTRA_BITS));
+    }
+    if (adc.slot[ADC_SERVICE_TEMP_CHANNEL] >= 0) {
+        printf("ADC temperature_mc=%ld\n", adc_service_temperature_mc());
+    }
+}
@@ -0,0 +1,52 @@
+/**
+ * PicoFlora ADC Service
+ *
+ * Free-running acquisition of the battery, soil-moisture probes and the
+ * temperature sensor. The ADC converts the selected inputs in round-robin
+ * order on its own clock and a DMA channel streams the FIFO into a sample
+ * buffer; a second DMA channel rewinds the first when it reaches the end, so
+ * the buffer is refilled forever without interrupts or CPU time.
+ *
+ * The buffer holds ADC_SERVICE_DEPTH samples per channel, interleaved in
+ * round-robin order. Its length is a multiple of the channel count, so every
+ * channel keeps a fixed slot in each row (a power-of-two address wrap would
+ * not allow that with three channels). Readings are filtered on demand from
+ * the newest samples: latest, median (sorting network), EMA and
+ * oversampling-decimation, see adc_filter.h.
+ *
+ * While the service runs it owns the ADC: adc_read() and the BSP battery
+ * helpers must not be used (the battery is ADC channel 1).
+ */
+
+#ifndef ADC_SERVICE_H
+#define ADC_SERVICE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Configuration
+#define ADC_SERVICE_CHANNELS 5              // ADC0-3 on GPIO 26-29, 4 = temperature sensor
+#define ADC_SERVICE_TEMP_CHANNEL 4
+#define ADC_SERVICE_DEPTH 64                // Samples kept per channel
+#define ADC_SERVICE_MEDIAN 9                // Samples in the median (3, 5 or 9)
+#define ADC_SERVICE_EMA_SHIFT 3             // EMA alpha = 1/8, over the whole window
+#define ADC_SERVICE_MAX_EXTRA_BITS 3        // Decimation needs 4^bits samples, at most DEPTH
+
+// Start conversions of the channels in 'channel_mask' (bit n = ADC channel n), each at 'rate_hz'
+bool adc_service_init(uint8_t channel_mask, uint32_t rate_hz);
+bool adc_service_is_running(void);
+
+// Readings of one channel in ADC counts (12 bits), 0 if it is not sampled
+uint16_t adc_service_get_latest(uint8_t channel);
+uint16_t adc_service_get_median(uint8_t channel);           // Median of the newest ADC_SERVICE_MEDIAN samples
+uint16_t adc_service_get_average(uint8_t channel);          // EMA over the window
+uint32_t adc_service_get_oversampled(uint8_t channel, uint8_t extra_bits);  // (12 + extra_bits) bits
+
+// Conversions
+uint32_t adc_service_to_mv(uint32_t counts, uint8_t bits);
+int32_t adc_service_temperature_mc(void);                  // Die temperature in milli-degrees C
+
+// Diagnostics
+void adc_service_dump(void);
+
+#endif // ADC_SERVICE_H
@@ -0,0 +1,352 @@
+/**
+ * PicoFlora Audio Engine Implementation
+ */
+
+#include "audio.h"
+#include "bsp_i2s.h"
+#include "bsp_dma_channel_irq.h"
+#include "pico/stdlib.h"
+#include "hardware/dma.h"
+#include "hardware/sync.h"
+#include "../logging/logging.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#define BUFFER_BYTES (AUDIO_BUFFER_FRAMES * sizeof(uint32_t))
+#define RAMP_SAMPLES (1u << AUDIO_RAMP_SHIFT)
+#define SINE_SIZE (1u << AUDIO_SINE_BITS)
+#define UNITY_GAIN 256                      // Q8
+
+typedef enum {
+    VOICE_TONE,
+    VOICE_CLIP
+} voice_kind_t;
+
+typedef struct {
+    volatile bool active;                   // Set by the main loop once filled in, cleared by the IRQ
+    voice_kind_t kind;
+    int32_t gain;                           // Q8
+    uint32_t delay;                         // Samples of silence before the start
+
+    // Tone
+    audio_wave_t wave;
+    uint32_t phase;
+    uint32_t phase_step;
+    uint32_t length;                        // Samples
+    uint32_t position;
+
+    // Clip
+    const uint8_t *data;
+    uint32_t size;
+    uint32_t offset;                        // Next byte
+    uint32_t block_end;                     // Offset of the next block header
+    uint16_t block_size;
+    bool high_nibble;                       // data[offset] is half decoded
+    audio_adpcm_t adpcm;
+} voice_t;
+
+// Tone steps of an alert
+typedef struct {
+    uint16_t freq_hz;
+    uint16_t duration_ms;
+    uint16_t delay_ms;
+    audio_wave_t wave;
+    uint8_t volume;
+} alert_tone_t;
+
+static const alert_tone_t alert_done[] = {
+    { 880, 120, 0, AUDIO_WAVE_SINE, 60 },
+    { 1320, 200, 100, AUDIO_WAVE_SINE, 60 },  // Overlaps the first note
+};
+static const alert_tone_t alert_alarm[] = {
+    { 2400, 120, 0, AUDIO_WAVE_SQUARE, 80 },
+    { 2400, 120, 200, AUDIO_WAVE_SQUARE, 80 },
+    { 2400, 120, 400, AUDIO_WAVE_SQUARE, 80 },
+};
+
+static const struct {
+    const alert_tone_t *tones;
+    uint8_t count;
+} alerts[] = {
+    [AUDIO_ALERT_DONE] = { alert_done, sizeof(alert_done) / sizeof(alert_done[0]) },
+    [AUDIO_ALERT_ALARM] = { alert_alarm, sizeof(alert_alarm) / sizeof(alert_alarm[0]) },
+};
+
+// Ping-pong halves, each aligned to its size for the DMA read ring
+static uint32_t buffer[2][AUDIO_BUFFER_FRAMES] __attribute__((aligned(BUFFER_BYTES)));
+static int32_t mix[AUDIO_BUFFER_FRAMES];
+static int16_t sine[SINE_SIZE];
+static voice_t voices[AUDIO_VOICES];
+
+// Engine state
+static struct {
+    bool running;
+    int dma[2];
+    bool silent[2];                         // Half already holds zeros
+    volatile bool stop_request;
+
+    // Statistics
+    uint32_t refills;
+    uint32_t underruns;
+    uint32_t last_refill_us;
+    uint32_t max_refill_us;
+} audio;
+
+// Add up to 'count' samples of a tone into mix[]; false once it has ended
+static bool render_tone(voice_t *v, int32_t *out, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        if (v->position >= v->length) {
+            return false;
+        }
+        uint32_t edge = v->position < v->length - v->position ? v->position : v->length - v->position;
+        int32_t gain = edge < RAMP_SAMPLES ? (v->gain * (int32_t)edge) >> AUDIO_RAMP_SHIFT : v->gain;
+        int32_t sample = v->wave == AUDIO_WAVE_SINE ? sine[v->phase >> (32 - AUDIO_SINE_BITS)]
+                                                    : (v->phase & 0x80000000u) ? -INT16_MAX : INT16_MAX;
+        out[i] += (sample * gain) >> 8;
+        v->phase += v->phase_step;
+        v->position++;
+    }
+    return true;
+}
+
+// Decode up to 'count' samples of a clip into mix[]; false once it has ended
+static bool render_clip(voice_t *v, int32_t *out, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        int32_t sample;
+        if (v->high_nibble) {
+            sample = audio_adpcm_decode(&v->adpcm, v->data[v->offset++] >> 4);
+            v->high_nibble = false;
+        } else if (v->offset >= v->size) {
+            return false;
+        } else if (v->offset == v->block_end) {
+            if (v->offset + AUDIO_ADPCM_BLOCK_HEADER > v->size) {
+                return false;
+            }
+            sample = audio_adpcm_block_start(&v->adpcm, &v->data[v->offset]);
+            v->block_end = v->offset + v->block_size;
+            v->offset += AUDIO_ADPCM_BLOCK_HEADER;
+        } else {
+            sample = audio_adpcm_decode(&v->adpcm, v->data[v->offset] & 0x0F);
+            v->high_nibble = true;
+        }
+        out[i] += (sample * v->gain) >> 8;
+    }
+    return true;
+}
+
+// DMA IRQ: 'half' has just been played and the other one is on the wire; mix the next frames into it
+static void refill(uint32_t half) {
+    uint32_t start_us = time_us_32();
+    if (dma_channel_get_irq1_status((uint)audio.dma[half ^ 1])) {
+        audio.underruns++;                  // The other half ended too: this one is replaying already
+    }
+    audio.refills++;
+
+    if (audio.stop_request) {
+        for (uint32_t i = 0; i < AUDIO_VOICES; i++) {
+            voices[i].active = false;
+        }
+        audio.stop_request = false;
+    }
+
+    bool any = false;
+    for (uint32_t i = 0; i < AUDIO_VOICES; i++) {
+        voice_t *v = &voices[i];
+        if (!v->active) {
+            continue;
+        }
+        if (!any) {
+            memset(mix, 0, sizeof(mix));
+            any = true;
+        }
+        uint32_t skip = v->delay < AUDIO_BUFFER_FRAMES ? v->delay : AUDIO_BUFFER_FRAMES;
+        v->delay -= skip;
+        bool playing = v->kind == VOICE_TONE ? render_tone(v, mix + skip, AUDIO_BUFFER_FRAMES - skip)
+                                             : render_clip(v, mix + skip, AUDIO_BUFFER_FRAMES - skip);
+        if (!playing) {
+            v->active = false;
+        }
+    }
+
+    uint32_t *out = buffer[half];
+    if (any) {
+        // Saturate, same sample on left (high half) and right
+        for (uint32_t i = 0; i < AUDIO_BUFFER_FRAMES; i++) {
+            int32_t s = mix[i] > INT16_MAX ? INT16_MAX : mix[i] < INT16_MIN ? INT16_MIN : mix[i];
+            out[i] = ((uint32_t)(uint16_t)s << 16) | (uint16_t)s;
+        }
+        audio.silent[half] = false;
+    } else if (!audio.silent[half]) {
+        memset(out, 0, BUFFER_BYTES);
+        audio.silent[half] = true;
+    }
+
+    audio.last_refill_us = time_us_32() - start_us;
+    if (audio.last_refill_us > audio.max_refill_us) {
+        audio.max_refill_us = audio.last_refill_us;
+    }
+}
+
+static void refill_first(void) {
+    refill(0);
+}
+
+static void refill_second(void) {
+    refill(1);
+}
+
+bool audio_init(void) {
+    if (audio.running) {
+        return false;
+    }
+
+    int dma_a = dma_claim_unused_channel(false);
+    int dma_b = dma_claim_unused_channel(false);
+    if (dma_a < 0 || dma_b < 0) {
+        if (dma_a >= 0) {
+            dma_channel_unclaim((uint)dma_a);
+        }
+        LOG_HW_ERROR("No free DMA channels for audio");
+        return false;
+    }
+    audio.dma[0] = dma_a;
+    audio.dma[1] = dma_b;
+    audio.silent[0] = audio.silent[1] = true;
+
+    for (uint32_t i = 0; i < SINE_SIZE; i++) {
+        sine[i] = (int16_t)lroundf(sinf(6.28318530718f * i / SINE_SIZE) * INT16_MAX);
+    }
+
+    bsp_i2s_init();
+
+    // Each half -> PIO TX FIFO, paced by its DREQ, wrapping within the half and chaining to the other
+    for (uint32_t half = 0; half < 2; half++) {
+        uint channel = (uint)audio.dma[half];
+        dma_channel_config config = dma_channel_get_default_config(channel);
+        channel_config_set_transfer_data_size(&config, DMA_SIZE_32);
+        channel_config_set_read_increment(&config, true);
+        channel_config_set_write_increment(&config, false);
+        channel_config_set_ring(&config, false, __builtin_ctz(BUFFER_BYTES));
+        channel_config_set_dreq(&config, bsp_i2s_get_dreq());
+        channel_config_set_chain_to(&config, (uint)audio.dma[half ^ 1]);
+        dma_channel_configure(channel, &config, bsp_i2s_get_tx_fifo(), buffer[half], AUDIO_BUFFER_FRAMES, false);
+    }
+    bsp_dma_channel_irq_add(1, (uint)audio.dma[0], refill_first);
+    bsp_dma_channel_irq_add(1, (uint)audio.dma[1], refill_second);
+
+    dma_channel_start((uint)audio.dma[0]);
+    audio.running = true;
+
+    LOG_HW_INFO("Audio: %u Hz, %u-frame ping-pong (DMA %d/%d), %u voices", AUDIO_SAMPLE_RATE,
+                AUDIO_BUFFER_FRAMES, audio.dma[0], audio.dma[1], AUDIO_VOICES);
+    return true;
+}
+
+bool audio_is_running(void) {
+    return audio.running;
+}
+
+static voice_t *free_voice(void) {
+    for (uint32_t i = 0; i < AUDIO_VOICES; i++) {
+        if (!voices[i].active) {
+            return &voices[i];
+        }
+    }
+    return NULL;
+}
+
+// Hand a filled-in voice to the IRQ
+static void start_voice(voice_t *v) {
+    __dmb();
+    v->active = true;
+}
+
+bool audio_play_tone(uint16_t freq_hz, uint16_t duration_ms, uint16_t delay_ms, audio_wave_t wave,
+                     uint8_t volume) {
+    voice_t *v = audio.running ? free_voice() : NULL;
+    if (!v || freq_hz == 0 || freq_hz >= AUDIO_SAMPLE_RATE / 2 || duration_ms == 0) {
+        return false;
+    }
+    v->kind = VOICE_TONE;
+    v->gain = (volume > 100 ? 100 : volume) * UNITY_GAIN / 100;
+    v->delay = (uint32_t)delay_ms * AUDIO_SAMPLE_RATE / 1000;
+    v->wave = wave;
+    v->phase = 0;
+    v->phase_step = (uint32_t)(((uint64_t)freq_hz << 32) / AUDIO_SAMPLE_RATE);
+    v->length = (uint32_t)duration_ms * AUDIO_SAMPLE_RATE / 1000;
+    v->position = 0;
+    start_voice(v);
+    return true;
+}
+
+bool audio_play_clip(const audio_clip_t *clip, uint8_t volume) {
+    voice_t *v = audio.running ? free_voice() : NULL;
+    if (!v || !clip || !clip->data || clip->size == 0 ||
+        (clip->block_size != 0 && clip->block_size <= AUDIO_ADPCM_BLOCK_HEADER)) {
+        return false;
+    }
+    v->kind = VOICE_CLIP;
+    v->gain = (volume > 100 ? 100 : volume) * UNITY_GAIN / 100;
+    v->delay = 0;
+    v->data = clip->data;
+    v->size = clip->size;
+    v->offset = 0;
+    v->block_size = clip->block_size;
+    v->block_end = clip->block_size ? 0 : UINT32_MAX;  // Headerless: start from silence
+    v->high_nibble = false;
+    v->adpcm.predictor = 0;
+    v->adpcm.index = 0;
+    start_voice(v);
+    return true;
+}
+
+bool audio_alert(audio_alert_t alert) {
+    if (!audio.running || (uint32_t)alert >= sizeof(alerts) / sizeof(alerts[0])) {
+        return false;
+    }
+
+    // All tones or none, so a busy mixer does not play half a cue
+    uint32_t free_count = 0;
+    for (uint32_t i = 0; i < AUDIO_VOICES; i++) {
+        free_count += !voices[i].active;
+    }
+    if (free_count < alerts[alert].count) {
+        return false;
+    }
+    for (uint32_t i = 0; i < alerts[alert].count; i++) {
+        const alert_tone_t *t = &alerts[alert].tones[i];
+        audio_play_tone(t->freq_hz, t->duration_ms, t->delay_ms, t->wave, t->volume);
+    }
+    return true;
+}
+
+void audio_stop_all(void) {
+    audio.stop_request = true;
+}
+
+void audio_clock_changed(void) {
+    if (audio.running) {
+        bsp_i2s_update_clock();
+    }
+}
+
+uint32_t audio_get_underruns(void) {
+    return audio.underruns;
+}
+
+void audio_dump(void) {
+    if (!audio.running) {
+        printf("AUDIO not running\n");
+        return;
+    }
+    uint32_t active = 0;
+    for (uint32_t i = 0; i < AUDIO_VOICES; i++) {
+        active += voices[i].active;
+    }
+    printf("AUDIO rate_hz=%u frames=%u dma=%d/%d voices=%lu/%u\n", AUDIO_SAMPLE_RATE, AUDIO_BUFFER_FRAMES,
+           audio.dma[0], audio.dma[1], active, AUDIO_VOICES);
+    printf("AUDIO refills=%lu underruns=%lu refill_us=%lu max_refill_us=%lu budget_us=%u\n", audio.refills,
+           audio.underruns, audio.last_refill_us, audio.max_refill_us,
+           AUDIO_BUFFER_FRAMES * 1000000 / AUDIO_SAMPLE_RATE);
+}
@@ -0,0 +1,86 @@
+/**
+ * PicoFlora Audio Engine
+ *
+ * Non-blocking sound output over the BSP's I2S PIO program. Two DMA
+ * channels feed the PIO TX FIFO from a ping-pong buffer, each chained to
+ * the other, so the stream runs in hardware with no gap between halves.
+ * Each half is aligned to its own size and read with a DMA address ring,
+ * so a channel's read address wraps back to the start of its half by
+ * itself. The only CPU work is the refill: when a channel completes, its
+ * DMA IRQ mixes the next AUDIO_BUFFER_FRAMES into the half that just
+ * played while the other half is on the wire, a full half (16 ms) of
+ * deadline however long the main loop spends rendering the UI.
+ *
+ * The mixer sums up to AUDIO_VOICES sources with per-voice volume and
+ * saturates to 16 bits, sent identically to both I2S channels:
+ * - Tones: phase-accumulator oscillator (sine table or square), with a
+ *   short linear ramp at each end against clicks and an optional start
+ *   delay, so chimes and beep patterns are queued in one go.
+ * - Clips: IMA ADPCM streamed from flash (XIP) and decoded as they play,
+ *   see audio_adpcm.h.
+ *
+ * Voices are claimed from the main loop and released by the IRQ; nothing
+ * blocks on either side. A refill that starts after the other half has
+ * also finished means that half replayed stale samples; these underruns
+ * are counted (a flash erase, which masks interrupts for tens of
+ * milliseconds, is the usual cause).
+ */
+
+#ifndef AUDIO_H
+#define AUDIO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "audio_adpcm.h"
+
+// Configuration
+#define AUDIO_SAMPLE_RATE 16000             // BSP_I2S_FREQ
+#define AUDIO_BUFFER_FRAMES 256             // Per half: 16 ms, 1 KB (a power of two, for the DMA ring)
+#define AUDIO_VOICES 6                      // Enough for the alarm and the chime at once
+#define AUDIO_RAMP_SHIFT 5                  // 32-sample (2 ms) fade in and out of tones
+#define AUDIO_SINE_BITS 8                   // 256-entry sine table
+
+// Tone waveforms
+typedef enum {
+    AUDIO_WAVE_SINE,
+    AUDIO_WAVE_SQUARE                       // Louder on small speakers, for alarms
+} audio_wave_t;
+
+// IMA ADPCM clip in flash, mono at AUDIO_SAMPLE_RATE
+typedef struct {
+    const uint8_t *data;
+    uint32_t size;                          // Bytes
+    uint16_t block_size;                    // WAV block align, 0 = one headerless stream
+} audio_clip_t;
+
+// Alert sounds built from tones
+typedef enum {
+    AUDIO_ALERT_DONE,                       // Rising two-note chime
+    AUDIO_ALERT_ALARM                       // Three loud beeps
+} audio_alert_t;
+
+// Start the I2S output and the ping-pong DMA (silence until something plays)
+bool audio_init(void);
+bool audio_is_running(void);
+
+// Queue a tone; false if all voices are busy. Volume in percent
+bool audio_play_tone(uint16_t freq_hz, uint16_t duration_ms, uint16_t delay_ms, audio_wave_t wave,
+                     uint8_t volume);
+
+// Queue a clip; false if all voices are busy. The clip data must stay valid while it plays
+bool audio_play_clip(const audio_clip_t *clip, uint8_t volume);
+
+// Queue one of the alert sounds (several voices at once)
+bool audio_alert(audio_alert_t alert);
+
+// Silence every voice at the next refill
+void audio_stop_all(void);
+
+// Follow a system clock change (the I2S bit clock is derived from it)
+void audio_clock_changed(void);
+
+// Diagnostics
+uint32_t audio_get_underruns(void);
+void audio_dump(void);
+
+#endif // AUDIO_H
@@ -0,0 +1,44 @@
+/**
+ * PicoFlora IMA ADPCM Decoder Implementation
+ */
+
+#include "audio_adpcm.h"
+
+static const int8_t index_step[8] = { -1, -1, -1, -1, 2, 4, 6, 8 };
+
+static const uint16_t step_size[AUDIO_ADPCM_MAX_INDEX + 1] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+int16_t audio_adpcm_block_start(audio_adpcm_t *state, const uint8_t *header) {
+    state->predictor = (int16_t)(header[0] | (header[1] << 8));
+    state->index = header[2] > AUDIO_ADPCM_MAX_INDEX ? AUDIO_ADPCM_MAX_INDEX : header[2];
+    return state->predictor;
+}
+
+int16_t audio_adpcm_decode(audio_adpcm_t *state, uint8_t nibble) {
+    // diff = (nibble & 7 + 1/2) * step / 4, built from the bits as the encoder did
+    int32_t step = step_size[state->index];
+    int32_t diff = step >> 3;
+    if (nibble & 4) {
+        diff += step;
+    }
+    if (nibble & 2) {
+        diff += step >> 1;
+    }
+    if (nibble & 1) {
+        diff += step >> 2;
+    }
+
+    int32_t sample = state->predictor + ((nibble & 8) ? -diff : diff);
+    sample = sample > INT16_MAX ? INT16_MAX : sample < INT16_MIN ? INT16_MIN : sample;
+    state->predictor = (int16_t)sample;
+
+    int32_t index = state->index + index_step[nibble & 7];
+    state->index = (uint8_t)(index < 0 ? 0 : index > AUDIO_ADPCM_MAX_INDEX ? AUDIO_ADPCM_MAX_INDEX : index);
+    return state->predictor;
+}
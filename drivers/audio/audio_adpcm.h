@@ -0,0 +1,39 @@
+/**
+ * PicoFlora IMA ADPCM Decoder
+ *
+ * Decodes 4-bit IMA (DVI) ADPCM to 16-bit PCM, a quarter of the flash that
+ * raw samples would take. Each nibble is a step count against an adaptive
+ * step size: the decoder keeps the predicted sample and an index into the
+ * 89-entry step table, so one sample costs a table lookup, a few shifts and
+ * adds and a clamp. It is a pure function of its state (no hardware), so it
+ * builds and runs on the host as well.
+ *
+ * Clips are stored like the data chunk of a mono IMA ADPCM WAV file: blocks
+ * of block_size bytes, each starting with a 4-byte header (first sample,
+ * little endian, then the step index and a reserved byte) followed by
+ * nibbles, low nibble first. A block_size of 0 means one headerless stream
+ * starting from silence at step index 0.
+ */
+
+#ifndef AUDIO_ADPCM_H
+#define AUDIO_ADPCM_H
+
+#include <stdint.h>
+
+// Configuration
+#define AUDIO_ADPCM_BLOCK_HEADER 4          // Bytes in front of each block
+#define AUDIO_ADPCM_MAX_INDEX 88
+
+// Decoder state
+typedef struct {
+    int16_t predictor;                      // Last decoded sample
+    uint8_t index;                          // Into the step table, 0..88
+} audio_adpcm_t;
+
+// Load the state from a block header; returns the header's sample (the block's first)
+int16_t audio_adpcm_block_start(audio_adpcm_t *state, const uint8_t *header);
+
+// Decode one nibble (low 4 bits) into the next sample
+int16_t audio_adpcm_decode(audio_adpcm_t *state, uint8_t nibble);
+
+#endif // AUDIO_ADPCM_H
@@ -0,0 +1,746 @@
+/**
+ * PicoFlora Volumetric Dosing Implementation
+ */
+
+#include "dosing.h"
+#include "../stepper/stepper_driver.h"
+#include "../stepper/stepper_planner.h"
+#include "../storage/settings_store.h"
+#include "pico/stdlib.h"
+#include "../logging/logging.h"
+#include <stdio.h>
+#include <string.h>
+
+#define CAL_MERGE_HZ 100                    // A calibration this close to a point replaces it
+#define Q8_PER_STEP_DIVISOR ((uint64_t)STEPPER_STEPS_PER_REV << 8)
+
+_Static_assert(sizeof(dosing_cal_point_t) * DOSING_CAL_MAX_POINTS <= SETTINGS_MAX_VALUE_LENGTH,
+               "calibration curve must fit one settings value");
+
+// Calibration curve of one pump, sorted by speed
+typedef struct {
+    dosing_cal_point_t points[DOSING_CAL_MAX_POINTS];
+    uint32_t count;             // 0 = uncalibrated
+} dosing_curve_t;
+
+// Dosing state
+static struct {
+    dosing_curve_t curves[DOSING_MAX_PUMPS];
+
+    dosing_request_t queue[DOSING_QUEUE_SIZE];
+    uint32_t head;
+    uint32_t count;
+
+    // Doses running as one planned sequence, indexed by segment tag
+    dosing_request_t batch[STEPPER_PLANNER_MAX_SEGMENTS];
+    uint32_t batch_count;
+    bool active;
+    bool holding;               // Driver held enabled between sequences
+    bool routed;                // Start hook has routed a dose and not been closed yet
+    bool unroutable;            // The start hook refused a dose within the running sequence
+    uint32_t zone_count;
+
+    // Stall retry of the running sequence
+    bool retry_pending;
+    int32_t retry_position;
+    uint32_t retry_speed_hz;
+    uint32_t retries;
+
+    // Closed-loop correction of the running dose
+    int32_t planned_steps[STEPPER_PLANNER_MAX_SEGMENTS];
+    uint32_t flow_tag;          // Dose the meter reading belongs to
+    uint32_t flow_start_ul;     // Meter reading when it started, DOSING_FLOW_NONE = no meter
+    uint32_t flow_check_ms;
+
+    dosing_start_cb_t start_callback;
+    dosing_flow_cb_t flow_callback;
+    dosing_stats_t stats;
+} dosing;
+
+static void make_key(char *key, size_t size, uint8_t pump) {
+    snprintf(key, size, "%s%u", SETTINGS_KEY_DOSING_CAL_PREFIX, pump);
+}
+
+static bool curve_is_valid(const dosing_cal_point_t *points, uint32_t count) {
+    if (count > DOSING_CAL_MAX_POINTS) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        if (points[i].ul_per_rev == 0 || (i > 0 && points[i].speed_hz <= points[i - 1].speed_hz)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Volume per revolution at a speed, Q8 (uL/rev * 256)
+static uint32_t curve_ul_per_rev_q8(const dosing_curve_t *curve, uint32_t speed_hz) {
+    const dosing_cal_point_t *p = curve->points;
+    uint32_t n = curve->count;
+
+    if (n == 0) {
+        return DOSING_DEFAULT_UL_PER_REV << 8;
+    }
+    if (speed_hz <= p[0].speed_hz) {
+        return (uint32_t)p[0].ul_per_rev << 8;
+    }
+    if (speed_hz >= p[n - 1].speed_hz) {
+        return (uint32_t)p[n - 1].ul_per_rev << 8;
+    }
+
+    uint32_t i = 0;
+    while (speed_hz >= p[i + 1].speed_hz) {
+        i++;
+    }
+    int64_t delta = ((int64_t)p[i + 1].ul_per_rev - p[i].ul_per_rev) << 8;
+    int64_t offset = delta * (speed_hz - p[i].speed_hz) / (p[i + 1].speed_hz - p[i].speed_hz);
+    return (uint32_t)(((int64_t)p[i].ul_per_rev << 8) + offset);
+}
+
+// Volume of 'steps' steps on a linear speed ramp, in Q8 uL/rev * steps
+static uint64_t ramp_volume(const dosing_curve_t *curve, int32_t steps, uint32_t f_start, uint32_t f_end) {
+    if (steps <= 0) {
+        return 0;
+    }
+
+    // Midpoint samples of the ramp
+    uint64_t sum = 0;
+    int32_t span = (int32_t)f_end - (int32_t)f_start;
+    for (int32_t k = 0; k < DOSING_RAMP_SAMPLES; k++) {
+        uint32_t f = (uint32_t)((int32_t)f_start + span * (2 * k + 1) / (2 * DOSING_RAMP_SAMPLES));
+        sum += curve_ul_per_rev_q8(curve, f);
+    }
+    return (uint64_t)steps * sum / DOSING_RAMP_SAMPLES;
+}
+
+// Volume of a whole move, following the driver's accelerate/cruise/decelerate profile
+static uint64_t move_volume(const dosing_curve_t *curve, int32_t steps, uint32_t cruise_hz) {
+    int32_t accel = (int32_t)stepper_driver_get_accel_steps(steps);
+    uint32_t min_hz = stepper_driver_get_min_frequency();
+    uint32_t range = cruise_hz - min_hz;
+
+    int32_t accel_steps = steps < accel ? steps : accel;
+    int32_t decel_start = steps - accel > accel ? steps - accel : accel;
+    int32_t decel_steps = steps > decel_start ? steps - decel_start : 0;
+    int32_t cruise_steps = decel_start - accel > 0 ? decel_start - accel : 0;
+
+    uint64_t volume = ramp_volume(curve, accel_steps, min_hz,
+                                  min_hz + (uint32_t)((uint64_t)range * accel_steps / accel));
+    volume += (uint64_t)cruise_steps * curve_ul_per_rev_q8(curve, cruise_hz);
+    volume += ramp_volume(curve, decel_steps,
+                          min_hz + (uint32_t)((uint64_t)range * decel_steps / accel), min_hz);
+    return volume;
+}
+
+// Volume of a planned segment (ramp in, cruise, ramp out)
+static uint64_t segment_volume(const dosing_curve_t *curve, int32_t steps, const stepper_segment_shape_t *shape) {
+    int32_t cruise_steps = steps - shape->accel_steps - shape->decel_steps;
+    uint64_t volume = ramp_volume(curve, shape->accel_steps, shape->entry_hz, shape->peak_hz);
+    if (cruise_steps > 0) {
+        volume += (uint64_t)cruise_steps * curve_ul_per_rev_q8(curve, shape->peak_hz);
+    }
+    volume += ramp_volume(curve, shape->decel_steps, shape->peak_hz, shape->exit_hz);
+    return volume;
+}
+
+// Volume of the first 'done' steps of a planned segment
+static uint64_t segment_prefix_volume(const dosing_curve_t *curve, int32_t steps,
+                                      const stepper_segment_shape_t *shape, int32_t done) {
+    int32_t accel = done < shape->accel_steps ? done : shape->accel_steps;
+    uint32_t accel_hz = shape->accel_steps > 0 ?
+        shape->entry_hz + (uint32_t)((uint64_t)(shape->peak_hz - shape->entry_hz) * accel / shape->accel_steps) :
+        shape->peak_hz;
+    uint64_t volume = ramp_volume(curve, accel, shape->entry_hz, accel_hz);
+
+    int32_t decel_start = steps - shape->decel_steps;
+    int32_t cruise = (done < decel_start ? done : decel_start) - shape->accel_steps;
+    if (cruise > 0) {
+        volume += (uint64_t)cruise * curve_ul_per_rev_q8(curve, shape->peak_hz);
+    }
+
+    int32_t decel = done - decel_start;
+    if (decel > 0) {
+        uint32_t decel_hz = shape->peak_hz -
+            (uint32_t)((uint64_t)(shape->peak_hz - shape->exit_hz) * decel / shape->decel_steps);
+        volume += ramp_volume(curve, decel, shape->peak_hz, decel_hz);
+    }
+    return volume;
+}
+
+// Cruise speed the driver will actually use for a requested speed
+static uint32_t effective_speed(uint32_t speed_hz) {
+    uint32_t min_hz = stepper_driver_get_min_frequency();
+    uint32_t max_hz = stepper_driver_get_max_frequency();
+    if (speed_hz == 0 || speed_hz > max_hz) {
+        return max_hz;
+    }
+    return speed_hz < min_hz ? min_hz : speed_hz;
+}
+
+// Meter reading for a pump, DOSING_FLOW_NONE without a meter
+static uint32_t read_flow(uint8_t pump) {
+    return dosing.flow_callback ? dosing.flow_callback(pump) : DOSING_FLOW_NONE;
+}
+
+// Metered volume of a dose starts counting here
+static void start_flow(uint32_t tag) {
+    dosing.flow_tag = tag;
+    dosing.flow_start_ul = read_flow(dosing.batch[tag].pump);
+    dosing.flow_check_ms = to_ms_since_boot(get_absolute_time());
+}
+
+// Metered volume of the running dose so far, DOSING_FLOW_NONE without a meter
+static uint32_t metered_volume(uint32_t tag) {
+    if (tag != dosing.flow_tag || dosing.flow_start_ul == DOSING_FLOW_NONE) {
+        return DOSING_FLOW_NONE;
+    }
+    uint32_t now_ul = read_flow(dosing.batch[tag].pump);
+    if (now_ul == DOSING_FLOW_NONE) {
+        return DOSING_FLOW_NONE;
+    }
+    return now_ul > dosing.flow_start_ul ? now_ul - dosing.flow_start_ul : 0;
+}
+
+// Route the pump to a dose through the start hook, or close everything (NULL); false if the hook refused
+static bool route(const dosing_request_t *dose) {
+    dosing.routed = dose != NULL;
+    return !dosing.start_callback || dosing.start_callback(dose) || dose == NULL;
+}
+
+// Put a dose back at the head of the queue
+static bool queue_front(const dosing_request_t *dose) {
+    if (dosing.count == DOSING_QUEUE_SIZE) {
+        dosing.stats.dropped++;
+        LOG_STEPPER_ERROR("Dose queue full, dropped %lu uL for zone %u", dose->volume_ul, dose->zone);
+        return false;
+    }
+    dosing.head = (dosing.head + DOSING_QUEUE_SIZE - 1) % DOSING_QUEUE_SIZE;
+    dosing.queue[dosing.head] = *dose;
+    dosing.queue[dosing.head].steps = 0;
+    dosing.count++;
+    return true;
+}
+
+// Queue the interrupted dose's remainder and the doses behind it again, in order
+static void requeue_after_stall(uint32_t tag) {
+    int32_t start = 0;
+    for (uint32_t i = 0; i < tag; i++) {
+        start += dosing.batch[i].steps;
+    }
+
+    for (uint32_t i = dosing.batch_count; i-- > tag + 1;) {
+        queue_front(&dosing.batch[i]);
+    }
+
+    // Steps up to the stall position count as delivered (along the planned profile), the rest is pumped again
+    dosing_request_t *dose = &dosing.batch[tag];
+    int32_t done = dosing.retry_position - start;
+    if (done < 0) done = 0;
+    if (done > dose->steps) done = dose->steps;
+    uint32_t delivered = (uint32_t)((uint64_t)dose->volume_ul * (uint32_t)done / (uint32_t)dose->steps);
+    uint32_t metered = metered_volume(tag);
+    stepper_segment_shape_t shape;
+    if (metered != DOSING_FLOW_NONE) {
+        // The meter saw what actually went through
+        delivered = metered < dose->volume_ul ? metered : dose->volume_ul;
+    } else if (stepper_planner_get_shape(tag, &shape)) {
+        uint64_t volume = segment_prefix_volume(&dosing.curves[dose->pump], dose->steps, &shape, done);
+        delivered = (uint32_t)((volume + Q8_PER_STEP_DIVISOR / 2) / Q8_PER_STEP_DIVISOR);
+        if (delivered > dose->volume_ul) {
+            delivered = dose->volume_ul;
+        }
+    }
+    dosing.stats.dispensed_ul += delivered;
+    dose->volume_ul -= delivered;
+    if (dosing.retry_speed_hz != 0 && dosing.retry_speed_hz < dose->speed_hz) {
+        dose->speed_hz = dosing.retry_speed_hz;
+    }
+    if (dose->volume_ul > 0) {
+        queue_front(dose);
+    }
+
+    dosing.stats.retried++;
+    LOG_STEPPER_WARN("Pump stalled in dose for zone %u, %lu uL queued again at %lu Hz (retry %lu)",
+                     dose->zone, dose->volume_ul, dose->speed_hz, dosing.retries);
+}
+
+// The start hook could not route the pump to a dose: drop it, queue the doses behind it again
+static void drop_unroutable(uint32_t tag) {
+    for (uint32_t i = dosing.batch_count; i-- > tag + 1;) {
+        queue_front(&dosing.batch[i]);
+    }
+    dosing.stats.aborted++;
+    LOG_STEPPER_ERROR("Zone %u could not be routed, dose of %lu uL dropped",
+                      dosing.batch[tag].zone, dosing.batch[tag].volume_ul);
+}
+
+// Planner hand-over: one dose ended, the next one (if any) starts
+static void dosing_segment_callback(uint32_t tag, bool completed) {
+    if (tag >= dosing.batch_count) {
+        return;
+    }
+    const dosing_request_t *dose = &dosing.batch[tag];
+
+    if (!completed && dosing.retry_pending) {
+        dosing.retry_pending = false;
+        dosing.active = false;
+        requeue_after_stall(tag);
+        route(NULL);
+        return;
+    }
+
+    if (!completed && dosing.unroutable) {
+        dosing.unroutable = false;
+        dosing.active = false;
+        drop_unroutable(tag);
+        route(NULL);
+        return;
+    }
+
+    if (!completed) {
+        // Stopped by hand or replaced by a manual move - do not keep pumping behind the user's back
+        dosing.stats.aborted++;
+        LOG_STEPPER_WARN("Dose aborted: pump %u, zone %u", dose->pump, dose->zone);
+        dosing.active = false;
+        dosing_cancel();
+        route(NULL);
+        return;
+    }
+
+    dosing.stats.completed++;
+    dosing.stats.dispensed_ul += dose->volume_ul;
+    LOG_STEPPER_INFO("Dose complete: pump %u, zone %u, %lu uL", dose->pump, dose->zone, dose->volume_ul);
+
+    if (tag + 1 < dosing.batch_count) {
+        // The motor keeps turning into the next dose; a new zone was routed on its first step already
+        dosing.stats.back_to_back++;
+        start_flow(tag + 1);
+    } else {
+        // The pump has stopped; a dose for another zone is routed when its sequence starts
+        dosing.active = false;
+        dosing.retries = 0;
+        if (dosing.count == 0) {
+            route(NULL);
+        }
+    }
+}
+
+// A dose for another zone starts (step interrupt, on its first step): switch the valve while the pump turns.
+// If it does not switch, the sequence stops right there and the planner reports it
+static bool dosing_mark_callback(uint32_t tag) {
+    if (tag >= dosing.batch_count || route(&dosing.batch[tag])) {
+        return true;
+    }
+    dosing.unroutable = true;
+    return false;
+}
+
+void dosing_init(void) {
+    memset(&dosing, 0, sizeof(dosing));
+
+    // Load persisted calibration curves
+    for (uint8_t pump = 0; pump < DOSING_MAX_PUMPS; pump++) {
+        char key[SETTINGS_MAX_KEY_LENGTH + 1];
+        make_key(key, sizeof(key), pump);
+
+        dosing_curve_t *curve = &dosing.curves[pump];
+        int length = settings_get(key, curve->points, sizeof(curve->points));
+        if (length <= 0) {
+            continue;
+        }
+        curve->count = (uint32_t)length / sizeof(dosing_cal_point_t);
+        if (!curve_is_valid(curve->points, curve->count)) {
+            LOG_STEPPER_WARN("Pump %u calibration invalid, using default", pump);
+            curve->count = 0;
+        }
+    }
+
+    dosing.zone_count = UINT8_MAX + 1;
+    stepper_planner_set_segment_callback(dosing_segment_callback);
+    stepper_planner_set_mark_callback(dosing_mark_callback);
+    LOG_STEPPER_INFO("Dosing initialized (%d pumps, queue of %d)", DOSING_MAX_PUMPS, DOSING_QUEUE_SIZE);
+}
+
+void dosing_set_start_callback(dosing_start_cb_t callback) {
+    dosing.start_callback = callback;
+}
+
+void dosing_set_zone_count(uint32_t count) {
+    dosing.zone_count = count;
+}
+
+void dosing_set_flow_callback(dosing_flow_cb_t callback) {
+    dosing.flow_callback = callback;
+}
+
+bool dosing_set_calibration(uint8_t pump, const dosing_cal_point_t *points, uint32_t count) {
+    if (pump >= DOSING_MAX_PUMPS || !curve_is_valid(points, count)) {
+        LOG_STEPPER_ERROR("Rejected calibration for pump %u", pump);
+        return false;
+    }
+
+    dosing_curve_t *curve = &dosing.curves[pump];
+    memcpy(curve->points, points, count * sizeof(dosing_cal_point_t));
+    curve->count = count;
+
+    char key[SETTINGS_MAX_KEY_LENGTH + 1];
+    make_key(key, sizeof(key), pump);
+    if (count == 0) {
+        return settings_delete(key);
+    }
+    return settings_set(key, points, count * sizeof(dosing_cal_point_t));
+}
+
+uint32_t dosing_get_calibration(uint8_t pump, dosing_cal_point_t *points, uint32_t max_points) {
+    if (pump >= DOSING_MAX_PUMPS) {
+        return 0;
+    }
+    const dosing_curve_t *curve = &dosing.curves[pump];
+    uint32_t count = curve->count < max_points ? curve->count : max_points;
+    memcpy(points, curve->points, count * sizeof(dosing_cal_point_t));
+    return count;
+}
+
+bool dosing_calibrate(uint8_t pump, uint32_t speed_hz, int32_t steps, uint32_t measured_ul) {
+    if (pump >= DOSING_MAX_PUMPS || steps <= 0 || speed_hz == 0 || speed_hz > UINT16_MAX) {
+        return false;
+    }
+
+    uint64_t ul_per_rev = ((uint64_t)measured_ul * STEPPER_STEPS_PER_REV + steps / 2) / steps;
+    if (ul_per_rev == 0 || ul_per_rev > UINT16_MAX) {
+        LOG_STEPPER_ERROR("Pump %u calibration out of range: %llu uL/rev", pump, ul_per_rev);
+        return false;
+    }
+
+    dosing_cal_point_t points[DOSING_CAL_MAX_POINTS];
+    uint32_t count = dosing_get_calibration(pump, points, DOSING_CAL_MAX_POINTS);
+    dosing_cal_point_t point = { (uint16_t)speed_hz, (uint16_t)ul_per_rev };
+
+    // Replace the nearest point if it is close or the table is full, otherwise insert
+    uint32_t nearest = 0;
+    uint32_t nearest_distance = UINT32_MAX;
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t distance = points[i].speed_hz > speed_hz ? points[i].speed_hz - speed_hz
+                                                          : speed_hz - points[i].speed_hz;
+        if (distance < nearest_distance) {
+            nearest = i;
+            nearest_distance = distance;
+        }
+    }
+
+    if (count > 0 && (nearest_distance <= CAL_MERGE_HZ || count == DOSING_CAL_MAX_POINTS)) {
+        // Remove it, then insert below to keep the table sorted
+        memmove(&points[nearest], &points[nearest + 1], (count - nearest - 1) * sizeof(point));
+        count--;
+    }
+
+    uint32_t pos = 0;
+    while (pos < count && points[pos].speed_hz < speed_hz) {
+        pos++;
+    }
+    memmove(&points[pos + 1], &points[pos], (count - pos) * sizeof(point));
+    points[pos] = point;
+    count++;
+
+    LOG_STEPPER_INFO("Pump %u calibrated: %lu uL/rev at %lu Hz", pump, (uint32_t)ul_per_rev, speed_hz);
+    return dosing_set_calibration(pump, points, count);
+}
+
+uint32_t dosing_ul_per_rev(uint8_t pump, uint32_t speed_hz) {
+    if (pump >= DOSING_MAX_PUMPS) {
+        return 0;
+    }
+    return curve_ul_per_rev_q8(&dosing.curves[pump], speed_hz) >> 8;
+}
+
+uint32_t dosing_steps_to_ul(uint8_t pump, int32_t steps, uint32_t speed_hz) {
+    if (pump >= DOSING_MAX_PUMPS || steps <= 0) {
+        return 0;
+    }
+    uint64_t volume = move_volume(&dosing.curves[pump], steps, effective_speed(speed_hz));
+    return (uint32_t)((volume + Q8_PER_STEP_DIVISOR / 2) / Q8_PER_STEP_DIVISOR);
+}
+
+int32_t dosing_ul_to_steps(uint8_t pump, uint32_t volume_ul, uint32_t speed_hz) {
+    if (pump >= DOSING_MAX_PUMPS || volume_ul == 0) {
+        return 0;
+    }
+
+    const dosing_curve_t *curve = &dosing.curves[pump];
+    uint32_t cruise_hz = effective_speed(speed_hz);
+    uint64_t target = (uint64_t)volume_ul * Q8_PER_STEP_DIVISOR;
+
+    // Upper bound from the smallest volume per revolution anywhere on the curve
+    uint32_t min_rate = DOSING_DEFAULT_UL_PER_REV;
+    for (uint32_t i = 0; i < curve->count; i++) {
+        if (i == 0 || curve->points[i].ul_per_rev < min_rate) {
+            min_rate = curve->points[i].ul_per_rev;
+        }
+    }
+    uint64_t hi = (uint64_t)volume_ul * STEPPER_STEPS_PER_REV / min_rate + 1;
+    if (hi > INT32_MAX) {
+        hi = INT32_MAX;
+    }
+
+    // Smallest step count that delivers at least the volume
+    int32_t lo = 1;
+    int32_t high = (int32_t)hi;
+    while (lo < high) {
+        int32_t mid = lo + (high - lo) / 2;
+        if (move_volume(curve, mid, cruise_hz) >= target) {
+            high = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+
+    // Pick whichever neighbour is closer
+    if (lo > 1) {
+        uint64_t above = move_volume(curve, lo, cruise_hz) - target;
+        uint64_t below = target - move_volume(curve, lo - 1, cruise_hz);
+        if (below < above) {
+            lo--;
+        }
+    }
+    return lo;
+}
+
+bool dosing_queue(uint8_t pump, uint8_t zone, uint32_t volume_ul, uint32_t speed_hz) {
+    if (pump >= DOSING_MAX_PUMPS || zone >= dosing.zone_count || volume_ul == 0) {
+        return false;
+    }
+    if (dosing.count == DOSING_QUEUE_SIZE) {
+        dosing.stats.dropped++;
+        LOG_STEPPER_ERROR("Dose queue full, dropped %lu uL for zone %u", volume_ul, zone);
+        return false;
+    }
+
+    dosing_request_t *dose = &dosing.queue[(dosing.head + dosing.count) % DOSING_QUEUE_SIZE];
+    dose->pump = pump;
+    dose->zone = zone;
+    dose->volume_ul = volume_ul;
+    dose->speed_hz = speed_hz;
+    dose->steps = 0;
+    dosing.count++;
+    dosing.stats.queued++;
+    return true;
+}
+
+void dosing_cancel(void) {
+    if (dosing.count > 0) {
+        LOG_STEPPER_WARN("Cancelled %lu queued doses", dosing.count);
+    }
+    dosing.count = 0;
+}
+
+bool dosing_stall(int32_t position, uint32_t speed_hz) {
+    if (!dosing.active || !stepper_planner_is_running() || dosing.retries >= DOSING_MAX_RETRIES) {
+        dosing.retries = 0;
+        return false;
+    }
+
+    // The planner reports the stop through the segment callback, which queues the rest again
+    dosing.retries++;
+    dosing.retry_pending = true;
+    dosing.retry_position = position;
+    dosing.retry_speed_hz = speed_hz;
+    stepper_driver_stop();
+    return true;
+}
+
+bool dosing_is_busy(void) {
+    return dosing.active || dosing.count > 0;
+}
+
+uint32_t dosing_get_queue_length(void) {
+    return dosing.count;
+}
+
+// Compare the metered volume with the curve's prediction and rescale the rest of the running dose
+static void correct_flow(void) {
+    uint32_t now_ms = to_ms_since_boot(get_absolute_time());
+    if (now_ms - dosing.flow_check_ms < DOSING_FLOW_CHECK_MS) {
+        return;
+    }
+    dosing.flow_check_ms = now_ms;
+
+    uint32_t tag;
+    int32_t done;
+    stepper_segment_shape_t shape;
+    if (!stepper_planner_get_progress(&tag, &done) || tag >= dosing.batch_count ||
+        !stepper_planner_get_shape(tag, &shape)) {
+        return;
+    }
+    uint32_t metered = metered_volume(tag);
+    if (metered == DOSING_FLOW_NONE) {
+        return;
+    }
+
+    // Wait until the meter has seen enough pulses to mean something
+    dosing_request_t *dose = &dosing.batch[tag];
+    const dosing_curve_t *curve = &dosing.curves[dose->pump];
+    uint32_t predicted = (uint32_t)(segment_prefix_volume(curve, dose->steps, &shape, done) / Q8_PER_STEP_DIVISOR);
+    uint32_t min_ul = dose->volume_ul * DOSING_FLOW_MIN_PERCENT / 100;
+    if (predicted == 0 || predicted < DOSING_FLOW_MIN_UL || predicted < min_ul) {
+        return;
+    }
+
+    if ((uint64_t)metered * 100 < (uint64_t)predicted * DOSING_FLOW_DRY_PERCENT) {
+        // The planner reports the stop, which aborts the sequence
+        dosing.stats.flow_faults++;
+        LOG_STEPPER_ERROR("Pump %u running dry: %lu uL metered, %lu uL expected - stopping",
+                          dose->pump, metered, predicted);
+        stepper_driver_stop();
+        return;
+    }
+
+    // Remaining steps scaled by what is still missing over what they would deliver at the metered rate
+    uint64_t planned_total = segment_volume(curve, dose->steps, &shape) / Q8_PER_STEP_DIVISOR;
+    uint64_t predicted_rest = planned_total > predicted ? planned_total - predicted : 0;
+    uint64_t missing = dose->volume_ul > metered ? dose->volume_ul - metered : 0;
+    uint64_t delivering = predicted_rest * metered / predicted;
+    int32_t rest = dose->steps - done;
+    int32_t steps = delivering > 0 ? done + (int32_t)((uint64_t)rest * missing / delivering) : dose->steps;
+
+    int32_t planned = dosing.planned_steps[tag];
+    int32_t limit = (int32_t)((int64_t)planned * DOSING_FLOW_MAX_CORRECTION_PERCENT / 100);
+    if (steps > planned + limit) steps = planned + limit;
+    if (steps < planned - limit) steps = planned - limit;
+    int32_t change = steps - dose->steps;
+    if (change < DOSING_FLOW_DEADBAND_STEPS && change > -DOSING_FLOW_DEADBAND_STEPS) {
+        return;
+    }
+
+    // Refused once the dose is on its final ramp - too late to matter
+    if (stepper_planner_adjust_steps(tag, steps)) {
+        LOG_STEPPER_DEBUG("Pump %u: %lu uL metered vs %lu uL expected, dose now %ld steps (was %ld)",
+                          dose->pump, metered, predicted, steps, dose->steps);
+        dose->steps = steps;
+        dosing.stats.corrections++;
+    }
+}
+
+void dosing_process(void) {
+    if (dosing.active) {
+        if (stepper_planner_is_running()) {
+            correct_flow();
+        }
+        return;
+    }
+
+    if (dosing.count == 0) {
+        if (dosing.holding) {
+            stepper_driver_hold_enable(false);
+            dosing.holding = false;
+        }
+        if (dosing.routed) {
+            route(NULL);        // Queue cancelled between sequences
+        }
+        return;
+    }
+
+    // Wait for a manual move to finish
+    if (stepper_driver_is_running() || stepper_planner_is_running()) {
+        return;
+    }
+
+    // Doses for the same pump run as one blended sequence; zone valves switch on the exact step in between
+    stepper_planner_clear();
+    dosing.batch_count = 0;
+    while (dosing.count > 0 && dosing.batch_count < STEPPER_PLANNER_MAX_SEGMENTS) {
+        const dosing_request_t *next = &dosing.queue[dosing.head];
+        if (dosing.batch_count > 0 && next->pump != dosing.batch[0].pump) {
+            break;
+        }
+        dosing_request_t *dose = &dosing.batch[dosing.batch_count];
+        *dose = dosing.queue[dosing.head];
+        dosing.head = (dosing.head + 1) % DOSING_QUEUE_SIZE;
+        dosing.count--;
+
+        // Standalone conversion as the first guess
+        dose->speed_hz = effective_speed(dose->speed_hz);
+        dose->steps = dosing_ul_to_steps(dose->pump, dose->volume_ul, dose->speed_hz);
+        if (dose->steps > 0 && stepper_planner_add(dose->steps, dose->speed_hz, dosing.batch_count)) {
+            dosing.batch_count++;
+        }
+    }
+    if (dosing.batch_count == 0) {
+        return;
+    }
+
+    // Blending changes the ramps each dose sees, so rescale the step counts to the planned shapes
+    for (int iteration = 0; iteration < DOSING_PLAN_ITERATIONS; iteration++) {
+        stepper_segment_shape_t shapes[STEPPER_PLANNER_MAX_SEGMENTS];
+        stepper_planner_plan();
+        for (uint32_t i = 0; i < dosing.batch_count; i++) {
+            stepper_planner_get_shape(i, &shapes[i]);
+        }
+        for (uint32_t i = 0; i < dosing.batch_count; i++) {
+            dosing_request_t *dose = &dosing.batch[i];
+            uint64_t volume = segment_volume(&dosing.curves[dose->pump], dose->steps, &shapes[i]);
+            uint64_t target = (uint64_t)dose->volume_ul * Q8_PER_STEP_DIVISOR;
+            int32_t steps = (int32_t)(((uint64_t)dose->steps * target + volume / 2) / volume);
+            dose->steps = steps > 0 ? steps : 1;
+            stepper_planner_set_steps(i, dose->steps);
+        }
+    }
+    stepper_planner_plan();
+    for (uint32_t i = 0; i < dosing.batch_count; i++) {
+        dosing.planned_steps[i] = dosing.batch[i].steps;
+        if (i > 0 && dosing.batch[i].zone != dosing.batch[i - 1].zone) {
+            stepper_planner_mark(i);
+        }
+    }
+
+    if (!route(&dosing.batch[0])) {
+        drop_unroutable(0);
+        stepper_planner_clear();
+        route(NULL);
+        return;
+    }
+    start_flow(0);
+
+    if (dosing.holding) {
+        dosing.stats.back_to_back++;
+    } else {
+        stepper_driver_hold_enable(true);
+        dosing.holding = true;
+    }
+
+    LOG_STEPPER_INFO("Dosing %lu doses in one sequence, first %lu uL on pump %u for zone %u",
+                     dosing.batch_count, dosing.batch[0].volume_ul, dosing.batch[0].pump, dosing.batch[0].zone);
+    dosing.unroutable = false;
+    dosing.active = stepper_planner_start();
+}
+
+void dosing_get_stats(dosing_stats_t *stats) {
+    *stats = dosing.stats;
+}
+
+void dosing_dump(void) {
+    printf("DOSE begin queued=%lu completed=%lu aborted=%lu dropped=%lu back_to_back=%lu retried=%lu dispensed_ul=%llu pending=%lu\n",
+           dosing.stats.queued, dosing.stats.completed, dosing.stats.aborted, dosing.stats.dropped,
+           dosing.stats.back_to_back, dosing.stats.retried, dosing.stats.dispensed_ul, dosing.count);
+
+    uint32_t blended_ms, separate_ms;
+    stepper_planner_get_estimate(&blended_ms, &separate_ms);
+    printf("DOSE plan doses=%lu blended_ms=%lu separate_ms=%lu\n", dosing.batch_count, blended_ms, separate_ms);
+    printf("DOSE flow meter=%d corrections=%lu flow_faults=%lu\n",
+           dosing.flow_callback != NULL, dosing.stats.corrections, dosing.stats.flow_faults);
+
+    for (uint8_t pump = 0; pump < DOSING_MAX_PUMPS; pump++) {
+        const dosing_curve_t *curve = &dosing.curves[pump];
+        printf("DOSE pump=%u points=%lu", pump, curve->count);
+        for (uint32_t i = 0; i < curve->count; i++) {
+            printf(" %u:%u", curve->points[i].speed_hz, curve->points[i].ul_per_rev);
+        }
+        printf("\n");
+    }
+
+    for (uint32_t i = 0; i < dosing.count; i++) {
+        const dosing_request_t *dose = &dosing.queue[(dosing.head + i) % DOSING_QUEUE_SIZE];
+        printf("DOSE queue pump=%u zone=%u volume_ul=%lu speed_hz=%lu\n",
+               dose->pump, dose->zone, dose->volume_ul, dose->speed_hz);
+    }
+    printf("DOSE end\n");
+}
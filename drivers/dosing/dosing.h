@@ -0,0 +1,137 @@
+/**
+ * PicoFlora Volumetric Dosing
+ *
+ * Converts millilitres to stepper moves for the peristaltic pumps. The volume
+ * per revolution of a peristaltic pump depends on speed and tubing wear, so
+ * every pump has a calibration curve: a small table of (speed, uL/rev) points
+ * with linear interpolation in between, stored as integers and persisted in
+ * the settings store. The conversion follows the driver's ramp profile, so
+ * the slower acceleration and deceleration steps are accounted for.
+ *
+ * Doses are queued in a FIFO. dosing_process() hands consecutive doses for
+ * the same pump to the move planner as one blended sequence, so the pump
+ * keeps its cruise speed from one dose to the next (also into another zone),
+ * and refines each dose's step count against the planned profile. A dose for
+ * another pump starts a new sequence once the pump has stopped. The driver
+ * stays enabled until the queue is empty, so only the first dose pays for
+ * the enable settle time.
+ *
+ * When the pump stalls, dosing_stall() stops the sequence and queues the
+ * undelivered volume again at the front, at the cruise speed the caller
+ * gives, so it is retried slower instead of being lost. Other doses keep
+ * their own speeds.
+ *
+ * With a flow meter on a pump's line (dosing_set_flow_callback), the dose is
+ * closed-loop: while it runs, the metered volume is compared with what the
+ * curve predicts for the steps done so far, and the remaining steps are
+ * rescaled mid-move so the dose ends on the metered volume (worn tubing, a
+ * stale calibration). Far too little flow means the pump is running dry or
+ * pumping air, and the sequence is stopped instead.
+ *
+ * All pumps share the single stepper driver; the start hook is called when
+ * each dose begins so the caller can route it (pump select, zone valve).
+ * For the first dose of a sequence that is before the pump starts. A dose
+ * for another zone within a sequence is a planner mark: the hook runs from
+ * the step interrupt right after the last step of the dose before, so the
+ * valves switch on the exact step while the pump turns, and has to be safe
+ * there (the zone manager's I2C is, see bsp_i2c_share_with_irq()). If the
+ * hook cannot route a dose, that dose is dropped: a first dose never starts
+ * the pump, a later one stops the sequence on its first step. The doses
+ * behind it are queued again. The hook is called with NULL once the pump
+ * has stopped and nothing is left to dose, so everything can be closed
+ * again.
+ */
+
+#ifndef DOSING_H
+#define DOSING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Configuration
+#define DOSING_MAX_PUMPS 4
+#define DOSING_CAL_MAX_POINTS 8             // Fits one settings value (8 x 4 bytes)
+#define DOSING_QUEUE_SIZE 16
+#define DOSING_DEFAULT_UL_PER_REV 1000      // Uncalibrated pump: 1 mL/rev at any speed
+#define DOSING_RAMP_SAMPLES 8               // Curve samples per ramp when converting volumes
+#define DOSING_PLAN_ITERATIONS 2            // Step count refinements against the blended profile
+#define DOSING_MAX_RETRIES 3                // Stall retries per sequence before the doses are dropped
+#define DOSING_FLOW_CHECK_MS 100            // Closed-loop correction interval
+#define DOSING_FLOW_MIN_UL 1000             // Predicted volume before the first correction (several meter pulses)
+#define DOSING_FLOW_MIN_PERCENT 20          // ... and at least this share of the dose
+#define DOSING_FLOW_DRY_PERCENT 30          // Metered below this share of the prediction = dry run, stop
+#define DOSING_FLOW_MAX_CORRECTION_PERCENT 50  // Step count stays within this of the plan
+#define DOSING_FLOW_DEADBAND_STEPS 32       // Smaller corrections are not applied
+#define DOSING_FLOW_NONE UINT32_MAX         // Flow callback result: no meter on this pump
+
+// Calibration point: volume per revolution at one cruise speed
+typedef struct {
+    uint16_t speed_hz;
+    uint16_t ul_per_rev;
+} dosing_cal_point_t;
+
+// Queued dose
+typedef struct {
+    uint8_t pump;
+    uint8_t zone;
+    uint32_t volume_ul;
+    uint32_t speed_hz;          // Cruise speed, 0 = driver maximum
+    int32_t steps;              // Filled in when the dose starts
+} dosing_request_t;
+
+// Dosing statistics
+typedef struct {
+    uint32_t queued;
+    uint32_t completed;
+    uint32_t aborted;           // Stopped externally or displaced by a manual move
+    uint32_t dropped;           // Rejected because the queue was full
+    uint32_t back_to_back;      // Doses started without re-enabling the driver
+    uint32_t retried;           // Doses queued again after a stall
+    uint32_t corrections;       // Closed-loop step count changes
+    uint32_t flow_faults;       // Sequences stopped for too little metered flow
+    uint64_t dispensed_ul;
+} dosing_stats_t;
+
+// Hook called as each dose starts, and with NULL once the pump has stopped with nothing left to dose.
+// False if the dose could not be routed (e.g. its zone valve did not open); ignored for NULL.
+typedef bool (*dosing_start_cb_t)(const dosing_request_t *dose);
+
+// Metered volume on a pump's line in uL, counting up, or DOSING_FLOW_NONE
+typedef uint32_t (*dosing_flow_cb_t)(uint8_t pump);
+
+// Initialization - loads the calibration curves from the settings store
+void dosing_init(void);
+void dosing_set_start_callback(dosing_start_cb_t callback);
+// Doses may only go to zones below 'count' (any uint8_t zone until set)
+void dosing_set_zone_count(uint32_t count);
+void dosing_set_flow_callback(dosing_flow_cb_t callback);
+
+// Calibration
+bool dosing_set_calibration(uint8_t pump, const dosing_cal_point_t *points, uint32_t count);
+uint32_t dosing_get_calibration(uint8_t pump, dosing_cal_point_t *points, uint32_t max_points);
+// Record a measured run: 'steps' at 'speed_hz' delivered 'measured_ul' (use long runs)
+bool dosing_calibrate(uint8_t pump, uint32_t speed_hz, int32_t steps, uint32_t measured_ul);
+
+// Conversion using the pump's curve and the driver's ramp profile
+uint32_t dosing_ul_per_rev(uint8_t pump, uint32_t speed_hz);
+uint32_t dosing_steps_to_ul(uint8_t pump, int32_t steps, uint32_t speed_hz);
+int32_t dosing_ul_to_steps(uint8_t pump, uint32_t volume_ul, uint32_t speed_hz);
+
+// Queue
+bool dosing_queue(uint8_t pump, uint8_t zone, uint32_t volume_ul, uint32_t speed_hz);
+void dosing_cancel(void);                   // Drop queued doses, the running sequence finishes
+// Stop the running sequence after a stall; what was not delivered before sequence step
+// 'position' is queued again, at no more than 'speed_hz' (0 = unchanged)
+// (false = nothing running or out of retries, nothing stopped)
+bool dosing_stall(int32_t position, uint32_t speed_hz);
+bool dosing_is_busy(void);
+uint32_t dosing_get_queue_length(void);
+
+// Run the queue (call from the main loop after stepper_planner_process)
+void dosing_process(void);
+
+// Diagnostics
+void dosing_get_stats(dosing_stats_t *stats);
+void dosing_dump(void);
+
+#endif // DOSING_H
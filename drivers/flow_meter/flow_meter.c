@@ -0,0 +1,247 @@
+/**
+ * PicoFlora Flow Meter Implementation
+ */
+
+#include "flow_meter.h"
+#include "flow_meter.pio.h"
+#include "pico/stdlib.h"
+#include "hardware/pio.h"
+#include "hardware/dma.h"
+#include "hardware/clocks.h"
+#include "../logging/logging.h"
+#include <stdio.h>
+
+#define FLOW_METER_PIO pio0
+#define RING_BYTES (FLOW_METER_RING_SIZE * sizeof(uint32_t))
+#define RING_BITS 10                        // log2(RING_BYTES), for the DMA address wrap
+
+_Static_assert((1u << RING_BITS) == RING_BYTES, "RING_BITS must match FLOW_METER_RING_SIZE");
+
+// Per-sensor state
+typedef struct {
+    bool active;
+    uint32_t pin;
+    uint sm;
+    int dma_channel;
+    uint32_t read_index;                // Next ring slot to process
+    uint32_t ul_per_pulse_q16;
+
+    uint32_t periods[FLOW_METER_AVERAGE];
+    uint32_t period_count;
+    uint32_t period_sum;
+    uint32_t last_pulse_ms;             // When processing saw the latest pulse
+
+    flow_meter_stats_t stats;
+} flow_channel_t;
+
+// Sample rings, aligned for the DMA write address wrap
+static uint32_t rings[FLOW_METER_MAX_CHANNELS][FLOW_METER_RING_SIZE] __attribute__((aligned(RING_BYTES)));
+
+static flow_channel_t channels[FLOW_METER_MAX_CHANNELS];
+static int program_offset = -1;
+
+uint32_t flow_meter_ul_per_pulse_q16(uint32_t pulses_per_litre) {
+    if (pulses_per_litre == 0) {
+        return 0;
+    }
+    return (uint32_t)((1000000ull << 16) / pulses_per_litre);
+}
+
+uint32_t flow_meter_period_to_flow(uint32_t period_cycles, uint32_t clock_hz, uint32_t ul_per_pulse_q16) {
+    if (period_cycles == 0) {
+        return 0;
+    }
+    // uL/s = uL per pulse * pulses per second
+    return (uint32_t)(((uint64_t)ul_per_pulse_q16 * clock_hz / period_cycles) >> 16);
+}
+
+bool flow_meter_init(uint32_t channel, uint32_t pin, uint32_t pulses_per_litre) {
+    if (channel >= FLOW_METER_MAX_CHANNELS || channels[channel].active || pulses_per_litre == 0) {
+        return false;
+    }
+    flow_channel_t *ch = &channels[channel];
+    LOG_HW_INFO("Initializing flow meter %lu on GPIO %lu (%lu pulses/L)", channel, pin, pulses_per_litre);
+
+    if (program_offset < 0) {
+        if (!pio_can_add_program(FLOW_METER_PIO, &flow_period_program)) {
+            LOG_HW_ERROR("Cannot add flow meter PIO program - insufficient space!");
+            return false;
+        }
+        program_offset = pio_add_program(FLOW_METER_PIO, &flow_period_program);
+    }
+
+    int sm = pio_claim_unused_sm(FLOW_METER_PIO, false);
+    if (sm < 0) {
+        LOG_HW_ERROR("No free PIO state machine for flow meter %lu", channel);
+        return false;
+    }
+    int dma_channel = dma_claim_unused_channel(false);
+    if (dma_channel < 0) {
+        pio_sm_unclaim(FLOW_METER_PIO, (uint)sm);
+        LOG_HW_ERROR("No free DMA channel for flow meter %lu", channel);
+        return false;
+    }
+
+    ch->pin = pin;
+    ch->sm = (uint)sm;
+    ch->dma_channel = dma_channel;
+    ch->read_index = 0;
+    ch->ul_per_pulse_q16 = flow_meter_ul_per_pulse_q16(pulses_per_litre);
+    ch->period_count = 0;
+    ch->period_sum = 0;
+    ch->last_pulse_ms = 0;
+    ch->stats = (flow_meter_stats_t){ .min_period_cycles = UINT32_MAX };
+
+    flow_period_program_init(FLOW_METER_PIO, ch->sm, (uint)program_offset, pin);
+
+    // RX FIFO -> ring, paced by the state machine, wrapping forever
+    dma_channel_config config = dma_channel_get_default_config((uint)dma_channel);
+    channel_config_set_transfer_data_size(&config, DMA_SIZE_32);
+    channel_config_set_read_increment(&config, false);
+    channel_config_set_write_increment(&config, true);
+    channel_config_set_ring(&config, true, RING_BITS);
+    channel_config_set_dreq(&config, pio_get_dreq(FLOW_METER_PIO, ch->sm, false));
+    dma_channel_configure((uint)dma_channel, &config, rings[channel], &FLOW_METER_PIO->rxf[ch->sm],
+                          dma_encode_endless_transfer_count(), true);
+
+    pio_sm_set_enabled(FLOW_METER_PIO, ch->sm, true);
+    ch->active = true;
+
+    LOG_HW_INFO("Flow meter %lu ready (PIO0 SM%u, DMA %d, %lu uL/pulse)",
+                channel, ch->sm, dma_channel, ch->ul_per_pulse_q16 >> 16);
+    return true;
+}
+
+bool flow_meter_is_active(uint32_t channel) {
+    return channel < FLOW_METER_MAX_CHANNELS && channels[channel].active;
+}
+
+static void add_period(flow_channel_t *ch, uint32_t period_cycles) {
+    uint32_t slot = ch->stats.pulses % FLOW_METER_AVERAGE;
+    if (ch->period_count == FLOW_METER_AVERAGE) {
+        ch->period_sum -= ch->periods[slot];
+    } else {
+        ch->period_count++;
+    }
+    ch->periods[slot] = period_cycles;
+    ch->period_sum += period_cycles;
+
+    ch->stats.pulses++;
+    ch->stats.last_period_cycles = period_cycles;
+    if (period_cycles < ch->stats.min_period_cycles) {
+        ch->stats.min_period_cycles = period_cycles;
+    }
+    if (period_cycles > ch->stats.max_period_cycles) {
+        ch->stats.max_period_cycles = period_cycles;
+    }
+}
+
+static void process_channel(flow_channel_t *ch, uint32_t now_ms) {
+    // The DMA write pointer says how far the ring has been filled
+    uint32_t write_addr = (uint32_t)dma_channel_hw_addr((uint)ch->dma_channel)->write_addr;
+    uint32_t write_index = (write_addr - (uint32_t)(uintptr_t)rings[ch - channels]) / sizeof(uint32_t);
+    if (write_index == ch->read_index) {
+        return;
+    }
+
+    // A full lap looks like an empty ring; at 256 samples that is far more than a loop pass collects
+    uint32_t *ring = rings[ch - channels];
+    while (ch->read_index != write_index) {
+        uint32_t count = ring[ch->read_index];
+        ch->read_index = (ch->read_index + 1) % FLOW_METER_RING_SIZE;
+
+        if (count == FLOW_PERIOD_IDLE) {
+            // Idle marker; the next sample is the first edge after it
+            ch->stats.timeouts++;
+            ch->period_count = 0;
+            ch->period_sum = 0;
+            continue;
+        }
+        if (count == FLOW_PERIOD_FIRST_EDGE) {
+            // A pulse like any other, only without a period; the rate starts afresh from it
+            ch->stats.pulses++;
+            ch->period_count = 0;
+            ch->period_sum = 0;
+            continue;
+        }
+        add_period(ch, 2 * count + FLOW_PERIOD_OVERHEAD_CYCLES);
+    }
+    ch->last_pulse_ms = now_ms;
+}
+
+void flow_meter_process(void) {
+    uint32_t now_ms = to_ms_since_boot(get_absolute_time());
+    for (uint32_t i = 0; i < FLOW_METER_MAX_CHANNELS; i++) {
+        if (channels[i].active) {
+            process_channel(&channels[i], now_ms);
+        }
+    }
+}
+
+uint32_t flow_meter_get_pulses(uint32_t channel) {
+    return flow_meter_is_active(channel) ? channels[channel].stats.pulses : 0;
+}
+
+static uint32_t average_period(const flow_channel_t *ch) {
+    return ch->period_count ? ch->period_sum / ch->period_count : 0;
+}
+
+static bool is_flowing(const flow_channel_t *ch, uint32_t now_ms) {
+    return ch->period_count > 0 && now_ms - ch->last_pulse_ms < FLOW_METER_TIMEOUT_MS;
+}
+
+uint32_t flow_meter_get_volume_ul(uint32_t channel) {
+    if (!flow_meter_is_active(channel)) {
+        return 0;
+    }
+    const flow_channel_t *ch = &channels[channel];
+    uint64_t volume_q16 = (uint64_t)ch->stats.pulses * ch->ul_per_pulse_q16;
+
+    // Part of the pulse in progress, at the current rate, never a whole pulse
+    uint32_t now_ms = to_ms_since_boot(get_absolute_time());
+    if (is_flowing(ch, now_ms)) {
+        uint32_t period_ms = (uint32_t)((uint64_t)average_period(ch) * 1000 / clock_get_hz(clk_sys));
+        uint32_t elapsed_ms = now_ms - ch->last_pulse_ms;
+        if (period_ms > 0) {
+            if (elapsed_ms >= period_ms) {
+                elapsed_ms = period_ms - 1;     // Late pulse: hold short of the next count
+            }
+            volume_q16 += (uint64_t)ch->ul_per_pulse_q16 * elapsed_ms / period_ms;
+        }
+    }
+    return (uint32_t)(volume_q16 >> 16);
+}
+
+uint32_t flow_meter_get_flow_ul_per_s(uint32_t channel) {
+    if (!flow_meter_is_active(channel)) {
+        return 0;
+    }
+    const flow_channel_t *ch = &channels[channel];
+    if (!is_flowing(ch, to_ms_since_boot(get_absolute_time()))) {
+        return 0;
+    }
+    return flow_meter_period_to_flow(average_period(ch), clock_get_hz(clk_sys), ch->ul_per_pulse_q16);
+}
+
+void flow_meter_get_stats(uint32_t channel, flow_meter_stats_t *stats) {
+    if (flow_meter_is_active(channel)) {
+        *stats = channels[channel].stats;
+    } else {
+        *stats = (flow_meter_stats_t){ 0 };
+    }
+}
+
+void flow_meter_dump(void) {
+    for (uint32_t i = 0; i < FLOW_METER_MAX_CHANNELS; i++) {
+        const flow_channel_t *ch = &channels[i];
+        if (!ch->active) {
+            continue;
+        }
+        printf("FLOW ch=%lu pin=%lu sm=%u dma=%d pulses=%lu volume_ul=%lu flow_ul_s=%lu\n",
+               i, ch->pin, ch->sm, ch->dma_channel, ch->stats.pulses,
+               flow_meter_get_volume_ul(i), flow_meter_get_flow_ul_per_s(i));
+        printf("FLOW ch=%lu period_cycles last=%lu min=%lu max=%lu timeouts=%lu\n",
+               i, ch->stats.last_period_cycles, ch->stats.pulses ? ch->stats.min_period_cycles : 0,
+               ch->stats.max_period_cycles, ch->stats.timeouts);
+    }
+}
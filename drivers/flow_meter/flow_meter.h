@@ -0,0 +1,61 @@
+/**
+ * PicoFlora Flow Meter
+ *
+ * Hall-effect flow sensors counted by PIO, for closed-loop dose verification.
+ * Each sensor gets a state machine on pio0 that measures the period between
+ * rising edges in system clock cycles and pushes one sample per pulse. A DMA
+ * channel streams the samples into a ring buffer (address wrap, endless
+ * transfer), so pulses cost no interrupts and no CPU time; the main loop
+ * drains the rings in flow_meter_process().
+ *
+ * The pulse count gives the delivered volume, the periods the current flow
+ * rate. Between pulses the volume is interpolated from the last period, so
+ * the reading moves smoothly even with coarse sensors (~170 uL per pulse).
+ *
+ * The period is counted in system clock cycles, so it is converted with the
+ * clock at the time of processing; samples that straddle a CPU frequency
+ * change are off for that one pulse.
+ */
+
+#ifndef FLOW_METER_H
+#define FLOW_METER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Configuration
+#define FLOW_METER_MAX_CHANNELS 2
+#define FLOW_METER_RING_SIZE 256            // Samples per channel (power of two, ring is aligned to its size)
+#define FLOW_METER_AVERAGE 4                // Periods averaged for the flow rate
+#define FLOW_METER_TIMEOUT_MS 2000          // No pulse for this long = no flow
+
+// Channel statistics
+typedef struct {
+    uint32_t pulses;
+    uint32_t timeouts;          // Idle markers from the PIO (no pulse for 2^33 cycles, ~1 min)
+    uint32_t last_period_cycles;
+    uint32_t min_period_cycles;
+    uint32_t max_period_cycles;
+} flow_meter_stats_t;
+
+// Initialization - claims a state machine on pio0 and a DMA channel
+bool flow_meter_init(uint32_t channel, uint32_t pin, uint32_t pulses_per_litre);
+bool flow_meter_is_active(uint32_t channel);
+
+// Drain the sample rings (call from the main loop)
+void flow_meter_process(void);
+
+// Readings
+uint32_t flow_meter_get_pulses(uint32_t channel);
+uint32_t flow_meter_get_volume_ul(uint32_t channel);        // Since init, interpolated between pulses while flowing
+uint32_t flow_meter_get_flow_ul_per_s(uint32_t channel);    // 0 when no pulse within the timeout
+
+// Conversion (pure)
+uint32_t flow_meter_ul_per_pulse_q16(uint32_t pulses_per_litre);
+uint32_t flow_meter_period_to_flow(uint32_t period_cycles, uint32_t clock_hz, uint32_t ul_per_pulse_q16);
+
+// Diagnostics
+void flow_meter_get_stats(uint32_t channel, flow_meter_stats_t *stats);
+void flow_meter_dump(void);
+
+#endif // FLOW_METER_H
@@ -0,0 +1,199 @@
+/**
+ * PicoFlora IMU Service Implementation
+ */
+
+#include "imu.h"
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+#include "hardware/irq.h"
+#include "../logging/logging.h"
+#include <stdio.h>
+
+#define WATERMARK_PERIOD_MS (IMU_FIFO_WATERMARK * 1000 / IMU_ODR_HZ)
+#define KNOCK_THRESHOLD_LSB (IMU_KNOCK_THRESHOLD_MG * IMU_ACC_LSB_PER_G / 1000)
+#define BASELINE_FRAC_BITS 4
+
+// One FIFO's worth, drained in a single read
+static qmi8658_sample_t fifo[IMU_FIFO_SAMPLES];
+
+// Service state
+static struct {
+    bool running;
+    int int_pin;
+    volatile bool pending;              // Watermark edge seen
+    uint32_t last_check_ms;
+    imu_batch_cb_t batch_callback;
+
+    // Latest batch
+    bool have_tilt;
+    imu_tilt_t tilt;
+    int16_t gyr[3];
+
+    // Knock detection
+    uint32_t baseline_q4;               // EMA of |a| in LSB, 4 fraction bits
+    uint16_t holdoff;
+    uint32_t knocks;
+    uint32_t last_knock_ms;
+    uint32_t last_knock_peak;           // LSB
+
+    // Statistics
+    uint32_t drains;
+    uint32_t samples;
+    uint32_t max_batch;
+    uint32_t overflows;
+} imu;
+
+static void imu_gpio_irq(void) {
+    if (gpio_get_irq_event_mask((uint)imu.int_pin) & GPIO_IRQ_EDGE_RISE) {
+        gpio_acknowledge_irq((uint)imu.int_pin, GPIO_IRQ_EDGE_RISE);
+        imu.pending = true;
+    }
+}
+
+bool imu_init(int int_pin) {
+    if (imu.running || !bsp_qmi8658_init()) {
+        return false;
+    }
+
+    imu.int_pin = int_pin;
+    bsp_qmi8658_fifo_init(QMI8658_FIFO_SIZE_64, IMU_FIFO_WATERMARK, true);
+
+    if (int_pin >= 0) {
+        // Shared with the touch controller's GPIO callback, so a raw handler of our own
+        gpio_init((uint)int_pin);
+        gpio_set_dir((uint)int_pin, GPIO_IN);
+        gpio_add_raw_irq_handler((uint)int_pin, imu_gpio_irq);
+        gpio_set_irq_enabled((uint)int_pin, GPIO_IRQ_EDGE_RISE, true);
+        irq_set_enabled(IO_IRQ_BANK0, true);
+    }
+
+    imu.last_check_ms = to_ms_since_boot(get_absolute_time());
+    imu.running = true;
+    LOG_HW_INFO("IMU FIFO running: %u Hz, watermark %u samples, %s", IMU_ODR_HZ, IMU_FIFO_WATERMARK,
+                int_pin >= 0 ? "interrupt" : "polled");
+    return true;
+}
+
+bool imu_is_running(void) {
+    return imu.running;
+}
+
+static void process_batch(uint16_t count, uint32_t now_ms) {
+    int32_t sum[3] = {0, 0, 0};
+
+    for (uint16_t i = 0; i < count; i++) {
+        const int16_t *a = fifo[i].acc;
+        sum[0] += a[0];
+        sum[1] += a[1];
+        sum[2] += a[2];
+
+        // Magnitude against a slow baseline: gravity and tilt cancel, impacts stand out
+        uint32_t magnitude = imu_math_isqrt((uint32_t)((int32_t)a[0] * a[0]) + (uint32_t)((int32_t)a[1] * a[1]) +
+                                            (uint32_t)((int32_t)a[2] * a[2]));
+        if (imu.baseline_q4 == 0) {
+            imu.baseline_q4 = magnitude << BASELINE_FRAC_BITS;
+        }
+        uint32_t baseline = imu.baseline_q4 >> BASELINE_FRAC_BITS;
+        uint32_t deviation = magnitude > baseline ? magnitude - baseline : baseline - magnitude;
+        imu.baseline_q4 += (int32_t)((magnitude << BASELINE_FRAC_BITS) - imu.baseline_q4) >> IMU_BASELINE_SHIFT;
+
+        if (imu.holdoff > 0) {
+            imu.holdoff--;
+            if (deviation > imu.last_knock_peak) {
+                imu.last_knock_peak = deviation;
+            }
+        } else if (deviation > KNOCK_THRESHOLD_LSB) {
+            imu.knocks++;
+            imu.last_knock_ms = now_ms;
+            imu.last_knock_peak = deviation;
+            imu.holdoff = IMU_KNOCK_HOLDOFF_SAMPLES;
+            LOG_HW_DEBUG("IMU knock: %lu mg", deviation * 1000 / IMU_ACC_LSB_PER_G);
+        }
+    }
+
+    // Mean over the batch: one orientation per drain
+    imu_math_tilt(sum[0] / count, sum[1] / count, sum[2] / count, &imu.tilt);
+    imu.have_tilt = true;
+    for (int axis = 0; axis < 3; axis++) {
+        imu.gyr[axis] = fifo[count - 1].gyr[axis];
+    }
+}
+
+void imu_process(void) {
+    if (!imu.running) {
+        return;
+    }
+
+    // Drain on the watermark edge. Polled, the status is checked twice per watermark period so
+    // the FIFO never fills; with the interrupt a slow check covers an edge that was missed
+    uint32_t now_ms = to_ms_since_boot(get_absolute_time());
+    uint32_t period = imu.int_pin >= 0 ? 4 * WATERMARK_PERIOD_MS : WATERMARK_PERIOD_MS / 2;
+    if (!imu.pending && now_ms - imu.last_check_ms < period) {
+        return;
+    }
+    imu.pending = false;
+    imu.last_check_ms = now_ms;
+
+    uint8_t status = bsp_qmi8658_fifo_status();
+    if (!(status & (QMI8658_FIFO_STATUS_WTM | QMI8658_FIFO_STATUS_FULL))) {
+        return;
+    }
+    if (status & QMI8658_FIFO_STATUS_OVFLOW) {
+        imu.overflows++;
+    }
+
+    uint16_t count = bsp_qmi8658_fifo_read(fifo, IMU_FIFO_SAMPLES);
+    if (count == 0) {
+        return;
+    }
+    imu.drains++;
+    imu.samples += count;
+    if (count > imu.max_batch) {
+        imu.max_batch = count;
+    }
+    process_batch(count, now_ms);
+    if (imu.batch_callback) {
+        imu.batch_callback(fifo, count);
+    }
+}
+
+void imu_set_batch_callback(imu_batch_cb_t callback) {
+    imu.batch_callback = callback;
+}
+
+bool imu_get_tilt(imu_tilt_t *tilt) {
+    if (!imu.have_tilt) {
+        return false;
+    }
+    *tilt = imu.tilt;
+    return true;
+}
+
+uint32_t imu_get_knock_count(void) {
+    return imu.knocks;
+}
+
+uint32_t imu_get_last_knock_ms(void) {
+    return imu.last_knock_ms;
+}
+
+uint32_t imu_get_last_knock_peak_mg(void) {
+    return imu.last_knock_peak * 1000 / IMU_ACC_LSB_PER_G;
+}
+
+void imu_dump(void) {
+    if (!imu.running) {
+        printf("IMU not running\n");
+        return;
+    }
+    printf("IMU odr_hz=%u watermark=%u int_pin=%d drains=%lu samples=%lu max_batch=%lu overflows=%lu\n",
+           IMU_ODR_HZ, IMU_FIFO_WATERMARK, imu.int_pin, imu.drains, imu.samples, imu.max_batch, imu.overflows);
+    if (imu.have_tilt) {
+        printf("IMU roll_cdeg=%ld pitch_cdeg=%ld tilt_cdeg=%ld direction_cdeg=%ld magnitude_mg=%lu\n",
+               imu.tilt.roll_cdeg, imu.tilt.pitch_cdeg, imu.tilt.tilt_cdeg, imu.tilt.direction_cdeg,
+               imu.tilt.magnitude * 1000 / IMU_ACC_LSB_PER_G);
+        printf("IMU gyr=%d,%d,%d\n", imu.gyr[0], imu.gyr[1], imu.gyr[2]);
+    }
+    printf("IMU knocks=%lu last_ms=%lu last_peak_mg=%lu baseline_mg=%lu\n", imu.knocks, imu.last_knock_ms,
+           imu_get_last_knock_peak_mg(), (imu.baseline_q4 >> BASELINE_FRAC_BITS) * 1000 / IMU_ACC_LSB_PER_G);
+}
@@ -0,0 +1,59 @@
+/**
+ * PicoFlora IMU Service
+ *
+ * Reservoir tilt and knock detection from the onboard QMI8658 at full ODR
+ * without handling every sample. The IMU buffers accelerometer and
+ * gyroscope samples in its FIFO and raises its watermark interrupt once
+ * IMU_FIFO_WATERMARK of them are waiting; the main loop then drains the
+ * whole FIFO in a single burst I2C read and processes the batch:
+ *
+ * - Tilt: the batch's mean acceleration (gravity, vibration averaged out)
+ *   goes through the CORDIC orientation in imu_math.h once per batch.
+ * - Knocks: every sample's |a| (integer sqrt) is compared with a slow EMA
+ *   baseline; a deviation above IMU_KNOCK_THRESHOLD_MG counts a knock,
+ *   then IMU_KNOCK_HOLDOFF_SAMPLES of ringing are ignored.
+ *
+ * Without the INT pin wired (pin -1) the FIFO status is polled once per
+ * watermark period instead, which costs one register read.
+ */
+
+#ifndef IMU_H
+#define IMU_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "imu_math.h"
+#include "bsp_qmi8658.h"
+
+// Configuration
+#define IMU_ODR_HZ 224                      // Accelerometer and gyroscope output data rate
+#define IMU_ACC_LSB_PER_G 8192              // +-4 g range
+#define IMU_FIFO_SAMPLES 64                 // FIFO size, also the drain buffer (12 bytes each)
+#define IMU_FIFO_WATERMARK 32               // Samples per interrupt (~7 drains per second)
+#define IMU_KNOCK_THRESHOLD_MG 250          // |a| deviation from the baseline that counts as a knock
+#define IMU_KNOCK_HOLDOFF_SAMPLES 22        // ~100 ms ignored after a knock
+#define IMU_BASELINE_SHIFT 6                // Baseline EMA alpha = 1/64 (~0.3 s)
+
+// Start FIFO acquisition; 'int_pin' is the GPIO wired to QMI8658 INT1, or -1 to poll
+bool imu_init(int int_pin);
+bool imu_is_running(void);
+
+// Drain the FIFO when the watermark is reached (call from the main loop)
+void imu_process(void);
+
+// Called from imu_process() with every drained batch, oldest sample first (NULL = none)
+typedef void (*imu_batch_cb_t)(const qmi8658_sample_t *samples, uint16_t count);
+void imu_set_batch_callback(imu_batch_cb_t callback);
+
+// Orientation of the latest batch; false until the first batch
+bool imu_get_tilt(imu_tilt_t *tilt);
+
+// Knocks counted since init, and the time and peak deviation of the last one
+uint32_t imu_get_knock_count(void);
+uint32_t imu_get_last_knock_ms(void);
+uint32_t imu_get_last_knock_peak_mg(void);
+
+// Diagnostics
+void imu_dump(void);
+
+#endif // IMU_H
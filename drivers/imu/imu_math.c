@@ -0,0 +1,106 @@
+/**
+ * PicoFlora IMU Maths Implementation
+ */
+
+#include "imu_math.h"
+#include <stddef.h>
+
+// atan(2^-i) in centidegrees * 256
+static const int32_t cordic_atan[IMU_MATH_CORDIC_ITERATIONS] = {
+    1152000, 680065, 359328, 182400, 91554, 45822, 22916, 11459,
+    5730, 2865, 1432, 716, 358, 179, 90, 45
+};
+
+#define CORDIC_ANGLE_FRAC_BITS 8
+#define CORDIC_INV_GAIN_Q30 652032874       // 1 / prod(sqrt(1 + 2^-2i)) = 0.6072529
+#define CORDIC_INPUT_BITS 28                // Inputs scaled to [2^28, 2^29): room for the gain and sqrt(2)
+#define HALF_TURN_CDEG 18000
+
+static int highest_bit(uint32_t v) {
+    return 31 - __builtin_clz(v);
+}
+
+int32_t imu_math_atan2(int32_t y, int32_t x, uint32_t *hypot) {
+    if (x == 0 && y == 0) {
+        if (hypot) {
+            *hypot = 0;
+        }
+        return 0;
+    }
+
+    // Vectoring converges for x >= 0 only: a half turn brings the left half plane over
+    int64_t vx = x;
+    int64_t vy = y;
+    int32_t z = 0;
+    if (vx < 0) {
+        z = (vy >= 0 ? HALF_TURN_CDEG : -HALF_TURN_CDEG) * (1 << CORDIC_ANGLE_FRAC_BITS);
+        vx = -vx;
+        vy = -vy;
+    }
+
+    // Scale the larger component to CORDIC_INPUT_BITS so small vectors keep their resolution
+    uint32_t ax = (uint32_t)vx;
+    uint32_t ay = (uint32_t)(vy < 0 ? -vy : vy);
+    int shift = CORDIC_INPUT_BITS - highest_bit(ax > ay ? ax : ay);
+    int32_t cx = (int32_t)(shift >= 0 ? vx << shift : vx >> -shift);
+    int32_t cy = (int32_t)(shift >= 0 ? vy << shift : vy >> -shift);
+
+    // Rotate towards y = 0, accumulating the rotation
+    for (int i = 0; i < IMU_MATH_CORDIC_ITERATIONS; i++) {
+        int32_t px = cx;
+        if (cy > 0) {
+            cx += cy >> i;
+            cy -= px >> i;
+            z += cordic_atan[i];
+        } else {
+            cx -= cy >> i;
+            cy += px >> i;
+            z -= cordic_atan[i];
+        }
+    }
+
+    if (hypot) {
+        uint64_t length = ((uint64_t)cx * CORDIC_INV_GAIN_Q30 + (1u << 29)) >> 30;
+        if (shift > 0) {
+            length = (length + (1ull << (shift - 1))) >> shift;
+        } else {
+            length <<= -shift;
+        }
+        *hypot = length > UINT32_MAX ? UINT32_MAX : (uint32_t)length;
+    }
+
+    int32_t half = 1 << (CORDIC_ANGLE_FRAC_BITS - 1);
+    int32_t angle = (z >= 0 ? z + half : z - half) / (1 << CORDIC_ANGLE_FRAC_BITS);
+    if (angle > HALF_TURN_CDEG) {
+        angle = HALF_TURN_CDEG;
+    } else if (angle < -HALF_TURN_CDEG) {
+        angle = -HALF_TURN_CDEG;
+    }
+    return angle;
+}
+
+void imu_math_tilt(int32_t x, int32_t y, int32_t z, imu_tilt_t *tilt) {
+    uint32_t yz, xy;
+    tilt->roll_cdeg = imu_math_atan2(y, z, &yz);
+    tilt->pitch_cdeg = imu_math_atan2(-x, (int32_t)yz, NULL);
+    tilt->direction_cdeg = imu_math_atan2(y, x, &xy);
+    tilt->tilt_cdeg = imu_math_atan2((int32_t)xy, z, &tilt->magnitude);
+}
+
+uint32_t imu_math_isqrt(uint32_t v) {
+    uint32_t root = 0;
+    uint32_t bit = 1u << 30;
+    while (bit > v) {
+        bit >>= 2;
+    }
+    while (bit != 0) {
+        if (v >= root + bit) {
+            v -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
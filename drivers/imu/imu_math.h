@@ -0,0 +1,46 @@
+/**
+ * PicoFlora IMU Maths
+ *
+ * Integer orientation maths for the accelerometer, with no floating point
+ * and no libm. They are pure functions (no hardware, no state), so they
+ * build and run on the host as well.
+ *
+ * - CORDIC vectoring: rotates (x, y) onto the x axis in fixed shift-and-add
+ *   steps; the accumulated rotation is atan2(y, x) and the remaining x is
+ *   the vector length (times the CORDIC gain, removed with one multiply).
+ *   So each call yields an angle and a hypotenuse without sqrt or divide.
+ * - Tilt: three vectoring steps on a gravity vector give roll, pitch, the
+ *   angle from vertical, the direction of the lean and the magnitude.
+ * - Integer square root for per-sample magnitudes at full ODR.
+ *
+ * Angles are in centidegrees (0.01 degree), like the other fixed-point
+ * quantities in the firmware.
+ */
+
+#ifndef IMU_MATH_H
+#define IMU_MATH_H
+
+#include <stdint.h>
+
+// Configuration
+#define IMU_MATH_CORDIC_ITERATIONS 16       // Last step is atan(2^-15) = 0.0017 degrees
+
+// Orientation of a gravity vector
+typedef struct {
+    int32_t roll_cdeg;          // Rotation about X: atan2(y, z), -18000..18000
+    int32_t pitch_cdeg;         // Rotation about Y: atan2(-x, sqrt(y^2 + z^2)), -9000..9000
+    int32_t tilt_cdeg;          // Angle between Z and the vector, 0..18000
+    int32_t direction_cdeg;     // Direction of the lean in the XY plane: atan2(y, x)
+    uint32_t magnitude;         // Vector length, same units as the input
+} imu_tilt_t;
+
+// atan2(y, x) in centidegrees (-18000..18000), and optionally sqrt(x^2 + y^2)
+int32_t imu_math_atan2(int32_t y, int32_t x, uint32_t *hypot);
+
+// Orientation of (x, y, z); any common scale (raw LSB, mg), components within +-2^30
+void imu_math_tilt(int32_t x, int32_t y, int32_t z, imu_tilt_t *tilt);
+
+// floor(sqrt(v))
+uint32_t imu_math_isqrt(uint32_t v);
+
+#endif // IMU_MATH_H
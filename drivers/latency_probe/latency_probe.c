@@ -0,0 +1,153 @@
+/**
+ * PicoFlora Input-to-Photon Latency Probe Implementation
+ */
+
+#include "latency_probe.h"
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+#include "hardware/timer.h"
+#include <stdio.h>
+#include <string.h>
+
+#define STAGE_BIT(stage) (1u << (stage))
+
+// A stage is only recorded once its prerequisite has been seen in the same trace,
+// so unrelated renders/flushes that were already in flight are not attributed to the touch
+static const latency_stage_t stage_prerequisite[LATENCY_STAGE_COUNT] = {
+    [LATENCY_STAGE_TOUCH_IRQ]    = LATENCY_STAGE_TOUCH_IRQ,
+    [LATENCY_STAGE_INDEV_READ]   = LATENCY_STAGE_TOUCH_IRQ,
+    [LATENCY_STAGE_EVENT_CB]     = LATENCY_STAGE_INDEV_READ,
+    [LATENCY_STAGE_RENDER_START] = LATENCY_STAGE_INDEV_READ,
+    [LATENCY_STAGE_RENDER_END]   = LATENCY_STAGE_RENDER_START,
+    [LATENCY_STAGE_FLUSH_DONE]   = LATENCY_STAGE_RENDER_START
+};
+
+// Stage strings for output formatting
+static const char* stage_strings[] = {
+    [LATENCY_STAGE_TOUCH_IRQ]    = "touch_irq",
+    [LATENCY_STAGE_INDEV_READ]   = "indev_read",
+    [LATENCY_STAGE_EVENT_CB]     = "event_cb",
+    [LATENCY_STAGE_RENDER_START] = "render_start",
+    [LATENCY_STAGE_RENDER_END]   = "render_end",
+    [LATENCY_STAGE_FLUSH_DONE]   = "flush_done"
+};
+
+// A trace is finished once the frame has been both rendered and pushed out
+#define TRACE_DONE_MASK (STAGE_BIT(LATENCY_STAGE_RENDER_END) | STAGE_BIT(LATENCY_STAGE_FLUSH_DONE))
+
+// Probe state, shared by both cores (the display flush may complete on core1)
+static struct {
+    spin_lock_t *lock;
+    bool trace_active;
+    uint32_t trace_start_us;
+    uint32_t seen_mask;
+    uint32_t abandoned;
+    latency_stage_stats_t stats[LATENCY_STAGE_COUNT];
+} probe;
+
+static inline uint32_t bucket_for(uint32_t elapsed_us) {
+    if (elapsed_us == 0) {
+        return 0;
+    }
+    uint32_t bucket = 31 - __builtin_clz(elapsed_us);
+    return (bucket < LATENCY_HIST_BUCKETS) ? bucket : (LATENCY_HIST_BUCKETS - 1);
+}
+
+static void record_stage(latency_stage_t stage, uint32_t elapsed_us) {
+    latency_stage_stats_t *s = &probe.stats[stage];
+    s->count++;
+    s->sum_us += elapsed_us;
+    if (elapsed_us > s->max_us) {
+        s->max_us = elapsed_us;
+    }
+    s->buckets[bucket_for(elapsed_us)]++;
+}
+
+void latency_probe_init(void) {
+    probe.lock = spin_lock_instance((uint)spin_lock_claim_unused(true));
+    latency_probe_reset();
+}
+
+void latency_probe_reset(void) {
+    spin_lock_t *lock = probe.lock;
+    uint32_t irq_state = spin_lock_blocking(lock);
+    memset(&probe, 0, sizeof(probe));
+    probe.lock = lock;
+    spin_unlock(lock, irq_state);
+}
+
+void latency_probe_mark(latency_stage_t stage) {
+    if (stage >= LATENCY_STAGE_COUNT) {
+        return;
+    }
+    
+    uint32_t now = time_us_32();
+    uint32_t irq_state = spin_lock_blocking(probe.lock);
+    
+    // Drop traces that never made it to the display (e.g. touch on an idle area)
+    if (probe.trace_active && (now - probe.trace_start_us) > LATENCY_TRACE_TIMEOUT_US) {
+        probe.trace_active = false;
+        probe.abandoned++;
+    }
+    
+    if (stage == LATENCY_STAGE_TOUCH_IRQ) {
+        // Only start a new trace when idle; further INT edges belong to the same gesture
+        if (!probe.trace_active) {
+            probe.trace_active = true;
+            probe.trace_start_us = now;
+            probe.seen_mask = STAGE_BIT(LATENCY_STAGE_TOUCH_IRQ);
+            record_stage(LATENCY_STAGE_TOUCH_IRQ, 0);
+        }
+    } else if (probe.trace_active &&
+               !(probe.seen_mask & STAGE_BIT(stage)) &&
+               (probe.seen_mask & STAGE_BIT(stage_prerequisite[stage]))) {
+        probe.seen_mask |= STAGE_BIT(stage);
+        record_stage(stage, now - probe.trace_start_us);
+        
+        if ((probe.seen_mask & TRACE_DONE_MASK) == TRACE_DONE_MASK) {
+            probe.trace_active = false;
+        }
+    }
+    
+    spin_unlock(probe.lock, irq_state);
+}
+
+const latency_stage_stats_t* latency_probe_get_stats(latency_stage_t stage) {
+    if (stage < LATENCY_STAGE_COUNT) {
+        return &probe.stats[stage];
+    }
+    return NULL;
+}
+
+uint32_t latency_probe_get_abandoned_count(void) {
+    return probe.abandoned;
+}
+
+void latency_probe_dump(void) {
+    // Take a consistent copy so IRQ-side marks can't tear the output
+    latency_stage_stats_t snapshot[LATENCY_STAGE_COUNT];
+    uint32_t irq_state = spin_lock_blocking(probe.lock);
+    memcpy(snapshot, probe.stats, sizeof(snapshot));
+    uint32_t abandoned = probe.abandoned;
+    spin_unlock(probe.lock, irq_state);
+    
+    printf("LAT begin buckets=%d abandoned=%lu\n", LATENCY_HIST_BUCKETS, abandoned);
+    for (int i = 0; i < LATENCY_STAGE_COUNT; i++) {
+        const latency_stage_stats_t *s = &snapshot[i];
+        uint32_t mean_us = s->count ? (uint32_t)(s->sum_us / s->count) : 0;
+        printf("LAT stage=%s count=%lu mean_us=%lu max_us=%lu hist=",
+               stage_strings[i], s->count, mean_us, s->max_us);
+        for (int b = 0; b < LATENCY_HIST_BUCKETS; b++) {
+            printf(b ? ",%lu" : "%lu", s->buckets[b]);
+        }
+        printf("\n");
+    }
+    printf("LAT end\n");
+}
+
+const char* latency_stage_to_string(latency_stage_t stage) {
+    if (stage < LATENCY_STAGE_COUNT) {
+        return stage_strings[stage];
+    }
+    return "UNKNOWN";
+}
@@ -0,0 +1,69 @@
+/**
+ * PicoFlora Input-to-Photon Latency Probe
+ * 
+ * Follows a single touch through the UI pipeline and records how long each
+ * stage took to be reached, measured from the CST328 INT edge.
+ * Per-stage log2 histograms live in RAM and can be dumped over USB stdio
+ * (see tools/latency_view.py for a host-side viewer).
+ * 
+ * Each mark is one timer read plus a handful of integer operations, so the
+ * probe is intended to stay enabled in production builds.
+ */
+
+#ifndef LATENCY_PROBE_H
+#define LATENCY_PROBE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Pipeline stages (in the order a touch normally travels through them)
+typedef enum {
+    LATENCY_STAGE_TOUCH_IRQ = 0,    // CST328 INT falling edge (trace start)
+    LATENCY_STAGE_INDEV_READ,       // LVGL indev read saw the press
+    LATENCY_STAGE_EVENT_CB,         // Application event callback ran
+    LATENCY_STAGE_RENDER_START,     // LVGL started rendering a frame
+    LATENCY_STAGE_RENDER_END,       // LVGL finished rendering the frame
+    LATENCY_STAGE_FLUSH_DONE,       // DMA finished pushing the last band
+    LATENCY_STAGE_COUNT             // Number of stages (keep last)
+} latency_stage_t;
+
+// Configuration
+#ifndef LATENCY_PROBE_ENABLED
+#define LATENCY_PROBE_ENABLED true
+#endif
+#define LATENCY_HIST_BUCKETS 16           // Bucket n holds [2^n, 2^(n+1)) us, last is open-ended
+#define LATENCY_TRACE_TIMEOUT_US 500000   // Abandon a trace that never reaches the display
+
+// Per-stage statistics (all times are microseconds since the touch IRQ)
+typedef struct {
+    uint32_t count;
+    uint32_t max_us;
+    uint64_t sum_us;
+    uint32_t buckets[LATENCY_HIST_BUCKETS];
+} latency_stage_stats_t;
+
+// Initialization
+void latency_probe_init(void);
+void latency_probe_reset(void);
+
+// Record that the current trace reached a stage (safe from IRQ context and either core)
+void latency_probe_mark(latency_stage_t stage);
+
+// Statistics access
+const latency_stage_stats_t* latency_probe_get_stats(latency_stage_t stage);
+uint32_t latency_probe_get_abandoned_count(void);
+
+// Dump all histograms over stdio in a line-oriented format ("LAT ...")
+void latency_probe_dump(void);
+
+// Utility functions
+const char* latency_stage_to_string(latency_stage_t stage);
+
+// Instrumentation macro - compiles to nothing when the probe is disabled
+#if LATENCY_PROBE_ENABLED
+#define LATENCY_MARK(stage) latency_probe_mark(stage)
+#else
+#define LATENCY_MARK(stage) ((void)0)
+#endif
+
+#endif // LATENCY_PROBE_H
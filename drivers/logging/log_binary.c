@@ -0,0 +1,262 @@
+/**
+ * PicoFlora Binary Logging Backend Implementation
+ * 
+ * The ring is a bounded multi-producer queue with a per-slot sequence number:
+ * a producer claims a slot with a CAS on enqueue_pos, fills it, then publishes
+ * it by storing pos + 1 into the slot sequence. Producers never wait on the
+ * consumer, so logging from an IRQ that interrupted another producer (or from
+ * the other core) cannot deadlock; a full ring simply drops the record.
+ */
+
+#include "log_binary.h"
+#include "pico/stdlib.h"
+#include "hardware/timer.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+
+#define RING_MASK (LOG_BINARY_RING_SLOTS - 1)
+#define RECORD_HEADER_BYTES 12
+
+_Static_assert((LOG_BINARY_RING_SLOTS & RING_MASK) == 0, "LOG_BINARY_RING_SLOTS must be a power of two");
+
+typedef struct {
+    atomic_uint seq;            // Slot sequence number (ownership handshake)
+    uint32_t fmt;               // Format string address (resolved on the host via the ELF)
+    uint32_t timestamp_us;
+    uint8_t level;
+    uint8_t category;
+    uint8_t nwords;
+    uint8_t flags;
+    uint32_t args[LOG_BINARY_MAX_ARG_WORDS];
+} log_slot_t;
+
+static log_slot_t ring[LOG_BINARY_RING_SLOTS];
+static atomic_uint enqueue_pos;
+static uint32_t dequeue_pos;        // Single consumer (main loop)
+static atomic_uint dropped_count;
+static uint32_t dropped_reported;
+static bool binary_initialized = false;
+
+void log_binary_init(void) {
+    for (uint32_t i = 0; i < LOG_BINARY_RING_SLOTS; i++) {
+        atomic_init(&ring[i].seq, i);
+    }
+    atomic_init(&enqueue_pos, 0);
+    atomic_init(&dropped_count, 0);
+    dequeue_pos = 0;
+    dropped_reported = 0;
+    binary_initialized = true;
+}
+
+// Walk the format string and copy each argument as raw 32-bit words.
+// Strings are copied inline (length word + bytes) since the caller's buffer may not outlive the record.
+uint8_t log_binary_encode(const char* format, va_list args, uint32_t* out, uint8_t* flags) {
+    uint32_t n = 0;
+    
+    #define PUT_WORD(value) do { \
+        if (n >= LOG_BINARY_MAX_ARG_WORDS) { *flags |= LOG_BINARY_FLAG_TRUNCATED; return n; } \
+        out[n++] = (uint32_t)(value); \
+    } while (0)
+    
+    for (const char* p = format; *p; p++) {
+        if (*p != '%') continue;
+        p++;
+        if (*p == '%') continue;
+        
+        // Flags, width and precision ('*' consumes an int argument)
+        while (*p == '-' || *p == '+' || *p == ' ' || *p == '#' || *p == '0') p++;
+        if (*p == '*') { PUT_WORD(va_arg(args, int)); p++; }
+        while (*p >= '0' && *p <= '9') p++;
+        if (*p == '.') {
+            p++;
+            if (*p == '*') { PUT_WORD(va_arg(args, int)); p++; }
+            while (*p >= '0' && *p <= '9') p++;
+        }
+        
+        // Length modifiers
+        bool is_long = false;
+        bool is_long_long = false;
+        if (*p == 'h') { p++; if (*p == 'h') p++; }
+        else if (*p == 'l') { p++; is_long = true; if (*p == 'l') { p++; is_long_long = true; } }
+        else if (*p == 'j') { p++; is_long_long = true; }
+        else if (*p == 'z' || *p == 't' || *p == 'L') { p++; }
+        
+        switch (*p) {
+            case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c':
+                if (is_long_long) {
+                    uint64_t v = va_arg(args, unsigned long long);
+                    PUT_WORD(v);
+                    PUT_WORD(v >> 32);
+                } else if (is_long) {
+                    PUT_WORD(va_arg(args, unsigned long));
+                } else {
+                    PUT_WORD(va_arg(args, unsigned int));
+                }
+                break;
+            case 'p':
+                PUT_WORD((uintptr_t)va_arg(args, void*));
+                break;
+            case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A': {
+                double d = va_arg(args, double);
+                uint64_t bits;
+                memcpy(&bits, &d, sizeof(bits));
+                PUT_WORD(bits);
+                PUT_WORD(bits >> 32);
+                break;
+            }
+            case 's': {
+                const char* str = va_arg(args, const char*);
+                if (!str) str = "(null)";
+                if (n >= LOG_BINARY_MAX_ARG_WORDS) {
+                    *flags |= LOG_BINARY_FLAG_TRUNCATED;
+                    return n;
+                }
+                uint32_t room = (LOG_BINARY_MAX_ARG_WORDS - n - 1) * 4;
+                uint32_t len = strlen(str);
+                if (len > room) {
+                    len = room;
+                    *flags |= LOG_BINARY_FLAG_TRUNCATED;
+                }
+                out[n++] = len;
+                memcpy(&out[n], str, len);
+                n += (len + 3) / 4;
+                break;
+            }
+            case '\0':
+                return n;
+            default:
+                break;
+        }
+    }
+    
+    #undef PUT_WORD
+    return n;
+}
+
+// Claim a slot for a producer; NULL if the ring is full
+static log_slot_t* claim_slot(uint32_t* claimed_pos) {
+    uint32_t pos = atomic_load_explicit(&enqueue_pos, memory_order_relaxed);
+    
+    for (;;) {
+        log_slot_t* slot = &ring[pos & RING_MASK];
+        uint32_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        int32_t diff = (int32_t)(seq - pos);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&enqueue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                *claimed_pos = pos;
+                return slot;
+            }
+        } else if (diff < 0) {
+            // Ring full - the consumer has not released this slot yet
+            atomic_fetch_add_explicit(&dropped_count, 1, memory_order_relaxed);
+            return NULL;
+        } else {
+            pos = atomic_load_explicit(&enqueue_pos, memory_order_relaxed);
+        }
+    }
+}
+
+bool log_binary_record(uint8_t level, uint8_t category, const char* format, va_list args) {
+    if (!binary_initialized) {
+        return false;
+    }
+    
+    uint32_t timestamp_us = time_us_32();
+    uint32_t pos;
+    log_slot_t* slot = claim_slot(&pos);
+    if (!slot) {
+        return false;
+    }
+    
+    // Fill and publish
+    slot->fmt = (uint32_t)(uintptr_t)format;
+    slot->timestamp_us = timestamp_us;
+    slot->level = level;
+    slot->category = category;
+    slot->flags = 0;
+    slot->nwords = log_binary_encode(format, args, slot->args, &slot->flags);
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+    return true;
+}
+
+bool log_binary_record_words(uint8_t level, uint8_t category, const char* format,
+                             const uint32_t* args, uint8_t nwords, uint8_t flags) {
+    if (!binary_initialized) {
+        return false;
+    }
+    
+    uint32_t timestamp_us = time_us_32();
+    uint32_t pos;
+    log_slot_t* slot = claim_slot(&pos);
+    if (!slot) {
+        return false;
+    }
+    
+    slot->fmt = (uint32_t)(uintptr_t)format;
+    slot->timestamp_us = timestamp_us;
+    slot->level = level;
+    slot->category = category;
+    slot->flags = flags;
+    slot->nwords = nwords;
+    memcpy(slot->args, args, nwords * 4);
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+    return true;
+}
+
+uint32_t log_binary_drain(uint32_t max_records) {
+    static const char hex_digits[] = "0123456789abcdef";
+    uint8_t record[RECORD_HEADER_BYTES + LOG_BINARY_MAX_ARG_WORDS * 4];
+    char line[2 + sizeof(record) * 2];
+    uint32_t shipped = 0;
+    
+    if (!binary_initialized) {
+        return 0;
+    }
+    
+    while (shipped < max_records) {
+        log_slot_t* slot = &ring[dequeue_pos & RING_MASK];
+        if (atomic_load_explicit(&slot->seq, memory_order_acquire) != dequeue_pos + 1) {
+            break;  // Empty, or the producer has not published yet
+        }
+        
+        // Copy out, then hand the slot back to producers before doing any slow I/O
+        uint32_t len = RECORD_HEADER_BYTES + slot->nwords * 4;
+        memcpy(&record[0], &slot->fmt, 4);
+        memcpy(&record[4], &slot->timestamp_us, 4);
+        record[8] = slot->level;
+        record[9] = slot->category;
+        record[10] = slot->nwords;
+        record[11] = slot->flags;
+        memcpy(&record[RECORD_HEADER_BYTES], slot->args, slot->nwords * 4);
+        atomic_store_explicit(&slot->seq, dequeue_pos + LOG_BINARY_RING_SLOTS, memory_order_release);
+        dequeue_pos++;
+        
+        char* out = line;
+        *out++ = LOG_BINARY_LINE_PREFIX;
+        for (uint32_t i = 0; i < len; i++) {
+            *out++ = hex_digits[record[i] >> 4];
+            *out++ = hex_digits[record[i] & 0x0F];
+        }
+        *out = '\0';
+        printf("%s\n", line);
+        shipped++;
+    }
+    
+    uint32_t dropped = atomic_load_explicit(&dropped_count, memory_order_relaxed);
+    if (dropped != dropped_reported) {
+        printf("[LOG] %lu binary log records dropped (ring full)\n", dropped - dropped_reported);
+        dropped_reported = dropped;
+    }
+    
+    return shipped;
+}
+
+uint32_t log_binary_get_dropped_count(void) {
+    return atomic_load_explicit(&dropped_count, memory_order_relaxed);
+}
+
+uint32_t log_binary_get_pending_count(void) {
+    return atomic_load_explicit(&enqueue_pos, memory_order_relaxed) - dequeue_pos;
+}
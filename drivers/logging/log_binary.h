@@ -0,0 +1,51 @@
+/**
+ * PicoFlora Binary Logging Backend
+ * 
+ * Deferred logging: call sites store the format string address, a timestamp
+ * and the raw arguments in a lock-free multi-producer ring (safe from both
+ * cores and from IRQ handlers). log_binary_drain() ships the records later
+ * from the main loop, and tools/log_decode.py rebuilds the text on the host
+ * using the string table of the firmware ELF.
+ * 
+ * Wire format (one record per line, hex encoded so it can share the USB CDC
+ * stream with plain text output):
+ *   ~<fmt:u32><timestamp_us:u32><level:u8><category:u8><nwords:u8><flags:u8><args:u32 * nwords>
+ * All multi-byte fields are little-endian.
+ */
+
+#ifndef LOG_BINARY_H
+#define LOG_BINARY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+
+// Configuration
+#define LOG_BINARY_RING_SLOTS   64      // Must be a power of two
+#define LOG_BINARY_MAX_ARG_WORDS 12     // Raw argument payload per record (48 bytes)
+#define LOG_BINARY_LINE_PREFIX  '~'     // Marks binary records in the USB stream
+
+// Record flags
+#define LOG_BINARY_FLAG_TRUNCATED 0x01  // Arguments did not fit in the payload
+
+// Initialization (records are rejected until this has run)
+void log_binary_init(void);
+
+// Queue a record; returns false if the ring was full and the record was dropped
+bool log_binary_record(uint8_t level, uint8_t category, const char* format, va_list args);
+
+// Same, for arguments already encoded with log_binary_encode()
+bool log_binary_record_words(uint8_t level, uint8_t category, const char* format,
+                             const uint32_t* args, uint8_t nwords, uint8_t flags);
+
+// Encode the arguments of format into out (LOG_BINARY_MAX_ARG_WORDS words); returns the word count
+uint8_t log_binary_encode(const char* format, va_list args, uint32_t* out, uint8_t* flags);
+
+// Ship up to max_records pending records over stdio; returns the number shipped
+uint32_t log_binary_drain(uint32_t max_records);
+
+// Statistics
+uint32_t log_binary_get_dropped_count(void);
+uint32_t log_binary_get_pending_count(void);
+
+#endif // LOG_BINARY_H
@@ -3,11 +3,16 @@
  */
 
 #include "logging.h"
+#include "log_binary.h"
 #include "pico/stdlib.h"
 #include <string.h>
 
 // Global configuration
 log_level_t g_current_log_level = LOG_LEVEL_INFO;  // Default to INFO level
+log_backend_t g_log_backend = LOG_DEFAULT_BACKEND;
+static log_sink_t log_sink = NULL;
+static log_binary_sink_t log_binary_sink = NULL;
+static log_level_t log_sink_level = LOG_LEVEL_NONE;
 bool g_log_category_enabled[LOG_CAT_COUNT] = {
     [LOG_CAT_SYSTEM] = true,
     [LOG_CAT_HARDWARE] = true,
@@ -50,6 +55,7 @@ static const char* color_reset = "\033[0m";
 void log_init(void) {
     // Ensure stdio is initialized for logging output
     stdio_init_all();
+    log_binary_init();
     
     LOG_SYS_INFO("Logging system initialized");
     LOG_SYS_DEBUG("Log level: %s", log_level_to_string(g_current_log_level));
@@ -78,6 +84,27 @@ void log_enable_category(log_category_t category, bool enabled) {
     }
 }
 
+void log_set_backend(log_backend_t backend) {
+    if (backend == g_log_backend) {
+        return;
+    }
+    // Flush anything still queued so records stay in order across the switch
+    while (log_binary_drain(LOG_BINARY_RING_SLOTS) > 0) {
+    }
+    g_log_backend = backend;
+    LOG_SYS_INFO("Log backend changed to: %s", backend == LOG_BACKEND_BINARY ? "binary" : "text");
+}
+
+void log_set_sink(log_sink_t sink, log_binary_sink_t binary_sink, log_level_t min_level) {
+    log_sink = sink;
+    log_binary_sink = binary_sink;
+    log_sink_level = min_level;
+}
+
+void log_process(void) {
+    log_binary_drain(LOG_DRAIN_BATCH);
+}
+
 void log_message(log_level_t level, log_category_t category, const char* format, ...) {
     // Filter by log level
     if (level < g_current_log_level || level == LOG_LEVEL_NONE) {
@@ -89,13 +116,45 @@ void log_message(log_level_t level, log_category_t category, const char* format,
         return;
     }
     
+    va_list args;
+    bool to_sink = (log_sink != NULL && level >= log_sink_level);
+    
+    // Deferred path: record raw arguments, text is rebuilt on the host.
+    // Fatal messages always go out synchronously since the system halts afterwards.
+    bool deferred = (g_log_backend == LOG_BACKEND_BINARY && level != LOG_LEVEL_FATAL);
+    if (deferred) {
+        if (to_sink && log_binary_sink != NULL) {
+            // Encode once for both outputs; the sink stores the raw record as well
+            uint32_t words[LOG_BINARY_MAX_ARG_WORDS];
+            uint8_t flags = 0;
+            va_start(args, format);
+            uint8_t nwords = log_binary_encode(format, args, words, &flags);
+            va_end(args);
+            log_binary_record_words(level, category, format, words, nwords, flags);
+            log_binary_sink(level, category, format, words, nwords, flags);
+            return;
+        }
+        va_start(args, format);
+        log_binary_record(level, category, format, args);
+        va_end(args);
+        if (!to_sink) {
+            return;
+        }
+    }
+    
     // Format the message
     char message_buffer[LOG_MAX_MESSAGE_LENGTH];
-    va_list args;
     va_start(args, format);
     vsnprintf(message_buffer, sizeof(message_buffer), format, args);
     va_end(args);
     
+    if (to_sink) {
+        log_sink(level, category, message_buffer);
+    }
+    if (deferred) {
+        return;
+    }
+    
     // Build the log line
     char log_line[LOG_MAX_MESSAGE_LENGTH + 100];  // Extra space for prefix
     
@@ -157,6 +216,61 @@ void log_message(log_level_t level, log_category_t category, const char* format,
     }
 }
 
+void log_benchmark(uint32_t iterations) {
+    // Representative hot-path message (matches the stepper frequency update log)
+    static const char bench_format[] = "Steps: %ld/%ld, State: %d, Freq: %lu Hz";
+    const uint32_t chunk = LOG_BINARY_RING_SLOTS / 2;
+    log_backend_t saved_backend = g_log_backend;
+    log_sink_t saved_sink = log_sink;
+    log_level_t level = (g_current_log_level > LOG_LEVEL_INFO && g_current_log_level < LOG_LEVEL_FATAL)
+                        ? g_current_log_level : LOG_LEVEL_INFO;
+    uint64_t elapsed_us[2] = {0, 0};
+    uint64_t filtered_us = 0;
+    
+    if (iterations == 0 || !g_log_category_enabled[LOG_CAT_SYSTEM]) {
+        return;
+    }
+    
+    // Keep the benchmark traffic out of the secondary output
+    log_sink = NULL;
+    
+    for (int backend = LOG_BACKEND_TEXT; backend <= LOG_BACKEND_BINARY; backend++) {
+        log_set_backend((log_backend_t)backend);
+        uint32_t done = 0;
+        while (done < iterations) {
+            // Binary runs are split in chunks that fit the ring, draining (untimed) in between,
+            // so the measurement never includes the ring-full drop path
+            uint32_t n = (iterations - done < chunk) ? (iterations - done) : chunk;
+            uint64_t start = time_us_64();
+            for (uint32_t i = 0; i < n; i++) {
+                log_message(level, LOG_CAT_SYSTEM, bench_format, (long)(done + i), (long)iterations, 2, 8000UL);
+            }
+            elapsed_us[backend] += time_us_64() - start;
+            done += n;
+            while (log_binary_drain(LOG_BINARY_RING_SLOTS) > 0) {
+            }
+        }
+    }
+    
+    log_set_backend(saved_backend);
+    log_sink = saved_sink;
+    
+    // Cost of a message rejected by the inline runtime gate (DEBUG below the current level)
+    if (g_current_log_level > LOG_LEVEL_DEBUG) {
+        uint64_t start = time_us_64();
+        for (uint32_t i = 0; i < iterations; i++) {
+            LOG_SYS_DEBUG(bench_format, (long)i, (long)iterations, 2, 8000UL);
+        }
+        filtered_us = time_us_64() - start;
+    }
+    
+    LOG_SYS_INFO("Log benchmark (%lu calls): text %lu ns/call, binary %lu ns/call, filtered %lu ns/call",
+                 iterations,
+                 (uint32_t)(elapsed_us[LOG_BACKEND_TEXT] * 1000 / iterations),
+                 (uint32_t)(elapsed_us[LOG_BACKEND_BINARY] * 1000 / iterations),
+                 (uint32_t)(filtered_us * 1000 / iterations));
+}
+
 const char* log_level_to_string(log_level_t level) {
     if (level < LOG_LEVEL_NONE) {
         return level_strings[level];
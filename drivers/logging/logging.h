@@ -34,34 +34,90 @@ typedef enum {
     LOG_CAT_COUNT           // Number of categories (keep last)
 } log_category_t;
 
+// Output backends
+typedef enum {
+    LOG_BACKEND_TEXT = 0,   // Format and print synchronously (human readable)
+    LOG_BACKEND_BINARY      // Queue raw records, ship from log_process(), decode on host
+} log_backend_t;
+
 // Configuration
+#define LOG_DEFAULT_BACKEND LOG_BACKEND_TEXT
+#define LOG_DRAIN_BATCH 8           // Binary records shipped per log_process() call
 #define LOG_MAX_MESSAGE_LENGTH 256
 #define LOG_TIMESTAMP_ENABLED true
 #define LOG_CATEGORY_ENABLED true
 
+// Compile-time filtering - calls below LOG_COMPILE_LEVEL or outside the
+// LOG_COMPILE_CATEGORIES bitmask are removed by the compiler, arguments included.
+// Override from CMake, e.g. target_compile_definitions(... LOG_COMPILE_LEVEL=LOG_LEVEL_INFO)
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_LEVEL_DEBUG
+#endif
+#ifndef LOG_COMPILE_CATEGORIES
+#define LOG_COMPILE_CATEGORIES ((1u << LOG_CAT_COUNT) - 1u)
+#endif
+#define LOG_CAT_BIT(category) (1u << (category))
+
+// Optional secondary output (e.g. the persistent flash store), receives the formatted text
+typedef void (*log_sink_t)(log_level_t level, log_category_t category, const char* message);
+
+// Its binary counterpart, used while the binary backend is active so that nothing gets formatted:
+// receives the raw record (format string address and arguments encoded by log_binary_encode())
+typedef void (*log_binary_sink_t)(log_level_t level, log_category_t category, const char* format,
+                                  const uint32_t* args, uint8_t nwords, uint8_t flags);
+
 // Global log level - messages below this level are filtered out
 extern log_level_t g_current_log_level;
 
 // Category enable/disable flags
 extern bool g_log_category_enabled[LOG_CAT_COUNT];
 
+// Active output backend
+extern log_backend_t g_log_backend;
+
 // Initialization
 void log_init(void);
 void log_set_level(log_level_t level);
 void log_enable_category(log_category_t category, bool enabled);
+void log_set_backend(log_backend_t backend);
+void log_set_sink(log_sink_t sink, log_binary_sink_t binary_sink, log_level_t min_level);
+
+// Ship deferred binary records - call from the main loop when idle
+void log_process(void);
+
+// Measure the per-call cost of each backend and report it over the log
+void log_benchmark(uint32_t iterations);
 
 // Core logging function
 void log_message(log_level_t level, log_category_t category, const char* format, ...);
 
+// Runtime filter, inlined at each call site so filtered messages skip the call
+static inline bool log_is_enabled(log_level_t level, log_category_t category) {
+    return level >= g_current_log_level && g_log_category_enabled[category];
+}
+
+// Compile-time filter (constant-folded away when the level/category is compiled out)
+#define LOG_COMPILED_IN(level, category) \
+    ((level) >= LOG_COMPILE_LEVEL && (LOG_COMPILE_CATEGORIES & LOG_CAT_BIT(category)) != 0)
+
+// Both checks run before any argument is evaluated
+#define LOG_AT(level, category, ...) \
+    do { \
+        if (LOG_COMPILED_IN(level, category) && log_is_enabled(level, category)) { \
+            log_message(level, category, __VA_ARGS__); \
+        } \
+    } while (0)
+
 // Convenience macros for different log levels
-#define LOG_DEBUG(category, ...) log_message(LOG_LEVEL_DEBUG, category, __VA_ARGS__)
-#define LOG_INFO(category, ...)  log_message(LOG_LEVEL_INFO, category, __VA_ARGS__)
-#define LOG_WARN(category, ...)  log_message(LOG_LEVEL_WARN, category, __VA_ARGS__)
-#define LOG_ERROR(category, ...) log_message(LOG_LEVEL_ERROR, category, __VA_ARGS__)
-#define LOG_FATAL(category, ...) log_message(LOG_LEVEL_FATAL, category, __VA_ARGS__)
+#define LOG_DEBUG(category, ...) LOG_AT(LOG_LEVEL_DEBUG, category, __VA_ARGS__)
+#define LOG_INFO(category, ...)  LOG_AT(LOG_LEVEL_INFO, category, __VA_ARGS__)
+#define LOG_WARN(category, ...)  LOG_AT(LOG_LEVEL_WARN, category, __VA_ARGS__)
+#define LOG_ERROR(category, ...) LOG_AT(LOG_LEVEL_ERROR, category, __VA_ARGS__)
+#define LOG_FATAL(category, ...) LOG_AT(LOG_LEVEL_FATAL, category, __VA_ARGS__)
 
 // Convenience macros for specific categories
 #define LOG_SYS_INFO(...)     LOG_INFO(LOG_CAT_SYSTEM, __VA_ARGS__)
+#define LOG_SYS_WARN(...)     LOG_WARN(LOG_CAT_SYSTEM, __VA_ARGS__)
 #define LOG_SYS_ERROR(...)    LOG_ERROR(LOG_CAT_SYSTEM, __VA_ARGS__)
 #define LOG_SYS_DEBUG(...)    LOG_DEBUG(LOG_CAT_SYSTEM, __VA_ARGS__)
 
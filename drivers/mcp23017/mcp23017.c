@@ -8,6 +8,7 @@
 #include "../logging/logging.h"
 #include "pico/stdlib.h"
 #include "hardware/i2c.h"
+#include "bsp_i2c.h"
 #include <stdio.h>
 
 // MCP23017 Register addresses (IOCON.BANK = 0)
@@ -39,9 +40,13 @@
 #define MCP23017_I2C_TIMEOUT_US 10000
 
 // Private functions
+// Every transfer holds the BSP bus lock (valves may switch from the step interrupt); read-modify-writes hold
+// it across both, so an interrupt cannot write the same latch in between
 static bool mcp23017_write_register(mcp23017_device_t* device, uint8_t reg, uint8_t value) {
     uint8_t data[2] = {reg, value};
+    bsp_i2c_lock();
     int result = i2c_write_timeout_us(MCP23017_I2C_INSTANCE, device->i2c_addr, data, 2, false, MCP23017_I2C_TIMEOUT_US);
+    bsp_i2c_unlock();
     
     if (result < 0) {
         LOG_HARDWARE_ERROR("MCP23017: Failed to write register 0x%02X to device 0x%02X", reg, device->i2c_addr);
@@ -54,14 +59,17 @@ static bool mcp23017_read_register(mcp23017_device_t* device, uint8_t reg, uint8
     if (!value) return false;
     
     // Write register address
+    bsp_i2c_lock();
     int result = i2c_write_timeout_us(MCP23017_I2C_INSTANCE, device->i2c_addr, &reg, 1, true, MCP23017_I2C_TIMEOUT_US);
     if (result < 0) {
+        bsp_i2c_unlock();
         LOG_HARDWARE_ERROR("MCP23017: Failed to write register address 0x%02X to device 0x%02X", reg, device->i2c_addr);
         return false;
     }
     
     // Read the value
     result = i2c_read_timeout_us(MCP23017_I2C_INSTANCE, device->i2c_addr, value, 1, false, MCP23017_I2C_TIMEOUT_US);
+    bsp_i2c_unlock();
     if (result < 0) {
         LOG_HARDWARE_ERROR("MCP23017: Failed to read register 0x%02X from device 0x%02X", reg, device->i2c_addr);
         return false;
@@ -118,7 +126,9 @@ bool mcp23017_set_pin_direction(mcp23017_device_t* device, mcp23017_pin_t pin, m
     
     // Read current direction register
     uint8_t current_value;
+    bsp_i2c_lock();
     if (!mcp23017_read_register(device, reg, &current_value)) {
+        bsp_i2c_unlock();
         return false;
     }
     
@@ -129,7 +139,9 @@ bool mcp23017_set_pin_direction(mcp23017_device_t* device, mcp23017_pin_t pin, m
         current_value &= ~(1 << bit_pos);  // Clear bit for output
     }
     
-    return mcp23017_write_register(device, reg, current_value);
+    bool ok = mcp23017_write_register(device, reg, current_value);
+    bsp_i2c_unlock();
+    return ok;
 }
 
 bool mcp23017_write_pin(mcp23017_device_t* device, mcp23017_pin_t pin, mcp23017_state_t state) {
@@ -140,7 +152,9 @@ bool mcp23017_write_pin(mcp23017_device_t* device, mcp23017_pin_t pin, mcp23017_
     
     // Read current output latch
     uint8_t current_value;
+    bsp_i2c_lock();
     if (!mcp23017_read_register(device, reg, &current_value)) {
+        bsp_i2c_unlock();
         return false;
     }
     
@@ -151,7 +165,9 @@ bool mcp23017_write_pin(mcp23017_device_t* device, mcp23017_pin_t pin, mcp23017_
         current_value &= ~(1 << bit_pos);  // Clear bit
     }
     
-    return mcp23017_write_register(device, reg, current_value);
+    bool ok = mcp23017_write_register(device, reg, current_value);
+    bsp_i2c_unlock();
+    return ok;
 }
 
 bool mcp23017_read_pin(mcp23017_device_t* device, mcp23017_pin_t pin, mcp23017_state_t* state) {
@@ -188,6 +204,61 @@ bool mcp23017_read_port(mcp23017_device_t* device, mcp23017_port_t port, uint8_t
     return mcp23017_read_register(device, reg, value);
 }
 
+bool mcp23017_update_port(mcp23017_device_t* device, mcp23017_port_t port, uint8_t mask, uint8_t value) {
+    if (!device || port > MCP23017_PORT_B) return false;
+    
+    uint8_t reg = (port == MCP23017_PORT_A) ? MCP23017_REG_OLATA : MCP23017_REG_OLATB;
+    
+    // Read current output latch, keep the pins outside the mask
+    uint8_t current_value;
+    bsp_i2c_lock();
+    if (!mcp23017_read_register(device, reg, &current_value)) {
+        bsp_i2c_unlock();
+        return false;
+    }
+    
+    bool ok = mcp23017_write_register(device, reg, (current_value & ~mask) | (value & mask));
+    bsp_i2c_unlock();
+    return ok;
+}
+
+bool mcp23017_read_all(mcp23017_device_t* device, uint16_t* value) {
+    if (!device || !value) return false;
+    
+    // Sequential read: GPIOA, then GPIOB (IOCON.SEQOP = 0)
+    uint8_t reg = MCP23017_REG_GPIOA;
+    uint8_t data[2];
+    bsp_i2c_lock();
+    int result = i2c_write_timeout_us(MCP23017_I2C_INSTANCE, device->i2c_addr, &reg, 1, true, MCP23017_I2C_TIMEOUT_US);
+    if (result >= 0) {
+        result = i2c_read_timeout_us(MCP23017_I2C_INSTANCE, device->i2c_addr, data, 2, false, MCP23017_I2C_TIMEOUT_US);
+    }
+    bsp_i2c_unlock();
+    if (result < 0) {
+        LOG_HARDWARE_ERROR("MCP23017: Failed to read GPIO ports from device 0x%02X", device->i2c_addr);
+        return false;
+    }
+    
+    *value = (uint16_t)data[0] | ((uint16_t)data[1] << 8);
+    return true;
+}
+
+bool mcp23017_write_all(mcp23017_device_t* device, uint16_t value) {
+    if (!device) return false;
+    
+    // Sequential write: OLATA, then OLATB in the same transaction
+    uint8_t data[3] = {MCP23017_REG_OLATA, (uint8_t)value, (uint8_t)(value >> 8)};
+    bsp_i2c_lock();
+    int result = i2c_write_timeout_us(MCP23017_I2C_INSTANCE, device->i2c_addr, data, 3, false, MCP23017_I2C_TIMEOUT_US);
+    bsp_i2c_unlock();
+    
+    if (result < 0) {
+        LOG_HARDWARE_ERROR("MCP23017: Failed to write output latches of device 0x%02X", device->i2c_addr);
+        return false;
+    }
+    return true;
+}
+
 bool mcp23017_set_pin_pullup(mcp23017_device_t* device, mcp23017_pin_t pin, bool enable) {
     if (!device || pin > MCP23017_PIN_B7) return false;
     
@@ -196,7 +267,9 @@ bool mcp23017_set_pin_pullup(mcp23017_device_t* device, mcp23017_pin_t pin, bool
     
     // Read current pullup register
     uint8_t current_value;
+    bsp_i2c_lock();
     if (!mcp23017_read_register(device, reg, &current_value)) {
+        bsp_i2c_unlock();
         return false;
     }
     
@@ -207,7 +280,9 @@ bool mcp23017_set_pin_pullup(mcp23017_device_t* device, mcp23017_pin_t pin, bool
         current_value &= ~(1 << bit_pos);  // Disable pullup
     }
     
-    return mcp23017_write_register(device, reg, current_value);
+    bool ok = mcp23017_write_register(device, reg, current_value);
+    bsp_i2c_unlock();
+    return ok;
 }
 
 bool mcp23017_stepper_enable(mcp23017_device_t* device) {
@@ -129,6 +129,16 @@ bool mcp23017_read_pin(mcp23017_device_t* device, mcp23017_pin_t pin, mcp23017_s
  */
 bool mcp23017_write_port(mcp23017_device_t* device, mcp23017_port_t port, uint8_t value);
 
+/**
+ * Change some pins of a port, leaving the others as they are (one read, one write)
+ * @param device Pointer to device structure
+ * @param port MCP23017_PORTA or MCP23017_PORTB
+ * @param mask Bit mask of the pins to change
+ * @param value New state of the masked pins
+ * @return true if successful, false otherwise
+ */
+bool mcp23017_update_port(mcp23017_device_t* device, mcp23017_port_t port, uint8_t mask, uint8_t value);
+
 /**
  * Read from an entire port (8 pins at once)
  * @param device Pointer to device structure
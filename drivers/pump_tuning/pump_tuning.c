@@ -0,0 +1,302 @@
+/**
+ * PicoFlora Pump Stall Detection and Speed Tuning Implementation
+ */
+
+#include "pump_tuning.h"
+#include "../stepper/stepper_driver.h"
+#include "../tmc2209/tmc2209.h"
+#include "../dosing/dosing.h"
+#include "../storage/settings_store.h"
+#include "pico/stdlib.h"
+#include "../logging/logging.h"
+#include <stdio.h>
+
+#define TCOOLTHRS_ALWAYS 0xFFFFF            // StallGuard output at every speed
+#define BASELINE_TRACK_SHIFT 4              // Baseline follows normal samples with weight 1/16
+
+// Tuning and monitor state
+static struct {
+    bool enabled;
+    stall_detector_t detector;
+    int32_t last_good_position;  // Driver position at the last sample without load
+    uint32_t last_sample_ms;
+
+    pump_tuning_state_t state;
+    uint32_t candidate_hz;
+    uint32_t best_hz;           // Fastest run without a stall
+    uint32_t saved_max_hz;      // Limit to restore if tuning fails
+
+    pump_tuning_cb_t callback;
+    pump_tuning_stats_t stats;
+} tuning;
+
+static const char *state_names[] = { "idle", "running", "done", "failed" };
+
+// Start learning at a new cruise speed
+static void restart_detector(stall_detector_t *detector, uint32_t freq_hz) {
+    detector->freq_hz = freq_hz;
+    detector->samples = 0;
+    detector->learned = 0;
+    detector->baseline_q4 = 0;
+    detector->low_count = 0;
+}
+
+void stall_detector_reset(stall_detector_t *detector, uint32_t freq_hz) {
+    restart_detector(detector, freq_hz);
+    detector->reference_hz = 0;
+    detector->reference_q4 = 0;
+}
+
+stall_verdict_t stall_detector_sample(stall_detector_t *detector, uint16_t sg_result, uint32_t freq_hz) {
+    uint32_t learn_end = PUMP_TUNING_SETTLE_SAMPLES + PUMP_TUNING_LEARN_SAMPLES;
+    if (freq_hz != detector->freq_hz) {
+        if (detector->samples > learn_end && detector->learned > 0) {
+            detector->reference_hz = detector->freq_hz;
+            detector->reference_q4 = detector->baseline_q4;
+        }
+        restart_detector(detector, freq_hz);
+    }
+    detector->samples++;
+
+    uint32_t sample_q4 = (uint32_t)sg_result << 4;
+    bool low = sg_result <= PUMP_TUNING_STALL_FLOOR;
+
+    if (detector->samples > learn_end) {
+        // Compare against the baseline, and let it follow slow drift while the load is normal
+        if (detector->learned > 0) {
+            low = low || sample_q4 * 100 < detector->baseline_q4 * PUMP_TUNING_STALL_PERCENT;
+            if (!low) {
+                int32_t delta = (int32_t)sample_q4 - (int32_t)detector->baseline_q4;
+                detector->baseline_q4 = (uint32_t)((int32_t)detector->baseline_q4 + delta / (1 << BASELINE_TRACK_SHIFT));
+            }
+        }
+    } else {
+        // Learning: sum now, average once the last learning sample is in
+        if (detector->samples > PUMP_TUNING_SETTLE_SAMPLES && !low) {
+            detector->baseline_q4 += sample_q4;
+            detector->learned++;
+        }
+        if (detector->samples == learn_end && detector->learned > 0) {
+            detector->baseline_q4 /= detector->learned;
+
+            // Faster than before, but the load margin collapsed: stalling since it got here
+            if (detector->freq_hz > detector->reference_hz && detector->reference_q4 > 0 &&
+                detector->baseline_q4 * 100 < detector->reference_q4 * PUMP_TUNING_STALL_PERCENT) {
+                detector->low_count = PUMP_TUNING_CONFIRM_SAMPLES - 1;
+                low = true;
+            }
+        }
+    }
+
+    if (!low) {
+        detector->low_count = 0;
+        return STALL_NONE;
+    }
+    return ++detector->low_count >= PUMP_TUNING_CONFIRM_SAMPLES ? STALL_DETECTED : STALL_SUSPECT;
+}
+
+void pump_tuning_init(void) {
+    tuning.enabled = false;
+    tuning.state = PUMP_TUNING_IDLE;
+    tuning.stats = (pump_tuning_stats_t){ 0 };
+    stall_detector_reset(&tuning.detector, 0);
+
+    // StallGuard4 only works in StealthChop
+    if (!tmc2209_is_present() ||
+        !tmc2209_set_stealthchop(true) ||
+        !tmc2209_set_stallguard(0, TCOOLTHRS_ALWAYS)) {
+        LOG_STEPPER_WARN("No TMC2209 - pump stall detection disabled");
+        return;
+    }
+
+    tuning.enabled = true;
+    LOG_STEPPER_INFO("Pump stall detection enabled (SG_RESULT every %d ms at cruise)", PUMP_TUNING_SAMPLE_MS);
+}
+
+void pump_tuning_set_callback(pump_tuning_cb_t callback) {
+    tuning.callback = callback;
+}
+
+static void start_run(void) {
+    // Long enough to learn a baseline at cruise, plus both ramps
+    int32_t steps = (int32_t)(tuning.candidate_hz * PUMP_TUNING_CRUISE_MS / 1000);
+    steps += 2 * (int32_t)stepper_driver_get_accel_steps(steps);
+
+    LOG_STEPPER_INFO("Tuning run at %lu Hz (%ld steps)", tuning.candidate_hz, steps);
+    stepper_driver_start_at(steps, tuning.candidate_hz);
+}
+
+static void finish_tuning(bool stalled) {
+    uint32_t min_hz = stepper_driver_get_min_frequency();
+    uint32_t tuned_hz = stalled ? tuning.best_hz * PUMP_TUNING_MARGIN_PERCENT / 100 : tuning.best_hz;
+
+    if (tuning.callback) {
+        tuning.callback(false);
+    }
+
+    if (tuned_hz <= min_hz) {
+        LOG_STEPPER_ERROR("Pump tuning found no reliable speed above %lu Hz", min_hz);
+        stepper_driver_set_frequency_limits(min_hz, tuning.saved_max_hz);
+        tuning.state = PUMP_TUNING_FAILED;
+        return;
+    }
+
+    stepper_driver_set_frequency_limits(min_hz, tuned_hz);
+    settings_set_u32(SETTINGS_KEY_STEPPER_MAX_HZ, tuned_hz);
+    tuning.stats.tuned_hz = tuned_hz;
+    tuning.state = PUMP_TUNING_DONE;
+    LOG_STEPPER_INFO("Pump tuned: clean up to %lu Hz%s, maximum set to %lu Hz",
+                     tuning.best_hz, stalled ? "" : " (driver limit)", tuned_hz);
+}
+
+bool pump_tuning_start(void) {
+    if (!tuning.enabled || tuning.state == PUMP_TUNING_RUNNING ||
+        stepper_driver_is_running() || dosing_is_busy()) {
+        return false;
+    }
+
+    // Real water against the real load, so only with somewhere for it to go
+    if (tuning.callback && !tuning.callback(true)) {
+        tuning.callback(false);
+        LOG_STEPPER_ERROR("Pump tuning not started: the hook could not route the pump");
+        return false;
+    }
+
+    // Try everything up to what the driver can do
+    uint32_t min_hz = stepper_driver_get_min_frequency();
+    tuning.saved_max_hz = stepper_driver_get_max_frequency();
+    if (!stepper_driver_set_frequency_limits(min_hz, stepper_driver_get_frequency_ceiling())) {
+        if (tuning.callback) {
+            tuning.callback(false);
+        }
+        return false;
+    }
+
+    tuning.best_hz = 0;
+    tuning.candidate_hz = PUMP_TUNING_START_HZ > min_hz ? PUMP_TUNING_START_HZ : min_hz + PUMP_TUNING_STEP_HZ;
+    tuning.state = PUMP_TUNING_RUNNING;
+    stall_detector_reset(&tuning.detector, 0);
+    LOG_STEPPER_INFO("Pump tuning from %lu Hz to %lu Hz", tuning.candidate_hz, stepper_driver_get_frequency_ceiling());
+    start_run();
+    return true;
+}
+
+void pump_tuning_cancel(void) {
+    if (tuning.state != PUMP_TUNING_RUNNING) {
+        return;
+    }
+
+    stepper_driver_stop();
+    stepper_driver_set_frequency_limits(stepper_driver_get_min_frequency(), tuning.saved_max_hz);
+    tuning.state = PUMP_TUNING_IDLE;
+    if (tuning.callback) {
+        tuning.callback(false);
+    }
+    LOG_STEPPER_WARN("Pump tuning cancelled");
+}
+
+pump_tuning_state_t pump_tuning_get_state(void) {
+    return tuning.state;
+}
+
+// Next tuning run once the previous one has finished cleanly
+static void advance_tuning(void) {
+    if (stepper_driver_is_running()) {
+        return;
+    }
+    if (stepper_driver_get_state() != STEPPER_COMPLETED) {
+        pump_tuning_cancel();    // Stopped from outside
+        return;
+    }
+
+    tuning.best_hz = tuning.candidate_hz;
+    uint32_t ceiling = stepper_driver_get_frequency_ceiling();
+    if (tuning.candidate_hz >= ceiling) {
+        finish_tuning(false);
+        return;
+    }
+    tuning.candidate_hz += PUMP_TUNING_STEP_HZ;
+    if (tuning.candidate_hz > ceiling) {
+        tuning.candidate_hz = ceiling;
+    }
+    start_run();
+}
+
+// Stop and hand the undelivered volume back to dosing, to be retried below the stall speed
+static void handle_stall(uint32_t freq_hz) {
+    if (tuning.state == PUMP_TUNING_RUNNING) {
+        LOG_STEPPER_INFO("Tuning run stalled at %lu Hz", freq_hz);
+        stepper_driver_stop();
+        finish_tuning(true);
+        return;
+    }
+
+    tuning.stats.stalls++;
+    tuning.stats.last_stall_hz = freq_hz;
+    LOG_STEPPER_WARN("Pump stall at %lu Hz, step %ld", freq_hz, stepper_driver_get_current_steps());
+
+    // Only the retried dose slows down; the maximum frequency is left to tuning
+    uint32_t reduced_hz = freq_hz * PUMP_TUNING_BACKOFF_PERCENT / 100;
+    if (reduced_hz <= stepper_driver_get_min_frequency()) {
+        LOG_STEPPER_ERROR("Pump stalls at minimum speed - check tubing");
+    }
+
+    if (dosing_stall(tuning.last_good_position, reduced_hz)) {
+        tuning.stats.retries++;
+    } else {
+        stepper_driver_stop();
+    }
+}
+
+void pump_tuning_process(void) {
+    if (!tuning.enabled) {
+        return;
+    }
+
+    if (tuning.state == PUMP_TUNING_RUNNING) {
+        advance_tuning();
+    }
+
+    // Only at steady cruise: ramps and microstep switches move SG_RESULT on their own
+    if (stepper_driver_get_state() != STEPPER_RUNNING) {
+        tuning.last_good_position = stepper_driver_get_current_steps();
+        return;
+    }
+
+    uint32_t now_ms = to_ms_since_boot(get_absolute_time());
+    if (now_ms - tuning.last_sample_ms < PUMP_TUNING_SAMPLE_MS) {
+        return;
+    }
+    tuning.last_sample_ms = now_ms;
+
+    uint16_t sg_result;
+    if (!tmc2209_get_sg_result(&sg_result)) {
+        return;
+    }
+    tuning.stats.samples++;
+
+    uint32_t freq_hz = stepper_driver_get_current_frequency();
+    int32_t position = stepper_driver_get_current_steps();
+    stall_verdict_t verdict = stall_detector_sample(&tuning.detector, sg_result, freq_hz);
+    if (verdict == STALL_NONE) {
+        tuning.last_good_position = position;
+    } else if (verdict == STALL_DETECTED) {
+        stall_detector_reset(&tuning.detector, 0);
+        handle_stall(freq_hz);
+    }
+}
+
+void pump_tuning_get_stats(pump_tuning_stats_t *stats) {
+    *stats = tuning.stats;
+}
+
+void pump_tuning_dump(void) {
+    printf("TUNE enabled=%d state=%s max_hz=%lu ceiling_hz=%lu tuned_hz=%lu\n",
+           tuning.enabled, state_names[tuning.state], stepper_driver_get_max_frequency(),
+           stepper_driver_get_frequency_ceiling(), tuning.stats.tuned_hz);
+    printf("TUNE samples=%lu stalls=%lu retries=%lu last_stall_hz=%lu baseline=%lu at_hz=%lu\n",
+           tuning.stats.samples, tuning.stats.stalls, tuning.stats.retries, tuning.stats.last_stall_hz,
+           tuning.detector.samples > PUMP_TUNING_SETTLE_SAMPLES + PUMP_TUNING_LEARN_SAMPLES ?
+               tuning.detector.baseline_q4 >> 4 : 0,
+           tuning.detector.freq_hz);
+}
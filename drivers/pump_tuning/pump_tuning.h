@@ -0,0 +1,105 @@
+/**
+ * PicoFlora Pump Stall Detection and Speed Tuning
+ *
+ * Sensorless stall detection from the TMC2209's StallGuard value, polled over
+ * UART while the pump cruises. SG_RESULT depends strongly on speed, tubing and
+ * load, so there is no fixed threshold: every time the pump settles at a new
+ * cruise speed the detector learns a baseline from a few samples, then
+ * reports a stall when the value falls below a fraction of it (or near zero)
+ * for consecutive samples. The baseline keeps following slow drift such as
+ * tubing warming up. A motor that is already stalling when it reaches a
+ * higher speed is caught by comparing the new baseline with the one learned
+ * at the previous, slower speed.
+ *
+ * Tuning ramps the pump through increasing cruise frequencies, one short
+ * move each, until the first stall. The highest speed that ran clean, less a
+ * safety margin, becomes the maximum step frequency and is stored in the
+ * settings store, where the stepper setup picks it up at boot.
+ *
+ * During normal operation a stall stops the pump and hands the undelivered
+ * volume back to the dose queue, to be retried below the speed it stalled
+ * at. The maximum frequency is not touched; only tuning changes it.
+ *
+ * Needs a TMC2209 on the UART; without one, pump_tuning_process() does
+ * nothing. Polling costs one ~1.5 ms register read per sample.
+ */
+
+#ifndef PUMP_TUNING_H
+#define PUMP_TUNING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Configuration
+#define PUMP_TUNING_SAMPLE_MS 20            // SG_RESULT polling interval while cruising
+#define PUMP_TUNING_SETTLE_SAMPLES 3        // Ignored after reaching a new cruise speed
+#define PUMP_TUNING_LEARN_SAMPLES 8         // Averaged into the baseline
+#define PUMP_TUNING_STALL_PERCENT 40        // Stall below this share of the baseline
+#define PUMP_TUNING_STALL_FLOOR 10          // SG_RESULT this low is a stall at any baseline
+#define PUMP_TUNING_CONFIRM_SAMPLES 2       // Consecutive low samples before a stall is reported
+#define PUMP_TUNING_START_HZ 4000           // First cruise frequency tried
+#define PUMP_TUNING_STEP_HZ 1000            // Increment between tuning runs
+#define PUMP_TUNING_CRUISE_MS 1500          // Cruise time of each tuning run
+#define PUMP_TUNING_MARGIN_PERCENT 90       // Tuned maximum = fastest clean speed * margin
+#define PUMP_TUNING_BACKOFF_PERCENT 85      // Retry speed after a stall = stall speed * backoff
+
+// Detector verdict for one sample
+typedef enum {
+    STALL_NONE,
+    STALL_SUSPECT,              // Low, not yet confirmed
+    STALL_DETECTED
+} stall_verdict_t;
+
+// Detector state, one per monitored motor
+typedef struct {
+    uint32_t freq_hz;           // Cruise speed the baseline belongs to
+    uint32_t samples;           // Samples since the speed was reached
+    uint32_t learned;           // Samples in the baseline
+    uint32_t baseline_q4;       // Learned SG_RESULT (Q4), a sum while learning
+    uint32_t low_count;
+    uint32_t reference_hz;      // Previous cruise speed and its baseline
+    uint32_t reference_q4;
+} stall_detector_t;
+
+// Tuning state
+typedef enum {
+    PUMP_TUNING_IDLE,
+    PUMP_TUNING_RUNNING,
+    PUMP_TUNING_DONE,
+    PUMP_TUNING_FAILED
+} pump_tuning_state_t;
+
+// Statistics
+typedef struct {
+    uint32_t samples;
+    uint32_t stalls;            // Stalls during normal operation
+    uint32_t retries;           // ... of which the doses were retried
+    uint32_t last_stall_hz;
+    uint32_t tuned_hz;          // Result of the last tuning, 0 = none
+} pump_tuning_stats_t;
+
+// Hook called with true when tuning starts pumping and false when it ends (open a zone valve).
+// False from the 'true' call means there is nowhere to pump to: tuning does not start.
+typedef bool (*pump_tuning_cb_t)(bool active);
+
+// Detector (pure, no hardware access); reset forgets the previous speed's baseline too
+void stall_detector_reset(stall_detector_t *detector, uint32_t freq_hz);
+stall_verdict_t stall_detector_sample(stall_detector_t *detector, uint16_t sg_result, uint32_t freq_hz);
+
+// Initialization - enables StallGuard on the TMC2209
+void pump_tuning_init(void);
+void pump_tuning_set_callback(pump_tuning_cb_t callback);
+
+// Tuning run
+bool pump_tuning_start(void);
+void pump_tuning_cancel(void);
+pump_tuning_state_t pump_tuning_get_state(void);
+
+// Monitor and tuning (call from the main loop right after stepper_driver_update)
+void pump_tuning_process(void);
+
+// Diagnostics
+void pump_tuning_get_stats(pump_tuning_stats_t *stats);
+void pump_tuning_dump(void);
+
+#endif // PUMP_TUNING_H
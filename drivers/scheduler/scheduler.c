@@ -0,0 +1,284 @@
+/**
+ * PicoFlora Watering Scheduler Implementation
+ */
+
+#include "scheduler.h"
+#include "pico/stdlib.h"
+#include "hardware/timer.h"
+#include "../logging/logging.h"
+#include <stdio.h>
+#include <string.h>
+
+#define HEAP_NONE 0xFFFF
+
+// 1970-01-01 was a Thursday
+#define EPOCH_WEEKDAY 4
+
+// Scheduler state
+static struct {
+    schedule_rule_t rules[SCHEDULER_MAX_RULES];
+    bool in_use[SCHEDULER_MAX_RULES];
+    uint32_t due[SCHEDULER_MAX_RULES];          // Next occurrence per rule
+
+    // Min-heap of rule ids ordered by due time, plus each rule's heap position
+    uint16_t heap[SCHEDULER_MAX_RULES];
+    uint16_t heap_pos[SCHEDULER_MAX_RULES];
+    uint32_t heap_size;
+
+    uint32_t alarm_programmed;                  // Last value handed to the alarm hook
+    scheduler_event_cb_t event_callback;
+    scheduler_alarm_cb_t alarm_callback;
+    uint32_t zone_count;
+
+    // Wall clock = base + elapsed system time
+    uint32_t clock_base;
+    uint64_t clock_base_us;
+} sched;
+
+static inline void heap_swap(uint32_t a, uint32_t b) {
+    uint16_t id_a = sched.heap[a];
+    uint16_t id_b = sched.heap[b];
+    sched.heap[a] = id_b;
+    sched.heap[b] = id_a;
+    sched.heap_pos[id_b] = (uint16_t)a;
+    sched.heap_pos[id_a] = (uint16_t)b;
+}
+
+static inline bool heap_less(uint32_t a, uint32_t b) {
+    return sched.due[sched.heap[a]] < sched.due[sched.heap[b]];
+}
+
+static void sift_up(uint32_t i) {
+    while (i > 0) {
+        uint32_t parent = (i - 1) / 2;
+        if (!heap_less(i, parent)) {
+            break;
+        }
+        heap_swap(i, parent);
+        i = parent;
+    }
+}
+
+static void sift_down(uint32_t i) {
+    while (true) {
+        uint32_t smallest = i;
+        uint32_t left = 2 * i + 1;
+        uint32_t right = left + 1;
+
+        if (left < sched.heap_size && heap_less(left, smallest)) {
+            smallest = left;
+        }
+        if (right < sched.heap_size && heap_less(right, smallest)) {
+            smallest = right;
+        }
+        if (smallest == i) {
+            break;
+        }
+        heap_swap(i, smallest);
+        i = smallest;
+    }
+}
+
+static void heap_insert(int rule_id) {
+    uint32_t i = sched.heap_size++;
+    sched.heap[i] = (uint16_t)rule_id;
+    sched.heap_pos[rule_id] = (uint16_t)i;
+    sift_up(i);
+}
+
+static void heap_remove(int rule_id) {
+    uint32_t i = sched.heap_pos[rule_id];
+    uint32_t last = --sched.heap_size;
+
+    if (i != last) {
+        // Move the last element into the hole, then restore order in whichever direction it needs
+        heap_swap(i, last);
+        uint16_t moved = sched.heap[i];
+        sift_up(i);
+        sift_down(sched.heap_pos[moved]);
+    }
+    sched.heap_pos[rule_id] = HEAP_NONE;
+}
+
+// Re-position a rule after its due time changed
+static void heap_update(int rule_id) {
+    uint32_t i = sched.heap_pos[rule_id];
+    sift_up(i);
+    sift_down(sched.heap_pos[rule_id]);
+}
+
+// Tell the alarm hook when the earliest event has moved
+static void update_alarm(void) {
+    uint32_t next = scheduler_next_due();
+    if (next != sched.alarm_programmed) {
+        sched.alarm_programmed = next;
+        if (sched.alarm_callback) {
+            sched.alarm_callback(next);
+        }
+    }
+}
+
+static bool rule_is_valid(const schedule_rule_t *rule) {
+    if (rule->zone >= sched.zone_count || rule->volume_ml == 0 || rule->volume_ml > SCHEDULER_MAX_VOLUME_ML) {
+        return false;
+    }
+    if (rule->type == SCHEDULE_WEEKLY) {
+        return (rule->weekday_mask & SCHEDULE_EVERY_DAY) != 0 &&
+               rule->time_of_day_s < SCHEDULER_SECONDS_PER_DAY;
+    }
+    if (rule->type == SCHEDULE_INTERVAL) {
+        return rule->interval_s > 0;
+    }
+    return false;
+}
+
+void scheduler_init(void) {
+    memset(&sched, 0, sizeof(sched));
+    for (int i = 0; i < SCHEDULER_MAX_RULES; i++) {
+        sched.heap_pos[i] = HEAP_NONE;
+    }
+    sched.alarm_programmed = SCHEDULER_NEVER;
+    sched.zone_count = UINT8_MAX + 1;
+    sched.clock_base_us = time_us_64();
+    LOG_SYS_INFO("Scheduler initialized (%d rules max)", SCHEDULER_MAX_RULES);
+}
+
+void scheduler_set_event_callback(scheduler_event_cb_t callback) {
+    sched.event_callback = callback;
+}
+
+void scheduler_set_alarm_callback(scheduler_alarm_cb_t callback) {
+    sched.alarm_callback = callback;
+}
+
+void scheduler_set_zone_count(uint32_t count) {
+    sched.zone_count = count;
+}
+
+uint32_t scheduler_next_occurrence(const schedule_rule_t *rule, uint32_t after) {
+    if (rule->type == SCHEDULE_INTERVAL) {
+        if (after < rule->anchor) {
+            return rule->anchor;
+        }
+        uint64_t periods = (uint64_t)(after - rule->anchor) / rule->interval_s + 1;
+        uint64_t next = rule->anchor + periods * rule->interval_s;
+        return next < SCHEDULER_NEVER ? (uint32_t)next : SCHEDULER_NEVER;
+    }
+
+    // Weekly: at most a week ahead (8 days covers "today, but the time has passed")
+    uint32_t day = after / SCHEDULER_SECONDS_PER_DAY;
+    for (uint32_t i = 0; i <= 7; i++) {
+        uint64_t candidate = (uint64_t)(day + i) * SCHEDULER_SECONDS_PER_DAY + rule->time_of_day_s;
+        uint32_t weekday = (day + i + EPOCH_WEEKDAY) % 7;
+        if (candidate > after && (rule->weekday_mask & (1u << weekday))) {
+            return candidate < SCHEDULER_NEVER ? (uint32_t)candidate : SCHEDULER_NEVER;
+        }
+    }
+    return SCHEDULER_NEVER;
+}
+
+int scheduler_add_rule(const schedule_rule_t *rule, uint32_t now) {
+    if (!rule_is_valid(rule)) {
+        LOG_SYS_ERROR("Scheduler: invalid rule for zone %u", rule->zone);
+        return -1;
+    }
+
+    for (int id = 0; id < SCHEDULER_MAX_RULES; id++) {
+        if (!sched.in_use[id]) {
+            sched.in_use[id] = true;
+            sched.rules[id] = *rule;
+            // An occurrence exactly at 'now' still counts
+            sched.due[id] = scheduler_next_occurrence(rule, now > 0 ? now - 1 : 0);
+            heap_insert(id);
+            update_alarm();
+            return id;
+        }
+    }
+
+    LOG_SYS_ERROR("Scheduler: rule table full");
+    return -1;
+}
+
+bool scheduler_update_rule(int rule_id, const schedule_rule_t *rule, uint32_t now) {
+    if (rule_id < 0 || rule_id >= SCHEDULER_MAX_RULES || !sched.in_use[rule_id] || !rule_is_valid(rule)) {
+        return false;
+    }
+
+    sched.rules[rule_id] = *rule;
+    sched.due[rule_id] = scheduler_next_occurrence(rule, now > 0 ? now - 1 : 0);
+    heap_update(rule_id);
+    update_alarm();
+    return true;
+}
+
+bool scheduler_remove_rule(int rule_id) {
+    if (rule_id < 0 || rule_id >= SCHEDULER_MAX_RULES || !sched.in_use[rule_id]) {
+        return false;
+    }
+
+    heap_remove(rule_id);
+    sched.in_use[rule_id] = false;
+    update_alarm();
+    return true;
+}
+
+const schedule_rule_t* scheduler_get_rule(int rule_id) {
+    if (rule_id < 0 || rule_id >= SCHEDULER_MAX_RULES || !sched.in_use[rule_id]) {
+        return NULL;
+    }
+    return &sched.rules[rule_id];
+}
+
+uint32_t scheduler_get_rule_count(void) {
+    return sched.heap_size;
+}
+
+uint32_t scheduler_next_due(void) {
+    return sched.heap_size ? sched.due[sched.heap[0]] : SCHEDULER_NEVER;
+}
+
+uint32_t scheduler_process(uint32_t now) {
+    uint32_t fired = 0;
+
+    while (sched.heap_size > 0 && sched.due[sched.heap[0]] <= now) {
+        int id = sched.heap[0];
+        uint32_t due = sched.due[id];
+        schedule_rule_t rule = sched.rules[id];
+
+        // Reschedule first so the callback is free to add/update/remove rules
+        sched.due[id] = scheduler_next_occurrence(&rule, now);
+        heap_update(id);
+
+        if (sched.event_callback) {
+            sched.event_callback(id, &rule, due);
+        }
+        fired++;
+    }
+
+    update_alarm();
+    return fired;
+}
+
+void scheduler_sync_clock(uint32_t now) {
+    sched.clock_base = now;
+    sched.clock_base_us = time_us_64();
+}
+
+uint32_t scheduler_now(void) {
+    return sched.clock_base + (uint32_t)((time_us_64() - sched.clock_base_us) / 1000000);
+}
+
+void scheduler_dump(void) {
+    printf("SCHED begin rules=%lu now=%lu next=%lu\n",
+           sched.heap_size, scheduler_now(), scheduler_next_due());
+    for (int id = 0; id < SCHEDULER_MAX_RULES; id++) {
+        if (!sched.in_use[id]) {
+            continue;
+        }
+        const schedule_rule_t *rule = &sched.rules[id];
+        printf("SCHED rule=%d zone=%u type=%s volume_ml=%lu due=%lu\n",
+               id, rule->zone, rule->type == SCHEDULE_WEEKLY ? "weekly" : "interval",
+               rule->volume_ml, sched.due[id]);
+    }
+    printf("SCHED end\n");
+}
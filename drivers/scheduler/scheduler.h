@@ -0,0 +1,91 @@
+/**
+ * PicoFlora Watering Scheduler
+ *
+ * Recurring watering rules per zone (weekday mask + time of day, or a fixed
+ * interval) with their next occurrences kept in a binary min-heap. Adding,
+ * changing or removing a rule and firing an event are O(log n); finding the
+ * next event is O(1).
+ *
+ * Time is wall-clock seconds since 1970 in RTC local time. The scheduler
+ * keeps its own clock from the system timer (synced from the RTC), so the
+ * main loop only compares two integers until an event is actually due.
+ * Whenever the next event changes the alarm hook is called, so the PCF85063
+ * alarm can wake the system instead of polling.
+ *
+ * The engine has no hardware dependencies besides the system timer and can
+ * be driven by any clock through scheduler_process().
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Configuration
+#define SCHEDULER_MAX_RULES 256
+#define SCHEDULER_NEVER UINT32_MAX              // No event scheduled
+#define SCHEDULER_SECONDS_PER_DAY 86400u
+#define SCHEDULER_MAX_VOLUME_ML 10000           // Largest amount per event
+
+// Rule types
+typedef enum {
+    SCHEDULE_WEEKLY = 0,        // At time_of_day_s on every weekday set in weekday_mask
+    SCHEDULE_INTERVAL           // Every interval_s starting at anchor
+} schedule_type_t;
+
+// Weekday mask bits (tm_wday numbering)
+#define SCHEDULE_SUNDAY    (1u << 0)
+#define SCHEDULE_MONDAY    (1u << 1)
+#define SCHEDULE_TUESDAY   (1u << 2)
+#define SCHEDULE_WEDNESDAY (1u << 3)
+#define SCHEDULE_THURSDAY  (1u << 4)
+#define SCHEDULE_FRIDAY    (1u << 5)
+#define SCHEDULE_SATURDAY  (1u << 6)
+#define SCHEDULE_EVERY_DAY 0x7Fu
+
+// Watering rule
+typedef struct {
+    schedule_type_t type;
+    uint8_t zone;               // Plant/zone the water goes to
+    uint8_t weekday_mask;       // WEEKLY: days to run on
+    uint32_t time_of_day_s;     // WEEKLY: seconds after midnight
+    uint32_t interval_s;        // INTERVAL: period in seconds
+    uint32_t anchor;            // INTERVAL: first occurrence
+    uint32_t volume_ml;         // Amount to dispense, 1 to SCHEDULER_MAX_VOLUME_ML
+} schedule_rule_t;
+
+// Hooks
+typedef void (*scheduler_event_cb_t)(int rule_id, const schedule_rule_t *rule, uint32_t due);
+typedef void (*scheduler_alarm_cb_t)(uint32_t next_due);
+
+// Initialization
+void scheduler_init(void);
+void scheduler_set_event_callback(scheduler_event_cb_t callback);
+void scheduler_set_alarm_callback(scheduler_alarm_cb_t callback);
+// Rules may only water zones below 'count' (any uint8_t zone until set)
+void scheduler_set_zone_count(uint32_t count);
+
+// Rule management (rule ids are stable until the rule is removed)
+int scheduler_add_rule(const schedule_rule_t *rule, uint32_t now);
+bool scheduler_update_rule(int rule_id, const schedule_rule_t *rule, uint32_t now);
+bool scheduler_remove_rule(int rule_id);
+const schedule_rule_t* scheduler_get_rule(int rule_id);
+uint32_t scheduler_get_rule_count(void);
+
+// Next occurrence of a rule strictly after the given time
+uint32_t scheduler_next_occurrence(const schedule_rule_t *rule, uint32_t after);
+
+// Event dispatch - fires everything due at or before now, returns the number fired.
+// Occurrences missed while the system was off are fired once, then skipped ahead.
+uint32_t scheduler_process(uint32_t now);
+uint32_t scheduler_next_due(void);
+
+// Wall clock kept from the system timer
+void scheduler_sync_clock(uint32_t now);
+uint32_t scheduler_now(void);
+
+// Diagnostics
+void scheduler_dump(void);
+
+#endif // SCHEDULER_H
@@ -3,6 +3,12 @@
  * 
  * Uses PIO to generate precise step pulses with smooth acceleration/deceleration
  * Hardware-timed pulses eliminate software timing jitter
+ *
+ * The PIO is handed the move in counted chunks of at most STEPPER_CHUNK_STEPS
+ * steps, a few ahead. Each chunk's end interrupts: that gives the exact
+ * position so far, tops up the queue and calls the marks (positions set
+ * with stepper_driver_set_marks(), always a chunk end) on the exact step.
+ * Between chunk ends the position is estimated from the pulse rate.
  */
 
 #include "stepper_driver.h"
@@ -11,6 +17,7 @@
 #include "pico/stdlib.h"
 #include "hardware/clocks.h"
 #include "hardware/pio.h"
+#include "hardware/sync.h"
 #include "stepper.pio.h"
 #include <stdio.h>
 #include <math.h>
@@ -20,12 +27,31 @@
 #define STEPPER_PIO pio1
 #define STEPPER_PIO_SM 0
 
+#define STEPPER_CHUNK_SLOTS (STEPPER_CHUNKS_AHEAD + 1)  // The running chunk and the queued ones
+
+// A chunk handed to the PIO
+typedef struct {
+    int32_t end;  // Position once its last pulse is out
+    uint32_t pulses;
+    uint32_t divider;  // Logical steps per pulse
+    uint32_t marks;  // Marks reached at its end (count from the first)
+} stepper_chunk_t;
+
 // Driver state
 static struct {
     stepper_state_t state;
     int32_t current_steps;
     int32_t target_steps;
     uint32_t current_frequency;
+    uint32_t min_frequency;  // Runtime limits, within STEPPER_MIN/MAX_FREQ_HZ
+    uint32_t max_frequency;
+    uint32_t cruise_frequency;  // Constant-speed frequency of the current move
+    stepper_profile_t profile;  // Planned speed profile, NULL = built-in ramps
+    uint32_t ramp_slope_q16;  // Ramp slope of the current move, Hz per step (Q16)
+    uint32_t stop_freq_q16;  // Live speed while stopping (Q16)
+    bool pause_requested;  // Stopping ends in PAUSED instead of IDLE
+    bool resuming;  // Ramping back up after a pause
+    int32_t resume_from;  // Position the resume ramp starts at
     uint32_t step_counter;
     bool direction;  // true = forward, false = reverse
     absolute_time_t last_update_time;
@@ -35,13 +61,45 @@ static struct {
     bool pio_running;  // Track if PIO is currently running
     bool const_phase_printed;  // Flag to avoid repeated CONST messages
     uint32_t steps_at_last_update;  // For accurate step counting
+    uint32_t step_fraction;  // Partial step carried between updates (millionths)
+    stepper_microstep_cb_t microstep_switch;  // Changes the driver's resolution, NULL = fixed
+    uint32_t coarse_factor;  // Logical steps per pulse at the coarse resolution
+    uint32_t pulse_divider;  // Logical steps per pulse right now
+    uint32_t pulse_frequency;  // PIO pulse rate (current_frequency / pulse_divider)
+    bool switch_failed;  // Microstep switch refused during this move, stay fine
     gpio_pin_t *enable_pin;  // Optional enable pin (can be NULL)
     bool enable_pin_active;  // Track if enable pin is currently active
+    bool hold_enable;  // Keep the driver enabled between moves
+    spin_lock_t *lock;  // Chunk queue and marks, shared with the chunk interrupt
+    bool feeding;  // Chunks are being handed to the PIO
+    bool holding_marks;  // Microstep switch on: no chunk may reach a mark
+    bool mark_refused;  // A mark callback stopped the move, the stop is still to be finished
+    stepper_chunk_t chunks[STEPPER_CHUNK_SLOTS];
+    uint32_t chunk_head;
+    uint32_t chunk_count;
+    int32_t pushed_steps;  // Position at the end of the last chunk handed over
+    int32_t done_steps;  // Position at the end of the last finished chunk
+    int32_t marks[STEPPER_MAX_MARKS];
+    uint32_t mark_count;
+    uint32_t marks_pushed;  // Marks within the chunks handed over
+    uint32_t marks_done;  // Marks whose chunk has finished
+    uint32_t marks_called;
+    stepper_mark_cb_t mark_callback;
+    uint irq_num;
 } stepper_state = {
     .state = STEPPER_IDLE,
     .current_steps = 0,
     .target_steps = 0,
     .current_frequency = 0,
+    .min_frequency = STEPPER_MIN_FREQ_HZ,
+    .max_frequency = STEPPER_MAX_FREQ_HZ,
+    .cruise_frequency = STEPPER_MAX_FREQ_HZ,
+    .profile = NULL,
+    .ramp_slope_q16 = 0,
+    .stop_freq_q16 = 0,
+    .pause_requested = false,
+    .resuming = false,
+    .resume_from = 0,
     .step_counter = 0,
     .direction = true,
     .last_update_time = 0,
@@ -51,54 +109,322 @@ static struct {
     .pio_running = false,
     .const_phase_printed = false,
     .steps_at_last_update = 0,
+    .step_fraction = 0,
+    .microstep_switch = NULL,
+    .coarse_factor = 1,
+    .pulse_divider = 1,
+    .pulse_frequency = 0,
+    .switch_failed = false,
     .enable_pin = NULL,
-    .enable_pin_active = false
+    .enable_pin_active = false,
+    .hold_enable = false,
+    .lock = NULL,
+    .feeding = false,
+    .holding_marks = false,
+    .mark_refused = false,
+    .chunk_head = 0,
+    .chunk_count = 0,
+    .pushed_steps = 0,
+    .done_steps = 0,
+    .mark_count = 0,
+    .marks_pushed = 0,
+    .marks_done = 0,
+    .marks_called = 0,
+    .mark_callback = NULL,
+    .irq_num = 0
 };
 
 // Helper function to calculate frequency based on current position
 static uint32_t calculate_adaptive_accel_steps(void) {
+    return stepper_driver_get_accel_steps(stepper_state.target_steps);
+}
+
+uint32_t stepper_driver_get_accel_steps(int32_t total_steps) {
     // Adaptive acceleration steps: configurable percentage of total movement
-    int32_t adaptive_accel_steps = stepper_state.target_steps / STEPPER_ACCEL_DIVISOR;
+    int32_t adaptive_accel_steps = total_steps / STEPPER_ACCEL_DIVISOR;
     if (adaptive_accel_steps < STEPPER_MIN_ACCEL_STEPS) adaptive_accel_steps = STEPPER_MIN_ACCEL_STEPS;
     if (adaptive_accel_steps > STEPPER_MAX_ACCEL_STEPS) adaptive_accel_steps = STEPPER_MAX_ACCEL_STEPS;
     return adaptive_accel_steps;
 }
 
-static uint32_t calculate_target_frequency(void) {
+static uint32_t profile_frequency(void) {
     int32_t remaining_steps = stepper_state.target_steps - stepper_state.current_steps;
     
     if (remaining_steps <= 0) {
         return 0;  // Stop
     }
     
+    // Externally planned profile
+    if (stepper_state.profile) {
+        uint32_t freq = stepper_state.profile(stepper_state.current_steps);
+        return freq < stepper_state.min_frequency ? stepper_state.min_frequency : freq;
+    }
+    
     // Get adaptive acceleration steps
     int32_t adaptive_accel_steps = calculate_adaptive_accel_steps();
     
     // Acceleration phase
     if (stepper_state.current_steps < adaptive_accel_steps) {
         // Linear acceleration using integer math for consistency
-        uint32_t freq_range = STEPPER_MAX_FREQ_HZ - STEPPER_MIN_FREQ_HZ;
+        uint32_t freq_range = stepper_state.cruise_frequency - stepper_state.min_frequency;
         uint32_t accel_increment = (freq_range * stepper_state.current_steps) / adaptive_accel_steps;
-        uint32_t target_freq = STEPPER_MIN_FREQ_HZ + accel_increment;
+        uint32_t target_freq = stepper_state.min_frequency + accel_increment;
         return target_freq;
     }
     
     // Deceleration phase
     if (remaining_steps < adaptive_accel_steps) {
         // Linear deceleration using integer math for consistency
-        uint32_t freq_range = STEPPER_MAX_FREQ_HZ - STEPPER_MIN_FREQ_HZ;
+        uint32_t freq_range = stepper_state.cruise_frequency - stepper_state.min_frequency;
         uint32_t decel_increment = (freq_range * remaining_steps) / adaptive_accel_steps;
-        uint32_t target_freq = STEPPER_MIN_FREQ_HZ + decel_increment;
+        uint32_t target_freq = stepper_state.min_frequency + decel_increment;
         return target_freq;
     }
     
     // Constant speed phase - only log once when entering this phase
     if (!stepper_state.const_phase_printed) {
         LOG_STEPPER_DEBUG("Entering constant speed phase: freq=%lu Hz, accel_steps=%ld", 
-                         STEPPER_MAX_FREQ_HZ, adaptive_accel_steps);
+                         stepper_state.cruise_frequency, adaptive_accel_steps);
         stepper_state.const_phase_printed = true;
     }
-    return STEPPER_MAX_FREQ_HZ;
+    return stepper_state.cruise_frequency;
+}
+
+static uint32_t calculate_target_frequency(void) {
+    uint32_t freq = profile_frequency();
+    
+    // After a pause, ramp up from the minimum frequency until the profile is reached again
+    if (stepper_state.resuming && freq > 0) {
+        uint64_t gained = ((uint64_t)stepper_state.ramp_slope_q16 *
+                           (uint32_t)(stepper_state.current_steps - stepper_state.resume_from)) >> 16;
+        uint64_t limit = stepper_state.min_frequency + gained;
+        if (limit >= freq) {
+            stepper_state.resuming = false;
+        } else {
+            freq = (uint32_t)limit;
+        }
+    }
+    return freq;
+}
+
+// Set up a new move (common part of all start functions)
+static void begin_move(int32_t target_steps, uint32_t ramp_range_hz) {
+    stepper_state.current_steps = 0;
+    stepper_state.target_steps = target_steps;
+    stepper_state.state = STEPPER_ACCELERATING;
+    stepper_state.step_counter = 0;
+    stepper_state.last_update_time = get_absolute_time();
+    stepper_state.step_start_time = stepper_state.last_update_time;  // Track movement start time
+    stepper_state.steps_at_last_update = 0;
+    stepper_state.step_fraction = 0;
+    stepper_state.const_phase_printed = false;  // Reset for new movement
+    stepper_state.ramp_slope_q16 = (ramp_range_hz << 16) / stepper_driver_get_accel_steps(target_steps);
+    stepper_state.pause_requested = false;
+    stepper_state.resuming = false;
+    stepper_state.switch_failed = false;
+    stepper_state.pushed_steps = 0;
+    stepper_state.done_steps = 0;
+    stepper_state.marks_pushed = 0;
+    stepper_state.marks_done = 0;
+    stepper_state.marks_called = 0;
+    stepper_state.mark_refused = false;
+}
+
+// Hand chunks to the PIO until it has STEPPER_CHUNKS_AHEAD queued or the move is all handed over (lock held)
+static void feed_chunks(void) {
+    while (stepper_state.feeding && stepper_state.chunk_count < STEPPER_CHUNK_SLOTS &&
+           stepper_state.pushed_steps < stepper_state.target_steps) {
+        int32_t from = stepper_state.pushed_steps;
+        int32_t end = from + STEPPER_CHUNK_STEPS;
+        if (end > stepper_state.target_steps) end = stepper_state.target_steps;
+        if (stepper_state.marks_pushed < stepper_state.mark_count &&
+            stepper_state.marks[stepper_state.marks_pushed] < end) {
+            end = stepper_state.marks[stepper_state.marks_pushed];
+        }
+        
+        // At coarse steps the chunk ends on the nearest pulse
+        uint32_t divider = stepper_state.pulse_divider;
+        uint32_t pulses = ((uint32_t)(end - from) + divider / 2) / divider;
+        if (pulses == 0) {
+            if (end == stepper_state.target_steps) {
+                stepper_state.pushed_steps = end;  // Less than half a pulse short of the end
+                break;
+            }
+            pulses = 1;
+        }
+        end = from + (int32_t)(pulses * divider);
+        if (stepper_state.holding_marks && stepper_state.marks_pushed < stepper_state.mark_count &&
+            stepper_state.marks[stepper_state.marks_pushed] <= end) {
+            break;
+        }
+        while (stepper_state.marks_pushed < stepper_state.mark_count &&
+               stepper_state.marks[stepper_state.marks_pushed] <= end) {
+            stepper_state.marks_pushed++;
+        }
+        
+        stepper_chunk_t *chunk = &stepper_state.chunks[(stepper_state.chunk_head + stepper_state.chunk_count) %
+                                                       STEPPER_CHUNK_SLOTS];
+        chunk->end = end;
+        chunk->pulses = pulses;
+        chunk->divider = divider;
+        chunk->marks = stepper_state.marks_pushed;
+        stepper_state.chunk_count++;
+        stepper_state.pushed_steps = end;
+        stepper_step_push(STEPPER_PIO, STEPPER_PIO_SM, pulses);
+    }
+}
+
+// The oldest 'count' chunks are out (lock held)
+static void finish_chunks(uint32_t count) {
+    while (count-- > 0 && stepper_state.chunk_count > 0) {
+        stepper_chunk_t *chunk = &stepper_state.chunks[stepper_state.chunk_head];
+        stepper_state.done_steps = chunk->end;
+        stepper_state.marks_done = chunk->marks;
+        stepper_state.chunk_head = (stepper_state.chunk_head + 1) % STEPPER_CHUNK_SLOTS;
+        stepper_state.chunk_count--;
+    }
+}
+
+// Marks reached since the last call, outside the lock; false if a callback refused to go on
+static bool call_marks(void) {
+    bool go_on = true;
+    while (stepper_state.marks_called < stepper_state.marks_done) {
+        uint32_t mark = stepper_state.marks_called++;
+        if (stepper_state.mark_callback && !stepper_state.mark_callback(mark)) {
+            go_on = false;
+        }
+    }
+    return go_on;
+}
+
+// RX FIFO not empty: chunks have finished
+static void stepper_chunk_irq(void) {
+    uint32_t irq_state = spin_lock_blocking(stepper_state.lock);
+    finish_chunks(stepper_step_take_done(STEPPER_PIO, STEPPER_PIO_SM));
+    feed_chunks();
+    spin_unlock(stepper_state.lock, irq_state);
+    if (!call_marks()) {
+        // Only the pulses sent during the callback get past the mark; the position is read back on the stop
+        stepper_step_stop(STEPPER_PIO, STEPPER_PIO_SM);
+        irq_state = spin_lock_blocking(stepper_state.lock);
+        stepper_state.feeding = false;
+        stepper_state.mark_refused = true;
+        spin_unlock(stepper_state.lock, irq_state);
+    }
+}
+
+// Stop the pulses where they are and take the exact position; the queued chunks are dropped
+static void halt_pulses(void) {
+    stepper_step_stop(STEPPER_PIO, STEPPER_PIO_SM);
+    
+    uint32_t irq_state = spin_lock_blocking(stepper_state.lock);
+    finish_chunks(stepper_step_take_done(STEPPER_PIO, STEPPER_PIO_SM));
+    int32_t position = stepper_state.done_steps;
+    if (stepper_state.chunk_count > 0) {
+        stepper_chunk_t *chunk = &stepper_state.chunks[stepper_state.chunk_head];
+        uint32_t left = stepper_step_remaining(STEPPER_PIO, STEPPER_PIO_SM, stepper_state.pio_offset, chunk->pulses);
+        if (left == 0) {
+            finish_chunks(1);  // Stopped between its last pulse and the interrupt
+            position = stepper_state.done_steps;
+        } else {
+            position = chunk->end - (int32_t)(left * chunk->divider);
+        }
+    }
+    stepper_step_clear(STEPPER_PIO, STEPPER_PIO_SM, stepper_state.pio_offset);
+    stepper_state.feeding = false;
+    stepper_state.chunk_count = 0;
+    stepper_state.current_steps = position;
+    stepper_state.done_steps = position;
+    stepper_state.pushed_steps = position;
+    stepper_state.marks_pushed = stepper_state.marks_done;
+    spin_unlock(stepper_state.lock, irq_state);
+    if (!call_marks()) {
+        stepper_state.mark_refused = true;
+    }
+}
+
+// Pulses already handed over keep their count but move 'divider' steps each from here on
+static void rebase_chunks(uint32_t divider) {
+    stepper_step_stop(STEPPER_PIO, STEPPER_PIO_SM);
+    uint32_t irq_state = spin_lock_blocking(stepper_state.lock);
+    finish_chunks(stepper_step_take_done(STEPPER_PIO, STEPPER_PIO_SM));
+    int32_t position = stepper_state.done_steps;
+    for (uint32_t i = 0; i < stepper_state.chunk_count; i++) {
+        stepper_chunk_t *chunk = &stepper_state.chunks[(stepper_state.chunk_head + i) % STEPPER_CHUNK_SLOTS];
+        uint32_t left = chunk->pulses;
+        if (i == 0) {
+            left = stepper_step_remaining(STEPPER_PIO, STEPPER_PIO_SM, stepper_state.pio_offset, left);
+            position = chunk->end - (int32_t)(left * chunk->divider);
+        }
+        chunk->end = position + (int32_t)(left * divider);
+        chunk->divider = divider;
+        position = chunk->end;
+    }
+    stepper_state.pushed_steps = position;
+    stepper_state.pulse_divider = divider;
+    stepper_state.holding_marks = false;
+    feed_chunks();
+    bool refused = stepper_state.mark_refused;
+    spin_unlock(stepper_state.lock, irq_state);
+    if (!refused) {
+        stepper_step_start(STEPPER_PIO, STEPPER_PIO_SM);
+    }
+}
+
+// Before a microstep switch: false if a mark lies within the chunks handed over (their ends have
+// to stay where they are), else no further chunk may reach one until rebase_chunks()
+static bool hold_marks(void) {
+    uint32_t irq_state = spin_lock_blocking(stepper_state.lock);
+    bool free = stepper_state.marks_pushed == stepper_state.marks_done;
+    stepper_state.holding_marks = free;
+    spin_unlock(stepper_state.lock, irq_state);
+    return free;
+}
+
+// Logical steps per pulse for a frequency: coarse steps only above what fine steps can reach
+static uint32_t select_pulse_divider(uint32_t frequency_hz) {
+    if (!stepper_state.microstep_switch || stepper_state.switch_failed || frequency_hz == 0) {
+        return 1;
+    }
+    
+    uint32_t threshold = STEPPER_MAX_FREQ_HZ;
+    if (stepper_state.pulse_divider > 1) {
+        // Stay coarse a little below, but never let the pulse rate drop under the PIO's range
+        uint32_t floor = STEPPER_MIN_FREQ_HZ * stepper_state.coarse_factor;
+        threshold -= STEPPER_MICROSTEP_HYSTERESIS_HZ;
+        if (threshold < floor) threshold = floor;
+    }
+    return frequency_hz > threshold ? stepper_state.coarse_factor : 1;
+}
+
+// Switch the driver's resolution; the PIO rate is changed right after, so at most one pulse has the wrong size.
+// Chunks handed over are re-counted in the new step size, to within the pulses sent during the switch
+// (taken at the old size); so no switch while a mark is among them, it waits until the mark has passed.
+static void apply_pulse_divider(uint32_t divider) {
+    if (divider == stepper_state.pulse_divider) {
+        return;
+    }
+    if (stepper_state.pio_running && !hold_marks()) {
+        return;
+    }
+    
+    uint16_t microsteps = (uint16_t)(STEPPER_MICROSTEPS / divider);
+    if (!stepper_state.microstep_switch(microsteps)) {
+        if (divider > 1) {
+            LOG_STEPPER_WARN("Microstep switch failed, staying at 1/%u", STEPPER_MICROSTEPS);
+            stepper_state.switch_failed = true;
+            if (stepper_state.pio_running) {
+                rebase_chunks(stepper_state.pulse_divider);
+            }
+            return;
+        }
+        LOG_STEPPER_ERROR("Failed to restore 1/%u microstepping", STEPPER_MICROSTEPS);
+    }
+    if (stepper_state.pio_running) {
+        rebase_chunks(divider);
+    }
+    stepper_state.pulse_divider = divider;
+    LOG_STEPPER_DEBUG("Switched to 1/%u microstepping at %lu Hz", microsteps, stepper_state.current_frequency);
 }
 
 // Update step frequency using PIO
@@ -109,23 +435,36 @@ static void update_step_frequency(uint32_t frequency_hz) {
     }
     
     stepper_state.current_frequency = frequency_hz;
-    
     if (frequency_hz == 0) {
         // Stop the PIO program
-        stepper_step_stop(STEPPER_PIO, STEPPER_PIO_SM);
-        stepper_state.pio_running = false;
-    } else {
-        // Set the new frequency
-        stepper_step_set_frequency(STEPPER_PIO, STEPPER_PIO_SM, frequency_hz);
-        
-        // Only start PIO if it's not already running
-        if (!stepper_state.pio_running) {
-            stepper_step_start(STEPPER_PIO, STEPPER_PIO_SM);
-            stepper_state.pio_running = true;
-            LOG_STEPPER_DEBUG("Stepper frequency set to %lu Hz", frequency_hz);
+        if (stepper_state.pio_running) {
+            halt_pulses();
+            stepper_state.pio_running = false;
         }
-        // Don't spam frequency changes - they happen very frequently now
+        stepper_state.pulse_frequency = 0;
+        return;
+    }
+    apply_pulse_divider(select_pulse_divider(frequency_hz));
+    
+    // Logical frequency above the fine range only if the switch failed; the step count follows the real rate
+    uint32_t pulse_hz = frequency_hz / stepper_state.pulse_divider;
+    if (pulse_hz > STEPPER_MAX_FREQ_HZ) pulse_hz = STEPPER_MAX_FREQ_HZ;
+    stepper_state.pulse_frequency = pulse_hz;
+    
+    // Set the new frequency
+    stepper_step_set_frequency(STEPPER_PIO, STEPPER_PIO_SM, pulse_hz);
+    
+    // Only start PIO if it's not already running: hand it the first chunks from where the move stands
+    if (!stepper_state.pio_running) {
+        uint32_t irq_state = spin_lock_blocking(stepper_state.lock);
+        stepper_state.feeding = true;
+        feed_chunks();
+        spin_unlock(stepper_state.lock, irq_state);
+        stepper_step_start(STEPPER_PIO, STEPPER_PIO_SM);
+        stepper_state.pio_running = true;
+        LOG_STEPPER_DEBUG("Stepper frequency set to %lu Hz", frequency_hz);
     }
+    // Don't spam frequency changes - they happen very frequently now
 }
 
 // Helper functions for enable pin control
@@ -134,7 +473,7 @@ static void stepper_enable_driver(void) {
         gpio_pin_set_low(stepper_state.enable_pin);  // Most stepper drivers are active low
         stepper_state.enable_pin_active = true;
         LOG_STEPPER_DEBUG("Stepper driver enabled");
-        sleep_ms(10);  // Allow driver to stabilize
+        sleep_ms(STEPPER_ENABLE_SETTLE_MS);  // Allow driver to stabilize
     }
 }
 
@@ -189,6 +528,8 @@ void stepper_driver_init_with_enable_pin(gpio_pin_t *enable_pin) {
     }
     
     stepper_step_program_init(STEPPER_PIO, STEPPER_PIO_SM, stepper_state.pio_offset, STEPPER_STEP_PIN);
+    stepper_state.lock = spin_lock_instance(spin_lock_claim_unused(true));
+    stepper_state.irq_num = stepper_step_set_irq_handler(STEPPER_PIO, STEPPER_PIO_SM, stepper_chunk_irq);
     LOG_STEPPER_DEBUG("PIO state machine initialized");
     
     // Initialize state
@@ -204,32 +545,56 @@ void stepper_driver_init_with_enable_pin(gpio_pin_t *enable_pin) {
     stepper_state.pio_running = false;
     
     LOG_STEPPER_INFO("PIO stepper driver initialized successfully");
-    LOG_STEPPER_INFO("Frequency range: %d Hz to %d Hz", STEPPER_MIN_FREQ_HZ, STEPPER_MAX_FREQ_HZ);
+    LOG_STEPPER_INFO("Frequency range: %lu Hz to %lu Hz", stepper_state.min_frequency, stepper_state.max_frequency);
 }
 
 void stepper_driver_start(int32_t target_steps) {
+    stepper_driver_start_at(target_steps, stepper_state.max_frequency);
+}
+
+void stepper_driver_start_at(int32_t target_steps, uint32_t cruise_hz) {
     if (target_steps <= 0) {
         LOG_STEPPER_ERROR("Invalid target steps: %ld", target_steps);
         return;
     }
     
-    LOG_STEPPER_INFO("Starting stepper motor: %ld steps", target_steps);
+    // Cruise speed is limited to the configured frequency range
+    if (cruise_hz < stepper_state.min_frequency) cruise_hz = stepper_state.min_frequency;
+    if (cruise_hz > stepper_state.max_frequency) cruise_hz = stepper_state.max_frequency;
+    
+    LOG_STEPPER_INFO("Starting stepper motor: %ld steps at %lu Hz", target_steps, cruise_hz);
     
     // Enable the stepper driver
     stepper_enable_driver();
     
     // Reset state
-    stepper_state.current_steps = 0;
-    stepper_state.target_steps = target_steps;
-    stepper_state.state = STEPPER_ACCELERATING;
-    stepper_state.step_counter = 0;
-    stepper_state.last_update_time = get_absolute_time();
-    stepper_state.step_start_time = stepper_state.last_update_time;  // Track movement start time
-    stepper_state.steps_at_last_update = 0;
-    stepper_state.const_phase_printed = false;  // Reset for new movement
+    stepper_state.cruise_frequency = cruise_hz;
+    stepper_state.profile = NULL;
+    stepper_state.mark_count = 0;
+    begin_move(target_steps, cruise_hz - stepper_state.min_frequency);
     
     // Start with minimum frequency
-    update_step_frequency(STEPPER_MIN_FREQ_HZ);
+    update_step_frequency(stepper_state.min_frequency);
+}
+
+void stepper_driver_start_profile(int32_t target_steps, stepper_profile_t profile) {
+    if (target_steps <= 0 || !profile) {
+        LOG_STEPPER_ERROR("Invalid profile move: %ld steps", target_steps);
+        return;
+    }
+    
+    LOG_STEPPER_INFO("Starting stepper motor: %ld steps on planned profile", target_steps);
+    
+    // Enable the stepper driver
+    stepper_enable_driver();
+    
+    // Reset state
+    stepper_state.cruise_frequency = stepper_state.max_frequency;
+    stepper_state.profile = profile;
+    begin_move(target_steps, stepper_state.max_frequency - stepper_state.min_frequency);
+    
+    // Start at the profile's entry speed
+    update_step_frequency(calculate_target_frequency());
 }
 
 void stepper_driver_stop(void) {
@@ -242,8 +607,110 @@ void stepper_driver_stop(void) {
     stepper_state.state = STEPPER_IDLE;
     stepper_state.current_frequency = 0;
     
-    // Disable the stepper driver to save power
-    stepper_disable_driver();
+    // Disable the stepper driver to save power, unless more moves follow
+    if (!stepper_state.hold_enable) {
+        stepper_disable_driver();
+    }
+}
+
+// Start a controlled deceleration from the live speed
+static void begin_stopping(bool pause) {
+    stepper_state_t state = stepper_state.state;
+    if (state != STEPPER_ACCELERATING && state != STEPPER_RUNNING && state != STEPPER_DECELERATING) {
+        if (state == STEPPER_STOPPING) {
+            stepper_state.pause_requested = pause;
+        }
+        return;
+    }
+    
+    LOG_STEPPER_INFO("%s from %lu Hz at step %ld", pause ? "Pausing" : "Stopping smoothly",
+                     stepper_state.current_frequency, stepper_state.current_steps);
+    stepper_state.state = STEPPER_STOPPING;
+    stepper_state.stop_freq_q16 = stepper_state.current_frequency << 16;
+    stepper_state.pause_requested = pause;
+    stepper_state.resuming = false;
+}
+
+void stepper_driver_stop_smooth(void) {
+    begin_stopping(false);
+}
+
+void stepper_driver_pause(void) {
+    begin_stopping(true);
+}
+
+bool stepper_driver_resume(void) {
+    if (stepper_state.state != STEPPER_PAUSED || stepper_state.mark_refused) {
+        return false;
+    }
+    
+    LOG_STEPPER_INFO("Resuming at step %ld of %ld", stepper_state.current_steps, stepper_state.target_steps);
+    
+    // The driver stayed enabled while paused
+    stepper_state.state = STEPPER_ACCELERATING;
+    stepper_state.resuming = true;
+    stepper_state.resume_from = stepper_state.current_steps;
+    stepper_state.last_update_time = get_absolute_time();
+    update_step_frequency(stepper_state.min_frequency);
+    return true;
+}
+
+bool stepper_driver_set_target_steps(int32_t target_steps) {
+    return stepper_driver_resize(stepper_state.target_steps, target_steps - stepper_state.target_steps);
+}
+
+bool stepper_driver_resize(int32_t position, int32_t delta) {
+    // Planned moves only: the planner has checked that the new end is reachable on its ramps
+    if (!stepper_state.profile || !stepper_driver_is_running() || stepper_state.state == STEPPER_STOPPING ||
+        position > stepper_state.target_steps || position + delta <= stepper_state.current_steps) {
+        return false;
+    }
+    
+    // Steps handed to the PIO are fixed; paused, nothing is
+    uint32_t irq_state = spin_lock_blocking(stepper_state.lock);
+    int32_t committed = stepper_state.feeding ? stepper_state.pushed_steps : stepper_state.current_steps;
+    bool fits = position > committed && position + delta > committed;
+    if (fits) {
+        for (uint32_t i = stepper_state.marks_pushed; i < stepper_state.mark_count; i++) {
+            if (stepper_state.marks[i] >= position) {
+                stepper_state.marks[i] += delta;
+            }
+        }
+        stepper_state.target_steps += delta;
+        feed_chunks();
+    }
+    spin_unlock(stepper_state.lock, irq_state);
+    if (!fits) {
+        return false;
+    }
+    
+    LOG_STEPPER_DEBUG("Move resized by %ld steps at step %ld, ends at %ld", delta, position, stepper_state.target_steps);
+    return true;
+}
+
+bool stepper_driver_set_marks(const int32_t *positions, uint32_t count, stepper_mark_cb_t callback) {
+    if (stepper_driver_is_running() || count > STEPPER_MAX_MARKS) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        if (positions[i] <= 0 || (i > 0 && positions[i] <= positions[i - 1])) {
+            LOG_STEPPER_ERROR("Marks have to be positive and increasing");
+            return false;
+        }
+        stepper_state.marks[i] = positions[i];
+    }
+    stepper_state.mark_count = count;
+    stepper_state.mark_callback = callback;
+    return true;
+}
+
+void stepper_driver_hold_enable(bool hold) {
+    stepper_state.hold_enable = hold;
+    
+    // Releasing the hold while idle powers the driver down right away
+    if (!hold && !stepper_driver_is_running()) {
+        stepper_disable_driver();
+    }
 }
 
 void stepper_driver_update(void) {
@@ -251,24 +718,77 @@ void stepper_driver_update(void) {
         return;
     }
     
+    // A mark callback refused to go on: its pulses are already stopped
+    if (stepper_state.mark_refused) {
+        stepper_driver_stop();
+        LOG_STEPPER_WARN("Stopped at a refused mark, step %ld of %ld", stepper_state.current_steps, stepper_state.target_steps);
+        return;
+    }
+    
     absolute_time_t current_time = get_absolute_time();
     uint64_t update_time_diff = absolute_time_diff_us(stepper_state.last_update_time, current_time);
     
     // Update step count based on time since last update and current frequency
     if (stepper_state.current_frequency > 0 && update_time_diff >= 2000) { // Update every 2ms for balanced smoothness and visibility
-        uint32_t steps_since_last = (stepper_state.current_frequency * update_time_diff) / 1000000;
+        // Carry the partial step so slow ramps don't undercount (matters for pause/resume)
+        uint64_t step_micros = (uint64_t)stepper_state.pulse_frequency * stepper_state.pulse_divider * update_time_diff +
+                               stepper_state.step_fraction;
+        uint32_t steps_since_last = (uint32_t)(step_micros / 1000000);
+        stepper_state.step_fraction = (uint32_t)(step_micros % 1000000);
         stepper_state.current_steps += steps_since_last;
         stepper_state.last_update_time = current_time;
         
-        // Check if movement is complete
-        if (stepper_state.current_steps >= stepper_state.target_steps) {
-            stepper_state.current_steps = stepper_state.target_steps;
+        // The estimate stays within the running chunk; its end is only reached once the PIO says so
+        uint32_t irq_state = spin_lock_blocking(stepper_state.lock);
+        bool all_out = stepper_state.chunk_count == 0 && stepper_state.pushed_steps >= stepper_state.target_steps;
+        int32_t done_steps = stepper_state.done_steps;
+        int32_t running_end = stepper_state.chunk_count > 0 ?
+                              stepper_state.chunks[stepper_state.chunk_head].end : done_steps;
+        spin_unlock(stepper_state.lock, irq_state);
+        if (stepper_state.current_steps < done_steps) {
+            stepper_state.current_steps = done_steps;
+        } else if (stepper_state.current_steps >= running_end) {
+            stepper_state.current_steps = running_end > done_steps ? running_end - 1 : done_steps;
+        }
+        
+        // Check if movement is complete: every pulse of it is out
+        if (all_out) {
             stepper_driver_stop();
+            stepper_state.current_steps = stepper_state.target_steps;
             stepper_state.state = STEPPER_COMPLETED;
             LOG_STEPPER_INFO("Stepper movement completed: %ld steps", stepper_state.current_steps);
             return;
         }
         
+        if (stepper_state.state == STEPPER_STOPPING) {
+            // Ramp down incrementally from the live speed at the move's slope
+            uint32_t drop = (uint32_t)(((uint64_t)stepper_state.ramp_slope_q16 * steps_since_last));
+            uint32_t floor_q16 = stepper_state.min_frequency << 16;
+            if (stepper_state.stop_freq_q16 <= floor_q16 + drop) {
+                if (stepper_state.pause_requested) {
+                    update_step_frequency(0);
+                    stepper_state.state = STEPPER_PAUSED;
+                    LOG_STEPPER_INFO("Paused at step %ld of %ld", stepper_state.current_steps, stepper_state.target_steps);
+                } else {
+                    stepper_driver_stop();
+                    LOG_STEPPER_INFO("Stopped smoothly at step %ld of %ld", stepper_state.current_steps, stepper_state.target_steps);
+                }
+                return;
+            }
+            stepper_state.stop_freq_q16 -= drop;
+            
+            // Never faster than the move itself would go here (e.g. its own final ramp)
+            uint32_t stop_freq = stepper_state.stop_freq_q16 >> 16;
+            uint32_t profile_freq = calculate_target_frequency();
+            if (profile_freq < stop_freq) {
+                stop_freq = profile_freq;
+            }
+            if (stop_freq != stepper_state.current_frequency) {
+                update_step_frequency(stop_freq);
+            }
+            return;
+        }
+        
         // Calculate new target frequency based on current position - do this frequently for smooth acceleration!
         uint32_t target_freq = calculate_target_frequency();
         
@@ -276,7 +796,16 @@ void stepper_driver_update(void) {
         int32_t remaining_steps = stepper_state.target_steps - stepper_state.current_steps;
         int32_t adaptive_accel_steps = calculate_adaptive_accel_steps();
         
-        if (stepper_state.current_steps < adaptive_accel_steps) {
+        if (stepper_state.profile) {
+            // Planned profile: follow the direction of the speed change
+            if (target_freq > stepper_state.current_frequency) {
+                stepper_state.state = STEPPER_ACCELERATING;
+            } else if (target_freq < stepper_state.current_frequency) {
+                stepper_state.state = STEPPER_DECELERATING;
+            } else {
+                stepper_state.state = STEPPER_RUNNING;
+            }
+        } else if (stepper_state.current_steps < adaptive_accel_steps) {
             stepper_state.state = STEPPER_ACCELERATING;
         } else if (remaining_steps < adaptive_accel_steps) {
             stepper_state.state = STEPPER_DECELERATING;
@@ -295,11 +824,67 @@ void stepper_driver_update(void) {
     }
 }
 
+bool stepper_driver_set_frequency_limits(uint32_t min_hz, uint32_t max_hz) {
+    if (stepper_driver_is_running() ||
+        min_hz < STEPPER_MIN_FREQ_HZ || max_hz > stepper_driver_get_frequency_ceiling() || min_hz >= max_hz) {
+        LOG_STEPPER_ERROR("Rejected frequency limits: %lu Hz to %lu Hz", min_hz, max_hz);
+        return false;
+    }
+    
+    stepper_state.min_frequency = min_hz;
+    stepper_state.max_frequency = max_hz;
+    LOG_STEPPER_INFO("Frequency range: %lu Hz to %lu Hz", min_hz, max_hz);
+    return true;
+}
+
+bool stepper_driver_set_microstep_switch(stepper_microstep_cb_t callback, uint16_t coarse_microsteps) {
+    if (stepper_driver_is_running()) {
+        return false;
+    }
+    
+    if (!callback) {
+        // A move that ended coarse leaves the driver there: back to full resolution first
+        if (stepper_state.microstep_switch && stepper_state.pulse_divider > 1 &&
+            !stepper_state.microstep_switch(STEPPER_MICROSTEPS)) {
+            LOG_STEPPER_ERROR("Failed to restore 1/%u microstepping", STEPPER_MICROSTEPS);
+        }
+        stepper_state.pulse_divider = 1;
+        stepper_state.microstep_switch = NULL;
+        stepper_state.coarse_factor = 1;
+        if (stepper_state.max_frequency > STEPPER_MAX_FREQ_HZ) {
+            stepper_state.max_frequency = STEPPER_MAX_FREQ_HZ;
+            if (stepper_state.min_frequency >= stepper_state.max_frequency) {
+                stepper_state.min_frequency = STEPPER_MIN_FREQ_HZ;
+            }
+        }
+        return true;
+    }
+    
+    // The coarse pulse rate has to stay within the PIO's range (1/2 or 1/4 from 1/8)
+    if (coarse_microsteps == 0 || coarse_microsteps >= STEPPER_MICROSTEPS ||
+        STEPPER_MICROSTEPS % coarse_microsteps != 0 ||
+        STEPPER_MIN_FREQ_HZ * (STEPPER_MICROSTEPS / coarse_microsteps) > STEPPER_MAX_FREQ_HZ) {
+        LOG_STEPPER_ERROR("Unsupported coarse microstepping 1/%u", coarse_microsteps);
+        return false;
+    }
+    
+    stepper_state.microstep_switch = callback;
+    stepper_state.coarse_factor = STEPPER_MICROSTEPS / coarse_microsteps;
+    stepper_state.pulse_divider = 1;
+    LOG_STEPPER_INFO("1/%u microstepping above %u Hz, up to %lu Hz", coarse_microsteps,
+                     STEPPER_MAX_FREQ_HZ, stepper_driver_get_frequency_ceiling());
+    return true;
+}
+
 // Status functions
 bool stepper_driver_is_running(void) {
     return (stepper_state.state != STEPPER_IDLE && stepper_state.state != STEPPER_COMPLETED);
 }
 
+bool stepper_driver_is_paused(void) {
+    return stepper_state.state == STEPPER_PAUSED;
+}
+
 int32_t stepper_driver_get_current_steps(void) {
     return stepper_state.current_steps;
 }
@@ -316,6 +901,26 @@ uint32_t stepper_driver_get_current_frequency(void) {
     return stepper_state.current_frequency;
 }
 
+uint32_t stepper_driver_get_min_frequency(void) {
+    return stepper_state.min_frequency;
+}
+
+uint32_t stepper_driver_get_max_frequency(void) {
+    return stepper_state.max_frequency;
+}
+
+uint32_t stepper_driver_get_frequency_ceiling(void) {
+    return STEPPER_MAX_FREQ_HZ * stepper_state.coarse_factor;
+}
+
+uint32_t stepper_driver_get_mark_irq(void) {
+    return stepper_state.irq_num;
+}
+
+uint16_t stepper_driver_get_microsteps(void) {
+    return (uint16_t)(STEPPER_MICROSTEPS / stepper_state.pulse_divider);
+}
+
 // Convenience functions for revolution-based movement
 void stepper_driver_start_revolutions(float revolutions) {
     int32_t steps = (int32_t)(revolutions * STEPPER_STEPS_PER_REV);
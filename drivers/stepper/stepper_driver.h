@@ -13,6 +13,8 @@
  * - Configurable step rates
  * - Non-blocking operation
  * - Real-time position feedback
+ * - Exact step counts: pulses go to the PIO in counted chunks
+ * - Marks: callbacks on an exact step of a planned move, from the chunk interrupt
  * - Optional enable pin control (native GPIO or MCP23017)
  */
 
@@ -20,6 +22,14 @@
 #define STEPPER_STEP_PIN 29          // GPIO pin for step signal
 #define STEPPER_MIN_FREQ_HZ 2000     // Minimum step frequency (above PIO limit)
 #define STEPPER_MAX_FREQ_HZ 8000     // Maximum step frequency (Hz)
+// Note: Runtime limits can be narrowed within this range (stepper_driver_set_frequency_limits)
+
+// Pulse chunks handed to the PIO (its TX FIFO holds 4)
+#define STEPPER_CHUNK_STEPS 512      // Longest chunk; the position is exact at every chunk end
+#define STEPPER_CHUNKS_AHEAD 2       // Chunks queued behind the running one
+#define STEPPER_MAX_MARKS 16         // Marks per planned move
+
+#define STEPPER_ENABLE_SETTLE_MS 10   // Wait after enabling the driver before the first step
 
 // Adaptive acceleration configuration
 #define STEPPER_ACCEL_DIVISOR 15     // Acceleration zone = total_steps / divisor (smaller = longer accel)
@@ -31,6 +41,9 @@
 #define STEPPER_MICROSTEPS 8         // 1/8 microstepping
 #define STEPPER_FULL_STEPS_PER_REV 200  // Standard 1.8° stepper motor
 #define STEPPER_STEPS_PER_REV (STEPPER_FULL_STEPS_PER_REV * STEPPER_MICROSTEPS)  // 1600 steps/rev
+// Note: Positions and frequencies are always counted in STEPPER_MICROSTEPS units, also
+// while a microstep switch runs the driver at a coarser resolution
+#define STEPPER_MICROSTEP_HYSTERESIS_HZ 1000  // Back to fine steps this far below STEPPER_MAX_FREQ_HZ
 
 // Stepper states
 typedef enum {
@@ -38,22 +51,57 @@ typedef enum {
     STEPPER_ACCELERATING,
     STEPPER_RUNNING,
     STEPPER_DECELERATING,
-    STEPPER_COMPLETED
+    STEPPER_COMPLETED,
+    STEPPER_STOPPING,     // Controlled deceleration after stop_smooth/pause
+    STEPPER_PAUSED        // Stopped mid-move, remaining steps kept, driver enabled
 } stepper_state_t;
 
+// Planned speed profile: step frequency at a position within the move
+typedef uint32_t (*stepper_profile_t)(int32_t position);
+
+// A mark of the planned move was reached (index into the positions given); runs in the chunk interrupt.
+// False stops the move there: the pulses stop at once, stepper_driver_update() finishes the stop.
+typedef bool (*stepper_mark_cb_t)(uint32_t mark);
+
+// Changes the driver's microstep resolution (e.g. over UART), false if it failed
+typedef bool (*stepper_microstep_cb_t)(uint16_t microsteps);
+
 // Function prototypes
 void stepper_driver_init(void);
 void stepper_driver_init_with_enable_pin(gpio_pin_t *enable_pin);
 void stepper_driver_start(int32_t target_steps);
-void stepper_driver_stop(void);
+void stepper_driver_start_at(int32_t target_steps, uint32_t cruise_hz);  // Cruise speed for this move only
+void stepper_driver_start_profile(int32_t target_steps, stepper_profile_t profile);  // Speed from a planner
+void stepper_driver_stop(void);         // Emergency stop: pulses end immediately
+void stepper_driver_stop_smooth(void);  // Decelerate to the minimum frequency, then stop
+void stepper_driver_pause(void);        // Like stop_smooth, but the move can be resumed
+bool stepper_driver_resume(void);       // Ramp back up and finish the remaining steps
+bool stepper_driver_set_target_steps(int32_t target_steps);  // Move the end of a running planned move
+// Lengthen or shorten a running planned move at 'position' (e.g. a segment's end): the end and every
+// mark from there on move by 'delta'. False once steps past it have been handed to the PIO.
+bool stepper_driver_resize(int32_t position, int32_t delta);
+// Call 'callback' when the next planned move reaches each of 'positions' (increasing). The pulse
+// there is the exact step at fine resolution, the nearest pulse at coarse resolution.
+bool stepper_driver_set_marks(const int32_t *positions, uint32_t count, stepper_mark_cb_t callback);
+void stepper_driver_hold_enable(bool hold);  // Keep the driver enabled between moves (skips the enable settle time)
 void stepper_driver_update(void);
+bool stepper_driver_set_frequency_limits(uint32_t min_hz, uint32_t max_hz);
+// Run above STEPPER_MAX_FREQ_HZ with coarser steps (NULL = off); raises the allowed maximum frequency
+bool stepper_driver_set_microstep_switch(stepper_microstep_cb_t callback, uint16_t coarse_microsteps);
 
 // Status functions
-bool stepper_driver_is_running(void);
+bool stepper_driver_is_running(void);  // True until completed or stopped, including while paused
+bool stepper_driver_is_paused(void);
 int32_t stepper_driver_get_current_steps(void);
 int32_t stepper_driver_get_target_steps(void);
 stepper_state_t stepper_driver_get_state(void);
 uint32_t stepper_driver_get_current_frequency(void);
+uint32_t stepper_driver_get_min_frequency(void);
+uint32_t stepper_driver_get_max_frequency(void);
+uint32_t stepper_driver_get_frequency_ceiling(void);  // Highest allowed maximum frequency
+uint16_t stepper_driver_get_microsteps(void);  // Resolution the driver is running at
+uint32_t stepper_driver_get_mark_irq(void);    // Interrupt the mark callbacks run from
+uint32_t stepper_driver_get_accel_steps(int32_t total_steps);  // Length of each ramp for a move
 
 // Convenience functions for revolution-based movement
 void stepper_driver_start_revolutions(float revolutions);
@@ -0,0 +1,374 @@
+/**
+ * Stepper Move Planner Implementation
+ */
+
+#include "stepper_planner.h"
+#include "stepper_driver.h"
+#include "../logging/logging.h"
+#include "pico/stdlib.h"
+#include <math.h>
+
+// Queued segment
+typedef struct {
+    int32_t steps;
+    uint32_t cruise_hz;
+    uint32_t tag;
+    int32_t start;              // Position of the first step within the sequence
+    bool marked;                // Its start is reported on the exact step
+    stepper_segment_shape_t shape;
+} planner_segment_t;
+
+// Planner state
+static struct {
+    planner_segment_t segments[STEPPER_PLANNER_MAX_SEGMENTS];
+    uint32_t count;
+    int32_t total_steps;
+
+    // Ramp slope shared by the whole sequence: range Hz over accel_steps steps
+    uint32_t min_hz;
+    uint32_t range_hz;
+    int32_t accel_steps;
+
+    bool planned;
+    bool running;
+    uint32_t current;           // Segment the driver is in
+    uint32_t cursor;            // Segment lookup for the profile
+
+    uint32_t blended_ms;
+    uint32_t separate_ms;
+
+    stepper_planner_segment_cb_t segment_callback;
+    stepper_planner_mark_cb_t mark_callback;
+    uint32_t mark_tags[STEPPER_MAX_MARKS];  // Tag of the segment starting at each driver mark
+} planner;
+
+// Speed gained over a number of steps on the ramp
+static uint32_t ramp_gain(int32_t steps) {
+    return (uint32_t)((uint64_t)planner.range_hz * (uint32_t)steps / (uint32_t)planner.accel_steps);
+}
+
+// Steps needed to change speed by delta_hz on the ramp
+static int32_t ramp_steps(uint32_t delta_hz) {
+    return (int32_t)((uint64_t)delta_hz * (uint32_t)planner.accel_steps / planner.range_hz);
+}
+
+// Time to cover n steps while the frequency changes linearly from f0 to f1
+static float ramp_time_s(int32_t steps, float f0, float f1) {
+    if (steps <= 0) {
+        return 0.0f;
+    }
+    if (fabsf(f1 - f0) < 1.0f) {
+        return steps / f0;
+    }
+    return steps * logf(f1 / f0) / (f1 - f0);
+}
+
+// Duration of a segment run on its own with the driver's built-in ramps
+static float separate_time_s(const planner_segment_t *seg) {
+    int32_t steps = seg->steps;
+    int32_t accel = (int32_t)stepper_driver_get_accel_steps(steps);
+    float min_hz = (float)planner.min_hz;
+    float range = (float)(seg->cruise_hz - planner.min_hz);
+
+    int32_t accel_steps = steps < accel ? steps : accel;
+    int32_t decel_start = steps - accel > accel ? steps - accel : accel;
+    int32_t decel_steps = steps > decel_start ? steps - decel_start : 0;
+    int32_t cruise_steps = decel_start - accel > 0 ? decel_start - accel : 0;
+
+    return ramp_time_s(accel_steps, min_hz, min_hz + range * accel_steps / accel) +
+           cruise_steps / (float)seg->cruise_hz +
+           ramp_time_s(decel_steps, min_hz + range * decel_steps / accel, min_hz);
+}
+
+void stepper_planner_clear(void) {
+    if (planner.running) {
+        return;
+    }
+    planner.count = 0;
+    planner.total_steps = 0;
+    planner.planned = false;
+}
+
+bool stepper_planner_add(int32_t steps, uint32_t cruise_hz, uint32_t tag) {
+    if (planner.running || steps <= 0 || planner.count == STEPPER_PLANNER_MAX_SEGMENTS) {
+        return false;
+    }
+
+    planner_segment_t *seg = &planner.segments[planner.count++];
+    seg->steps = steps;
+    seg->cruise_hz = cruise_hz;
+    seg->tag = tag;
+    seg->marked = false;
+    planner.planned = false;
+    return true;
+}
+
+bool stepper_planner_set_steps(uint32_t index, int32_t steps) {
+    if (planner.running || index >= planner.count || steps <= 0) {
+        return false;
+    }
+    planner.segments[index].steps = steps;
+    planner.planned = false;
+    return true;
+}
+
+bool stepper_planner_mark(uint32_t index) {
+    if (planner.running || index == 0 || index >= planner.count) {
+        return false;
+    }
+    planner.segments[index].marked = true;
+    return true;
+}
+
+bool stepper_planner_adjust_steps(uint32_t index, int32_t steps) {
+    if (!planner.running) {
+        return stepper_planner_set_steps(index, steps);
+    }
+    if (index < planner.current || index >= planner.count || steps <= 0) {
+        return false;
+    }
+
+    // The new end must leave room for the segment's ramps at the planned slope
+    planner_segment_t *seg = &planner.segments[index];
+    int32_t decel_steps = ramp_steps(seg->shape.peak_hz - seg->shape.exit_hz);
+    int32_t shortest = seg->shape.accel_steps + decel_steps;
+    if (index == planner.current) {
+        int32_t offset = stepper_driver_get_current_steps() - seg->start;
+        if (offset + decel_steps >= seg->steps) {
+            return false;       // Already slowing down for the exit
+        }
+        if (offset + decel_steps > shortest) {
+            shortest = offset + decel_steps;
+        }
+    }
+    if (steps < shortest) {
+        return false;
+    }
+
+    int32_t delta = steps - seg->steps;
+    if (!stepper_driver_resize(seg->start + seg->steps, delta)) {
+        return false;
+    }
+    seg->steps = steps;
+    seg->shape.decel_steps = decel_steps;
+    for (uint32_t i = index + 1; i < planner.count; i++) {
+        planner.segments[i].start += delta;
+    }
+    planner.total_steps += delta;
+    return true;
+}
+
+bool stepper_planner_get_progress(uint32_t *index, int32_t *offset) {
+    if (!planner.running) {
+        return false;
+    }
+    *index = planner.current;
+    *offset = stepper_driver_get_current_steps() - planner.segments[planner.current].start;
+    return true;
+}
+
+uint32_t stepper_planner_get_count(void) {
+    return planner.count;
+}
+
+void stepper_planner_plan(void) {
+    uint32_t min_hz = stepper_driver_get_min_frequency();
+    uint32_t max_hz = stepper_driver_get_max_frequency();
+
+    planner.total_steps = 0;
+    for (uint32_t i = 0; i < planner.count; i++) {
+        planner_segment_t *seg = &planner.segments[i];
+        if (seg->cruise_hz == 0 || seg->cruise_hz > max_hz) seg->cruise_hz = max_hz;
+        if (seg->cruise_hz < min_hz) seg->cruise_hz = min_hz;
+        seg->start = planner.total_steps;
+        planner.total_steps += seg->steps;
+    }
+
+    // The whole sequence ramps like a single move of its total length
+    planner.min_hz = min_hz;
+    planner.range_hz = max_hz - min_hz;
+    planner.accel_steps = (int32_t)stepper_driver_get_accel_steps(planner.total_steps);
+
+    // Exit speed of each segment: never faster than either neighbour's cruise, stop at the end
+    uint32_t junction[STEPPER_PLANNER_MAX_SEGMENTS];
+    for (uint32_t i = 0; i < planner.count; i++) {
+        const planner_segment_t *seg = &planner.segments[i];
+        if (i + 1 < planner.count) {
+            uint32_t next_cruise = planner.segments[i + 1].cruise_hz;
+            junction[i] = seg->cruise_hz < next_cruise ? seg->cruise_hz : next_cruise;
+        } else {
+            junction[i] = min_hz;
+        }
+    }
+
+    // Reverse pass: each junction must be able to slow down to the next one within the next segment
+    for (int32_t i = (int32_t)planner.count - 2; i >= 0; i--) {
+        uint32_t reachable = junction[i + 1] + ramp_gain(planner.segments[i + 1].steps);
+        if (junction[i] > reachable) {
+            junction[i] = reachable;
+        }
+    }
+
+    // Forward pass: each junction must be reachable by accelerating through its segment
+    uint32_t entry = min_hz;
+    for (uint32_t i = 0; i < planner.count; i++) {
+        uint32_t reachable = entry + ramp_gain(planner.segments[i].steps);
+        if (junction[i] > reachable) {
+            junction[i] = reachable;
+        }
+
+        // Trapezoid, or a triangle when the segment is too short to reach cruise
+        planner_segment_t *seg = &planner.segments[i];
+        stepper_segment_shape_t *shape = &seg->shape;
+        shape->entry_hz = entry;
+        shape->exit_hz = junction[i];
+        shape->accel_steps = ramp_steps(seg->cruise_hz - entry);
+        shape->decel_steps = ramp_steps(seg->cruise_hz - junction[i]);
+        shape->peak_hz = seg->cruise_hz;
+        if (shape->accel_steps + shape->decel_steps > seg->steps) {
+            uint32_t peak = (entry + junction[i] + ramp_gain(seg->steps)) / 2;
+            shape->peak_hz = peak < seg->cruise_hz ? peak : seg->cruise_hz;
+            shape->accel_steps = ramp_steps(shape->peak_hz - entry);
+            if (shape->accel_steps > seg->steps) {
+                shape->accel_steps = seg->steps;
+            }
+            shape->decel_steps = seg->steps - shape->accel_steps;
+        }
+
+        entry = junction[i];
+    }
+
+    // Estimates for the report
+    float blended = STEPPER_ENABLE_SETTLE_MS / 1000.0f;
+    float separate = 0.0f;
+    for (uint32_t i = 0; i < planner.count; i++) {
+        const planner_segment_t *seg = &planner.segments[i];
+        const stepper_segment_shape_t *shape = &seg->shape;
+        int32_t cruise_steps = seg->steps - shape->accel_steps - shape->decel_steps;
+        blended += ramp_time_s(shape->accel_steps, shape->entry_hz, shape->peak_hz) +
+                   (cruise_steps > 0 ? cruise_steps / (float)shape->peak_hz : 0.0f) +
+                   ramp_time_s(shape->decel_steps, shape->peak_hz, shape->exit_hz);
+        separate += STEPPER_ENABLE_SETTLE_MS / 1000.0f + separate_time_s(seg);
+    }
+    planner.blended_ms = (uint32_t)(blended * 1000.0f);
+    planner.separate_ms = (uint32_t)(separate * 1000.0f);
+    planner.planned = true;
+}
+
+bool stepper_planner_get_shape(uint32_t index, stepper_segment_shape_t *shape) {
+    if (!planner.planned || index >= planner.count) {
+        return false;
+    }
+    *shape = planner.segments[index].shape;
+    return true;
+}
+
+// Profile handed to the driver: speed at a position within the sequence
+static uint32_t planner_profile(int32_t position) {
+    while (planner.cursor + 1 < planner.count &&
+           position >= planner.segments[planner.cursor + 1].start) {
+        planner.cursor++;
+    }
+
+    const planner_segment_t *seg = &planner.segments[planner.cursor];
+    int32_t offset = position - seg->start;
+    if (offset > seg->steps) {
+        offset = seg->steps;
+    }
+
+    uint32_t freq = seg->shape.peak_hz;
+    uint32_t rising = seg->shape.entry_hz + ramp_gain(offset);
+    uint32_t falling = seg->shape.exit_hz + ramp_gain(seg->steps - offset);
+    if (rising < freq) freq = rising;
+    if (falling < freq) freq = falling;
+    return freq;
+}
+
+void stepper_planner_set_segment_callback(stepper_planner_segment_cb_t callback) {
+    planner.segment_callback = callback;
+}
+
+void stepper_planner_set_mark_callback(stepper_planner_mark_cb_t callback) {
+    planner.mark_callback = callback;
+}
+
+// Driver mark reached: a marked segment starts (chunk interrupt)
+static bool planner_mark_reached(uint32_t mark) {
+    return !planner.mark_callback || planner.mark_callback(planner.mark_tags[mark]);
+}
+
+bool stepper_planner_start(void) {
+    if (planner.running || planner.count == 0 || stepper_driver_is_running()) {
+        return false;
+    }
+    if (!planner.planned) {
+        stepper_planner_plan();
+    }
+
+    LOG_STEPPER_INFO("Planned %lu segments, %ld steps: %lu ms blended vs %lu ms as separate moves",
+                     planner.count, planner.total_steps, planner.blended_ms, planner.separate_ms);
+
+    // Marked segment starts become driver marks
+    int32_t marks[STEPPER_MAX_MARKS];
+    uint32_t mark_count = 0;
+    for (uint32_t i = 1; i < planner.count && mark_count < STEPPER_MAX_MARKS; i++) {
+        if (planner.segments[i].marked) {
+            marks[mark_count] = planner.segments[i].start;
+            planner.mark_tags[mark_count++] = planner.segments[i].tag;
+        }
+    }
+    stepper_driver_set_marks(marks, mark_count, planner_mark_reached);
+
+    planner.current = 0;
+    planner.cursor = 0;
+    planner.running = true;
+    stepper_driver_start_profile(planner.total_steps, planner_profile);
+    return true;
+}
+
+void stepper_planner_process(void) {
+    if (!planner.running) {
+        return;
+    }
+
+    stepper_state_t state = stepper_driver_get_state();
+    bool ours = stepper_driver_get_target_steps() == planner.total_steps;
+    int32_t position = stepper_driver_get_current_steps();
+    if (state == STEPPER_COMPLETED && ours) {
+        position = planner.total_steps;
+    }
+
+    // Hand over at every segment end the driver has passed
+    while (planner.current < planner.count &&
+           position >= planner.segments[planner.current].start + planner.segments[planner.current].steps) {
+        uint32_t tag = planner.segments[planner.current].tag;
+        planner.current++;
+        if (planner.current == planner.count) {
+            planner.running = false;
+        }
+        if (planner.segment_callback) {
+            planner.segment_callback(tag, true);
+        }
+    }
+    if (!planner.running) {
+        return;
+    }
+
+    // Stopped early, or replaced by another move
+    if (state == STEPPER_IDLE || state == STEPPER_COMPLETED || !ours) {
+        planner.running = false;
+        LOG_STEPPER_WARN("Planned sequence stopped in segment %lu of %lu", planner.current + 1, planner.count);
+        if (planner.segment_callback) {
+            planner.segment_callback(planner.segments[planner.current].tag, false);
+        }
+    }
+}
+
+bool stepper_planner_is_running(void) {
+    return planner.running;
+}
+
+void stepper_planner_get_estimate(uint32_t *blended_ms, uint32_t *separate_ms) {
+    *blended_ms = planner.planned ? planner.blended_ms : 0;
+    *separate_ms = planner.planned ? planner.separate_ms : 0;
+}
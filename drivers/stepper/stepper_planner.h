@@ -0,0 +1,76 @@
+/**
+ * Stepper Move Planner
+ *
+ * Look-ahead queue of pump segments that run as one continuous move.
+ * Instead of ramping down to the minimum frequency at the end of every move,
+ * the planner computes a junction speed between consecutive segments
+ * (GRBL-style reverse and forward passes over the queue), so the motor keeps
+ * its cruise speed across segment boundaries and only the whole sequence
+ * ramps up and down. Ramps use the same linear frequency-per-step slope as
+ * the driver's own moves.
+ *
+ * The segment callback runs from stepper_planner_process() once the
+ * driver's position has passed each segment end - on the main loop, so up
+ * to a loop pass worth of steps late. It suits bookkeeping. What must happen
+ * at an exact step (switching a valve) goes in the mark callback: the start
+ * of each marked segment is a driver mark, called from the step interrupt
+ * right after the last step of the segment before.
+ *
+ * A running sequence can be resized while it runs (closed-loop dosing): the
+ * current segment up to the start of its final ramp, later ones freely as
+ * long as their ramps still fit. The ramp slope stays as planned.
+ *
+ * The pump only turns forward, so every segment continues in the same
+ * direction and all junctions can be blended.
+ */
+
+#ifndef STEPPER_PLANNER_H
+#define STEPPER_PLANNER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Configuration
+#define STEPPER_PLANNER_MAX_SEGMENTS 16
+
+// Planned speed shape of one segment: ramp from entry to peak, hold, ramp to exit
+typedef struct {
+    uint32_t entry_hz;
+    uint32_t peak_hz;
+    uint32_t exit_hz;
+    int32_t accel_steps;
+    int32_t decel_steps;
+} stepper_segment_shape_t;
+
+// Called when a segment ends (completed) or the sequence is stopped inside it
+typedef void (*stepper_planner_segment_cb_t)(uint32_t tag, bool completed);
+
+// Called from the step interrupt when a marked segment starts; false stops the sequence there
+typedef bool (*stepper_planner_mark_cb_t)(uint32_t tag);
+
+// Building the queue (only while no sequence is running)
+void stepper_planner_clear(void);
+bool stepper_planner_add(int32_t steps, uint32_t cruise_hz, uint32_t tag);
+bool stepper_planner_set_steps(uint32_t index, int32_t steps);
+bool stepper_planner_mark(uint32_t index);  // Report this segment's start on the exact step (not the first)
+uint32_t stepper_planner_get_count(void);
+
+// Changing a running sequence: resize the current segment (before its final ramp) or a later one
+bool stepper_planner_adjust_steps(uint32_t index, int32_t steps);
+bool stepper_planner_get_progress(uint32_t *index, int32_t *offset);  // Segment the driver is in
+
+// Compute junction speeds; shapes are valid until the queue changes
+void stepper_planner_plan(void);
+bool stepper_planner_get_shape(uint32_t index, stepper_segment_shape_t *shape);
+
+// Run the planned sequence as one move
+void stepper_planner_set_segment_callback(stepper_planner_segment_cb_t callback);
+void stepper_planner_set_mark_callback(stepper_planner_mark_cb_t callback);
+bool stepper_planner_start(void);
+void stepper_planner_process(void);    // Call from the main loop right after stepper_driver_update
+bool stepper_planner_is_running(void);
+
+// Estimated duration of the planned sequence, blended and as separate moves
+void stepper_planner_get_estimate(uint32_t *blended_ms, uint32_t *separate_ms);
+
+#endif // STEPPER_PLANNER_H
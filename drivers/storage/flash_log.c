@@ -0,0 +1,524 @@
+/**
+ * PicoFlora Persistent Log Store Implementation
+ */
+
+#include "flash_log.h"
+#include "storage_flash.h"
+#include "../logging/log_binary.h"
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+#include "hardware/timer.h"
+#include <stdio.h>
+#include <string.h>
+
+#define LOG_PAGES_TOTAL (STORAGE_LOG_SECTORS * STORAGE_PAGES_PER_SECTOR)
+#define NEXT_SECTOR(s) (((s) + 1) % STORAGE_LOG_SECTORS)
+
+_Static_assert(FLASH_LOG_PAGE_HEADER_SIZE + FLASH_LOG_PAYLOAD_SIZE == STORAGE_PAGE_SIZE,
+               "flash log page layout must fill one program page");
+_Static_assert(FLASH_LOG_MAX_TEXT <= UINT8_MAX, "text length must fit the record header");
+_Static_assert(5 + LOG_BINARY_MAX_ARG_WORDS * 4 <= FLASH_LOG_MAX_TEXT, "binary records must fit a page");
+
+// Page header as stored in flash
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;
+    uint16_t boot_id;
+    uint16_t length;
+    uint32_t crc;
+} flash_log_page_header_t;
+
+_Static_assert(sizeof(flash_log_page_header_t) == FLASH_LOG_PAGE_HEADER_SIZE,
+               "page header must be packed");
+
+// RAM index: one entry per sector, enough to seek without touching flash
+typedef struct {
+    uint32_t first_seq;         // Sequence of the first valid page, 0 = no valid pages
+    uint32_t first_ms;          // Timestamp of the first record in that page
+    uint16_t boot_id;           // Boot counter of that page
+    uint8_t valid_pages;        // Number of pages that passed the CRC check
+} flash_log_sector_index_t;
+
+// Store state
+static struct {
+    bool mounted;
+    spin_lock_t* lock;          // Guards the RAM page and pending queue (both cores, IRQs)
+    uint16_t boot_id;
+    uint32_t next_seq;
+
+    // Write position (the pages from write_page onwards are erased when write_ready)
+    uint32_t write_sector;
+    uint32_t write_page;
+    bool write_ready;
+    bool spare_ready;           // Sector after write_sector is erased
+
+    flash_log_sector_index_t index[STORAGE_LOG_SECTORS];
+
+    // RAM staging: the page being filled plus sealed pages waiting for a program slot
+    uint8_t page[STORAGE_PAGE_SIZE];
+    uint32_t page_used;
+    uint32_t last_append_ms;
+    uint8_t pending[FLASH_LOG_PENDING_PAGES][STORAGE_PAGE_SIZE];
+    uint32_t pending_head;
+    uint32_t pending_count;
+
+    // Stream cursor
+    bool streaming;
+    uint32_t stream_logical;    // Sector position counted from the oldest sector
+    uint32_t stream_page;
+    uint64_t stream_key;
+    uint32_t stream_records;
+
+    uint32_t torn_pages;
+    uint32_t dropped_records;
+    uint32_t max_program_us;
+    uint32_t max_erase_us;
+} flog;
+
+static inline uint32_t sector_offset(uint32_t sector) {
+    return STORAGE_LOG_OFFSET + sector * STORAGE_SECTOR_SIZE;
+}
+
+static inline uint32_t page_offset(uint32_t sector, uint32_t page) {
+    return sector_offset(sector) + page * STORAGE_PAGE_SIZE;
+}
+
+static inline uint64_t make_key(uint16_t boot_id, uint32_t timestamp_ms) {
+    return ((uint64_t)boot_id << 32) | timestamp_ms;
+}
+
+static uint32_t page_crc(const uint8_t* page) {
+    const flash_log_page_header_t* hdr = (const flash_log_page_header_t*)page;
+    uint32_t crc = storage_crc32(0, &hdr->seq, offsetof(flash_log_page_header_t, crc) - offsetof(flash_log_page_header_t, seq));
+    return storage_crc32(crc, page + FLASH_LOG_PAGE_HEADER_SIZE, hdr->length);
+}
+
+static bool page_is_valid(const uint8_t* page) {
+    const flash_log_page_header_t* hdr = (const flash_log_page_header_t*)page;
+    return hdr->magic == FLASH_LOG_PAGE_MAGIC &&
+           hdr->seq != 0 &&
+           hdr->length <= FLASH_LOG_PAYLOAD_SIZE &&
+           hdr->crc == page_crc(page);
+}
+
+static uint32_t record_timestamp(const uint8_t* record) {
+    uint32_t timestamp_ms;
+    memcpy(&timestamp_ms, record, sizeof(timestamp_ms));
+    return timestamp_ms;
+}
+
+// Move the RAM page into the pending queue (flog.lock must be held)
+static bool seal_page_locked(void) {
+    if (flog.page_used == 0) {
+        return true;
+    }
+    if (flog.pending_count >= FLASH_LOG_PENDING_PAGES) {
+        return false;
+    }
+
+    flash_log_page_header_t* hdr = (flash_log_page_header_t*)flog.page;
+    hdr->length = (uint16_t)flog.page_used;
+
+    uint32_t slot = (flog.pending_head + flog.pending_count) % FLASH_LOG_PENDING_PAGES;
+    memcpy(flog.pending[slot], flog.page, STORAGE_PAGE_SIZE);
+    flog.pending_count++;
+
+    // Unused bytes stay 0xFF so programming them leaves the flash untouched
+    memset(flog.page, 0xFF, sizeof(flog.page));
+    flog.page_used = 0;
+    return true;
+}
+
+static void erase_sector(uint32_t sector) {
+    uint32_t start = time_us_32();
+    bool ok = storage_flash_erase_sector(sector_offset(sector));
+    uint32_t elapsed = time_us_32() - start;
+
+    if (elapsed > flog.max_erase_us) {
+        flog.max_erase_us = elapsed;
+    }
+    if (ok) {
+        memset(&flog.index[sector], 0, sizeof(flog.index[sector]));
+    }
+
+    if (sector == flog.write_sector) {
+        flog.write_ready = ok;
+    } else if (sector == NEXT_SECTOR(flog.write_sector)) {
+        flog.spare_ready = ok;
+    }
+}
+
+static void advance_sector(void) {
+    flog.write_sector = NEXT_SECTOR(flog.write_sector);
+    flog.write_page = 0;
+    flog.write_ready = flog.spare_ready;
+    flog.spare_ready = false;
+}
+
+static void program_pending_page(void) {
+    uint8_t* page = flog.pending[flog.pending_head];
+    flash_log_page_header_t* hdr = (flash_log_page_header_t*)page;
+
+    hdr->magic = FLASH_LOG_PAGE_MAGIC;
+    hdr->seq = flog.next_seq;
+    hdr->boot_id = flog.boot_id;
+    hdr->crc = page_crc(page);
+
+    uint32_t start = time_us_32();
+    bool ok = storage_flash_program_page(page_offset(flog.write_sector, flog.write_page), page);
+    uint32_t elapsed = time_us_32() - start;
+
+    if (elapsed > flog.max_program_us) {
+        flog.max_program_us = elapsed;
+    }
+    if (!ok) {
+        return;     // Retried on the next call
+    }
+
+    flash_log_sector_index_t* entry = &flog.index[flog.write_sector];
+    if (entry->first_seq == 0) {
+        entry->first_seq = hdr->seq;
+        entry->boot_id = hdr->boot_id;
+        entry->first_ms = record_timestamp(page + FLASH_LOG_PAGE_HEADER_SIZE);
+    }
+    entry->valid_pages++;
+
+    flog.next_seq++;
+    flog.write_page++;
+
+    uint32_t irq_state = spin_lock_blocking(flog.lock);
+    flog.pending_head = (flog.pending_head + 1) % FLASH_LOG_PENDING_PAGES;
+    flog.pending_count--;
+    spin_unlock(flog.lock, irq_state);
+
+    if (flog.write_page == STORAGE_PAGES_PER_SECTOR) {
+        advance_sector();
+    }
+}
+
+// One slow flash operation at most, in order of urgency
+static bool flash_step(void) {
+    if (!flog.write_ready) {
+        erase_sector(flog.write_sector);
+        return true;
+    }
+    if (flog.pending_count > 0) {
+        program_pending_page();
+        return true;
+    }
+    if (!flog.spare_ready) {
+        erase_sector(NEXT_SECTOR(flog.write_sector));
+        return true;
+    }
+    return false;
+}
+
+static void stream_page(const uint8_t* page) {
+    static const char hex_digits[] = "0123456789abcdef";
+    const flash_log_page_header_t* hdr = (const flash_log_page_header_t*)page;
+    const uint8_t* record = page + FLASH_LOG_PAGE_HEADER_SIZE;
+    const uint8_t* end = record + hdr->length;
+
+    while (record + FLASH_LOG_RECORD_HEADER_SIZE <= end) {
+        uint32_t timestamp_ms = record_timestamp(record);
+        uint8_t level = record[4];
+        uint8_t category = record[5];
+        uint8_t text_len = record[6];
+        const uint8_t* text = record + FLASH_LOG_RECORD_HEADER_SIZE;
+
+        if (text + text_len > end) {
+            break;
+        }
+        if (make_key(hdr->boot_id, timestamp_ms) >= flog.stream_key) {
+            printf("FLOG boot=%u [%7lu.%03lu] [%s] [%s] ",
+                   hdr->boot_id, timestamp_ms / 1000, timestamp_ms % 1000,
+                   log_level_to_string((log_level_t)(level & FLASH_LOG_LEVEL_MASK)),
+                   log_category_to_string((log_category_t)category));
+            if (level & FLASH_LOG_LEVEL_BINARY) {
+                // Hex encoded, decoded on the host by tools/log_decode.py
+                char line[2 + FLASH_LOG_MAX_TEXT * 2];
+                char* out = line;
+                *out++ = LOG_BINARY_LINE_PREFIX;
+                for (uint32_t i = 0; i < text_len; i++) {
+                    *out++ = hex_digits[text[i] >> 4];
+                    *out++ = hex_digits[text[i] & 0x0F];
+                }
+                *out = '\0';
+                printf("%s\n", line);
+            } else {
+                printf("%.*s\n", text_len, (const char*)text);
+            }
+            flog.stream_records++;
+        }
+        record = text + text_len;
+    }
+}
+
+static void stream_step(void) {
+    uint32_t oldest = NEXT_SECTOR(flog.write_sector);
+
+    for (uint32_t n = 0; n < FLASH_LOG_STREAM_PAGES; n++) {
+        uint32_t sector = (oldest + flog.stream_logical) % STORAGE_LOG_SECTORS;
+
+        // Caught up with the writer: finish once everything queued has reached flash
+        if (flog.stream_logical >= STORAGE_LOG_SECTORS ||
+            (sector == flog.write_sector && flog.stream_page >= flog.write_page)) {
+            if (flog.pending_count == 0 || flog.stream_logical >= STORAGE_LOG_SECTORS) {
+                printf("FLOG end records=%lu\n", flog.stream_records);
+                flog.streaming = false;
+            }
+            return;
+        }
+
+        const uint8_t* page = storage_flash_ptr(page_offset(sector, flog.stream_page));
+        if (page_is_valid(page)) {
+            stream_page(page);
+        }
+
+        if (++flog.stream_page == STORAGE_PAGES_PER_SECTOR) {
+            flog.stream_page = 0;
+            flog.stream_logical++;
+        }
+    }
+}
+
+static void log_sink(log_level_t level, log_category_t category, const char* message) {
+    flash_log_append(level, category, message);
+
+    // The system halts after a fatal message, so get it onto flash now
+    if (level == LOG_LEVEL_FATAL) {
+        flash_log_flush();
+    }
+}
+
+// Fatal messages are always formatted, so this one never needs to flush
+static void log_binary_sink(log_level_t level, log_category_t category, const char* format,
+                            const uint32_t* args, uint8_t nwords, uint8_t flags) {
+    flash_log_append_binary(level, category, format, args, nwords, flags);
+}
+
+bool flash_log_init(void) {
+    uint32_t newest_seq = 0;
+    uint32_t newest_sector = 0;
+    uint16_t newest_boot = 0;
+
+    memset(&flog, 0, sizeof(flog));
+    memset(flog.page, 0xFF, sizeof(flog.page));
+    flog.lock = spin_lock_instance((uint)spin_lock_claim_unused(true));
+
+    // Single sequential scan: validate every page and rebuild the sector index
+    for (uint32_t s = 0; s < STORAGE_LOG_SECTORS; s++) {
+        flash_log_sector_index_t* entry = &flog.index[s];
+        for (uint32_t p = 0; p < STORAGE_PAGES_PER_SECTOR; p++) {
+            const uint8_t* page = storage_flash_ptr(page_offset(s, p));
+            const flash_log_page_header_t* hdr = (const flash_log_page_header_t*)page;
+
+            if (page_is_valid(page)) {
+                if (entry->first_seq == 0) {
+                    entry->first_seq = hdr->seq;
+                    entry->boot_id = hdr->boot_id;
+                    entry->first_ms = record_timestamp(page + FLASH_LOG_PAGE_HEADER_SIZE);
+                }
+                entry->valid_pages++;
+                if (hdr->seq > newest_seq) {
+                    newest_seq = hdr->seq;
+                    newest_sector = s;
+                    newest_boot = hdr->boot_id;
+                }
+            } else if (!storage_flash_is_erased(page_offset(s, p), STORAGE_PAGE_SIZE)) {
+                flog.torn_pages++;
+            }
+        }
+    }
+
+    // Resume after the last written (valid or torn) page of the newest sector
+    flog.write_sector = newest_sector;
+    flog.write_page = 0;
+    if (newest_seq != 0) {
+        for (uint32_t p = STORAGE_PAGES_PER_SECTOR; p > 0; p--) {
+            if (!storage_flash_is_erased(page_offset(newest_sector, p - 1), STORAGE_PAGE_SIZE)) {
+                flog.write_page = p;
+                break;
+            }
+        }
+    }
+
+    // A sector is only ever erased as a whole, so if its tail is not clean
+    // (interrupted program) move on rather than wiping the valid pages before it
+    bool tail_erased = flog.write_page < STORAGE_PAGES_PER_SECTOR &&
+                       storage_flash_is_erased(page_offset(flog.write_sector, flog.write_page),
+                                               STORAGE_SECTOR_SIZE - flog.write_page * STORAGE_PAGE_SIZE);
+    if (flog.write_page > 0 && !tail_erased) {
+        flog.write_sector = NEXT_SECTOR(flog.write_sector);
+        flog.write_page = 0;
+        tail_erased = storage_flash_is_erased(sector_offset(flog.write_sector), STORAGE_SECTOR_SIZE);
+    }
+    flog.write_ready = tail_erased;
+    flog.spare_ready = storage_flash_is_erased(sector_offset(NEXT_SECTOR(flog.write_sector)),
+                                               STORAGE_SECTOR_SIZE);
+
+    flog.next_seq = newest_seq + 1;
+    flog.boot_id = (uint16_t)(newest_boot + 1);
+    if (flog.boot_id == 0) {
+        flog.boot_id = 1;
+    }
+    flog.mounted = true;
+
+    log_set_sink(log_sink, log_binary_sink, FLASH_LOG_MIN_LEVEL);
+
+    flash_log_stats_t stats;
+    flash_log_get_stats(&stats);
+    LOG_SYS_INFO("Flash log mounted: boot %u, %lu/%lu pages, %lu torn",
+                 stats.boot_id, stats.pages_used, stats.pages_total, stats.torn_pages);
+    return true;
+}
+
+// Copy one record (header, then head and body back to back) into the RAM page
+static bool append_record(uint8_t level, log_category_t category,
+                          const void* head, uint32_t head_len, const void* body, uint32_t body_len) {
+    uint32_t record_len = FLASH_LOG_RECORD_HEADER_SIZE + head_len + body_len;
+    uint32_t timestamp_ms = to_ms_since_boot(get_absolute_time());
+
+    uint32_t irq_state = spin_lock_blocking(flog.lock);
+
+    if (flog.page_used + record_len > FLASH_LOG_PAYLOAD_SIZE && !seal_page_locked()) {
+        flog.dropped_records++;
+        spin_unlock(flog.lock, irq_state);
+        return false;
+    }
+
+    uint8_t* record = flog.page + FLASH_LOG_PAGE_HEADER_SIZE + flog.page_used;
+    memcpy(record, &timestamp_ms, sizeof(timestamp_ms));
+    record[4] = level;
+    record[5] = (uint8_t)category;
+    record[6] = (uint8_t)(head_len + body_len);
+    memcpy(record + FLASH_LOG_RECORD_HEADER_SIZE, head, head_len);
+    memcpy(record + FLASH_LOG_RECORD_HEADER_SIZE + head_len, body, body_len);
+    flog.page_used += record_len;
+    flog.last_append_ms = timestamp_ms;
+
+    spin_unlock(flog.lock, irq_state);
+    return true;
+}
+
+bool flash_log_append(log_level_t level, log_category_t category, const char* text) {
+    if (!flog.mounted) {
+        return false;
+    }
+
+    size_t text_len = strlen(text);
+    if (text_len > FLASH_LOG_MAX_TEXT) {
+        text_len = FLASH_LOG_MAX_TEXT;
+    }
+    return append_record((uint8_t)level, category, text, text_len, "", 0);
+}
+
+bool flash_log_append_binary(log_level_t level, log_category_t category, const char* format,
+                             const uint32_t* args, uint8_t nwords, uint8_t flags) {
+    if (!flog.mounted) {
+        return false;
+    }
+
+    uint8_t head[5];
+    uint32_t fmt = (uint32_t)(uintptr_t)format;
+    memcpy(head, &fmt, sizeof(fmt));
+    head[4] = flags;
+    return append_record((uint8_t)level | FLASH_LOG_LEVEL_BINARY, category,
+                         head, sizeof(head), args, nwords * 4u);
+}
+
+void flash_log_process(void) {
+    if (!flog.mounted) {
+        return;
+    }
+
+    // Seal a partly filled page once logging goes quiet so it reaches flash
+    if (flog.page_used > 0 &&
+        to_ms_since_boot(get_absolute_time()) - flog.last_append_ms >= FLASH_LOG_FLUSH_MS) {
+        uint32_t irq_state = spin_lock_blocking(flog.lock);
+        seal_page_locked();
+        spin_unlock(flog.lock, irq_state);
+    }
+
+    flash_step();
+
+    if (flog.streaming) {
+        stream_step();
+    }
+}
+
+void flash_log_flush(void) {
+    if (!flog.mounted) {
+        return;
+    }
+
+    // Bounded: one erase and one program per page at most
+    for (uint32_t i = 0; i < 2 * (FLASH_LOG_PENDING_PAGES + 1); i++) {
+        uint32_t irq_state = spin_lock_blocking(flog.lock);
+        bool sealed = seal_page_locked();
+        spin_unlock(flog.lock, irq_state);
+
+        if (sealed && flog.pending_count == 0) {
+            break;
+        }
+        if (!flash_step()) {
+            break;
+        }
+    }
+}
+
+bool flash_log_stream_start(uint16_t boot_id, uint32_t timestamp_ms) {
+    if (!flog.mounted) {
+        return false;
+    }
+
+    // Make what is still in RAM part of the stream
+    uint32_t irq_state = spin_lock_blocking(flog.lock);
+    seal_page_locked();
+    spin_unlock(flog.lock, irq_state);
+
+    // Sectors in age order are sorted by key, so the start is the last sector
+    // whose first record is not newer than the requested point
+    uint64_t key = make_key(boot_id, timestamp_ms);
+    uint32_t oldest = NEXT_SECTOR(flog.write_sector);
+    uint32_t start_logical = 0;
+    bool found = false;
+    for (uint32_t i = 0; i < STORAGE_LOG_SECTORS; i++) {
+        const flash_log_sector_index_t* entry = &flog.index[(oldest + i) % STORAGE_LOG_SECTORS];
+        if (entry->first_seq == 0) {
+            continue;
+        }
+        if (!found || make_key(entry->boot_id, entry->first_ms) <= key) {
+            start_logical = i;
+            found = true;
+        } else {
+            break;
+        }
+    }
+
+    flog.streaming = true;
+    flog.stream_logical = start_logical;
+    flog.stream_page = 0;
+    flog.stream_key = key;
+    flog.stream_records = 0;
+
+    printf("FLOG begin boot=%u from_boot=%u from_ms=%lu\n", flog.boot_id, boot_id, timestamp_ms);
+    return true;
+}
+
+void flash_log_get_stats(flash_log_stats_t* stats) {
+    memset(stats, 0, sizeof(*stats));
+    stats->boot_id = flog.boot_id;
+    stats->pages_total = LOG_PAGES_TOTAL;
+    for (uint32_t s = 0; s < STORAGE_LOG_SECTORS; s++) {
+        stats->pages_used += flog.index[s].valid_pages;
+    }
+    stats->torn_pages = flog.torn_pages;
+    stats->dropped_records = flog.dropped_records;
+    stats->max_program_us = flog.max_program_us;
+    stats->max_erase_us = flog.max_erase_us;
+}
+
+uint16_t flash_log_get_boot_id(void) {
+    return flog.boot_id;
+}
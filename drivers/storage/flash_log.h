@@ -0,0 +1,82 @@
+/**
+ * PicoFlora Persistent Log Store
+ *
+ * Log-structured circular store in the reserved flash region, so log and
+ * event records survive when no USB host is attached.
+ *
+ * Records are appended to a RAM page and only written out by
+ * flash_log_process() from the main loop, one 256-byte page program at a
+ * time. The sector after the one being written is always erased ahead of
+ * time, so a page program never has to wait for a 4 KB erase. Erasing the
+ * spare sector is also what discards the oldest data once the store wraps.
+ *
+ * Page layout (little-endian):
+ *   magic:u32 seq:u32 boot_id:u16 length:u16 crc32:u32 payload[length]
+ * The CRC covers seq..payload, so pages torn by a power loss are skipped.
+ * Payload records:
+ *   timestamp_ms:u32 level:u8 category:u8 text_len:u8 text[text_len]
+ * With the binary log backend active the text is not formatted: the level
+ * carries FLASH_LOG_LEVEL_BINARY and text holds the binary log record
+ *   fmt:u32 flags:u8 args:u32[]
+ * (see log_binary.h), turned back into text on the host with the firmware ELF.
+ * Records never span pages. tools/flash_log_decode.py reads the same format
+ * from a raw flash image (e.g. from `picotool save -r`).
+ */
+
+#ifndef FLASH_LOG_H
+#define FLASH_LOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../logging/logging.h"
+
+// Configuration
+#define FLASH_LOG_MIN_LEVEL LOG_LEVEL_INFO     // Lowest level persisted to flash
+#define FLASH_LOG_PENDING_PAGES 4              // Sealed pages waiting to be programmed
+#define FLASH_LOG_FLUSH_MS 2000                // Seal a partly filled page after this idle time
+#define FLASH_LOG_STREAM_PAGES 4               // Pages streamed per flash_log_process() call
+
+// Format constants (shared with tools/flash_log_decode.py)
+#define FLASH_LOG_PAGE_MAGIC 0x474C4650u       // "PFLG"
+#define FLASH_LOG_PAGE_HEADER_SIZE 16
+#define FLASH_LOG_RECORD_HEADER_SIZE 7
+#define FLASH_LOG_PAYLOAD_SIZE (256 - FLASH_LOG_PAGE_HEADER_SIZE)
+#define FLASH_LOG_MAX_TEXT (FLASH_LOG_PAYLOAD_SIZE - FLASH_LOG_RECORD_HEADER_SIZE)
+#define FLASH_LOG_LEVEL_BINARY 0x80            // Level flag: the record holds a binary log record
+#define FLASH_LOG_LEVEL_MASK 0x0F
+
+// Store statistics
+typedef struct {
+    uint16_t boot_id;           // Boot counter of the current session
+    uint32_t pages_used;        // Valid pages currently held in flash
+    uint32_t pages_total;       // Capacity in pages
+    uint32_t torn_pages;        // Pages rejected at mount (bad CRC, e.g. power loss)
+    uint32_t dropped_records;   // Records lost because the pending queue was full
+    uint32_t max_program_us;    // Longest page program seen
+    uint32_t max_erase_us;      // Longest sector erase seen
+} flash_log_stats_t;
+
+// Initialization - mounts the store, rebuilds the RAM index and hooks into logging
+bool flash_log_init(void);
+
+// Append a record to the RAM page (safe from IRQ context, never touches flash)
+bool flash_log_append(log_level_t level, log_category_t category, const char* text);
+
+// Append a binary log record, unformatted (same context rules)
+bool flash_log_append_binary(log_level_t level, log_category_t category, const char* format,
+                             const uint32_t* args, uint8_t nwords, uint8_t flags);
+
+// Background work - program pending pages, erase ahead, stream output
+void flash_log_process(void);
+
+// Seal the current page and write everything out synchronously
+void flash_log_flush(void);
+
+// Stream records at or after (boot_id, timestamp_ms) over stdio ("FLOG ..." lines)
+bool flash_log_stream_start(uint16_t boot_id, uint32_t timestamp_ms);
+
+// Statistics access
+void flash_log_get_stats(flash_log_stats_t* stats);
+uint16_t flash_log_get_boot_id(void);
+
+#endif // FLASH_LOG_H
@@ -0,0 +1,463 @@
+/**
+ * PicoFlora Settings Store Implementation
+ */
+
+#include "settings_store.h"
+#include "storage_flash.h"
+#include "pico/stdlib.h"
+#include "hardware/timer.h"
+#include "../logging/logging.h"
+#include <stdio.h>
+#include <string.h>
+
+#define SETTINGS_PAGE_MAGIC 0x564B4650u        // "PFKV"
+#define PAGE_HEADER_SIZE 16
+#define PAYLOAD_SIZE (STORAGE_PAGE_SIZE - PAGE_HEADER_SIZE)
+#define RECORD_HEADER_SIZE 2
+#define NEXT_SECTOR(s) (((s) + 1) % STORAGE_SETTINGS_SECTORS)
+
+_Static_assert((SETTINGS_INDEX_SLOTS & (SETTINGS_INDEX_SLOTS - 1)) == 0,
+               "index size must be a power of two");
+_Static_assert(STORAGE_SETTINGS_SECTORS >= 3,
+               "need a write sector, an erased spare and at least one sector of history");
+
+// Page header as stored in flash
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;
+    uint16_t length;
+    uint16_t reserved;
+    uint32_t crc;
+} settings_page_header_t;
+
+_Static_assert(sizeof(settings_page_header_t) == PAGE_HEADER_SIZE, "page header must be packed");
+
+// Hash index entry: newest record for one key
+typedef struct {
+    uint32_t hash;
+    uint32_t offset;            // Flash offset of the record, 0 = empty slot
+    uint32_t seq;               // Sequence of the page holding it
+} settings_index_entry_t;
+
+// Store state
+static struct {
+    bool mounted;
+    bool compacting;
+    uint32_t next_seq;
+    uint32_t write_sector;
+    uint32_t write_page;
+
+    settings_index_entry_t index[SETTINGS_INDEX_SLOTS];
+
+    // Staged changes, committed together in one page program
+    uint8_t batch[STORAGE_PAGE_SIZE];
+    uint32_t batch_used;
+    uint32_t last_change_ms;
+
+    // Results of the last scan
+    uint32_t newest_seq;
+    uint32_t newest_sector;
+    uint32_t pages_used;
+    uint32_t torn_pages;
+
+    uint32_t load_us;
+    uint32_t commits;
+} store;
+
+static inline uint32_t sector_offset(uint32_t sector) {
+    return STORAGE_SETTINGS_OFFSET + sector * STORAGE_SECTOR_SIZE;
+}
+
+static inline uint32_t page_offset(uint32_t sector, uint32_t page) {
+    return sector_offset(sector) + page * STORAGE_PAGE_SIZE;
+}
+
+// FNV-1a
+static uint32_t key_hash(const char* key, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (uint8_t)key[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static uint32_t page_crc(const uint8_t* page) {
+    const settings_page_header_t* hdr = (const settings_page_header_t*)page;
+    uint32_t crc = storage_crc32(0, &hdr->seq, offsetof(settings_page_header_t, crc) - offsetof(settings_page_header_t, seq));
+    return storage_crc32(crc, page + PAGE_HEADER_SIZE, hdr->length);
+}
+
+static bool page_is_valid(const uint8_t* page) {
+    const settings_page_header_t* hdr = (const settings_page_header_t*)page;
+    return hdr->magic == SETTINGS_PAGE_MAGIC &&
+           hdr->seq != 0 &&
+           hdr->length <= PAYLOAD_SIZE &&
+           hdr->crc == page_crc(page);
+}
+
+static bool record_key_matches(const uint8_t* record, const char* key, size_t key_length) {
+    return record[0] == key_length && memcmp(record + RECORD_HEADER_SIZE, key, key_length) == 0;
+}
+
+// Slot holding key, or the empty slot where it would go (-1 if the index is full)
+static int index_find(const char* key, size_t key_length, uint32_t hash) {
+    for (uint32_t probe = 0; probe < SETTINGS_INDEX_SLOTS; probe++) {
+        uint32_t slot = (hash + probe) & (SETTINGS_INDEX_SLOTS - 1);
+        const settings_index_entry_t* entry = &store.index[slot];
+
+        if (entry->offset == 0) {
+            return (int)slot;
+        }
+        if (entry->hash == hash &&
+            record_key_matches(storage_flash_ptr(entry->offset), key, key_length)) {
+            return (int)slot;
+        }
+    }
+    return -1;
+}
+
+static void index_update(uint32_t record_offset, uint32_t seq) {
+    const uint8_t* record = storage_flash_ptr(record_offset);
+    const char* key = (const char*)(record + RECORD_HEADER_SIZE);
+    uint32_t hash = key_hash(key, record[0]);
+    int slot = index_find(key, record[0], hash);
+
+    if (slot < 0) {
+        LOG_SYS_ERROR("Settings index full");
+        return;
+    }
+
+    // Records within a page are visited in order, so equal sequence means newer
+    settings_index_entry_t* entry = &store.index[slot];
+    if (entry->offset == 0 || seq >= entry->seq) {
+        entry->hash = hash;
+        entry->offset = record_offset;
+        entry->seq = seq;
+    }
+}
+
+// Visit every record of a valid page: fn(record_offset, seq)
+static void for_each_record(uint32_t offset, void (*fn)(uint32_t, uint32_t)) {
+    const uint8_t* page = storage_flash_ptr(offset);
+    const settings_page_header_t* hdr = (const settings_page_header_t*)page;
+    uint32_t pos = 0;
+
+    while (pos + RECORD_HEADER_SIZE <= hdr->length) {
+        const uint8_t* record = page + PAGE_HEADER_SIZE + pos;
+        uint32_t record_length = RECORD_HEADER_SIZE + record[0] + record[1];
+        if (record[0] == 0 || pos + record_length > hdr->length) {
+            break;
+        }
+        fn(offset + PAGE_HEADER_SIZE + pos, hdr->seq);
+        pos += record_length;
+    }
+}
+
+// Single sequential pass over the region: validate pages and rebuild the index
+static void scan(void) {
+    memset(store.index, 0, sizeof(store.index));
+    store.newest_seq = 0;
+    store.newest_sector = 0;
+    store.pages_used = 0;
+    store.torn_pages = 0;
+
+    for (uint32_t s = 0; s < STORAGE_SETTINGS_SECTORS; s++) {
+        for (uint32_t p = 0; p < STORAGE_PAGES_PER_SECTOR; p++) {
+            uint32_t offset = page_offset(s, p);
+            const uint8_t* page = storage_flash_ptr(offset);
+
+            if (page_is_valid(page)) {
+                uint32_t seq = ((const settings_page_header_t*)page)->seq;
+                for_each_record(offset, index_update);
+                store.pages_used++;
+                if (seq > store.newest_seq) {
+                    store.newest_seq = seq;
+                    store.newest_sector = s;
+                }
+            } else if (!storage_flash_is_erased(offset, STORAGE_PAGE_SIZE)) {
+                store.torn_pages++;
+            }
+        }
+    }
+}
+
+// Newest record for key: staged changes first, then flash (NULL if never set)
+static const uint8_t* find_record(const char* key, size_t key_length) {
+    const uint8_t* found = NULL;
+    uint32_t pos = 0;
+
+    while (pos < store.batch_used) {
+        const uint8_t* record = store.batch + PAGE_HEADER_SIZE + pos;
+        if (record_key_matches(record, key, key_length)) {
+            found = record;
+        }
+        pos += RECORD_HEADER_SIZE + record[0] + record[1];
+    }
+    if (found) {
+        return found;
+    }
+
+    int slot = index_find(key, key_length, key_hash(key, key_length));
+    if (slot < 0 || store.index[slot].offset == 0) {
+        return NULL;
+    }
+    return storage_flash_ptr(store.index[slot].offset);
+}
+
+static void compact_sector(uint32_t sector);
+
+static bool program_batch(void) {
+    settings_page_header_t* hdr = (settings_page_header_t*)store.batch;
+    uint32_t offset = page_offset(store.write_sector, store.write_page);
+
+    hdr->magic = SETTINGS_PAGE_MAGIC;
+    hdr->seq = store.next_seq;
+    hdr->length = (uint16_t)store.batch_used;
+    hdr->reserved = 0xFFFF;
+    hdr->crc = page_crc(store.batch);
+
+    if (!storage_flash_program_page(offset, store.batch)) {
+        LOG_SYS_ERROR("Settings commit failed at 0x%08lx", offset);
+        return false;
+    }
+
+    for_each_record(offset, index_update);
+    store.next_seq++;
+    store.pages_used++;
+    store.commits++;
+    memset(store.batch, 0xFF, sizeof(store.batch));
+    store.batch_used = 0;
+
+    // Entering a new sector: the one after it must be emptied before it is needed
+    if (++store.write_page == STORAGE_PAGES_PER_SECTOR) {
+        store.write_sector = NEXT_SECTOR(store.write_sector);
+        store.write_page = 0;
+        if (!store.compacting) {
+            compact_sector(NEXT_SECTOR(store.write_sector));
+        }
+    }
+    return true;
+}
+
+static bool stage_record(const char* key, size_t key_length, const void* value, size_t value_length) {
+    uint32_t record_length = RECORD_HEADER_SIZE + key_length + value_length;
+
+    if (store.batch_used + record_length > PAYLOAD_SIZE && !program_batch()) {
+        return false;
+    }
+
+    uint8_t* record = store.batch + PAGE_HEADER_SIZE + store.batch_used;
+    record[0] = (uint8_t)key_length;
+    record[1] = (uint8_t)value_length;
+    memcpy(record + RECORD_HEADER_SIZE, key, key_length);
+    if (value_length > 0) {
+        memcpy(record + RECORD_HEADER_SIZE + key_length, value, value_length);
+    }
+    store.batch_used += record_length;
+    store.last_change_ms = to_ms_since_boot(get_absolute_time());
+    return true;
+}
+
+static void relocate_if_live(uint32_t record_offset, uint32_t seq) {
+    (void)seq;
+    const uint8_t* record = storage_flash_ptr(record_offset);
+    const char* key = (const char*)(record + RECORD_HEADER_SIZE);
+    int slot = index_find(key, record[0], key_hash(key, record[0]));
+
+    // Deleted keys are simply dropped: nothing older than this sector remains
+    if (slot >= 0 && store.index[slot].offset == record_offset && record[1] > 0) {
+        stage_record(key, record[0], record + RECORD_HEADER_SIZE + record[0], record[1]);
+    }
+}
+
+// Copy the live records of a sector forward, then erase it
+static void compact_sector(uint32_t sector) {
+    store.compacting = true;
+
+    for (uint32_t p = 0; p < STORAGE_PAGES_PER_SECTOR; p++) {
+        uint32_t offset = page_offset(sector, p);
+        if (page_is_valid(storage_flash_ptr(offset))) {
+            for_each_record(offset, relocate_if_live);
+        }
+    }
+    if (store.batch_used > 0) {
+        program_batch();
+    }
+
+    if (!storage_flash_erase_sector(sector_offset(sector))) {
+        LOG_SYS_ERROR("Settings sector %lu erase failed", sector);
+    }
+
+    // Drop index entries that pointed into the erased sector (deleted keys)
+    scan();
+    store.compacting = false;
+}
+
+bool settings_init(void) {
+    uint32_t start = time_us_32();
+
+    memset(&store, 0, sizeof(store));
+    memset(store.batch, 0xFF, sizeof(store.batch));
+    scan();
+    store.next_seq = store.newest_seq + 1;
+
+    if (store.newest_seq == 0) {
+        // Empty store - make sure no leftovers from older firmware remain
+        if (!storage_flash_is_erased(STORAGE_SETTINGS_OFFSET, STORAGE_SETTINGS_SECTORS * STORAGE_SECTOR_SIZE)) {
+            LOG_SYS_INFO("Formatting settings store");
+            for (uint32_t s = 0; s < STORAGE_SETTINGS_SECTORS; s++) {
+                storage_flash_erase_sector(sector_offset(s));
+            }
+        }
+    } else {
+        // Resume after the last written page of the newest sector
+        store.write_sector = store.newest_sector;
+        for (uint32_t p = STORAGE_PAGES_PER_SECTOR; p > 0; p--) {
+            if (!storage_flash_is_erased(page_offset(store.write_sector, p - 1), STORAGE_PAGE_SIZE)) {
+                store.write_page = p;
+                break;
+            }
+        }
+        if (store.write_page == STORAGE_PAGES_PER_SECTOR) {
+            store.write_sector = NEXT_SECTOR(store.write_sector);
+            store.write_page = 0;
+            if (!storage_flash_is_erased(sector_offset(store.write_sector), STORAGE_SECTOR_SIZE)) {
+                LOG_SYS_WARN("Settings sector %lu not erased, discarding it", store.write_sector);
+                storage_flash_erase_sector(sector_offset(store.write_sector));
+                scan();
+            }
+        }
+
+        // Finish a compaction interrupted by a power loss
+        uint32_t spare = NEXT_SECTOR(store.write_sector);
+        if (!storage_flash_is_erased(sector_offset(spare), STORAGE_SECTOR_SIZE)) {
+            compact_sector(spare);
+        }
+    }
+
+    store.mounted = true;
+    store.load_us = time_us_32() - start;
+
+    settings_stats_t stats;
+    settings_get_stats(&stats);
+    LOG_SYS_INFO("Settings loaded: %lu keys, %lu pages, %lu torn in %lu us",
+                 stats.keys, stats.pages_used, stats.torn_pages, stats.load_us);
+    return true;
+}
+
+int settings_get(const char* key, void* value, size_t max_length) {
+    size_t key_length = strlen(key);
+    if (!store.mounted || key_length == 0 || key_length > SETTINGS_MAX_KEY_LENGTH) {
+        return -1;
+    }
+
+    const uint8_t* record = find_record(key, key_length);
+    if (record == NULL || record[1] == 0) {
+        return -1;
+    }
+
+    size_t length = record[1];
+    memcpy(value, record + RECORD_HEADER_SIZE + key_length, length < max_length ? length : max_length);
+    return (int)length;
+}
+
+bool settings_set(const char* key, const void* value, size_t length) {
+    size_t key_length = strlen(key);
+    if (!store.mounted || key_length == 0 || key_length > SETTINGS_MAX_KEY_LENGTH ||
+        length == 0 || length > SETTINGS_MAX_VALUE_LENGTH) {
+        return false;
+    }
+
+    // Unchanged values cost no flash
+    const uint8_t* record = find_record(key, key_length);
+    if (record != NULL && record[1] == length &&
+        memcmp(record + RECORD_HEADER_SIZE + key_length, value, length) == 0) {
+        return true;
+    }
+    return stage_record(key, key_length, value, length);
+}
+
+bool settings_delete(const char* key) {
+    size_t key_length = strlen(key);
+    if (!store.mounted || key_length == 0 || key_length > SETTINGS_MAX_KEY_LENGTH) {
+        return false;
+    }
+
+    const uint8_t* record = find_record(key, key_length);
+    if (record == NULL || record[1] == 0) {
+        return true;
+    }
+    return stage_record(key, key_length, NULL, 0);
+}
+
+uint32_t settings_get_u32(const char* key, uint32_t default_value) {
+    uint32_t value;
+    if (settings_get(key, &value, sizeof(value)) != (int)sizeof(value)) {
+        return default_value;
+    }
+    return value;
+}
+
+bool settings_set_u32(const char* key, uint32_t value) {
+    return settings_set(key, &value, sizeof(value));
+}
+
+bool settings_commit(void) {
+    if (!store.mounted || store.batch_used == 0) {
+        return true;
+    }
+    return program_batch();
+}
+
+void settings_process(void) {
+    if (store.batch_used > 0 &&
+        to_ms_since_boot(get_absolute_time()) - store.last_change_ms >= SETTINGS_COMMIT_DELAY_MS) {
+        settings_commit();
+    }
+}
+
+void settings_get_stats(settings_stats_t* stats) {
+    memset(stats, 0, sizeof(*stats));
+    for (uint32_t i = 0; i < SETTINGS_INDEX_SLOTS; i++) {
+        const settings_index_entry_t* entry = &store.index[i];
+        if (entry->offset != 0 && storage_flash_ptr(entry->offset)[1] > 0) {
+            stats->keys++;
+        }
+    }
+    stats->pages_used = store.pages_used;
+    stats->torn_pages = store.torn_pages;
+    stats->load_us = store.load_us;
+    stats->commits = store.commits;
+}
+
+void settings_dump(void) {
+    settings_stats_t stats;
+    settings_get_stats(&stats);
+
+    printf("SET begin keys=%lu pages=%lu commits=%lu staged=%lu\n",
+           stats.keys, stats.pages_used, stats.commits, store.batch_used);
+    for (uint32_t i = 0; i < SETTINGS_INDEX_SLOTS; i++) {
+        const settings_index_entry_t* entry = &store.index[i];
+        if (entry->offset == 0) {
+            continue;
+        }
+        const uint8_t* record = storage_flash_ptr(entry->offset);
+        const uint8_t* value = record + RECORD_HEADER_SIZE + record[0];
+        if (record[1] == 0) {
+            continue;
+        }
+        printf("SET %.*s=", record[0], (const char*)(record + RECORD_HEADER_SIZE));
+        if (record[1] == sizeof(uint32_t)) {
+            uint32_t v;
+            memcpy(&v, value, sizeof(v));
+            printf("%lu\n", v);
+        } else {
+            for (uint32_t b = 0; b < record[1]; b++) {
+                printf("%02x", value[b]);
+            }
+            printf("\n");
+        }
+    }
+    printf("SET end\n");
+}
@@ -0,0 +1,79 @@
+/**
+ * PicoFlora Settings Store
+ *
+ * Small log-structured key/value store in the last flash sectors, so user
+ * settings survive a reboot.
+ *
+ * Changes are staged in a RAM page and committed together in a single page
+ * program, either explicitly with settings_commit() or by settings_process()
+ * once the changes have settled. A page is all-or-nothing thanks to its CRC,
+ * so every batch of changes that fits in one page is committed atomically.
+ * At boot a single sequential scan rebuilds an in-RAM hash index of the
+ * newest record for every key; lookups then read the value straight from XIP.
+ *
+ * When the writer moves into a new sector, the live records of the oldest
+ * sector are copied forward and that sector is erased, so one erased sector
+ * is always available.
+ *
+ * Page layout (little-endian):
+ *   magic:u32 seq:u32 length:u16 reserved:u16 crc32:u32 payload[length]
+ * Payload records:
+ *   key_len:u8 value_len:u8 key[key_len] value[value_len]   (value_len 0 = deleted)
+ *
+ * Not safe from IRQ context - call from the main loop only.
+ */
+
+#ifndef SETTINGS_STORE_H
+#define SETTINGS_STORE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Configuration
+#define SETTINGS_MAX_KEY_LENGTH 15
+#define SETTINGS_MAX_VALUE_LENGTH 32
+#define SETTINGS_INDEX_SLOTS 128               // Hash index size (power of two)
+#define SETTINGS_COMMIT_DELAY_MS 1000          // Settle time before staged changes are committed
+
+// Known keys
+#define SETTINGS_KEY_LCD_BRIGHTNESS  "lcd.bright"   // u32, 0-100
+#define SETTINGS_KEY_LOG_LEVEL       "log.level"    // u32, log_level_t
+#define SETTINGS_KEY_STEPPER_STEPS   "step.count"   // u32, last slider value
+#define SETTINGS_KEY_STEPPER_MIN_HZ  "step.fmin"    // u32, minimum step frequency
+#define SETTINGS_KEY_STEPPER_MAX_HZ  "step.fmax"    // u32, maximum step frequency
+#define SETTINGS_KEY_RTC_LAST_TIME   "rtc.last"     // u32, last known time (seconds since 1970)
+#define SETTINGS_KEY_DOSING_CAL_PREFIX "dose.cal"   // + pump number, dosing_cal_point_t[]
+#define SETTINGS_KEY_VIBRATION_BASELINE "vib.base"  // vibration_baseline_t, healthy pump band levels
+#define SETTINGS_KEY_SCHEDULE_PREFIX "sched."       // + rule id, schedule_rule_t
+
+// Store statistics
+typedef struct {
+    uint32_t keys;              // Live keys in the index
+    uint32_t pages_used;        // Valid pages in flash
+    uint32_t torn_pages;        // Pages rejected at boot (bad CRC, e.g. power loss)
+    uint32_t load_us;           // Duration of the boot scan
+    uint32_t commits;           // Page programs since boot
+} settings_stats_t;
+
+// Initialization - scans the store and rebuilds the index
+bool settings_init(void);
+
+// Raw access - get returns the value length, or -1 if the key is not set
+int settings_get(const char* key, void* value, size_t max_length);
+bool settings_set(const char* key, const void* value, size_t length);
+bool settings_delete(const char* key);
+
+// Typed helpers
+uint32_t settings_get_u32(const char* key, uint32_t default_value);
+bool settings_set_u32(const char* key, uint32_t value);
+
+// Write staged changes now / after they have settled (call from the main loop)
+bool settings_commit(void);
+void settings_process(void);
+
+// Diagnostics
+void settings_get_stats(settings_stats_t* stats);
+void settings_dump(void);
+
+#endif // SETTINGS_STORE_H
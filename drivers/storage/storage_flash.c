@@ -0,0 +1,103 @@
+/**
+ * PicoFlora Flash Storage Layer Implementation
+ */
+
+#include "storage_flash.h"
+#include "pico/stdlib.h"
+#include "pico/flash.h"
+#include "hardware/regs/addressmap.h"
+#include "../logging/logging.h"
+
+// End of the firmware image in flash (provided by the SDK linker script)
+extern char __flash_binary_end;
+
+typedef struct {
+    uint32_t offset;
+    const uint8_t* data;
+} flash_op_t;
+
+static bool layout_ok = false;
+
+// Nibble-wide table keeps the CRC small; records are short so speed is not critical
+static const uint32_t crc32_nibble_table[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+    0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+    0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+static bool offset_in_reserved(uint32_t offset, uint32_t length) {
+    return layout_ok && offset >= STORAGE_RESERVED_OFFSET &&
+           offset + length <= PICO_FLASH_SIZE_BYTES;
+}
+
+static void erase_sector_unsafe(void* param) {
+    const flash_op_t* op = (const flash_op_t*)param;
+    flash_range_erase(op->offset, STORAGE_SECTOR_SIZE);
+}
+
+static void program_page_unsafe(void* param) {
+    const flash_op_t* op = (const flash_op_t*)param;
+    flash_range_program(op->offset, op->data, STORAGE_PAGE_SIZE);
+}
+
+bool storage_flash_init(void) {
+    uint32_t image_end = (uint32_t)((uintptr_t)&__flash_binary_end - XIP_BASE);
+
+    layout_ok = (image_end <= STORAGE_RESERVED_OFFSET);
+    if (!layout_ok) {
+        LOG_HW_ERROR("Firmware image (%lu bytes) overlaps flash storage at 0x%08lx",
+                     image_end, (uint32_t)STORAGE_RESERVED_OFFSET);
+        return false;
+    }
+
+    LOG_HW_INFO("Flash storage reserved: %lu KB at 0x%08lx",
+                (uint32_t)((PICO_FLASH_SIZE_BYTES - STORAGE_RESERVED_OFFSET) / 1024),
+                (uint32_t)STORAGE_RESERVED_OFFSET);
+    return true;
+}
+
+const uint8_t* storage_flash_ptr(uint32_t offset) {
+    return (const uint8_t*)(XIP_BASE + offset);
+}
+
+bool storage_flash_is_erased(uint32_t offset, size_t length) {
+    const uint32_t* words = (const uint32_t*)storage_flash_ptr(offset);
+
+    for (size_t i = 0; i < length / sizeof(uint32_t); i++) {
+        if (words[i] != 0xFFFFFFFFu) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool storage_flash_erase_sector(uint32_t offset) {
+    if ((offset % STORAGE_SECTOR_SIZE) != 0 || !offset_in_reserved(offset, STORAGE_SECTOR_SIZE)) {
+        return false;
+    }
+
+    flash_op_t op = { .offset = offset, .data = NULL };
+    return flash_safe_execute(erase_sector_unsafe, &op, STORAGE_SAFE_TIMEOUT_MS) == PICO_OK;
+}
+
+bool storage_flash_program_page(uint32_t offset, const uint8_t* data) {
+    if ((offset % STORAGE_PAGE_SIZE) != 0 || !offset_in_reserved(offset, STORAGE_PAGE_SIZE)) {
+        return false;
+    }
+
+    flash_op_t op = { .offset = offset, .data = data };
+    return flash_safe_execute(program_page_unsafe, &op, STORAGE_SAFE_TIMEOUT_MS) == PICO_OK;
+}
+
+uint32_t storage_crc32(uint32_t crc, const void* data, size_t length) {
+    const uint8_t* bytes = (const uint8_t*)data;
+
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= bytes[i];
+        crc = (crc >> 4) ^ crc32_nibble_table[crc & 0x0F];
+        crc = (crc >> 4) ^ crc32_nibble_table[crc & 0x0F];
+    }
+    return ~crc;
+}
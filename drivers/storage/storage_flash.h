@@ -0,0 +1,56 @@
+/**
+ * PicoFlora Flash Storage Layer
+ *
+ * Shared plumbing for the stores kept in the reserved area at the top of the
+ * QSPI flash: region layout, XIP read access, interrupt/multicore safe erase
+ * and program wrappers, and the CRC used to validate records.
+ *
+ * Erase and program stall execution from flash (XIP is unavailable while the
+ * flash is busy), so callers are expected to run them from the main loop,
+ * never from an interrupt or a time critical path.
+ */
+
+#ifndef STORAGE_FLASH_H
+#define STORAGE_FLASH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "hardware/flash.h"
+
+// Flash geometry
+#define STORAGE_SECTOR_SIZE FLASH_SECTOR_SIZE       // Smallest erasable unit (4 KB)
+#define STORAGE_PAGE_SIZE   FLASH_PAGE_SIZE         // Smallest programmable unit (256 bytes)
+#define STORAGE_PAGES_PER_SECTOR (STORAGE_SECTOR_SIZE / STORAGE_PAGE_SIZE)
+
+// Reserved region layout (offsets from the start of flash, growing down from the top)
+#define STORAGE_SETTINGS_SECTORS 4                  // Key/value settings store (16 KB)
+#define STORAGE_SETTINGS_OFFSET (PICO_FLASH_SIZE_BYTES - STORAGE_SETTINGS_SECTORS * STORAGE_SECTOR_SIZE)
+#define STORAGE_LOG_SECTORS 64                      // Persistent log store (256 KB)
+#define STORAGE_LOG_OFFSET  (STORAGE_SETTINGS_OFFSET - STORAGE_LOG_SECTORS * STORAGE_SECTOR_SIZE)
+#define STORAGE_TS_RAW_SECTORS 32                   // Time-series tiers, one ring each (see timeseries.h)
+#define STORAGE_TS_1MIN_SECTORS 48
+#define STORAGE_TS_15MIN_SECTORS 40
+#define STORAGE_TS_DAY_SECTORS 8
+#define STORAGE_TS_SECTORS (STORAGE_TS_RAW_SECTORS + STORAGE_TS_1MIN_SECTORS + \
+                            STORAGE_TS_15MIN_SECTORS + STORAGE_TS_DAY_SECTORS)
+#define STORAGE_TS_OFFSET   (STORAGE_LOG_OFFSET - STORAGE_TS_SECTORS * STORAGE_SECTOR_SIZE)
+#define STORAGE_RESERVED_OFFSET STORAGE_TS_OFFSET   // Lowest offset used by any store
+
+#define STORAGE_SAFE_TIMEOUT_MS 100                 // Max wait for the other core to park
+
+// Initialization - returns false if the firmware image overlaps the reserved region
+bool storage_flash_init(void);
+
+// Read access (memory mapped through XIP)
+const uint8_t* storage_flash_ptr(uint32_t offset);
+bool storage_flash_is_erased(uint32_t offset, size_t length);
+
+// Modification (offsets must be sector/page aligned and inside the reserved region)
+bool storage_flash_erase_sector(uint32_t offset);
+bool storage_flash_program_page(uint32_t offset, const uint8_t* data);
+
+// CRC-32 (IEEE 802.3), chainable: pass 0 to start, the previous result to continue
+uint32_t storage_crc32(uint32_t crc, const void* data, size_t length);
+
+#endif // STORAGE_FLASH_H
@@ -0,0 +1,609 @@
+/**
+ * PicoFlora Time-Series Store Implementation
+ */
+
+#include "timeseries.h"
+#include "storage_flash.h"
+#include "pico/stdlib.h"
+#include "hardware/timer.h"
+#include "../logging/logging.h"
+#include <stdio.h>
+#include <string.h>
+
+#define MAX_RECORD_SIZE 25      // Tag plus four values, five varint bytes each
+
+_Static_assert(TIMESERIES_PAGE_HEADER_SIZE + TIMESERIES_PAYLOAD_SIZE == STORAGE_PAGE_SIZE,
+               "time-series page layout must fill one program page");
+
+// Page header as stored in flash
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t first_time;        // Time of the first record, the base of its delta
+    uint32_t last_time;         // Latest time in the page
+    uint8_t tier;
+    uint8_t reserved;
+    uint16_t length;
+    uint32_t crc;
+} timeseries_page_header_t;
+
+_Static_assert(sizeof(timeseries_page_header_t) == TIMESERIES_PAGE_HEADER_SIZE,
+               "page header must be packed");
+
+// RAM index: one entry per sector
+typedef struct {
+    uint32_t first_seq;         // Sequence of the first valid page, 0 = no valid pages
+    uint32_t first_time;        // First time in that page
+    uint8_t valid_pages;
+} timeseries_sector_index_t;
+
+// One tier: a ring of sectors plus the page being filled
+typedef struct {
+    uint32_t offset;            // Flash offset of the ring
+    uint32_t sectors;
+    uint32_t unit;              // Seconds per time unit in the records
+    timeseries_sector_index_t* index;
+
+    uint32_t next_seq;
+    uint32_t write_sector;
+    uint32_t write_page;
+    bool write_ready;           // Pages from write_page onwards are erased
+    bool spare_ready;           // Sector after write_sector is erased
+
+    // Encoder state of the RAM page
+    uint8_t page[STORAGE_PAGE_SIZE];
+    uint32_t used;
+    uint32_t units;
+    int32_t prev[TIMESERIES_MAX_SERIES][3];
+} timeseries_ring_t;
+
+// Running rollup of one series in one tier
+typedef struct {
+    uint32_t bucket;            // Bucket start (seconds)
+    uint32_t count;
+    int32_t min;
+    int32_t max;
+    int64_t sum;
+} timeseries_bucket_t;
+
+static timeseries_sector_index_t sector_index[STORAGE_TS_SECTORS];
+
+// Store state
+static struct {
+    bool mounted;
+    timeseries_ring_t rings[TIMESERIES_TIER_COUNT];
+    timeseries_bucket_t buckets[TIMESERIES_MAX_SERIES][TIMESERIES_TIER_COUNT];  // [.][RAW] unused
+
+    uint32_t samples;
+    uint32_t records[TIMESERIES_TIER_COUNT];
+    uint32_t payload_bytes[TIMESERIES_TIER_COUNT];
+    uint32_t torn_pages;
+    uint32_t write_errors;
+    uint32_t max_program_us;
+    uint32_t max_erase_us;
+} ts;
+
+static const char* const tier_names[TIMESERIES_TIER_COUNT] = { "raw", "1min", "15min", "day" };
+
+uint32_t timeseries_tier_seconds(timeseries_tier_t tier) {
+    static const uint32_t seconds[TIMESERIES_TIER_COUNT] = { 0, 60, 15 * 60, 24 * 60 * 60 };
+    return tier < TIMESERIES_TIER_COUNT ? seconds[tier] : 0;
+}
+
+static inline uint32_t next_sector(const timeseries_ring_t* ring, uint32_t sector) {
+    return (sector + 1) % ring->sectors;
+}
+
+static inline uint32_t page_offset(const timeseries_ring_t* ring, uint32_t sector, uint32_t page) {
+    return ring->offset + sector * STORAGE_SECTOR_SIZE + page * STORAGE_PAGE_SIZE;
+}
+
+// Varints (LEB128) with zig-zag mapping for signed deltas
+
+static inline uint32_t zigzag(int32_t value) {
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static inline int32_t unzigzag(uint32_t value) {
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+static uint8_t* put_varint(uint8_t* out, uint32_t value) {
+    while (value >= 0x80) {
+        *out++ = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    *out++ = (uint8_t)value;
+    return out;
+}
+
+static const uint8_t* get_varint(const uint8_t* in, const uint8_t* end, uint32_t* value) {
+    uint32_t result = 0;
+    for (uint32_t shift = 0; shift < 35 && in < end; shift += 7) {
+        uint8_t byte = *in++;
+        result |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return in;
+        }
+    }
+    return NULL;    // Truncated or malformed
+}
+
+static uint32_t page_crc(const uint8_t* page) {
+    const timeseries_page_header_t* hdr = (const timeseries_page_header_t*)page;
+    uint32_t crc = storage_crc32(0, &hdr->seq, offsetof(timeseries_page_header_t, crc) - offsetof(timeseries_page_header_t, seq));
+    return storage_crc32(crc, page + TIMESERIES_PAGE_HEADER_SIZE, hdr->length);
+}
+
+static bool header_is_valid(const timeseries_page_header_t* hdr, uint32_t tier) {
+    return hdr->magic == TIMESERIES_PAGE_MAGIC && hdr->seq != 0 &&
+           hdr->tier == tier && hdr->length <= TIMESERIES_PAYLOAD_SIZE;
+}
+
+static void reset_page(timeseries_ring_t* ring) {
+    memset(ring->page, 0xFF, sizeof(ring->page));
+    ring->used = 0;
+    ring->units = 0;
+    memset(ring->prev, 0, sizeof(ring->prev));
+}
+
+static void erase_sector(timeseries_ring_t* ring, uint32_t sector) {
+    uint32_t start = time_us_32();
+    bool ok = storage_flash_erase_sector(ring->offset + sector * STORAGE_SECTOR_SIZE);
+    uint32_t elapsed = time_us_32() - start;
+
+    if (elapsed > ts.max_erase_us) {
+        ts.max_erase_us = elapsed;
+    }
+    if (ok) {
+        memset(&ring->index[sector], 0, sizeof(ring->index[sector]));
+    } else {
+        ts.write_errors++;
+    }
+
+    if (sector == ring->write_sector) {
+        ring->write_ready = ok;
+    } else if (sector == next_sector(ring, ring->write_sector)) {
+        ring->spare_ready = ok;
+    }
+}
+
+// Program the RAM page at the write position and start a new one
+static bool write_page(timeseries_ring_t* ring, uint32_t tier) {
+    if (ring->used == 0) {
+        return true;
+    }
+    if (!ring->write_ready) {
+        erase_sector(ring, ring->write_sector);     // Only if erase-ahead fell behind
+    }
+
+    timeseries_page_header_t* hdr = (timeseries_page_header_t*)ring->page;
+    hdr->magic = TIMESERIES_PAGE_MAGIC;
+    hdr->seq = ring->next_seq;
+    hdr->tier = (uint8_t)tier;
+    hdr->reserved = 0;
+    hdr->length = (uint16_t)ring->used;
+    hdr->crc = page_crc(ring->page);
+
+    uint32_t start = time_us_32();
+    bool ok = ring->write_ready &&
+              storage_flash_program_page(page_offset(ring, ring->write_sector, ring->write_page), ring->page);
+    uint32_t elapsed = time_us_32() - start;
+    if (elapsed > ts.max_program_us) {
+        ts.max_program_us = elapsed;
+    }
+
+    if (ok) {
+        timeseries_sector_index_t* entry = &ring->index[ring->write_sector];
+        if (entry->first_seq == 0) {
+            entry->first_seq = hdr->seq;
+            entry->first_time = hdr->first_time;
+        }
+        entry->valid_pages++;
+        ring->next_seq++;
+        if (++ring->write_page == STORAGE_PAGES_PER_SECTOR) {
+            ring->write_sector = next_sector(ring, ring->write_sector);
+            ring->write_page = 0;
+            ring->write_ready = ring->spare_ready;
+            ring->spare_ready = false;
+        }
+    } else {
+        ts.write_errors++;      // The page is dropped rather than blocking inserts
+    }
+
+    reset_page(ring);
+    return ok;
+}
+
+static uint32_t encode_record(timeseries_ring_t* ring, uint8_t* out, uint8_t series, uint32_t time,
+                              const int32_t* values, uint32_t count, bool rollup) {
+    uint32_t units = time / ring->unit;
+    uint8_t* p = put_varint(out, (zigzag((int32_t)(units - ring->units)) << 2) | series);
+    if (rollup) {
+        p = put_varint(p, count);
+        for (int i = 0; i < 3; i++) {
+            p = put_varint(p, zigzag(values[i] - ring->prev[series][i]));
+        }
+    } else {
+        p = put_varint(p, zigzag(values[0] - ring->prev[series][0]));
+    }
+    return (uint32_t)(p - out);
+}
+
+static bool append_record(uint32_t tier, uint8_t series, uint32_t time,
+                          const int32_t* values, uint32_t count) {
+    timeseries_ring_t* ring = &ts.rings[tier];
+    timeseries_page_header_t* hdr = (timeseries_page_header_t*)ring->page;
+    bool rollup = tier != TIMESERIES_TIER_RAW;
+    uint8_t record[MAX_RECORD_SIZE];
+
+    uint32_t length = encode_record(ring, record, series, time, values, count, rollup);
+    if (ring->used + length > TIMESERIES_PAYLOAD_SIZE) {
+        write_page(ring, tier);
+    }
+    if (ring->used == 0) {
+        // New page: deltas restart from its first record
+        hdr->first_time = time;
+        hdr->last_time = time;
+        ring->units = time / ring->unit;
+        length = encode_record(ring, record, series, time, values, count, rollup);
+    }
+
+    memcpy(ring->page + TIMESERIES_PAGE_HEADER_SIZE + ring->used, record, length);
+    ring->used += length;
+    ring->units = time / ring->unit;
+    memcpy(ring->prev[series], values, (rollup ? 3 : 1) * sizeof(int32_t));
+    if (time > hdr->last_time) {
+        hdr->last_time = time;
+    }
+
+    ts.records[tier]++;
+    ts.payload_bytes[tier] += length;
+    return true;
+}
+
+static void close_bucket(uint8_t series, uint32_t tier) {
+    timeseries_bucket_t* bucket = &ts.buckets[series][tier];
+    if (bucket->count == 0) {
+        return;
+    }
+    int64_t half = (int64_t)(bucket->count / 2);
+    int32_t avg = (int32_t)((bucket->sum + (bucket->sum >= 0 ? half : -half)) / (int64_t)bucket->count);
+    int32_t values[3] = { bucket->min, avg, bucket->max };
+    append_record(tier, series, bucket->bucket, values, bucket->count);
+    bucket->count = 0;
+}
+
+static void mount_ring(timeseries_ring_t* ring, uint32_t tier) {
+    uint32_t newest_seq = 0;
+    uint32_t newest_sector = 0;
+
+    for (uint32_t s = 0; s < ring->sectors; s++) {
+        timeseries_sector_index_t* entry = &ring->index[s];
+        for (uint32_t p = 0; p < STORAGE_PAGES_PER_SECTOR; p++) {
+            const uint8_t* page = storage_flash_ptr(page_offset(ring, s, p));
+            const timeseries_page_header_t* hdr = (const timeseries_page_header_t*)page;
+
+            if (header_is_valid(hdr, tier) && hdr->crc == page_crc(page)) {
+                if (entry->first_seq == 0) {
+                    entry->first_seq = hdr->seq;
+                    entry->first_time = hdr->first_time;
+                }
+                entry->valid_pages++;
+                if (hdr->seq > newest_seq) {
+                    newest_seq = hdr->seq;
+                    newest_sector = s;
+                }
+            } else if (!storage_flash_is_erased(page_offset(ring, s, p), STORAGE_PAGE_SIZE)) {
+                ts.torn_pages++;
+            }
+        }
+    }
+
+    // Resume after the last written page of the newest sector, as the flash log does
+    ring->write_sector = newest_sector;
+    ring->write_page = 0;
+    if (newest_seq != 0) {
+        for (uint32_t p = STORAGE_PAGES_PER_SECTOR; p > 0; p--) {
+            if (!storage_flash_is_erased(page_offset(ring, newest_sector, p - 1), STORAGE_PAGE_SIZE)) {
+                ring->write_page = p;
+                break;
+            }
+        }
+    }
+    bool tail_erased = ring->write_page < STORAGE_PAGES_PER_SECTOR &&
+                       storage_flash_is_erased(page_offset(ring, ring->write_sector, ring->write_page),
+                                               STORAGE_SECTOR_SIZE - ring->write_page * STORAGE_PAGE_SIZE);
+    if (ring->write_page > 0 && !tail_erased) {
+        ring->write_sector = next_sector(ring, ring->write_sector);
+        ring->write_page = 0;
+        tail_erased = storage_flash_is_erased(page_offset(ring, ring->write_sector, 0), STORAGE_SECTOR_SIZE);
+    }
+    ring->write_ready = tail_erased;
+    ring->spare_ready = storage_flash_is_erased(page_offset(ring, next_sector(ring, ring->write_sector), 0),
+                                                STORAGE_SECTOR_SIZE);
+    ring->next_seq = newest_seq + 1;
+    reset_page(ring);
+}
+
+bool timeseries_init(void) {
+    static const uint32_t sectors[TIMESERIES_TIER_COUNT] = {
+        STORAGE_TS_RAW_SECTORS, STORAGE_TS_1MIN_SECTORS, STORAGE_TS_15MIN_SECTORS, STORAGE_TS_DAY_SECTORS
+    };
+
+    memset(&ts, 0, sizeof(ts));
+    memset(sector_index, 0, sizeof(sector_index));
+
+    uint32_t offset = STORAGE_TS_OFFSET;
+    timeseries_sector_index_t* index = sector_index;
+    for (uint32_t tier = 0; tier < TIMESERIES_TIER_COUNT; tier++) {
+        timeseries_ring_t* ring = &ts.rings[tier];
+        ring->offset = offset;
+        ring->sectors = sectors[tier];
+        ring->unit = tier == TIMESERIES_TIER_RAW ? 1 : timeseries_tier_seconds((timeseries_tier_t)tier);
+        ring->index = index;
+        mount_ring(ring, tier);
+
+        offset += sectors[tier] * STORAGE_SECTOR_SIZE;
+        index += sectors[tier];
+    }
+    ts.mounted = true;
+
+    timeseries_stats_t stats;
+    timeseries_get_stats(&stats);
+    LOG_SYS_INFO("Time-series store mounted: raw %lu/%lu, 1min %lu/%lu, 15min %lu/%lu, day %lu/%lu pages, %lu torn",
+                 stats.pages_used[0], stats.pages_total[0], stats.pages_used[1], stats.pages_total[1],
+                 stats.pages_used[2], stats.pages_total[2], stats.pages_used[3], stats.pages_total[3],
+                 stats.torn_pages);
+    return true;
+}
+
+bool timeseries_insert(uint8_t series, uint32_t time, int32_t value) {
+    if (!ts.mounted || series >= TIMESERIES_MAX_SERIES) {
+        return false;
+    }
+
+    append_record(TIMESERIES_TIER_RAW, series, time, &value, 1);
+    ts.samples++;
+
+    // Fold into the rollups; a sample past the open bucket closes it first
+    for (uint32_t tier = TIMESERIES_TIER_1MIN; tier < TIMESERIES_TIER_COUNT; tier++) {
+        timeseries_bucket_t* bucket = &ts.buckets[series][tier];
+        uint32_t start = time - time % timeseries_tier_seconds((timeseries_tier_t)tier);
+        if (bucket->count > 0 && start != bucket->bucket) {
+            close_bucket(series, tier);
+        }
+        if (bucket->count == 0) {
+            bucket->bucket = start;
+            bucket->min = value;
+            bucket->max = value;
+            bucket->sum = 0;
+        }
+        bucket->count++;
+        bucket->sum += value;
+        if (value < bucket->min) {
+            bucket->min = value;
+        }
+        if (value > bucket->max) {
+            bucket->max = value;
+        }
+    }
+    return true;
+}
+
+void timeseries_process(uint32_t now) {
+    if (!ts.mounted) {
+        return;
+    }
+
+    // Close buckets whose period is over, so rollups do not wait for the next sample
+    for (uint8_t series = 0; series < TIMESERIES_MAX_SERIES; series++) {
+        for (uint32_t tier = TIMESERIES_TIER_1MIN; tier < TIMESERIES_TIER_COUNT; tier++) {
+            const timeseries_bucket_t* bucket = &ts.buckets[series][tier];
+            if (bucket->count > 0 && now - bucket->bucket >= timeseries_tier_seconds((timeseries_tier_t)tier)) {
+                close_bucket(series, tier);
+            }
+        }
+    }
+
+    // Erase ahead, one sector per call at most
+    for (uint32_t tier = 0; tier < TIMESERIES_TIER_COUNT; tier++) {
+        timeseries_ring_t* ring = &ts.rings[tier];
+        if (!ring->write_ready) {
+            erase_sector(ring, ring->write_sector);
+            return;
+        }
+        if (!ring->spare_ready) {
+            erase_sector(ring, next_sector(ring, ring->write_sector));
+            return;
+        }
+    }
+}
+
+void timeseries_flush(void) {
+    if (!ts.mounted) {
+        return;
+    }
+    for (uint32_t tier = 0; tier < TIMESERIES_TIER_COUNT; tier++) {
+        write_page(&ts.rings[tier], tier);
+    }
+}
+
+void timeseries_query(timeseries_iter_t* iter, timeseries_tier_t tier, uint8_t series, uint32_t from, uint32_t to) {
+    memset(iter, 0, sizeof(*iter));
+    iter->tier = (uint8_t)tier;
+    iter->series = series;
+    iter->from = from;
+    iter->to = to;
+    if (!ts.mounted || tier >= TIMESERIES_TIER_COUNT || series >= TIMESERIES_MAX_SERIES || from > to) {
+        iter->done = true;
+        return;
+    }
+
+    // Sectors in age order are sorted by time, so start at the last one that begins at or before 'from'
+    const timeseries_ring_t* ring = &ts.rings[tier];
+    uint32_t oldest = next_sector(ring, ring->write_sector);
+    bool found = false;
+    for (uint32_t i = 0; i < ring->sectors; i++) {
+        const timeseries_sector_index_t* entry = &ring->index[(oldest + i) % ring->sectors];
+        if (entry->first_seq == 0) {
+            continue;
+        }
+        if (!found || entry->first_time <= from) {
+            iter->logical_sector = i;
+            found = true;
+        } else {
+            break;
+        }
+    }
+    if (!found) {
+        iter->logical_sector = ring->sectors;
+    }
+}
+
+// Point the iterator at the next page that can hold points in range; false when there is none
+static bool next_page(timeseries_iter_t* iter) {
+    const timeseries_ring_t* ring = &ts.rings[iter->tier];
+    uint32_t oldest = next_sector(ring, ring->write_sector);
+
+    while (!iter->in_ram) {
+        uint32_t sector = (oldest + iter->logical_sector) % ring->sectors;
+        if (iter->logical_sector >= ring->sectors ||
+            (sector == ring->write_sector && iter->page >= ring->write_page)) {
+            break;
+        }
+
+        const uint8_t* page = storage_flash_ptr(page_offset(ring, sector, iter->page));
+        const timeseries_page_header_t* hdr = (const timeseries_page_header_t*)page;
+        if (++iter->page == STORAGE_PAGES_PER_SECTOR) {
+            iter->page = 0;
+            iter->logical_sector++;
+        }
+
+        // Headers alone decide about pages outside the range; only pages that are read get the CRC check
+        if (!header_is_valid(hdr, iter->tier) || hdr->last_time < iter->from) {
+            continue;
+        }
+        if (hdr->first_time > iter->to) {
+            return false;
+        }
+        if (hdr->crc != page_crc(page)) {
+            continue;
+        }
+        iter->pos = page + TIMESERIES_PAGE_HEADER_SIZE;
+        iter->end = iter->pos + hdr->length;
+        iter->units = hdr->first_time / ring->unit;
+        memset(iter->prev, 0, sizeof(iter->prev));
+        return true;
+    }
+
+    // Then the page still in RAM
+    if (iter->in_ram || ring->used == 0) {
+        return false;
+    }
+    iter->in_ram = true;
+    const timeseries_page_header_t* hdr = (const timeseries_page_header_t*)ring->page;
+    if (hdr->last_time < iter->from || hdr->first_time > iter->to) {
+        return false;
+    }
+    iter->pos = ring->page + TIMESERIES_PAGE_HEADER_SIZE;
+    iter->end = iter->pos + ring->used;
+    iter->units = hdr->first_time / ring->unit;
+    memset(iter->prev, 0, sizeof(iter->prev));
+    return true;
+}
+
+bool timeseries_next(timeseries_iter_t* iter, timeseries_point_t* point) {
+    if (iter->done) {
+        return false;
+    }
+    uint32_t unit = ts.rings[iter->tier].unit;
+    bool rollup = iter->tier != TIMESERIES_TIER_RAW;
+
+    while (true) {
+        if (iter->pos == NULL || iter->pos >= iter->end) {
+            if (!next_page(iter)) {
+                iter->done = true;
+                return false;
+            }
+        }
+
+        // Every record is decoded to keep the per-series deltas in step
+        uint32_t tag;
+        uint32_t count = 1;
+        uint32_t fields[3];
+        const uint8_t* p = get_varint(iter->pos, iter->end, &tag);
+        if (p && rollup) {
+            p = get_varint(p, iter->end, &count);
+        }
+        for (int i = 0; p && i < (rollup ? 3 : 1); i++) {
+            p = get_varint(p, iter->end, &fields[i]);
+        }
+        if (!p) {
+            iter->pos = iter->end;      // Malformed tail, skip the rest of the page
+            continue;
+        }
+        iter->pos = p;
+
+        uint8_t series = (uint8_t)(tag & 3);
+        iter->units += (uint32_t)unzigzag(tag >> 2);
+        int32_t* prev = iter->prev[series];
+        for (int i = 0; i < (rollup ? 3 : 1); i++) {
+            prev[i] += unzigzag(fields[i]);
+        }
+
+        uint32_t time = iter->units * unit;
+        if (series != iter->series || time < iter->from || time > iter->to) {
+            continue;
+        }
+        point->time = time;
+        point->count = count;
+        point->min = prev[0];
+        point->avg = rollup ? prev[1] : prev[0];
+        point->max = rollup ? prev[2] : prev[0];
+        return true;
+    }
+}
+
+void timeseries_get_stats(timeseries_stats_t* stats) {
+    memset(stats, 0, sizeof(*stats));
+    stats->samples = ts.samples;
+    for (uint32_t tier = 0; tier < TIMESERIES_TIER_COUNT; tier++) {
+        const timeseries_ring_t* ring = &ts.rings[tier];
+        stats->records[tier] = ts.records[tier];
+        stats->payload_bytes[tier] = ts.payload_bytes[tier];
+        stats->pages_total[tier] = ring->sectors * STORAGE_PAGES_PER_SECTOR;
+
+        uint32_t oldest = ring->sectors ? next_sector(ring, ring->write_sector) : 0;
+        for (uint32_t i = 0; i < ring->sectors; i++) {
+            const timeseries_sector_index_t* entry = &ring->index[(oldest + i) % ring->sectors];
+            stats->pages_used[tier] += entry->valid_pages;
+            if (stats->oldest[tier] == 0 && entry->first_seq != 0) {
+                stats->oldest[tier] = entry->first_time;
+            }
+        }
+        if (stats->oldest[tier] == 0 && ring->used > 0) {
+            stats->oldest[tier] = ((const timeseries_page_header_t*)ring->page)->first_time;
+        }
+    }
+    stats->torn_pages = ts.torn_pages;
+    stats->write_errors = ts.write_errors;
+    stats->max_program_us = ts.max_program_us;
+    stats->max_erase_us = ts.max_erase_us;
+}
+
+void timeseries_dump(void) {
+    timeseries_stats_t stats;
+    timeseries_get_stats(&stats);
+
+    printf("TS samples=%lu torn=%lu errors=%lu max_program_us=%lu max_erase_us=%lu\n",
+           stats.samples, stats.torn_pages, stats.write_errors, stats.max_program_us, stats.max_erase_us);
+    for (uint32_t tier = 0; tier < TIMESERIES_TIER_COUNT; tier++) {
+        uint32_t records = stats.records[tier];
+        uint32_t bytes_x100 = records ? (uint32_t)((uint64_t)stats.payload_bytes[tier] * 100 / records) : 0;
+        printf("TS tier=%s pages=%lu/%lu oldest=%lu records=%lu bytes_per_record=%lu.%02lu\n",
+               tier_names[tier], stats.pages_used[tier], stats.pages_total[tier], stats.oldest[tier],
+               records, bytes_x100 / 100, bytes_x100 % 100);
+    }
+}
@@ -0,0 +1,129 @@
+/**
+ * PicoFlora Time-Series Store
+ *
+ * Compact sensor history (soil moisture, battery, temperature, doses) in the
+ * reserved flash region, for history views on the device without keeping
+ * samples in RAM.
+ *
+ * Every sample goes to the raw tier and is folded into three rollup tiers
+ * (1 minute, 15 minutes, 1 day) on insert: each series keeps a running
+ * count/min/max/sum per tier, and when a bucket closes its min/avg/max is
+ * appended to that tier. Each tier is its own circular store of flash pages,
+ * so raw data wraps after a day or two while the daily tier reaches back
+ * for years.
+ *
+ * Records are delta encoded against the previous record of the same series
+ * in the page and written as zig-zag varints, so a slowly changing value
+ * costs about three bytes per sample. Records never span pages and the
+ * deltas restart on every page, so each page decodes on its own.
+ *
+ * Page layout (little-endian):
+ *   magic:u32 seq:u32 first_time:u32 last_time:u32 tier:u8 reserved:u8 length:u16 crc32:u32 payload[length]
+ * first_time/last_time bound the page's timestamps (seconds), for seeking.
+ * Payload records:
+ *   varint(zigzag(time delta in tier units) << 2 | series)
+ *   raw:     zigzag-varint(value delta)
+ *   rollups: varint(count) zigzag-varint(min delta) zigzag-varint(avg delta) zigzag-varint(max delta)
+ *
+ * A page is programmed (~1 ms) when it fills; the sector after the write
+ * position is erased ahead of time by timeseries_process(). Queries walk
+ * the pages in place through XIP with an iterator, then the RAM page.
+ * Buckets that are still open are lost on a reboot.
+ *
+ * Not safe from IRQ context - call from the main loop only. Do not insert
+ * or call timeseries_process() while an iterator is in use.
+ */
+
+#ifndef TIMESERIES_H
+#define TIMESERIES_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Configuration
+#define TIMESERIES_MAX_SERIES 4                 // Series ids 0-3 (two bits in the record tag)
+
+// Known series
+#define TIMESERIES_MOISTURE     0               // Soil-moisture probe, ADC counts
+#define TIMESERIES_BATTERY_MV   1               // Battery voltage, mV
+#define TIMESERIES_TEMPERATURE  2               // Die temperature, 0.01 C
+#define TIMESERIES_DOSE_UL      3               // One sample per dose, uL
+
+// Format constants
+#define TIMESERIES_PAGE_MAGIC 0x53544650u       // "PFTS"
+#define TIMESERIES_PAGE_HEADER_SIZE 24
+#define TIMESERIES_PAYLOAD_SIZE (256 - TIMESERIES_PAGE_HEADER_SIZE)
+
+// Resolution tiers, each a separate ring in flash
+typedef enum {
+    TIMESERIES_TIER_RAW = 0,
+    TIMESERIES_TIER_1MIN,
+    TIMESERIES_TIER_15MIN,
+    TIMESERIES_TIER_DAY,
+    TIMESERIES_TIER_COUNT
+} timeseries_tier_t;
+
+// One point: raw samples have min = avg = max and count 1
+typedef struct {
+    uint32_t time;              // Seconds; rollups are stamped with the bucket start
+    int32_t min;
+    int32_t avg;
+    int32_t max;
+    uint32_t count;             // Samples in the bucket
+} timeseries_point_t;
+
+// Range query cursor; decodes in place from flash, no page copies
+typedef struct {
+    uint8_t tier;
+    uint8_t series;
+    uint32_t from;
+    uint32_t to;
+
+    uint32_t logical_sector;    // Sector position counted from the oldest sector
+    uint32_t page;
+    bool in_ram;                // Reached the page still being filled
+    bool done;
+    const uint8_t* pos;         // Next record in the current page
+    const uint8_t* end;
+    uint32_t units;             // Time of the previous record, in tier units
+    int32_t prev[TIMESERIES_MAX_SERIES][3];
+} timeseries_iter_t;
+
+// Store statistics
+typedef struct {
+    uint32_t samples;           // Inserted since boot
+    uint32_t records[TIMESERIES_TIER_COUNT];        // Appended since boot, per tier
+    uint32_t payload_bytes[TIMESERIES_TIER_COUNT];  // Encoded size of those records
+    uint32_t pages_used[TIMESERIES_TIER_COUNT];
+    uint32_t pages_total[TIMESERIES_TIER_COUNT];
+    uint32_t oldest[TIMESERIES_TIER_COUNT];         // First time still held, 0 = empty
+    uint32_t torn_pages;
+    uint32_t write_errors;
+    uint32_t max_program_us;
+    uint32_t max_erase_us;
+} timeseries_stats_t;
+
+// Initialization - mounts the tier rings and rebuilds the RAM index
+bool timeseries_init(void);
+
+// Add a sample (time in seconds, non-decreasing per series) and update the rollups
+bool timeseries_insert(uint8_t series, uint32_t time, int32_t value);
+
+// Background work - close rollup buckets that ended by 'now', erase ahead
+void timeseries_process(uint32_t now);
+
+// Write the partly filled pages out (e.g. before a planned power-off)
+void timeseries_flush(void);
+
+// Range query over [from, to], oldest first
+void timeseries_query(timeseries_iter_t* iter, timeseries_tier_t tier, uint8_t series, uint32_t from, uint32_t to);
+bool timeseries_next(timeseries_iter_t* iter, timeseries_point_t* point);
+
+// Tier properties
+uint32_t timeseries_tier_seconds(timeseries_tier_t tier);  // Bucket length, 0 for raw
+
+// Statistics access
+void timeseries_get_stats(timeseries_stats_t* stats);
+void timeseries_dump(void);
+
+#endif // TIMESERIES_H
@@ -0,0 +1,278 @@
+/**
+ * TMC2209 Single-Wire UART Driver Implementation
+ */
+
+#include "tmc2209.h"
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+#include "../logging/logging.h"
+#include <stdio.h>
+
+#define SYNC_BYTE 0x05
+#define MASTER_ADDRESS 0xFF
+#define WRITE_BIT 0x80
+#define WRITE_LENGTH 8
+#define READ_REQUEST_LENGTH 4
+#define REPLY_LENGTH 8
+
+// Driver state
+static struct {
+    uart_inst_t *uart;
+    uint8_t address;
+    bool present;
+
+    // Shadows of the write-only registers we manage
+    uint32_t gconf;
+    uint32_t ihold_irun;
+    uint32_t chopconf;
+    uint32_t tpwmthrs;
+    uint32_t tcoolthrs;
+    uint8_t sgthrs;
+
+    uint32_t crc_errors;
+    uint32_t timeouts;
+} tmc;
+
+// CRC8 as specified by the datasheet (polynomial x^8 + x^2 + x + 1, LSB first)
+static uint8_t tmc2209_crc8(const uint8_t *data, size_t length) {
+    uint8_t crc = 0;
+    for (size_t i = 0; i < length; i++) {
+        uint8_t byte = data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            if ((crc >> 7) ^ (byte & 0x01)) {
+                crc = (uint8_t)((crc << 1) ^ 0x07);
+            } else {
+                crc = (uint8_t)(crc << 1);
+            }
+            byte >>= 1;
+        }
+    }
+    return crc;
+}
+
+// Drop anything left in the receiver (echo of our last write, line noise)
+static void flush_rx(void) {
+    while (uart_is_readable(tmc.uart)) {
+        (void)uart_getc(tmc.uart);
+    }
+}
+
+bool tmc2209_write_register(uint8_t reg, uint32_t value) {
+    if (!tmc.uart) {
+        return false;
+    }
+
+    uint8_t datagram[WRITE_LENGTH] = {
+        SYNC_BYTE, tmc.address, (uint8_t)(reg | WRITE_BIT),
+        (uint8_t)(value >> 24), (uint8_t)(value >> 16), (uint8_t)(value >> 8), (uint8_t)value, 0
+    };
+    datagram[WRITE_LENGTH - 1] = tmc2209_crc8(datagram, WRITE_LENGTH - 1);
+
+    flush_rx();
+    uart_write_blocking(tmc.uart, datagram, WRITE_LENGTH);
+    uart_tx_wait_blocking(tmc.uart);
+    return true;
+}
+
+bool tmc2209_read_register(uint8_t reg, uint32_t *value) {
+    if (!tmc.uart) {
+        return false;
+    }
+
+    uint8_t request[READ_REQUEST_LENGTH] = { SYNC_BYTE, tmc.address, reg, 0 };
+    request[READ_REQUEST_LENGTH - 1] = tmc2209_crc8(request, READ_REQUEST_LENGTH - 1);
+
+    flush_rx();
+    uart_write_blocking(tmc.uart, request, READ_REQUEST_LENGTH);
+
+    // Collect bytes until a reply frame (sync, master address) lines up; the echo
+    // of the request starts with the slave address instead and is shifted out
+    uint8_t reply[REPLY_LENGTH];
+    size_t received = 0;
+    uint64_t deadline = time_us_64() + TMC2209_REPLY_TIMEOUT_US;
+    while (received < REPLY_LENGTH) {
+        if (!uart_is_readable(tmc.uart)) {
+            if (time_us_64() > deadline) {
+                tmc.timeouts++;
+                return false;
+            }
+            continue;
+        }
+        reply[received++] = (uint8_t)uart_getc(tmc.uart);
+        if ((received == 1 && reply[0] != SYNC_BYTE) ||
+            (received == 2 && reply[1] != MASTER_ADDRESS)) {
+            // Resynchronise on the byte just received
+            if (received == 2 && reply[1] == SYNC_BYTE) {
+                reply[0] = SYNC_BYTE;
+                received = 1;
+            } else {
+                received = 0;
+            }
+        }
+    }
+
+    if (reply[2] != reg || tmc2209_crc8(reply, REPLY_LENGTH - 1) != reply[REPLY_LENGTH - 1]) {
+        tmc.crc_errors++;
+        return false;
+    }
+
+    *value = ((uint32_t)reply[3] << 24) | ((uint32_t)reply[4] << 16) | ((uint32_t)reply[5] << 8) | reply[6];
+    return true;
+}
+
+// Write and confirm through the interface counter (IFCNT counts accepted writes)
+static bool write_verified(uint8_t reg, uint32_t value) {
+    uint32_t before, after;
+    if (!tmc2209_read_register(TMC2209_REG_IFCNT, &before) ||
+        !tmc2209_write_register(reg, value) ||
+        !tmc2209_read_register(TMC2209_REG_IFCNT, &after)) {
+        return false;
+    }
+    return ((after - before) & 0xFF) == 1;
+}
+
+bool tmc2209_init(uart_inst_t *uart, uint tx_pin, uint rx_pin, uint8_t address) {
+    LOG_STEPPER_INFO("Initializing TMC2209 UART (address %u)", address);
+
+    tmc.uart = uart;
+    tmc.address = address;
+    tmc.present = false;
+
+    uart_init(uart, TMC2209_BAUD_RATE);
+    gpio_set_function(tx_pin, GPIO_FUNC_UART);
+    gpio_set_function(rx_pin, GPIO_FUNC_UART);
+    gpio_pull_up(rx_pin);
+
+    uint32_t ioin;
+    if (!tmc2209_read_register(TMC2209_REG_IOIN, &ioin)) {
+        LOG_STEPPER_WARN("TMC2209 not responding - STEP/EN control only");
+        return false;
+    }
+    if ((ioin >> 24) != TMC2209_VERSION) {
+        LOG_STEPPER_ERROR("Unexpected TMC2209 version 0x%02lx", ioin >> 24);
+        return false;
+    }
+
+    // Take over from the MS1/MS2 jumpers and the PDN function of the UART pin
+    tmc.gconf = TMC2209_GCONF_PDN_DISABLE | TMC2209_GCONF_MSTEP_REG_SELECT | TMC2209_GCONF_MULTISTEP_FILT;
+    if (!write_verified(TMC2209_REG_GCONF, tmc.gconf)) {
+        LOG_STEPPER_ERROR("TMC2209 rejected configuration write");
+        return false;
+    }
+    tmc.present = true;
+
+    tmc.chopconf = TMC2209_CHOPCONF_DEFAULT;
+    tmc.tpwmthrs = 0;
+    tmc2209_set_microsteps(TMC2209_DEFAULT_MICROSTEPS);
+    tmc2209_set_current(TMC2209_DEFAULT_IRUN, TMC2209_DEFAULT_IHOLD, TMC2209_DEFAULT_IHOLD_DELAY);
+    tmc2209_write_register(TMC2209_REG_TPWMTHRS, tmc.tpwmthrs);
+
+    LOG_STEPPER_INFO("TMC2209 ready: %u microsteps, StealthChop", tmc2209_get_microsteps());
+    return true;
+}
+
+bool tmc2209_is_present(void) {
+    return tmc.present;
+}
+
+bool tmc2209_set_microsteps(uint16_t microsteps) {
+    // MRES: 0 = 256 microsteps ... 8 = full steps
+    uint32_t mres = 0;
+    while (mres <= 8 && (256u >> mres) != microsteps) {
+        mres++;
+    }
+    if (mres > 8 || !tmc.present) {
+        return false;
+    }
+
+    tmc.chopconf = (tmc.chopconf & ~TMC2209_CHOPCONF_MRES_MASK) | (mres << TMC2209_CHOPCONF_MRES_SHIFT);
+    return tmc2209_write_register(TMC2209_REG_CHOPCONF, tmc.chopconf);
+}
+
+uint16_t tmc2209_get_microsteps(void) {
+    uint32_t mres = (tmc.chopconf & TMC2209_CHOPCONF_MRES_MASK) >> TMC2209_CHOPCONF_MRES_SHIFT;
+    return (uint16_t)(256u >> mres);
+}
+
+bool tmc2209_set_current(uint8_t irun, uint8_t ihold, uint8_t ihold_delay) {
+    if (irun > 31 || ihold > 31 || ihold_delay > 15 || !tmc.present) {
+        return false;
+    }
+    tmc.ihold_irun = (uint32_t)ihold | ((uint32_t)irun << 8) | ((uint32_t)ihold_delay << 16);
+    return tmc2209_write_register(TMC2209_REG_IHOLD_IRUN, tmc.ihold_irun);
+}
+
+bool tmc2209_set_stealthchop(bool enable) {
+    if (!tmc.present) {
+        return false;
+    }
+    if (enable) {
+        tmc.gconf &= ~TMC2209_GCONF_EN_SPREADCYCLE;
+    } else {
+        tmc.gconf |= TMC2209_GCONF_EN_SPREADCYCLE;
+    }
+    return tmc2209_write_register(TMC2209_REG_GCONF, tmc.gconf);
+}
+
+bool tmc2209_set_pwm_threshold(uint32_t tstep) {
+    if (tstep > 0xFFFFF || !tmc.present) {
+        return false;
+    }
+    tmc.tpwmthrs = tstep;
+    return tmc2209_write_register(TMC2209_REG_TPWMTHRS, tstep);
+}
+
+bool tmc2209_set_stallguard(uint8_t sgthrs, uint32_t tcoolthrs) {
+    if (tcoolthrs > 0xFFFFF || !tmc.present) {
+        return false;
+    }
+    tmc.sgthrs = sgthrs;
+    tmc.tcoolthrs = tcoolthrs;
+    return tmc2209_write_register(TMC2209_REG_SGTHRS, sgthrs) &&
+           tmc2209_write_register(TMC2209_REG_TCOOLTHRS, tcoolthrs);
+}
+
+bool tmc2209_get_sg_result(uint16_t *sg_result) {
+    uint32_t value;
+    if (!tmc.present || !tmc2209_read_register(TMC2209_REG_SG_RESULT, &value)) {
+        return false;
+    }
+    *sg_result = (uint16_t)(value & 0x3FF);
+    return true;
+}
+
+bool tmc2209_get_status(tmc2209_status_t *status) {
+    uint32_t drv_status, mscnt, sg_result, tstep;
+    if (!tmc.present ||
+        !tmc2209_read_register(TMC2209_REG_DRV_STATUS, &drv_status) ||
+        !tmc2209_read_register(TMC2209_REG_MSCNT, &mscnt) ||
+        !tmc2209_read_register(TMC2209_REG_SG_RESULT, &sg_result) ||
+        !tmc2209_read_register(TMC2209_REG_TSTEP, &tstep)) {
+        return false;
+    }
+
+    status->drv_status = drv_status;
+    status->mscnt = (uint16_t)(mscnt & 0x3FF);
+    status->sg_result = (uint16_t)(sg_result & 0x3FF);
+    status->tstep = tstep & 0xFFFFF;
+    status->cs_actual = (uint8_t)((drv_status >> 16) & 0x1F);
+    status->stealthchop = (drv_status >> 30) & 1;
+    return true;
+}
+
+void tmc2209_dump(void) {
+    tmc2209_status_t status;
+    if (!tmc2209_get_status(&status)) {
+        printf("TMC present=%d timeouts=%lu crc_errors=%lu\n", tmc.present, tmc.timeouts, tmc.crc_errors);
+        return;
+    }
+    printf("TMC present=1 microsteps=%u gconf=0x%08lx chopconf=0x%08lx ihold_irun=0x%08lx tpwmthrs=%lu tcoolthrs=%lu sgthrs=%u\n",
+           tmc2209_get_microsteps(), tmc.gconf, tmc.chopconf, tmc.ihold_irun, tmc.tpwmthrs, tmc.tcoolthrs, tmc.sgthrs);
+    printf("TMC drv_status=0x%08lx mscnt=%u sg_result=%u tstep=%lu cs_actual=%u mode=%s%s%s%s\n",
+           status.drv_status, status.mscnt, status.sg_result, status.tstep, status.cs_actual,
+           status.stealthchop ? "stealthchop" : "spreadcycle",
+           (status.drv_status & TMC2209_DRV_STATUS_STST) ? " standstill" : "",
+           (status.drv_status & (TMC2209_DRV_STATUS_OT | TMC2209_DRV_STATUS_OTPW)) ? " overtemp" : "",
+           (status.drv_status & (TMC2209_DRV_STATUS_OLA | TMC2209_DRV_STATUS_OLB)) ? " open-load" : "");
+    printf("TMC timeouts=%lu crc_errors=%lu\n", tmc.timeouts, tmc.crc_errors);
+}
@@ -0,0 +1,108 @@
+/**
+ * TMC2209 Single-Wire UART Driver
+ *
+ * Runtime configuration of the BigTreeTech TMC2209 over its PDN_UART pin:
+ * microstep resolution (MRES), run/hold current, StealthChop/SpreadCycle
+ * and the StealthChop velocity threshold, plus read-back of the microstep
+ * counter, StallGuard result and driver status.
+ *
+ * Uses a hardware UART with TX and RX joined through 1k to PDN_UART. Every
+ * datagram ends in the chip's CRC8; the own transmission echoed back on the
+ * single wire is skipped when reading. Most TMC2209 registers are
+ * write-only, so the last written values are kept in shadow copies.
+ *
+ * Blocking: a write takes ~0.7 ms and a read ~1.5 ms at 115200 baud. Call
+ * from the main loop only.
+ */
+
+#ifndef TMC2209_H
+#define TMC2209_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "hardware/uart.h"
+
+// Configuration
+#define TMC2209_BAUD_RATE 115200
+#define TMC2209_REPLY_TIMEOUT_US 5000
+#define TMC2209_VERSION 0x21                  // IOIN.VERSION of the TMC2209
+#define TMC2209_DEFAULT_MICROSTEPS 8          // Same as the MS1/MS2 jumper setting
+#define TMC2209_DEFAULT_IRUN 16               // Run current scale (x/32 of full scale)
+#define TMC2209_DEFAULT_IHOLD 8               // Hold current scale
+#define TMC2209_DEFAULT_IHOLD_DELAY 6         // Ramp from run to hold current (2^18 clocks per step)
+
+// Registers
+#define TMC2209_REG_GCONF       0x00
+#define TMC2209_REG_GSTAT       0x01
+#define TMC2209_REG_IFCNT       0x02          // Counts successful UART writes
+#define TMC2209_REG_IOIN        0x06
+#define TMC2209_REG_IHOLD_IRUN  0x10
+#define TMC2209_REG_TPOWERDOWN  0x11
+#define TMC2209_REG_TSTEP       0x12
+#define TMC2209_REG_TPWMTHRS    0x13
+#define TMC2209_REG_TCOOLTHRS   0x14
+#define TMC2209_REG_VACTUAL     0x22
+#define TMC2209_REG_SGTHRS      0x40
+#define TMC2209_REG_SG_RESULT   0x41
+#define TMC2209_REG_COOLCONF    0x42
+#define TMC2209_REG_MSCNT       0x6A
+#define TMC2209_REG_CHOPCONF    0x6C
+#define TMC2209_REG_DRV_STATUS  0x6F
+#define TMC2209_REG_PWMCONF     0x70
+
+// GCONF bits
+#define TMC2209_GCONF_I_SCALE_ANALOG   (1u << 0)
+#define TMC2209_GCONF_EN_SPREADCYCLE   (1u << 2)
+#define TMC2209_GCONF_PDN_DISABLE      (1u << 6)   // PDN_UART pin used for UART only
+#define TMC2209_GCONF_MSTEP_REG_SELECT (1u << 7)   // MRES from CHOPCONF instead of MS1/MS2
+#define TMC2209_GCONF_MULTISTEP_FILT   (1u << 8)
+
+// CHOPCONF fields
+#define TMC2209_CHOPCONF_MRES_SHIFT 24
+#define TMC2209_CHOPCONF_MRES_MASK  (0xFu << TMC2209_CHOPCONF_MRES_SHIFT)
+#define TMC2209_CHOPCONF_INTPOL     (1u << 28)     // Interpolate to 256 microsteps
+#define TMC2209_CHOPCONF_DEFAULT    0x10000053u    // TOFF=3, HSTRT=5, HEND=0, TBL=0, intpol
+
+// DRV_STATUS bits
+#define TMC2209_DRV_STATUS_OTPW     (1u << 0)      // Overtemperature pre-warning
+#define TMC2209_DRV_STATUS_OT       (1u << 1)      // Overtemperature shutdown
+#define TMC2209_DRV_STATUS_S2GA     (1u << 2)      // Short to ground, phase A
+#define TMC2209_DRV_STATUS_S2GB     (1u << 3)
+#define TMC2209_DRV_STATUS_OLA      (1u << 6)      // Open load, phase A
+#define TMC2209_DRV_STATUS_OLB      (1u << 7)
+#define TMC2209_DRV_STATUS_STST     (1u << 31)     // Standstill
+
+// Read-back snapshot
+typedef struct {
+    uint32_t drv_status;
+    uint16_t mscnt;             // Microstep counter, 0-1023
+    uint16_t sg_result;         // StallGuard load value (lower = more load)
+    uint32_t tstep;             // Measured time between steps (1/fCLK units)
+    uint8_t cs_actual;          // Actual current scale, 0-31
+    bool stealthchop;           // Driver currently in StealthChop
+} tmc2209_status_t;
+
+// Initialization - checks the chip version and puts it under UART control
+bool tmc2209_init(uart_inst_t *uart, uint tx_pin, uint rx_pin, uint8_t address);
+bool tmc2209_is_present(void);
+
+// Raw register access
+bool tmc2209_write_register(uint8_t reg, uint32_t value);
+bool tmc2209_read_register(uint8_t reg, uint32_t *value);
+
+// Configuration
+bool tmc2209_set_microsteps(uint16_t microsteps);           // 1-256, power of two
+uint16_t tmc2209_get_microsteps(void);
+bool tmc2209_set_current(uint8_t irun, uint8_t ihold, uint8_t ihold_delay);  // 0-31 current scale
+bool tmc2209_set_stealthchop(bool enable);                  // false = SpreadCycle
+bool tmc2209_set_pwm_threshold(uint32_t tstep);             // StealthChop below this speed, 0 = always
+bool tmc2209_set_stallguard(uint8_t sgthrs, uint32_t tcoolthrs);  // StallGuard active while TSTEP <= tcoolthrs
+
+// Read-back
+bool tmc2209_get_status(tmc2209_status_t *status);
+bool tmc2209_get_sg_result(uint16_t *sg_result);            // Single read, for polling while running
+
+// Diagnostics
+void tmc2209_dump(void);
+
+#endif // TMC2209_H
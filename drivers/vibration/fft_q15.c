@@ -0,0 +1,137 @@
+/**
+ * PicoFlora Q15 FFT Implementation
+ */
+
+#include "fft_q15.h"
+#include <math.h>
+
+#if defined(__ARM_FEATURE_SIMD32) && !defined(FFT_Q15_PORTABLE)
+#include <arm_acle.h>
+
+// (a + b) / 2 and (a - b) / 2 on both halves
+static inline uint32_t half_add(uint32_t a, uint32_t b) { return (uint32_t)__shadd16((int16x2_t)a, (int16x2_t)b); }
+static inline uint32_t half_sub(uint32_t a, uint32_t b) { return (uint32_t)__shsub16((int16x2_t)a, (int16x2_t)b); }
+// a + j*b and a - j*b, halved
+static inline uint32_t half_add_j(uint32_t a, uint32_t b) { return (uint32_t)__shasx((int16x2_t)a, (int16x2_t)b); }
+static inline uint32_t half_sub_j(uint32_t a, uint32_t b) { return (uint32_t)__shsax((int16x2_t)a, (int16x2_t)b); }
+// a.re * b.re + a.im * b.im, and a.re * b.im - a.im * b.re
+static inline int32_t dual_mul_add(uint32_t a, uint32_t b) { return __smuad((int16x2_t)a, (int16x2_t)b); }
+static inline int32_t dual_mul_sub_x(uint32_t a, uint32_t b) { return __smusdx((int16x2_t)a, (int16x2_t)b); }
+// Clamp to int16
+static inline int32_t saturate(int32_t v) { return __ssat(v, 16); }
+
+#else
+
+static inline int32_t lo(uint32_t z) { return FFT_Q15_RE(z); }
+static inline int32_t hi(uint32_t z) { return FFT_Q15_IM(z); }
+
+static inline uint32_t half_add(uint32_t a, uint32_t b) { return FFT_Q15_PACK((lo(a) + lo(b)) >> 1, (hi(a) + hi(b)) >> 1); }
+static inline uint32_t half_sub(uint32_t a, uint32_t b) { return FFT_Q15_PACK((lo(a) - lo(b)) >> 1, (hi(a) - hi(b)) >> 1); }
+static inline uint32_t half_add_j(uint32_t a, uint32_t b) { return FFT_Q15_PACK((lo(a) - hi(b)) >> 1, (hi(a) + lo(b)) >> 1); }
+static inline uint32_t half_sub_j(uint32_t a, uint32_t b) { return FFT_Q15_PACK((lo(a) + hi(b)) >> 1, (hi(a) - lo(b)) >> 1); }
+static inline int32_t dual_mul_add(uint32_t a, uint32_t b) { return lo(a) * lo(b) + hi(a) * hi(b); }
+static inline int32_t dual_mul_sub_x(uint32_t a, uint32_t b) { return lo(a) * hi(b) - hi(a) * lo(b); }
+static inline int32_t saturate(int32_t v) { return v > INT16_MAX ? INT16_MAX : v < INT16_MIN ? INT16_MIN : v; }
+
+#endif
+
+// W^k = cos(2 pi k / MAX) - j sin(2 pi k / MAX), stored as (cos, sin) for k < 3/4 MAX
+#define TWIDDLES (FFT_Q15_MAX_SIZE / 4 * 3)
+static uint32_t twiddle[TWIDDLES];
+
+void fft_q15_init(void) {
+    const float step = 6.28318530718f / FFT_Q15_MAX_SIZE;
+    for (uint32_t k = 0; k < TWIDDLES; k++) {
+        float c = cosf(step * k) * 32767.0f;
+        float s = sinf(step * k) * 32767.0f;
+        twiddle[k] = FFT_Q15_PACK((int16_t)lroundf(c), (int16_t)lroundf(s));
+    }
+}
+
+// y * conj(w) in Q15: (y.re*c + y.im*s) + j(y.im*c - y.re*s). A rotation keeps |y|, but one
+// part can grow to |y|, past full scale when both parts of y are near it (e.g. -1 - j at 45 degrees)
+static inline uint32_t twiddle_mul(uint32_t y, uint32_t w) {
+    return FFT_Q15_PACK(saturate(dual_mul_add(y, w) >> 15), saturate(dual_mul_sub_x(w, y) >> 15));
+}
+
+static uint32_t digit_reverse(uint32_t i, uint32_t digits) {
+    uint32_t r = 0;
+    for (uint32_t d = 0; d < digits; d++) {
+        r = (r << 2) | (i & 3);
+        i >>= 2;
+    }
+    return r;
+}
+
+bool fft_q15_forward(fft_q15_complex_t *data, uint32_t n) {
+    uint32_t digits = 0;
+    while ((4u << (2 * digits)) <= n) {
+        digits++;
+    }
+    if (n < 16 || n > FFT_Q15_MAX_SIZE || (1u << (2 * digits)) != n) {
+        return false;
+    }
+
+    // Each pass splits every length-L block into four interleaved length-L/4 DFTs
+    for (uint32_t length = n; length >= 4; length >>= 2) {
+        uint32_t quarter = length / 4;
+        uint32_t stride = FFT_Q15_MAX_SIZE / length;
+        for (uint32_t j = 0; j < quarter; j++) {
+            uint32_t w1 = twiddle[j * stride];
+            uint32_t w2 = twiddle[2 * j * stride];
+            uint32_t w3 = twiddle[3 * j * stride];
+            for (uint32_t g = j; g < n; g += length) {
+                uint32_t a = data[g];
+                uint32_t b = data[g + quarter];
+                uint32_t c = data[g + 2 * quarter];
+                uint32_t d = data[g + 3 * quarter];
+
+                uint32_t t0 = half_add(a, c);
+                uint32_t t1 = half_sub(a, c);
+                uint32_t t2 = half_add(b, d);
+                uint32_t t3 = half_sub(b, d);
+
+                data[g] = half_add(t0, t2);                 // a + b + c + d
+                uint32_t y1 = half_sub_j(t1, t3);           // a - jb - c + jd
+                uint32_t y2 = half_sub(t0, t2);             // a - b + c - d
+                uint32_t y3 = half_add_j(t1, t3);           // a + jb - c - jd
+                if (j == 0) {
+                    data[g + quarter] = y1;
+                    data[g + 2 * quarter] = y2;
+                    data[g + 3 * quarter] = y3;
+                } else {
+                    data[g + quarter] = twiddle_mul(y1, w1);
+                    data[g + 2 * quarter] = twiddle_mul(y2, w2);
+                    data[g + 3 * quarter] = twiddle_mul(y3, w3);
+                }
+            }
+        }
+    }
+
+    // Outputs come out in base-4 digit-reversed order
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t r = digit_reverse(i, digits);
+        if (i < r) {
+            uint32_t t = data[i];
+            data[i] = data[r];
+            data[r] = t;
+        }
+    }
+    return true;
+}
+
+int16_t fft_q15_hann(uint32_t i, uint32_t n) {
+    // 0.5 - 0.5 cos(2 pi i / n), symmetric about n / 2
+    if (i > n / 2) {
+        i = n - i;
+    }
+    int32_t c = FFT_Q15_RE(twiddle[i * (FFT_Q15_MAX_SIZE / n)]);
+    return (int16_t)((32767 - c) >> 1);
+}
+
+uint32_t fft_q15_power(fft_q15_complex_t z) {
+    // Unsigned: -32768 in both halves gives 2^31
+    int32_t re = FFT_Q15_RE(z);
+    int32_t im = FFT_Q15_IM(z);
+    return (uint32_t)(re * re) + (uint32_t)(im * im);
+}
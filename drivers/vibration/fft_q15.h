@@ -0,0 +1,47 @@
+/**
+ * PicoFlora Q15 FFT
+ *
+ * In-place radix-4 decimation-in-frequency FFT on packed Q15 complex
+ * values (real part in the low halfword, imaginary in the high one, the
+ * layout the Cortex-M33 dual 16-bit instructions work on). Every
+ * butterfly uses halving adds, so each stage scales by 1/4 and the result
+ * is the DFT divided by n. Inputs within unit magnitude never overflow;
+ * past it (both parts near full scale) the twiddle products saturate.
+ *
+ * On cores with the DSP extension (__ARM_FEATURE_SIMD32, the RP2350's
+ * M33) the butterflies and twiddle products use the SIMD intrinsics from
+ * arm_acle.h: halving add/subtract on both halves at once (SHADD16,
+ * SHSUB16, SHASX, SHSAX) and dual multiply-accumulate (SMUAD, SMUSDX).
+ * Elsewhere, or with FFT_Q15_PORTABLE defined, plain C computes the same
+ * values bit for bit, so the kernel can be tested on the host.
+ */
+
+#ifndef FFT_Q15_H
+#define FFT_Q15_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Configuration
+#define FFT_Q15_MAX_SIZE 1024               // Largest transform (a power of 4); sets the twiddle table
+
+// Packed complex Q15 value
+typedef uint32_t fft_q15_complex_t;
+
+#define FFT_Q15_PACK(re, im) ((uint32_t)(uint16_t)(re) | ((uint32_t)(uint16_t)(im) << 16))
+#define FFT_Q15_RE(z) ((int16_t)((z) & 0xFFFF))
+#define FFT_Q15_IM(z) ((int16_t)((z) >> 16))
+
+// Build the twiddle table (once, before the first transform)
+void fft_q15_init(void);
+
+// Forward transform of n points (16, 64, 256 or 1024), natural order in and out, scaled by 1/n
+bool fft_q15_forward(fft_q15_complex_t *data, uint32_t n);
+
+// Hann window coefficient i of n, Q15
+int16_t fft_q15_hann(uint32_t i, uint32_t n);
+
+// |z|^2 of a transform output
+uint32_t fft_q15_power(fft_q15_complex_t z);
+
+#endif // FFT_Q15_H
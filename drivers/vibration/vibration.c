@@ -0,0 +1,280 @@
+/**
+ * PicoFlora Pump Vibration Monitor Implementation
+ */
+
+#include "vibration.h"
+#include "fft_q15.h"
+#include "../imu/imu.h"
+#include "../stepper/stepper_driver.h"
+#include "../storage/settings_store.h"
+#include "pico/stdlib.h"
+#include "../logging/logging.h"
+#include <stdio.h>
+
+#define SPEED_MATCH_PCT 2                   // Cruise speed may wobble this much during a capture
+#define HEADROOM_BITS 14                    // Largest deviation scaled to 2^14 before the window
+
+typedef enum {
+    VIBRATION_IDLE,
+    VIBRATION_SETTLING,                     // Cruising, waiting for the ramp transient to pass
+    VIBRATION_CAPTURING,
+    VIBRATION_HOLD                          // Analysed, waiting for a new run or the interval
+} vibration_state_t;
+
+// Baseline as stored in the settings store
+typedef struct {
+    uint32_t step_hz;
+    int16_t level_db10[VIBRATION_BANDS];
+} vibration_baseline_t;
+
+// Capture buffer, transformed in place
+static fft_q15_complex_t window[VIBRATION_FFT_SIZE];
+
+// Monitor state
+static struct {
+    bool enabled;
+    vibration_state_t state;
+    uint32_t step_hz;
+    uint32_t since_ms;
+    uint32_t fill;
+
+    bool have_baseline;
+    bool learn;
+    vibration_baseline_t baseline;
+
+    bool have_result;
+    vibration_result_t result;
+
+    // Statistics
+    uint32_t captures;
+    uint32_t aborted;
+    uint32_t alarms;
+    uint32_t fft_us;
+    uint32_t analyse_us;
+    int8_t shift;
+} vib;
+
+static void on_imu_batch(const qmi8658_sample_t *samples, uint16_t count) {
+    if (vib.state != VIBRATION_CAPTURING) {
+        return;
+    }
+    for (uint16_t i = 0; i < count && vib.fill < VIBRATION_FFT_SIZE; i++) {
+        const int16_t *a = samples[i].acc;
+        window[vib.fill++] = imu_math_isqrt((uint32_t)((int32_t)a[0] * a[0]) + (uint32_t)((int32_t)a[1] * a[1]) +
+                                            (uint32_t)((int32_t)a[2] * a[2]));
+    }
+}
+
+// log2(v) with 8 fraction bits, by repeated squaring of the mantissa; v > 0
+static int32_t log2_q8(uint64_t v) {
+    int32_t msb = 63 - __builtin_clzll(v);
+    uint64_t m = msb >= 30 ? v >> (msb - 30) : v << (30 - msb);    // [1, 2) in Q30
+    int32_t result = msb << 8;
+    for (int32_t bit = 128; bit > 0; bit >>= 1) {
+        m = (m * m) >> 30;
+        if (m >= (2ull << 30)) {
+            m >>= 1;
+            result |= bit;
+        }
+    }
+    return result;
+}
+
+// Band energy in 0.1 dB, undoing the pre-scaling of the samples
+static int16_t level_db10(uint64_t energy, int32_t shift) {
+    if (energy == 0) {
+        return VIBRATION_LEVEL_NONE;
+    }
+    int32_t log2 = log2_q8(energy) - 2 * shift * 256;
+    return (int16_t)((int64_t)log2 * 30103 / 256000);     // 100 * log10(2) = 30.103
+}
+
+static void analyse(void) {
+    uint32_t start_us = time_us_32();
+    vibration_result_t *result = &vib.result;
+
+    // Remove gravity (the mean), scale into Q15 with headroom, apply the window
+    uint32_t sum = 0;
+    for (uint32_t i = 0; i < VIBRATION_FFT_SIZE; i++) {
+        sum += window[i];
+    }
+    int32_t mean = (int32_t)(sum / VIBRATION_FFT_SIZE);
+    uint32_t peak = 1;
+    for (uint32_t i = 0; i < VIBRATION_FFT_SIZE; i++) {
+        int32_t deviation = (int32_t)window[i] - mean;
+        uint32_t magnitude = (uint32_t)(deviation < 0 ? -deviation : deviation);
+        peak = magnitude > peak ? magnitude : peak;
+    }
+    int32_t shift = HEADROOM_BITS - (31 - __builtin_clz(peak));
+    for (uint32_t i = 0; i < VIBRATION_FFT_SIZE; i++) {
+        int32_t deviation = (int32_t)window[i] - mean;
+        deviation = shift >= 0 ? deviation << shift : deviation >> -shift;
+        window[i] = FFT_Q15_PACK((deviation * fft_q15_hann(i, VIBRATION_FFT_SIZE)) >> 15, 0);
+    }
+    vib.shift = (int8_t)shift;
+
+    uint32_t fft_start_us = time_us_32();
+    fft_q15_forward(window, VIBRATION_FFT_SIZE);
+    vib.fft_us = time_us_32() - fft_start_us;
+
+    // Harmonic bands around h * shaft frequency, the rest is broadband
+    uint64_t total = 0;
+    for (uint32_t k = 1; k < VIBRATION_FFT_SIZE / 2; k++) {
+        total += fft_q15_power(window[k]);
+    }
+    uint64_t rest = total;
+    uint64_t bins_per_hz_den = (uint64_t)STEPPER_STEPS_PER_REV * IMU_ODR_HZ;
+    for (uint32_t h = 1; h <= VIBRATION_HARMONICS; h++) {
+        uint32_t center = (uint32_t)((2ull * h * vib.step_hz * VIBRATION_FFT_SIZE / bins_per_hz_den + 1) / 2);
+        if (center <= VIBRATION_BAND_HALF_WIDTH || center + VIBRATION_BAND_HALF_WIDTH >= VIBRATION_FFT_SIZE / 2) {
+            result->level_db10[h - 1] = VIBRATION_LEVEL_NONE;
+            continue;
+        }
+        uint64_t energy = 0;
+        for (uint32_t k = center - VIBRATION_BAND_HALF_WIDTH; k <= center + VIBRATION_BAND_HALF_WIDTH; k++) {
+            energy += fft_q15_power(window[k]);
+        }
+        rest -= energy;
+        result->level_db10[h - 1] = level_db10(energy, shift);
+    }
+    result->level_db10[VIBRATION_HARMONICS] = level_db10(rest, shift);
+    result->step_hz = vib.step_hz;
+    result->shaft_mhz = (uint32_t)((uint64_t)vib.step_hz * 1000 / STEPPER_STEPS_PER_REV);
+
+    // Against the healthy pump at this speed
+    uint32_t base_hz = vib.baseline.step_hz;
+    uint32_t diff_hz = vib.step_hz > base_hz ? vib.step_hz - base_hz : base_hz - vib.step_hz;
+    result->compared = vib.have_baseline && diff_hz * 100 <= base_hz * VIBRATION_SPEED_TOLERANCE_PCT;
+    result->alarm = false;
+    int32_t worst = 0;
+    for (uint32_t b = 0; b < VIBRATION_BANDS; b++) {
+        result->delta_db10[b] = 0;
+        if (!result->compared || result->level_db10[b] == VIBRATION_LEVEL_NONE ||
+            vib.baseline.level_db10[b] == VIBRATION_LEVEL_NONE) {
+            continue;
+        }
+        result->delta_db10[b] = result->level_db10[b] - vib.baseline.level_db10[b];
+        if (result->delta_db10[b] > VIBRATION_ALARM_DB10) {
+            result->alarm = true;
+        }
+        if (result->delta_db10[b] > result->delta_db10[worst]) {
+            worst = b;
+        }
+    }
+
+    vib.captures++;
+    vib.have_result = true;
+    vib.analyse_us = time_us_32() - start_us;
+
+    if (result->alarm) {
+        vib.alarms++;
+        LOG_SYS_WARN("Pump vibration %s band %d dB over baseline at %lu Hz",
+                     worst < VIBRATION_HARMONICS ? "harmonic" : "broadband",
+                     result->delta_db10[worst] / 10, vib.step_hz);
+    } else {
+        LOG_SYS_DEBUG("Pump vibration analysed at %lu Hz in %lu us (FFT %lu us)",
+                      vib.step_hz, vib.analyse_us, vib.fft_us);
+    }
+
+    if (vib.learn) {
+        vib.learn = false;
+        vib.baseline.step_hz = vib.step_hz;
+        for (uint32_t b = 0; b < VIBRATION_BANDS; b++) {
+            vib.baseline.level_db10[b] = result->level_db10[b];
+        }
+        vib.have_baseline = settings_set(SETTINGS_KEY_VIBRATION_BASELINE, &vib.baseline, sizeof(vib.baseline));
+        LOG_SYS_INFO("Pump vibration baseline learned at %lu Hz", vib.step_hz);
+    }
+}
+
+void vibration_init(void) {
+    if (!imu_is_running()) {
+        LOG_SYS_INFO("Vibration monitor off (no IMU)");
+        return;
+    }
+    fft_q15_init();
+    vib.have_baseline = settings_get(SETTINGS_KEY_VIBRATION_BASELINE, &vib.baseline, sizeof(vib.baseline)) ==
+                        (int)sizeof(vib.baseline);
+    imu_set_batch_callback(on_imu_batch);
+    vib.enabled = true;
+    LOG_SYS_INFO("Vibration monitor ready, %s", vib.have_baseline ? "baseline loaded" : "no baseline yet");
+}
+
+void vibration_process(void) {
+    if (!vib.enabled) {
+        return;
+    }
+
+    uint32_t now_ms = to_ms_since_boot(get_absolute_time());
+    bool cruising = stepper_driver_get_state() == STEPPER_RUNNING;
+    uint32_t hz = stepper_driver_get_current_frequency();
+    uint32_t diff_hz = hz > vib.step_hz ? hz - vib.step_hz : vib.step_hz - hz;
+    bool same_speed = cruising && diff_hz * 100 <= vib.step_hz * SPEED_MATCH_PCT;
+
+    switch (vib.state) {
+        case VIBRATION_IDLE:
+            if (cruising) {
+                vib.step_hz = hz;
+                vib.since_ms = now_ms;
+                vib.state = VIBRATION_SETTLING;
+            }
+            break;
+        case VIBRATION_SETTLING:
+            if (!same_speed) {
+                vib.state = VIBRATION_IDLE;
+            } else if (now_ms - vib.since_ms >= VIBRATION_SETTLE_MS) {
+                vib.fill = 0;
+                vib.state = VIBRATION_CAPTURING;
+            }
+            break;
+        case VIBRATION_CAPTURING:
+            if (!same_speed) {
+                vib.aborted++;      // Run ended or the speed changed before the window was full
+                vib.state = VIBRATION_IDLE;
+            } else if (vib.fill >= VIBRATION_FFT_SIZE) {
+                analyse();
+                vib.since_ms = now_ms;
+                vib.state = VIBRATION_HOLD;
+            }
+            break;
+        case VIBRATION_HOLD:
+            if (!same_speed || now_ms - vib.since_ms >= VIBRATION_INTERVAL_MS) {
+                vib.state = VIBRATION_IDLE;
+            }
+            break;
+    }
+}
+
+void vibration_learn_baseline(void) {
+    vib.learn = true;
+    LOG_SYS_INFO("Pump vibration baseline: next capture at cruise is stored");
+}
+
+bool vibration_get_result(vibration_result_t *result) {
+    if (!vib.have_result) {
+        return false;
+    }
+    *result = vib.result;
+    return true;
+}
+
+void vibration_dump(void) {
+    static const char *const states[] = { "idle", "settling", "capturing", "hold" };
+    if (!vib.enabled) {
+        printf("VIB off\n");
+        return;
+    }
+    printf("VIB state=%s fill=%lu/%u captures=%lu aborted=%lu alarms=%lu learn=%d\n", states[vib.state],
+           vib.fill, VIBRATION_FFT_SIZE, vib.captures, vib.aborted, vib.alarms, vib.learn);
+    printf("VIB fft_us=%lu analyse_us=%lu shift=%d baseline_hz=%lu\n", vib.fft_us, vib.analyse_us, vib.shift,
+           vib.have_baseline ? vib.baseline.step_hz : 0);
+    if (!vib.have_result) {
+        return;
+    }
+    printf("VIB step_hz=%lu shaft_mhz=%lu compared=%d alarm=%d\n", vib.result.step_hz, vib.result.shaft_mhz,
+           vib.result.compared, vib.result.alarm);
+    for (uint32_t b = 0; b < VIBRATION_BANDS; b++) {
+        printf("VIB band=%lu level_db10=%d baseline_db10=%d delta_db10=%d\n", b + 1, vib.result.level_db10[b],
+               vib.have_baseline ? vib.baseline.level_db10[b] : VIBRATION_LEVEL_NONE, vib.result.delta_db10[b]);
+    }
+}
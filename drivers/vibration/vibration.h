@@ -0,0 +1,63 @@
+/**
+ * PicoFlora Pump Vibration Monitor
+ *
+ * Worn rollers, a loose mount or a pump running dry change the vibration
+ * the pump puts into the board long before the delivered volume drops.
+ * While the pump cruises at a steady speed the monitor records a window of
+ * accelerometer samples from the IMU service, takes the magnitude (so the
+ * board's orientation does not matter), removes the mean, applies a Hann
+ * window and runs a Q15 FFT (fft_q15.h).
+ *
+ * The spectrum is reduced to band levels at the pump shaft frequency and
+ * its harmonics (the roller pass frequency is the harmonic equal to the
+ * roller count), plus the broadband rest. The IMU samples at 224 Hz, far
+ * below the step rate, so the bands are derived from the step frequency as
+ * step_hz / STEPPER_STEPS_PER_REV rather than placed on it. Levels are in
+ * 0.1 dB, and each run is compared with a baseline learned from a healthy
+ * pump at the same speed; a band more than VIBRATION_ALARM_DB10 above its
+ * baseline raises the alarm.
+ */
+
+#ifndef VIBRATION_H
+#define VIBRATION_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Configuration
+#define VIBRATION_FFT_SIZE 1024             // Samples per capture: 4.6 s at 224 Hz, 0.22 Hz bins
+#define VIBRATION_HARMONICS 5               // Shaft frequency and harmonics 2-5
+#define VIBRATION_BANDS (VIBRATION_HARMONICS + 1)  // Last band: everything else
+#define VIBRATION_BAND_HALF_WIDTH 2         // Bins either side of a harmonic
+#define VIBRATION_SETTLE_MS 500             // At cruise this long before capturing
+#define VIBRATION_INTERVAL_MS 60000         // Next capture during the same long run
+#define VIBRATION_SPEED_TOLERANCE_PCT 5     // Baseline only applies at this speed
+#define VIBRATION_ALARM_DB10 60             // 6 dB over the baseline
+#define VIBRATION_LEVEL_NONE INT16_MIN      // Band outside the spectrum
+
+// One analysed capture
+typedef struct {
+    uint32_t step_hz;                       // Cruise step frequency during the capture
+    uint32_t shaft_mhz;                     // Shaft frequency in milli-Hz
+    int16_t level_db10[VIBRATION_BANDS];    // Band levels in 0.1 dB re 1 LSB^2
+    int16_t delta_db10[VIBRATION_BANDS];    // Against the baseline, 0 without one
+    bool compared;                          // Baseline found for this speed
+    bool alarm;
+} vibration_result_t;
+
+// Load the baseline and attach to the IMU service
+void vibration_init(void);
+
+// Start, check and analyse captures (call from the main loop)
+void vibration_process(void);
+
+// Store the next analysed capture as the healthy baseline
+void vibration_learn_baseline(void);
+
+// Latest analysed capture; false if none yet
+bool vibration_get_result(vibration_result_t *result);
+
+// Diagnostics
+void vibration_dump(void);
+
+#endif // VIBRATION_H
@@ -0,0 +1,222 @@
+/**
+ * PicoFlora Zone Valve Manager Implementation
+ */
+
+#include "zone_manager.h"
+#include "../mcp23017/mcp23017.h"
+#include "pico/stdlib.h"
+#include "../logging/logging.h"
+#include <stdio.h>
+#include <string.h>
+
+#define PORT_A_MASK 0x00FF
+#define PORT_B_MASK 0xFF00
+
+// Expander carrying valves
+typedef struct {
+    mcp23017_device_t device;
+    uint16_t valve_mask;        // Pins driven by the zone manager
+    uint16_t outputs;           // Shadow of the valve outputs
+} zone_expander_t;
+
+// Manager state
+static struct {
+    zone_expander_t expanders[ZONE_MANAGER_MAX_EXPANDERS];
+    uint32_t expander_count;
+
+    uint8_t zone_expander[ZONE_MANAGER_MAX_ZONES];  // ZONE_MANAGER_NONE = not mapped
+    uint8_t zone_pin[ZONE_MANAGER_MAX_ZONES];
+    uint32_t zone_count;
+    uint8_t open_zone;
+
+    zone_manager_stats_t stats;
+} zones;
+
+void zone_manager_init(void) {
+    memset(&zones, 0, sizeof(zones));
+    memset(zones.zone_expander, ZONE_MANAGER_NONE, sizeof(zones.zone_expander));
+    zones.open_zone = ZONE_MANAGER_NONE;
+}
+
+static zone_expander_t *find_expander(uint8_t i2c_addr) {
+    for (uint32_t i = 0; i < zones.expander_count; i++) {
+        if (zones.expanders[i].device.i2c_addr == i2c_addr) {
+            return &zones.expanders[i];
+        }
+    }
+    if (zones.expander_count == ZONE_MANAGER_MAX_EXPANDERS) {
+        return NULL;
+    }
+
+    // No mcp23017_init(): it resets every pin, and the expander may already drive
+    // other outputs. The valve pins are set up one by one below instead.
+    zone_expander_t *expander = &zones.expanders[zones.expander_count++];
+    expander->device.i2c_addr = i2c_addr;
+    expander->device.initialized = true;
+    expander->valve_mask = 0;
+    expander->outputs = 0;
+    return expander;
+}
+
+bool zone_manager_add_valves(uint8_t first_zone, uint8_t i2c_addr, uint8_t first_pin, uint8_t count) {
+    if (count == 0 || (uint32_t)first_zone + count > ZONE_MANAGER_MAX_ZONES ||
+        (uint32_t)first_pin + count > 16 || i2c_addr < 0x20 || i2c_addr > 0x27) {
+        LOG_HW_ERROR("Zone valves %u-%u on 0x%02X pin %u: out of range",
+                     first_zone, first_zone + count - 1, i2c_addr, first_pin);
+        return false;
+    }
+
+    uint16_t mask = (uint16_t)(((1u << count) - 1) << first_pin);
+    for (uint8_t i = 0; i < count; i++) {
+        if (zones.zone_expander[first_zone + i] != ZONE_MANAGER_NONE) {
+            LOG_HW_ERROR("Zone %u is already mapped", first_zone + i);
+            return false;
+        }
+    }
+    zone_expander_t *expander = find_expander(i2c_addr);
+    if (!expander || (expander->valve_mask & mask)) {
+        LOG_HW_ERROR("Cannot map zone valves to expander 0x%02X", i2c_addr);
+        return false;
+    }
+
+    // Closed before they become outputs, so no valve opens for a moment at boot
+    bool ok = true;
+    if (mask & PORT_A_MASK) {
+        ok = ok && mcp23017_update_port(&expander->device, MCP23017_PORT_A, (uint8_t)mask, 0);
+    }
+    if (mask & PORT_B_MASK) {
+        ok = ok && mcp23017_update_port(&expander->device, MCP23017_PORT_B, (uint8_t)(mask >> 8), 0);
+    }
+    for (uint8_t i = 0; ok && i < count; i++) {
+        ok = mcp23017_set_pin_direction(&expander->device, (mcp23017_pin_t)(first_pin + i), MCP23017_OUTPUT);
+    }
+    if (!ok) {
+        zones.stats.errors++;
+        LOG_HW_ERROR("Zone valves on expander 0x%02X not responding", i2c_addr);
+        return false;
+    }
+
+    expander->valve_mask |= mask;
+    for (uint8_t i = 0; i < count; i++) {
+        zones.zone_expander[first_zone + i] = (uint8_t)(expander - zones.expanders);
+        zones.zone_pin[first_zone + i] = first_pin + i;
+    }
+    if ((uint32_t)first_zone + count > zones.zone_count) {
+        zones.zone_count = first_zone + count;
+    }
+
+    LOG_HW_INFO("Zones %u-%u on expander 0x%02X pins %u-%u",
+                first_zone, first_zone + count - 1, i2c_addr, first_pin, first_pin + count - 1);
+    return true;
+}
+
+uint32_t zone_manager_get_zone_count(void) {
+    return zones.zone_count;
+}
+
+// Bring an expander's valves to 'outputs': one write for the ports that changed
+static bool write_expander(zone_expander_t *expander, uint16_t outputs) {
+    uint16_t changed = expander->outputs ^ outputs;
+    if (changed == 0) {
+        return true;
+    }
+
+    bool ok = true;
+    if ((changed & PORT_A_MASK) && (changed & PORT_B_MASK) && expander->valve_mask == 0xFFFF) {
+        // Both latches in one sequential write
+        ok = mcp23017_write_all(&expander->device, outputs);
+        zones.stats.transactions++;
+    } else {
+        for (int port = MCP23017_PORT_A; port <= MCP23017_PORT_B; port++) {
+            uint8_t port_mask = (uint8_t)(expander->valve_mask >> (8 * port));
+            uint8_t port_value = (uint8_t)(outputs >> (8 * port));
+            if (((changed >> (8 * port)) & 0xFF) == 0) {
+                continue;
+            }
+            if (port_mask == 0xFF) {
+                ok = mcp23017_write_port(&expander->device, (mcp23017_port_t)port, port_value) && ok;
+                zones.stats.transactions++;
+            } else {
+                // Shared with other outputs: only touch the valve bits
+                ok = mcp23017_update_port(&expander->device, (mcp23017_port_t)port, port_mask, port_value) && ok;
+                zones.stats.transactions += 2;
+            }
+        }
+    }
+
+    if (!ok) {
+        zones.stats.errors++;
+        return false;
+    }
+    expander->outputs = outputs;
+    return true;
+}
+
+bool zone_manager_open(uint8_t zone) {
+    if (zone >= zones.zone_count || zones.zone_expander[zone] == ZONE_MANAGER_NONE) {
+        LOG_HW_ERROR("Zone %u has no valve", zone);
+        return false;
+    }
+    if (zone == zones.open_zone) {
+        return true;
+    }
+    zones.stats.transitions++;
+
+    // Make before break: the new zone's expander first (closing its other valve in the same write)
+    zone_expander_t *target = &zones.expanders[zones.zone_expander[zone]];
+    bool ok = write_expander(target, (uint16_t)(1u << zones.zone_pin[zone]));
+    for (uint32_t i = 0; i < zones.expander_count; i++) {
+        if (&zones.expanders[i] != target) {
+            ok = write_expander(&zones.expanders[i], 0) && ok;
+        }
+    }
+
+    if (!ok) {
+        LOG_HW_ERROR("Zone %u valve switch failed", zone);
+    }
+    zones.open_zone = (target->outputs & (1u << zones.zone_pin[zone])) ? zone : ZONE_MANAGER_NONE;
+    return ok;
+}
+
+bool zone_manager_close_all(void) {
+    // Go by the outputs: a failed switch can leave a valve open without an open zone
+    bool any_open = false;
+    for (uint32_t i = 0; i < zones.expander_count; i++) {
+        any_open = any_open || zones.expanders[i].outputs != 0;
+    }
+    if (!any_open) {
+        return true;
+    }
+    zones.stats.transitions++;
+
+    bool ok = true;
+    for (uint32_t i = 0; i < zones.expander_count; i++) {
+        ok = write_expander(&zones.expanders[i], 0) && ok;
+    }
+    if (ok) {
+        zones.open_zone = ZONE_MANAGER_NONE;
+    } else {
+        LOG_HW_ERROR("Closing zone valves failed");
+    }
+    return ok;
+}
+
+uint8_t zone_manager_get_open(void) {
+    return zones.open_zone;
+}
+
+void zone_manager_get_stats(zone_manager_stats_t *stats) {
+    *stats = zones.stats;
+}
+
+void zone_manager_dump(void) {
+    printf("ZONE zones=%lu expanders=%lu open=%d transitions=%lu transactions=%lu errors=%lu\n",
+           zones.zone_count, zones.expander_count,
+           zones.open_zone == ZONE_MANAGER_NONE ? -1 : zones.open_zone,
+           zones.stats.transitions, zones.stats.transactions, zones.stats.errors);
+    for (uint32_t i = 0; i < zones.expander_count; i++) {
+        const zone_expander_t *expander = &zones.expanders[i];
+        printf("ZONE expander=0x%02X valves=0x%04X outputs=0x%04X\n",
+               expander->device.i2c_addr, expander->valve_mask, expander->outputs);
+    }
+}
@@ -0,0 +1,58 @@
+/**
+ * PicoFlora Zone Valve Manager
+ *
+ * Maps watering zones (one plant or bed each) to valve outputs on up to
+ * eight MCP23017 expanders, so one pump can serve 100+ zones. Each expander
+ * keeps a shadow of its valve outputs; switching zones computes the new
+ * outputs for every expander and writes only the ports that changed. A
+ * port with only valves on it is one write transaction, both ports of an
+ * expander go in one sequential write. A port shared with other outputs is
+ * a read-modify-write of the valve bits (mcp23017_update_port(): latch read,
+ * then write, two transactions), so those outputs are left alone. The
+ * built-in expander's valves are such a port: B0-B3, next to B4-B7 and the
+ * pump enable and status LED on port A.
+ *
+ * Only one zone is open at a time. Dosing switches zones from the step
+ * interrupt while the pump turns, so a switch is make before break: a zone
+ * on another expander opens before the old one closes, one on the same
+ * expander opens and closes in the same write. The valves are never all
+ * closed in between. A switch is at most five transactions, under 250 us
+ * at 400 kHz (built-in valve to manifold and back).
+ */
+
+#ifndef ZONE_MANAGER_H
+#define ZONE_MANAGER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Configuration
+#define ZONE_MANAGER_MAX_ZONES 128
+#define ZONE_MANAGER_MAX_EXPANDERS 8
+#define ZONE_MANAGER_NONE 0xFF                  // No zone open
+
+// Statistics
+typedef struct {
+    uint32_t transitions;       // Zone changes, including close-all
+    uint32_t transactions;      // Port writes; a shared port counts its latch read too
+    uint32_t errors;
+} zone_manager_stats_t;
+
+// Initialization
+void zone_manager_init(void);
+
+// Map 'count' zones from 'first_zone' to consecutive pins (0-15, B0 = 8) of an expander;
+// the valves are configured as outputs and closed. Valves are active high.
+bool zone_manager_add_valves(uint8_t first_zone, uint8_t i2c_addr, uint8_t first_pin, uint8_t count);
+uint32_t zone_manager_get_zone_count(void);     // Highest mapped zone + 1
+
+// Switching
+bool zone_manager_open(uint8_t zone);           // Open one zone, close all others
+bool zone_manager_close_all(void);
+uint8_t zone_manager_get_open(void);            // ZONE_MANAGER_NONE when all closed
+
+// Diagnostics
+void zone_manager_get_stats(zone_manager_stats_t *stats);
+void zone_manager_dump(void);
+
+#endif // ZONE_MANAGER_H
@@ -23,13 +23,13 @@ static void bubble_sort(uint16_t *data, uint16_t size)
 
 static uint16_t average_filter(uint16_t *samples)
 {
-    uint16_t out;
+    uint32_t sum = 0;
     bubble_sort(samples, BATTERY_ADC_SIZE);
     for (int i = 1; i < BATTERY_ADC_SIZE - 1; i++)
     {
-        out += samples[i] / (BATTERY_ADC_SIZE - 2);
+        sum += samples[i];
     }
-    return out;
+    return sum / (BATTERY_ADC_SIZE - 2);
 }
 
 uint16_t bsp_battery_read_raw(void)
@@ -135,6 +135,8 @@ void gpio_isr_handler(uint gpio, uint32_t events)
         // printf("Button pressed!\n");
         // bsp_cst328_read();
         g_cst328_data.read_data_done = true;
+        if (g_cst328_info != NULL && g_cst328_info->int_callback != NULL)
+            g_cst328_info->int_callback();
     }
 }
 
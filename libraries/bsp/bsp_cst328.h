@@ -73,7 +73,7 @@ typedef struct
     uint16_t rotation;
     uint16_t width;
     uint16_t height;
-
+    void (*int_callback)(void); // Optional hook called from the INT edge ISR
 } bsp_cst328_info_t;
 
 typedef struct
@@ -1,11 +1,40 @@
 #include "bsp_i2c.h"
 
 #include "hardware/i2c.h"
+#include "hardware/irq.h"
 
+static struct {
+    bool irq_shared;
+    uint irq_num;
+    uint32_t depth;
+} bus;
+
+void bsp_i2c_share_with_irq(uint irq_num)
+{
+    bus.irq_num = irq_num;
+    bus.irq_shared = true;
+}
+
+// Balanced within the interrupt too, so an interrupted count is written back unchanged
+void bsp_i2c_lock(void)
+{
+    if (bus.irq_shared && bus.depth++ == 0) {
+        irq_set_enabled(bus.irq_num, false);
+    }
+}
+
+void bsp_i2c_unlock(void)
+{
+    if (bus.irq_shared && --bus.depth == 0) {
+        irq_set_enabled(bus.irq_num, true);
+    }
+}
 
 void bsp_i2c_write(uint8_t device_addr, uint8_t *buffer, size_t len)
 {
+    bsp_i2c_lock();
     i2c_write_blocking(BSP_I2C_NUM, device_addr, buffer, len, false);
+    bsp_i2c_unlock();
 }
 
 
@@ -14,13 +43,17 @@ void bsp_i2c_write_reg8(uint8_t device_addr, uint8_t reg_addr, uint8_t *buffer,
     uint8_t write_buffer[len + 1];
     write_buffer[0] = reg_addr;
     memcpy(write_buffer + 1, buffer, len);
+    bsp_i2c_lock();
     i2c_write_blocking(BSP_I2C_NUM, device_addr, write_buffer, len + 1, false);
+    bsp_i2c_unlock();
 }
 
 void bsp_i2c_read_reg8(uint8_t device_addr, uint8_t reg_addr, uint8_t *buffer, size_t len)
 {
+    bsp_i2c_lock();
     i2c_write_blocking(BSP_I2C_NUM, device_addr, &reg_addr, 1, true);
     i2c_read_blocking(BSP_I2C_NUM, device_addr, buffer, len, false);
+    bsp_i2c_unlock();
 }
 
 void bsp_i2c_write_reg16(uint8_t device_addr, uint16_t reg_addr, uint8_t *buffer, size_t len)
@@ -29,7 +62,9 @@ void bsp_i2c_write_reg16(uint8_t device_addr, uint16_t reg_addr, uint8_t *buffer
     write_buffer[0] = (uint8_t)(reg_addr >> 8);
     write_buffer[1] = (uint8_t)(reg_addr);
     memcpy(write_buffer + 2, buffer, len);
+    bsp_i2c_lock();
     i2c_write_blocking(BSP_I2C_NUM, device_addr, write_buffer, len + 2, false);
+    bsp_i2c_unlock();
 }
 
 
@@ -38,8 +73,10 @@ void bsp_i2c_read_reg16(uint8_t device_addr, uint16_t reg_addr, uint8_t *buffer,
     uint8_t write_buffer[2];
     write_buffer[0] = (uint8_t)(reg_addr >> 8);
     write_buffer[1] = (uint8_t)(reg_addr);
+    bsp_i2c_lock();
     i2c_write_blocking(BSP_I2C_NUM, device_addr, write_buffer, 2, true);
     i2c_read_blocking(BSP_I2C_NUM, device_addr, buffer, len, false);
+    bsp_i2c_unlock();
 }
 
 void bsp_i2c_init(void)
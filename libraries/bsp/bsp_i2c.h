@@ -20,6 +20,12 @@ void bsp_i2c_read_reg16(uint8_t device_addr, uint16_t reg_addr, uint8_t *buffer,
 
 void bsp_i2c_init(void);
 
+// The bus is also used from interrupt 'irq_num' (e.g. valves switched on a step): while the main loop holds
+// the bus, that interrupt is masked, and it runs right after the transaction
+void bsp_i2c_share_with_irq(uint irq_num);
+void bsp_i2c_lock(void);    // Nests; every transfer here takes it, drivers wrap read-modify-writes in it
+void bsp_i2c_unlock(void);
+
 
 #endif
 
@@ -9,7 +9,8 @@
 // 全局变量
 static int i2sSoundSm;
 static uint i2sSoundOffset;
-static int dmaSoundTx;
+static int dmaSoundTx = -1;
+static bool i2sReady;
 
 void bsp_i2s_init(void)
 {
@@ -48,25 +49,49 @@ void bsp_i2s_init(void)
     pio_sm_set_pins(BSP_I2S_SOUND_PIO, i2sSoundSm, 0);
 
     // 设置状态机频率
+    i2sReady = true;
+    bsp_i2s_update_clock();
+    printf("I2S sound freq: %d, divider: %lu\n", BSP_I2S_FREQ, clock_get_hz(clk_sys) * 4 / BSP_I2S_FREQ);
+    pio_sm_set_enabled(BSP_I2S_SOUND_PIO, i2sSoundSm, true);
+}
+
+// The blocking output's DMA channel, claimed on first use so the audio engine does not waste one
+static void i2s_dma_claim(void)
+{
+    if (dmaSoundTx >= 0)
+        return;
+    dmaSoundTx = dma_claim_unused_channel(true);
+
+    dma_channel_config c = dma_channel_get_default_config(dmaSoundTx);
+    channel_config_set_dreq(&c, bsp_i2s_get_dreq());
+    dma_channel_configure(dmaSoundTx, &c, bsp_i2s_get_tx_fifo(), NULL, 0, false);
+}
+
+void bsp_i2s_update_clock(void)
+{
+    if (!i2sReady)
+        return;
+
     // 分频器 = 主机频率 * 256 / ( 2 * 声道数 * 声音位数 * 声音频率)
     // 分频器 = 主机频率 * 256 / (2 * 2 * 16 * 44100)
     // 分频器 = 主机频率 * 4 / 44100
     uint32_t freqDiv = clock_get_hz(clk_sys) * 4 / BSP_I2S_FREQ;
     pio_sm_set_clkdiv_int_frac(BSP_I2S_SOUND_PIO, i2sSoundSm, freqDiv >> 8, freqDiv & 0xFF);
+}
 
-    printf("I2S sound freq: %d, divider: %d\n", BSP_I2S_FREQ, freqDiv);
-    pio_sm_set_enabled(BSP_I2S_SOUND_PIO, i2sSoundSm, true);
-
-    // DMA
-    dmaSoundTx = dma_claim_unused_channel(true);
+volatile uint32_t *bsp_i2s_get_tx_fifo(void)
+{
+    return &BSP_I2S_SOUND_PIO->txf[i2sSoundSm];
+}
 
-    dma_channel_config c = dma_channel_get_default_config(dmaSoundTx);
-    channel_config_set_dreq(&c, pio_get_dreq(BSP_I2S_SOUND_PIO, i2sSoundSm, true));
-    dma_channel_configure(dmaSoundTx, &c, (uint32_t *)&(BSP_I2S_SOUND_PIO->txf[i2sSoundSm]), NULL, 0, false);
+uint bsp_i2s_get_dreq(void)
+{
+    return pio_get_dreq(BSP_I2S_SOUND_PIO, i2sSoundSm, true);
 }
 
 void bsp_i2s_output(const uint32_t *sound, size_t len, bool wait)
 {
+    i2s_dma_claim();
     if (wait)
     {
         dma_channel_wait_for_finish_blocking(dmaSoundTx);
@@ -78,6 +103,7 @@ void bsp_i2s_output(const uint32_t *sound, size_t len, bool wait)
 
 void i2sSoundOutputDmaBlocking(const uint32_t *sound, size_t len)
 {
+    i2s_dma_claim();
     dma_channel_wait_for_finish_blocking(dmaSoundTx);
     dma_channel_transfer_from_buffer_now(dmaSoundTx, (uint32_t *)sound, len);
 }
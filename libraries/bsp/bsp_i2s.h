@@ -23,6 +23,11 @@
 // void bsp_i2c_read_reg8(uint8_t device_addr, uint8_t reg_addr, uint8_t *buffer, size_t len);
 
 void bsp_i2s_init(void);
+// Recompute the PIO clock divider after a system clock change
+void bsp_i2s_update_clock(void);
+// TX FIFO and its DREQ, for DMA channels of the caller's own
+volatile uint32_t *bsp_i2s_get_tx_fifo(void);
+uint bsp_i2s_get_dreq(void);
 void bsp_i2s_output(const uint32_t *sound, size_t len, bool wait);
 void i2sSoundOutputDmaBlocking(const uint32_t *sound, size_t len);
 #endif
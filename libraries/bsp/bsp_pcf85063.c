@@ -63,6 +63,52 @@ void bsp_pcf85063_set_time(struct tm *now_tm)
     bsp_pcf85063_reg_write_byte(PCF85063_SECONDS, time_data, 7);
 }
 
+void bsp_pcf85063_set_alarm(const struct tm *alarm_tm)
+{
+    uint8_t alarm_data[5];
+    uint8_t control_2;
+
+    alarm_data[0] = dec2bcd(alarm_tm->tm_sec) & 0x7F;
+    alarm_data[1] = dec2bcd(alarm_tm->tm_min) & 0x7F;
+    alarm_data[2] = dec2bcd(alarm_tm->tm_hour) & 0x3F;
+    alarm_data[3] = dec2bcd(alarm_tm->tm_mday) & 0x3F;
+    alarm_data[4] = PCF85063_ALARM_DISABLE;  // Weekday not compared
+    bsp_pcf85063_reg_write_byte(PCF85063_SECOND_ALARM, alarm_data, 5);
+
+    bsp_pcf85063_reg_read(PCF85063_CONTROL_2, &control_2, 1);
+    control_2 |= PCF85063_CONTROL_2_AIE;
+    control_2 &= ~PCF85063_CONTROL_2_AF;
+    bsp_pcf85063_reg_write_byte(PCF85063_CONTROL_2, &control_2, 1);
+}
+
+void bsp_pcf85063_disable_alarm(void)
+{
+    uint8_t alarm_data[5];
+    uint8_t control_2;
+
+    memset(alarm_data, PCF85063_ALARM_DISABLE, sizeof(alarm_data));
+    bsp_pcf85063_reg_write_byte(PCF85063_SECOND_ALARM, alarm_data, 5);
+
+    bsp_pcf85063_reg_read(PCF85063_CONTROL_2, &control_2, 1);
+    control_2 &= ~(PCF85063_CONTROL_2_AIE | PCF85063_CONTROL_2_AF);
+    bsp_pcf85063_reg_write_byte(PCF85063_CONTROL_2, &control_2, 1);
+}
+
+bool bsp_pcf85063_alarm_fired(void)
+{
+    uint8_t control_2;
+    bsp_pcf85063_reg_read(PCF85063_CONTROL_2, &control_2, 1);
+    return (control_2 & PCF85063_CONTROL_2_AF) != 0;
+}
+
+void bsp_pcf85063_clear_alarm_flag(void)
+{
+    uint8_t control_2;
+    bsp_pcf85063_reg_read(PCF85063_CONTROL_2, &control_2, 1);
+    control_2 &= ~PCF85063_CONTROL_2_AF;
+    bsp_pcf85063_reg_write_byte(PCF85063_CONTROL_2, &control_2, 1);
+}
+
 // static void bsp_pcf85063_task(void *arg)
 // {
 //     struct tm now_tm;
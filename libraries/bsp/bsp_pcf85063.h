@@ -33,9 +33,19 @@ typedef enum
     PCF85063_TIMER_MODE,
 }pcf85063_reg_t;
 
+#define PCF85063_CONTROL_2_AIE 0x80     // Alarm interrupt enable (drives INT low)
+#define PCF85063_CONTROL_2_AF  0x40     // Alarm flag, cleared by writing 0
+#define PCF85063_ALARM_DISABLE 0x80     // AEN_x bit in each alarm register
+
 void bsp_pcf85063_init(void);
 void bsp_pcf85063_get_time(struct tm *now_tm);
 void bsp_pcf85063_set_time(struct tm *now_tm);
+
+// Alarm on day-of-month/hour/minute/second (month is not compared)
+void bsp_pcf85063_set_alarm(const struct tm *alarm_tm);
+void bsp_pcf85063_disable_alarm(void);
+bool bsp_pcf85063_alarm_fired(void);
+void bsp_pcf85063_clear_alarm_flag(void);
 // void bsp_pcf85063_test(void);
 
 #endif
\ No newline at end of file
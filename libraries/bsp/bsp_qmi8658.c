@@ -13,34 +13,101 @@ static void bsp_qmi8658_reg_write_byte(uint8_t reg_addr, uint8_t *data, size_t l
     bsp_i2c_write_reg8(QMI8658_DEVICE_ADDR, reg_addr, data, len);
 }
 
+// 小端字节转有符号16位
+static inline int16_t bsp_qmi8658_le16(const uint8_t *bytes)
+{
+    return (int16_t)((uint16_t)bytes[0] | ((uint16_t)bytes[1] << 8));
+}
+
 void bsp_qmi8658_read_data(qmi8658_data_t *data)
 {
     uint8_t status;
-    float mask;
-    uint16_t buf[6];
+    uint8_t buf[14];
     bsp_qmi8658_reg_read(QMI8658_STATUS0, &status, 1); // 读状态寄存器
     if (status & 0x03)
     {
-        bsp_qmi8658_reg_read(QMI8658_AX_L, (uint8_t *)buf, 12); // 读加速度和陀螺仪值
-        data->acc_x = buf[0];
-        data->acc_y = buf[1];
-        data->acc_z = buf[2];
-        data->gyr_x = buf[3];
-        data->gyr_y = buf[4];
-        data->gyr_z = buf[5];
-
-        mask = (float)data->acc_x / sqrt(((float)data->acc_y * (float)data->acc_y + (float)data->acc_z * (float)data->acc_z));
-        data->AngleX = atan(mask) * 57.29578f; // 180/π=57.29578
-        mask = (float)data->acc_y / sqrt(((float)data->acc_x * (float)data->acc_x + (float)data->acc_z * (float)data->acc_z));
-        data->AngleY = atan(mask) * 57.29578f; // 180/π=57.29578
-        mask = sqrt(((float)data->acc_x * (float)data->acc_x + (float)data->acc_y * (float)data->acc_y)) / (float)data->acc_z;
-        data->AngleZ = atan(mask) * 57.29578f; // 180/π=57.29578
+        bsp_qmi8658_reg_read(QMI8658_TEMP_L, buf, 14); // 读温度、加速度和陀螺仪值
+        data->temp = bsp_qmi8658_le16(&buf[0]) / 256.0f;
+        data->acc_x = bsp_qmi8658_le16(&buf[2]);
+        data->acc_y = bsp_qmi8658_le16(&buf[4]);
+        data->acc_z = bsp_qmi8658_le16(&buf[6]);
+        data->gyr_x = bsp_qmi8658_le16(&buf[8]);
+        data->gyr_y = bsp_qmi8658_le16(&buf[10]);
+        data->gyr_z = bsp_qmi8658_le16(&buf[12]);
     }
     else
         printf("QMI8658 read data fail!");
 }
 
-void bsp_qmi8658_init(void)
+// CTRL9 命令握手: 写命令, 等 CmdDone, 写 ACK, 等 CmdDone 清零
+static bool bsp_qmi8658_ctrl9_command(uint8_t cmd)
+{
+    uint8_t status = 0;
+    bsp_qmi8658_reg_write_byte(QMI8658_CTRL9, &cmd, 1);
+    for (int i = 0; i < 100 && !(status & QMI8658_STATUSINT_CMD_DONE); i++)
+    {
+        sleep_us(50);
+        bsp_qmi8658_reg_read(QMI8658_STATUSINT, &status, 1);
+    }
+    if (!(status & QMI8658_STATUSINT_CMD_DONE))
+        return false;
+
+    bsp_qmi8658_reg_write_byte(QMI8658_CTRL9, (uint8_t[]){QMI8658_CTRL_CMD_ACK}, 1);
+    for (int i = 0; i < 100 && (status & QMI8658_STATUSINT_CMD_DONE); i++)
+    {
+        sleep_us(50);
+        bsp_qmi8658_reg_read(QMI8658_STATUSINT, &status, 1);
+    }
+    return true;
+}
+
+static uint8_t fifo_ctrl; // 读完FIFO后写回 (清 RD_MODE)
+
+void bsp_qmi8658_fifo_init(uint8_t size, uint8_t watermark, bool int1)
+{
+    uint8_t ctrl1 = QMI8658_CTRL1_ADDR_AI | (int1 ? (QMI8658_CTRL1_INT1_EN | QMI8658_CTRL1_FIFO_INT_SEL) : QMI8658_CTRL1_INT2_EN);
+    fifo_ctrl = size | QMI8658_FIFO_MODE_STREAM;
+    bsp_qmi8658_reg_write_byte(QMI8658_CTRL1, &ctrl1, 1);
+    bsp_qmi8658_reg_write_byte(QMI8658_FIFO_WTM_TH, &watermark, 1);
+    bsp_qmi8658_reg_write_byte(QMI8658_FIFO_CTRL, &fifo_ctrl, 1);
+    bsp_qmi8658_ctrl9_command(QMI8658_CTRL_CMD_RST_FIFO);
+}
+
+uint8_t bsp_qmi8658_fifo_status(void)
+{
+    uint8_t status;
+    bsp_qmi8658_reg_read(QMI8658_FIFO_STATUS, &status, 1);
+    return status;
+}
+
+uint16_t bsp_qmi8658_fifo_read(qmi8658_sample_t *samples, uint16_t max_samples)
+{
+    uint8_t count[2];
+    if (!bsp_qmi8658_ctrl9_command(QMI8658_CTRL_CMD_REQ_FIFO))
+        return 0;
+
+    // FIFO_SMPL_CNT 和 FIFO_STATUS 连续读, 字节数 = 2 * 计数
+    bsp_qmi8658_reg_read(QMI8658_FIFO_SMPL_CNT, count, 2);
+    uint32_t bytes = 2u * (((uint32_t)(count[1] & 0x03) << 8) | count[0]);
+    uint16_t n = bytes / sizeof(qmi8658_sample_t);
+    if (n > max_samples)
+        n = max_samples;
+
+    // 一次 I2C 读完, 然后原地转换字节序
+    if (n > 0)
+    {
+        uint8_t *raw = (uint8_t *)samples;
+        bsp_qmi8658_reg_read(QMI8658_FIFO_DATA, raw, n * sizeof(qmi8658_sample_t));
+        int16_t *values = (int16_t *)samples;
+        for (uint32_t i = 0; i < n * 6u; i++)
+            values[i] = bsp_qmi8658_le16(&raw[2 * i]);
+    }
+
+    bsp_qmi8658_reg_write_byte(QMI8658_FIFO_CTRL, &fifo_ctrl, 1); // 退出FIFO读模式
+    return n;
+}
+
+bool bsp_qmi8658_init(void)
 {
     uint8_t id = 0;
 
@@ -48,16 +115,17 @@ void bsp_qmi8658_init(void)
     if (0x05 != id)
     {
         printf("QMI8658 not found!\r\n");
-        return;
+        return false;
     }
     printf("Find QMI8658!\r\n");
     bsp_qmi8658_reg_write_byte(QMI8658_RESET, (uint8_t[]){0xb0}, 1); // 复位
     sleep_ms(10);                                                    // 延时10ms
     bsp_qmi8658_reg_write_byte(QMI8658_CTRL1, (uint8_t[]){0x40}, 1); // CTRL1 设置地址自动增加
     bsp_qmi8658_reg_write_byte(QMI8658_CTRL7, (uint8_t[]){0x03}, 1); // CTRL7 允许加速度和陀螺仪
-    bsp_qmi8658_reg_write_byte(QMI8658_CTRL2, (uint8_t[]){0x95}, 1); // CTRL2 设置ACC 4g 250Hz
-    bsp_qmi8658_reg_write_byte(QMI8658_CTRL3, (uint8_t[]){0xd5}, 1); // CTRL3 设置GRY 512dps 250Hz
+    bsp_qmi8658_reg_write_byte(QMI8658_CTRL2, (uint8_t[]){0x15}, 1); // CTRL2 设置ACC 4g 224Hz (自检关闭)
+    bsp_qmi8658_reg_write_byte(QMI8658_CTRL3, (uint8_t[]){0x55}, 1); // CTRL3 设置GRY 512dps 224Hz (自检关闭)
     sleep_ms(100); 
+    return true;
 }
 
 // static void bsp_qmi8658_task(void *arg)
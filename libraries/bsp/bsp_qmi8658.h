@@ -4,12 +4,41 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <math.h>
 #include "pico/stdlib.h"
 
 
 #define QMI8658_DEVICE_ADDR 0x6B
 
+// CTRL1 bits
+#define QMI8658_CTRL1_ADDR_AI       0x40    // Register address auto increment
+#define QMI8658_CTRL1_INT2_EN       0x10
+#define QMI8658_CTRL1_INT1_EN       0x08
+#define QMI8658_CTRL1_FIFO_INT_SEL  0x04    // FIFO interrupt on INT1 (0 = INT2)
+
+// FIFO_CTRL bits
+#define QMI8658_FIFO_CTRL_RD_MODE   0x80    // Set by CTRL_CMD_REQ_FIFO, cleared by the host after reading
+#define QMI8658_FIFO_SIZE_16        0x00
+#define QMI8658_FIFO_SIZE_32        0x04
+#define QMI8658_FIFO_SIZE_64        0x08
+#define QMI8658_FIFO_SIZE_128       0x0C
+#define QMI8658_FIFO_MODE_BYPASS    0x00
+#define QMI8658_FIFO_MODE_FIFO      0x01    // Stops when full
+#define QMI8658_FIFO_MODE_STREAM    0x02    // Oldest samples dropped when full
+
+// FIFO_STATUS bits (bits 1:0 are the top of the sample count)
+#define QMI8658_FIFO_STATUS_FULL    0x80
+#define QMI8658_FIFO_STATUS_WTM     0x40
+#define QMI8658_FIFO_STATUS_OVFLOW  0x20
+#define QMI8658_FIFO_STATUS_NOT_EMPTY 0x10
+
+// STATUSINT bits
+#define QMI8658_STATUSINT_CMD_DONE  0x80
+
+// CTRL9 commands
+#define QMI8658_CTRL_CMD_ACK        0x00
+#define QMI8658_CTRL_CMD_RST_FIFO   0x04
+#define QMI8658_CTRL_CMD_REQ_FIFO   0x05
+
 typedef enum
 {
     QMI8658_WHO_AM_I,
@@ -78,7 +107,7 @@ typedef enum
     QMI8658_RESET = 96
 } qmi8658_reg_t;
 
-// 倾角结构体
+// 传感器数据 (orientation is computed in fixed point by drivers/imu)
 typedef struct{
     int16_t acc_x;
 	int16_t acc_y;
@@ -86,13 +115,23 @@ typedef struct{
 	int16_t gyr_x;
 	int16_t gyr_y;
 	int16_t gyr_z;
-	float AngleX;
-	float AngleY;
-	float AngleZ;
     float temp;
 }qmi8658_data_t;
 
+// One FIFO entry with accelerometer and gyroscope enabled, in register order
+typedef struct{
+    int16_t acc[3];
+    int16_t gyr[3];
+}qmi8658_sample_t;
+
 
-void bsp_qmi8658_init(void);
+bool bsp_qmi8658_init(void);
 void bsp_qmi8658_read_data(qmi8658_data_t *data);
+
+// FIFO in stream mode, 'size' one of QMI8658_FIFO_SIZE_*, watermark in samples.
+// The watermark interrupt goes to INT1 (or INT2 if int1 is false).
+void bsp_qmi8658_fifo_init(uint8_t size, uint8_t watermark, bool int1);
+uint8_t bsp_qmi8658_fifo_status(void);
+// Drain the FIFO in one burst read: returns the samples stored (at most max_samples)
+uint16_t bsp_qmi8658_fifo_read(qmi8658_sample_t *samples, uint16_t max_samples);
 #endif
\ No newline at end of file
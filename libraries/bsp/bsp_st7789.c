@@ -78,7 +78,9 @@ void bsp_st7789_spi_dma_init(void)
                           g_st7789_info->width * g_st7789_info->height * 2, // element count (each element is of size transfer_data_size)
                           false);                                           // don't start yet
 
-    bsp_dma_channel_irq_add(1, g_st7789_info->dma_tx_channel, __dma_flush_done_callback);
+    // Without a callback the caller waits for the transfer itself (bsp_st7789_wait_dma)
+    if (g_st7789_info->dma_flush_done_callback != NULL)
+        bsp_dma_channel_irq_add(1, g_st7789_info->dma_tx_channel, __dma_flush_done_callback);
 }
 
 void bsp_st7789_gpio_init(void)
@@ -298,6 +300,14 @@ void bsp_st7789_flush_dma(uint16_t x_start, uint16_t y_start, uint16_t x_end, ui
     dma_channel_set_read_addr(g_st7789_info->dma_tx_channel, color, true);
 }
 
+void bsp_st7789_wait_dma(void)
+{
+    dma_channel_wait_for_finish_blocking(g_st7789_info->dma_tx_channel);
+    while (spi_is_busy(BSP_ST7789_SPI_NUM))
+        tight_loop_contents();
+    gpio_put(BSP_ST7789_CS_PIN, 1);
+}
+
 bsp_st7789_info_t *bsp_st7789_get_info(void)
 {
     return g_st7789_info;
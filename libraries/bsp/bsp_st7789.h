@@ -43,6 +43,8 @@ typedef struct
 
 bsp_st7789_info_t *bsp_st7789_get_info(void);
 void bsp_st7789_flush_dma(uint16_t x_start, uint16_t y_start, uint16_t x_end, uint16_t y_end, uint16_t *color);
+// Wait for a flush_dma transfer to leave the SPI and release CS (when no done callback is set)
+void bsp_st7789_wait_dma(void);
 void bsp_st7789_init(bsp_st7789_info_t *st7789_info);
 void bsp_st7789_set_window(uint16_t Xstart, uint16_t Ystart, uint16_t Xend, uint16_t Yend);
 void bsp_st7789_flush(uint16_t x_start, uint16_t y_start, uint16_t x_end, uint16_t y_end, uint16_t *color);
@@ -121,6 +121,16 @@
     * radius * 4 bytes are used per circle (the most often used radiuses are saved)
     * 0: to disable caching */
     #define LV_CIRCLE_CACHE_SIZE 4
+
+    /* Set number of maximally cached rounded corners (radius and border/outline width).
+    * One anti-aliased quadrant is saved per entry and mirrored to the 4 corners,
+    * so rounded rectangles are blended in spans without evaluating radius masks.
+    * 2 * size^2 bytes are used per corner where size is `max(radius, width)`
+    * 0: to disable caching */
+    #define LV_CORNER_CACHE_SIZE 8
+
+    /*Larger corners are drawn with radius masks*/
+    #define LV_CORNER_CACHE_MAX_SIZE 32
 #endif /*LV_DRAW_COMPLEX*/
 
 /**
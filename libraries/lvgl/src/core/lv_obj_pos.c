@@ -836,6 +836,7 @@ void lv_obj_invalidate_area(const lv_obj_t * obj, const lv_area_t * area)
     LV_ASSERT_OBJ(obj, MY_CLASS);
 
     lv_disp_t * disp   = lv_obj_get_disp(obj);
+    if(disp && disp->driver->invalidate_cb) disp->driver->invalidate_cb(disp->driver, obj, area);
     if(!lv_disp_is_invalidation_enabled(disp)) return;
 
     lv_area_t area_tmp;
@@ -20,9 +20,27 @@
 #define SHADOW_ENHANCE          1
 #define SPLIT_LIMIT             50
 
+#if LV_DRAW_COMPLEX && defined(LV_CORNER_CACHE_SIZE) && LV_CORNER_CACHE_SIZE > 0
+    #define CORNER_CACHE            1
+    #if LV_CORNER_CACHE_MAX_SIZE > 255
+        #error "LV_CORNER_CACHE_MAX_SIZE can't be larger than 255"
+    #endif
+#else
+    #define CORNER_CACHE            0
+#endif
+
 /**********************
  *      TYPEDEFS
  **********************/
+#if CORNER_CACHE
+typedef struct {
+    uint8_t * buf;      /*Top left quadrant, the same mirrored for the right corners, then {x1, x2 + 1} of every row*/
+    uint32_t life;
+    lv_coord_t radius;
+    lv_coord_t width;   /*Border or outline width, 0 for a filled corner*/
+    lv_coord_t size;    /*Rows and columns of the quadrant: `max(radius, width)`*/
+} corner_cache_t;
+#endif
 
 /**********************
  *  STATIC PROTOTYPES
@@ -47,9 +65,26 @@ void draw_border_generic(lv_draw_ctx_t * draw_ctx, const lv_area_t * outer_area,
 static void draw_border_simple(lv_draw_ctx_t * draw_ctx, const lv_area_t * outer_area, const lv_area_t * inner_area,
                                lv_color_t color, lv_opa_t opa);
 
+#if CORNER_CACHE
+static const corner_cache_t * corner_get(lv_coord_t radius, lv_coord_t width);
+static void corner_build(uint8_t * buf, lv_coord_t radius, lv_coord_t width, lv_coord_t size);
+static void corner_blend_row(lv_draw_ctx_t * draw_ctx, const lv_draw_sw_blend_dsc_t * dsc,
+                             const corner_cache_t * corner, lv_coord_t row, const lv_area_t * coords, lv_coord_t y);
+static void draw_bg_corner_cached(lv_draw_ctx_t * draw_ctx, lv_draw_sw_blend_dsc_t * blend_dsc,
+                                  const lv_area_t * bg_coords, const corner_cache_t * corner);
+static bool draw_border_corner_cached(lv_draw_ctx_t * draw_ctx, const lv_area_t * outer_area,
+                                      const lv_area_t * inner_area, lv_coord_t rout, lv_coord_t rin, lv_color_t color,
+                                      lv_opa_t opa, lv_blend_mode_t blend_mode);
+#endif
+
 /**********************
  *  STATIC VARIABLES
  **********************/
+#if CORNER_CACHE
+    static corner_cache_t corner_cache[LV_CORNER_CACHE_SIZE];
+    static uint32_t corner_cache_life;
+    static bool corner_cache_enabled = true;
+#endif
 #if defined(LV_SHADOW_CACHE_SIZE) && LV_SHADOW_CACHE_SIZE > 0
     static uint8_t sh_cache[LV_SHADOW_CACHE_SIZE * LV_SHADOW_CACHE_SIZE];
     static int32_t sh_cache_size = -1;
@@ -80,6 +115,19 @@ void lv_draw_sw_rect(lv_draw_ctx_t * draw_ctx, const lv_draw_rect_dsc_t * dsc, c
     LV_ASSERT_MEM_INTEGRITY();
 }
 
+/**
+ * Enable or disable the rounded corner cache (e.g. to measure it). Without it the corners are drawn with radius masks.
+ * @param en true: use the cached corners (default); false: evaluate the radius masks on every draw
+ */
+void lv_draw_sw_corner_cache_enable(bool en)
+{
+#if CORNER_CACHE
+    corner_cache_enabled = en;
+#else
+    LV_UNUSED(en);
+#endif
+}
+
 void lv_draw_sw_bg(lv_draw_ctx_t * draw_ctx, const lv_draw_rect_dsc_t * dsc, const lv_area_t * coords)
 {
 #if LV_COLOR_SCREEN_TRANSP && LV_COLOR_DEPTH == 32
@@ -141,6 +189,17 @@ static void draw_bg(lv_draw_ctx_t * draw_ctx, const lv_draw_rect_dsc_t * dsc, co
     int32_t short_side = LV_MIN(coords_bg_w, coords_bg_h);
     int32_t rout = LV_MIN(dsc->radius, short_side >> 1);
 
+#if CORNER_CACHE
+    /*Opaque plain color with rounded corners only: blend the cached corners in spans, fill the rest*/
+    if(!mask_any && opa == LV_OPA_COVER && grad_dir == LV_GRAD_DIR_NONE) {
+        const corner_cache_t * corner = corner_get(rout, 0);
+        if(corner) {
+            draw_bg_corner_cached(draw_ctx, &blend_dsc, &bg_coords, corner);
+            return;
+        }
+    }
+#endif
+
     /*Add a radius mask if there is radius*/
     int32_t clipped_w = lv_area_get_width(&clipped_coords);
     int16_t mask_rout_id = LV_MASK_ID_INV;
@@ -1157,6 +1216,12 @@ void draw_border_generic(lv_draw_ctx_t * draw_ctx, const lv_area_t * outer_area,
         return;
     }
 
+#if CORNER_CACHE
+    if(!mask_any && draw_border_corner_cached(draw_ctx, outer_area, inner_area, rout, rin, color, opa, blend_mode)) {
+        return;
+    }
+#endif
+
     /*Get clipped draw area which is the real draw area.
      *It is always the same or inside `coords`*/
     lv_area_t draw_area;
@@ -1422,3 +1487,205 @@ static void draw_border_simple(lv_draw_ctx_t * draw_ctx, const lv_area_t * outer
         lv_draw_sw_blend(draw_ctx, &blend_dsc);
     }
 }
+
+#if CORNER_CACHE
+/**
+ * Get the quadrant of a rounded corner from the cache or compute it
+ * @param radius    the radius of the corner (already limited to the half of the shorter side)
+ * @param width     border or outline width, 0 for a filled corner
+ * @return          the cached corner or NULL if it's too large or can't be allocated
+ */
+static const corner_cache_t * corner_get(lv_coord_t radius, lv_coord_t width)
+{
+    if(!corner_cache_enabled) return NULL;
+    lv_coord_t size = LV_MAX(radius, width);
+    if(radius <= 0 || size > LV_CORNER_CACHE_MAX_SIZE) return NULL;
+
+    /*Without anti-aliasing the blend rounds the mask in place which would change the cached corner*/
+    lv_disp_t * disp = _lv_refr_get_disp_refreshing();
+    if(disp == NULL || disp->driver->antialiasing == 0) return NULL;
+
+    corner_cache_life++;
+    corner_cache_t * oldest = &corner_cache[0];
+    uint32_t i;
+    for(i = 0; i < LV_CORNER_CACHE_SIZE; i++) {
+        if(corner_cache[i].buf && corner_cache[i].radius == radius && corner_cache[i].width == width) {
+            corner_cache[i].life = corner_cache_life;
+            return &corner_cache[i];
+        }
+        if(corner_cache[i].life < oldest->life) oldest = &corner_cache[i];
+    }
+
+    uint8_t * buf = lv_mem_alloc(2 * size * size + 2 * size);
+    if(buf == NULL) return NULL;
+    corner_build(buf, radius, width, size);
+
+    if(oldest->buf) lv_mem_free(oldest->buf);
+    oldest->buf = buf;
+    oldest->life = corner_cache_life;
+    oldest->radius = radius;
+    oldest->width = width;
+    oldest->size = size;
+    return oldest;
+}
+
+/**
+ * Apply the same radius masks `draw_bg` and `draw_border_generic` use on the top left corner of a rectangle
+ * large enough to keep the corners apart, and save the result row by row
+ */
+static void corner_build(uint8_t * buf, lv_coord_t radius, lv_coord_t width, lv_coord_t size)
+{
+    lv_area_t outer_area;
+    lv_area_set(&outer_area, 0, 0, 4 * size - 1, 4 * size - 1);
+    lv_draw_mask_radius_param_t outer_param;
+    lv_draw_mask_radius_init(&outer_param, &outer_area, radius, false);
+
+    lv_area_t inner_area;
+    lv_area_set(&inner_area, width, width, outer_area.x2 - width, outer_area.y2 - width);
+    lv_draw_mask_radius_param_t inner_param;
+    if(width > 0) lv_draw_mask_radius_init(&inner_param, &inner_area, LV_MAX(radius - width, 0), true);
+
+    uint8_t * mirror = buf + size * size;
+    uint8_t * span = buf + 2 * size * size;
+    lv_coord_t y;
+    for(y = 0; y < size; y++) {
+        lv_opa_t * row = buf + y * size;
+        lv_memset_ff(row, size);
+        lv_draw_mask_res_t res = outer_param.dsc.cb(row, 0, y, size, &outer_param);
+        if(res != LV_DRAW_MASK_RES_TRANSP && width > 0) res = inner_param.dsc.cb(row, 0, y, size, &inner_param);
+        if(res == LV_DRAW_MASK_RES_TRANSP) lv_memset_00(row, size);
+
+        /*Only the covered part of the row is blended*/
+        lv_coord_t x1 = 0;
+        while(x1 < size && row[x1] == LV_OPA_TRANSP) x1++;
+        lv_coord_t x2 = size;
+        while(x2 > x1 && row[x2 - 1] == LV_OPA_TRANSP) x2--;
+        span[y * 2] = x1;
+        span[y * 2 + 1] = x2;
+
+        lv_coord_t x;
+        for(x = 0; x < size; x++) mirror[y * size + x] = row[size - 1 - x];
+    }
+
+    lv_draw_mask_free_param(&outer_param);
+    if(width > 0) lv_draw_mask_free_param(&inner_param);
+}
+
+/**
+ * Blend a row of a cached corner on both sides of an area
+ * @param dsc       color, opacity and blend mode
+ * @param row       row of the quadrant, counted from the top or bottom edge
+ * @param coords    the outer area of the rounded rectangle
+ * @param y         the row to draw
+ */
+static void corner_blend_row(lv_draw_ctx_t * draw_ctx, const lv_draw_sw_blend_dsc_t * dsc,
+                             const corner_cache_t * corner, lv_coord_t row, const lv_area_t * coords, lv_coord_t y)
+{
+    if(y < draw_ctx->clip_area->y1 || y > draw_ctx->clip_area->y2) return;
+
+    lv_coord_t size = corner->size;
+    const uint8_t * span = corner->buf + 2 * size * size + 2 * row;
+    if(span[0] >= span[1]) return;
+
+    lv_area_t area;
+    area.y1 = y;
+    area.y2 = y;
+
+    lv_draw_sw_blend_dsc_t blend_dsc = *dsc;
+    blend_dsc.blend_area = &area;
+    blend_dsc.mask_area = &area;
+    blend_dsc.mask_res = LV_DRAW_MASK_RES_CHANGED;
+
+    area.x1 = coords->x1 + span[0];
+    area.x2 = coords->x1 + span[1] - 1;
+    blend_dsc.mask_buf = corner->buf + row * size + span[0];
+    lv_draw_sw_blend(draw_ctx, &blend_dsc);
+
+    area.x1 = coords->x2 - span[1] + 1;
+    area.x2 = coords->x2 - span[0];
+    blend_dsc.mask_buf = corner->buf + size * size + row * size + size - span[1];
+    lv_draw_sw_blend(draw_ctx, &blend_dsc);
+}
+
+/**
+ * Draw an opaque rounded background: fill everything but the corners and blend the corners from the cache.
+ * The same pixels as the radius mask path of `draw_bg`.
+ */
+static void draw_bg_corner_cached(lv_draw_ctx_t * draw_ctx, lv_draw_sw_blend_dsc_t * blend_dsc,
+                                  const lv_area_t * bg_coords, const corner_cache_t * corner)
+{
+    lv_coord_t rout = corner->radius;
+    lv_area_t area;
+    blend_dsc->blend_area = &area;
+    blend_dsc->opa = LV_OPA_COVER;
+    blend_dsc->mask_buf = NULL;
+    blend_dsc->mask_res = LV_DRAW_MASK_RES_FULL_COVER;
+
+    /*Between the top corners, between the bottom corners, the full width in the middle*/
+    lv_area_set(&area, bg_coords->x1 + rout, bg_coords->y1, bg_coords->x2 - rout, bg_coords->y1 + rout - 1);
+    lv_draw_sw_blend(draw_ctx, blend_dsc);
+    lv_area_set(&area, bg_coords->x1 + rout, bg_coords->y2 - rout + 1, bg_coords->x2 - rout, bg_coords->y2);
+    lv_draw_sw_blend(draw_ctx, blend_dsc);
+    lv_area_set(&area, bg_coords->x1, bg_coords->y1 + rout, bg_coords->x2, bg_coords->y2 - rout);
+    lv_draw_sw_blend(draw_ctx, blend_dsc);
+
+    lv_coord_t h;
+    for(h = 0; h < rout; h++) {
+        corner_blend_row(draw_ctx, blend_dsc, corner, h, bg_coords, bg_coords->y1 + h);
+        corner_blend_row(draw_ctx, blend_dsc, corner, h, bg_coords, bg_coords->y2 - h);
+    }
+}
+
+/**
+ * Draw a rounded border or outline of the same width on every side with straight fills and cached corners.
+ * The same pixels as `draw_border_generic` without other masks.
+ * @return false if the border is not like that (the caller draws it with masks)
+ */
+static bool draw_border_corner_cached(lv_draw_ctx_t * draw_ctx, const lv_area_t * outer_area,
+                                      const lv_area_t * inner_area, lv_coord_t rout, lv_coord_t rin, lv_color_t color,
+                                      lv_opa_t opa, lv_blend_mode_t blend_mode)
+{
+    lv_coord_t width = inner_area->x1 - outer_area->x1;
+    if(width <= 0 || outer_area->x2 - inner_area->x2 != width || inner_area->y1 - outer_area->y1 != width ||
+       outer_area->y2 - inner_area->y2 != width || rin != LV_MAX(rout - width, 0)) {
+        return false;
+    }
+
+    /*The corners mustn't meet. Narrow borders have masked straight lines which give the same pixels only if opaque*/
+    lv_coord_t size = LV_MAX(rout, width);
+    lv_coord_t core_w = lv_area_get_width(outer_area) - 2 * size;
+    if(lv_area_get_height(outer_area) < 2 * size || core_w < 0 || (core_w < SPLIT_LIMIT && opa != LV_OPA_COVER)) {
+        return false;
+    }
+
+    const corner_cache_t * corner = corner_get(rout, width);
+    if(corner == NULL) return false;
+
+    lv_area_t area;
+    lv_draw_sw_blend_dsc_t blend_dsc;
+    lv_memset_00(&blend_dsc, sizeof(blend_dsc));
+    blend_dsc.blend_area = &area;
+    blend_dsc.color = color;
+    blend_dsc.opa = opa;
+    blend_dsc.blend_mode = blend_mode;
+    blend_dsc.mask_res = LV_DRAW_MASK_RES_FULL_COVER;
+
+    /*Top, bottom, left and right straight lines*/
+    lv_area_set(&area, outer_area->x1 + size, outer_area->y1, outer_area->x2 - size, inner_area->y1 - 1);
+    lv_draw_sw_blend(draw_ctx, &blend_dsc);
+    lv_area_set(&area, outer_area->x1 + size, inner_area->y2 + 1, outer_area->x2 - size, outer_area->y2);
+    lv_draw_sw_blend(draw_ctx, &blend_dsc);
+    lv_area_set(&area, outer_area->x1, outer_area->y1 + size, inner_area->x1 - 1, outer_area->y2 - size);
+    lv_draw_sw_blend(draw_ctx, &blend_dsc);
+    lv_area_set(&area, inner_area->x2 + 1, outer_area->y1 + size, outer_area->x2, outer_area->y2 - size);
+    lv_draw_sw_blend(draw_ctx, &blend_dsc);
+
+    lv_coord_t h;
+    for(h = 0; h < size; h++) {
+        corner_blend_row(draw_ctx, &blend_dsc, corner, h, outer_area, outer_area->y1 + h);
+        corner_blend_row(draw_ctx, &blend_dsc, corner, h, outer_area, outer_area->y2 - h);
+    }
+
+    return true;
+}
+#endif /*CORNER_CACHE*/
@@ -136,6 +136,10 @@ typedef struct _lv_disp_drv_t {
     /** OPTIONAL: called when start rendering */
     void (*render_start_cb)(struct _lv_disp_drv_t * disp_drv);
 
+    /** OPTIONAL: called with every area invalidated on an object, also on screens which are not loaded
+     * and while invalidation is disabled (e.g. to keep a copy of a screen up to date)*/
+    void (*invalidate_cb)(struct _lv_disp_drv_t * disp_drv, const struct _lv_obj_t * obj, const lv_area_t * area);
+
     /** On CHROMA_KEYED images this color will be transparent.
      * `LV_COLOR_CHROMA_KEY` by default. (lv_conf.h)*/
     lv_color_t color_chroma_key;
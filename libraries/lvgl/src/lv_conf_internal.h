@@ -313,6 +313,28 @@
             #define LV_CIRCLE_CACHE_SIZE 4
         #endif
     #endif
+
+    /* Set number of maximally cached rounded corners (radius and border/outline width).
+    * One anti-aliased quadrant is saved per entry and mirrored to the 4 corners,
+    * so rounded rectangles are blended in spans without evaluating radius masks.
+    * 2 * size^2 bytes are used per corner where size is `max(radius, width)`
+    * 0: to disable caching */
+    #ifndef LV_CORNER_CACHE_SIZE
+        #ifdef CONFIG_LV_CORNER_CACHE_SIZE
+            #define LV_CORNER_CACHE_SIZE CONFIG_LV_CORNER_CACHE_SIZE
+        #else
+            #define LV_CORNER_CACHE_SIZE 0
+        #endif
+    #endif
+
+    /*Larger corners are drawn with radius masks*/
+    #ifndef LV_CORNER_CACHE_MAX_SIZE
+        #ifdef CONFIG_LV_CORNER_CACHE_MAX_SIZE
+            #define LV_CORNER_CACHE_MAX_SIZE CONFIG_LV_CORNER_CACHE_MAX_SIZE
+        #else
+            #define LV_CORNER_CACHE_MAX_SIZE 32
+        #endif
+    #endif
 #endif /*LV_DRAW_COMPLEX*/
 
 /**
@@ -1,6 +1,15 @@
 #include "lv_port.h"
+#include "lv_port_blend.h"
+#include "lv_port_dma.h"
+#include "lv_port_frame.h"
 #include "bsp_st7789.h"
 #include "bsp_cst328.h"
+#include "latency_probe.h"
+#include "hardware/sync.h"
+#if LV_PORT_CORE1_FLUSH
+#include "pico/multicore.h"
+#include "pico/flash.h"
+#endif
 
 #define LCD_WIDTH 240
 #define LCD_HEIGHT 320
@@ -8,11 +17,166 @@
 
 lv_indev_t *indev_touchpad;
 static lv_disp_drv_t disp_drv; /*Descriptor of a display driver*/
+static volatile bool flushing_last_band = false; /*Set while the final band of a frame is on the DMA*/
+static volatile bool pushing = false; /*Set while lv_port_push() has the DMA*/
 
 #define LVGL_TICK_PERIOD_MS 1
 
+/*Pipeline statistics; each core writes only its own half*/
+static struct
+{
+    uint32_t window_start_us;
+    uint32_t render_start_us;
+    uint32_t frame_wait_us;
+    uint32_t wait_start_us;
+    bool waiting;
+    uint32_t frames;
+    uint64_t render_us;                     /*Core0 rendering, flush waits excluded*/
+    uint64_t wait_us;                       /*Core0 blocked on a busy draw buffer*/
+} core0_stats;
+
+static struct
+{
+    volatile bool reset;                    /*Set by core0, cleared by the flushing side*/
+    uint32_t frames;
+    uint32_t bands;
+    uint64_t pixels;
+    uint64_t busy_us;                       /*Window commands and starting the DMA*/
+    uint64_t dma_us;                        /*Waiting for the DMA and SPI to drain*/
+} flush_stats;
+
+/*Time-to-first-frame of screen changes; core0 arms it, the side that sees the frame on the panel ends it*/
+static struct
+{
+    uint32_t start_us;
+    bool armed;                             /*Waiting for the next frame to start rendering*/
+    volatile bool rendering;                /*That frame is on its way to the panel*/
+    uint32_t rendered;                      /*Rendered by LVGL (written by the flushing side)*/
+    uint32_t rendered_last_us;
+    uint32_t rendered_max_us;
+    uint32_t pushed;                        /*Pushed from a retained copy (written by core0)*/
+    uint32_t pushed_last_us;
+    uint32_t pushed_max_us;
+} nav;
+
+/*The flushing side: the last band of a frame is on the panel*/
+static void frame_done(uint32_t done_us)
+{
+    if (nav.rendering)
+    {
+        nav.rendered_last_us = done_us - nav.start_us;
+        nav.rendered_max_us = LV_MAX(nav.rendered_max_us, nav.rendered_last_us);
+        nav.rendered++;
+        nav.rendering = false;
+    }
+}
+
+#if LV_PORT_CORE1_FLUSH
+/*Finished draw buffers handed from core0 to core1: single producer, single consumer*/
+typedef struct
+{
+    lv_area_t area;
+    lv_color_t *color_p;
+    bool last;
+    bool pushed;                            /*From lv_port_push(): not a buffer of LVGL's*/
+} flush_job_t;
+
+#define FLUSH_QUEUE_SIZE 4                  /*LVGL has one band in flight with two buffers; a power of two*/
+static flush_job_t flush_queue[FLUSH_QUEUE_SIZE];
+static volatile uint32_t flush_head;        /*Written by core0 only*/
+static volatile uint32_t flush_tail;        /*Written by core1 only*/
+
+/*Core1: owns the SPI and the display DMA. Takes a band, sends the window commands, pushes the pixels,
+ *then hands the buffer back to LVGL. The panel is set to little-endian RGB565 (RAMCTRL), so LVGL's
+ *buffers go out as they are, with no conversion pass*/
+static void core1_display_worker(void)
+{
+    /*Let core0's flash writes park this core while XIP is off, then tell core0 it may write again*/
+    flash_safe_execute_core_init();
+    multicore_fifo_push_blocking(0);
+
+    while (true)
+    {
+        while (flush_tail == flush_head)
+        {
+            __wfe();
+        }
+        __dmb();
+        flush_job_t job = flush_queue[flush_tail % FLUSH_QUEUE_SIZE];
+        if (flush_stats.reset)
+        {
+            memset((void *)&flush_stats, 0, sizeof(flush_stats));
+        }
+
+        uint32_t start_us = time_us_32();
+        bsp_st7789_flush_dma(job.area.x1, job.area.y1, job.area.x2, job.area.y2, (uint16_t *)job.color_p);
+        uint32_t issued_us = time_us_32();
+        bsp_st7789_wait_dma();
+        uint32_t done_us = time_us_32();
+
+        flush_stats.bands++;
+        flush_stats.pixels += (uint32_t)lv_area_get_size(&job.area);
+        flush_stats.busy_us += issued_us - start_us;
+        flush_stats.dma_us += done_us - issued_us;
+        if (job.last)
+        {
+            flush_stats.frames++;
+            frame_done(done_us);
+            LATENCY_MARK(LATENCY_STAGE_FLUSH_DONE);
+        }
+
+        flush_tail++;
+        __dmb();
+        if (!job.pushed)
+        {
+            lv_disp_flush_ready(&disp_drv);
+        }
+        __sev();
+    }
+}
+#endif
+
+static void end_flush_wait(uint32_t now_us)
+{
+    if (core0_stats.waiting)
+    {
+        core0_stats.waiting = false;
+        core0_stats.frame_wait_us += now_us - core0_stats.wait_start_us;
+        core0_stats.wait_us += now_us - core0_stats.wait_start_us;
+    }
+}
+
+/*Called by LVGL while it waits for the draw buffer it wants to be flushed*/
+static void disp_wait(lv_disp_drv_t *disp_drv)
+{
+    if (!core0_stats.waiting)
+    {
+        core0_stats.waiting = true;
+        core0_stats.wait_start_us = time_us_32();
+    }
+#if LV_PORT_CORE1_FLUSH
+    __wfe(); /*Core1 signals every finished band*/
+#endif
+}
+
 static void disp_flush(lv_disp_drv_t *disp_drv, const lv_area_t *area, lv_color_t *color_p)
 {
+    end_flush_wait(time_us_32());
+#if LV_PORT_CORE1_FLUSH
+    uint32_t head = flush_head;
+    while (head - flush_tail >= FLUSH_QUEUE_SIZE)
+    {
+        __wfe();
+    }
+    flush_job_t *job = &flush_queue[head % FLUSH_QUEUE_SIZE];
+    job->area = *area;
+    job->color_p = color_p;
+    job->last = lv_disp_flush_is_last(disp_drv);
+    job->pushed = false;
+    __dmb();
+    flush_head = head + 1;
+    __sev();
+#else
     // if(disp_flush_enabled) {
     //     /*The most simple case (but also the slowest) to put all pixels to the screen one-by-one*/
 
@@ -26,11 +190,21 @@ static void disp_flush(lv_disp_drv_t *disp_drv, const lv_area_t *area, lv_color_
     //         }
     //     }
     // }
+    if (flush_stats.reset)
+    {
+        memset((void *)&flush_stats, 0, sizeof(flush_stats));
+    }
+    uint32_t start_us = time_us_32();
+    flushing_last_band = lv_disp_flush_is_last(disp_drv);
     bsp_st7789_flush_dma(area->x1, area->y1, area->x2, area->y2,
                          (uint16_t *)color_p);
+    flush_stats.bands++;
+    flush_stats.pixels += (uint32_t)lv_area_get_size(area);
+    flush_stats.busy_us += time_us_32() - start_us;
     /*IMPORTANT!!!
      *Inform the graphics library that you are ready with the flushing*/
     // lv_disp_flush_ready(disp_drv);
+#endif
 }
 
 static void touchpad_read(lv_indev_drv_t *indev_drv, lv_indev_data_t *data)
@@ -42,6 +216,7 @@ static void touchpad_read(lv_indev_drv_t *indev_drv, lv_indev_data_t *data)
     if (bsp_cst328_get_touch_data(&cst328_data))
     {
         data->state = LV_INDEV_STATE_PR;
+        LATENCY_MARK(LATENCY_STAGE_INDEV_READ);
     }
     else
     {
@@ -59,8 +234,46 @@ static bool repeating_lvgl_timer_cb(struct repeating_timer *t)
     return true;
 }
 
+static void touch_int_callback(void)
+{
+    LATENCY_MARK(LATENCY_STAGE_TOUCH_IRQ);
+}
+
+static void render_start_cb(lv_disp_drv_t *disp_drv)
+{
+    LATENCY_MARK(LATENCY_STAGE_RENDER_START);
+    if (nav.armed)
+    {
+        nav.armed = false;
+        nav.rendering = true;
+    }
+    core0_stats.render_start_us = time_us_32();
+    core0_stats.frame_wait_us = 0;
+}
+
+static void render_monitor_cb(lv_disp_drv_t *disp_drv, uint32_t time, uint32_t px)
+{
+    LATENCY_MARK(LATENCY_STAGE_RENDER_END);
+    uint32_t now_us = time_us_32();
+    end_flush_wait(now_us);
+    core0_stats.render_us += now_us - core0_stats.render_start_us - core0_stats.frame_wait_us;
+    core0_stats.frames++;
+}
+
 void lvgl_flush_done_callback(void)
 {
+    if (pushing)
+    {
+        pushing = false; /*lv_port_push() waits for this itself*/
+        return;
+    }
+    if (flushing_last_band)
+    {
+        flushing_last_band = false;
+        flush_stats.frames++;
+        frame_done(time_us_32());
+        LATENCY_MARK(LATENCY_STAGE_FLUSH_DONE);
+    }
     lv_disp_flush_ready(&disp_drv);
 }
 
@@ -76,16 +289,17 @@ void lv_port_init(void)
     st7789_info.x_offset = 0;
     st7789_info.y_offset = 0;
     st7789_info.enabled_dma = true;
+#if LV_PORT_CORE1_FLUSH
+    st7789_info.dma_flush_done_callback = NULL; /*Core1 waits for the DMA itself*/
+#else
     st7789_info.dma_flush_done_callback = lvgl_flush_done_callback;
-    bsp_st7789_init(&st7789_info);
+#endif
     bsp_st7789_init(&st7789_info);
     uint32_t buffer_size = st7789_info.width * st7789_info.height / 4;
     lv_color_t *buf_1 = (lv_color_t *)malloc(buffer_size * sizeof(lv_color_t));
     lv_color_t *buf_2 = (lv_color_t *)malloc(buffer_size * sizeof(lv_color_t));
     lv_disp_draw_buf_init(&draw_buf_dsc, buf_1, buf_2, buffer_size);
 
-    lv_disp_draw_buf_init(&draw_buf_dsc, buf_1, buf_2, buffer_size);
-
     /*-----------------------------------
      * Register the display in LVGL
      *----------------------------------*/
@@ -94,15 +308,31 @@ void lv_port_init(void)
     disp_drv.hor_res = st7789_info.width;
     disp_drv.ver_res = st7789_info.height;
     disp_drv.flush_cb = disp_flush;
+    disp_drv.wait_cb = disp_wait;
+    disp_drv.render_start_cb = render_start_cb;
+    disp_drv.monitor_cb = render_monitor_cb;
     disp_drv.draw_buf = &draw_buf_dsc;
+#if LV_PORT_DMA_FILL
+    lv_port_dma_init(); /*Large opaque fills and copies of the blend kernels*/
+#endif
+#if LV_PORT_BLEND_SWAR
+    disp_drv.draw_ctx_init = lv_port_blend_init_ctx; /*Two-pixels-per-word RGB565 blend kernels*/
+#endif
+#if LV_PORT_FRAME_CACHE
+    disp_drv.invalidate_cb = lv_port_frame_invalidate_cb; /*Keeps the copies of retained screens up to date*/
+#endif
     lv_disp_drv_register(&disp_drv);
 
-    lv_disp_drv_register(&disp_drv);
+#if LV_PORT_CORE1_FLUSH
+    multicore_launch_core1(core1_display_worker);
+    multicore_fifo_pop_blocking();
+#endif
 
     static bsp_cst328_info_t cst328_info;
     cst328_info.width = LCD_WIDTH;
     cst328_info.height = LCD_HEIGHT;
     cst328_info.rotation = LCD_ROTATION;
+    cst328_info.int_callback = touch_int_callback;
     bsp_cst328_init(&cst328_info);
 
     static lv_indev_drv_t indev_drv;
@@ -113,4 +343,159 @@ void lv_port_init(void)
 
     static struct repeating_timer lvgl_timer;
     add_repeating_timer_ms(LVGL_TICK_PERIOD_MS, repeating_lvgl_timer_cb, NULL, &lvgl_timer);
-}
\ No newline at end of file
+
+    core0_stats.window_start_us = time_us_32();
+}
+
+void lv_port_push(const lv_area_t *area, const lv_color_t *color_p)
+{
+#if LV_PORT_CORE1_FLUSH
+    /*Queued behind LVGL's bands, so core1 keeps the only hand on the SPI*/
+    uint32_t head = flush_head;
+    while (head - flush_tail >= FLUSH_QUEUE_SIZE)
+    {
+        __wfe();
+    }
+    flush_job_t *job = &flush_queue[head % FLUSH_QUEUE_SIZE];
+    job->area = *area;
+    job->color_p = (lv_color_t *)color_p;
+    job->last = false;
+    job->pushed = true;
+    __dmb();
+    flush_head = head + 1;
+    __sev();
+    while ((int32_t)(flush_tail - (head + 1)) < 0)
+    {
+        __wfe();
+    }
+#else
+    while (disp_drv.draw_buf->flushing)
+    {
+        tight_loop_contents();
+    }
+    uint32_t start_us = time_us_32();
+    pushing = true;
+    bsp_st7789_flush_dma(area->x1, area->y1, area->x2, area->y2, (uint16_t *)color_p);
+    while (pushing)
+    {
+        tight_loop_contents();
+    }
+    flush_stats.bands++;
+    flush_stats.pixels += (uint32_t)lv_area_get_size(area);
+    flush_stats.busy_us += time_us_32() - start_us;
+#endif
+
+    if (nav.armed)
+    {
+        nav.armed = false;
+        nav.pushed_last_us = time_us_32() - nav.start_us;
+        nav.pushed_max_us = LV_MAX(nav.pushed_max_us, nav.pushed_last_us);
+        nav.pushed++;
+    }
+}
+
+void lv_port_mark_navigation(void)
+{
+    nav.start_us = time_us_32();
+    nav.armed = true;
+}
+
+void lv_port_reset_stats(void)
+{
+    memset(&core0_stats, 0, sizeof(core0_stats));
+    core0_stats.window_start_us = time_us_32();
+    flush_stats.reset = true;
+}
+
+void lv_port_dump(void)
+{
+    uint32_t window_us = time_us_32() - core0_stats.window_start_us;
+    uint32_t window_ms = window_us / 1000 ? window_us / 1000 : 1;
+    printf("DISP mode=%s window_ms=%lu rendered=%lu flushed=%lu fps_x10=%lu bands=%lu kpx=%lu\n",
+           LV_PORT_CORE1_FLUSH ? "core1" : "core0", window_ms, core0_stats.frames, flush_stats.frames,
+           flush_stats.frames * 10000 / window_ms, flush_stats.bands, (uint32_t)(flush_stats.pixels / 1000));
+    printf("DISP core0 render_ms=%lu wait_ms=%lu render_pct=%lu wait_pct=%lu\n",
+           (uint32_t)(core0_stats.render_us / 1000), (uint32_t)(core0_stats.wait_us / 1000),
+           (uint32_t)(core0_stats.render_us / 10 / window_ms), (uint32_t)(core0_stats.wait_us / 10 / window_ms));
+    printf("DISP %s flush_ms=%lu dma_ms=%lu flush_pct=%lu dma_pct=%lu\n", LV_PORT_CORE1_FLUSH ? "core1" : "core0",
+           (uint32_t)(flush_stats.busy_us / 1000), (uint32_t)(flush_stats.dma_us / 1000),
+           (uint32_t)(flush_stats.busy_us / 10 / window_ms), (uint32_t)(flush_stats.dma_us / 10 / window_ms));
+    printf("DISP nav rendered=%lu ttff_us=%lu max_us=%lu pushed=%lu ttff_us=%lu max_us=%lu\n", nav.rendered,
+           nav.rendered_last_us, nav.rendered_max_us, nav.pushed, nav.pushed_last_us, nav.pushed_max_us);
+}
+/*-----------------
+ * Frame benchmark
+ *----------------*/
+
+#define FRAME_BAND_HEIGHT 40
+#define FRAME_ROUNDS 4
+
+/*Render the active screen and the layers above it band by band into band, not flushed; returns microseconds*/
+static uint32_t render_frame(lv_draw_ctx_t *draw_ctx, lv_color_t *band, uint32_t *hash)
+{
+    lv_disp_t *disp = lv_disp_get_default();
+    uint32_t total_us = 0;
+    for (lv_coord_t y = 0; y < LCD_HEIGHT; y += FRAME_BAND_HEIGHT)
+    {
+        lv_area_t area = { 0, y, LCD_WIDTH - 1, LV_MIN(y + FRAME_BAND_HEIGHT, LCD_HEIGHT) - 1 };
+        draw_ctx->buf = band;
+        draw_ctx->buf_area = &area;
+        draw_ctx->clip_area = &area;
+        uint32_t t0 = time_us_32();
+        lv_obj_redraw(draw_ctx, lv_disp_get_scr_act(disp));
+        lv_obj_redraw(draw_ctx, lv_disp_get_layer_top(disp));
+        lv_obj_redraw(draw_ctx, lv_disp_get_layer_sys(disp));
+        if (draw_ctx->wait_for_finish)
+        {
+            draw_ctx->wait_for_finish(draw_ctx);
+        }
+        total_us += time_us_32() - t0;
+
+        uint32_t pixels = lv_area_get_size(&area);
+        for (uint32_t i = 0; i < pixels; i++)
+        {
+            *hash = (*hash ^ band[i].full) * 16777619U; /*FNV-1a*/
+        }
+    }
+    return total_us;
+}
+
+void lv_port_corner_benchmark(void)
+{
+    lv_color_t *band = malloc(LCD_WIDTH * FRAME_BAND_HEIGHT * sizeof(lv_color_t));
+    if (!band)
+    {
+        printf("RECT out of memory\n");
+        return;
+    }
+    lv_disp_t *refreshing = _lv_refr_get_disp_refreshing();
+    _lv_refr_set_disp_refreshing(lv_disp_get_default());
+
+    lv_draw_sw_ctx_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    disp_drv.draw_ctx_init(&disp_drv, &ctx.base_draw);
+
+    /*Alternated so that both see the same caches and the same screen*/
+    uint32_t masked_us = 0;
+    uint32_t cached_us = 0;
+    uint32_t masked_hash = 2166136261U;
+    uint32_t cached_hash = 2166136261U;
+    for (uint32_t round = 0; round < FRAME_ROUNDS; round++)
+    {
+        uint32_t hash = 2166136261U;
+        lv_draw_sw_corner_cache_enable(false);
+        masked_us += render_frame(&ctx.base_draw, band, &hash);
+        masked_hash = hash;
+        hash = 2166136261U;
+        lv_draw_sw_corner_cache_enable(true);
+        cached_us += render_frame(&ctx.base_draw, band, &hash);
+        cached_hash = hash;
+    }
+    masked_us /= FRAME_ROUNDS;
+    cached_us /= FRAME_ROUNDS;
+    printf("RECT frame_us_masked=%lu frame_us_cached=%lu saved_us=%ld match=%d\n", masked_us, cached_us,
+           (int32_t)(masked_us - cached_us), masked_hash == cached_hash);
+
+    _lv_refr_set_disp_refreshing(refreshing);
+    free(band);
+}
@@ -9,8 +9,26 @@
 #include "lvgl.h"
 
 
+// Configuration
+#ifndef LV_PORT_CORE1_FLUSH
+#define LV_PORT_CORE1_FLUSH 1 // Core1 owns the display: window commands, DMA and flush-ready; core0 only renders
+#endif
+
 void lv_port_init(void);
 
+// Send pixels to the panel outside LVGL's refresh, behind the bands already queued; returns once they are shown
+void lv_port_push(const lv_area_t *area, const lv_color_t *color_p);
+
+// Start a time-to-first-frame measurement: ended by the next frame fully on the panel, rendered or pushed
+void lv_port_mark_navigation(void);
+
+// Display pipeline statistics: frames per second and per-core time since the last reset
+void lv_port_reset_stats(void);
+void lv_port_dump(void);
+
+// Active screen rendered offscreen with LVGL's corner masks against cached corners, with an output comparison
+void lv_port_corner_benchmark(void);
+
 
 #endif // __LV_PORT_H__
 
@@ -0,0 +1,642 @@
+#include "lv_port_blend.h"
+#include "lv_port_dma.h"
+#include "lv_port_glyph.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#if LV_PORT_BLEND_SIMD
+#include <arm_acle.h>
+#endif
+
+#if LV_COLOR_DEPTH != 16 || LV_COLOR_16_SWAP != 0 || LV_COLOR_MIX_ROUND_OFS != 0
+#error "lv_port_blend reproduces lv_color_mix() for RGB565 without byte swap and LV_COLOR_MIX_ROUND_OFS 0"
+#endif
+
+/*lv_color_mix() layout: G moved to the upper half, so each channel has room for its product with a 5-bit mix*/
+#define MIX_MASK 0x07E0F81FU
+#define MIX4_COVER 0x20202020U
+
+/*Opacity fill constants: both pixels' channels side by side in 16-bit lanes*/
+typedef struct
+{
+    uint32_t premult_r;
+    uint32_t premult_g;
+    uint32_t premult_b;
+    uint32_t opa_inv;
+} fill_opa_t;
+
+static inline uint32_t load32(const void *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline void store32(void *p, uint32_t v)
+{
+    memcpy(p, &v, sizeof(v));
+}
+
+static inline uint32_t spread(uint32_t c)
+{
+    return (c | (c << 16)) & MIX_MASK;
+}
+
+/*lv_color_mix()'s rounding of an opacity to 0..32*/
+static inline uint32_t mix_of(uint32_t opa)
+{
+    return (opa + 4) >> 3;
+}
+
+/*mix_of() on four mask bytes at once*/
+static inline uint32_t mix4_of(uint32_t mask4)
+{
+#if LV_PORT_BLEND_SIMD
+    return (__uhadd8(mask4, 0x04040404U) >> 2) & 0x3F3F3F3FU;
+#else
+    return ((mask4 >> 3) & 0x1F1F1F1FU) + ((((mask4 & 0x07070707U) + 0x04040404U) >> 3) & 0x01010101U);
+#endif
+}
+
+/*Opacity of a masked pixel as LVGL computes it, as a mix; masks from cover_from up take the plain opacity*/
+static inline uint32_t mix_masked(uint32_t mask, uint32_t opa, uint32_t cover_from, uint32_t mix_cover)
+{
+    return mask >= cover_from ? mix_cover : mix_of((mask * opa) >> 8);
+}
+
+/*lv_color_mix() with the foreground already spread*/
+static inline uint32_t mix_px(uint32_t fg_s, uint32_t bg, uint32_t mix)
+{
+    uint32_t bg_s = spread(bg);
+    uint32_t r = ((((fg_s - bg_s) * mix) >> 5) + bg_s) & MIX_MASK;
+    return (r >> 16 | r) & 0xFFFF;
+}
+
+static inline uint32_t mix_pair(uint32_t fg_s0, uint32_t fg_s1, uint32_t bg2, uint32_t mix0, uint32_t mix1)
+{
+    return mix_px(fg_s0, bg2 & 0xFFFF, mix0) | (mix_px(fg_s1, bg2 >> 16, mix1) << 16);
+}
+
+/*LV_UDIV255() in both 16-bit lanes, exact for lanes up to 63 * 255*/
+static inline uint32_t lanes_div255(uint32_t v)
+{
+#if LV_PORT_BLEND_SIMD
+    v += __uxtb16(v >> 8) + 0x00010001U;
+    return __uxtb16(v >> 8);
+#else
+    v += ((v >> 8) & 0x00FF00FFU) + 0x00010001U;
+    return (v >> 8) & 0x00FF00FFU;
+#endif
+}
+
+/*lv_color_mix_premult() on two pixels: one multiply per channel for both*/
+static inline uint32_t fill_opa_pair(const fill_opa_t *k, uint32_t bg2)
+{
+    uint32_t r = lanes_div255(((bg2 >> 11) & 0x001F001FU) * k->opa_inv + k->premult_r);
+    uint32_t g = lanes_div255(((bg2 >> 5) & 0x003F003FU) * k->opa_inv + k->premult_g);
+    uint32_t b = lanes_div255((bg2 & 0x001F001FU) * k->opa_inv + k->premult_b);
+    return (r << 11) | (g << 5) | b;
+}
+
+static void fill_opa(lv_color_t *dest, lv_coord_t dest_stride, int32_t w, int32_t h, lv_color_t color,
+                     lv_opa_t opa)
+{
+    /*LVGL's result cache starts at black with a plain lv_color_mix(), so leading black pixels get that*/
+    uint16_t black_res = lv_color_mix(color, lv_color_black(), opa).full;
+    bool leading_black = true;
+
+    /*Then the premultiplied mix, with lv_color_mix()'s opacity rounding (256 wraps to 0 in lv_opa_t)*/
+    uint32_t opa_r = (uint8_t)(mix_of(opa) << 3);
+    fill_opa_t k;
+    k.premult_r = LV_COLOR_GET_R(color) * opa_r * 0x00010001U;
+    k.premult_g = LV_COLOR_GET_G(color) * opa_r * 0x00010001U;
+    k.premult_b = LV_COLOR_GET_B(color) * opa_r * 0x00010001U;
+    k.opa_inv = 255 - opa_r;
+
+    /*Runs of the same background cost a compare per two pixels*/
+    uint32_t last_bg2 = 0;
+    uint32_t last_res2 = fill_opa_pair(&k, 0);
+
+    for (int32_t y = 0; y < h; y++)
+    {
+        int32_t x = 0;
+        if (leading_black)
+        {
+            for (; x < w && dest[x].full == 0; x++)
+            {
+                dest[x].full = black_res;
+            }
+            leading_black = x == w;
+        }
+        if (x < w && ((lv_uintptr_t)&dest[x] & 0x2))
+        {
+            dest[x].full = (uint16_t)fill_opa_pair(&k, dest[x].full);
+            x++;
+        }
+        for (; x + 2 <= w; x += 2)
+        {
+            uint32_t bg2 = load32(&dest[x]);
+            if (bg2 != last_bg2)
+            {
+                last_bg2 = bg2;
+                last_res2 = fill_opa_pair(&k, bg2);
+            }
+            store32(&dest[x], last_res2);
+        }
+        if (x < w)
+        {
+            dest[x].full = (uint16_t)fill_opa_pair(&k, dest[x].full);
+        }
+        dest += dest_stride;
+    }
+}
+
+static void fill_mask(lv_color_t *dest, lv_coord_t dest_stride, int32_t w, int32_t h, lv_color_t color,
+                      const lv_opa_t *mask, lv_coord_t mask_stride)
+{
+    uint32_t fg_s = spread(color.full);
+    uint32_t color2 = color.full * 0x00010001U;
+
+    for (int32_t y = 0; y < h; y++)
+    {
+        int32_t x = 0;
+        if (w > 0 && ((lv_uintptr_t)dest & 0x2))
+        {
+            dest[0].full = (uint16_t)mix_px(fg_s, dest[0].full, mix_of(mask[0]));
+            x = 1;
+        }
+        for (; x + 4 <= w; x += 4)
+        {
+            uint32_t mix4 = mix4_of(load32(&mask[x]));
+            if (mix4 == 0)
+            {
+                continue;
+            }
+            if (mix4 == MIX4_COVER)
+            {
+                store32(&dest[x], color2);
+                store32(&dest[x + 2], color2);
+                continue;
+            }
+            if (mix4 & 0xFFFF)
+            {
+                store32(&dest[x], mix_pair(fg_s, fg_s, load32(&dest[x]), mix4 & 0xFF, (mix4 >> 8) & 0xFF));
+            }
+            if (mix4 >> 16)
+            {
+                store32(&dest[x + 2], mix_pair(fg_s, fg_s, load32(&dest[x + 2]), (mix4 >> 16) & 0xFF, mix4 >> 24));
+            }
+        }
+        for (; x < w; x++)
+        {
+            dest[x].full = (uint16_t)mix_px(fg_s, dest[x].full, mix_of(mask[x]));
+        }
+        dest += dest_stride;
+        mask += mask_stride;
+    }
+}
+
+static void fill_mask_opa(lv_color_t *dest, lv_coord_t dest_stride, int32_t w, int32_t h, lv_color_t color,
+                          lv_opa_t opa, const lv_opa_t *mask, lv_coord_t mask_stride)
+{
+    uint32_t fg_s = spread(color.full);
+    uint32_t mix_cover = mix_of(opa);
+
+    for (int32_t y = 0; y < h; y++)
+    {
+        int32_t x = 0;
+        if (w > 0 && ((lv_uintptr_t)dest & 0x2))
+        {
+            dest[0].full = (uint16_t)mix_px(fg_s, dest[0].full, mix_masked(mask[0], opa, LV_OPA_COVER, mix_cover));
+            x = 1;
+        }
+        for (; x + 2 <= w; x += 2)
+        {
+            uint32_t mask0 = mask[x];
+            uint32_t mask1 = mask[x + 1];
+            if ((mask0 | mask1) == 0)
+            {
+                continue;
+            }
+            store32(&dest[x], mix_pair(fg_s, fg_s, load32(&dest[x]),
+                                       mix_masked(mask0, opa, LV_OPA_COVER, mix_cover),
+                                       mix_masked(mask1, opa, LV_OPA_COVER, mix_cover)));
+        }
+        if (x < w)
+        {
+            dest[x].full = (uint16_t)mix_px(fg_s, dest[x].full, mix_masked(mask[x], opa, LV_OPA_COVER, mix_cover));
+        }
+        dest += dest_stride;
+        mask += mask_stride;
+    }
+}
+
+/*Word copy of one row; a source a halfword off the destination is read as aligned words and funnel shifted*/
+static void copy_row(lv_color_t *dest, const lv_color_t *src, int32_t n)
+{
+    if (n > 0 && ((lv_uintptr_t)dest & 0x2))
+    {
+        *dest++ = *src++;
+        n--;
+    }
+    if (((lv_uintptr_t)src & 0x2) == 0)
+    {
+        for (; n >= 8; n -= 8, dest += 8, src += 8)
+        {
+            store32(&dest[0], load32(&src[0]));
+            store32(&dest[2], load32(&src[2]));
+            store32(&dest[4], load32(&src[4]));
+            store32(&dest[6], load32(&src[6]));
+        }
+        for (; n >= 2; n -= 2, dest += 2, src += 2)
+        {
+            store32(dest, load32(src));
+        }
+        if (n)
+        {
+            *dest = *src;
+        }
+        return;
+    }
+
+    /*carry holds src[0]; each aligned word from src[1] gives the next pixel and becomes the carry*/
+    uint32_t carry = src[0].full;
+    for (; n >= 3; n -= 2, dest += 2, src += 2)
+    {
+        uint32_t next2 = load32(&src[1]);
+        store32(dest, carry | (next2 << 16));
+        carry = next2 >> 16;
+    }
+    if (n)
+    {
+        dest[0].full = (uint16_t)carry;
+        if (n == 2)
+        {
+            dest[1] = src[1];
+        }
+    }
+}
+
+static void map_opa(lv_color_t *dest, lv_coord_t dest_stride, int32_t w, int32_t h, const lv_color_t *src,
+                    lv_coord_t src_stride, lv_opa_t opa)
+{
+    uint32_t mix = mix_of(opa);
+
+    for (int32_t y = 0; y < h; y++)
+    {
+        int32_t x = 0;
+        if (w > 0 && ((lv_uintptr_t)dest & 0x2))
+        {
+            dest[0].full = (uint16_t)mix_px(spread(src[0].full), dest[0].full, mix);
+            x = 1;
+        }
+        for (; x + 2 <= w; x += 2)
+        {
+            uint32_t src2 = load32(&src[x]);
+            store32(&dest[x], mix_pair(spread(src2 & 0xFFFF), spread(src2 >> 16), load32(&dest[x]), mix, mix));
+        }
+        if (x < w)
+        {
+            dest[x].full = (uint16_t)mix_px(spread(src[x].full), dest[x].full, mix);
+        }
+        dest += dest_stride;
+        src += src_stride;
+    }
+}
+
+static void map_mask(lv_color_t *dest, lv_coord_t dest_stride, int32_t w, int32_t h, const lv_color_t *src,
+                     lv_coord_t src_stride, const lv_opa_t *mask, lv_coord_t mask_stride)
+{
+    for (int32_t y = 0; y < h; y++)
+    {
+        int32_t x = 0;
+        if (w > 0 && ((lv_uintptr_t)dest & 0x2))
+        {
+            dest[0].full = (uint16_t)mix_px(spread(src[0].full), dest[0].full, mix_of(mask[0]));
+            x = 1;
+        }
+        for (; x + 4 <= w; x += 4)
+        {
+            uint32_t mix4 = mix4_of(load32(&mask[x]));
+            if (mix4 == 0)
+            {
+                continue;
+            }
+            uint32_t src01 = load32(&src[x]);
+            uint32_t src23 = load32(&src[x + 2]);
+            if (mix4 == MIX4_COVER)
+            {
+                store32(&dest[x], src01);
+                store32(&dest[x + 2], src23);
+                continue;
+            }
+            store32(&dest[x], mix_pair(spread(src01 & 0xFFFF), spread(src01 >> 16), load32(&dest[x]),
+                                       mix4 & 0xFF, (mix4 >> 8) & 0xFF));
+            store32(&dest[x + 2], mix_pair(spread(src23 & 0xFFFF), spread(src23 >> 16), load32(&dest[x + 2]),
+                                           (mix4 >> 16) & 0xFF, mix4 >> 24));
+        }
+        for (; x < w; x++)
+        {
+            dest[x].full = (uint16_t)mix_px(spread(src[x].full), dest[x].full, mix_of(mask[x]));
+        }
+        dest += dest_stride;
+        src += src_stride;
+        mask += mask_stride;
+    }
+}
+
+static void map_mask_opa(lv_color_t *dest, lv_coord_t dest_stride, int32_t w, int32_t h, const lv_color_t *src,
+                         lv_coord_t src_stride, lv_opa_t opa, const lv_opa_t *mask, lv_coord_t mask_stride)
+{
+    uint32_t mix_cover = mix_of(opa);
+
+    for (int32_t y = 0; y < h; y++)
+    {
+        int32_t x = 0;
+        if (w > 0 && ((lv_uintptr_t)dest & 0x2))
+        {
+            dest[0].full = (uint16_t)mix_px(spread(src[0].full), dest[0].full,
+                                            mix_masked(mask[0], opa, LV_OPA_MAX, mix_cover));
+            x = 1;
+        }
+        for (; x + 2 <= w; x += 2)
+        {
+            uint32_t mask0 = mask[x];
+            uint32_t mask1 = mask[x + 1];
+            if ((mask0 | mask1) == 0)
+            {
+                continue;
+            }
+            uint32_t src2 = load32(&src[x]);
+            store32(&dest[x], mix_pair(spread(src2 & 0xFFFF), spread(src2 >> 16), load32(&dest[x]),
+                                       mix_masked(mask0, opa, LV_OPA_MAX, mix_cover),
+                                       mix_masked(mask1, opa, LV_OPA_MAX, mix_cover)));
+        }
+        if (x < w)
+        {
+            dest[x].full = (uint16_t)mix_px(spread(src[x].full), dest[x].full,
+                                            mix_masked(mask[x], opa, LV_OPA_MAX, mix_cover));
+        }
+        dest += dest_stride;
+        src += src_stride;
+        mask += mask_stride;
+    }
+}
+
+#if LV_PORT_DMA_FILL
+/*LVGL calls this before every blend and before flushing a buffer*/
+static void wait_for_finish(lv_draw_ctx_t *draw_ctx)
+{
+    lv_draw_sw_wait_for_finish(draw_ctx);
+    lv_port_dma_wait();
+}
+#endif
+
+void lv_port_blend_init_ctx(lv_disp_drv_t *disp_drv, lv_draw_ctx_t *draw_ctx)
+{
+    lv_draw_sw_init_ctx(disp_drv, draw_ctx);
+    ((lv_draw_sw_ctx_t *)draw_ctx)->blend = lv_port_blend;
+#if LV_PORT_DMA_FILL
+    draw_ctx->wait_for_finish = wait_for_finish;
+#endif
+#if LV_PORT_GLYPH_CACHE
+    draw_ctx->draw_letter = lv_port_glyph_draw_letter;
+#endif
+}
+
+void lv_port_blend(lv_draw_ctx_t *draw_ctx, const lv_draw_sw_blend_dsc_t *dsc)
+{
+    lv_disp_t *disp = _lv_refr_get_disp_refreshing();
+    if (dsc->blend_mode != LV_BLEND_MODE_NORMAL || disp->driver->set_px_cb || disp->driver->screen_transp ||
+        !disp->driver->antialiasing)
+    {
+        lv_draw_sw_blend_basic(draw_ctx, dsc);
+        return;
+    }
+
+    /*Same clipping and addressing as lv_draw_sw_blend_basic()*/
+    if (dsc->mask_buf && dsc->mask_res == LV_DRAW_MASK_RES_TRANSP)
+    {
+        return;
+    }
+    const lv_opa_t *mask = dsc->mask_res == LV_DRAW_MASK_RES_FULL_COVER ? NULL : dsc->mask_buf;
+
+    lv_area_t blend_area;
+    if (!_lv_area_intersect(&blend_area, dsc->blend_area, draw_ctx->clip_area))
+    {
+        return;
+    }
+    int32_t w = lv_area_get_width(&blend_area);
+    int32_t h = lv_area_get_height(&blend_area);
+
+    lv_coord_t dest_stride = lv_area_get_width(draw_ctx->buf_area);
+    lv_color_t *dest = (lv_color_t *)draw_ctx->buf + dest_stride * (blend_area.y1 - draw_ctx->buf_area->y1) +
+                       (blend_area.x1 - draw_ctx->buf_area->x1);
+
+    lv_coord_t mask_stride = 0;
+    if (mask)
+    {
+        mask_stride = lv_area_get_width(dsc->mask_area);
+        mask += mask_stride * (blend_area.y1 - dsc->mask_area->y1) + (blend_area.x1 - dsc->mask_area->x1);
+    }
+
+    if (dsc->src_buf == NULL)
+    {
+        if (mask == NULL && dsc->opa >= LV_OPA_MAX)
+        {
+#if LV_PORT_DMA_FILL
+            if (lv_port_dma_fill(dest, dest_stride, w, h, dsc->color))
+            {
+                return;
+            }
+#endif
+            for (int32_t y = 0; y < h; y++)
+            {
+                lv_color_fill(dest, dsc->color, w);
+                dest += dest_stride;
+            }
+        }
+        else if (mask == NULL)
+        {
+            fill_opa(dest, dest_stride, w, h, dsc->color, dsc->opa);
+        }
+        else if (dsc->opa >= LV_OPA_MAX)
+        {
+            fill_mask(dest, dest_stride, w, h, dsc->color, mask, mask_stride);
+        }
+        else
+        {
+            fill_mask_opa(dest, dest_stride, w, h, dsc->color, dsc->opa, mask, mask_stride);
+        }
+        return;
+    }
+
+    lv_coord_t src_stride = lv_area_get_width(dsc->blend_area);
+    const lv_color_t *src = dsc->src_buf + src_stride * (blend_area.y1 - dsc->blend_area->y1) +
+                            (blend_area.x1 - dsc->blend_area->x1);
+
+    /*The thresholds differ between LVGL's paths (>= for the plain copy, > with a mask); kept as they are*/
+    if (mask == NULL && dsc->opa >= LV_OPA_MAX)
+    {
+#if LV_PORT_DMA_FILL
+        if (lv_port_dma_copy(dest, dest_stride, src, src_stride, w, h))
+        {
+            return;
+        }
+#endif
+        for (int32_t y = 0; y < h; y++)
+        {
+            copy_row(dest, src, w);
+            dest += dest_stride;
+            src += src_stride;
+        }
+    }
+    else if (mask == NULL)
+    {
+        map_opa(dest, dest_stride, w, h, src, src_stride, dsc->opa);
+    }
+    else if (dsc->opa > LV_OPA_MAX)
+    {
+        map_mask(dest, dest_stride, w, h, src, src_stride, mask, mask_stride);
+    }
+    else
+    {
+        map_mask_opa(dest, dest_stride, w, h, src, src_stride, dsc->opa, mask, mask_stride);
+    }
+}
+
+/*-----------------
+ * Benchmark
+ *----------------*/
+
+#define BENCH_WIDTH 240
+#define BENCH_HEIGHT 40                     /*Half a draw buffer band*/
+#define BENCH_PIXELS (BENCH_WIDTH * BENCH_HEIGHT)
+#define BENCH_ROUNDS 16
+
+typedef struct
+{
+    const char *name;
+    bool map;
+    bool masked;
+    lv_opa_t opa;
+    uint8_t src_offset;                     /*Pixels, to put the source a halfword off the destination*/
+} bench_case_t;
+
+static const bench_case_t bench_cases[] = {
+    { "fill_opa", false, false, LV_OPA_50, 0 },         /*Translucent backgrounds*/
+    { "fill_mask", false, true, LV_OPA_COVER, 0 },      /*Glyphs, anti-aliased edges*/
+    { "fill_mask_opa", false, true, LV_OPA_70, 0 },
+    { "copy", true, false, LV_OPA_COVER, 0 },
+    { "copy_odd", true, false, LV_OPA_COVER, 1 },
+    { "map_opa", true, false, LV_OPA_50, 0 },           /*Fading layers*/
+    { "map_mask", true, true, LV_OPA_COVER, 0 },
+    { "map_mask_opa", true, true, LV_OPA_70, 0 },
+};
+
+/*Background in runs of 8 like a UI, a gradient-like source, a mask of clear, covered and edge stretches*/
+static void bench_patterns(lv_color_t *dest, lv_color_t *src, lv_opa_t *mask)
+{
+    uint32_t seed = 0x2545F491U;
+    for (uint32_t i = 0; i < BENCH_PIXELS; i++)
+    {
+        uint32_t x = i % BENCH_WIDTH;
+        uint32_t y = i / BENCH_WIDTH;
+        dest[i].full = (uint16_t)(((x / 8) * 0x0821U + y * 0x1003U) ^ 0x39E7U);
+        src[i].full = (uint16_t)(x * 0x0841U + y * 0x2005U);
+        if ((i & 3) == 0)
+        {
+            seed = seed * 1664525U + 1013904223U;
+        }
+        uint32_t kind = (seed >> 24) % 10;
+        mask[i] = kind < 4 ? LV_OPA_TRANSP : kind < 7 ? LV_OPA_COVER : (lv_opa_t)(seed >> (8 + (i & 3) * 4));
+    }
+    src[BENCH_PIXELS].full = 0xFFFF;
+}
+
+void lv_port_blend_benchmark(void)
+{
+    lv_color_t *dest = malloc(BENCH_PIXELS * sizeof(lv_color_t));
+    lv_color_t *expect = malloc(BENCH_PIXELS * sizeof(lv_color_t));
+    lv_color_t *pattern = malloc(BENCH_PIXELS * sizeof(lv_color_t));
+    lv_color_t *src = malloc((BENCH_PIXELS + 1) * sizeof(lv_color_t));
+    lv_opa_t *mask = malloc(BENCH_PIXELS);
+    if (!dest || !expect || !pattern || !src || !mask)
+    {
+        printf("BLEND out of memory\n");
+        free(dest);
+        free(expect);
+        free(pattern);
+        free(src);
+        free(mask);
+        return;
+    }
+    bench_patterns(pattern, src, mask);
+
+    /*The blend paths look up the display being refreshed*/
+    lv_disp_t *refreshing = _lv_refr_get_disp_refreshing();
+    _lv_refr_set_disp_refreshing(lv_disp_get_default());
+
+    lv_area_t area = { 0, 0, BENCH_WIDTH - 1, BENCH_HEIGHT - 1 };
+    lv_draw_sw_ctx_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.base_draw.buf = dest;
+    ctx.base_draw.buf_area = &area;
+    ctx.base_draw.clip_area = &area;
+
+    printf("BLEND simd=%d pixels=%d rounds=%d\n", LV_PORT_BLEND_SIMD, BENCH_PIXELS, BENCH_ROUNDS);
+    for (uint32_t c = 0; c < sizeof(bench_cases) / sizeof(bench_cases[0]); c++)
+    {
+        const bench_case_t *bc = &bench_cases[c];
+        lv_draw_sw_blend_dsc_t dsc;
+        memset(&dsc, 0, sizeof(dsc));
+        dsc.blend_area = &area;
+        dsc.mask_area = &area;
+        dsc.src_buf = bc->map ? src + bc->src_offset : NULL;
+        dsc.color = lv_color_hex(0x3FA34D);
+        dsc.mask_buf = bc->masked ? mask : NULL;
+        dsc.mask_res = bc->masked ? LV_DRAW_MASK_RES_CHANGED : LV_DRAW_MASK_RES_FULL_COVER;
+        dsc.opa = bc->opa;
+        dsc.blend_mode = LV_BLEND_MODE_NORMAL;
+
+        uint32_t us[2] = { 0, 0 };
+        for (uint32_t round = 0; round < BENCH_ROUNDS; round++)
+        {
+            for (uint32_t kernel = 0; kernel < 2; kernel++)
+            {
+                memcpy(dest, pattern, BENCH_PIXELS * sizeof(lv_color_t));
+                uint32_t start_us = time_us_32();
+                if (kernel == 0)
+                {
+                    lv_draw_sw_blend_basic(&ctx.base_draw, &dsc);
+                }
+                else
+                {
+                    lv_port_blend(&ctx.base_draw, &dsc);
+#if LV_PORT_DMA_FILL
+                    lv_port_dma_wait();
+#endif
+                }
+                us[kernel] += time_us_32() - start_us;
+                if (round == 0 && kernel == 0)
+                {
+                    memcpy(expect, dest, BENCH_PIXELS * sizeof(lv_color_t));
+                }
+            }
+        }
+        bool match = memcmp(expect, dest, BENCH_PIXELS * sizeof(lv_color_t)) == 0;
+        uint32_t ref_us = us[0] ? us[0] : 1;
+        uint32_t swar_us = us[1] ? us[1] : 1;
+        printf("BLEND case=%s ref_kpx_s=%lu swar_kpx_s=%lu speedup_x10=%lu match=%d\n", bc->name,
+               (uint32_t)((uint64_t)BENCH_PIXELS * BENCH_ROUNDS * 1000 / ref_us),
+               (uint32_t)((uint64_t)BENCH_PIXELS * BENCH_ROUNDS * 1000 / swar_us), ref_us * 10 / swar_us, match);
+    }
+
+    _lv_refr_set_disp_refreshing(refreshing);
+    free(dest);
+    free(expect);
+    free(pattern);
+    free(src);
+    free(mask);
+}
@@ -0,0 +1,43 @@
+#ifndef __LV_PORT_BLEND_H__
+#define __LV_PORT_BLEND_H__
+
+#include "lvgl.h"
+#include "src/draw/sw/lv_draw_sw.h"
+
+/*
+ * RGB565 blend backend for LVGL's software renderer.
+ *
+ * Replaces the draw context's blend callback for the normal blend mode and
+ * works on two pixels per 32-bit word: word loads and stores of the draw
+ * buffer, four mask bytes tested and converted at once, and the opacity fill
+ * done with both pixels' channels side by side in 16-bit lanes. Copies whose
+ * source and destination differ in halfword alignment are done with aligned
+ * word loads and a funnel shift instead of LVGL's byte loop.
+ *
+ * Results are bit-exact with lv_draw_sw_blend_basic(), quirks included (the
+ * rounded opacity of lv_color_mix, the premultiplied opacity fill). Anything
+ * else (other blend modes, set_px_cb, transparent screens, no anti-aliasing)
+ * goes to lv_draw_sw_blend_basic() unchanged.
+ */
+
+// Configuration
+#ifndef LV_PORT_BLEND_SWAR
+#define LV_PORT_BLEND_SWAR 1 // Install the two-pixels-per-word blend kernels
+#endif
+
+#if defined(__ARM_FEATURE_SIMD32) && __ARM_FEATURE_SIMD32
+#define LV_PORT_BLEND_SIMD 1 // Cortex-M33 DSP extension: byte and halfword lane instructions
+#else
+#define LV_PORT_BLEND_SIMD 0 // Portable C with the same results
+#endif
+
+// Draw context init for lv_disp_drv_t.draw_ctx_init: the software context with this blend
+void lv_port_blend_init_ctx(lv_disp_drv_t *disp_drv, lv_draw_ctx_t *draw_ctx);
+
+// LVGL's blend callback replacement (falls back to lv_draw_sw_blend_basic where it does not apply)
+void lv_port_blend(lv_draw_ctx_t *draw_ctx, const lv_draw_sw_blend_dsc_t *dsc);
+
+// Pixels per second of each blend path against LVGL's kernels, with an output comparison
+void lv_port_blend_benchmark(void);
+
+#endif // __LV_PORT_BLEND_H__
@@ -0,0 +1,278 @@
+#include "lv_port_dma.h"
+#include "lv_port_blend.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/dma.h"
+#include "hardware/sync.h"
+
+static struct
+{
+    int ctrl;                               /*Walks the row table, retriggering the data channel*/
+    int data;                               /*Moves one row per trigger*/
+    bool busy;                              /*Started and not waited for yet*/
+    uint32_t done_read_addr;                /*Control read address once it has read the null trigger*/
+    uint32_t min_pixels;
+    uint32_t fill_word;                     /*Fill colour twice: the fixed read address of fills*/
+    uint32_t rows[(LV_PORT_DMA_MAX_ROWS + 1) * 2]; /*{read, write} per row, then {0, 0}: a null trigger*/
+} dma = { .ctrl = -1, .data = -1, .min_pixels = LV_PORT_DMA_MIN_PIXELS };
+
+bool lv_port_dma_init(void)
+{
+    int ctrl = dma_claim_unused_channel(false);
+    int data = dma_claim_unused_channel(false);
+    if (ctrl < 0 || data < 0)
+    {
+        if (ctrl >= 0)
+        {
+            dma_channel_unclaim((uint)ctrl);
+        }
+        return false;
+    }
+    dma.ctrl = ctrl;
+    dma.data = data;
+
+    /*Two words per trigger into the data channel's READ_ADDR and WRITE_ADDR_TRIG, kept there by an 8-byte write ring*/
+    dma_channel_config config = dma_channel_get_default_config((uint)ctrl);
+    channel_config_set_transfer_data_size(&config, DMA_SIZE_32);
+    channel_config_set_read_increment(&config, true);
+    channel_config_set_write_increment(&config, true);
+    channel_config_set_ring(&config, true, 3);
+    dma_channel_configure((uint)ctrl, &config, &dma_hw->ch[data].al2_read_addr, dma.rows, 2, false);
+    return true;
+}
+
+void lv_port_dma_set_min_pixels(uint32_t pixels)
+{
+    dma.min_pixels = pixels;
+}
+
+void lv_port_dma_wait(void)
+{
+    if (!dma.busy)
+    {
+        return;
+    }
+    while (dma_channel_hw_addr((uint)dma.ctrl)->read_addr != dma.done_read_addr ||
+           dma_channel_is_busy((uint)dma.ctrl) || dma_channel_is_busy((uint)dma.data))
+    {
+        tight_loop_contents();
+    }
+    dma.busy = false;
+}
+
+/*The row table is filled in; run it*/
+static void start(uint32_t rows, uint32_t count, bool words, bool read_increment)
+{
+    dma.rows[rows * 2] = 0;
+    dma.rows[rows * 2 + 1] = 0;
+    dma.done_read_addr = (uint32_t)(uintptr_t)&dma.rows[rows * 2 + 2];
+
+    dma_channel_config config = dma_channel_get_default_config((uint)dma.data);
+    channel_config_set_transfer_data_size(&config, words ? DMA_SIZE_32 : DMA_SIZE_16);
+    channel_config_set_read_increment(&config, read_increment);
+    channel_config_set_write_increment(&config, true);
+    channel_config_set_chain_to(&config, (uint)dma.ctrl);
+    dma_channel_set_config((uint)dma.data, &config, false);
+    dma_channel_set_trans_count((uint)dma.data, words ? count / 2 : count, false);
+
+    dma.busy = true;
+    __dmb(); /*Table before the trigger*/
+    dma_channel_set_read_addr((uint)dma.ctrl, dma.rows, true);
+}
+
+bool lv_port_dma_fill(lv_color_t *dest, lv_coord_t dest_stride, int32_t w, int32_t h, lv_color_t color)
+{
+    uint32_t pixels = (uint32_t)(w * h);
+    bool contiguous = w == dest_stride;
+    if (dma.data < 0 || pixels < dma.min_pixels || (!contiguous && h > LV_PORT_DMA_MAX_ROWS))
+    {
+        return false;
+    }
+    lv_port_dma_wait();
+
+    uint32_t rows = contiguous ? 1 : (uint32_t)h;
+    uint32_t count = contiguous ? pixels : (uint32_t)w;
+    /*Word transfers if every row starts on a word and is whole words*/
+    bool words = ((uintptr_t)dest & 0x2) == 0 && (count & 1) == 0 && (contiguous || (dest_stride & 1) == 0);
+
+    dma.fill_word = color.full * 0x00010001U;
+    for (uint32_t row = 0; row < rows; row++)
+    {
+        dma.rows[row * 2] = (uint32_t)(uintptr_t)&dma.fill_word;
+        dma.rows[row * 2 + 1] = (uint32_t)(uintptr_t)(dest + row * dest_stride);
+    }
+    start(rows, count, words, false);
+    return true;
+}
+
+bool lv_port_dma_copy(lv_color_t *dest, lv_coord_t dest_stride, const lv_color_t *src, lv_coord_t src_stride,
+                      int32_t w, int32_t h)
+{
+    uint32_t pixels = (uint32_t)(w * h);
+    bool contiguous = w == dest_stride && w == src_stride;
+    if (dma.data < 0 || pixels < dma.min_pixels || (!contiguous && h > LV_PORT_DMA_MAX_ROWS))
+    {
+        return false;
+    }
+    lv_port_dma_wait();
+
+    uint32_t rows = contiguous ? 1 : (uint32_t)h;
+    uint32_t count = contiguous ? pixels : (uint32_t)w;
+    bool words = (((uintptr_t)dest | (uintptr_t)src) & 0x2) == 0 && (count & 1) == 0 &&
+                 (contiguous || ((dest_stride | src_stride) & 1) == 0);
+
+    for (uint32_t row = 0; row < rows; row++)
+    {
+        dma.rows[row * 2] = (uint32_t)(uintptr_t)(src + row * src_stride);
+        dma.rows[row * 2 + 1] = (uint32_t)(uintptr_t)(dest + row * dest_stride);
+    }
+    start(rows, count, words, true);
+    return true;
+}
+
+/*-----------------
+ * Benchmark
+ *----------------*/
+
+#define BENCH_WIDTH 240
+#define BENCH_HEIGHT 40
+#define BENCH_PIXELS (BENCH_WIDTH * BENCH_HEIGHT)
+#define BENCH_ROUNDS 16
+
+static const struct
+{
+    lv_coord_t w;
+    lv_coord_t h;
+} bench_sizes[] = { { 16, 8 }, { 32, 16 }, { 64, 16 }, { 96, 24 }, { 120, 40 }, { 240, 20 }, { 240, 40 } };
+
+/*Total microseconds of BENCH_ROUNDS blends; start_us is the time until the call returned*/
+static uint32_t bench_run(lv_draw_ctx_t *draw_ctx, const lv_draw_sw_blend_dsc_t *dsc, lv_color_t *dest,
+                          const lv_color_t *pattern, uint32_t *start_us)
+{
+    uint32_t total_us = 0;
+    *start_us = 0;
+    for (uint32_t round = 0; round < BENCH_ROUNDS; round++)
+    {
+        memcpy(dest, pattern, BENCH_PIXELS * sizeof(lv_color_t));
+        uint32_t t0 = time_us_32();
+        lv_port_blend(draw_ctx, dsc);
+        uint32_t t1 = time_us_32();
+        lv_port_dma_wait();
+        uint32_t t2 = time_us_32();
+        *start_us += t1 - t0;
+        total_us += t2 - t0;
+    }
+    return total_us;
+}
+
+void lv_port_dma_benchmark(void)
+{
+    if (dma.data < 0)
+    {
+        printf("DMA off\n");
+        return;
+    }
+    lv_color_t *dest = malloc(BENCH_PIXELS * sizeof(lv_color_t));
+    lv_color_t *expect = malloc(BENCH_PIXELS * sizeof(lv_color_t));
+    lv_color_t *pattern = malloc(BENCH_PIXELS * sizeof(lv_color_t));
+    lv_color_t *src = malloc((BENCH_PIXELS + 1) * sizeof(lv_color_t));
+    if (!dest || !expect || !pattern || !src)
+    {
+        printf("DMA out of memory\n");
+        free(dest);
+        free(expect);
+        free(pattern);
+        free(src);
+        return;
+    }
+    for (uint32_t i = 0; i < BENCH_PIXELS; i++)
+    {
+        pattern[i].full = (uint16_t)(i * 0x9E37U);
+        src[i].full = (uint16_t)(i * 0x0841U + 0x1234U);
+    }
+    src[BENCH_PIXELS].full = 0;
+
+    lv_disp_t *refreshing = _lv_refr_get_disp_refreshing();
+    _lv_refr_set_disp_refreshing(lv_disp_get_default());
+    uint32_t min_pixels = dma.min_pixels;
+
+    lv_area_t buf_area = { 0, 0, BENCH_WIDTH - 1, BENCH_HEIGHT - 1 };
+    lv_draw_sw_ctx_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.base_draw.buf = dest;
+    ctx.base_draw.buf_area = &buf_area;
+    ctx.base_draw.clip_area = &buf_area;
+
+    uint32_t crossover = 0;
+    bool all_match = true;
+    for (uint32_t s = 0; s < sizeof(bench_sizes) / sizeof(bench_sizes[0]); s++)
+    {
+        bool dma_wins = true;
+        for (uint32_t op = 0; op < 2; op++)
+        {
+            bool match = true;
+            uint32_t cpu_us = 0;
+            uint32_t start_us = 0;
+            uint32_t total_us = 0;
+            /*Timed at a word-aligned origin; checked there and a pixel off (halfword transfers)*/
+            for (lv_coord_t offset = 0; offset < 2; offset++)
+            {
+                lv_coord_t w = bench_sizes[s].w - (bench_sizes[s].w == BENCH_WIDTH ? offset : 0);
+                lv_area_t area = { offset, 0, offset + w - 1, bench_sizes[s].h - 1 };
+                lv_draw_sw_blend_dsc_t dsc;
+                memset(&dsc, 0, sizeof(dsc));
+                dsc.blend_area = &area;
+                dsc.src_buf = op ? src + offset : NULL;
+                dsc.color = lv_color_hex(0x1E1E1E);
+                dsc.mask_res = LV_DRAW_MASK_RES_FULL_COVER;
+                dsc.opa = LV_OPA_COVER;
+                dsc.blend_mode = LV_BLEND_MODE_NORMAL;
+
+                uint32_t unused_us;
+                dma.min_pixels = UINT32_MAX;
+                uint32_t cpu = bench_run(&ctx.base_draw, &dsc, dest, pattern, &unused_us);
+                memcpy(expect, dest, BENCH_PIXELS * sizeof(lv_color_t));
+                dma.min_pixels = 0;
+                uint32_t start = 0;
+                uint32_t total = bench_run(&ctx.base_draw, &dsc, dest, pattern, &start);
+                match = match && memcmp(expect, dest, BENCH_PIXELS * sizeof(lv_color_t)) == 0;
+                if (offset == 0)
+                {
+                    cpu_us = cpu;
+                    start_us = start;
+                    total_us = total;
+                }
+            }
+            all_match = all_match && match;
+            dma_wins = dma_wins && total_us <= cpu_us;
+            printf("DMA op=%s px=%lu cpu_ns=%lu dma_start_ns=%lu dma_total_ns=%lu match=%d\n", op ? "copy" : "fill",
+                   (uint32_t)(bench_sizes[s].w * bench_sizes[s].h), cpu_us * 1000 / BENCH_ROUNDS,
+                   start_us * 1000 / BENCH_ROUNDS, total_us * 1000 / BENCH_ROUNDS, match);
+        }
+        if (!dma_wins)
+        {
+            crossover = 0;
+        }
+        else if (crossover == 0)
+        {
+            crossover = (uint32_t)(bench_sizes[s].w * bench_sizes[s].h);
+        }
+    }
+    if (crossover)
+    {
+        printf("DMA min_px=%lu suggested_min_px=%lu match=%d\n", min_pixels, crossover, all_match);
+    }
+    else
+    {
+        printf("DMA min_px=%lu suggested_min_px=none match=%d\n", min_pixels, all_match);
+    }
+
+    dma.min_pixels = min_pixels;
+    _lv_refr_set_disp_refreshing(refreshing);
+    free(dest);
+    free(expect);
+    free(pattern);
+    free(src);
+}
@@ -0,0 +1,44 @@
+#ifndef __LV_PORT_DMA_H__
+#define __LV_PORT_DMA_H__
+
+#include "lvgl.h"
+
+/*
+ * Draw buffer fills and copies on a spare DMA channel pair.
+ *
+ * Large opaque solid fills (screen and panel backgrounds) and large opaque
+ * copies (images, layers) are handed to DMA instead of CPU store loops. A
+ * control channel walks a table of per-row {read, write} addresses and
+ * retriggers the data channel for each row, so a rectangle inside the draw
+ * buffer is one request; a fill reads its colour from one fixed address.
+ * The call returns as soon as the transfer is started and LVGL keeps
+ * rasterising (building masks, laying out text) until its next blend or
+ * the flush, which wait for the DMA through the draw context's
+ * wait_for_finish.
+ */
+
+// Configuration
+#ifndef LV_PORT_DMA_FILL
+#define LV_PORT_DMA_FILL 1 // Hand large fills and copies to DMA
+#endif
+#define LV_PORT_DMA_MIN_PIXELS 1024 // Default threshold: smaller areas stay on the CPU (tune with the 'G' benchmark)
+#define LV_PORT_DMA_MAX_ROWS 80     // Row table size: a draw buffer band; taller areas stay on the CPU
+
+// Claim the channels; without them every request falls back to the CPU
+bool lv_port_dma_init(void);
+
+// Start a fill or copy of a w x h area; false if the caller must do it (too small, too tall, no channels)
+bool lv_port_dma_fill(lv_color_t *dest, lv_coord_t dest_stride, int32_t w, int32_t h, lv_color_t color);
+bool lv_port_dma_copy(lv_color_t *dest, lv_coord_t dest_stride, const lv_color_t *src, lv_coord_t src_stride,
+                      int32_t w, int32_t h);
+
+// Smallest area handed to DMA, in pixels
+void lv_port_dma_set_min_pixels(uint32_t pixels);
+
+// Block until the last fill or copy has landed
+void lv_port_dma_wait(void);
+
+// CPU against DMA time per area size, with an output comparison and the crossover size
+void lv_port_dma_benchmark(void);
+
+#endif // __LV_PORT_DMA_H__
@@ -0,0 +1,221 @@
+#include "lv_port_frame.h"
+#include "lv_port.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "src/draw/sw/lv_draw_sw.h"
+
+typedef struct
+{
+    lv_obj_t *scr;                          /*NULL: free slot*/
+    lv_color_t *frame;                      /*The whole display, row by row*/
+    bool rendered;                          /*frame holds the screen, apart from the dirty area*/
+    bool has_dirty;
+    lv_area_t dirty;                        /*Invalidated since it was rendered into frame (bounding box)*/
+    uint32_t clean;                         /*Loads pushed as they were*/
+    uint32_t partial;                       /*Loads with the dirty area rendered first*/
+    uint32_t full;                          /*Loads rendered completely (the first one)*/
+    uint32_t refused;                       /*Loaded by LVGL instead (animation running, layers in use)*/
+    uint32_t render_us;                     /*Last load: rendering into frame*/
+    uint32_t push_us;                       /*Last load: pushing frame to the panel*/
+} retained_t;
+
+static retained_t retained[LV_PORT_FRAME_SCREENS];
+static uint32_t retained_count;             /*Slots in use: the invalidate callback returns at once without*/
+static retained_t *loading;                 /*Being loaded by lv_port_frame_load()*/
+static uint32_t loading_scr_invalidations;  /*Of the screen object itself during that load; the last is the load's own*/
+
+static retained_t *find(const lv_obj_t *scr)
+{
+    for (uint32_t i = 0; i < LV_PORT_FRAME_SCREENS; i++)
+    {
+        if (retained[i].scr == scr)
+        {
+            return &retained[i];
+        }
+    }
+    return NULL;
+}
+
+static void scr_delete_cb(lv_event_t *e)
+{
+    retained_t *r = find(lv_event_get_target(e));
+    if (r)
+    {
+        free(r->frame);
+        memset(r, 0, sizeof(*r));
+        retained_count--;
+    }
+}
+
+bool lv_port_frame_retain(lv_obj_t *scr)
+{
+#if LV_PORT_FRAME_CACHE
+    if (find(scr))
+    {
+        return true;
+    }
+    retained_t *r = find(NULL);
+    lv_disp_t *disp = lv_obj_get_disp(scr);
+    if (!r || !disp)
+    {
+        return false;
+    }
+    uint32_t pixels = (uint32_t)lv_disp_get_hor_res(disp) * (uint32_t)lv_disp_get_ver_res(disp);
+    r->frame = malloc(pixels * sizeof(lv_color_t));
+    if (!r->frame)
+    {
+        return false;
+    }
+    r->scr = scr;
+    retained_count++;
+    lv_obj_set_pos(scr, 0, 0); /*Where screen loads put it; set once here, they do not invalidate it*/
+    lv_obj_add_event_cb(scr, scr_delete_cb, LV_EVENT_DELETE, NULL);
+    return true;
+#else
+    LV_UNUSED(scr);
+    return false;
+#endif
+}
+
+void lv_port_frame_invalidate_cb(lv_disp_drv_t *disp_drv, const lv_obj_t *obj, const lv_area_t *area)
+{
+    LV_UNUSED(disp_drv);
+    if (retained_count == 0)
+    {
+        return;
+    }
+    retained_t *r = find(lv_obj_get_screen(obj));
+    if (r && r == loading && obj == r->scr)
+    {
+        loading_scr_invalidations++;
+        return;
+    }
+    lv_area_t clipped;
+    if (!r || !r->rendered || !_lv_area_intersect(&clipped, area, &r->scr->coords))
+    {
+        return;
+    }
+    if (r->has_dirty)
+    {
+        _lv_area_join(&r->dirty, &r->dirty, &clipped);
+    }
+    else
+    {
+        r->dirty = clipped;
+        r->has_dirty = true;
+    }
+}
+
+/*Draw the screen over area of the copy, the way a refresh of the display would*/
+static void render(retained_t *r, lv_disp_t *disp, const lv_area_t *area)
+{
+    lv_area_t buf_area = { 0, 0, lv_disp_get_hor_res(disp) - 1, lv_disp_get_ver_res(disp) - 1 };
+    lv_area_t clip_area = *area;
+
+    lv_disp_t *refreshing = _lv_refr_get_disp_refreshing();
+    _lv_refr_set_disp_refreshing(disp);
+
+    lv_draw_sw_ctx_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    disp->driver->draw_ctx_init(disp->driver, &ctx.base_draw);
+    ctx.base_draw.buf = r->frame;
+    ctx.base_draw.buf_area = &buf_area;
+    ctx.base_draw.clip_area = &clip_area;
+
+    /*A screen that does not cover the display shows the display's background (its colour only)*/
+    if (lv_obj_get_style_bg_opa(r->scr, LV_PART_MAIN) < LV_OPA_COVER)
+    {
+        lv_draw_rect_dsc_t bg;
+        lv_draw_rect_dsc_init(&bg);
+        bg.bg_color = disp->bg_color;
+        bg.bg_opa = disp->bg_opa;
+        lv_draw_rect(&ctx.base_draw, &bg, &clip_area);
+    }
+    lv_obj_redraw(&ctx.base_draw, r->scr);
+    if (ctx.base_draw.wait_for_finish)
+    {
+        ctx.base_draw.wait_for_finish(&ctx.base_draw);
+    }
+
+    if (disp->driver->draw_ctx_deinit)
+    {
+        disp->driver->draw_ctx_deinit(disp->driver, &ctx.base_draw);
+    }
+    _lv_refr_set_disp_refreshing(refreshing);
+}
+
+bool lv_port_frame_load(lv_obj_t *scr)
+{
+    retained_t *r = find(scr);
+    lv_disp_t *disp = lv_obj_get_disp(scr);
+    if (!r || !disp || lv_disp_get_scr_act(disp) == scr)
+    {
+        return false;
+    }
+    if (disp->scr_to_load || disp->prev_scr || lv_obj_get_child_cnt(lv_disp_get_layer_top(disp)) ||
+        lv_obj_get_child_cnt(lv_disp_get_layer_sys(disp)))
+    {
+        r->refused++;
+        return false;
+    }
+
+    uint32_t start_us = time_us_32();
+    lv_obj_update_layout(scr); /*May invalidate what moved*/
+    lv_area_t full = { 0, 0, lv_disp_get_hor_res(disp) - 1, lv_disp_get_ver_res(disp) - 1 };
+    if (!r->rendered)
+    {
+        render(r, disp, &full);
+        r->rendered = true;
+        r->full++;
+    }
+    else if (r->has_dirty)
+    {
+        render(r, disp, &r->dirty);
+        r->partial++;
+    }
+    else
+    {
+        r->clean++;
+    }
+    r->has_dirty = false;
+    uint32_t rendered_us = time_us_32();
+    r->render_us = rendered_us - start_us;
+
+    lv_port_push(&full, r->frame);
+    r->push_us = time_us_32() - rendered_us;
+
+    /*The panel shows the screen already; anything invalidated by the load events is redrawn by LVGL*/
+    loading = r;
+    loading_scr_invalidations = 0;
+    lv_disp_enable_invalidation(disp, false);
+    lv_scr_load(scr);
+    lv_disp_enable_invalidation(disp, true);
+    loading = NULL;
+    if (loading_scr_invalidations > 1)
+    {
+        lv_port_frame_invalidate_cb(disp->driver, scr, &scr->coords);
+    }
+    if (r->has_dirty)
+    {
+        lv_obj_invalidate_area(scr, &r->dirty);
+    }
+    return true;
+}
+
+void lv_port_frame_dump(void)
+{
+    for (uint32_t i = 0; i < LV_PORT_FRAME_SCREENS; i++)
+    {
+        const retained_t *r = &retained[i];
+        if (!r->scr)
+        {
+            continue;
+        }
+        printf("FRAME slot=%lu clean=%lu partial=%lu full=%lu refused=%lu render_us=%lu push_us=%lu dirty_px=%lu\n", i,
+               r->clean, r->partial, r->full, r->refused, r->render_us, r->push_us,
+               r->has_dirty ? (uint32_t)lv_area_get_size(&r->dirty) : 0);
+    }
+    printf("FRAME retained=%lu slots=%d\n", retained_count, LV_PORT_FRAME_SCREENS);
+}
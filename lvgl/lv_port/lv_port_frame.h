@@ -0,0 +1,40 @@
+#ifndef __LV_PORT_FRAME_H__
+#define __LV_PORT_FRAME_H__
+
+#include "lvgl.h"
+
+/*
+ * Retained screens.
+ *
+ * A screen that hardly ever changes (the main menu) is re-rendered in full
+ * by LVGL every time it is loaded. A retained screen instead keeps a copy of
+ * its pixels, one full frame in RAM, rendered offscreen the first time it is
+ * shown. Every area invalidated on its objects afterwards, while it is shown
+ * or not, is collected through the display driver's invalidate_cb; the next
+ * time the screen is loaded only that area is rendered into the copy before
+ * the whole frame is pushed to the panel, and LVGL is told nothing needs
+ * drawing. Retained screens therefore appear at once, without the fade.
+ *
+ * The copy holds the screen alone: while a screen load animation runs or the
+ * top or system layer has children, the screen is loaded the usual way.
+ */
+
+// Configuration
+#ifndef LV_PORT_FRAME_CACHE
+#define LV_PORT_FRAME_CACHE 1 // Keep copies of retained screens (installs the invalidate callback)
+#endif
+#define LV_PORT_FRAME_SCREENS 1 // Retained screens: 150 KB each at 240x320 RGB565
+
+// Keep a copy of scr from now on; false if every slot is taken, memory is short or the cache is off
+bool lv_port_frame_retain(lv_obj_t *scr);
+
+// Load scr from its copy and push it to the panel; false if scr is not retained or cannot be loaded that way now
+bool lv_port_frame_load(lv_obj_t *scr);
+
+// lv_disp_drv_t.invalidate_cb: collects the areas that are out of date in the copies
+void lv_port_frame_invalidate_cb(lv_disp_drv_t *disp_drv, const lv_obj_t *obj, const lv_area_t *area);
+
+// Loads from the copies: untouched, partly re-rendered, fully rendered, refused, with the last timings
+void lv_port_frame_dump(void);
+
+#endif // __LV_PORT_FRAME_H__
@@ -0,0 +1,342 @@
+#include "lv_port_glyph.h"
+#include "lv_port_blend.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "src/draw/sw/lv_draw_sw.h"
+
+#if LV_PORT_GLYPH_SLOTS > 255
+#error "LV_PORT_GLYPH_SLOTS must fit the byte-sized ASCII table entries"
+#endif
+
+#define ASCII_FIRST 0x20
+#define ASCII_COUNT 95
+
+typedef struct
+{
+    const lv_font_t *font;                  /*Font drawn with; the glyph itself may come from a fallback*/
+    uint32_t letter;
+    uint32_t last_use;                      /*LRU stamp, 0: free slot*/
+    lv_font_glyph_dsc_t dsc;                /*bpp 8: the bitmap is one opacity byte per pixel*/
+} glyph_slot_t;
+
+static struct
+{
+    glyph_slot_t slots[LV_PORT_GLYPH_SLOTS];
+    uint8_t bitmaps[LV_PORT_GLYPH_SLOTS][LV_PORT_GLYPH_SLOT_BYTES];
+    const lv_font_t *ascii_fonts[LV_PORT_GLYPH_ASCII_FONTS];
+    uint8_t ascii[LV_PORT_GLYPH_ASCII_FONTS][ASCII_COUNT]; /*Slot index + 1, 0: not cached*/
+    uint32_t clock;
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t uncached;
+    const glyph_slot_t *drawing;            /*What the stand-in font answers with*/
+} cache;
+
+/*-----------------
+ * Stand-in font
+ *----------------*/
+
+static bool proxy_glyph_dsc(const lv_font_t *font, lv_font_glyph_dsc_t *dsc_out, uint32_t letter,
+                            uint32_t letter_next)
+{
+    LV_UNUSED(font);
+    LV_UNUSED(letter);
+    LV_UNUSED(letter_next);
+    *dsc_out = cache.drawing->dsc;
+    return true;
+}
+
+static const uint8_t *proxy_glyph_bitmap(const lv_font_t *font, uint32_t letter)
+{
+    LV_UNUSED(font);
+    LV_UNUSED(letter);
+    return cache.bitmaps[cache.drawing - cache.slots];
+}
+
+static lv_font_t proxy = {
+    .get_glyph_dsc = proxy_glyph_dsc,
+    .get_glyph_bitmap = proxy_glyph_bitmap,
+    .subpx = LV_FONT_SUBPX_NONE,
+};
+
+/*-----------------
+ * Lookup
+ *----------------*/
+
+/*The direct-mapped entry of an ASCII glyph, NULL if the letter is not ASCII or every table is taken*/
+static uint8_t *ascii_entry(const lv_font_t *font, uint32_t letter)
+{
+    if (letter - ASCII_FIRST >= ASCII_COUNT)
+    {
+        return NULL;
+    }
+    for (uint32_t f = 0; f < LV_PORT_GLYPH_ASCII_FONTS; f++)
+    {
+        if (cache.ascii_fonts[f] == NULL)
+        {
+            cache.ascii_fonts[f] = font;
+        }
+        if (cache.ascii_fonts[f] == font)
+        {
+            return &cache.ascii[f][letter - ASCII_FIRST];
+        }
+    }
+    return NULL;
+}
+
+static glyph_slot_t *lookup(const lv_font_t *font, uint32_t letter, const uint8_t *entry)
+{
+    if (entry)
+    {
+        /*Every ASCII glyph of the font is entered here when cached, so an empty or stale entry is a miss*/
+        glyph_slot_t *slot = *entry ? &cache.slots[*entry - 1] : NULL;
+        return slot && slot->font == font && slot->letter == letter ? slot : NULL;
+    }
+    for (uint32_t i = 0; i < LV_PORT_GLYPH_SLOTS; i++)
+    {
+        glyph_slot_t *slot = &cache.slots[i];
+        if (slot->last_use && slot->font == font && slot->letter == letter)
+        {
+            return slot;
+        }
+    }
+    return NULL;
+}
+
+/*Look the glyph up in the font and expand its bitmap into the least recently used slot; NULL if not cacheable*/
+static glyph_slot_t *insert(const lv_font_t *font, uint32_t letter, uint8_t *entry)
+{
+    lv_font_glyph_dsc_t g;
+    if (!lv_font_get_glyph_dsc(font, &g, letter, '\0') || g.is_placeholder ||
+        g.resolved_font->subpx != LV_FONT_SUBPX_NONE)
+    {
+        return NULL;
+    }
+    uint32_t bpp = g.bpp == 3 ? 4 : g.bpp; /*As the letter renderer reads it*/
+    uint32_t pixels = (uint32_t)g.box_w * g.box_h;
+    if ((bpp != 1 && bpp != 2 && bpp != 4 && bpp != 8) || pixels > LV_PORT_GLYPH_SLOT_BYTES)
+    {
+        return NULL;
+    }
+    const uint8_t *map = NULL;
+    if (pixels)
+    {
+        map = lv_font_get_glyph_bitmap(g.resolved_font, letter);
+        if (map == NULL)
+        {
+            return NULL;
+        }
+    }
+
+    glyph_slot_t *slot = &cache.slots[0];
+    for (uint32_t i = 1; i < LV_PORT_GLYPH_SLOTS && slot->last_use; i++)
+    {
+        if (cache.slots[i].last_use < slot->last_use)
+        {
+            slot = &cache.slots[i];
+        }
+    }
+
+    /*Rows are packed back to back, most significant bits first; shades scale to 0..255 like LVGL's bpp tables*/
+    uint8_t *bitmap = cache.bitmaps[slot - cache.slots];
+    uint32_t max = (1U << bpp) - 1;
+    uint32_t scale = 255 / max;
+    for (uint32_t i = 0; i < pixels; i++)
+    {
+        uint32_t bit = i * bpp;
+        bitmap[i] = (uint8_t)(((map[bit >> 3] >> (8 - bpp - (bit & 7))) & max) * scale);
+    }
+
+    g.bpp = 8;
+    slot->font = font;
+    slot->letter = letter;
+    slot->dsc = g;
+    if (entry)
+    {
+        *entry = (uint8_t)(slot - cache.slots + 1);
+    }
+    return slot;
+}
+
+void lv_port_glyph_draw_letter(lv_draw_ctx_t *draw_ctx, const lv_draw_label_dsc_t *dsc, const lv_point_t *pos_p,
+                               uint32_t letter)
+{
+    uint8_t *entry = ascii_entry(dsc->font, letter);
+    glyph_slot_t *slot = lookup(dsc->font, letter, entry);
+    if (slot)
+    {
+        cache.hits++;
+    }
+    else
+    {
+        slot = insert(dsc->font, letter, entry);
+        if (slot == NULL)
+        {
+            cache.uncached++;
+            lv_draw_sw_letter(draw_ctx, dsc, pos_p, letter);
+            return;
+        }
+        cache.misses++;
+    }
+    slot->last_use = ++cache.clock;
+
+    /*Spaces*/
+    if (slot->dsc.box_w == 0 || slot->dsc.box_h == 0)
+    {
+        return;
+    }
+
+    /*Opaque text with no mask active (clip corners): the bitmap is the blend mask as it is, one blend per glyph*/
+    lv_disp_t *disp = _lv_refr_get_disp_refreshing();
+    if (dsc->opa >= LV_OPA_MAX && disp->driver->antialiasing && !lv_draw_mask_is_any(NULL))
+    {
+        /*Placed like lv_draw_sw_letter() does, by the font the label is drawn with*/
+        lv_area_t area;
+        area.x1 = pos_p->x + slot->dsc.ofs_x;
+        area.y1 = pos_p->y + (dsc->font->line_height - dsc->font->base_line) - slot->dsc.box_h - slot->dsc.ofs_y;
+        area.x2 = area.x1 + slot->dsc.box_w - 1;
+        area.y2 = area.y1 + slot->dsc.box_h - 1;
+
+        lv_draw_sw_blend_dsc_t blend_dsc;
+        memset(&blend_dsc, 0, sizeof(blend_dsc));
+        blend_dsc.blend_area = &area;
+        blend_dsc.mask_area = &area;
+        blend_dsc.mask_buf = cache.bitmaps[slot - cache.slots];
+        blend_dsc.mask_res = LV_DRAW_MASK_RES_CHANGED;
+        blend_dsc.color = dsc->color;
+        blend_dsc.opa = dsc->opa;
+        blend_dsc.blend_mode = dsc->blend_mode;
+        lv_draw_sw_blend(draw_ctx, &blend_dsc);
+        return;
+    }
+
+    /*Otherwise LVGL's letter renderer builds the mask row by row, from the slot*/
+    proxy.line_height = dsc->font->line_height;
+    proxy.base_line = dsc->font->base_line;
+    lv_draw_label_dsc_t proxied = *dsc;
+    proxied.font = &proxy;
+    cache.drawing = slot;
+    lv_draw_sw_letter(draw_ctx, &proxied, pos_p, letter);
+}
+
+void lv_port_glyph_flush(void)
+{
+    memset(cache.slots, 0, sizeof(cache.slots));
+    memset(cache.ascii_fonts, 0, sizeof(cache.ascii_fonts));
+    memset(cache.ascii, 0, sizeof(cache.ascii));
+    cache.clock = 0;
+}
+
+/*-----------------
+ * Benchmark
+ *----------------*/
+
+#define BENCH_WIDTH 240
+#define BENCH_HEIGHT 80
+#define BENCH_PIXELS (BENCH_WIDTH * BENCH_HEIGHT)
+#define BENCH_ROUNDS 16
+#define BENCH_TEXTS 4
+
+/*What the screens redraw: the step counter, the lock screen clock and date, roller options*/
+static void bench_texts(uint32_t round, char text[BENCH_TEXTS][32])
+{
+    snprintf(text[0], 32, "Current Steps: %lu", 12000 + round * 137);
+    snprintf(text[1], 32, "%02lu:%02lu:%02lu", 9 + round / 8, (round * 7) % 60, (round * 13) % 60);
+    snprintf(text[2], 32, "Sun, Oct %lu 2026", 1 + round % 28);
+    snprintf(text[3], 32, "%lu min\n%lu min\n%lu min", 5 + round % 3, 15 + round % 3, 30 + round % 3);
+}
+
+static const struct
+{
+    const lv_font_t *font;
+    lv_area_t area;
+} bench_layout[BENCH_TEXTS] = {
+    { &lv_font_montserrat_16, { 0, 0, 239, 17 } },
+    { &lv_font_montserrat_16, { 0, 20, 119, 37 } },
+    { &lv_font_montserrat_14, { 0, 40, 119, 57 } },
+    { &lv_font_montserrat_14, { 120, 20, 239, 79 } },
+};
+
+static uint32_t bench_draw(lv_draw_ctx_t *draw_ctx, lv_color_t *dest, char text[BENCH_TEXTS][32])
+{
+    for (uint32_t i = 0; i < BENCH_PIXELS; i++)
+    {
+        dest[i] = lv_color_hex(0x1E1E1E);
+    }
+    draw_ctx->buf = dest;
+
+    uint32_t start_us = time_us_32();
+    for (uint32_t t = 0; t < BENCH_TEXTS; t++)
+    {
+        lv_draw_label_dsc_t dsc;
+        lv_draw_label_dsc_init(&dsc);
+        dsc.font = bench_layout[t].font;
+        dsc.color = lv_color_white();
+        lv_draw_label(draw_ctx, &dsc, &bench_layout[t].area, text[t], NULL);
+    }
+    return time_us_32() - start_us;
+}
+
+void lv_port_glyph_benchmark(void)
+{
+    uint32_t lookups = cache.hits + cache.misses + cache.uncached;
+    printf("GLYPH slots=%d slot_bytes=%d hits=%lu misses=%lu uncached=%lu hit_pct=%lu\n", LV_PORT_GLYPH_SLOTS,
+           LV_PORT_GLYPH_SLOT_BYTES, cache.hits, cache.misses, cache.uncached,
+           lookups ? cache.hits * 100 / lookups : 0);
+
+    lv_color_t *dest = malloc(BENCH_PIXELS * sizeof(lv_color_t));
+    lv_color_t *expect = malloc(BENCH_PIXELS * sizeof(lv_color_t));
+    if (!dest || !expect)
+    {
+        printf("GLYPH out of memory\n");
+        free(dest);
+        free(expect);
+        return;
+    }
+
+    /*The letter renderer looks up the display being refreshed*/
+    lv_disp_t *refreshing = _lv_refr_get_disp_refreshing();
+    lv_disp_t *disp = lv_disp_get_default();
+    _lv_refr_set_disp_refreshing(disp);
+
+    lv_area_t area = { 0, 0, BENCH_WIDTH - 1, BENCH_HEIGHT - 1 };
+    lv_draw_sw_ctx_t ctx;
+    lv_port_blend_init_ctx(disp->driver, &ctx.base_draw);
+    ctx.base_draw.buf_area = &area;
+    ctx.base_draw.clip_area = &area;
+
+    /*Start cold: the first round pays for the misses*/
+    lv_port_glyph_flush();
+    uint32_t hits = cache.hits;
+    uint32_t misses = cache.misses;
+    uint32_t uncached = cache.uncached;
+    uint32_t ref_us = 0;
+    uint32_t cached_us = 0;
+    uint32_t cold_us = 0;
+    bool match = true;
+    for (uint32_t round = 0; round < BENCH_ROUNDS; round++)
+    {
+        char text[BENCH_TEXTS][32];
+        bench_texts(round, text);
+        ctx.base_draw.draw_letter = lv_draw_sw_letter;
+        ref_us += bench_draw(&ctx.base_draw, expect, text);
+        ctx.base_draw.draw_letter = lv_port_glyph_draw_letter;
+        uint32_t us = bench_draw(&ctx.base_draw, dest, text);
+        cached_us += us;
+        cold_us = round == 0 ? us : cold_us;
+        match = match && memcmp(expect, dest, BENCH_PIXELS * sizeof(lv_color_t)) == 0;
+    }
+    hits = cache.hits - hits;
+    lookups = hits + (cache.misses - misses) + (cache.uncached - uncached);
+    ref_us = ref_us ? ref_us : 1;
+    cached_us = cached_us ? cached_us : 1;
+    printf("GLYPH texts=%d rounds=%d ref_us=%lu cached_us=%lu cold_us=%lu speedup_x10=%lu hit_pct=%lu match=%d\n",
+           BENCH_TEXTS, BENCH_ROUNDS, ref_us / BENCH_ROUNDS, cached_us / BENCH_ROUNDS, cold_us,
+           ref_us * 10 / cached_us, lookups ? hits * 100 / lookups : 0, match);
+
+    _lv_refr_set_disp_refreshing(refreshing);
+    free(dest);
+    free(expect);
+}
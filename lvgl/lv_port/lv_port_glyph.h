@@ -0,0 +1,45 @@
+#ifndef __LV_PORT_GLYPH_H__
+#define __LV_PORT_GLYPH_H__
+
+#include "lvgl.h"
+
+/*
+ * Glyph cache for the draw context's letter callback.
+ *
+ * Every drawn letter normally costs a cmap search in lv_font_fmt_txt.c and
+ * an unpacking of its 4 bpp bitmap, nibble by nibble, in the letter
+ * renderer. The screens redraw the same few glyphs all the time (step
+ * counters, the lock screen clock, roller options), so the descriptor and
+ * the bitmap, expanded once to one opacity byte per pixel, are kept in a
+ * fixed pool of slots keyed by font and codepoint (the font pointer carries
+ * the size). The least recently drawn glyph is replaced on a miss; ASCII
+ * glyphs of the first few fonts are found through a direct-mapped table,
+ * others by a scan of the slots.
+ *
+ * Opaque text is then a single blend per glyph with the cached bitmap as
+ * the mask, where LVGL builds the mask pixel by pixel. Translucent text or
+ * text under a clip mask goes through lv_draw_sw_letter() with a stand-in
+ * font that answers from the slot. Either way the pixels are identical to
+ * LVGL's. Glyphs larger than a slot, sub-pixel fonts and missing glyphs
+ * (placeholders) are drawn uncached.
+ */
+
+// Configuration
+#ifndef LV_PORT_GLYPH_CACHE
+#define LV_PORT_GLYPH_CACHE 1 // Install the glyph cache in the draw context
+#endif
+#define LV_PORT_GLYPH_SLOTS 64        // Cached glyphs (at most 255)
+#define LV_PORT_GLYPH_SLOT_BYTES 256  // Largest cached bitmap: box_w * box_h (every ASCII glyph up to 16 px)
+#define LV_PORT_GLYPH_ASCII_FONTS 4   // Fonts with a direct-mapped ASCII table
+
+// lv_draw_ctx_t.draw_letter replacement
+void lv_port_glyph_draw_letter(lv_draw_ctx_t *draw_ctx, const lv_draw_label_dsc_t *dsc, const lv_point_t *pos_p,
+                               uint32_t letter);
+
+// Drop every cached glyph (required before freeing a font loaded at run time)
+void lv_port_glyph_flush(void);
+
+// Hit rate since boot, then text rendering time cached against uncached, with an output comparison
+void lv_port_glyph_benchmark(void);
+
+#endif // __LV_PORT_GLYPH_H__
@@ -0,0 +1,241 @@
+/**
+ * History Downsampling Implementation
+ */
+
+#include "history_lttb.h"
+#include <string.h>
+
+static inline uint32_t bucket_start(const history_lttb_t* lttb, uint16_t index) {
+    // Cache index 0 is the bucket before the window
+    return (lttb->first + index - 1) * lttb->bucket_seconds;
+}
+
+static void clear_buckets(history_lttb_t* lttb, uint16_t a, uint16_t b) {
+    memset(&lttb->cache[a], 0, (b - a + 1) * sizeof(lttb->cache[0]));
+}
+
+static void finish_summary(history_lttb_bucket_t* bucket, int64_t time_sum, int64_t value_sum, uint32_t origin) {
+    if (bucket->count == 0) {
+        return;
+    }
+    bucket->valid = true;
+    bucket->avg_time = origin + (uint32_t)(time_sum / bucket->count);
+    bucket->avg_value = (int32_t)(value_sum / bucket->count);
+}
+
+// Pass 1: averages of cache buckets a..b
+static void summarize(history_lttb_t* lttb, uint16_t a, uint16_t b) {
+    clear_buckets(lttb, a, b);
+    uint32_t from = bucket_start(lttb, a);
+    uint32_t to = bucket_start(lttb, b + 1) - 1;
+    lttb->source->open(lttb->source->ctx, from, to);
+
+    // Points arrive in time order, so one bucket is summed at a time
+    int32_t current = -1;
+    int64_t time_sum = 0;
+    int64_t value_sum = 0;
+    uint32_t time;
+    int32_t value;
+    while (lttb->source->next(lttb->source->ctx, &time, &value)) {
+        if (time < from || time > to) {
+            continue;
+        }
+        int32_t index = (int32_t)((time - from) / lttb->bucket_seconds) + a;
+        if (index != current) {
+            if (current >= 0) {
+                finish_summary(&lttb->cache[current], time_sum, value_sum, bucket_start(lttb, (uint16_t)current));
+            }
+            current = index;
+            time_sum = 0;
+            value_sum = 0;
+            lttb->cache[current].count = 0;
+        }
+        history_lttb_bucket_t* bucket = &lttb->cache[current];
+        if (bucket->count < UINT16_MAX) {
+            bucket->count++;
+            time_sum += time - bucket_start(lttb, (uint16_t)current);
+            value_sum += value;
+        }
+        lttb->points_read++;
+    }
+    if (current >= 0) {
+        finish_summary(&lttb->cache[current], time_sum, value_sum, bucket_start(lttb, (uint16_t)current));
+    }
+    lttb->buckets_read += b - a + 1;
+}
+
+// Triangle corners around cache bucket i: the kept point before, the average after
+static bool neighbours(const history_lttb_t* lttb, uint16_t i, uint32_t* at, int32_t* av, uint32_t* ct, int32_t* cv) {
+    bool have_a = false;
+    for (int32_t j = i - 1; j >= 0 && !have_a; j--) {
+        const history_lttb_bucket_t* bucket = &lttb->cache[j];
+        if (bucket->valid) {
+            // The sentinel has no selection of its own, its average stands in
+            *at = j == 0 ? bucket->avg_time : bucket->sel_time;
+            *av = j == 0 ? bucket->avg_value : bucket->sel_value;
+            have_a = true;
+        }
+    }
+
+    const history_lttb_bucket_t* own = &lttb->cache[i];
+    *ct = own->avg_time;
+    *cv = own->avg_value;
+    for (uint16_t j = i + 1; j <= lttb->width + 1; j++) {
+        if (lttb->cache[j].valid) {
+            *ct = lttb->cache[j].avg_time;
+            *cv = lttb->cache[j].avg_value;
+            break;
+        }
+    }
+    return have_a;
+}
+
+// Twice the triangle area; times relative to the first corner keep the products in range
+static inline uint64_t triangle_area(uint32_t at, int32_t av, uint32_t bt, int32_t bv, uint32_t ct, int32_t cv) {
+    int64_t area = ((int64_t)bt - at) * ((int64_t)cv - av) - ((int64_t)ct - at) * ((int64_t)bv - av);
+    return (uint64_t)(area < 0 ? -area : area);
+}
+
+// Pass 2: select points from window bucket 'a' on; past 'must' stop once a selection comes out unchanged
+static void select_from(history_lttb_t* lttb, uint16_t a, uint16_t must) {
+    uint16_t w = lttb->width;
+    if (a > w) {
+        return;
+    }
+    uint32_t from = bucket_start(lttb, a);
+    lttb->source->open(lttb->source->ctx, from, bucket_start(lttb, w + 1) - 1);
+
+    uint16_t current = a;
+    bool has_point = false;
+    bool have_a = false;
+    uint32_t at = 0, ct = 0, best_time = 0;
+    int32_t av = 0, cv = 0, best_value = 0;
+    uint64_t best_area = 0;
+
+    bool more = true;
+    while (current <= w) {
+        uint32_t time = 0;
+        int32_t value = 0;
+        more = more && lttb->source->next(lttb->source->ctx, &time, &value);
+        if (more && time < from) {
+            continue;
+        }
+        uint32_t index = more ? (time - from) / lttb->bucket_seconds + a : (uint32_t)w + 1;
+        if (index < current) {
+            continue;       // Out of order, its bucket is already done
+        }
+
+        // Close the buckets the stream has moved past
+        while (current < index && current <= w) {
+            history_lttb_bucket_t* bucket = &lttb->cache[current];
+            bool changed = has_point && (bucket->sel_time != best_time || bucket->sel_value != best_value);
+            if (has_point) {
+                bucket->sel_time = best_time;
+                bucket->sel_value = best_value;
+            }
+            lttb->buckets_selected++;
+            has_point = false;
+            if (current >= must && !changed) {
+                return;
+            }
+            current++;
+        }
+        if (!more || current > w) {
+            break;
+        }
+
+        lttb->points_read++;
+        if (!has_point) {
+            // Nothing kept before this bucket: its first point stays
+            has_point = true;
+            have_a = neighbours(lttb, current, &at, &av, &ct, &cv);
+            best_time = time;
+            best_value = value;
+            best_area = have_a ? triangle_area(at, av, time, value, ct, cv) : 0;
+        } else if (have_a) {
+            uint64_t area = triangle_area(at, av, time, value, ct, cv);
+            if (area > best_area) {
+                best_area = area;
+                best_time = time;
+                best_value = value;
+            }
+        }
+    }
+}
+
+void history_lttb_init(history_lttb_t* lttb, const history_lttb_source_t* source, uint16_t width) {
+    memset(lttb, 0, sizeof(*lttb));
+    lttb->source = source;
+    lttb->width = width > HISTORY_LTTB_MAX_BUCKETS ? HISTORY_LTTB_MAX_BUCKETS : width;
+}
+
+void history_lttb_invalidate(history_lttb_t* lttb) {
+    lttb->bucket_seconds = 0;
+}
+
+void history_lttb_set_window(history_lttb_t* lttb, uint32_t start, uint32_t bucket_seconds) {
+    if (bucket_seconds == 0 || lttb->width == 0) {
+        return;
+    }
+    uint32_t first = start / bucket_seconds;
+    if (first == 0) {
+        first = 1;      // Keeps the left sentinel at or after time 0
+    }
+    lttb->points_read = 0;
+    lttb->buckets_read = 0;
+    lttb->buckets_selected = 0;
+
+    uint16_t w = lttb->width;
+    int64_t shift = (int64_t)first - lttb->first;
+    if (bucket_seconds != lttb->bucket_seconds || shift >= w || -shift >= w) {
+        lttb->bucket_seconds = bucket_seconds;
+        lttb->first = first;
+        summarize(lttb, 0, w + 1);
+        select_from(lttb, 1, w);
+        return;
+    }
+    if (shift == 0) {
+        return;
+    }
+
+    uint16_t d = (uint16_t)(shift > 0 ? shift : -shift);
+    lttb->first = first;
+    if (shift > 0) {
+        // Later: the old right sentinel becomes a window bucket, d new buckets behind it
+        memmove(&lttb->cache[0], &lttb->cache[d], (w + 2 - d) * sizeof(lttb->cache[0]));
+        summarize(lttb, w + 2 - d, w + 1);
+        select_from(lttb, 1, 1);                // Seam: the new left sentinel
+        select_from(lttb, w + 1 - d, w);
+    } else {
+        // Earlier: d new buckets in front, the old left sentinel becomes window bucket d.
+        // The bucket after it had the sentinel's average as its corner, so it is redone too
+        memmove(&lttb->cache[d], &lttb->cache[0], (w + 2 - d) * sizeof(lttb->cache[0]));
+        summarize(lttb, 0, d - 1);
+        select_from(lttb, 1, d + 1);
+    }
+}
+
+void history_lttb_refresh_tail(history_lttb_t* lttb, uint16_t buckets) {
+    if (lttb->bucket_seconds == 0) {
+        return;
+    }
+    uint16_t w = lttb->width;
+    if (buckets > w) {
+        buckets = w;
+    }
+    lttb->points_read = 0;
+    lttb->buckets_read = 0;
+    lttb->buckets_selected = 0;
+    uint16_t a = w + 1 - buckets;
+    summarize(lttb, a, w + 1);
+    // The bucket before them used the first one's average as its corner
+    select_from(lttb, a > 1 ? a - 1 : 1, w);
+}
+
+const history_lttb_bucket_t* history_lttb_get(const history_lttb_t* lttb, uint16_t i) {
+    return &lttb->cache[i + 1];
+}
+
+uint32_t history_lttb_get_start(const history_lttb_t* lttb) {
+    return lttb->first * lttb->bucket_seconds;
+}
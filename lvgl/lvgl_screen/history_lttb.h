@@ -0,0 +1,79 @@
+/**
+ * History Downsampling (Largest-Triangle-Three-Buckets)
+ *
+ * Reduces any time range to one point per chart column. The range is cut
+ * into equal time buckets aligned to multiples of the bucket length, and
+ * each bucket keeps the point that spans the largest triangle with the
+ * point kept in the bucket before and the average of the bucket after, so
+ * peaks and dips survive the decimation. All arithmetic is fixed point
+ * (64-bit triangle areas over seconds and raw values).
+ *
+ * The window is computed incrementally. Every bucket caches its average
+ * and selected point under its absolute bucket number, plus one sentinel
+ * bucket on each side that only contributes its average. Panning keeps the
+ * overlapping buckets, reads only the new ones, and re-selects forward from
+ * the seam until the selection stops changing. Zooming changes the bucket
+ * length and recomputes the window in two streaming passes.
+ *
+ * Points come from a source that streams a time range in order, so the
+ * caller decides where the data lives (the time-series store) and nothing
+ * is buffered here beyond the per-bucket results.
+ */
+
+#ifndef HISTORY_LTTB_H
+#define HISTORY_LTTB_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Configuration
+#define HISTORY_LTTB_MAX_BUCKETS 240            // Widest chart in pixels
+
+// Streams the points of [from, to] oldest first
+typedef struct {
+    void (*open)(void* ctx, uint32_t from, uint32_t to);
+    bool (*next)(void* ctx, uint32_t* time, int32_t* value);
+    void* ctx;
+} history_lttb_source_t;
+
+// One bucket of the window
+typedef struct {
+    bool valid;                 // Has points (false = gap)
+    uint16_t count;
+    uint32_t avg_time;
+    int32_t avg_value;
+    uint32_t sel_time;          // Point kept for the chart
+    int32_t sel_value;
+} history_lttb_bucket_t;
+
+typedef struct {
+    const history_lttb_source_t* source;
+    uint16_t width;             // Buckets in the window
+    uint32_t bucket_seconds;    // 0 = no window yet
+    uint32_t first;             // Absolute number of window bucket 0
+
+    // [0] and [width + 1] are the sentinels outside the window
+    history_lttb_bucket_t cache[HISTORY_LTTB_MAX_BUCKETS + 2];
+
+    // Cost of the last update
+    uint32_t points_read;
+    uint16_t buckets_read;
+    uint16_t buckets_selected;
+} history_lttb_t;
+
+void history_lttb_init(history_lttb_t* lttb, const history_lttb_source_t* source, uint16_t width);
+
+// Show [start, start + width * bucket_seconds), start rounded down to a bucket
+void history_lttb_set_window(history_lttb_t* lttb, uint32_t start, uint32_t bucket_seconds);
+
+// Re-read the newest 'buckets' window buckets (new samples at the right edge)
+void history_lttb_refresh_tail(history_lttb_t* lttb, uint16_t buckets);
+
+// Forget the cache; the next set_window computes the whole window
+void history_lttb_invalidate(history_lttb_t* lttb);
+
+// Window bucket i (0 .. width - 1)
+const history_lttb_bucket_t* history_lttb_get(const history_lttb_t* lttb, uint16_t i);
+uint32_t history_lttb_get_start(const history_lttb_t* lttb);
+
+#endif // HISTORY_LTTB_H
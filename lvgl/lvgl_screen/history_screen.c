@@ -0,0 +1,379 @@
+/**
+ * History Screen Implementation
+ *
+ * Chart of one series from the time-series store, decimated with LTTB
+ */
+
+#include "history_screen.h"
+#include "history_lttb.h"
+#include "screen_manager.h"
+#include "../../drivers/logging/logging.h"
+#include "../../drivers/storage/timeseries.h"
+#include "../../drivers/scheduler/scheduler.h"
+#include "pico/time.h"
+#include <stdio.h>
+#include <time.h>
+
+#define CHART_RANGE 1000        // Y axis in per mille of the visible value range
+
+// Screen object
+static lv_obj_t *history_screen = NULL;
+
+// UI elements
+static lv_obj_t *chart = NULL;
+static lv_chart_series_t *line = NULL;
+static lv_obj_t *series_btn_label = NULL;
+static lv_obj_t *range_label = NULL;
+static lv_obj_t *scale_label = NULL;
+
+// Zoom levels (visible span)
+static const uint32_t spans[] = { 3600, 6 * 3600, 86400, 7 * 86400, 30 * 86400, 365 * 86400 };
+static const char *const span_names[] = { "1 hour", "6 hours", "1 day", "1 week", "1 month", "1 year" };
+#define SPAN_COUNT (sizeof(spans) / sizeof(spans[0]))
+
+// Series that make sense as a line
+static const uint8_t series_ids[] = { TIMESERIES_MOISTURE, TIMESERIES_BATTERY_MV, TIMESERIES_TEMPERATURE };
+static const char *const series_names[] = { "Moisture", "Battery", "Temperature" };
+#define SERIES_COUNT (sizeof(series_ids) / sizeof(series_ids[0]))
+
+// Point source on top of the time-series store
+typedef struct {
+    timeseries_iter_t iter;
+    timeseries_tier_t tier;
+    uint8_t series;
+} history_source_ctx_t;
+
+static history_source_ctx_t source_ctx;
+static history_lttb_t lttb;
+
+// View state
+static uint32_t span_index = 2;
+static uint32_t series_index = 0;
+static uint32_t window_start = 0;
+static int32_t value_lo = 0;
+static int32_t value_hi = 0;
+static uint32_t last_refresh_ms = 0;
+
+static void source_open(void *ctx, uint32_t from, uint32_t to) {
+    history_source_ctx_t *source = (history_source_ctx_t *)ctx;
+    timeseries_query(&source->iter, source->tier, source->series, from, to);
+}
+
+static bool source_next(void *ctx, uint32_t *time, int32_t *value) {
+    history_source_ctx_t *source = (history_source_ctx_t *)ctx;
+    timeseries_point_t point;
+    if (!timeseries_next(&source->iter, &point)) {
+        return false;
+    }
+    *time = point.time;
+    *value = point.avg;
+    return true;
+}
+
+static const history_lttb_source_t source = { source_open, source_next, &source_ctx };
+
+static uint32_t bucket_seconds(void) {
+    return (spans[span_index] + HISTORY_SCREEN_POINTS - 1) / HISTORY_SCREEN_POINTS;
+}
+
+// Finest tier with a handful of points per bucket that still reaches back to the window start
+static timeseries_tier_t pick_tier(uint32_t bucket, uint32_t start) {
+    static const uint32_t raw_period_s = 10;    // CONFIG_HISTORY_SAMPLE_MS
+    timeseries_stats_t stats;
+    timeseries_get_stats(&stats);
+
+    for (uint32_t tier = TIMESERIES_TIER_RAW; tier < TIMESERIES_TIER_DAY; tier++) {
+        uint32_t period = tier == TIMESERIES_TIER_RAW ? raw_period_s : timeseries_tier_seconds((timeseries_tier_t)tier);
+        if (bucket <= 16 * period && stats.oldest[tier] != 0 && stats.oldest[tier] <= start) {
+            return (timeseries_tier_t)tier;
+        }
+    }
+    return TIMESERIES_TIER_DAY;
+}
+
+static lv_coord_t to_chart(int32_t value) {
+    if (value_hi <= value_lo) {
+        return CHART_RANGE / 2;
+    }
+    return (lv_coord_t)((int64_t)(value - value_lo) * CHART_RANGE / (value_hi - value_lo));
+}
+
+static void format_value(char *buffer, size_t size, int32_t value) {
+    switch (series_ids[series_index]) {
+        case TIMESERIES_BATTERY_MV:
+            snprintf(buffer, size, "%ld mV", value);
+            break;
+        case TIMESERIES_TEMPERATURE:
+            snprintf(buffer, size, "%ld.%01ld C", value / 100, (value < 0 ? -value : value) % 100 / 10);
+            break;
+        default:
+            snprintf(buffer, size, "%ld", value);
+            break;
+    }
+}
+
+static void update_labels(void) {
+    char lo[16], hi[16], text[48];
+    format_value(lo, sizeof(lo), value_lo);
+    format_value(hi, sizeof(hi), value_hi);
+    snprintf(text, sizeof(text), "%s - %s", lo, hi);
+    lv_label_set_text(scale_label, text);
+
+    time_t end = (time_t)(window_start + spans[span_index]);
+    struct tm end_tm;
+    gmtime_r(&end, &end_tm);
+    snprintf(text, sizeof(text), "%s to %02d/%02d %02d:%02d", span_names[span_index],
+             end_tm.tm_mday, end_tm.tm_mon + 1, end_tm.tm_hour, end_tm.tm_min);
+    lv_label_set_text(range_label, text);
+}
+
+static lv_coord_t chart_value(uint16_t i) {
+    const history_lttb_bucket_t *bucket = history_lttb_get(&lttb, i);
+    return bucket->valid ? to_chart(bucket->sel_value) : LV_CHART_POINT_NONE;
+}
+
+// Copy the LTTB points into the chart, invalidating only what changed
+static void apply_to_chart(void) {
+    int32_t lo = INT32_MAX;
+    int32_t hi = INT32_MIN;
+    for (uint16_t i = 0; i < HISTORY_SCREEN_POINTS; i++) {
+        const history_lttb_bucket_t *bucket = history_lttb_get(&lttb, i);
+        if (bucket->valid) {
+            lo = bucket->sel_value < lo ? bucket->sel_value : lo;
+            hi = bucket->sel_value > hi ? bucket->sel_value : hi;
+        }
+    }
+    // A new value range moves every point
+    bool full = lo <= hi && (lo != value_lo || hi != value_hi);
+    if (lo <= hi) {
+        value_lo = lo;
+        value_hi = hi;
+    }
+
+    lv_coord_t *y = lv_chart_get_y_array(chart, line);
+    uint16_t changed[HISTORY_SCREEN_MAX_POINT_UPDATES];
+    uint32_t changed_count = 0;
+    for (uint16_t i = 0; i < HISTORY_SCREEN_POINTS && !full; i++) {
+        if (chart_value(i) != y[i]) {
+            if (changed_count == HISTORY_SCREEN_MAX_POINT_UPDATES) {
+                full = true;
+            } else {
+                changed[changed_count++] = i;
+            }
+        }
+    }
+
+    if (full) {
+        // Panned or zoomed: rewrite the array, one invalidation of the chart
+        for (uint16_t i = 0; i < HISTORY_SCREEN_POINTS; i++) {
+            y[i] = chart_value(i);
+        }
+        lv_chart_refresh(chart);
+    } else {
+        // A few points (live tail): only the strips around them are redrawn
+        for (uint32_t i = 0; i < changed_count; i++) {
+            lv_chart_set_value_by_id(chart, line, changed[i], chart_value(changed[i]));
+        }
+    }
+    update_labels();
+}
+
+static void show_window(uint32_t start) {
+    uint32_t begin_us = to_us_since_boot(get_absolute_time());
+    uint32_t bucket = bucket_seconds();
+
+    // A different tier is a different data set, so the cache starts over
+    timeseries_tier_t tier = pick_tier(bucket, start);
+    if (tier != source_ctx.tier || series_ids[series_index] != source_ctx.series) {
+        source_ctx.tier = tier;
+        source_ctx.series = series_ids[series_index];
+        history_lttb_invalidate(&lttb);
+    }
+
+    history_lttb_set_window(&lttb, start, bucket);
+    window_start = history_lttb_get_start(&lttb);
+    apply_to_chart();
+
+    LOG_UI_DEBUG("History %s/%s: %u buckets read, %u selected, %lu points, %lu us",
+                 series_names[series_index], span_names[span_index], lttb.buckets_read,
+                 lttb.buckets_selected, lttb.points_read,
+                 (uint32_t)to_us_since_boot(get_absolute_time()) - begin_us);
+}
+
+static void show_latest(void) {
+    uint32_t now = scheduler_now();
+    uint32_t span = spans[span_index];
+    show_window(now > span ? now - span + bucket_seconds() : 0);
+}
+
+static void pan(int32_t direction) {
+    int64_t start = (int64_t)window_start + direction * (int64_t)(spans[span_index] / 4);
+    int64_t latest = (int64_t)scheduler_now() - spans[span_index] + bucket_seconds();
+    if (start > latest) {
+        start = latest;     // Not past the present
+    }
+    show_window(start < 0 ? 0 : (uint32_t)start);
+}
+
+static void zoom(int32_t direction) {
+    if ((direction < 0 && span_index == 0) || (direction > 0 && span_index == SPAN_COUNT - 1)) {
+        return;
+    }
+    // Keep the right edge where it is
+    uint32_t end = window_start + spans[span_index];
+    span_index += direction;
+    show_window(end > spans[span_index] ? end - spans[span_index] : 0);
+}
+
+// Event handlers
+static void pan_btn_event_cb(lv_event_t * e) {
+    if (lv_event_get_code(e) == LV_EVENT_CLICKED) {
+        screen_manager_handle_ui_event(e);  // Reset timeout
+        pan((int32_t)(intptr_t)lv_event_get_user_data(e));
+    }
+}
+
+static void zoom_btn_event_cb(lv_event_t * e) {
+    if (lv_event_get_code(e) == LV_EVENT_CLICKED) {
+        screen_manager_handle_ui_event(e);  // Reset timeout
+        zoom((int32_t)(intptr_t)lv_event_get_user_data(e));
+    }
+}
+
+static void series_btn_event_cb(lv_event_t * e) {
+    if (lv_event_get_code(e) == LV_EVENT_CLICKED) {
+        screen_manager_handle_ui_event(e);  // Reset timeout
+        series_index = (series_index + 1) % SERIES_COUNT;
+        lv_label_set_text(series_btn_label, series_names[series_index]);
+        show_window(window_start);
+    }
+}
+
+static void back_btn_event_cb(lv_event_t * e) {
+    if (lv_event_get_code(e) == LV_EVENT_CLICKED) {
+        screen_manager_handle_ui_event(e);  // Reset timeout
+        screen_manager_switch_to(SCREEN_MAIN);
+    }
+}
+
+static void gesture_event_cb(lv_event_t * e) {
+    lv_dir_t dir = lv_indev_get_gesture_dir(lv_indev_get_act());
+    if (dir == LV_DIR_LEFT || dir == LV_DIR_RIGHT) {
+        screen_manager_handle_ui_event(e);  // Reset timeout
+        pan(dir == LV_DIR_LEFT ? 1 : -1);   // Swipe left = later
+    }
+}
+
+static lv_obj_t *create_button(lv_obj_t *parent, const char *text, lv_coord_t width,
+                               lv_event_cb_t callback, intptr_t user_data) {
+    lv_obj_t *btn = lv_btn_create(parent);
+    lv_obj_set_size(btn, width, 40);
+    lv_obj_set_style_bg_color(btn, lv_color_hex(0x3a3a3a), LV_PART_MAIN);
+    lv_obj_set_style_bg_color(btn, lv_color_hex(0x555555), LV_STATE_PRESSED);
+    lv_obj_set_style_radius(btn, 8, LV_PART_MAIN);
+    lv_obj_add_event_cb(btn, callback, LV_EVENT_CLICKED, (void *)user_data);
+
+    lv_obj_t *label = lv_label_create(btn);
+    lv_label_set_text(label, text);
+    lv_obj_set_style_text_color(label, lv_color_white(), LV_PART_MAIN);
+    lv_obj_center(label);
+    return btn;
+}
+
+void history_screen_create(void) {
+    // Create the history screen
+    history_screen = lv_obj_create(NULL);
+    lv_obj_set_style_bg_color(history_screen, lv_color_hex(0x1e1e1e), LV_PART_MAIN);  // Dark background
+    lv_obj_clear_flag(history_screen, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_add_event_cb(history_screen, gesture_event_cb, LV_EVENT_GESTURE, NULL);
+
+    // Series selector doubles as the title
+    lv_obj_t *series_btn = create_button(history_screen, series_names[series_index], 160, series_btn_event_cb, 0);
+    lv_obj_align(series_btn, LV_ALIGN_TOP_MID, 0, 8);
+    series_btn_label = lv_obj_get_child(series_btn, 0);
+    lv_obj_set_style_text_font(series_btn_label, &lv_font_montserrat_16, LV_PART_MAIN);
+
+    // Visible value range
+    scale_label = lv_label_create(history_screen);
+    lv_label_set_text(scale_label, "");
+    lv_obj_set_style_text_color(scale_label, lv_color_hex(0xaaaaaa), LV_PART_MAIN);
+    lv_obj_set_style_text_font(scale_label, &lv_font_montserrat_12, LV_PART_MAIN);
+    lv_obj_align(scale_label, LV_ALIGN_TOP_MID, 0, 54);
+
+    // Chart: one point per pixel column, no point markers, gaps for missing data
+    chart = lv_chart_create(history_screen);
+    lv_obj_set_size(chart, HISTORY_SCREEN_POINTS, 160);
+    lv_obj_align(chart, LV_ALIGN_TOP_MID, 0, 72);
+    lv_obj_set_style_pad_all(chart, 0, LV_PART_MAIN);
+    lv_obj_set_style_bg_color(chart, lv_color_hex(0x2a2a2a), LV_PART_MAIN);
+    lv_obj_set_style_border_width(chart, 0, LV_PART_MAIN);
+    lv_obj_set_style_line_color(chart, lv_color_hex(0x3a3a3a), LV_PART_MAIN);
+    lv_obj_set_style_size(chart, 0, LV_PART_INDICATOR);
+    lv_obj_set_style_line_width(chart, 2, LV_PART_ITEMS);
+    lv_obj_clear_flag(chart, LV_OBJ_FLAG_CLICKABLE);
+    lv_chart_set_type(chart, LV_CHART_TYPE_LINE);
+    lv_chart_set_update_mode(chart, LV_CHART_UPDATE_MODE_CIRCULAR);
+    lv_chart_set_div_line_count(chart, 4, 0);
+    lv_chart_set_range(chart, LV_CHART_AXIS_PRIMARY_Y, 0, CHART_RANGE);
+    lv_chart_set_point_count(chart, HISTORY_SCREEN_POINTS);
+    line = lv_chart_add_series(chart, lv_color_hex(0x4CAF50), LV_CHART_AXIS_PRIMARY_Y);
+    lv_chart_set_all_value(chart, line, LV_CHART_POINT_NONE);
+
+    // Time range shown
+    range_label = lv_label_create(history_screen);
+    lv_label_set_text(range_label, "");
+    lv_obj_set_style_text_color(range_label, lv_color_white(), LV_PART_MAIN);
+    lv_obj_set_style_text_font(range_label, &lv_font_montserrat_14, LV_PART_MAIN);
+    lv_obj_align(range_label, LV_ALIGN_TOP_MID, 0, 238);
+
+    // Pan and zoom
+    lv_obj_t *earlier_btn = create_button(history_screen, LV_SYMBOL_LEFT, 50, pan_btn_event_cb, -1);
+    lv_obj_align(earlier_btn, LV_ALIGN_BOTTOM_LEFT, 8, -8);
+    lv_obj_t *zoom_out_btn = create_button(history_screen, LV_SYMBOL_MINUS, 50, zoom_btn_event_cb, 1);
+    lv_obj_align(zoom_out_btn, LV_ALIGN_BOTTOM_LEFT, 64, -8);
+    lv_obj_t *zoom_in_btn = create_button(history_screen, LV_SYMBOL_PLUS, 50, zoom_btn_event_cb, -1);
+    lv_obj_align(zoom_in_btn, LV_ALIGN_BOTTOM_RIGHT, -64, -8);
+    lv_obj_t *later_btn = create_button(history_screen, LV_SYMBOL_RIGHT, 50, pan_btn_event_cb, 1);
+    lv_obj_align(later_btn, LV_ALIGN_BOTTOM_RIGHT, -8, -8);
+
+    // Back to the main screen
+    lv_obj_t *back_btn = create_button(history_screen, LV_SYMBOL_HOME, 40, back_btn_event_cb, 0);
+    lv_obj_align(back_btn, LV_ALIGN_TOP_LEFT, 8, 8);
+
+    history_lttb_init(&lttb, &source, HISTORY_SCREEN_POINTS);
+    source_ctx.tier = TIMESERIES_TIER_COUNT;
+
+    LOG_UI_INFO("History screen created");
+}
+
+lv_obj_t* history_screen_get_screen(void) {
+    return history_screen;
+}
+
+void history_screen_load(void) {
+    show_latest();
+    last_refresh_ms = to_ms_since_boot(get_absolute_time());
+}
+
+void history_screen_update(void) {
+    uint32_t now_ms = to_ms_since_boot(get_absolute_time());
+    if (!history_screen || now_ms - last_refresh_ms < HISTORY_SCREEN_REFRESH_MS) {
+        return;
+    }
+    last_refresh_ms = now_ms;
+
+    // Only while the window reaches the present
+    uint32_t now = scheduler_now();
+    uint32_t end = window_start + spans[span_index];
+    if (now < window_start) {
+        return;
+    }
+    if (now >= end) {
+        if (now - end < spans[span_index] / 8) {
+            show_latest();      // The present moved past the right edge: follow it
+        }
+        return;
+    }
+    history_lttb_refresh_tail(&lttb, 2);
+    apply_to_chart();
+}
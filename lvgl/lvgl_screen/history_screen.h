@@ -0,0 +1,42 @@
+/**
+ * History Screen Header
+ *
+ * Chart of the sensor history (moisture, battery, temperature) from the
+ * time-series store. Any time range is reduced to one LTTB point per chart
+ * column, so lv_chart never draws more than HISTORY_SCREEN_POINTS points.
+ * Swipe or use the arrows to pan, +/- to zoom.
+ */
+
+#ifndef HISTORY_SCREEN_H
+#define HISTORY_SCREEN_H
+
+#include "lvgl.h"
+
+// Configuration
+#define HISTORY_SCREEN_POINTS 220               // Chart width in pixels, one point per column
+#define HISTORY_SCREEN_MAX_POINT_UPDATES 8      // More changed points than this redraw the whole chart
+#define HISTORY_SCREEN_REFRESH_MS 10000         // Live update of the newest buckets
+
+/**
+ * Create the history screen
+ */
+void history_screen_create(void);
+
+/**
+ * Get the history screen object
+ * @return pointer to the history screen object
+ */
+lv_obj_t* history_screen_get_screen(void);
+
+/**
+ * Show the newest data of the current series and zoom (call when switching to the screen)
+ */
+void history_screen_load(void);
+
+/**
+ * Pull in new samples at the right edge while the window reaches the present
+ * (call from the main loop while the screen is shown)
+ */
+void history_screen_update(void);
+
+#endif // HISTORY_SCREEN_H
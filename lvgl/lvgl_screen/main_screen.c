@@ -14,6 +14,7 @@ static lv_obj_t *main_screen = NULL;
 // UI elements
 static lv_obj_t *stepper_btn = NULL;
 static lv_obj_t *time_settings_btn = NULL;
+static lv_obj_t *history_btn = NULL;
 static lv_obj_t *title_label = NULL;
 
 // Event handlers
@@ -35,6 +36,15 @@ static void time_settings_btn_event_cb(lv_event_t * e) {
     }
 }
 
+static void history_btn_event_cb(lv_event_t * e) {
+    lv_event_code_t code = lv_event_get_code(e);
+    if (code == LV_EVENT_CLICKED) {
+        screen_manager_handle_ui_event(e);  // Reset timeout
+        screen_manager_switch_to(SCREEN_HISTORY);
+        LOG_UI_INFO("Navigating to history screen");
+    }
+}
+
 void main_screen_create(void) {
     // Create the main screen
     main_screen = lv_obj_create(NULL);
@@ -50,7 +60,7 @@ void main_screen_create(void) {
     // Create stepper control button
     stepper_btn = lv_btn_create(main_screen);
     lv_obj_set_size(stepper_btn, 200, 60);
-    lv_obj_align(stepper_btn, LV_ALIGN_CENTER, 0, -40);
+    lv_obj_align(stepper_btn, LV_ALIGN_CENTER, 0, -70);
     lv_obj_add_event_cb(stepper_btn, stepper_btn_event_cb, LV_EVENT_CLICKED, NULL);
     
     // Style the stepper button
@@ -68,7 +78,7 @@ void main_screen_create(void) {
     // Create time settings button
     time_settings_btn = lv_btn_create(main_screen);
     lv_obj_set_size(time_settings_btn, 200, 60);
-    lv_obj_align(time_settings_btn, LV_ALIGN_CENTER, 0, 40);
+    lv_obj_align(time_settings_btn, LV_ALIGN_CENTER, 0, 0);
     lv_obj_add_event_cb(time_settings_btn, time_settings_btn_event_cb, LV_EVENT_CLICKED, NULL);
     
     // Style the time settings button
@@ -83,6 +93,24 @@ void main_screen_create(void) {
     lv_obj_set_style_text_font(time_settings_btn_label, &lv_font_montserrat_16, LV_PART_MAIN);
     lv_obj_center(time_settings_btn_label);
     
+    // Create history button
+    history_btn = lv_btn_create(main_screen);
+    lv_obj_set_size(history_btn, 200, 60);
+    lv_obj_align(history_btn, LV_ALIGN_CENTER, 0, 70);
+    lv_obj_add_event_cb(history_btn, history_btn_event_cb, LV_EVENT_CLICKED, NULL);
+    
+    // Style the history button
+    lv_obj_set_style_bg_color(history_btn, lv_color_hex(0xFF9800), LV_PART_MAIN);  // Orange
+    lv_obj_set_style_bg_color(history_btn, lv_color_hex(0xF57C00), LV_STATE_PRESSED);
+    lv_obj_set_style_radius(history_btn, 8, LV_PART_MAIN);
+    
+    // Add label to history button
+    lv_obj_t *history_btn_label = lv_label_create(history_btn);
+    lv_label_set_text(history_btn_label, "History");
+    lv_obj_set_style_text_color(history_btn_label, lv_color_white(), LV_PART_MAIN);
+    lv_obj_set_style_text_font(history_btn_label, &lv_font_montserrat_16, LV_PART_MAIN);
+    lv_obj_center(history_btn_label);
+    
     LOG_UI_INFO("Main screen created with navigation buttons");
 }
 
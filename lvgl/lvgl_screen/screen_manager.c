@@ -8,7 +8,11 @@
 
 #include "screen_manager.h"
 #include "time_settings_screen.h"
+#include "history_screen.h"
 #include "../../drivers/logging/logging.h"
+#include "../../drivers/latency_probe/latency_probe.h"
+#include "../lv_port/lv_port.h"
+#include "../lv_port/lv_port_frame.h"
 #include <stdio.h>
 #include "pico/time.h"  // Add this for hardware-independent timing
 
@@ -30,6 +34,8 @@ static void lock_screen_touch_event_cb(lv_event_t * e) {
     lv_event_code_t code = lv_event_get_code(e);
     
     if (code == LV_EVENT_CLICKED || code == LV_EVENT_PRESSED) {
+        LATENCY_MARK(LATENCY_STAGE_EVENT_CB);
+        
         // Boost CPU frequency BEFORE screen transition for smooth animation
         if (cpu_frequency_callback) {
             cpu_frequency_callback(CPU_FREQ_HIGH);
@@ -84,10 +90,21 @@ void screen_manager_switch_to(screen_id_t screen_id) {
         if (screen_id == SCREEN_TIME_SETTINGS) {
             // Load current RTC time into the time settings screen
             time_settings_screen_load_current_time();
+        } else if (screen_id == SCREEN_HISTORY) {
+            // Jump to the newest data
+            history_screen_load();
+        }
+        
+        // Time-to-first-frame is measured up to the first frame of the new screen on the panel
+        if (screens[screen_id] != lv_scr_act()) {
+            lv_port_mark_navigation();
         }
         
-        // Load the new screen with fade animation (500ms duration)
-        lv_scr_load_anim(screens[screen_id], LV_SCR_LOAD_ANIM_FADE_IN, FADE_ANIMATION_MS, 0, false);
+        // Retained screens are pushed at once from their copy in RAM, the others fade in (250ms)
+        bool retained = lv_port_frame_load(screens[screen_id]);
+        if (!retained) {
+            lv_scr_load_anim(screens[screen_id], LV_SCR_LOAD_ANIM_FADE_IN, FADE_ANIMATION_MS, 0, false);
+        }
         current_screen = screen_id;
         
         // If switching to lock screen, reduce CPU frequency after animation delay
@@ -97,7 +114,7 @@ void screen_manager_switch_to(screen_id_t screen_id) {
             // For now, this will be handled in the main loop
         }
         
-        LOG_UI_INFO("Switched to screen %d with fade animation", screen_id);
+        LOG_UI_INFO("Switched to screen %d %s", screen_id, retained ? "from its retained copy" : "with fade animation");
     } else {
         LOG_UI_ERROR("Invalid screen ID %d or screen not initialized", screen_id);
     }
@@ -144,6 +161,8 @@ void screen_manager_reset_timeout(void) {
 
 // Helper function for UI elements to handle events and automatically reset timeout
 void screen_manager_handle_ui_event(lv_event_t * e) {
+    LATENCY_MARK(LATENCY_STAGE_EVENT_CB);
+    
     // Always reset timeout when any UI event occurs (except on lock screen)
     if (current_screen != SCREEN_LOCK) {
         screen_manager_reset_timeout();
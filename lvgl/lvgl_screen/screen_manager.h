@@ -15,6 +15,7 @@ typedef enum {
     SCREEN_MAIN,
     SCREEN_STEPPER,
     SCREEN_TIME_SETTINGS,
+    SCREEN_HISTORY,
     SCREEN_COUNT
 } screen_id_t;
 
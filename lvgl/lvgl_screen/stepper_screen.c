@@ -6,11 +6,14 @@
 #include "screen_manager.h"
 #include "../../drivers/stepper/stepper_driver.h"
 #include "../../drivers/logging/logging.h"
+#include "../../drivers/storage/settings_store.h"
+#include "../../drivers/dosing/dosing.h"
 #include <stdio.h>
 
 // Screen objects
 lv_obj_t *steps_slider = NULL;
 lv_obj_t *start_stop_btn = NULL;
+lv_obj_t *dose_btn = NULL;
 lv_obj_t *progress_bar = NULL;
 lv_obj_t *current_steps_label = NULL;
 lv_obj_t *target_steps_label = NULL;
@@ -34,12 +37,32 @@ static void slider_event_cb(lv_event_t * e) {
         
         // Update slider label with microstepping-aware units
         static char label_text[64];
-        snprintf(label_text, sizeof(label_text), "Steps: %d (%.2f rev)", value, value / (float)STEPPER_STEPS_PER_REV);
+        snprintf(label_text, sizeof(label_text), "Steps: %d (%.2f rev, %lu mL)", value,
+                 value / (float)STEPPER_STEPS_PER_REV, dosing_steps_to_ul(MANUAL_DOSE_PUMP, value, 0) / 1000);
         
         lv_label_set_text(target_steps_label, label_text);
     }
 }
 
+// Pump the slider's volume through the dose queue (zone valve, metering, history) instead of a bare move
+static void dose_button_event_cb(lv_event_t * e) {
+    if (lv_event_get_code(e) != LV_EVENT_CLICKED) {
+        return;
+    }
+    screen_manager_handle_ui_event(e);
+    
+    int32_t steps = lv_slider_get_value(steps_slider);
+    uint32_t volume_ul = dosing_steps_to_ul(MANUAL_DOSE_PUMP, steps, 0);
+    if (dosing_queue(MANUAL_DOSE_PUMP, MANUAL_DOSE_ZONE, volume_ul, 0)) {
+        snprintf(label_buffer, sizeof(label_buffer), "Dose queued: %lu mL", volume_ul / 1000);
+        stepper_screen_set_status(label_buffer);
+        completion_handled = false;
+        lv_bar_set_value(progress_bar, 0, LV_ANIM_OFF);
+    } else {
+        stepper_screen_set_status("Dose queue full");
+    }
+}
+
 static void button_event_cb(lv_event_t * e) {
     lv_event_code_t code = lv_event_get_code(e);
     
@@ -47,16 +70,24 @@ static void button_event_cb(lv_event_t * e) {
         // Reset timeout automatically using helper function
         screen_manager_handle_ui_event(e);
         
-        if (stepper_driver_is_running()) {
-            // Stop the stepper motor (enable pin automatically disabled)
+        if (stepper_driver_get_state() == STEPPER_STOPPING) {
+            // Second press while ramping down: stop immediately
             stepper_driver_stop();
             lv_label_set_text(lv_obj_get_child(start_stop_btn, 0), "START");
             stepper_screen_set_status("Stopped (Driver Disabled)");
+        } else if (stepper_driver_is_running()) {
+            // Ramp down without losing steps (enable pin disabled once stopped)
+            stepper_driver_stop_smooth();
+            lv_label_set_text(lv_obj_get_child(start_stop_btn, 0), "START");
+            stepper_screen_set_status("Stopping");
             completion_handled = false; // Reset for next movement
         } else {
             // Start the stepper motor (enable pin automatically enabled)
             int32_t target_steps = lv_slider_get_value(steps_slider);
             
+            // Remember the last used amount as the default for the next boot
+            settings_set_u32(SETTINGS_KEY_STEPPER_STEPS, (uint32_t)target_steps);
+            
             stepper_driver_start(target_steps);
             lv_label_set_text(lv_obj_get_child(start_stop_btn, 0), "STOP");
             stepper_screen_set_status("Running");
@@ -85,16 +116,22 @@ void stepper_screen_create(void) {
     lv_label_set_text(slider_label, "Number of Steps:");
     lv_obj_align(slider_label, LV_ALIGN_TOP_MID, 0, 15);  // Centered
     
+    int32_t initial_steps = (int32_t)settings_get_u32(SETTINGS_KEY_STEPPER_STEPS, DEFAULT_STEPS);
+    if (initial_steps < MIN_STEPS || initial_steps > MAX_STEPS) {
+        initial_steps = DEFAULT_STEPS;
+    }
+    
     steps_slider = lv_slider_create(obj);
     lv_slider_set_range(steps_slider, MIN_STEPS, MAX_STEPS);
-    lv_slider_set_value(steps_slider, DEFAULT_STEPS, LV_ANIM_OFF);
+    lv_slider_set_value(steps_slider, initial_steps, LV_ANIM_OFF);
     lv_obj_set_size(steps_slider, lv_pct(80), 30);
     lv_obj_align(steps_slider, LV_ALIGN_TOP_MID, 0, 40);  // Centered
     lv_obj_add_event_cb(steps_slider, slider_event_cb, LV_EVENT_VALUE_CHANGED, NULL);
     
     // Target steps label
     target_steps_label = lv_label_create(obj);
-    snprintf(label_buffer, sizeof(label_buffer), "Steps: %d (%.2f rev)", DEFAULT_STEPS, DEFAULT_STEPS / (float)STEPPER_STEPS_PER_REV);
+    snprintf(label_buffer, sizeof(label_buffer), "Steps: %ld (%.2f rev, %lu mL)", initial_steps,
+             initial_steps / (float)STEPPER_STEPS_PER_REV, dosing_steps_to_ul(MANUAL_DOSE_PUMP, initial_steps, 0) / 1000);
     lv_label_set_text(target_steps_label, label_buffer);
     lv_obj_align(target_steps_label, LV_ALIGN_TOP_MID, 0, 80);  // Centered
     
@@ -112,14 +149,24 @@ void stepper_screen_create(void) {
     
     // Start/Stop button - moved up due to space savings
     start_stop_btn = lv_btn_create(obj);
-    lv_obj_set_size(start_stop_btn, 120, 50);
-    lv_obj_align(start_stop_btn, LV_ALIGN_TOP_MID, 0, 170);  // Moved up from 195 to 170
+    lv_obj_set_size(start_stop_btn, 100, 50);
+    lv_obj_align(start_stop_btn, LV_ALIGN_TOP_MID, -55, 170);  // Moved up from 195 to 170
     lv_obj_add_event_cb(start_stop_btn, button_event_cb, LV_EVENT_CLICKED, NULL);
     
     lv_obj_t *btn_label = lv_label_create(start_stop_btn);
     lv_label_set_text(btn_label, "START");
     lv_obj_center(btn_label);
     
+    // Dose button - the same amount as a metered dose to MANUAL_DOSE_ZONE
+    dose_btn = lv_btn_create(obj);
+    lv_obj_set_size(dose_btn, 100, 50);
+    lv_obj_align(dose_btn, LV_ALIGN_TOP_MID, 55, 170);
+    lv_obj_add_event_cb(dose_btn, dose_button_event_cb, LV_EVENT_CLICKED, NULL);
+    
+    lv_obj_t *dose_label = lv_label_create(dose_btn);
+    lv_label_set_text(dose_label, "DOSE");
+    lv_obj_center(dose_label);
+    
     // Status label - moved up below button
     status_label = lv_label_create(obj);
     lv_label_set_text(status_label, "Ready");
@@ -154,6 +201,9 @@ void stepper_screen_update_progress(void) {
             stepper_screen_set_status("Completed");
             stepper_screen_set_button_text("START");
             completion_handled = true; // Mark completion as handled
+        } else {
+            stepper_screen_set_status("Stopped (Driver Disabled)");
+            completion_handled = true;
         }
     }
 }
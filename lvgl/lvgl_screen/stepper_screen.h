@@ -9,6 +9,7 @@
  * This screen provides:
  * - A slider to set the number of steps (1-10000)
  * - A button to start/stop the stepper motor
+ * - A button to queue the same amount as a metered dose
  * - A progress bar showing current progress
  * - Labels showing current step count and target steps
  */
@@ -16,6 +17,7 @@
 // Screen elements
 extern lv_obj_t *steps_slider;
 extern lv_obj_t *start_stop_btn;
+extern lv_obj_t *dose_btn;
 extern lv_obj_t *progress_bar;
 extern lv_obj_t *current_steps_label;
 extern lv_obj_t *target_steps_label;
@@ -27,6 +29,8 @@ extern lv_obj_t *status_label;
 #define MIN_STEPS 1
 #define MAX_STEPS (STEPPER_STEPS_PER_REV * 10)  // Up to 10 full revolutions
 #define DEFAULT_STEPS STEPPER_STEPS_PER_REV     // 1 full revolution (1600 steps with 1/8 microstepping)
+#define MANUAL_DOSE_PUMP 0                      // Pump and zone the DOSE button doses with
+#define MANUAL_DOSE_ZONE 0
 
 // Function prototypes
 void stepper_screen_create(void);
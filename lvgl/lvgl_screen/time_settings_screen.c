@@ -8,6 +8,8 @@
 #include "screen_manager.h"
 #include "../../libraries/bsp/bsp_pcf85063.h"
 #include "../../drivers/logging/logging.h"
+#include "../../drivers/storage/settings_store.h"
+#include "../../drivers/scheduler/scheduler.h"
 
 // Screen object
 static lv_obj_t *time_settings_screen = NULL;
@@ -280,6 +282,10 @@ void time_settings_screen_save_and_return(void) {
     
     // Set the RTC time
     bsp_pcf85063_set_time(&new_time);
+    new_time.tm_isdst = 0;
+    uint32_t new_epoch = (uint32_t)mktime(&new_time);
+    settings_set_u32(SETTINGS_KEY_RTC_LAST_TIME, new_epoch);
+    scheduler_sync_clock(new_epoch);
     
     LOG_RTC_INFO("Time set to: %04d-%02d-%02d %02d:%02d:00 (roller selections: h=%d, m=%d)",
                 new_time.tm_year + 1900, new_time.tm_mon + 1, new_time.tm_mday,
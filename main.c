@@ -3,10 +3,14 @@
  */
 
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
 #include "pico/stdlib.h"
 #include "hardware/clocks.h"
 #include "hardware/pio.h"
 #include "hardware/i2c.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
 #include "lvgl.h"
 #include "config.h"
 #include "bsp_i2c.h"
@@ -14,16 +18,37 @@
 #include "bsp_lcd_brightness.h"
 #include "bsp_pcf85063.h"
 #include "lvgl/lv_port/lv_port.h"
+#include "lvgl/lv_port/lv_port_blend.h"
+#include "lvgl/lv_port/lv_port_dma.h"
+#include "lvgl/lv_port/lv_port_glyph.h"
+#include "lvgl/lv_port/lv_port_frame.h"
 #include "lvgl_screen/lock_screen.h"
 #include "lvgl_screen/main_screen.h"
 #include "lvgl_screen/stepper_screen.h"
 #include "lvgl_screen/time_settings_screen.h"
+#include "lvgl_screen/history_screen.h"
 #include "lvgl_screen/screen_manager.h"
 #include "drivers/stepper/stepper_driver.h"
 #include "drivers/stepper/stepper_mcp23017.h"
+#include "drivers/stepper/stepper_planner.h"
 #include "drivers/gpio_abstraction/gpio_abstraction.h"
 #include "drivers/mcp23017/mcp23017_class.h"
 #include "drivers/logging/logging.h"
+#include "drivers/latency_probe/latency_probe.h"
+#include "drivers/storage/storage_flash.h"
+#include "drivers/storage/flash_log.h"
+#include "drivers/storage/settings_store.h"
+#include "drivers/storage/timeseries.h"
+#include "drivers/scheduler/scheduler.h"
+#include "drivers/dosing/dosing.h"
+#include "drivers/tmc2209/tmc2209.h"
+#include "drivers/pump_tuning/pump_tuning.h"
+#include "drivers/flow_meter/flow_meter.h"
+#include "drivers/zone_manager/zone_manager.h"
+#include "drivers/adc_service/adc_service.h"
+#include "drivers/imu/imu.h"
+#include "drivers/vibration/vibration.h"
+#include "drivers/audio/audio.h"
 
 // Forward declarations
 void set_cpu_clock(uint32_t freq_khz);
@@ -35,16 +60,465 @@ static void initialize_rtc_with_defaults(void);
 static void initialize_stepper_motor(void);
 static void initialize_user_interface(void);
 static void run_main_application_loop(void);
+static void handle_usb_commands(void);
+static void handle_usb_line(const char *line);
 
 // CPU frequency management callback
 static bool cpu_reduced = false;
 
 void cpu_frequency_change_callback(uint32_t freq_khz) {
     set_cpu_clock(freq_khz);
+    audio_clock_changed();
     cpu_reduced = (freq_khz < CONFIG_CPU_FREQ_THRESHOLD);
     LOG_POWER_DEBUG("CPU frequency changed to %lu kHz", freq_khz);
 }
 
+// RTC alarm: raised by the PCF85063 INT line, or found by polling its flag when INT is not wired
+static volatile bool rtc_alarm_pending = false;
+
+#if CONFIG_RTC_INT_PIN >= 0
+static void rtc_gpio_irq(void) {
+    if (gpio_get_irq_event_mask(CONFIG_RTC_INT_PIN) & GPIO_IRQ_EDGE_FALL) {
+        gpio_acknowledge_irq(CONFIG_RTC_INT_PIN, GPIO_IRQ_EDGE_FALL);
+        rtc_alarm_pending = true;
+    }
+}
+#endif
+
+static void rtc_alarm_init(void) {
+#if CONFIG_RTC_INT_PIN >= 0
+    // Open-drain, active low; shared with the touch controller's GPIO callback, so a raw handler
+    gpio_init(CONFIG_RTC_INT_PIN);
+    gpio_set_dir(CONFIG_RTC_INT_PIN, GPIO_IN);
+    gpio_pull_up(CONFIG_RTC_INT_PIN);
+    gpio_add_raw_irq_handler(CONFIG_RTC_INT_PIN, rtc_gpio_irq);
+    gpio_set_irq_enabled(CONFIG_RTC_INT_PIN, GPIO_IRQ_EDGE_FALL, true);
+    irq_set_enabled(IO_IRQ_BANK0, true);
+#endif
+    bsp_pcf85063_clear_alarm_flag();
+}
+
+// True once per alarm; the flag is cleared so the next alarm can be seen
+static bool rtc_alarm_fired(uint32_t now_ms) {
+#if CONFIG_RTC_INT_PIN < 0
+    static uint32_t last_poll_ms = 0;
+    if (!rtc_alarm_pending && now_ms - last_poll_ms >= CONFIG_RTC_ALARM_POLL_MS) {
+        last_poll_ms = now_ms;
+        rtc_alarm_pending = bsp_pcf85063_alarm_fired();
+    }
+#else
+    (void)now_ms;
+#endif
+    if (!rtc_alarm_pending) {
+        return false;
+    }
+    rtc_alarm_pending = false;
+    bsp_pcf85063_clear_alarm_flag();
+    return true;
+}
+
+// Program the RTC alarm for the next watering event so it can wake the system
+static void scheduler_alarm_callback(uint32_t next_due) {
+    if (next_due == SCHEDULER_NEVER) {
+        bsp_pcf85063_disable_alarm();
+        return;
+    }
+    if (next_due <= scheduler_now()) {
+        // Due this very second (e.g. a rule just added): an alarm set now could never match
+        rtc_alarm_pending = true;
+        return;
+    }
+    
+    time_t alarm_time = (time_t)next_due;
+    struct tm alarm_tm;
+    gmtime_r(&alarm_time, &alarm_tm);
+    bsp_pcf85063_set_alarm(&alarm_tm);
+}
+
+// Doses begun since the last main loop pass, for the history
+static volatile uint32_t doses_started_ul;
+
+// Zone valves: open the dose's zone as it begins, close all when done. Within a sequence a new zone
+// opens from the step interrupt while the pump turns, so only the valves are switched here. A valve
+// that does not open drops the dose rather than pumping into the wrong zone
+static bool dosing_start_callback(const dosing_request_t *dose) {
+    if (dose) {
+        if (!zone_manager_open(dose->zone)) {
+            return false;
+        }
+        doses_started_ul += dose->volume_ul;
+    } else {
+        zone_manager_close_all();
+        audio_alert(AUDIO_ALERT_DONE);
+    }
+    return true;
+}
+
+static void record_doses(void) {
+    uint32_t irq_state = save_and_disable_interrupts();
+    uint32_t volume_ul = doses_started_ul;
+    doses_started_ul = 0;
+    restore_interrupts(irq_state);
+    if (volume_ul > 0) {
+        timeseries_insert(TIMESERIES_DOSE_UL, scheduler_now(), (int32_t)volume_ul);
+    }
+}
+
+// Speed tuning pumps real water against the real load, so it needs an open zone
+static bool pump_tuning_callback(bool active) {
+    if (active) {
+        return zone_manager_open(CONFIG_PUMP_TUNING_ZONE);
+    }
+    zone_manager_close_all();
+    return true;
+}
+
+#if CONFIG_FLOW_METER_ENABLED
+// Metered volume for closed-loop dosing: one sensor on the scheduled watering pump's line
+static uint32_t dosing_flow_callback(uint8_t pump) {
+    if (pump != CONFIG_DOSING_PUMP || !flow_meter_is_active(0)) {
+        return DOSING_FLOW_NONE;
+    }
+    return flow_meter_get_volume_ul(0);
+}
+#endif
+
+// Rules are checked when added: the zone is mapped and the volume at most SCHEDULER_MAX_VOLUME_ML
+_Static_assert(SCHEDULER_MAX_VOLUME_ML <= UINT32_MAX / 1000, "a rule's volume must fit in uL");
+
+static void scheduler_event_callback(int rule_id, const schedule_rule_t *rule, uint32_t due) {
+    LOG_SYS_INFO("Scheduled watering: zone %u, %lu mL (rule %d, due %lu)",
+                 rule->zone, rule->volume_ml, rule_id, due);
+    dosing_queue(CONFIG_DOSING_PUMP, rule->zone, rule->volume_ml * 1000, 0);
+}
+
+// Battery voltage from the ADC service (1/3 divider), oversampled to 14 bits
+static uint32_t battery_mv(void) {
+    return 3 * adc_service_to_mv(adc_service_get_oversampled(CONFIG_ADC_BATTERY_CHANNEL, 2), 14);
+}
+
+// Sensor history for the device's history views
+static void record_history(uint32_t now) {
+    if (!adc_service_is_running()) {
+        return;
+    }
+    timeseries_insert(TIMESERIES_MOISTURE, now,
+                      adc_service_get_median((uint8_t)__builtin_ctz(CONFIG_ADC_SOIL_CHANNEL_MASK)));
+    timeseries_insert(TIMESERIES_BATTERY_MV, now, (int32_t)battery_mv());
+    timeseries_insert(TIMESERIES_TEMPERATURE, now, adc_service_temperature_mc() / 10);
+}
+
+// Watering rules live in the settings store, one key per rule id
+_Static_assert(sizeof(schedule_rule_t) <= SETTINGS_MAX_VALUE_LENGTH, "a rule must fit one setting");
+
+static void schedule_rule_key(char *key, int rule_id) {
+    snprintf(key, SETTINGS_MAX_KEY_LENGTH + 1, SETTINGS_KEY_SCHEDULE_PREFIX "%d", rule_id);
+}
+
+// Rules come back lowest id first, so the ids stay stable unless there were gaps to close
+static void load_schedule_rules(void) {
+    char key[SETTINGS_MAX_KEY_LENGTH + 1];
+    
+    for (int stored_id = 0; stored_id < CONFIG_SCHEDULER_STORED_RULES; stored_id++) {
+        schedule_rule_t rule;
+        schedule_rule_key(key, stored_id);
+        if (settings_get(key, &rule, sizeof(rule)) != (int)sizeof(rule)) {
+            continue;
+        }
+        int id = scheduler_add_rule(&rule, scheduler_now());
+        if (id < 0) {
+            LOG_SYS_ERROR("Stored watering rule %d rejected", stored_id);
+        } else if (id != stored_id) {
+            settings_delete(key);
+            schedule_rule_key(key, id);
+            settings_set(key, &rule, sizeof(rule));
+        }
+    }
+    LOG_SYS_INFO("Watering rules loaded: %lu", scheduler_get_rule_count());
+}
+
+static int add_schedule_rule_persisted(const schedule_rule_t *rule) {
+    int id = scheduler_add_rule(rule, scheduler_now());
+    if (id < 0) {
+        return -1;
+    }
+    char key[SETTINGS_MAX_KEY_LENGTH + 1];
+    schedule_rule_key(key, id);
+    if (id >= CONFIG_SCHEDULER_STORED_RULES || !settings_set(key, rule, sizeof(*rule))) {
+        LOG_SYS_ERROR("Watering rule %d could not be stored", id);
+        scheduler_remove_rule(id);
+        return -1;
+    }
+    return id;
+}
+
+static bool remove_schedule_rule_persisted(int rule_id) {
+    if (!scheduler_remove_rule(rule_id)) {
+        return false;
+    }
+    char key[SETTINGS_MAX_KEY_LENGTH + 1];
+    schedule_rule_key(key, rule_id);
+    settings_delete(key);
+    return true;
+}
+
+// Pump calibration: a run of known length into a measuring vessel, then ":cal <uL>" with what came out
+static struct {
+    bool running;
+    uint32_t speed_hz;
+    int32_t steps;              // Steps done by the last run, 0 = nothing to calibrate from
+} calibration_run;
+
+static bool start_calibration_run(uint32_t speed_hz, int32_t steps) {
+    if (steps <= 0 || stepper_driver_is_running() || dosing_is_busy()) {
+        return false;
+    }
+    // The driver clamps the cruise speed the same way
+    uint32_t min_hz = stepper_driver_get_min_frequency();
+    uint32_t max_hz = stepper_driver_get_max_frequency();
+    if (!zone_manager_open(CONFIG_PUMP_CALIBRATION_ZONE)) {
+        zone_manager_close_all();
+        LOG_STEPPER_ERROR("Calibration zone %d did not open, run not started", CONFIG_PUMP_CALIBRATION_ZONE);
+        return false;
+    }
+    calibration_run.speed_hz = speed_hz < min_hz ? min_hz : (speed_hz > max_hz ? max_hz : speed_hz);
+    calibration_run.steps = 0;
+    calibration_run.running = true;
+    stepper_driver_start_at(steps, calibration_run.speed_hz);
+    return true;
+}
+
+static void calibration_run_process(void) {
+    if (!calibration_run.running || stepper_driver_is_running()) {
+        return;
+    }
+    calibration_run.running = false;
+    calibration_run.steps = stepper_driver_get_current_steps();
+    zone_manager_close_all();
+    LOG_STEPPER_INFO("Calibration run done: %ld steps at %lu Hz, send :cal <uL> with the measured volume",
+                     calibration_run.steps, calibration_run.speed_hz);
+}
+
+// Runtime changes to persisted settings: applied, then staged for the settings store
+static void set_log_level_persisted(log_level_t level) {
+    log_set_level(level);
+    settings_set_u32(SETTINGS_KEY_LOG_LEVEL, level);
+}
+
+static void set_brightness_persisted(uint8_t percent) {
+    bsp_lcd_brightness_set(percent);
+    settings_set_u32(SETTINGS_KEY_LCD_BRIGHTNESS, percent);
+}
+
+static bool set_frequency_limits_persisted(uint32_t min_hz, uint32_t max_hz) {
+    if (!stepper_driver_set_frequency_limits(min_hz, max_hz)) {
+        return false;
+    }
+    settings_set_u32(SETTINGS_KEY_STEPPER_MIN_HZ, min_hz);
+    settings_set_u32(SETTINGS_KEY_STEPPER_MAX_HZ, max_hz);
+    return true;
+}
+
+// Commands with arguments: ':' starts a line, Enter runs it (e.g. ":bright 60")
+// Zones and weekday masks out of range are rejected rather than cut to 8 bits
+static void handle_usb_line(const char *line) {
+    unsigned long a, b, c, d, e;
+    
+    if (sscanf(line, "rule %lu %lu %lu:%lu %lu", &a, &b, &c, &d, &e) == 5 &&
+        a <= UINT8_MAX && b <= SCHEDULE_EVERY_DAY && c < 24 && d < 60) {
+        schedule_rule_t rule = {
+            .type = SCHEDULE_WEEKLY,
+            .zone = (uint8_t)a,
+            .weekday_mask = (uint8_t)b,
+            .time_of_day_s = (uint32_t)(c * 3600 + d * 60),
+            .volume_ml = (uint32_t)e,
+        };
+        int id = add_schedule_rule_persisted(&rule);
+        if (id >= 0) {
+            LOG_SYS_INFO("Watering rule %d: zone %lu, days 0x%02lx at %02lu:%02lu, %lu mL", id, a, b, c, d, e);
+        }
+    } else if (sscanf(line, "every %lu %lu %lu", &a, &b, &c) == 3 &&
+               a <= UINT8_MAX && b > 0 && b <= CONFIG_SCHEDULER_MAX_INTERVAL_MIN) {
+        uint32_t interval_s = (uint32_t)b * 60;
+        schedule_rule_t rule = {
+            .type = SCHEDULE_INTERVAL,
+            .zone = (uint8_t)a,
+            .interval_s = interval_s,
+            .anchor = scheduler_now() + interval_s,
+            .volume_ml = (uint32_t)c,
+        };
+        int id = add_schedule_rule_persisted(&rule);
+        if (id >= 0) {
+            LOG_SYS_INFO("Watering rule %d: zone %lu every %lu min, %lu mL", id, a, b, c);
+        }
+    } else if (sscanf(line, "unrule %lu", &a) == 1) {
+        if (remove_schedule_rule_persisted((int)a)) {
+            LOG_SYS_INFO("Watering rule %lu removed", a);
+        } else {
+            LOG_SYS_WARN("No watering rule %lu", a);
+        }
+    } else if (sscanf(line, "dose %lu %lu", &a, &b) == 2 && a <= UINT8_MAX && b > 0 && b <= SCHEDULER_MAX_VOLUME_ML) {
+        if (dosing_queue(CONFIG_DOSING_PUMP, (uint8_t)a, (uint32_t)b * 1000, 0)) {
+            LOG_SYS_INFO("Manual dose queued: zone %lu, %lu mL", a, b);
+        } else {
+            LOG_SYS_WARN("Manual dose refused: no valve for zone %lu, or the queue is full", a);
+        }
+    } else if (sscanf(line, "calrun %lu %lu", &a, &b) == 2) {
+        if (!start_calibration_run((uint32_t)a, (int32_t)b)) {
+            LOG_STEPPER_WARN("Calibration run not started (pump busy, no steps or no open zone)");
+        }
+    } else if (sscanf(line, "cal %lu", &a) == 1) {
+        if (calibration_run.running || calibration_run.steps <= 0) {
+            LOG_STEPPER_WARN("No finished calibration run (:calrun <Hz> <steps> first)");
+        } else if (dosing_calibrate(CONFIG_DOSING_PUMP, calibration_run.speed_hz, calibration_run.steps, (uint32_t)a)) {
+            calibration_run.steps = 0;
+        }
+    } else if (strcmp(line, "uncal") == 0) {
+        dosing_cal_point_t none[1];
+        if (dosing_set_calibration(CONFIG_DOSING_PUMP, none, 0)) {
+            LOG_STEPPER_INFO("Pump %d calibration cleared", CONFIG_DOSING_PUMP);
+        }
+    } else if (sscanf(line, "log %lu", &a) == 1 && a <= LOG_LEVEL_NONE) {
+        set_log_level_persisted((log_level_t)a);
+    } else if (sscanf(line, "bright %lu", &a) == 1 && a <= 100) {
+        set_brightness_persisted((uint8_t)a);
+        LOG_SYS_INFO("Brightness set to %lu%%", a);
+    } else if (sscanf(line, "freq %lu %lu", &a, &b) == 2) {
+        if (set_frequency_limits_persisted(a, b)) {
+            LOG_STEPPER_INFO("Step frequency limits set to %lu-%lu Hz", a, b);
+        } else {
+            LOG_STEPPER_ERROR("Step frequency limits %lu-%lu Hz rejected", a, b);
+        }
+    } else {
+        LOG_SYS_WARN("Unknown command line: %s", line);
+    }
+}
+
+// Single-character commands over USB stdio (non-blocking)
+static void handle_usb_commands(void) {
+    static char line[CONFIG_USB_LINE_LENGTH];
+    static int line_length = -1;    // -1: not collecting a ':' line
+    
+    int c = getchar_timeout_us(0);
+    if (c == PICO_ERROR_TIMEOUT) {
+        return;
+    }
+    
+    if (line_length >= 0) {
+        if (c == '\r' || c == '\n') {
+            line[line_length] = '\0';
+            line_length = -1;
+            handle_usb_line(line);
+        } else if (line_length < CONFIG_USB_LINE_LENGTH - 1) {
+            line[line_length++] = (char)c;
+        }
+        return;
+    }
+    
+    switch (c) {
+        case ':':   // Start a command line with arguments (see handle_usb_line)
+            line_length = 0;
+            break;
+        case 'l':   // Dump input-to-photon latency histograms
+            latency_probe_dump();
+            break;
+        case 'L':   // Clear latency histograms
+            latency_probe_reset();
+            LOG_SYS_INFO("Latency histograms cleared");
+            break;
+        case 't':   // Toggle between text and binary (host-decoded) logging
+            log_set_backend(g_log_backend == LOG_BACKEND_TEXT ? LOG_BACKEND_BINARY : LOG_BACKEND_TEXT);
+            break;
+        case 'b':   // Benchmark per-call logging cost of both backends
+            log_benchmark(256);
+            break;
+        case 'f':   // Stream the whole persistent flash log
+            flash_log_stream_start(0, 0);
+            break;
+        case 'F':   // Stream the persistent flash log of the current boot only
+            flash_log_stream_start(flash_log_get_boot_id(), 0);
+            break;
+        case 's':   // Dump persisted settings
+            settings_dump();
+            break;
+        case 'w':   // Dump watering schedule
+            scheduler_dump();
+            break;
+        case 'd':   // Dump dose queue and pump calibration
+            dosing_dump();
+            break;
+        case 'm':   // Dump TMC2209 registers, driver status, stall monitor and flow meter
+            tmc2209_dump();
+            pump_tuning_dump();
+            flow_meter_dump();
+            break;
+        case 'z':   // Dump zone valve mapping and outputs
+            zone_manager_dump();
+            break;
+        case 'a':   // Dump ADC channels (battery, soil moisture, temperature)
+            adc_service_dump();
+            LOG_SYS_INFO("Battery: %lu mV", battery_mv());
+            break;
+        case 'i':   // Dump IMU FIFO statistics, tilt and knocks
+            imu_dump();
+            break;
+        case 'v':   // Dump pump vibration bands against the baseline
+            vibration_dump();
+            break;
+        case 'V':   // Learn the vibration baseline from the next capture at cruise
+            vibration_learn_baseline();
+            break;
+        case 'r':   // Dump display frame rate and per-core render/flush time
+            lv_port_dump();
+            break;
+        case 'R':   // Restart the display statistics window (e.g. before a transition or scroll)
+            lv_port_reset_stats();
+            break;
+        case 'g':   // Benchmark the RGB565 blend kernels against LVGL's
+            lv_port_blend_benchmark();
+            break;
+        case 'G':   // Benchmark DMA against CPU fills and copies per area size (threshold tuning)
+            lv_port_dma_benchmark();
+            break;
+        case 'c':   // Dump the glyph cache hit rate and benchmark text rendering cached against uncached
+            lv_port_glyph_benchmark();
+            break;
+        case 'C':   // Benchmark a full-screen render with LVGL's corner masks against cached corners
+            lv_port_corner_benchmark();
+            break;
+        case 'n':   // Dump the retained screen copies (time-to-first-frame is in 'r')
+            lv_port_frame_dump();
+            break;
+        case 'u':   // Dump audio refill timing and underruns
+            audio_dump();
+            break;
+        case 'U':   // Play the alarm and the chime together (mixer test)
+            audio_alert(AUDIO_ALERT_ALARM);
+            audio_alert(AUDIO_ALERT_DONE);
+            break;
+        case 'h':   // Dump time-series store usage per tier
+            timeseries_dump();
+            break;
+        case 'T':   // Tune the maximum pump speed (stores the result)
+            if (!pump_tuning_start()) {
+                LOG_SYS_WARN("Pump tuning not available (no TMC2209 or pump busy)");
+            }
+            break;
+        case 'p':   // Pause / resume the pump, keeping the remaining steps
+            if (stepper_driver_is_paused()) {
+                stepper_driver_resume();
+            } else {
+                stepper_driver_pause();
+            }
+            break;
+        case 'x':   // Emergency stop of the pump
+            stepper_driver_stop();
+            break;
+        default:
+            break;
+    }
+}
+
 void set_cpu_clock(uint32_t freq_khz)
 {
     set_sys_clock_khz(freq_khz, true);
@@ -62,6 +536,18 @@ int main() {
     
     // Initialize logging system early
     log_init();
+    if (storage_flash_init()) {
+        flash_log_init();
+        settings_init();
+        timeseries_init();
+    }
+    
+    // Apply persisted log level (falls back to the compiled-in default)
+    uint32_t log_level = settings_get_u32(SETTINGS_KEY_LOG_LEVEL, g_current_log_level);
+    if (log_level != (uint32_t)g_current_log_level) {
+        log_set_level((log_level_t)log_level);
+    }
+    latency_probe_init();
     
     LOG_SYS_INFO("PicoFlora - Smart Plant Watering Station Starting...");
     LOG_SYS_INFO("Version: %s", CONFIG_VERSION_STRING);
@@ -72,14 +558,25 @@ int main() {
     bsp_i2c_init();
     lv_port_init();
     bsp_lcd_brightness_init();
-    bsp_lcd_brightness_set(CONFIG_LCD_DEFAULT_BRIGHTNESS);
+    uint32_t brightness = settings_get_u32(SETTINGS_KEY_LCD_BRIGHTNESS, CONFIG_LCD_DEFAULT_BRIGHTNESS);
+    bsp_lcd_brightness_set(brightness <= 100 ? brightness : CONFIG_LCD_DEFAULT_BRIGHTNESS);
     bsp_pcf85063_init();
     LOG_SYS_INFO("Hardware peripherals initialized");
     
     // Check if RTC has valid time, set default if needed
     struct tm now_tm;
     bsp_pcf85063_get_time(&now_tm);
-    if (now_tm.tm_year < CONFIG_RTC_MIN_YEAR_OFFSET || now_tm.tm_year > CONFIG_RTC_MAX_YEAR_OFFSET) {
+    uint32_t last_known_time = settings_get_u32(SETTINGS_KEY_RTC_LAST_TIME, 0);
+    if ((now_tm.tm_year < CONFIG_RTC_MIN_YEAR_OFFSET || now_tm.tm_year > CONFIG_RTC_MAX_YEAR_OFFSET) &&
+        last_known_time != 0) {
+        // Lost time (e.g. backup supply ran out) - the last time seen beats the build default
+        time_t restored = (time_t)last_known_time;
+        gmtime_r(&restored, &now_tm);
+        bsp_pcf85063_set_time(&now_tm);
+        LOG_RTC_INFO("RTC time invalid, restored last known time: %04d-%02d-%02d %02d:%02d:%02d",
+                    now_tm.tm_year + 1900, now_tm.tm_mon + 1, now_tm.tm_mday,
+                    now_tm.tm_hour, now_tm.tm_min, now_tm.tm_sec);
+    } else if (now_tm.tm_year < CONFIG_RTC_MIN_YEAR_OFFSET || now_tm.tm_year > CONFIG_RTC_MAX_YEAR_OFFSET) {
         LOG_RTC_INFO("RTC time invalid, setting default time");
         // Set default time from configuration
         now_tm.tm_year = CONFIG_RTC_DEFAULT_YEAR - 1900; // Year since 1900
@@ -97,8 +594,16 @@ int main() {
         LOG_RTC_INFO("RTC time valid: %04d-%02d-%02d %02d:%02d:%02d", 
                     now_tm.tm_year + 1900, now_tm.tm_mon + 1, now_tm.tm_mday,
                     now_tm.tm_hour, now_tm.tm_min, now_tm.tm_sec);
+        settings_set_u32(SETTINGS_KEY_RTC_LAST_TIME, (uint32_t)mktime(&now_tm));
     }
     
+    // Start the watering scheduler on the RTC time base
+    scheduler_init();
+    scheduler_set_alarm_callback(scheduler_alarm_callback);
+    scheduler_set_event_callback(scheduler_event_callback);
+    scheduler_sync_clock((uint32_t)mktime(&now_tm));
+    rtc_alarm_init();
+    
     // Initialize GPIO abstraction layer
     LOG_HW_INFO("Initializing GPIO abstraction layer...");
     gpio_abstraction_init();
@@ -130,6 +635,70 @@ int main() {
         }
     }
     
+    // Zone valves switch from the step interrupt during dosing: it waits while the main loop is on the bus
+    if (stepper_driver_get_mark_irq() != 0) {
+        bsp_i2c_share_with_irq(stepper_driver_get_mark_irq());
+    }
+    
+    // Zone valves, all closed: port B of the stepper's expander, then the manifold expanders
+    zone_manager_init();
+    zone_manager_add_valves(0, CONFIG_MCP23017_ADDRESS, 8 + CONFIG_VALVE_FIRST_PIN, CONFIG_VALVE_ZONE_COUNT);  // B0 = pin 8
+    for (int i = 0; i < CONFIG_VALVE_MANIFOLD_COUNT; i++) {
+        zone_manager_add_valves(CONFIG_VALVE_ZONE_COUNT + i * 16, CONFIG_VALVE_MANIFOLD_FIRST_ADDRESS + i, 0, 16);
+    }
+    
+    // Stored watering rules, now that the zones they water are known
+    scheduler_set_zone_count(zone_manager_get_zone_count());
+    load_schedule_rules();
+    
+    // Battery, soil moisture and die temperature, converted continuously into a DMA buffer
+    adc_service_init((1u << CONFIG_ADC_BATTERY_CHANNEL) | CONFIG_ADC_SOIL_CHANNEL_MASK |
+                     (1u << ADC_SERVICE_TEMP_CHANNEL), CONFIG_ADC_RATE_HZ);
+    
+    // Onboard IMU: FIFO at full rate, drained in bursts for tilt and knock detection
+    if (!imu_init(CONFIG_IMU_INT_PIN)) {
+        LOG_SYS_WARN("QMI8658 not available, no tilt or knock detection");
+    }
+    
+    // Pump vibration spectrum from the IMU batches, compared with the stored baseline
+    vibration_init();
+    
+    // Alert sounds over I2S, mixed and refilled from the DMA IRQ
+    if (!audio_init()) {
+        LOG_SYS_WARN("Audio not available, alerts are silent");
+    }
+    
+    // TMC2209 over UART: runtime microstepping, faster cruise with coarser steps
+    uint32_t default_max_freq = STEPPER_MAX_FREQ_HZ;
+    if (tmc2209_init(CONFIG_TMC2209_UART, CONFIG_TMC2209_TX_PIN, CONFIG_TMC2209_RX_PIN, CONFIG_TMC2209_ADDRESS) &&
+        tmc2209_set_microsteps(STEPPER_MICROSTEPS) &&
+        stepper_driver_set_microstep_switch(tmc2209_set_microsteps, CONFIG_STEPPER_CRUISE_MICROSTEPS)) {
+        default_max_freq = CONFIG_STEPPER_COARSE_MAX_FREQ_HZ;
+    }
+    
+    // Apply persisted step frequency limits, if any
+    uint32_t min_freq = settings_get_u32(SETTINGS_KEY_STEPPER_MIN_HZ, STEPPER_MIN_FREQ_HZ);
+    uint32_t max_freq = settings_get_u32(SETTINGS_KEY_STEPPER_MAX_HZ, default_max_freq);
+    if (min_freq != stepper_driver_get_min_frequency() || max_freq != stepper_driver_get_max_frequency()) {
+        stepper_driver_set_frequency_limits(min_freq, max_freq);
+    }
+    
+    // Volumetric dosing on top of the stepper (loads pump calibration)
+    dosing_init();
+    dosing_set_start_callback(dosing_start_callback);
+    dosing_set_zone_count(zone_manager_get_zone_count());
+    
+#if CONFIG_FLOW_METER_ENABLED
+    // Flow sensor on the pump outlet: doses are corrected against the metered volume
+    if (flow_meter_init(0, CONFIG_FLOW_METER_PIN, CONFIG_FLOW_METER_PULSES_PER_LITRE)) {
+        dosing_set_flow_callback(dosing_flow_callback);
+    }
+#endif
+    
+    // Stall detection and speed tuning on top of dosing (retries stalled doses slower)
+    pump_tuning_init();
+    pump_tuning_set_callback(pump_tuning_callback);
+    
     // Initialize screen manager
     screen_manager_init();
     screen_manager_set_cpu_callback(cpu_frequency_change_callback);
@@ -140,6 +709,7 @@ int main() {
     
     main_screen_create();
     screen_manager_add_screen(SCREEN_MAIN, main_screen_get_screen());
+    lv_port_frame_retain(main_screen_get_screen());  // Static menu: shown from a copy in RAM, not re-rendered
     
     stepper_screen_create();
     screen_manager_add_screen(SCREEN_STEPPER, stepper_screen_get_screen());
@@ -147,16 +717,22 @@ int main() {
     time_settings_screen_create();
     screen_manager_add_screen(SCREEN_TIME_SETTINGS, time_settings_screen_get_screen());
     
+    history_screen_create();
+    screen_manager_add_screen(SCREEN_HISTORY, history_screen_get_screen());
+    
     // Start with lock screen
     screen_manager_switch_to(SCREEN_LOCK);
     LOG_UI_INFO("User interface initialized with lock screen");
     
     LOG_SYS_INFO("PicoFlora Started Successfully");
     
+    uint32_t last_rtc_sync_ms = to_ms_since_boot(get_absolute_time());
+    uint32_t last_history_ms = last_rtc_sync_ms;
+    
     // Main loop
     while (true) {
         // Handle LVGL tasks
-        lv_timer_handler();
+        uint32_t lvgl_idle_ms = lv_timer_handler();
         
         // Update screen manager (handles timeout)
         screen_manager_update();
@@ -166,20 +742,78 @@ int main() {
             cpu_frequency_change_callback(CONFIG_CPU_FREQ_LOW_KHZ);
         }
         
+        // Fire watering events when the RTC alarm goes off. The clock is also corrected
+        // against the RTC now and then, which catches an event whose alarm was missed
+        uint32_t now_ms = to_ms_since_boot(get_absolute_time());
+        if (rtc_alarm_fired(now_ms) || now_ms - last_rtc_sync_ms >= CONFIG_SCHEDULER_RESYNC_MS) {
+            struct tm rtc_tm;
+            bsp_pcf85063_get_time(&rtc_tm);
+            scheduler_sync_clock((uint32_t)mktime(&rtc_tm));
+            scheduler_process(scheduler_now());
+            last_rtc_sync_ms = now_ms;
+        }
+        
+        // Sample the sensor history and close finished rollup buckets
+        if (now_ms - last_history_ms >= CONFIG_HISTORY_SAMPLE_MS) {
+            record_history(scheduler_now());
+            last_history_ms = now_ms;
+        }
+        timeseries_process(scheduler_now());
+        
         // Update stepper motor state
         stepper_driver_update();
         
+        // Watch for pump stalls at cruise and step the speed tuning along
+        pump_tuning_process();
+        
+        // Hand over between planned segments (dose bookkeeping; zone valves switch in the step interrupt)
+        stepper_planner_process();
+        calibration_run_process();
+        
+        // Collect flow meter pulses, then start queued doses or correct the running one
+        flow_meter_process();
+        dosing_process();
+        record_doses();
+        
+        // Drain the IMU FIFO when its watermark is reached
+        imu_process();
+        vibration_process();
+        
         // Update UI with stepper progress (only when on stepper screen)
         if (screen_manager_get_current() == SCREEN_STEPPER) {
             stepper_screen_update_progress();
         }
         
+        // Pull new history samples into the chart (only when on history screen)
+        if (screen_manager_get_current() == SCREEN_HISTORY) {
+            history_screen_update();
+        }
+        
         // Update lock screen time display (only when on lock screen and after fade completes)
         if (screen_manager_lock_screen_ready_for_updates()) {
             lock_screen_update_time();
         }
         
-        sleep_ms(CONFIG_MAIN_LOOP_DELAY_MS);
+        // Service host commands (latency dump, ...)
+        handle_usb_commands();
+        
+        // Ship deferred binary log records while idle
+        log_process();
+        
+        // Write queued log pages to flash and keep a spare sector erased
+        flash_log_process();
+        
+        // Commit settings changes once they have settled
+        settings_process();
+        
+        // Locked with the pump idle, sleep until LVGL's next timer; any interrupt (RTC alarm,
+        // touch, USB) ends the wait early
+        if (screen_manager_should_reduce_cpu() && !stepper_driver_is_running() && !dosing_is_busy()) {
+            uint32_t wait_ms = MAX(CONFIG_MAIN_LOOP_DELAY_MS, MIN(lvgl_idle_ms, CONFIG_MAIN_LOOP_IDLE_MS));
+            best_effort_wfe_or_timeout(make_timeout_time_ms(wait_ms));
+        } else {
+            sleep_ms(CONFIG_MAIN_LOOP_DELAY_MS);
+        }
     }
     
     return 0;
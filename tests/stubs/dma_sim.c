@@ -0,0 +1,259 @@
+/**
+ * Host model of the DMA channels - see hardware/dma.h
+ *
+ * Paced transfers happen one at a time when the test calls
+ * stub_dma_transfer(), standing in for the channel's DREQ; unpaced channels
+ * run to the end as soon as they are started. Address increments, the
+ * address ring wrap, endless transfer counts and chaining behave as on the
+ * chip. A transfer into a channel's registers programs it through the
+ * aliases, trigger and null trigger included (control blocks, rewinds).
+ * A channel that completes raises its IRQ 1 flag if enabled; the test runs
+ * the handler by checking and acknowledging it, like the BSP's dispatcher.
+ */
+
+#include "hardware/dma.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ENDLESS_MODE 0xF0000000u
+#define REGS_PER_CHANNEL 16
+
+static struct {
+    bool claimed;
+    bool busy;
+    bool irq1_enabled;
+    bool irq1_pending;
+    dma_channel_config config;
+    uint32_t reload_count;
+} channels[NUM_DMA_CHANNELS];
+
+dma_hw_t stub_dma_hw __attribute__((aligned(64)));
+
+static bool running_unpaced;
+
+// Host pointer to a 32-bit bus address; stops the test if the pointer does not fit
+static uint32_t bus_addr(const volatile void *ptr) {
+    if ((uintptr_t)ptr > UINT32_MAX) {
+        fprintf(stderr, "DMA model: address %p above 4 GB (is the test linked without PIE?)\n", (const void *)ptr);
+        abort();
+    }
+    return (uint32_t)(uintptr_t)ptr;
+}
+
+void stub_dma_reset(void) {
+    memset(channels, 0, sizeof(channels));
+    memset(&stub_dma_hw, 0, sizeof(stub_dma_hw));
+}
+
+int dma_claim_unused_channel(bool required) {
+    (void)required;
+    for (uint ch = 0; ch < NUM_DMA_CHANNELS; ch++) {
+        if (!channels[ch].claimed) {
+            channels[ch].claimed = true;
+            return (int)ch;
+        }
+    }
+    return -1;
+}
+
+void dma_channel_unclaim(uint channel) {
+    channels[channel].claimed = false;
+}
+
+dma_channel_config dma_channel_get_default_config(uint channel) {
+    return (dma_channel_config){ .size = DMA_SIZE_32, .read_increment = true, .write_increment = false,
+                                 .dreq = DREQ_FORCE, .chain_to = channel };
+}
+
+void channel_config_set_transfer_data_size(dma_channel_config *config, enum dma_channel_transfer_size size) {
+    config->size = size;
+}
+
+void channel_config_set_read_increment(dma_channel_config *config, bool increment) {
+    config->read_increment = increment;
+}
+
+void channel_config_set_write_increment(dma_channel_config *config, bool increment) {
+    config->write_increment = increment;
+}
+
+void channel_config_set_ring(dma_channel_config *config, bool write, uint size_bits) {
+    config->ring_write = write;
+    config->ring_bits = size_bits;
+}
+
+void channel_config_set_dreq(dma_channel_config *config, uint dreq) {
+    config->dreq = dreq;
+}
+
+void channel_config_set_chain_to(dma_channel_config *config, uint chain_to) {
+    config->chain_to = chain_to;
+}
+
+// Busy unpaced channels take turns, one transfer each, until all are done; not reentered from a transfer
+static void run_unpaced(void) {
+    if (running_unpaced) {
+        return;
+    }
+    running_unpaced = true;
+    bool progress = true;
+    while (progress) {
+        progress = false;
+        for (uint ch = 0; ch < NUM_DMA_CHANNELS; ch++) {
+            if (channels[ch].config.dreq == DREQ_FORCE && channels[ch].busy) {
+                progress |= stub_dma_transfer(ch);
+            }
+        }
+    }
+    running_unpaced = false;
+}
+
+static void trigger(uint channel) {
+    if (channels[channel].reload_count == 0) {
+        fprintf(stderr, "DMA model: channel %u triggered with a zero transfer count\n", channel);
+        abort();
+    }
+    stub_dma_hw.ch[channel].transfer_count = channels[channel].reload_count;
+    channels[channel].busy = true;
+    run_unpaced();
+}
+
+void dma_channel_set_config(uint channel, const dma_channel_config *config, bool trig) {
+    channels[channel].config = *config;
+    if (trig) {
+        trigger(channel);
+    }
+}
+
+void dma_channel_set_read_addr(uint channel, const volatile void *read_addr, bool trig) {
+    stub_dma_hw.ch[channel].read_addr = bus_addr(read_addr);
+    if (trig) {
+        trigger(channel);
+    }
+}
+
+void dma_channel_set_write_addr(uint channel, volatile void *write_addr, bool trig) {
+    stub_dma_hw.ch[channel].write_addr = bus_addr(write_addr);
+    if (trig) {
+        trigger(channel);
+    }
+}
+
+void dma_channel_set_trans_count(uint channel, uint32_t trans_count, bool trig) {
+    channels[channel].reload_count = trans_count;
+    stub_dma_hw.ch[channel].transfer_count = trans_count;
+    if (trig) {
+        trigger(channel);
+    }
+}
+
+void dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *write_addr,
+                           const volatile void *read_addr, uint32_t transfer_count, bool trig) {
+    dma_channel_set_config(channel, config, false);
+    dma_channel_set_write_addr(channel, write_addr, false);
+    dma_channel_set_read_addr(channel, read_addr, false);
+    dma_channel_set_trans_count(channel, transfer_count, trig);
+}
+
+void dma_channel_start(uint channel) {
+    trigger(channel);
+}
+
+bool dma_channel_is_busy(uint channel) {
+    return channels[channel].busy;
+}
+
+uint32_t dma_encode_endless_transfer_count(void) {
+    return ENDLESS_MODE;
+}
+
+dma_channel_hw_t *dma_channel_hw_addr(uint channel) {
+    return &stub_dma_hw.ch[channel];
+}
+
+void dma_channel_set_irq1_enabled(uint channel, bool enabled) {
+    channels[channel].irq1_enabled = enabled;
+}
+
+bool dma_channel_get_irq1_status(uint channel) {
+    return channels[channel].irq1_pending;
+}
+
+void dma_channel_acknowledge_irq1(uint channel) {
+    channels[channel].irq1_pending = false;
+}
+
+bool stub_dma_is_busy(uint channel) {
+    return channels[channel].busy;
+}
+
+// A word written into a channel's registers: the aliases map onto the four registers, the last of each group triggers
+static void write_register(uint channel, uint reg, uint32_t value) {
+    dma_channel_hw_t *regs = &stub_dma_hw.ch[channel];
+    switch (reg) {
+    case 0: case 5: case 10: case 15:
+        regs->read_addr = value;
+        break;
+    case 1: case 6: case 11: case 13:
+        regs->write_addr = value;
+        break;
+    case 2: case 7: case 9: case 14:
+        channels[channel].reload_count = value;
+        regs->transfer_count = value;
+        break;
+    default:
+        break;                              // CTRL: the model keeps the configuration from dma_channel_set_config()
+    }
+    if ((reg == 3 || reg == 7 || reg == 11 || reg == 15) && value != 0) {
+        trigger(channel);
+    }
+}
+
+static uint32_t advance(uint32_t addr, uint32_t size, bool wrap, uint ring_bits) {
+    if (!wrap || ring_bits == 0) {
+        return addr + size;
+    }
+    uint32_t mask = (1u << ring_bits) - 1;
+    return (addr & ~mask) | ((addr + size) & mask);
+}
+
+bool stub_dma_transfer(uint channel) {
+    if (channel >= NUM_DMA_CHANNELS || !channels[channel].busy) {
+        return false;
+    }
+    const dma_channel_config *config = &channels[channel].config;
+    dma_channel_hw_t *regs = &stub_dma_hw.ch[channel];
+    uint32_t size = 1u << config->size;
+    uint32_t target = regs->write_addr;
+    uint32_t value = 0;
+    memcpy(&value, (const void *)(uintptr_t)regs->read_addr, size);
+
+    if (config->read_increment) {
+        regs->read_addr = advance(regs->read_addr, size, !config->ring_write, config->ring_bits);
+    }
+    if (config->write_increment) {
+        regs->write_addr = advance(regs->write_addr, size, config->ring_write, config->ring_bits);
+    }
+
+    uint32_t hw_base = bus_addr(&stub_dma_hw);
+    if (target >= hw_base && target < hw_base + sizeof(stub_dma_hw)) {
+        uint32_t offset = (target - hw_base) / sizeof(uint32_t);
+        write_register(offset / REGS_PER_CHANNEL, offset % REGS_PER_CHANNEL, value);
+    } else {
+        memcpy((void *)(uintptr_t)target, &value, size);
+    }
+
+    if ((channels[channel].reload_count & ENDLESS_MODE) == ENDLESS_MODE) {
+        return true;
+    }
+    if (--regs->transfer_count == 0) {
+        channels[channel].busy = false;
+        channels[channel].irq1_pending |= channels[channel].irq1_enabled;
+        uint next = config->chain_to;
+        if (next != channel) {
+            trigger(next);
+        }
+    }
+    return true;
+}
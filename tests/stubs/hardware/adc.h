@@ -0,0 +1,60 @@
+#ifndef TESTS_STUB_HARDWARE_ADC_H
+#define TESTS_STUB_HARDWARE_ADC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "pico/stdlib.h"
+
+// Converter state as the test's model needs it; the test defines stub_adc_hw and does the conversions
+typedef struct {
+    volatile uint32_t fifo;                 // Read by DMA, one result per conversion
+    uint stub_input;                        // AINSEL
+    uint stub_round_robin;                  // RROBIN mask
+    float stub_clkdiv;
+    bool stub_running;
+    bool stub_temp_sensor;
+} adc_hw_t;
+
+extern adc_hw_t stub_adc_hw;
+
+#define adc_hw (&stub_adc_hw)
+
+static inline void adc_init(void) {
+}
+
+static inline void adc_gpio_init(uint gpio) {
+    (void)gpio;
+}
+
+static inline void adc_set_temp_sensor_enabled(bool enable) {
+    adc_hw->stub_temp_sensor = enable;
+}
+
+static inline void adc_select_input(uint input) {
+    adc_hw->stub_input = input;
+}
+
+static inline void adc_set_round_robin(uint input_mask) {
+    adc_hw->stub_round_robin = input_mask;
+}
+
+static inline void adc_fifo_setup(bool en, bool dreq_en, uint16_t dreq_thresh, bool err_in_fifo, bool byte_shift) {
+    (void)en;
+    (void)dreq_en;
+    (void)dreq_thresh;
+    (void)err_in_fifo;
+    (void)byte_shift;
+}
+
+static inline void adc_fifo_drain(void) {
+}
+
+static inline void adc_set_clkdiv(float clkdiv) {
+    adc_hw->stub_clkdiv = clkdiv;
+}
+
+static inline void adc_run(bool run) {
+    adc_hw->stub_running = run;
+}
+
+#endif // TESTS_STUB_HARDWARE_ADC_H
@@ -0,0 +1,21 @@
+#ifndef TESTS_STUB_HARDWARE_CLOCKS_H
+#define TESTS_STUB_HARDWARE_CLOCKS_H
+
+#include <stdint.h>
+
+#define STUB_SYS_CLOCK_HZ 150000000u
+#define STUB_ADC_CLOCK_HZ 48000000u
+
+enum clock_index {
+    clk_ref = 4,
+    clk_sys = 5,
+    clk_peri = 6,
+    clk_usb = 8,
+    clk_adc = 9
+};
+
+static inline uint32_t clock_get_hz(enum clock_index clock) {
+    return clock == clk_adc ? STUB_ADC_CLOCK_HZ : STUB_SYS_CLOCK_HZ;
+}
+
+#endif // TESTS_STUB_HARDWARE_CLOCKS_H
@@ -0,0 +1,95 @@
+/**
+ * Host stand-in for hardware/dma.h, backed by the DMA model in dma_sim.c
+ *
+ * The channel registers are 32 bits wide and laid out as on the chip
+ * (aliases included), since drivers program channels by DMA-ing words into
+ * them. Addresses must therefore fit in 32 bits: the tests are linked
+ * without PIE so that static data and the heap sit low.
+ */
+
+#ifndef TESTS_STUB_HARDWARE_DMA_H
+#define TESTS_STUB_HARDWARE_DMA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "pico/stdlib.h"
+
+#define NUM_DMA_CHANNELS 16
+#define DREQ_ADC 48
+#define DREQ_FORCE 0x3F                     // Unpaced: runs as fast as it can
+
+enum dma_channel_transfer_size {
+    DMA_SIZE_8 = 0,
+    DMA_SIZE_16 = 1,
+    DMA_SIZE_32 = 2
+};
+
+typedef volatile uint32_t io_rw_32;
+
+// Writes by a DMA transfer take effect as on the chip; *_trig aliases start the channel (not a null, 0, write)
+typedef struct {
+    io_rw_32 read_addr;
+    io_rw_32 write_addr;
+    io_rw_32 transfer_count;
+    io_rw_32 ctrl_trig;
+    io_rw_32 al1_ctrl;
+    io_rw_32 al1_read_addr;
+    io_rw_32 al1_write_addr;
+    io_rw_32 al1_transfer_count_trig;
+    io_rw_32 al2_ctrl;
+    io_rw_32 al2_transfer_count;
+    io_rw_32 al2_read_addr;
+    io_rw_32 al2_write_addr_trig;
+    io_rw_32 al3_ctrl;
+    io_rw_32 al3_write_addr;
+    io_rw_32 al3_transfer_count;
+    io_rw_32 al3_read_addr_trig;
+} dma_channel_hw_t;
+
+typedef struct {
+    dma_channel_hw_t ch[NUM_DMA_CHANNELS];
+} dma_hw_t;
+
+extern dma_hw_t stub_dma_hw;
+#define dma_hw (&stub_dma_hw)
+
+typedef struct {
+    enum dma_channel_transfer_size size;
+    bool read_increment;
+    bool write_increment;
+    bool ring_write;
+    uint ring_bits;
+    uint dreq;
+    uint chain_to;
+} dma_channel_config;
+
+int dma_claim_unused_channel(bool required);
+void dma_channel_unclaim(uint channel);
+dma_channel_config dma_channel_get_default_config(uint channel);
+void channel_config_set_transfer_data_size(dma_channel_config *config, enum dma_channel_transfer_size size);
+void channel_config_set_read_increment(dma_channel_config *config, bool increment);
+void channel_config_set_write_increment(dma_channel_config *config, bool increment);
+void channel_config_set_ring(dma_channel_config *config, bool write, uint size_bits);
+void channel_config_set_dreq(dma_channel_config *config, uint dreq);
+void channel_config_set_chain_to(dma_channel_config *config, uint chain_to);
+void dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *write_addr,
+                           const volatile void *read_addr, uint32_t transfer_count, bool trigger);
+void dma_channel_set_config(uint channel, const dma_channel_config *config, bool trigger);
+void dma_channel_set_read_addr(uint channel, const volatile void *read_addr, bool trigger);
+void dma_channel_set_write_addr(uint channel, volatile void *write_addr, bool trigger);
+void dma_channel_set_trans_count(uint channel, uint32_t trans_count, bool trigger);
+void dma_channel_start(uint channel);
+bool dma_channel_is_busy(uint channel);
+uint32_t dma_encode_endless_transfer_count(void);
+dma_channel_hw_t *dma_channel_hw_addr(uint channel);
+void dma_channel_set_irq1_enabled(uint channel, bool enabled);
+bool dma_channel_get_irq1_status(uint channel);
+void dma_channel_acknowledge_irq1(uint channel);
+
+// Model: one transfer of a running channel, as when its DREQ fires; false if it is not running.
+// Unpaced (DREQ_FORCE) channels run to the end as soon as they are started.
+bool stub_dma_transfer(uint channel);
+bool stub_dma_is_busy(uint channel);
+void stub_dma_reset(void);
+
+#endif // TESTS_STUB_HARDWARE_DMA_H
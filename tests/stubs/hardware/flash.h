@@ -0,0 +1,11 @@
+#ifndef TESTS_STUB_HARDWARE_FLASH_H
+#define TESTS_STUB_HARDWARE_FLASH_H
+
+#define FLASH_SECTOR_SIZE 4096u
+#define FLASH_PAGE_SIZE 256u
+
+#ifndef PICO_FLASH_SIZE_BYTES
+#define PICO_FLASH_SIZE_BYTES (4u * 1024u * 1024u)
+#endif
+
+#endif // TESTS_STUB_HARDWARE_FLASH_H
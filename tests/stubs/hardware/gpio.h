@@ -0,0 +1,17 @@
+#ifndef TESTS_STUB_HARDWARE_GPIO_H
+#define TESTS_STUB_HARDWARE_GPIO_H
+
+#include "pico/stdlib.h"
+
+#define GPIO_FUNC_UART 2
+
+static inline void gpio_set_function(uint gpio, int fn) {
+    (void)gpio;
+    (void)fn;
+}
+
+static inline void gpio_pull_up(uint gpio) {
+    (void)gpio;
+}
+
+#endif // TESTS_STUB_HARDWARE_GPIO_H
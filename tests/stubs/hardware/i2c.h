@@ -0,0 +1,21 @@
+#ifndef TESTS_STUB_HARDWARE_I2C_H
+#define TESTS_STUB_HARDWARE_I2C_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct i2c_inst i2c_inst_t;
+
+#define i2c0 ((i2c_inst_t *)0)
+#define i2c1 ((i2c_inst_t *)1)
+
+#define PICO_ERROR_GENERIC (-1)
+
+// Defined by the tests that talk to a modelled bus
+int i2c_write_timeout_us(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop,
+                         unsigned int timeout_us);
+int i2c_read_timeout_us(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop,
+                        unsigned int timeout_us);
+
+#endif // TESTS_STUB_HARDWARE_I2C_H
@@ -0,0 +1,69 @@
+#ifndef TESTS_STUB_HARDWARE_PIO_H
+#define TESTS_STUB_HARDWARE_PIO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "pico/stdlib.h"
+
+#define NUM_PIO_STATE_MACHINES 4
+
+// Programs load and state machines run in the stand-ins for the pioasm headers (stepper.pio.h,
+// flow_meter.pio.h); here are the handles, state machine claims and the RX FIFOs DMA reads from
+typedef struct {
+    uint8_t length;
+} pio_program_t;
+
+typedef struct pio_hw {
+    volatile uint32_t rxf[NUM_PIO_STATE_MACHINES];
+    uint32_t stub_claimed;                  // State machines in use
+    uint32_t stub_enabled;
+} pio_hw_t;
+
+typedef pio_hw_t *PIO;
+
+extern pio_hw_t stub_pio_hw[2];
+
+#define pio0 (&stub_pio_hw[0])
+#define pio1 (&stub_pio_hw[1])
+
+static inline bool pio_can_add_program(PIO pio, const pio_program_t *program) {
+    (void)pio;
+    (void)program;
+    return true;
+}
+
+static inline uint pio_add_program(PIO pio, const pio_program_t *program) {
+    (void)pio;
+    (void)program;
+    return 0;
+}
+
+static inline int pio_claim_unused_sm(PIO pio, bool required) {
+    (void)required;
+    for (int sm = 0; sm < NUM_PIO_STATE_MACHINES; sm++) {
+        if (!(pio->stub_claimed & (1u << sm))) {
+            pio->stub_claimed |= 1u << sm;
+            return sm;
+        }
+    }
+    return -1;
+}
+
+static inline void pio_sm_unclaim(PIO pio, uint sm) {
+    pio->stub_claimed &= ~(1u << sm);
+}
+
+static inline void pio_sm_set_enabled(PIO pio, uint sm, bool enabled) {
+    if (enabled) {
+        pio->stub_enabled |= 1u << sm;
+    } else {
+        pio->stub_enabled &= ~(1u << sm);
+    }
+}
+
+// RX DREQs, numbered as on the chip
+static inline uint pio_get_dreq(PIO pio, uint sm, bool is_tx) {
+    return (uint)(pio - stub_pio_hw) * 8 + (is_tx ? 0 : 4) + sm;
+}
+
+#endif // TESTS_STUB_HARDWARE_PIO_H
@@ -0,0 +1,54 @@
+#ifndef TESTS_STUB_HARDWARE_SYNC_H
+#define TESTS_STUB_HARDWARE_SYNC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Single threaded host: locks only count, so tests can check they are balanced
+typedef volatile uint32_t spin_lock_t;
+
+extern uint32_t stub_lock_depth;
+
+static inline uint32_t save_and_disable_interrupts(void) {
+    stub_lock_depth++;
+    return 0;
+}
+
+static inline void restore_interrupts(uint32_t status) {
+    (void)status;
+    stub_lock_depth--;
+}
+
+static inline int spin_lock_claim_unused(bool required) {
+    (void)required;
+    return 0;
+}
+
+static inline spin_lock_t* spin_lock_instance(unsigned int lock_num) {
+    static spin_lock_t locks[32];
+    return &locks[lock_num];
+}
+
+static inline uint32_t spin_lock_blocking(spin_lock_t* lock) {
+    *lock += 1;
+    stub_lock_depth++;
+    return 0;
+}
+
+static inline void spin_unlock(spin_lock_t* lock, uint32_t status) {
+    (void)status;
+    *lock -= 1;
+    stub_lock_depth--;
+}
+
+static inline void __dmb(void) {
+    __sync_synchronize();
+}
+
+static inline void __sev(void) {
+}
+
+static inline void __wfe(void) {
+}
+
+#endif // TESTS_STUB_HARDWARE_SYNC_H
@@ -0,0 +1,6 @@
+#ifndef TESTS_STUB_HARDWARE_TIMER_H
+#define TESTS_STUB_HARDWARE_TIMER_H
+
+#include "pico/time.h"
+
+#endif // TESTS_STUB_HARDWARE_TIMER_H
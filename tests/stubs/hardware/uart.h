@@ -0,0 +1,22 @@
+#ifndef TESTS_STUB_HARDWARE_UART_H
+#define TESTS_STUB_HARDWARE_UART_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "pico/stdlib.h"
+
+// The line itself is modelled by the test, which defines these
+typedef struct uart_inst uart_inst_t;
+
+extern uart_inst_t *stub_uart0;
+
+#define uart0 stub_uart0
+
+uint uart_init(uart_inst_t *uart, uint baudrate);
+void uart_write_blocking(uart_inst_t *uart, const uint8_t *src, size_t len);
+void uart_tx_wait_blocking(uart_inst_t *uart);
+bool uart_is_readable(uart_inst_t *uart);
+char uart_getc(uart_inst_t *uart);
+
+#endif // TESTS_STUB_HARDWARE_UART_H
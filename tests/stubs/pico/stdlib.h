@@ -0,0 +1,23 @@
+/**
+ * Host stand-in for the Pico SDK headers used by the drivers under test.
+ * Time is a counter the tests advance themselves.
+ */
+
+#ifndef TESTS_STUB_PICO_STDLIB_H
+#define TESTS_STUB_PICO_STDLIB_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "pico/time.h"
+
+typedef unsigned int uint;
+
+static inline void stdio_init_all(void) {
+}
+
+static inline void tight_loop_contents(void) {
+}
+
+#endif // TESTS_STUB_PICO_STDLIB_H
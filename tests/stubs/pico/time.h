@@ -0,0 +1,51 @@
+#ifndef TESTS_STUB_PICO_TIME_H
+#define TESTS_STUB_PICO_TIME_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+typedef uint64_t absolute_time_t;
+
+// Simulated clock in microseconds, advanced by the tests; the host's own clock while stub_time_from_host is set
+extern uint64_t stub_time_us;
+extern bool stub_time_from_host;
+
+static inline uint64_t stub_now_us(void) {
+    if (stub_time_from_host) {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+    }
+    return stub_time_us;
+}
+
+static inline absolute_time_t get_absolute_time(void) {
+    return stub_now_us();
+}
+
+static inline int64_t absolute_time_diff_us(absolute_time_t from, absolute_time_t to) {
+    return (int64_t)(to - from);
+}
+
+static inline uint32_t to_ms_since_boot(absolute_time_t t) {
+    return (uint32_t)(t / 1000);
+}
+
+static inline uint32_t time_us_32(void) {
+    return (uint32_t)stub_now_us();
+}
+
+static inline uint64_t time_us_64(void) {
+    return stub_now_us();
+}
+
+static inline void sleep_ms(uint32_t ms) {
+    stub_time_us += (uint64_t)ms * 1000;
+}
+
+static inline void sleep_us(uint64_t us) {
+    stub_time_us += us;
+}
+
+#endif // TESTS_STUB_PICO_TIME_H
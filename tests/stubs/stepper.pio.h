@@ -0,0 +1,129 @@
+/**
+ * Host stand-in for the header pioasm generates from drivers/stepper/stepper.pio
+ *
+ * The state machine is reduced to what the tests observe: whether it runs,
+ * the pulse rate it was set to and the chunks it was handed. The test plays
+ * the pulses with stub_step_pulse(); the end of a chunk runs the handler the
+ * driver registered, as the RX FIFO interrupt does.
+ */
+
+#ifndef TESTS_STUB_STEPPER_PIO_H
+#define TESTS_STUB_STEPPER_PIO_H
+
+#include "hardware/pio.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef void (*irq_handler_t)(void);
+
+#define STUB_STEP_FIFO 4
+
+extern bool stub_step_enabled;
+extern uint32_t stub_step_frequency;
+extern uint32_t stub_step_fifo[STUB_STEP_FIFO];  // Queued chunks (pulse counts)
+extern uint32_t stub_step_queued;
+extern uint32_t stub_step_left;      // Pulses still to come of the chunk being played
+extern uint32_t stub_step_finished;  // Finished chunks not yet taken
+extern irq_handler_t stub_step_handler;
+
+static const pio_program_t stepper_step_program = { 8 };
+
+static inline void stepper_step_program_init(PIO pio, uint sm, uint offset, uint pin) {
+    (void)pio;
+    (void)sm;
+    (void)offset;
+    (void)pin;
+    stub_step_enabled = false;
+    stub_step_queued = 0;
+    stub_step_left = 0;
+    stub_step_finished = 0;
+}
+
+static inline void stepper_step_set_frequency(PIO pio, uint sm, uint32_t frequency) {
+    (void)pio;
+    (void)sm;
+    stub_step_frequency = frequency;
+}
+
+static inline void stepper_step_push(PIO pio, uint sm, uint32_t pulses) {
+    (void)pio;
+    (void)sm;
+    if (stub_step_queued == STUB_STEP_FIFO || pulses == 0) {
+        fprintf(stderr, "PIO model: chunk of %u pulses pushed with %u queued\n", pulses, stub_step_queued);
+        abort();
+    }
+    stub_step_fifo[stub_step_queued++] = pulses;
+}
+
+static inline uint32_t stepper_step_take_done(PIO pio, uint sm) {
+    (void)pio;
+    (void)sm;
+    uint32_t done = stub_step_finished;
+    stub_step_finished = 0;
+    return done;
+}
+
+static inline uint32_t stepper_step_remaining(PIO pio, uint sm, uint offset, uint32_t pulses) {
+    (void)pio;
+    (void)sm;
+    (void)offset;
+    if (stub_step_enabled) {
+        fprintf(stderr, "PIO model: position read while the state machine runs\n");
+        abort();
+    }
+    return stub_step_left > 0 ? stub_step_left : pulses;  // The chunk that finished was taken
+}
+
+static inline void stepper_step_clear(PIO pio, uint sm, uint offset) {
+    (void)pio;
+    (void)sm;
+    (void)offset;
+    stub_step_queued = 0;
+    stub_step_left = 0;
+    stub_step_finished = 0;
+}
+
+static inline uint stepper_step_set_irq_handler(PIO pio, uint sm, irq_handler_t handler) {
+    (void)pio;
+    (void)sm;
+    stub_step_handler = handler;
+    return 8;
+}
+
+static inline void stepper_step_stop(PIO pio, uint sm) {
+    (void)pio;
+    (void)sm;
+    stub_step_enabled = false;
+}
+
+static inline void stepper_step_start(PIO pio, uint sm) {
+    (void)pio;
+    (void)sm;
+    stub_step_enabled = true;
+}
+
+// One pulse if the state machine runs and has one to give; the end of a chunk interrupts
+static inline bool stub_step_pulse(void) {
+    if (!stub_step_enabled) {
+        return false;
+    }
+    if (stub_step_left == 0) {
+        if (stub_step_queued == 0) {
+            return false;
+        }
+        stub_step_left = stub_step_fifo[0];
+        for (uint32_t i = 1; i < stub_step_queued; i++) {
+            stub_step_fifo[i - 1] = stub_step_fifo[i];
+        }
+        stub_step_queued--;
+    }
+    if (--stub_step_left == 0) {
+        stub_step_finished++;
+        if (stub_step_handler) {
+            stub_step_handler();
+        }
+    }
+    return true;
+}
+
+#endif // TESTS_STUB_STEPPER_PIO_H
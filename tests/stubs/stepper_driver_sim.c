@@ -0,0 +1,322 @@
+/**
+ * Host model of the stepper driver - see stepper_driver_sim.h
+ *
+ * Moves follow the driver's own frequency rules: a planner profile when one
+ * is given, otherwise linear ramps of stepper_driver_get_accel_steps() steps
+ * at both ends. Stops are immediate (stop_smooth and pause included).
+ * Marks are called right after the step they are on, as the chunk
+ * interrupt does, and a refused one stops the move there. A resize is
+ * refused as close ahead as the driver could have handed steps to the PIO
+ * already (all its chunks, full length).
+ */
+
+#include "stepper_driver_sim.h"
+#include "pico/time.h"
+#include <stddef.h>
+
+stub_stepper_step_cb_t stub_stepper_on_step = NULL;
+uint32_t stub_stepper_enables = 0;
+uint32_t stub_stepper_starts = 0;
+
+static struct {
+    stepper_state_t state;
+    int32_t current_steps;
+    int32_t target_steps;
+    uint32_t min_frequency;
+    uint32_t max_frequency;
+    uint32_t cruise_frequency;
+    uint32_t current_frequency;
+    stepper_profile_t profile;
+    bool hold_enable;
+    bool enabled;
+    uint64_t time_fraction_ns;
+    int32_t marks[STEPPER_MAX_MARKS];
+    uint32_t mark_count;
+    uint32_t marks_done;
+    stepper_mark_cb_t mark_callback;
+} sim;
+
+void stub_stepper_reset(void) {
+    sim.state = STEPPER_IDLE;
+    sim.current_steps = 0;
+    sim.target_steps = 0;
+    sim.min_frequency = STEPPER_MIN_FREQ_HZ;
+    sim.max_frequency = STEPPER_MAX_FREQ_HZ;
+    sim.current_frequency = 0;
+    sim.profile = NULL;
+    sim.hold_enable = false;
+    sim.enabled = false;
+    sim.mark_count = 0;
+    sim.mark_callback = NULL;
+    stub_stepper_on_step = NULL;
+    stub_stepper_enables = 0;
+    stub_stepper_starts = 0;
+}
+
+bool stub_stepper_is_enabled(void) {
+    return sim.enabled;
+}
+
+static void enable(void) {
+    if (!sim.enabled) {
+        sim.enabled = true;
+        stub_stepper_enables++;
+        stub_time_us += STEPPER_ENABLE_SETTLE_MS * 1000ull;
+    }
+}
+
+static void begin_move(int32_t target_steps) {
+    enable();
+    sim.current_steps = 0;
+    sim.target_steps = target_steps;
+    sim.state = STEPPER_ACCELERATING;
+    sim.marks_done = 0;
+    stub_stepper_starts++;
+}
+
+// Frequency of the next step, as profile_frequency() in the driver
+static uint32_t step_frequency(void) {
+    if (sim.profile) {
+        uint32_t freq = sim.profile(sim.current_steps);
+        return freq < sim.min_frequency ? sim.min_frequency : freq;
+    }
+
+    int32_t accel = (int32_t)stepper_driver_get_accel_steps(sim.target_steps);
+    int32_t remaining = sim.target_steps - sim.current_steps;
+    uint32_t range = sim.cruise_frequency - sim.min_frequency;
+    if (sim.current_steps < accel) {
+        return sim.min_frequency + range * (uint32_t)sim.current_steps / (uint32_t)accel;
+    }
+    if (remaining < accel) {
+        return sim.min_frequency + range * (uint32_t)remaining / (uint32_t)accel;
+    }
+    return sim.cruise_frequency;
+}
+
+int32_t stub_stepper_run(int32_t max_steps) {
+    int32_t done = 0;
+    while (done < max_steps && stepper_driver_is_running() && sim.state != STEPPER_PAUSED) {
+        // State follows the speed change, as the driver reports it for planned profiles
+        uint32_t freq = step_frequency();
+        if (freq > sim.current_frequency) {
+            sim.state = STEPPER_ACCELERATING;
+        } else if (freq < sim.current_frequency) {
+            sim.state = STEPPER_DECELERATING;
+        } else {
+            sim.state = STEPPER_RUNNING;
+        }
+        sim.current_frequency = freq;
+        sim.current_steps++;
+        done++;
+
+        uint64_t ns = sim.time_fraction_ns + 1000000000ull / freq;
+        stub_time_us += ns / 1000;
+        sim.time_fraction_ns = ns % 1000;
+
+        if (stub_stepper_on_step) {
+            stub_stepper_on_step(sim.current_steps, freq);
+        }
+        bool refused = false;
+        while (sim.marks_done < sim.mark_count && sim.marks[sim.marks_done] <= sim.current_steps) {
+            uint32_t mark = sim.marks_done++;
+            if (sim.mark_callback && !sim.mark_callback(mark)) {
+                refused = true;
+            }
+        }
+        if (refused) {
+            stepper_driver_stop();
+        } else if (sim.current_steps >= sim.target_steps) {
+            stepper_driver_stop();
+            sim.state = STEPPER_COMPLETED;
+        }
+    }
+    return done;
+}
+
+void stepper_driver_init(void) {
+    stub_stepper_reset();
+}
+
+void stepper_driver_init_with_enable_pin(gpio_pin_t *enable_pin) {
+    (void)enable_pin;
+    stub_stepper_reset();
+}
+
+void stepper_driver_start(int32_t target_steps) {
+    stepper_driver_start_at(target_steps, sim.max_frequency);
+}
+
+void stepper_driver_start_at(int32_t target_steps, uint32_t cruise_hz) {
+    if (target_steps <= 0) {
+        return;
+    }
+    if (cruise_hz < sim.min_frequency) cruise_hz = sim.min_frequency;
+    if (cruise_hz > sim.max_frequency) cruise_hz = sim.max_frequency;
+    sim.cruise_frequency = cruise_hz;
+    sim.profile = NULL;
+    sim.mark_count = 0;
+    begin_move(target_steps);
+}
+
+void stepper_driver_start_profile(int32_t target_steps, stepper_profile_t profile) {
+    if (target_steps <= 0 || !profile) {
+        return;
+    }
+    sim.cruise_frequency = sim.max_frequency;
+    sim.profile = profile;
+    begin_move(target_steps);
+}
+
+void stepper_driver_stop(void) {
+    sim.state = STEPPER_IDLE;
+    sim.current_frequency = 0;
+    if (!sim.hold_enable) {
+        sim.enabled = false;
+    }
+}
+
+void stepper_driver_stop_smooth(void) {
+    stepper_driver_stop();
+}
+
+void stepper_driver_pause(void) {
+    if (stepper_driver_is_running()) {
+        sim.state = STEPPER_PAUSED;
+        sim.current_frequency = 0;
+    }
+}
+
+bool stepper_driver_resume(void) {
+    if (sim.state != STEPPER_PAUSED) {
+        return false;
+    }
+    sim.state = STEPPER_RUNNING;
+    return true;
+}
+
+bool stepper_driver_set_target_steps(int32_t target_steps) {
+    return stepper_driver_resize(sim.target_steps, target_steps - sim.target_steps);
+}
+
+bool stepper_driver_resize(int32_t position, int32_t delta) {
+    int32_t committed = sim.current_steps;
+    if (sim.state != STEPPER_PAUSED) {
+        committed += STEPPER_CHUNK_STEPS * (STEPPER_CHUNKS_AHEAD + 1);
+        if (committed > sim.target_steps) committed = sim.target_steps;
+    }
+    if (!sim.profile || !stepper_driver_is_running() || position > sim.target_steps ||
+        position <= committed || position + delta <= committed) {
+        return false;
+    }
+    for (uint32_t i = sim.marks_done; i < sim.mark_count; i++) {
+        if (sim.marks[i] >= position) {
+            sim.marks[i] += delta;
+        }
+    }
+    sim.target_steps += delta;
+    return true;
+}
+
+bool stepper_driver_set_marks(const int32_t *positions, uint32_t count, stepper_mark_cb_t callback) {
+    if (stepper_driver_is_running() || count > STEPPER_MAX_MARKS) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        if (positions[i] <= 0 || (i > 0 && positions[i] <= positions[i - 1])) {
+            return false;
+        }
+        sim.marks[i] = positions[i];
+    }
+    sim.mark_count = count;
+    sim.mark_callback = callback;
+    return true;
+}
+
+void stepper_driver_hold_enable(bool hold) {
+    sim.hold_enable = hold;
+    if (!hold && !stepper_driver_is_running()) {
+        sim.enabled = false;
+    }
+}
+
+void stepper_driver_update(void) {
+}
+
+bool stepper_driver_set_frequency_limits(uint32_t min_hz, uint32_t max_hz) {
+    if (stepper_driver_is_running() ||
+        min_hz < STEPPER_MIN_FREQ_HZ || max_hz > stepper_driver_get_frequency_ceiling() || min_hz >= max_hz) {
+        return false;
+    }
+    sim.min_frequency = min_hz;
+    sim.max_frequency = max_hz;
+    return true;
+}
+
+bool stepper_driver_set_microstep_switch(stepper_microstep_cb_t callback, uint16_t coarse_microsteps) {
+    (void)callback;
+    (void)coarse_microsteps;
+    return false;
+}
+
+bool stepper_driver_is_running(void) {
+    return sim.state != STEPPER_IDLE && sim.state != STEPPER_COMPLETED;
+}
+
+bool stepper_driver_is_paused(void) {
+    return sim.state == STEPPER_PAUSED;
+}
+
+int32_t stepper_driver_get_current_steps(void) {
+    return sim.current_steps;
+}
+
+int32_t stepper_driver_get_target_steps(void) {
+    return sim.target_steps;
+}
+
+stepper_state_t stepper_driver_get_state(void) {
+    return sim.state;
+}
+
+uint32_t stepper_driver_get_current_frequency(void) {
+    return sim.current_frequency;
+}
+
+uint32_t stepper_driver_get_min_frequency(void) {
+    return sim.min_frequency;
+}
+
+uint32_t stepper_driver_get_max_frequency(void) {
+    return sim.max_frequency;
+}
+
+uint32_t stepper_driver_get_frequency_ceiling(void) {
+    return STEPPER_MAX_FREQ_HZ;
+}
+
+uint16_t stepper_driver_get_microsteps(void) {
+    return STEPPER_MICROSTEPS;
+}
+
+uint32_t stepper_driver_get_mark_irq(void) {
+    return 0;
+}
+
+uint32_t stepper_driver_get_accel_steps(int32_t total_steps) {
+    int32_t accel_steps = total_steps / STEPPER_ACCEL_DIVISOR;
+    if (accel_steps < STEPPER_MIN_ACCEL_STEPS) accel_steps = STEPPER_MIN_ACCEL_STEPS;
+    if (accel_steps > STEPPER_MAX_ACCEL_STEPS) accel_steps = STEPPER_MAX_ACCEL_STEPS;
+    return (uint32_t)accel_steps;
+}
+
+void stepper_driver_start_revolutions(float revolutions) {
+    stepper_driver_start((int32_t)(revolutions * STEPPER_STEPS_PER_REV));
+}
+
+float stepper_driver_get_current_revolutions(void) {
+    return (float)sim.current_steps / STEPPER_STEPS_PER_REV;
+}
+
+float stepper_driver_get_target_revolutions(void) {
+    return (float)sim.target_steps / STEPPER_STEPS_PER_REV;
+}
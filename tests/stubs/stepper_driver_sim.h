@@ -0,0 +1,31 @@
+/**
+ * Host model of the stepper driver (drivers/stepper/stepper_driver.c)
+ *
+ * Same API, with the pump turned by the test: stub_stepper_run() plays the
+ * next steps of the move at the frequency the driver would use for each one,
+ * advances the simulated clock by their duration and reports every step to
+ * stub_stepper_on_step, e.g. to integrate what a real pump would deliver.
+ */
+
+#ifndef TESTS_STUB_STEPPER_DRIVER_SIM_H
+#define TESTS_STUB_STEPPER_DRIVER_SIM_H
+
+#include "stepper_driver.h"
+
+// Called for every step with the position it ends at and its frequency
+typedef void (*stub_stepper_step_cb_t)(int32_t position, uint32_t freq_hz);
+
+extern stub_stepper_step_cb_t stub_stepper_on_step;
+extern uint32_t stub_stepper_enables;       // Times the driver was enabled (each costs the settle time)
+extern uint32_t stub_stepper_starts;
+
+// Back to idle, disabled, default frequency limits and no step callback
+void stub_stepper_reset(void);
+
+// Turn the pump by up to max_steps steps of the running move; returns the steps done
+int32_t stub_stepper_run(int32_t max_steps);
+
+// Whether the driver is enabled (held between moves, or running)
+bool stub_stepper_is_enabled(void);
+
+#endif // TESTS_STUB_STEPPER_DRIVER_SIM_H
@@ -0,0 +1,71 @@
+/**
+ * RAM model of drivers/storage/storage_flash.c
+ *
+ * Same API and checks, backed by an array: erase sets a sector to 0xFF and
+ * programming can only clear bits, like NOR flash. Tests reach the array
+ * through stub_flash to inspect or corrupt it.
+ */
+
+#include "storage_flash.h"
+#include <string.h>
+
+uint8_t stub_flash[PICO_FLASH_SIZE_BYTES];
+uint32_t stub_flash_erases = 0;
+uint32_t stub_flash_programs = 0;
+
+static bool offset_in_reserved(uint32_t offset, uint32_t length) {
+    return offset >= STORAGE_RESERVED_OFFSET && offset + length <= PICO_FLASH_SIZE_BYTES;
+}
+
+bool storage_flash_init(void) {
+    memset(stub_flash, 0xFF, sizeof(stub_flash));
+    stub_flash_erases = 0;
+    stub_flash_programs = 0;
+    return true;
+}
+
+const uint8_t* storage_flash_ptr(uint32_t offset) {
+    return &stub_flash[offset];
+}
+
+bool storage_flash_is_erased(uint32_t offset, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        if (stub_flash[offset + i] != 0xFF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool storage_flash_erase_sector(uint32_t offset) {
+    if ((offset % STORAGE_SECTOR_SIZE) != 0 || !offset_in_reserved(offset, STORAGE_SECTOR_SIZE)) {
+        return false;
+    }
+    memset(&stub_flash[offset], 0xFF, STORAGE_SECTOR_SIZE);
+    stub_flash_erases++;
+    return true;
+}
+
+bool storage_flash_program_page(uint32_t offset, const uint8_t* data) {
+    if ((offset % STORAGE_PAGE_SIZE) != 0 || !offset_in_reserved(offset, STORAGE_PAGE_SIZE)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < STORAGE_PAGE_SIZE; i++) {
+        stub_flash[offset + i] &= data[i];
+    }
+    stub_flash_programs++;
+    return true;
+}
+
+uint32_t storage_crc32(uint32_t crc, const void* data, size_t length) {
+    const uint8_t* bytes = (const uint8_t*)data;
+
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= bytes[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+        }
+    }
+    return ~crc;
+}
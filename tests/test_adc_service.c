@@ -0,0 +1,203 @@
+/**
+ * Host tests for the ADC filters (drivers/adc_service/adc_filter.c) and the
+ * free-running ADC service (drivers/adc_service/adc_service.c)
+ *
+ * The converter is modelled by its conversions: each one puts the selected
+ * input's value into the FIFO, fires the DMA request and steps the round
+ * robin, so samples reach the buffer through the DMA model, rewind channel
+ * included.
+ */
+
+#include "test_support.h"
+#include "adc_service.h"
+#include "adc_filter.h"
+#include "hardware/adc.h"
+#include "hardware/dma.h"
+#include "logging.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DATA_DMA 0                          // Claimed first by the service
+
+adc_hw_t stub_adc_hw;
+
+static uint32_t conversions;
+static uint16_t last_value[ADC_SERVICE_CHANNELS];
+static uint32_t rate_hz;
+static uint32_t channel_count;
+
+static int compare_u16(const void *a, const void *b) {
+    return (int)*(const uint16_t *)a - (int)*(const uint16_t *)b;
+}
+
+static uint16_t reference_median(const uint16_t *v, uint32_t n) {
+    uint16_t sorted[9];
+    memcpy(sorted, v, n * sizeof(uint16_t));
+    qsort(sorted, n, sizeof(uint16_t), compare_u16);
+    return sorted[n / 2];
+}
+
+static uint16_t network_median(uint16_t *v, uint32_t n) {
+    return n == 3 ? adc_filter_median3(v) : n == 5 ? adc_filter_median5(v) : adc_filter_median9(v);
+}
+
+// One conversion of the selected input, then on to the next one in the round robin
+static void convert(uint16_t (*signal)(uint channel)) {
+    uint input = adc_hw->stub_input;
+    uint16_t value = signal(input);
+    adc_hw->fifo = value;
+    last_value[input] = value;
+    CHECK(stub_dma_transfer(DATA_DMA));
+
+    do {
+        input = (input + 1) % ADC_SERVICE_CHANNELS;
+    } while (!(adc_hw->stub_round_robin & (1u << input)));
+    adc_hw->stub_input = input;
+
+    conversions++;
+    stub_time_us = (uint64_t)conversions * 1000000 / (rate_hz * channel_count);
+}
+
+// Channel n reads around n * 800 counts with a changing low part; the temperature sensor sits
+// at 0.706 V (27 C) with one count of noise
+static uint16_t test_signal(uint channel) {
+    static uint32_t sequence[ADC_SERVICE_CHANNELS];
+    if (channel == ADC_SERVICE_TEMP_CHANNEL) {
+        return (uint16_t)(876 + (sequence[channel]++ % 5 == 0));
+    }
+    return (uint16_t)(channel * 800 + (sequence[channel]++ * 37) % 800);
+}
+
+static void test_medians_sort_correctly(void) {
+    uint32_t failures = 0;
+    for (uint32_t n = 3; n <= 9; n += 2) {
+        if (n == 7) {
+            continue;
+        }
+        // 0/1 principle: a network that sorts every binary input sorts everything
+        for (uint32_t bits = 0; bits < (1u << n); bits++) {
+            uint16_t v[9];
+            for (uint32_t i = 0; i < n; i++) {
+                v[i] = (bits >> i) & 1;
+            }
+            uint16_t expected = reference_median(v, n);
+            failures += network_median(v, n) != expected;
+        }
+        srand(n);
+        for (int k = 0; k < 20000; k++) {
+            uint16_t v[9];
+            for (uint32_t i = 0; i < n; i++) {
+                v[i] = (uint16_t)(rand() & 4095);
+            }
+            uint16_t expected = reference_median(v, n);
+            failures += network_median(v, n) != expected;
+        }
+    }
+    CHECK_EQ(failures, 0);
+}
+
+static void test_ema(void) {
+    uint16_t samples[64];
+    for (int i = 0; i < 64; i++) {
+        samples[i] = 1000;
+    }
+    CHECK_EQ(adc_filter_ema(samples, 64, 3), 1000);
+    CHECK_EQ(adc_filter_ema(samples, 0, 3), 0);
+
+    // Step half way through: 32 steps of alpha = 1/8 towards full scale
+    for (int i = 0; i < 64; i++) {
+        samples[i] = i < 32 ? 0 : 4095;
+    }
+    double expected = 4095 * (1 - pow(7.0 / 8.0, 32));
+    uint16_t result = adc_filter_ema(samples, 64, 3);
+    printf("  step response %u, expected %.1f\n", result, expected);
+    CHECK(fabs(result - expected) <= 1.0);
+
+    // Small steps are not lost to truncation
+    uint32_t state = 1000u << ADC_FILTER_EMA_FRAC_BITS;
+    for (int i = 0; i < 200; i++) {
+        state = adc_filter_ema_step(state, 1003, 3);
+    }
+    CHECK_EQ((state + 128) >> ADC_FILTER_EMA_FRAC_BITS, 1003);
+}
+
+static void test_decimation(void) {
+    uint16_t samples[64];
+    for (int i = 0; i < 64; i++) {
+        samples[i] = (uint16_t)(2000 + (i & 1));
+    }
+    // 2000.5 counts as a 15-bit value
+    CHECK_EQ(adc_filter_decimate(samples, 64, 3), 16004);
+    CHECK_EQ(adc_filter_decimate(samples, 4, 1), 4001);
+    CHECK_EQ(adc_filter_decimate(samples, 3, 1), 0);
+
+    for (int i = 0; i < 64; i++) {
+        samples[i] = 4095;
+    }
+    CHECK_EQ(adc_filter_decimate(samples, 64, 3), 4095 * 8);
+}
+
+static void test_init_limits(void) {
+    CHECK(!adc_service_init(0, 1000));
+    CHECK(!adc_service_init(0x01, 0));
+    CHECK(!adc_service_init(0x07, 200000));            // 600k conversions/s, the ADC does 500k
+    CHECK(!adc_service_is_running());
+}
+
+static void test_service_follows_the_buffer(void) {
+    rate_hz = 1000;
+    channel_count = 3;
+    uint8_t mask = (1u << 1) | (1u << 2) | (1u << ADC_SERVICE_TEMP_CHANNEL);
+    CHECK(adc_service_init(mask, rate_hz));
+    CHECK(adc_service_is_running());
+    CHECK(adc_hw->stub_running);
+    CHECK(adc_hw->stub_temp_sensor);
+    CHECK_EQ(adc_hw->stub_input, 1);                   // Round robin starts at the lowest input
+    CHECK(fabsf(adc_hw->stub_clkdiv - (48000000.0f / 3000.0f - 1.0f)) < 0.5f);
+
+    // Nothing converted yet
+    CHECK_EQ(adc_service_get_latest(1), 0);
+
+    // Random reading times, many laps of the buffer and its rewind
+    srand(7);
+    uint32_t mismatches = 0;
+    for (int pass = 0; pass < 20000; pass++) {
+        int count = rand() % 7;
+        for (int i = 0; i < count; i++) {
+            convert(test_signal);
+        }
+        for (uint8_t ch = 1; ch <= 2; ch++) {
+            if (conversions >= channel_count && adc_service_get_latest(ch) != last_value[ch]) {
+                mismatches++;
+            }
+        }
+    }
+    CHECK_EQ(mismatches, 0);
+    CHECK_EQ(adc_service_get_latest(0), 0);            // Not sampled
+    CHECK_EQ(adc_service_get_latest(3), 0);
+
+    // Filters over the channel's own samples only
+    uint16_t median = adc_service_get_median(2);
+    CHECK(median >= 1600 && median < 2400);
+    uint32_t oversampled = adc_service_get_oversampled(1, 3);
+    CHECK(oversampled >= 800 * 8 && oversampled < 1600 * 8);
+
+    int32_t temperature_mc = adc_service_temperature_mc();
+    printf("  die temperature %ld mC\n", (long)temperature_mc);
+    CHECK(temperature_mc > 26000 && temperature_mc < 28000);
+    CHECK_EQ(adc_service_to_mv(4096, 12), 3300);
+}
+
+int main(void) {
+    log_init();
+    log_set_level(LOG_LEVEL_NONE);
+    stub_dma_reset();
+
+    TEST_RUN(test_medians_sort_correctly);
+    TEST_RUN(test_ema);
+    TEST_RUN(test_decimation);
+    TEST_RUN(test_init_limits);
+    TEST_RUN(test_service_follows_the_buffer);
+    TEST_EXIT();
+}
@@ -0,0 +1,351 @@
+/**
+ * Host tests for the IMA ADPCM decoder (drivers/audio/audio_adpcm.c) and
+ * the audio engine (drivers/audio/audio.c)
+ *
+ * The decoder is checked against a reference IMA encoder's reconstruction.
+ * The engine runs on the DMA model: the I2S DREQ moves one frame at a time
+ * from the ping-pong halves into the TX FIFO, where the test collects the
+ * output, and each completed half raises the IRQ that refills it.
+ */
+
+#include "test_support.h"
+#include "audio.h"
+#include "audio_adpcm.h"
+#include "bsp_i2s.h"
+#include "bsp_dma_channel_irq.h"
+#include "hardware/dma.h"
+#include "logging.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SOURCE_SAMPLES 16000                // One second
+#define WAV_BLOCK 256                       // Header and 504 nibbles: 505 samples per block
+#define OUTPUT_FRAMES (80 * AUDIO_BUFFER_FRAMES)
+#define I2S_DREQ 7
+
+static int16_t source[SOURCE_SAMPLES];
+static int16_t reference[SOURCE_SAMPLES];   // What a decoder must give back
+static uint8_t stream[SOURCE_SAMPLES / 2];
+static uint8_t wav[SOURCE_SAMPLES / 2 + 64];
+static uint32_t wav_size;
+static uint32_t wav_samples;
+
+// I2S side: TX FIFO, DMA IRQ callbacks and the collected output
+static volatile uint32_t tx_fifo;
+static uint dma_channels[2];
+static channel_irq_callback_t callbacks[2];
+static uint32_t callback_count;
+static int16_t output[OUTPUT_FRAMES];
+static uint32_t frames;
+static uint32_t stereo_mismatches;
+
+void bsp_i2s_init(void) {
+}
+
+void bsp_i2s_update_clock(void) {
+}
+
+volatile uint32_t *bsp_i2s_get_tx_fifo(void) {
+    return &tx_fifo;
+}
+
+uint bsp_i2s_get_dreq(void) {
+    return I2S_DREQ;
+}
+
+void bsp_dma_channel_irq_add(uint8_t irq_num, uint dma_channel, channel_irq_callback_t callback) {
+    CHECK_EQ(irq_num, 1);
+    dma_channel_set_irq1_enabled(dma_channel, true);
+    dma_channels[callback_count] = dma_channel;
+    callbacks[callback_count++] = callback;
+}
+
+// The BSP's DMA IRQ 1 handler
+static void dma_irq(void) {
+    for (uint32_t i = 0; i < callback_count; i++) {
+        if (dma_channel_get_irq1_status(dma_channels[i])) {
+            dma_channel_acknowledge_irq1(dma_channels[i]);
+            callbacks[i]();
+        }
+    }
+}
+
+// Play 'count' frames (whole halves); the IRQ is taken at once unless late_irq, then only after both
+static void play(uint32_t count, bool late_irq) {
+    CHECK_EQ(count % AUDIO_BUFFER_FRAMES, 0);
+    for (uint32_t n = 0; n < count; n++) {
+        uint channel = stub_dma_is_busy(dma_channels[0]) ? dma_channels[0] : dma_channels[1];
+        CHECK(stub_dma_transfer(channel));
+        stereo_mismatches += (tx_fifo >> 16) != (tx_fifo & 0xFFFF);
+        if (frames < OUTPUT_FRAMES) {
+            output[frames++] = (int16_t)(tx_fifo & 0xFFFF);
+        }
+        if (!late_irq || (dma_channel_get_irq1_status(dma_channels[0]) && dma_channel_get_irq1_status(dma_channels[1]))) {
+            dma_irq();
+        }
+    }
+}
+
+// Reference IMA ADPCM encoder; the nibble for 'sample', updating the decoder state it tracks
+static uint8_t encode(audio_adpcm_t *state, int32_t sample) {
+    static const int8_t index_step[8] = { -1, -1, -1, -1, 2, 4, 6, 8 };
+    static const uint16_t step_size[89] = {
+        7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45, 50, 55, 60, 66, 73, 80, 88, 97,
+        107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724,
+        796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327, 3660, 4026,
+        4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899, 15289, 16818, 18500,
+        20350, 22385, 24623, 27086, 29794, 32767
+    };
+    int32_t step = step_size[state->index];
+    int32_t delta = sample - state->predictor;
+    int32_t diff = step >> 3;
+    uint8_t nibble = 0;
+    if (delta < 0) {
+        nibble = 8;
+        delta = -delta;
+    }
+    for (uint8_t bit = 4; bit > 0; bit >>= 1) {
+        if (delta >= step) {
+            nibble |= bit;
+            delta -= step;
+            diff += step;
+        }
+        step >>= 1;
+    }
+    int32_t predictor = state->predictor + (nibble & 8 ? -diff : diff);
+    state->predictor = (int16_t)(predictor > INT16_MAX ? INT16_MAX : predictor < INT16_MIN ? INT16_MIN : predictor);
+    int32_t index = state->index + index_step[nibble & 7];
+    state->index = (uint8_t)(index < 0 ? 0 : index > AUDIO_ADPCM_MAX_INDEX ? AUDIO_ADPCM_MAX_INDEX : index);
+    return nibble;
+}
+
+// A tone and a rising sweep, not starting at zero so the start of a clip can be found
+static void make_source(void) {
+    for (uint32_t i = 0; i < SOURCE_SAMPLES; i++) {
+        double t = (double)i / AUDIO_SAMPLE_RATE;
+        source[i] = (int16_t)lrint(12000 * sin(2 * M_PI * 440 * t + 1) + 6000 * sin(2 * M_PI * (200 + 1500 * t) * t));
+    }
+}
+
+static void test_decoder_matches_reference(void) {
+    // Headerless stream from silence
+    audio_adpcm_t encoder = { 0, 0 };
+    for (uint32_t i = 0; i < SOURCE_SAMPLES; i += 2) {
+        uint8_t low = encode(&encoder, source[i]);
+        reference[i] = encoder.predictor;
+        uint8_t high = encode(&encoder, source[i + 1]);
+        reference[i + 1] = encoder.predictor;
+        stream[i / 2] = (uint8_t)(low | (high << 4));
+    }
+
+    audio_adpcm_t decoder = { 0, 0 };
+    uint32_t mismatches = 0;
+    double signal = 0;
+    double noise = 0;
+    for (uint32_t i = 0; i < SOURCE_SAMPLES; i++) {
+        int16_t sample = audio_adpcm_decode(&decoder, (stream[i / 2] >> ((i & 1) * 4)) & 0x0F);
+        mismatches += sample != reference[i];
+        signal += (double)source[i] * source[i];
+        noise += (double)(sample - source[i]) * (sample - source[i]);
+    }
+    double snr = 10 * log10(signal / noise);
+    printf("  stream SNR %.1f dB\n", snr);
+    CHECK_EQ(mismatches, 0);
+    CHECK(snr > 25);
+
+    // Clamped at full scale and at the ends of the step table
+    audio_adpcm_t state = { INT16_MAX - 10, AUDIO_ADPCM_MAX_INDEX };
+    CHECK_EQ(audio_adpcm_decode(&state, 0x7), INT16_MAX);
+    CHECK_EQ(state.index, AUDIO_ADPCM_MAX_INDEX);
+    state.predictor = INT16_MIN + 10;
+    CHECK_EQ(audio_adpcm_decode(&state, 0xF), INT16_MIN);
+    state.index = 0;
+    audio_adpcm_decode(&state, 0x0);
+    CHECK_EQ(state.index, 0);
+
+    // Block header: first sample little endian, then the index
+    const uint8_t header[AUDIO_ADPCM_BLOCK_HEADER] = { 0x30, 0xF8, 42, 0 };
+    CHECK_EQ(audio_adpcm_block_start(&state, header), -2000);
+    CHECK_EQ(state.predictor, -2000);
+    CHECK_EQ(state.index, 42);
+}
+
+// WAV layout: each block restarts from a header carrying the sample and the encoder's index
+static void make_wav(void) {
+    audio_adpcm_t encoder = { 0, 0 };
+    uint32_t i = 0;
+    wav_size = 0;
+    wav_samples = 0;
+    while (i + 2 * (WAV_BLOCK - AUDIO_ADPCM_BLOCK_HEADER) < SOURCE_SAMPLES) {
+        uint8_t *block = &wav[wav_size];
+        encoder.predictor = source[i++];
+        block[0] = (uint8_t)encoder.predictor;
+        block[1] = (uint8_t)((uint16_t)encoder.predictor >> 8);
+        block[2] = encoder.index;
+        block[3] = 0;
+        reference[wav_samples++] = encoder.predictor;
+        for (uint32_t k = AUDIO_ADPCM_BLOCK_HEADER; k < WAV_BLOCK; k++) {
+            uint8_t low = encode(&encoder, source[i++]);
+            reference[wav_samples++] = encoder.predictor;
+            uint8_t high = encode(&encoder, source[i++]);
+            reference[wav_samples++] = encoder.predictor;
+            block[k] = (uint8_t)(low | (high << 4));
+        }
+        wav_size += WAV_BLOCK;
+    }
+}
+
+// play() stops at a half boundary with the next half already mixed: a voice queued then is mixed
+// into the half after it, two halves on
+#define LATENCY_FRAMES (2 * AUDIO_BUFFER_FRAMES)
+
+// Output frames in [from, to) that are not silent
+static uint32_t count_sound(uint32_t from, uint32_t to) {
+    uint32_t count = 0;
+    for (uint32_t i = from; i < to; i++) {
+        count += output[i] != 0;
+    }
+    return count;
+}
+
+static void test_clip_plays_through_the_ring(void) {
+    make_wav();
+    audio_clip_t clip = { wav, wav_size, WAV_BLOCK };
+    CHECK(audio_play_clip(&clip, 100));
+    frames = 0;
+    play(LATENCY_FRAMES + (wav_samples / AUDIO_BUFFER_FRAMES + 2) * AUDIO_BUFFER_FRAMES, false);
+
+    // Sample for sample at full volume, on both channels
+    CHECK_EQ(count_sound(0, LATENCY_FRAMES), 0);
+    uint32_t mismatches = 0;
+    for (uint32_t i = 0; i < wav_samples; i++) {
+        mismatches += output[LATENCY_FRAMES + i] != reference[i];
+    }
+    printf("  %lu clip samples in %lu blocks\n", (unsigned long)wav_samples, (unsigned long)(wav_size / WAV_BLOCK));
+    CHECK_EQ(mismatches, 0);
+    CHECK_EQ(stereo_mismatches, 0);
+
+    // Over: silence, and the voice is free again (every one of them can be claimed)
+    CHECK_EQ(count_sound(LATENCY_FRAMES + wav_samples, frames), 0);
+    for (uint32_t i = 0; i < AUDIO_VOICES; i++) {
+        CHECK(audio_play_clip(&clip, 100));
+    }
+    CHECK(!audio_play_clip(&clip, 100));
+    CHECK(!audio_play_tone(1000, 100, 0, AUDIO_WAVE_SINE, 50));
+    audio_stop_all();
+    play(LATENCY_FRAMES, false);
+
+    // Rejected clips
+    audio_clip_t bad = { wav, wav_size, AUDIO_ADPCM_BLOCK_HEADER };
+    CHECK(!audio_play_clip(&bad, 100));
+    CHECK(!audio_play_clip(NULL, 100));
+}
+
+static void test_tone_timing_and_level(void) {
+    // 1 kHz for 100 ms (1600 samples) after 50 ms (800), half volume
+    CHECK(audio_play_tone(1000, 100, 50, AUDIO_WAVE_SINE, 50));
+    frames = 0;
+    play(LATENCY_FRAMES + 12 * AUDIO_BUFFER_FRAMES, false);
+
+    // The ramp starts from zero gain, so the first sample is silent and the last one is not
+    uint32_t start = LATENCY_FRAMES + 800;
+    uint32_t end = start + 1600;
+    CHECK_EQ(count_sound(0, start + 1), 0);
+    CHECK(output[start + 1] != 0);
+    CHECK(output[end - 1] != 0);
+    CHECK_EQ(count_sound(end, frames), 0);
+
+    int32_t peak = 0;
+    uint32_t cycles = 0;
+    for (uint32_t i = start; i < end; i++) {
+        peak = abs(output[i]) > peak ? abs(output[i]) : peak;
+        cycles += output[i] < 0 && output[i + 1] >= 0;
+    }
+    printf("  peak %ld, %lu cycles\n", (long)peak, (unsigned long)cycles);
+    CHECK(peak >= 16300 && peak <= 16384);
+    CHECK_EQ(cycles, 100);
+
+    // Ramped in and out: no click at either end
+    CHECK(abs(output[start + 1]) < 600);
+    CHECK(abs(output[end - 1]) < 600);
+
+    // Out-of-range tones are refused
+    CHECK(!audio_play_tone(0, 100, 0, AUDIO_WAVE_SINE, 50));
+    CHECK(!audio_play_tone(AUDIO_SAMPLE_RATE / 2, 100, 0, AUDIO_WAVE_SINE, 50));
+    CHECK(!audio_play_tone(1000, 0, 0, AUDIO_WAVE_SINE, 50));
+}
+
+static void test_mixer_saturates(void) {
+    // Four full-volume 500 Hz squares in phase: four times full scale, clipped rather than wrapped
+    for (int i = 0; i < 4; i++) {
+        CHECK(audio_play_tone(500, 20, 0, AUDIO_WAVE_SQUARE, 100));
+    }
+    frames = 0;
+    play(LATENCY_FRAMES + 2 * AUDIO_BUFFER_FRAMES, false);
+    uint32_t clipped = 0;
+    uint32_t wrong_sign = 0;
+    for (uint32_t k = 40; k < 280; k++) {                  // Past the ramps
+        int16_t sample = output[LATENCY_FRAMES + k];
+        clipped += sample == INT16_MAX || sample == INT16_MIN;
+        wrong_sign += (k % 32 < 16) != (sample > 0);
+    }
+    CHECK_EQ(clipped, 240);
+    CHECK_EQ(wrong_sign, 0);
+}
+
+static void test_alerts_and_stop(void) {
+    CHECK(audio_alert(AUDIO_ALERT_ALARM));              // 3 voices
+    CHECK(audio_alert(AUDIO_ALERT_DONE));               // 2 more
+    CHECK(!audio_alert(AUDIO_ALERT_ALARM));             // Only 1 left: none of it plays
+    CHECK(audio_play_tone(440, 1000, 0, AUDIO_WAVE_SINE, 10));
+    CHECK(!audio_play_tone(440, 1000, 0, AUDIO_WAVE_SINE, 10));
+
+    frames = 0;
+    play(LATENCY_FRAMES + AUDIO_BUFFER_FRAMES, false);
+    CHECK(count_sound(LATENCY_FRAMES, frames) > 0);
+
+    // Taken at the next refill: what is already mixed plays out, then silence with every voice free
+    audio_stop_all();
+    frames = 0;
+    play(LATENCY_FRAMES + 2 * AUDIO_BUFFER_FRAMES, false);
+    CHECK(count_sound(0, LATENCY_FRAMES) > 0);
+    CHECK_EQ(count_sound(LATENCY_FRAMES, frames), 0);
+    CHECK(audio_alert(AUDIO_ALERT_ALARM));
+    CHECK(audio_alert(AUDIO_ALERT_ALARM));
+    audio_stop_all();
+    play(LATENCY_FRAMES, false);
+}
+
+static void test_late_refill_is_an_underrun(void) {
+    uint32_t before = audio_get_underruns();
+    play(4 * AUDIO_BUFFER_FRAMES, false);
+    CHECK_EQ(audio_get_underruns(), before);
+
+    // Interrupts masked for a whole half (a flash erase): the refill finds the other half done too
+    play(AUDIO_BUFFER_FRAMES, false);
+    play(2 * AUDIO_BUFFER_FRAMES, true);
+    CHECK(audio_get_underruns() > before);
+}
+
+int main(void) {
+    log_init();
+    log_set_level(LOG_LEVEL_NONE);
+    stub_dma_reset();
+    make_source();
+
+    CHECK(!audio_is_running());
+    CHECK(!audio_play_tone(1000, 100, 0, AUDIO_WAVE_SINE, 50));
+    CHECK(audio_init());
+    CHECK(audio_is_running());
+    CHECK(!audio_init());
+    CHECK_EQ(callback_count, 2);
+
+    TEST_RUN(test_decoder_matches_reference);
+    TEST_RUN(test_clip_plays_through_the_ring);
+    TEST_RUN(test_tone_timing_and_level);
+    TEST_RUN(test_mixer_saturates);
+    TEST_RUN(test_alerts_and_stop);
+    TEST_RUN(test_late_refill_is_an_underrun);
+    TEST_EXIT();
+}
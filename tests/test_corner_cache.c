@@ -0,0 +1,152 @@
+/**
+ * Host tests for the rounded corner cache (lv_draw_sw_rect.c in libraries/lvgl)
+ *
+ * Random rectangles (radii up to a circle, borders with missing sides,
+ * outlines, shadows, translucency, clip areas cutting the corners and a
+ * rounded clip mask on top) are drawn with LVGL's radius masks and with the
+ * cached corner quadrants; the pixels must be identical. A sweep over every
+ * radius and border width cycles the cache through more entries than it
+ * holds and past its largest radius.
+ */
+
+#include "test_support.h"
+#include "lvgl.h"
+#include "src/draw/sw/lv_draw_sw.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define BUF_W 240
+#define BUF_H 100
+
+static lv_color_t expect[BUF_W * BUF_H];
+static lv_color_t actual[BUF_W * BUF_H];
+
+static void flush(lv_disp_drv_t *disp_drv, const lv_area_t *area, lv_color_t *color_p) {
+    (void)area;
+    (void)color_p;
+    lv_disp_flush_ready(disp_drv);
+}
+
+static lv_disp_t *make_display(void) {
+    static lv_disp_draw_buf_t draw_buf;
+    static lv_color_t buf[240 * 10];
+    static lv_disp_drv_t disp_drv;
+    lv_disp_draw_buf_init(&draw_buf, buf, NULL, 240 * 10);
+    lv_disp_drv_init(&disp_drv);
+    disp_drv.hor_res = 240;
+    disp_drv.ver_res = 320;
+    disp_drv.flush_cb = flush;
+    disp_drv.draw_buf = &draw_buf;
+    return lv_disp_drv_register(&disp_drv);
+}
+
+static int32_t random_in(int32_t n) {
+    return (int32_t)((((uint32_t)rand() << 16) ^ (uint32_t)rand()) % (uint32_t)n);
+}
+
+// The rectangle with masked corners into 'expect' and cached ones into 'actual'; true if they match
+static bool draw_both(const lv_draw_rect_dsc_t *dsc, const lv_area_t *coords, const lv_area_t *clip) {
+    for (int32_t i = 0; i < BUF_W * BUF_H; i++) {
+        expect[i].full = (uint16_t)(i * 0x9E37u);
+    }
+    memcpy(actual, expect, sizeof(actual));
+
+    lv_area_t buf_area = { 0, 0, BUF_W - 1, BUF_H - 1 };
+    lv_draw_sw_ctx_t ctx;
+    lv_draw_sw_init_ctx(lv_disp_get_default()->driver, &ctx.base_draw);
+    ctx.base_draw.buf_area = &buf_area;
+    ctx.base_draw.clip_area = clip;
+    ctx.base_draw.buf = expect;
+    lv_draw_sw_corner_cache_enable(false);
+    lv_draw_rect(&ctx.base_draw, dsc, coords);
+    ctx.base_draw.buf = actual;
+    lv_draw_sw_corner_cache_enable(true);
+    lv_draw_rect(&ctx.base_draw, dsc, coords);
+    return memcmp(expect, actual, sizeof(actual)) == 0;
+}
+
+static void test_matches_radius_masks(void) {
+    srand(4242);
+    uint32_t mismatches = 0;
+    uint32_t rects = 10000;
+    for (uint32_t i = 0; i < rects; i++) {
+        lv_draw_rect_dsc_t dsc;
+        lv_draw_rect_dsc_init(&dsc);
+        int32_t radius = random_in(5);
+        dsc.radius = radius == 0 ? 0 : radius == 1 ? LV_RADIUS_CIRCLE : random_in(20);
+        dsc.bg_color.full = (uint16_t)rand();
+        dsc.bg_opa = random_in(3) ? LV_OPA_COVER : (lv_opa_t)random_in(256);
+        if (random_in(3) == 0) {
+            dsc.border_width = 1 + random_in(8);
+            dsc.border_color.full = (uint16_t)rand();
+            dsc.border_opa = random_in(2) ? LV_OPA_COVER : (lv_opa_t)random_in(256);
+            if (random_in(5) == 0) {
+                dsc.border_side = random_in(16);
+            }
+        }
+        if (random_in(4) == 0) {
+            dsc.outline_width = 1 + random_in(6);
+            dsc.outline_pad = random_in(4);
+            dsc.outline_color.full = (uint16_t)rand();
+            dsc.outline_opa = random_in(2) ? LV_OPA_COVER : (lv_opa_t)random_in(256);
+        }
+        if (random_in(5) == 0) {
+            dsc.shadow_width = 1 + random_in(10);
+            dsc.shadow_opa = (lv_opa_t)random_in(256);
+            dsc.shadow_color.full = (uint16_t)rand();
+            dsc.shadow_ofs_y = random_in(5);
+        }
+        lv_area_t coords = { random_in(BUF_W) - 20, random_in(BUF_H) - 20, 0, 0 };
+        coords.x2 = coords.x1 + random_in(250);
+        coords.y2 = coords.y1 + random_in(110);
+        lv_area_t clip = { random_in(30), random_in(30), BUF_W - 1 - random_in(30), BUF_H - 1 - random_in(30) };
+        if (random_in(3) == 0) {
+            clip = (lv_area_t){ 0, 0, BUF_W - 1, BUF_H - 1 };
+        }
+
+        // Under another mask (a rounded parent) the corners go through the masks either way
+        bool rounded = random_in(8) == 0;
+        lv_draw_mask_radius_param_t parent;
+        int16_t mask_id = -1;
+        if (rounded) {
+            lv_area_t rect = { 5, 5, 180, 90 };
+            lv_draw_mask_radius_init(&parent, &rect, 15, false);
+            mask_id = lv_draw_mask_add(&parent, NULL);
+        }
+        mismatches += !draw_both(&dsc, &coords, &clip);
+        if (rounded) {
+            lv_draw_mask_remove_id(mask_id);
+            lv_draw_mask_free_param(&parent);
+        }
+    }
+    printf("  %lu rectangles, %lu mismatches\n", (unsigned long)rects, (unsigned long)mismatches);
+    CHECK_EQ(mismatches, 0);
+}
+
+static void test_every_radius_and_border(void) {
+    lv_area_t clip = { 0, 0, BUF_W - 1, BUF_H - 1 };
+    uint32_t mismatches = 0;
+    for (int32_t radius = 1; radius <= LV_CORNER_CACHE_MAX_SIZE + 8; radius++) {
+        for (int32_t border = 0; border <= 10; border += 2) {
+            lv_draw_rect_dsc_t dsc;
+            lv_draw_rect_dsc_init(&dsc);
+            dsc.radius = radius;
+            dsc.bg_color = lv_color_hex(0x2060A0);
+            dsc.border_width = border;
+            dsc.border_color = lv_color_hex(0xE0E0E0);
+            lv_area_t coords = { 3, 2, 3 + 2 * radius + 20, 2 + 2 * radius + 10 };
+            mismatches += !draw_both(&dsc, &coords, &clip);
+        }
+    }
+    CHECK_EQ(mismatches, 0);
+}
+
+int main(void) {
+    lv_init();
+    lv_disp_t *disp = make_display();
+    _lv_refr_set_disp_refreshing(disp);
+
+    TEST_RUN(test_matches_radius_masks);
+    TEST_RUN(test_every_radius_and_border);
+    TEST_EXIT();
+}
@@ -0,0 +1,383 @@
+/**
+ * Host tests for volumetric dosing (drivers/dosing/dosing.c)
+ *
+ * Runs the real move planner on the stepper driver model, against a pump
+ * whose true volume per revolution falls off with speed. Every step is
+ * credited to the zone whose dose is running, so the tests see what each
+ * zone actually received. Step durations and the driver's enable settle
+ * time advance the simulated clock, which times a queued watering pass.
+ */
+
+#include "test_support.h"
+#include "dosing.h"
+#include "stepper_planner.h"
+#include "stepper_driver_sim.h"
+#include "settings_store.h"
+#include "storage_flash.h"
+#include "logging.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ZONES 8
+#define NO_ZONE 0xFF
+
+static uint8_t open_zone = NO_ZONE;
+static double zone_ul[ZONES];
+static uint8_t started_zones[32];
+static uint32_t starts;
+static uint32_t closes;
+static uint32_t switched_while_running;     // Zone changed while the pump turned
+static int32_t started_at[32];              // Pump position as each dose started
+static int32_t started_steps[32];
+static uint8_t broken_zone = NO_ZONE;       // Its valve never opens
+
+// The pump being simulated: 1.2 mL/rev when slow, down to 0.95 mL/rev at full speed
+static double true_ul_per_rev(uint32_t freq_hz) {
+    return 1200.0 - 250.0 * pow((freq_hz - 2000.0) / 6000.0, 0.7);
+}
+
+static void on_step(int32_t position, uint32_t freq_hz) {
+    (void)position;
+    if (open_zone < ZONES) {
+        zone_ul[open_zone] += true_ul_per_rev(freq_hz) / STEPPER_STEPS_PER_REV;
+    }
+}
+
+static bool on_dose_start(const dosing_request_t *dose) {
+    if (dose && dose->zone == broken_zone) {
+        return false;
+    }
+    if (dose) {
+        if (open_zone != NO_ZONE && open_zone != dose->zone && stepper_driver_is_running()) {
+            switched_while_running++;
+        }
+        open_zone = dose->zone;
+        if (starts < sizeof(started_zones)) {
+            started_zones[starts] = dose->zone;
+            started_at[starts] = stepper_driver_get_current_steps();
+            started_steps[starts] = dose->steps;
+        }
+        starts++;
+    } else {
+        open_zone = NO_ZONE;
+        closes++;
+    }
+    return true;
+}
+
+static void reset(void) {
+    storage_flash_init();
+    stub_time_us = 0;
+    settings_init();
+    stub_stepper_reset();
+    stub_stepper_on_step = on_step;
+    dosing_init();
+    dosing_set_start_callback(on_dose_start);
+
+    open_zone = NO_ZONE;
+    memset(zone_ul, 0, sizeof(zone_ul));
+    starts = 0;
+    closes = 0;
+    switched_while_running = 0;
+    broken_zone = NO_ZONE;
+}
+
+// One main-loop pass: the pump turns for up to 'steps' steps, then the planner and dosing catch up
+static void loop_pass(int32_t steps) {
+    stub_stepper_run(steps);
+    stepper_planner_process();
+    dosing_process();
+}
+
+static void run_until_idle(int32_t steps_per_pass) {
+    for (int pass = 0; pass < 1000000 && (dosing_is_busy() || stepper_planner_is_running()); pass++) {
+        loop_pass(steps_per_pass);
+    }
+    dosing_process();           // Releases the driver hold
+}
+
+// What a measured calibration run would give: 'steps' at 'speed_hz' into a vessel
+static uint32_t measure_run(uint32_t speed_hz, int32_t steps) {
+    open_zone = 0;
+    zone_ul[0] = 0;
+    stepper_driver_start_at(steps, speed_hz);
+    while (stepper_driver_is_running()) {
+        stub_stepper_run(steps);
+    }
+    open_zone = NO_ZONE;
+    return (uint32_t)(zone_ul[0] + 0.5);
+}
+
+static void calibrate_pump(void) {
+    for (uint32_t speed_hz = 2000; speed_hz <= 8000; speed_hz += 1200) {
+        int32_t steps = 100 * STEPPER_STEPS_PER_REV;
+        CHECK(dosing_calibrate(0, speed_hz, steps, measure_run(speed_hz, steps)));
+    }
+    zone_ul[0] = 0;
+    stub_stepper_starts = 0;
+    stub_stepper_enables = 0;
+}
+
+static void test_calibration_is_persisted(void) {
+    reset();
+    CHECK_EQ(dosing_ul_per_rev(0, 5000), DOSING_DEFAULT_UL_PER_REV);
+
+    calibrate_pump();
+    dosing_cal_point_t points[DOSING_CAL_MAX_POINTS];
+    uint32_t count = dosing_get_calibration(0, points, DOSING_CAL_MAX_POINTS);
+    CHECK_EQ(count, 6);
+    CHECK(points[0].ul_per_rev > points[count - 1].ul_per_rev);
+
+    // Survives a reboot
+    CHECK(settings_commit());
+    CHECK(settings_init());
+    dosing_init();
+    dosing_cal_point_t reloaded[DOSING_CAL_MAX_POINTS];
+    CHECK_EQ(dosing_get_calibration(0, reloaded, DOSING_CAL_MAX_POINTS), count);
+    CHECK(memcmp(points, reloaded, count * sizeof(points[0])) == 0);
+
+    // A run close to an existing point replaces it
+    CHECK(dosing_calibrate(0, 2050, 160000, 115000));
+    CHECK_EQ(dosing_get_calibration(0, points, DOSING_CAL_MAX_POINTS), count);
+    CHECK_EQ(points[0].speed_hz, 2050);
+
+    // Clearing goes back to the default, also after a reboot
+    dosing_cal_point_t none[1];
+    CHECK(dosing_set_calibration(0, none, 0));
+    CHECK(settings_commit());
+    CHECK(settings_init());
+    dosing_init();
+    CHECK_EQ(dosing_get_calibration(0, points, DOSING_CAL_MAX_POINTS), 0);
+
+    // Unsorted curves are rejected
+    dosing_cal_point_t unsorted[2] = { { 5000, 1000 }, { 3000, 1100 } };
+    CHECK(!dosing_set_calibration(0, unsorted, 2));
+    CHECK(!dosing_calibrate(DOSING_MAX_PUMPS, 4000, 1600, 1000));
+}
+
+static void test_conversion_follows_the_ramps(void) {
+    reset();
+    calibrate_pump();
+
+    // Single moves at random volumes and speeds, measured on the simulated pump; what is
+    // left is the straight-line interpolation between calibration points
+    srand(1);
+    double worst = 0.0;
+    for (int i = 0; i < 200; i++) {
+        uint32_t volume_ul = 5000 + (uint32_t)rand() % 200000;
+        uint32_t speed_hz = 2000 + (uint32_t)rand() % 6001;
+        int32_t steps = dosing_ul_to_steps(0, volume_ul, speed_hz);
+        double error = fabs(measure_run(speed_hz, steps) - (double)volume_ul) / volume_ul;
+        if (error > worst) {
+            worst = error;
+        }
+    }
+    printf("  worst single-move error %.3f%%\n", worst * 100.0);
+    CHECK(worst < 0.015);
+}
+
+static void test_queued_doses_reach_their_zones(void) {
+    reset();
+    calibrate_pump();
+
+    static const uint32_t volumes_ul[] = { 20000, 5000, 12000, 30000 };
+    for (uint8_t zone = 0; zone < 4; zone++) {
+        CHECK(dosing_queue(0, zone, volumes_ul[zone], 0));
+    }
+    CHECK(dosing_is_busy());
+    CHECK_EQ(dosing_get_queue_length(), 4);
+
+    run_until_idle(64);
+
+    dosing_stats_t stats;
+    dosing_get_stats(&stats);
+    CHECK_EQ(stats.completed, 4);
+    CHECK_EQ(stats.aborted, 0);
+    CHECK_EQ(stats.dispensed_ul, 20000 + 5000 + 12000 + 30000);
+    CHECK_EQ(starts, 4);
+    CHECK_EQ(closes, 1);
+    for (uint8_t zone = 0; zone < 4; zone++) {
+        CHECK_EQ(started_zones[zone], zone);
+        double error = fabs(zone_ul[zone] - volumes_ul[zone]) / volumes_ul[zone];
+        printf("  zone %u: %.0f of %lu uL\n", zone, zone_ul[zone], (unsigned long)volumes_ul[zone]);
+        CHECK(error < 0.02);
+    }
+    CHECK(!dosing_is_busy());
+    CHECK(!stub_stepper_is_enabled());
+}
+
+static void test_zone_changes_land_on_the_step(void) {
+    reset();
+    calibrate_pump();
+
+    // Long main-loop passes: the planner sees each segment end hundreds of steps late, the mark does not
+    static const uint8_t zones[] = { 0, 1, 1, 2 };
+    for (uint32_t i = 0; i < sizeof(zones); i++) {
+        CHECK(dosing_queue(0, zones[i], 10000, 0));
+    }
+    run_until_idle(700);
+
+    dosing_stats_t stats;
+    dosing_get_stats(&stats);
+    CHECK_EQ(stats.completed, 4);
+    CHECK_EQ(stub_stepper_starts, 1);       // One sequence, blended across the zones
+    CHECK_EQ(stub_stepper_enables, 1);
+    CHECK_EQ(switched_while_running, 2);
+    CHECK_EQ(closes, 1);
+
+    // Zone 1's second dose needs no switch; the others start on the step after the previous zone's last
+    CHECK_EQ(starts, 3);
+    CHECK_EQ(started_at[1], started_steps[0]);      // Positions count from the start of the sequence
+    CHECK(started_at[2] > started_at[1] + started_steps[1]);
+    CHECK_EQ(started_at[2] + started_steps[2], stepper_driver_get_current_steps());
+    for (uint8_t zone = 0; zone < 3; zone++) {
+        double expected = zone == 1 ? 20000.0 : 10000.0;
+        printf("  zone %u: %.0f of %.0f uL\n", zone, zone_ul[zone], expected);
+        CHECK(fabs(zone_ul[zone] - expected) / expected < 0.02);
+    }
+}
+
+static void test_queue_throughput(void) {
+    // A watering pass: several doses, some to the same zone, queued at once
+    static const uint8_t zones[] = { 0, 0, 1, 2, 2, 2, 3, 1 };
+    static const uint32_t volumes_ul[] = { 8000, 4000, 15000, 6000, 6000, 3000, 25000, 10000 };
+    const uint32_t doses = sizeof(zones);
+    uint32_t total_ul = 0;
+    for (uint32_t i = 0; i < doses; i++) {
+        total_ul += volumes_ul[i];
+    }
+
+    // One dose at a time: the driver is released after each and enabled again for the next
+    reset();
+    calibrate_pump();
+    uint64_t start_us = stub_time_us;
+    for (uint32_t i = 0; i < doses; i++) {
+        CHECK(dosing_queue(0, zones[i], volumes_ul[i], 0));
+        run_until_idle(64);
+    }
+    uint64_t single_us = stub_time_us - start_us;
+    CHECK_EQ(stub_stepper_enables, doses);
+
+    // The whole queue: one enable and settle, blended where the zone stays the same
+    reset();
+    calibrate_pump();
+    start_us = stub_time_us;
+    for (uint32_t i = 0; i < doses; i++) {
+        CHECK(dosing_queue(0, zones[i], volumes_ul[i], 0));
+    }
+    run_until_idle(64);
+    uint64_t queued_us = stub_time_us - start_us;
+
+    dosing_stats_t stats;
+    dosing_get_stats(&stats);
+    CHECK_EQ(stats.completed, doses);
+    CHECK_EQ(stub_stepper_enables, 1);
+    CHECK_EQ(closes, 1);
+    CHECK(!stub_stepper_is_enabled());
+    for (uint8_t zone = 0; zone < 4; zone++) {
+        double expected = 0.0;
+        for (uint32_t i = 0; i < doses; i++) {
+            expected += zones[i] == zone ? volumes_ul[i] : 0;
+        }
+        CHECK(fabs(zone_ul[zone] - expected) / expected < 0.02);
+    }
+
+    printf("  %lu doses, %lu uL: %.0f ms queued (%.1f mL/min), %.0f ms one at a time (%.1f mL/min)\n",
+           (unsigned long)doses, (unsigned long)total_ul, queued_us / 1000.0, total_ul * 60000.0 / queued_us,
+           single_us / 1000.0, total_ul * 60000.0 / single_us);
+    CHECK(single_us - queued_us >= (doses - 1) * STEPPER_ENABLE_SETTLE_MS * 1000ull);
+}
+
+static void test_unroutable_doses_are_dropped(void) {
+    reset();
+    calibrate_pump();
+    broken_zone = 3;
+
+    // Zone 3 first: never starts the pump. Zone 3 within a sequence: the pump stops on its first step
+    static const uint8_t zones[] = { 3, 0, 3, 1, 2 };
+    for (uint32_t i = 0; i < sizeof(zones); i++) {
+        CHECK(dosing_queue(0, zones[i], 10000, 0));
+    }
+    run_until_idle(700);
+
+    dosing_stats_t stats;
+    dosing_get_stats(&stats);
+    CHECK_EQ(stats.aborted, 2);
+    CHECK_EQ(stats.completed, 3);
+    CHECK_EQ(stub_stepper_starts, 2);       // The doses behind the refused one are queued again
+    CHECK(zone_ul[3] == 0.0);
+    for (uint8_t zone = 0; zone < 3; zone++) {
+        printf("  zone %u: %.0f of 10000 uL\n", zone, zone_ul[zone]);
+        CHECK(fabs(zone_ul[zone] - 10000) / 10000 < 0.02);
+    }
+    CHECK(!dosing_is_busy());
+    CHECK_EQ(open_zone, NO_ZONE);
+}
+
+static void test_full_queue_drops(void) {
+    reset();
+    for (uint32_t i = 0; i < DOSING_QUEUE_SIZE; i++) {
+        CHECK(dosing_queue(0, 0, 1000, 0));
+    }
+    CHECK(!dosing_queue(0, 0, 1000, 0));
+    CHECK(!dosing_queue(DOSING_MAX_PUMPS, 0, 1000, 0));
+    CHECK(!dosing_queue(0, 0, 0, 0));
+
+    dosing_stats_t stats;
+    dosing_get_stats(&stats);
+    CHECK_EQ(stats.queued, DOSING_QUEUE_SIZE);
+    CHECK_EQ(stats.dropped, 1);
+
+    dosing_cancel();
+    CHECK(!dosing_is_busy());
+}
+
+static void test_doses_need_a_valve(void) {
+    reset();
+    CHECK(dosing_queue(0, 200, 1000, 0));   // Any zone until the count is known
+    dosing_cancel();
+
+    dosing_set_zone_count(4);
+    CHECK(dosing_queue(0, 3, 1000, 0));
+    CHECK(!dosing_queue(0, 4, 1000, 0));
+    CHECK(!dosing_queue(0, 200, 1000, 0));
+    CHECK_EQ(dosing_get_queue_length(), 1);
+    dosing_cancel();
+}
+
+static void test_manual_stop_aborts_the_sequence(void) {
+    reset();
+    CHECK(dosing_queue(0, 1, 20000, 0));
+    CHECK(dosing_queue(0, 2, 20000, 0));
+    loop_pass(0);
+    loop_pass(2000);
+
+    // Stopped by hand: nothing else is pumped behind the user's back
+    stepper_driver_stop();
+    run_until_idle(64);
+
+    dosing_stats_t stats;
+    dosing_get_stats(&stats);
+    CHECK_EQ(stats.aborted, 1);
+    CHECK_EQ(stats.completed, 0);
+    CHECK_EQ(closes, 1);
+    CHECK(zone_ul[2] == 0.0);
+    CHECK(!dosing_is_busy());
+}
+
+int main(void) {
+    log_init();
+    log_set_level(LOG_LEVEL_NONE);
+
+    TEST_RUN(test_calibration_is_persisted);
+    TEST_RUN(test_conversion_follows_the_ramps);
+    TEST_RUN(test_queued_doses_reach_their_zones);
+    TEST_RUN(test_zone_changes_land_on_the_step);
+    TEST_RUN(test_queue_throughput);
+    TEST_RUN(test_unroutable_doses_are_dropped);
+    TEST_RUN(test_full_queue_drops);
+    TEST_RUN(test_doses_need_a_valve);
+    TEST_RUN(test_manual_stop_aborts_the_sequence);
+    TEST_EXIT();
+}
@@ -0,0 +1,269 @@
+/**
+ * Host tests for the persistent log store (drivers/storage/flash_log.c)
+ *
+ * The store runs on the RAM flash model; records are read back by parsing
+ * the region the way tools/flash_log_decode.py does.
+ */
+
+#include "test_support.h"
+#include "flash_log.h"
+#include "storage_flash.h"
+#include "logging.h"
+#include <string.h>
+
+extern uint8_t stub_flash[];
+
+typedef struct {
+    uint32_t pages;             // Valid pages in the region
+    uint32_t torn;              // Written pages with a bad header or CRC
+    uint32_t records;
+    uint16_t last_boot;
+    uint32_t last_seq;
+    char last_text[FLASH_LOG_MAX_TEXT + 1];   // Text of the record in the newest page
+    uint8_t last_level;
+} region_scan_t;
+
+static void scan_region(region_scan_t* scan) {
+    memset(scan, 0, sizeof(*scan));
+
+    for (uint32_t offset = STORAGE_LOG_OFFSET; offset < STORAGE_SETTINGS_OFFSET; offset += STORAGE_PAGE_SIZE) {
+        const uint8_t* page = storage_flash_ptr(offset);
+        if (storage_flash_is_erased(offset, STORAGE_PAGE_SIZE)) {
+            continue;
+        }
+
+        uint32_t magic, seq, crc;
+        uint16_t boot_id, length;
+        memcpy(&magic, page, 4);
+        memcpy(&seq, page + 4, 4);
+        memcpy(&boot_id, page + 8, 2);
+        memcpy(&length, page + 10, 2);
+        memcpy(&crc, page + 12, 4);
+        if (magic != FLASH_LOG_PAGE_MAGIC || length > FLASH_LOG_PAYLOAD_SIZE ||
+            storage_crc32(storage_crc32(0, page + 4, 8), page + FLASH_LOG_PAGE_HEADER_SIZE, length) != crc) {
+            scan->torn++;
+            continue;
+        }
+        scan->pages++;
+
+        const uint8_t* record = page + FLASH_LOG_PAGE_HEADER_SIZE;
+        const uint8_t* end = record + length;
+        while (record + FLASH_LOG_RECORD_HEADER_SIZE <= end) {
+            uint8_t text_len = record[6];
+            if (seq > scan->last_seq) {
+                scan->last_seq = seq;
+                scan->last_boot = boot_id;
+                scan->last_level = record[4];
+                memcpy(scan->last_text, record + FLASH_LOG_RECORD_HEADER_SIZE, text_len);
+                scan->last_text[text_len] = '\0';
+            }
+            scan->records++;
+            record += FLASH_LOG_RECORD_HEADER_SIZE + text_len;
+        }
+    }
+}
+
+static void mount_fresh(void) {
+    storage_flash_init();
+    stub_time_us = 0;
+    CHECK(flash_log_init());
+}
+
+static void test_records_reach_flash(void) {
+    mount_fresh();
+    CHECK_EQ(flash_log_get_boot_id(), 1);
+
+    CHECK(flash_log_append(LOG_LEVEL_WARN, LOG_CAT_SYSTEM, "first"));
+    CHECK(flash_log_append(LOG_LEVEL_ERROR, LOG_CAT_STEPPER, "second"));
+    flash_log_flush();
+
+    region_scan_t scan;
+    scan_region(&scan);
+    CHECK_EQ(scan.pages, 1);
+    CHECK_EQ(scan.records, 2);
+    CHECK_EQ(scan.torn, 0);
+    CHECK_EQ(stub_lock_depth, 0);
+}
+
+static void test_idle_page_is_sealed(void) {
+    mount_fresh();
+    flash_log_append(LOG_LEVEL_INFO, LOG_CAT_SYSTEM, "quiet");
+
+    // Nothing is programmed until logging has been idle for FLASH_LOG_FLUSH_MS
+    for (int i = 0; i < 4; i++) {
+        flash_log_process();
+    }
+    region_scan_t scan;
+    scan_region(&scan);
+    CHECK_EQ(scan.pages, 0);
+
+    stub_time_us += FLASH_LOG_FLUSH_MS * 1000ull;
+    for (int i = 0; i < 4; i++) {
+        flash_log_process();
+    }
+    scan_region(&scan);
+    CHECK_EQ(scan.pages, 1);
+    CHECK_EQ(scan.records, 1);
+}
+
+static void test_remount_keeps_data(void) {
+    mount_fresh();
+    flash_log_append(LOG_LEVEL_INFO, LOG_CAT_SYSTEM, "before reboot");
+    flash_log_flush();
+
+    // Reboot: the RAM state is rebuilt from the flash contents alone
+    CHECK(flash_log_init());
+    CHECK_EQ(flash_log_get_boot_id(), 2);
+    flash_log_stats_t stats;
+    flash_log_get_stats(&stats);
+    CHECK_EQ(stats.pages_used, 1);
+    CHECK_EQ(stats.torn_pages, 0);
+
+    flash_log_append(LOG_LEVEL_INFO, LOG_CAT_SYSTEM, "after reboot");
+    flash_log_flush();
+    region_scan_t scan;
+    scan_region(&scan);
+    CHECK_EQ(scan.pages, 2);
+    CHECK_EQ(scan.last_boot, 2);
+    CHECK(strcmp(scan.last_text, "after reboot") == 0);
+}
+
+static void test_torn_page_is_skipped(void) {
+    mount_fresh();
+    flash_log_append(LOG_LEVEL_INFO, LOG_CAT_SYSTEM, "intact");
+    flash_log_flush();
+    flash_log_append(LOG_LEVEL_INFO, LOG_CAT_SYSTEM, "torn by a power loss");
+    flash_log_flush();
+
+    // Clear payload bits of the second page, as an interrupted program would leave it
+    stub_flash[STORAGE_LOG_OFFSET + STORAGE_PAGE_SIZE + FLASH_LOG_PAGE_HEADER_SIZE + 9] = 0;
+
+    CHECK(flash_log_init());
+    flash_log_stats_t stats;
+    flash_log_get_stats(&stats);
+    CHECK_EQ(stats.torn_pages, 1);
+    CHECK_EQ(stats.pages_used, 1);
+
+    // The sector holding the torn page is left alone; writing resumes after it
+    flash_log_append(LOG_LEVEL_INFO, LOG_CAT_SYSTEM, "resumed");
+    flash_log_flush();
+    region_scan_t scan;
+    scan_region(&scan);
+    CHECK_EQ(scan.torn, 1);
+    CHECK(strcmp(scan.last_text, "resumed") == 0);
+}
+
+static void test_wrap_discards_oldest(void) {
+    char text[FLASH_LOG_MAX_TEXT + 1];
+    memset(text, 'x', FLASH_LOG_MAX_TEXT);
+    text[FLASH_LOG_MAX_TEXT] = '\0';
+
+    mount_fresh();
+    flash_log_stats_t stats;
+    flash_log_get_stats(&stats);
+
+    // One full page per record, twice round the region
+    uint32_t total = 2 * stats.pages_total;
+    for (uint32_t i = 0; i < total; i++) {
+        snprintf(text, sizeof(text), "%lu", (unsigned long)i);
+        text[strlen(text)] = 'x';
+        CHECK(flash_log_append(LOG_LEVEL_INFO, LOG_CAT_SYSTEM, text));
+        flash_log_flush();
+    }
+    // Let the erase-ahead catch up
+    for (int i = 0; i < 4; i++) {
+        flash_log_process();
+    }
+
+    flash_log_get_stats(&stats);
+    CHECK_EQ(stats.dropped_records, 0);
+    // The spare sector is always erased, the write sector is empty after a wrap here
+    CHECK_EQ(stats.pages_used, stats.pages_total - 2 * STORAGE_PAGES_PER_SECTOR);
+
+    region_scan_t scan;
+    scan_region(&scan);
+    CHECK_EQ(scan.pages, stats.pages_used);
+    CHECK_EQ(scan.torn, 0);
+    CHECK_EQ(scan.last_seq, total);
+
+    // Remount finds the same write position
+    CHECK(flash_log_init());
+    flash_log_get_stats(&stats);
+    CHECK_EQ(stats.pages_used, scan.pages);
+    CHECK_EQ(stats.torn_pages, 0);
+}
+
+static void test_full_queue_drops(void) {
+    char text[FLASH_LOG_MAX_TEXT + 1];
+    memset(text, 'y', FLASH_LOG_MAX_TEXT);
+    text[FLASH_LOG_MAX_TEXT] = '\0';
+
+    mount_fresh();
+
+    // No flash_log_process(): the RAM page plus the pending pages fill up
+    uint32_t accepted = 0;
+    for (uint32_t i = 0; i < FLASH_LOG_PENDING_PAGES + 4; i++) {
+        accepted += flash_log_append(LOG_LEVEL_INFO, LOG_CAT_SYSTEM, text);
+    }
+    CHECK_EQ(accepted, FLASH_LOG_PENDING_PAGES + 1);
+
+    flash_log_stats_t stats;
+    flash_log_get_stats(&stats);
+    CHECK_EQ(stats.dropped_records, 3);
+    CHECK_EQ(stub_lock_depth, 0);
+}
+
+static void test_binary_record(void) {
+    static const char format[] = "dose %lu ml";
+    const uint32_t args[] = { 42 };
+
+    mount_fresh();
+    CHECK(flash_log_append_binary(LOG_LEVEL_INFO, LOG_CAT_STEPPER, format, args, 1, 0));
+    flash_log_flush();
+
+    region_scan_t scan;
+    scan_region(&scan);
+    CHECK_EQ(scan.records, 1);
+    CHECK_EQ(scan.last_level, LOG_LEVEL_INFO | FLASH_LOG_LEVEL_BINARY);
+
+    // fmt:u32 flags:u8 args:u32[]
+    uint32_t fmt, arg;
+    const uint8_t* text = (const uint8_t*)scan.last_text;
+    memcpy(&fmt, text, 4);
+    memcpy(&arg, text + 5, 4);
+    CHECK_EQ(fmt, (uint32_t)(uintptr_t)format);
+    CHECK_EQ(text[4], 0);
+    CHECK_EQ(arg, 42);
+}
+
+static void test_binary_backend_skips_formatting(void) {
+    mount_fresh();
+    log_set_backend(LOG_BACKEND_BINARY);
+
+    // Registered by flash_log_init(); the record lands in flash unformatted
+    log_message(LOG_LEVEL_WARN, LOG_CAT_SYSTEM, "pump %d stalled", 3);
+    flash_log_flush();
+    log_set_backend(LOG_BACKEND_TEXT);
+
+    region_scan_t scan;
+    scan_region(&scan);
+    CHECK_EQ(scan.last_level, LOG_LEVEL_WARN | FLASH_LOG_LEVEL_BINARY);
+    uint32_t arg;
+    memcpy(&arg, scan.last_text + 5, 4);
+    CHECK_EQ(arg, 3);
+}
+
+int main(void) {
+    log_init();
+    log_set_level(LOG_LEVEL_WARN);
+
+    TEST_RUN(test_records_reach_flash);
+    TEST_RUN(test_idle_page_is_sealed);
+    TEST_RUN(test_remount_keeps_data);
+    TEST_RUN(test_torn_page_is_skipped);
+    TEST_RUN(test_wrap_discards_oldest);
+    TEST_RUN(test_full_queue_drops);
+    TEST_RUN(test_binary_record);
+    TEST_RUN(test_binary_backend_skips_formatting);
+    TEST_EXIT();
+}
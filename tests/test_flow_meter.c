@@ -0,0 +1,245 @@
+/**
+ * Host tests for the flow meter (drivers/flow_meter/flow_meter.c) and the
+ * closed-loop dosing on top of it
+ *
+ * The PIO program is modelled by its output: each sensor pulse puts the
+ * period count into the state machine's RX FIFO and fires the DMA request,
+ * so the samples reach the ring through the DMA model like on the chip.
+ * The first edge after start and after 2^33 idle cycles (~57 s) comes
+ * without a period, the latter after an idle marker.
+ * Dosing runs on the stepper driver model, with a pump that delivers less
+ * than its calibration says.
+ */
+
+#include "test_support.h"
+#include "flow_meter.h"
+#include "flow_meter.pio.h"
+#include "hardware/dma.h"
+#include "hardware/clocks.h"
+#include "dosing.h"
+#include "stepper_planner.h"
+#include "stepper_driver_sim.h"
+#include "settings_store.h"
+#include "storage_flash.h"
+#include "logging.h"
+#include <math.h>
+
+#define PULSES_PER_LITRE 5880               // YF-S401 class sensor, ~170 uL per pulse
+#define SENSOR_CHANNEL 0                    // Counted by hand in the meter tests
+#define DOSING_CHANNEL 1                    // On the dosing pump's line
+#define CYCLES_PER_US (STUB_SYS_CLOCK_HZ / 1000000)
+#define IDLE_CYCLES (1ull << 33)            // The state machine's count runs out
+
+static uint64_t last_pulse_us[FLOW_METER_MAX_CHANNELS];
+static bool timing[FLOW_METER_MAX_CHANNELS];  // The state machine has seen an edge since start or idle
+static uint32_t sensor_pulses[FLOW_METER_MAX_CHANNELS];
+
+// Pump and line for the dosing tests
+static double delivery_factor;              // Delivered share of the calibrated volume
+static double delivered_ul;
+static double pending_ul;                   // Through the sensor, not yet a whole pulse
+
+// The state machine pushes a sample, DMA moves it
+static void sensor_push(uint32_t channel, uint32_t sample) {
+    pio0->rxf[channel] = sample;
+    CHECK(stub_dma_transfer(channel));      // Channels and state machines were claimed in order
+}
+
+// One rising edge on a sensor: the period count, or the first edge after start or idle
+static void sensor_pulse(uint32_t channel) {
+    uint64_t period_cycles = (stub_time_us - last_pulse_us[channel]) * CYCLES_PER_US;
+    last_pulse_us[channel] = stub_time_us;
+    sensor_pulses[channel]++;
+    if (timing[channel] && period_cycles >= IDLE_CYCLES) {
+        sensor_push(channel, FLOW_PERIOD_IDLE);
+        timing[channel] = false;
+    }
+    if (!timing[channel]) {
+        sensor_push(channel, FLOW_PERIOD_FIRST_EDGE);
+        timing[channel] = true;
+        return;
+    }
+    sensor_push(channel, (uint32_t)((period_cycles - FLOW_PERIOD_OVERHEAD_CYCLES) / 2));
+}
+
+static void on_step(int32_t position, uint32_t freq_hz) {
+    (void)position;
+    (void)freq_hz;
+    double ul = delivery_factor * DOSING_DEFAULT_UL_PER_REV / STEPPER_STEPS_PER_REV;
+    delivered_ul += ul;
+    pending_ul += ul;
+    double ul_per_pulse = 1e6 / PULSES_PER_LITRE;
+    while (pending_ul >= ul_per_pulse) {
+        pending_ul -= ul_per_pulse;
+        sensor_pulse(DOSING_CHANNEL);
+    }
+}
+
+static uint32_t read_meter(uint8_t pump) {
+    return pump == 0 ? flow_meter_get_volume_ul(DOSING_CHANNEL) : DOSING_FLOW_NONE;
+}
+
+static void reset_dosing(double factor) {
+    storage_flash_init();
+    settings_init();
+    stub_stepper_reset();
+    stub_stepper_on_step = on_step;
+    dosing_init();
+    dosing_set_flow_callback(read_meter);
+    delivery_factor = factor;
+    delivered_ul = 0;
+    pending_ul = 0;
+}
+
+static void run_dosing(void) {
+    for (int pass = 0; pass < 1000000 && (dosing_is_busy() || stepper_planner_is_running()); pass++) {
+        stub_stepper_run(32);
+        stepper_planner_process();
+        flow_meter_process();
+        dosing_process();
+    }
+}
+
+static void test_conversions(void) {
+    CHECK_EQ(flow_meter_ul_per_pulse_q16(PULSES_PER_LITRE) >> 16, 170);
+    CHECK_EQ(flow_meter_ul_per_pulse_q16(0), 0);
+
+    // 10 pulses per second of 170.07 uL
+    uint32_t q16 = flow_meter_ul_per_pulse_q16(PULSES_PER_LITRE);
+    CHECK_EQ(flow_meter_period_to_flow(STUB_SYS_CLOCK_HZ / 10, STUB_SYS_CLOCK_HZ, q16), 1700);
+    CHECK_EQ(flow_meter_period_to_flow(0, STUB_SYS_CLOCK_HZ, q16), 0);
+
+    CHECK(!flow_meter_init(FLOW_METER_MAX_CHANNELS, 5, PULSES_PER_LITRE));
+    CHECK(!flow_meter_init(SENSOR_CHANNEL, 5, PULSES_PER_LITRE));      // Already running
+    CHECK(!flow_meter_is_active(FLOW_METER_MAX_CHANNELS));
+}
+
+static void test_pulses_through_the_ring(void) {
+    // 20 pulses per second; the main loop only drains every 5 s, 100 samples at a time
+    for (int i = 1; i <= 600; i++) {
+        stub_time_us += 50000;
+        sensor_pulse(SENSOR_CHANNEL);
+        if (i % 100 == 0) {
+            flow_meter_process();
+        }
+    }
+
+    flow_meter_stats_t stats;
+    flow_meter_get_stats(SENSOR_CHANNEL, &stats);
+    CHECK_EQ(stats.pulses, 600);
+    CHECK_EQ(stats.last_period_cycles, 50000 * CYCLES_PER_US);
+    CHECK_EQ(stats.min_period_cycles, 50000 * CYCLES_PER_US);
+    CHECK_EQ(stats.max_period_cycles, 50000 * CYCLES_PER_US);
+    CHECK_EQ(flow_meter_get_pulses(SENSOR_CHANNEL), 600);
+    CHECK_EQ(flow_meter_get_volume_ul(SENSOR_CHANNEL), 600 * 1000000ull / PULSES_PER_LITRE);
+    CHECK_EQ(flow_meter_get_flow_ul_per_s(SENSOR_CHANNEL), 3401);
+}
+
+static void test_volume_between_pulses(void) {
+    uint32_t at_pulse = flow_meter_get_volume_ul(SENSOR_CHANNEL);
+    uint32_t ul_per_pulse = 1000000 / PULSES_PER_LITRE;
+
+    // Grows with time at the current rate, but never to the next count
+    stub_time_us += 25000;
+    uint32_t half_way = flow_meter_get_volume_ul(SENSOR_CHANNEL);
+    CHECK(half_way >= at_pulse + ul_per_pulse / 2 - 5 && half_way <= at_pulse + ul_per_pulse / 2 + 5);
+    stub_time_us += 200000;
+    uint32_t late = flow_meter_get_volume_ul(SENSOR_CHANNEL);
+    CHECK(late > half_way && late < at_pulse + ul_per_pulse);
+
+    // Flow stopped: the reading settles on the counted pulses
+    stub_time_us += FLOW_METER_TIMEOUT_MS * 1000ull;
+    CHECK_EQ(flow_meter_get_flow_ul_per_s(SENSOR_CHANNEL), 0);
+    CHECK_EQ(flow_meter_get_volume_ul(SENSOR_CHANNEL), at_pulse);
+
+    // Past the state machine's count: the idle marker counts as a timeout, the edge after it as a
+    // pulse, and the rate starts fresh from that edge
+    stub_time_us += IDLE_CYCLES / CYCLES_PER_US;
+    sensor_pulse(SENSOR_CHANNEL);
+    flow_meter_process();
+    flow_meter_stats_t stats;
+    flow_meter_get_stats(SENSOR_CHANNEL, &stats);
+    CHECK_EQ(stats.timeouts, 1);
+    CHECK_EQ(stats.pulses, 601);
+    CHECK_EQ(flow_meter_get_flow_ul_per_s(SENSOR_CHANNEL), 0);
+    stub_time_us += 100000;
+    sensor_pulse(SENSOR_CHANNEL);
+    flow_meter_process();
+    CHECK_EQ(flow_meter_get_pulses(SENSOR_CHANNEL), 602);
+    CHECK_EQ(flow_meter_get_flow_ul_per_s(SENSOR_CHANNEL), 1700);
+    CHECK_EQ(flow_meter_get_volume_ul(SENSOR_CHANNEL), 602 * 1000000ull / PULSES_PER_LITRE);
+}
+
+static void test_closed_loop_dose(void) {
+    // Worn tubing: 85% of what the curve says; open loop that would be 17 mL
+    reset_dosing(0.85);
+    CHECK(dosing_queue(0, 0, 20000, 0));
+    run_dosing();
+
+    dosing_stats_t stats;
+    dosing_get_stats(&stats);
+    printf("  %.0f uL delivered for 20000 uL, %lu corrections\n", delivered_ul, (unsigned long)stats.corrections);
+    CHECK_EQ(stats.completed, 1);
+    CHECK(stats.corrections > 0);
+    CHECK_EQ(stats.flow_faults, 0);
+    CHECK(fabs(delivered_ul - 20000) < 400);
+}
+
+static void test_dose_after_long_idle(void) {
+    // A minute after the last dose the state machine has timed out; the first pulse of the next dose counts
+    stub_time_us += 60 * 1000000ull;
+    flow_meter_stats_t before;
+    flow_meter_get_stats(DOSING_CHANNEL, &before);
+    reset_dosing(1.0);
+    CHECK(dosing_queue(0, 0, 5000, 0));
+    run_dosing();
+
+    flow_meter_stats_t after;
+    flow_meter_get_stats(DOSING_CHANNEL, &after);
+    dosing_stats_t stats;
+    dosing_get_stats(&stats);
+    printf("  %.0f uL delivered for 5000 uL after a minute idle, %lu of %lu pulses counted\n", delivered_ul,
+           (unsigned long)(after.pulses - before.pulses),
+           (unsigned long)(sensor_pulses[DOSING_CHANNEL] - before.pulses));
+    CHECK_EQ(after.timeouts, before.timeouts + 1);
+    CHECK_EQ(after.pulses, sensor_pulses[DOSING_CHANNEL]);
+    CHECK_EQ(stats.completed, 1);
+    CHECK_EQ(stats.flow_faults, 0);
+    CHECK(fabs(delivered_ul - 5000) < 1000000.0 / PULSES_PER_LITRE);
+}
+
+static void test_dry_run_stops(void) {
+    // Reservoir empty: a trickle of what the steps should move
+    reset_dosing(0.05);
+    CHECK(dosing_queue(0, 0, 20000, 0));
+    CHECK(dosing_queue(0, 1, 20000, 0));
+    run_dosing();
+
+    dosing_stats_t stats;
+    dosing_get_stats(&stats);
+    printf("  stopped after %.0f uL\n", delivered_ul);
+    CHECK_EQ(stats.flow_faults, 1);
+    CHECK_EQ(stats.aborted, 1);
+    CHECK_EQ(stats.completed, 0);
+    CHECK(delivered_ul < 1000);
+    CHECK(!dosing_is_busy());
+}
+
+int main(void) {
+    log_init();
+    log_set_level(LOG_LEVEL_NONE);
+
+    // Both sensors for the whole run: the driver has no way to release a channel
+    stub_dma_reset();
+    CHECK(flow_meter_init(SENSOR_CHANNEL, 5, PULSES_PER_LITRE));
+    CHECK(flow_meter_init(DOSING_CHANNEL, 6, PULSES_PER_LITRE));
+    CHECK(flow_meter_is_active(SENSOR_CHANNEL));
+
+    TEST_RUN(test_conversions);
+    TEST_RUN(test_pulses_through_the_ring);
+    TEST_RUN(test_volume_between_pulses);
+    TEST_RUN(test_closed_loop_dose);
+    TEST_RUN(test_dose_after_long_idle);
+    TEST_RUN(test_dry_run_stops);
+    TEST_EXIT();
+}
@@ -0,0 +1,175 @@
+/**
+ * Host tests for the history chart downsampling (lvgl/lvgl_screen/history_lttb.c)
+ *
+ * A week and a half of samples with spikes and gaps is streamed from an
+ * array. Incremental pans and zooms must give exactly the window a full
+ * recomputation gives, while reading fewer points.
+ */
+
+#include "test_support.h"
+#include "history_lttb.h"
+#include <stdlib.h>
+
+#define POINTS 300000
+#define WIDTH 220
+
+static uint32_t times[POINTS];
+static int32_t values[POINTS];
+static uint32_t count;
+
+typedef struct {
+    uint32_t pos;
+    uint32_t to;
+} array_source_t;
+
+static void array_open(void* ctx, uint32_t from, uint32_t to) {
+    array_source_t* source = ctx;
+    uint32_t lo = 0;
+    uint32_t hi = count;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (times[mid] < from) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    source->pos = lo;
+    source->to = to;
+}
+
+static bool array_next(void* ctx, uint32_t* time, int32_t* value) {
+    array_source_t* source = ctx;
+    if (source->pos >= count || times[source->pos] > source->to) {
+        return false;
+    }
+    *time = times[source->pos];
+    *value = values[source->pos];
+    source->pos++;
+    return true;
+}
+
+// Samples every 15 min with the odd 50 min gap, a slow drift, noise and a spike every 200 samples
+static void make_history(void) {
+    srand(3);
+    uint32_t time = 1000000;
+    for (count = 0; count < POINTS; count++) {
+        time += rand() % 50 == 0 ? 3000 : 900;
+        times[count] = time;
+        values[count] = (int32_t)(2000 + (count % 200 == 0 ? 600 : 0) + rand() % 40 - (int32_t)((count / 1000) % 300));
+    }
+}
+
+static bool same_bucket(const history_lttb_bucket_t* a, const history_lttb_bucket_t* b) {
+    return a->valid == b->valid && a->count == b->count && a->avg_value == b->avg_value &&
+           (!a->valid || (a->sel_time == b->sel_time && a->sel_value == b->sel_value));
+}
+
+static void test_incremental_matches_full(void) {
+    static history_lttb_t incremental;
+    static history_lttb_t full;
+    array_source_t ctx_a, ctx_b;
+    history_lttb_source_t source_a = { array_open, array_next, &ctx_a };
+    history_lttb_source_t source_b = { array_open, array_next, &ctx_b };
+    history_lttb_init(&incremental, &source_a, WIDTH);
+    history_lttb_init(&full, &source_b, WIDTH);
+
+    srand(5);
+    uint32_t bucket_seconds = 3 * 3600;
+    uint32_t start = times[0] + 5 * 86400;
+    uint64_t read_incremental = 0;
+    uint64_t read_full = 0;
+    uint32_t differences = 0;
+    history_lttb_set_window(&incremental, start, bucket_seconds);
+
+    for (int step = 0; step < 3000; step++) {
+        // Mostly short pans either way, some long jumps, and a zoom every 500 steps
+        int r = rand() % 10;
+        int buckets = r < 4 ? rand() % 60 + 1 : r < 8 ? -(rand() % 60 + 1) : rand() % 400 - 200;
+        int64_t next = (int64_t)start + (int64_t)buckets * bucket_seconds;
+        if (next < (int64_t)times[0] - 3 * 86400 || next > (int64_t)times[count - 1]) {
+            next = (int64_t)start - (int64_t)buckets * bucket_seconds;
+        }
+        start = (uint32_t)next;
+        if (step % 500 == 499) {
+            bucket_seconds = bucket_seconds == 3 * 3600 ? 3600 : 3 * 3600;
+        }
+
+        history_lttb_set_window(&incremental, start, bucket_seconds);
+        read_incremental += incremental.points_read;
+        history_lttb_invalidate(&full);
+        history_lttb_set_window(&full, start, bucket_seconds);
+        read_full += full.points_read;
+
+        CHECK_EQ(history_lttb_get_start(&incremental), history_lttb_get_start(&full));
+        for (uint16_t i = 0; i < WIDTH; i++) {
+            differences += !same_bucket(history_lttb_get(&incremental, i), history_lttb_get(&full, i));
+        }
+    }
+    printf("  incremental read %.1f%% of the points of full recomputes\n", 100.0 * read_incremental / read_full);
+    CHECK_EQ(differences, 0);
+    CHECK(read_incremental * 4 < read_full);
+}
+
+static void test_spikes_survive(void) {
+    static history_lttb_t lttb;
+    array_source_t ctx;
+    history_lttb_source_t source = { array_open, array_next, &ctx };
+    history_lttb_init(&lttb, &source, WIDTH);
+
+    // About 16 samples per bucket; a bucket holding a spike keeps it
+    uint32_t bucket_seconds = 4 * 3600;
+    uint32_t start = times[10000];
+    history_lttb_set_window(&lttb, start, bucket_seconds);
+    uint32_t spikes = 0;
+    uint32_t kept = 0;
+    for (uint16_t i = 1; i + 1 < WIDTH; i++) {
+        const history_lttb_bucket_t* bucket = history_lttb_get(&lttb, i);
+        uint32_t from = history_lttb_get_start(&lttb) + i * bucket_seconds;
+        for (uint32_t p = 0; p < count; p += 200) {
+            if (times[p] >= from && times[p] < from + bucket_seconds) {
+                spikes++;
+                kept += bucket->valid && bucket->sel_time == times[p];
+            }
+        }
+    }
+    printf("  %lu of %lu spikes kept\n", (unsigned long)kept, (unsigned long)spikes);
+    CHECK(spikes > 10);
+    CHECK_EQ(kept, spikes);
+}
+
+static void test_gaps_and_edges(void) {
+    static history_lttb_t lttb;
+    array_source_t ctx;
+    history_lttb_source_t source = { array_open, array_next, &ctx };
+    history_lttb_init(&lttb, &source, WIDTH);
+
+    // Half the window before the first sample: empty buckets there, none after
+    uint32_t bucket_seconds = 3600;
+    uint32_t start = times[0] - WIDTH / 2 * bucket_seconds;
+    history_lttb_set_window(&lttb, start, bucket_seconds);
+    CHECK_EQ(history_lttb_get_start(&lttb) % bucket_seconds, 0);
+    CHECK(!history_lttb_get(&lttb, 0)->valid);
+    CHECK(!history_lttb_get(&lttb, WIDTH / 2 - 2)->valid);
+    CHECK(history_lttb_get(&lttb, WIDTH / 2 + 1)->valid);
+    CHECK(history_lttb_get(&lttb, WIDTH - 1)->valid);
+
+    // Buckets shorter than the sample interval: every other one is a gap
+    history_lttb_set_window(&lttb, times[1000], 450);
+    uint32_t gaps = 0;
+    for (uint16_t i = 0; i < WIDTH; i++) {
+        const history_lttb_bucket_t* bucket = history_lttb_get(&lttb, i);
+        gaps += !bucket->valid;
+        CHECK(!bucket->valid || bucket->count == 1);
+    }
+    CHECK(gaps >= WIDTH / 2 - 2);
+}
+
+int main(void) {
+    make_history();
+
+    TEST_RUN(test_incremental_matches_full);
+    TEST_RUN(test_spikes_survive);
+    TEST_RUN(test_gaps_and_edges);
+    TEST_EXIT();
+}
@@ -0,0 +1,120 @@
+/**
+ * Host tests for the integer orientation maths (drivers/imu/imu_math.c)
+ *
+ * CORDIC results are compared against libm over random vectors of every
+ * scale, and over gravity vectors spread evenly on the sphere.
+ */
+
+#include "test_support.h"
+#include "imu_math.h"
+#include <math.h>
+#include <stdlib.h>
+
+#define ONE_G 8192                          // +-4 g range, raw LSB
+
+// Difference of two angles in centidegrees, across the +-180 degree wrap
+static double angle_error(double a, double b) {
+    return fabs(fmod(a - b + 54000.0, 36000.0) - 18000.0);
+}
+
+static double to_cdeg(double radians) {
+    return radians * 18000.0 / M_PI;
+}
+
+static int32_t random_in(int32_t range) {
+    int64_t r = ((int64_t)rand() << 16) ^ rand();
+    return (int32_t)(r % (2 * (int64_t)range + 1) - range);
+}
+
+static void test_atan2_and_hypot(void) {
+    // Raw readings, small noisy ones, near the input limit and almost zero
+    static const int32_t ranges[] = { 32768, 300, 1 << 30, 8 };
+    srand(7);
+    double max_angle = 0;
+    double max_hypot = 0;
+    for (int k = 0; k < 400000; k++) {
+        int32_t x = random_in(ranges[k % 4]);
+        int32_t y = random_in(ranges[k % 4]);
+        uint32_t hypot_out;
+        int32_t angle = imu_math_atan2(y, x, &hypot_out);
+
+        double reference = x == 0 && y == 0 ? 0 : to_cdeg(atan2(y, x));
+        double length = hypot(x, y);
+        double angle_err = angle_error(angle, reference);
+        // Absolute below 2^20, relative to 2^20 above
+        double hypot_err = fabs(hypot_out - length) / (length < (1 << 20) ? 1 : length / (1 << 20));
+        max_angle = angle_err > max_angle ? angle_err : max_angle;
+        max_hypot = hypot_err > max_hypot ? hypot_err : max_hypot;
+    }
+    printf("  atan2 max error %.3f cdeg, hypot %.2f LSB\n", max_angle, max_hypot);
+    CHECK(max_angle <= 1.0);
+    CHECK(max_hypot <= 1.0);
+
+    // Axes and the hypot pointer is optional
+    CHECK_EQ(imu_math_atan2(0, 1000, NULL), 0);
+    CHECK_EQ(imu_math_atan2(1000, 0, NULL), 9000);
+    CHECK_EQ(imu_math_atan2(-1000, 0, NULL), -9000);
+    CHECK(abs(imu_math_atan2(0, -1000, NULL)) == 18000);
+    uint32_t length;
+    CHECK_EQ(imu_math_atan2(0, 0, &length), 0);
+    CHECK_EQ(length, 0);
+}
+
+static void test_tilt_over_the_sphere(void) {
+    srand(11);
+    double max_roll = 0, max_pitch = 0, max_tilt = 0, max_direction = 0, max_magnitude = 0;
+    for (int k = 0; k < 100000; k++) {
+        double theta = acos(2.0 * rand() / RAND_MAX - 1);
+        double phi = 2 * M_PI * rand() / RAND_MAX;
+        int32_t x = lround(ONE_G * sin(theta) * cos(phi));
+        int32_t y = lround(ONE_G * sin(theta) * sin(phi));
+        int32_t z = lround(ONE_G * cos(theta));
+        imu_tilt_t tilt;
+        imu_math_tilt(x, y, z, &tilt);
+
+        double xy = sqrt((double)x * x + (double)y * y);
+        double roll = angle_error(tilt.roll_cdeg, to_cdeg(atan2(y, z)));
+        double pitch = angle_error(tilt.pitch_cdeg, to_cdeg(atan2(-x, sqrt((double)y * y + (double)z * z))));
+        double lean = angle_error(tilt.tilt_cdeg, to_cdeg(atan2(xy, z)));
+        double direction = angle_error(tilt.direction_cdeg, x || y ? to_cdeg(atan2(y, x)) : 0);
+        double magnitude = fabs(tilt.magnitude - sqrt(xy * xy + (double)z * z));
+        max_roll = roll > max_roll ? roll : max_roll;
+        max_pitch = pitch > max_pitch ? pitch : max_pitch;
+        max_tilt = lean > max_tilt ? lean : max_tilt;
+        max_direction = direction > max_direction ? direction : max_direction;
+        max_magnitude = magnitude > max_magnitude ? magnitude : max_magnitude;
+    }
+    printf("  max errors: roll %.2f, pitch %.2f, tilt %.2f, direction %.2f cdeg, magnitude %.2f LSB\n",
+           max_roll, max_pitch, max_tilt, max_direction, max_magnitude);
+    CHECK(max_roll <= 1.5 && max_pitch <= 1.5 && max_tilt <= 1.5 && max_direction <= 1.5);
+    CHECK(max_magnitude <= 1.5);
+
+    // Lying flat, upside down and on its side
+    imu_tilt_t tilt;
+    imu_math_tilt(0, 0, ONE_G, &tilt);
+    CHECK_EQ(tilt.tilt_cdeg, 0);
+    CHECK_EQ(tilt.magnitude, ONE_G);
+    imu_math_tilt(0, 0, -ONE_G, &tilt);
+    CHECK_EQ(tilt.tilt_cdeg, 18000);
+    imu_math_tilt(-ONE_G, 0, 0, &tilt);
+    CHECK_EQ(tilt.pitch_cdeg, 9000);
+    CHECK_EQ(tilt.tilt_cdeg, 9000);
+}
+
+static void test_isqrt(void) {
+    uint32_t bad = 0;
+    for (uint64_t v = 0; v <= UINT32_MAX; v += v < 70000 ? 1 : 65521) {
+        uint64_t r = imu_math_isqrt((uint32_t)v);
+        bad += r * r > v || (r + 1) * (r + 1) <= v;
+    }
+    CHECK_EQ(bad, 0);
+    CHECK_EQ(imu_math_isqrt(UINT32_MAX), 65535);
+    CHECK_EQ(imu_math_isqrt(65536u * 65535u), 65535);
+}
+
+int main(void) {
+    TEST_RUN(test_atan2_and_hypot);
+    TEST_RUN(test_tilt_over_the_sphere);
+    TEST_RUN(test_isqrt);
+    TEST_EXIT();
+}
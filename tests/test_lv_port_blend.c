@@ -0,0 +1,221 @@
+/**
+ * Host tests for the RGB565 blend backend (lvgl/lv_port/lv_port_blend.c)
+ *
+ * Random blends (clip areas cutting the draw buffer, masks offset from the
+ * blend area, odd widths and halfword-misaligned sources and destinations,
+ * opacities near the thresholds) go through lv_draw_sw_blend_basic() and
+ * lv_port_blend() on copies of the same buffer; the results must be
+ * bit-identical. The DMA backend is replaced by a fake that takes every
+ * other eligible fill and copy and does it on the CPU.
+ */
+
+#include "test_support.h"
+#include "lv_port_blend.h"
+#include "lv_port_dma.h"
+#include "lv_port_glyph.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define BUF_W 300
+#define BUF_H 40
+#define BUF_PIXELS ((BUF_W + 8) * (BUF_H + 6))
+
+static lv_color_t expect[BUF_PIXELS];
+static lv_color_t actual[BUF_PIXELS];
+static lv_color_t source[BUF_PIXELS];
+static lv_opa_t mask[BUF_PIXELS];
+
+// DMA backend fake: accepts the hand-off when told to
+static bool dma_accepts;
+static uint32_t dma_fills;
+static uint32_t dma_copies;
+
+bool lv_port_dma_fill(lv_color_t *dest, lv_coord_t dest_stride, int32_t w, int32_t h, lv_color_t color) {
+    if (!dma_accepts) {
+        return false;
+    }
+    for (int32_t y = 0; y < h; y++) {
+        for (int32_t x = 0; x < w; x++) {
+            dest[y * dest_stride + x] = color;
+        }
+    }
+    dma_fills++;
+    return true;
+}
+
+bool lv_port_dma_copy(lv_color_t *dest, lv_coord_t dest_stride, const lv_color_t *src, lv_coord_t src_stride,
+                      int32_t w, int32_t h) {
+    if (!dma_accepts) {
+        return false;
+    }
+    for (int32_t y = 0; y < h; y++) {
+        memcpy(dest + y * dest_stride, src + y * src_stride, w * sizeof(lv_color_t));
+    }
+    dma_copies++;
+    return true;
+}
+
+void lv_port_dma_wait(void) {
+}
+
+void lv_port_glyph_draw_letter(lv_draw_ctx_t *draw_ctx, const lv_draw_label_dsc_t *dsc, const lv_point_t *pos_p,
+                               uint32_t letter) {
+    lv_draw_sw_letter(draw_ctx, dsc, pos_p, letter);
+}
+
+static void flush(lv_disp_drv_t *disp_drv, const lv_area_t *area, lv_color_t *color_p) {
+    (void)area;
+    (void)color_p;
+    lv_disp_flush_ready(disp_drv);
+}
+
+static lv_disp_t *make_display(void) {
+    static lv_disp_draw_buf_t draw_buf;
+    static lv_color_t buf[240 * 10];
+    static lv_disp_drv_t disp_drv;
+    lv_disp_draw_buf_init(&draw_buf, buf, NULL, 240 * 10);
+    lv_disp_drv_init(&disp_drv);
+    disp_drv.hor_res = 240;
+    disp_drv.ver_res = 320;
+    disp_drv.flush_cb = flush;
+    disp_drv.draw_buf = &draw_buf;
+    disp_drv.draw_ctx_init = lv_port_blend_init_ctx;
+    return lv_disp_drv_register(&disp_drv);
+}
+
+static uint32_t random_u32(void) {
+    return ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+}
+
+static int32_t random_in(int32_t n) {
+    return (int32_t)(random_u32() % (uint32_t)n);
+}
+
+// Buffer contents need a lot of random numbers: xorshift, seeded from rand()
+static uint32_t noise_state;
+
+static uint32_t noise(void) {
+    noise_state ^= noise_state << 13;
+    noise_state ^= noise_state >> 17;
+    noise_state ^= noise_state << 5;
+    return noise_state;
+}
+
+// Draw buffer contents: noise, stripes, black and gradients (the kernels special-case some values)
+static void fill_destination(int32_t pixels) {
+    int kind = random_in(4);
+    int32_t black = random_in(3) == 0 ? random_in(300) : 0;
+    for (int32_t i = 0; i < pixels; i++) {
+        uint16_t v = kind == 0 ? (uint16_t)noise() : kind == 1 ? ((i / 7) % 2 ? 0x1234 : 0xFFFF)
+                   : kind == 2 ? 0 : (uint16_t)((i / 13) * 0x0841u ^ 0x39E7);
+        expect[i].full = i < black ? 0 : v;
+    }
+    memcpy(actual, expect, sizeof(actual));
+}
+
+// Mask bytes weighted to the fully covered, transparent and nearly-so values
+static void fill_source_and_mask(int32_t pixels) {
+    for (int32_t i = 0; i < pixels; i++) {
+        uint32_t r = noise();
+        source[i].full = (uint16_t)r;
+        uint32_t k = (r >> 16) % 10;
+        uint32_t v = r >> 24;
+        mask[i] = k < 3 ? 0 : k < 6 ? 255 : k < 7 ? (lv_opa_t)(250 + v % 6) : k < 8 ? (lv_opa_t)(v % 5) : (lv_opa_t)v;
+    }
+    int32_t whole = random_in(4);
+    if (whole == 0) {
+        memset(mask, 0, pixels);
+    } else if (whole == 1) {
+        memset(mask, 255, pixels);
+    }
+}
+
+// One random blend through both kernels; true if the buffers match
+static bool blend_case(void) {
+    int32_t bw = 1 + random_in(BUF_W);
+    int32_t bh = 1 + random_in(BUF_H);
+    int32_t bx = random_in(50) - 10;
+    int32_t by = random_in(50) - 10;
+    lv_area_t buf_area = { bx, by, bx + bw - 1, by + bh - 1 };
+    lv_area_t clip = { bx + random_in(4), by + random_in(3), bx + bw - 1 - random_in(4), by + bh - 1 - random_in(3) };
+    int32_t aw = 1 + random_in(bw + 6);
+    int32_t ah = 1 + random_in(bh + 4);
+    int32_t ax = bx - 3 + random_in(bw + 3);
+    int32_t ay = by - 2 + random_in(bh + 2);
+    lv_area_t blend_area = { ax, ay, ax + aw - 1, ay + ah - 1 };
+    lv_area_t mask_area = blend_area;
+    if (random_in(4) == 0) {
+        mask_area.x1 -= random_in(3);
+        mask_area.y1 -= random_in(2);
+        mask_area.x2 += random_in(3);
+    }
+    int32_t dest_offset = random_in(2);                 // Draw buffer starting on a halfword
+    noise_state = random_u32() | 1;
+
+    // Only the part of the buffers this blend can reach is refilled
+    int32_t pixels = (bw + 8) * (bh + 6);
+    fill_destination(pixels);
+    fill_source_and_mask(pixels);
+
+    lv_draw_sw_blend_dsc_t dsc;
+    memset(&dsc, 0, sizeof(dsc));
+    dsc.blend_area = &blend_area;
+    dsc.mask_area = &mask_area;
+    dsc.color.full = (uint16_t)random_u32();
+    int32_t opa = random_in(8);
+    dsc.opa = opa == 0 ? LV_OPA_COVER : opa == 1 ? (lv_opa_t)(250 + random_in(6)) : (lv_opa_t)random_u32();
+    dsc.src_buf = random_in(2) ? source + random_in(3) : NULL;
+    int32_t mask_kind = random_in(5);
+    dsc.mask_buf = mask_kind ? mask + random_in(4) : NULL;
+    dsc.mask_res = mask_kind == 1 ? LV_DRAW_MASK_RES_FULL_COVER
+                 : mask_kind == 2 ? LV_DRAW_MASK_RES_TRANSP : LV_DRAW_MASK_RES_CHANGED;
+    if (!mask_kind) {
+        dsc.mask_res = random_in(2) ? LV_DRAW_MASK_RES_FULL_COVER : LV_DRAW_MASK_RES_CHANGED;
+    }
+    dsc.blend_mode = random_in(16) == 0 ? LV_BLEND_MODE_ADDITIVE : LV_BLEND_MODE_NORMAL;
+
+    lv_draw_sw_ctx_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.base_draw.buf_area = &buf_area;
+    ctx.base_draw.clip_area = &clip;
+    ctx.base_draw.buf = expect + dest_offset;
+    lv_draw_sw_blend_basic(&ctx.base_draw, &dsc);
+    ctx.base_draw.buf = actual + dest_offset;
+    lv_port_blend(&ctx.base_draw, &dsc);
+    return memcmp(expect, actual, sizeof(actual)) == 0;
+}
+
+static void test_matches_lvgl_blend(void) {
+    srand(12345);
+    uint32_t mismatches = 0;
+    for (int i = 0; i < 20000; i++) {
+        dma_accepts = i % 2;
+        mismatches += !blend_case();
+    }
+    printf("  20000 blends, %lu mismatches, %lu fills and %lu copies taken by DMA\n",
+           (unsigned long)mismatches, (unsigned long)dma_fills, (unsigned long)dma_copies);
+    CHECK_EQ(mismatches, 0);
+    CHECK(dma_fills > 100);
+    CHECK(dma_copies > 100);
+}
+
+static void test_init_ctx_installs_the_backend(void) {
+    lv_disp_t *disp = lv_disp_get_default();
+    lv_draw_sw_ctx_t *ctx = (lv_draw_sw_ctx_t *)disp->driver->draw_ctx;
+    CHECK(ctx->blend == lv_port_blend);
+    CHECK(ctx->base_draw.draw_letter == lv_port_glyph_draw_letter);
+    CHECK(ctx->base_draw.draw_rect == lv_draw_sw_rect);
+    // Waits for the DMA too, on top of LVGL's wait
+    CHECK(ctx->base_draw.wait_for_finish != NULL);
+    CHECK(ctx->base_draw.wait_for_finish != lv_draw_sw_wait_for_finish);
+}
+
+int main(void) {
+    lv_init();
+    lv_disp_t *disp = make_display();
+    _lv_refr_set_disp_refreshing(disp);
+
+    TEST_RUN(test_matches_lvgl_blend);
+    TEST_RUN(test_init_ctx_installs_the_backend);
+    TEST_EXIT();
+}
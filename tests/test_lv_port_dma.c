@@ -0,0 +1,194 @@
+/**
+ * Host tests for the DMA draw buffer fills and copies (lvgl/lv_port/lv_port_dma.c)
+ *
+ * The control and data channels run on the DMA model, which takes the
+ * control channel's {read, write} words through the data channel's alias
+ * registers as the chip does. Fills and copies of random rectangles (word
+ * and halfword transfers, one request or a row table) must match a plain
+ * CPU loop and leave everything around them alone; blends through
+ * lv_port_blend() must still match LVGL's own.
+ */
+
+#include "test_support.h"
+#include "lv_port_blend.h"
+#include "lv_port_dma.h"
+#include "lv_port_glyph.h"
+#include "hardware/dma.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define BUF_W 240
+#define BUF_H (LV_PORT_DMA_MAX_ROWS + 8)
+#define BUF_PIXELS (BUF_W * BUF_H + 8)
+
+static lv_color_t expect[BUF_PIXELS];
+static lv_color_t actual[BUF_PIXELS];
+static lv_color_t source[BUF_PIXELS];
+
+void lv_port_glyph_draw_letter(lv_draw_ctx_t *draw_ctx, const lv_draw_label_dsc_t *dsc, const lv_point_t *pos_p,
+                               uint32_t letter) {
+    lv_draw_sw_letter(draw_ctx, dsc, pos_p, letter);
+}
+
+static void flush(lv_disp_drv_t *disp_drv, const lv_area_t *area, lv_color_t *color_p) {
+    (void)area;
+    (void)color_p;
+    lv_disp_flush_ready(disp_drv);
+}
+
+static lv_disp_t *make_display(void) {
+    static lv_disp_draw_buf_t draw_buf;
+    static lv_color_t buf[240 * 10];
+    static lv_disp_drv_t disp_drv;
+    lv_disp_draw_buf_init(&draw_buf, buf, NULL, 240 * 10);
+    lv_disp_drv_init(&disp_drv);
+    disp_drv.hor_res = 240;
+    disp_drv.ver_res = 320;
+    disp_drv.flush_cb = flush;
+    disp_drv.draw_buf = &draw_buf;
+    disp_drv.draw_ctx_init = lv_port_blend_init_ctx;
+    return lv_disp_drv_register(&disp_drv);
+}
+
+static int32_t random_in(int32_t n) {
+    return (int32_t)((((uint32_t)rand() << 16) ^ (uint32_t)rand()) % (uint32_t)n);
+}
+
+static void fill_buffers(void) {
+    for (int32_t i = 0; i < BUF_PIXELS; i++) {
+        expect[i].full = (uint16_t)(i * 0x9E37u);
+        source[i].full = (uint16_t)rand();
+    }
+    memcpy(actual, expect, sizeof(actual));
+}
+
+static void test_no_channels_falls_back(void) {
+    // Every channel taken: init fails and requests stay on the CPU
+    int claimed[NUM_DMA_CHANNELS];
+    for (int i = 0; i < NUM_DMA_CHANNELS; i++) {
+        claimed[i] = dma_claim_unused_channel(false);
+    }
+    CHECK(!lv_port_dma_init());
+    lv_port_dma_set_min_pixels(0);
+    CHECK(!lv_port_dma_fill(actual, BUF_W, 64, 64, lv_color_hex(0xFF0000)));
+    CHECK(!lv_port_dma_copy(actual, BUF_W, source, BUF_W, 64, 64));
+    lv_port_dma_wait();
+    for (int i = 0; i < NUM_DMA_CHANNELS; i++) {
+        dma_channel_unclaim((uint)claimed[i]);
+    }
+
+    CHECK(lv_port_dma_init());
+    lv_port_dma_set_min_pixels(LV_PORT_DMA_MIN_PIXELS);
+}
+
+static void test_threshold_and_row_limit(void) {
+    fill_buffers();
+    lv_color_t red = lv_color_hex(0xFF0000);
+    CHECK(!lv_port_dma_fill(actual, BUF_W, 31, 33, red));
+    CHECK(lv_port_dma_fill(actual, BUF_W, 32, 32, red));
+    lv_port_dma_wait();
+
+    // A rectangle taller than the row table stays on the CPU; a whole-width one is a single request
+    lv_port_dma_set_min_pixels(0);
+    CHECK(!lv_port_dma_copy(actual, BUF_W, source, BUF_W, BUF_W - 1, LV_PORT_DMA_MAX_ROWS + 1));
+    CHECK(!lv_port_dma_fill(actual, BUF_W, BUF_W - 1, LV_PORT_DMA_MAX_ROWS + 1, red));
+    CHECK(lv_port_dma_fill(actual, BUF_W, BUF_W, LV_PORT_DMA_MAX_ROWS + 1, red));
+    lv_port_dma_wait();
+    CHECK(actual[BUF_W * (LV_PORT_DMA_MAX_ROWS + 1) - 1].full == red.full);
+    CHECK(actual[BUF_W * (LV_PORT_DMA_MAX_ROWS + 1)].full != red.full);
+    lv_port_dma_set_min_pixels(LV_PORT_DMA_MIN_PIXELS);
+}
+
+static void test_matches_cpu(void) {
+    srand(7);
+    lv_port_dma_set_min_pixels(0);
+    uint32_t mismatches = 0;
+    uint32_t started = 0;
+    uint32_t cases = 4000;
+    for (uint32_t i = 0; i < cases; i++) {
+        fill_buffers();
+        // Odd and even widths, strides and origins: word and halfword transfers
+        int32_t stride = random_in(3) == 0 ? BUF_W : BUF_W - random_in(3);
+        int32_t w = random_in(3) == 0 ? stride : 1 + random_in(stride);
+        int32_t h = 1 + random_in(LV_PORT_DMA_MAX_ROWS);
+        int32_t offset = random_in(4);
+        int32_t src_offset = random_in(4);
+        lv_color_t *dest = actual + offset;
+        bool copy = i % 2;
+        lv_color_t color;
+        color.full = (uint16_t)rand();
+
+        bool dma;
+        if (copy) {
+            dma = lv_port_dma_copy(dest, stride, source + src_offset, stride, w, h);
+        } else {
+            dma = lv_port_dma_fill(dest, stride, w, h, color);
+        }
+        lv_port_dma_wait();
+        CHECK(dma);
+        started += dma;
+        CHECK(!dma_channel_is_busy(0) && !dma_channel_is_busy(1));
+
+        for (int32_t y = 0; y < h; y++) {
+            for (int32_t x = 0; x < w; x++) {
+                expect[offset + y * stride + x] = copy ? source[src_offset + y * stride + x] : color;
+            }
+        }
+        mismatches += memcmp(expect, actual, sizeof(actual)) != 0;
+    }
+    printf("  %lu fills and copies, %lu mismatches\n", (unsigned long)started, (unsigned long)mismatches);
+    CHECK_EQ(mismatches, 0);
+    lv_port_dma_set_min_pixels(LV_PORT_DMA_MIN_PIXELS);
+}
+
+static void test_blends_match_lvgl(void) {
+    srand(9);
+    lv_port_dma_set_min_pixels(0);
+    uint32_t mismatches = 0;
+    for (int i = 0; i < 2000; i++) {
+        fill_buffers();
+        int32_t bw = 1 + random_in(BUF_W);
+        int32_t bh = 1 + random_in(BUF_H - 8);
+        lv_area_t buf_area = { 0, 0, bw - 1, bh - 1 };
+        lv_area_t clip = { random_in(4), random_in(4), bw - 1 - random_in(4), bh - 1 };
+        lv_area_t blend_area = { random_in(bw) - 2, random_in(bh) - 2, 0, 0 };
+        blend_area.x2 = blend_area.x1 + random_in(bw + 4);
+        blend_area.y2 = blend_area.y1 + random_in(bh + 4);
+        int32_t dest_offset = random_in(2);
+
+        lv_draw_sw_blend_dsc_t dsc;
+        memset(&dsc, 0, sizeof(dsc));
+        dsc.blend_area = &blend_area;
+        dsc.color.full = (uint16_t)rand();
+        dsc.opa = LV_OPA_COVER;
+        dsc.src_buf = random_in(2) ? source + random_in(2) : NULL;
+        dsc.mask_res = LV_DRAW_MASK_RES_FULL_COVER;
+        dsc.blend_mode = LV_BLEND_MODE_NORMAL;
+
+        lv_draw_sw_ctx_t ctx;
+        memset(&ctx, 0, sizeof(ctx));
+        ctx.base_draw.buf_area = &buf_area;
+        ctx.base_draw.clip_area = &clip;
+        ctx.base_draw.buf = expect + dest_offset;
+        lv_draw_sw_blend_basic(&ctx.base_draw, &dsc);
+        ctx.base_draw.buf = actual + dest_offset;
+        lv_port_blend(&ctx.base_draw, &dsc);
+        lv_port_dma_wait();
+        mismatches += memcmp(expect, actual, sizeof(actual)) != 0;
+    }
+    CHECK_EQ(mismatches, 0);
+    lv_port_dma_set_min_pixels(LV_PORT_DMA_MIN_PIXELS);
+}
+
+int main(void) {
+    lv_init();
+    lv_disp_t *disp = make_display();
+    _lv_refr_set_disp_refreshing(disp);
+    stub_dma_reset();
+
+    TEST_RUN(test_no_channels_falls_back);
+    TEST_RUN(test_threshold_and_row_limit);
+    TEST_RUN(test_matches_cpu);
+    TEST_RUN(test_blends_match_lvgl);
+    TEST_EXIT();
+}
@@ -0,0 +1,243 @@
+/**
+ * Host tests for the retained screens (lvgl/lv_port/lv_port_frame.c)
+ *
+ * A main menu like the firmware's is retained and edited at random (pressed
+ * buttons, new texts, moves, colours, hidden buttons), while shown and while
+ * another screen is. After every load from the copy and every refresh, the
+ * panel must hold exactly what rendering the active screen from scratch
+ * gives. The panel is an array: lv_port_push() and the flush callback write
+ * into it.
+ */
+
+#include "test_support.h"
+#include "lv_port.h"
+#include "lv_port_frame.h"
+#include "src/draw/sw/lv_draw_sw.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define LCD_W 240
+#define LCD_H 320
+
+static lv_color_t panel[LCD_W * LCD_H];
+static lv_color_t reference[LCD_W * LCD_H];
+static uint32_t pushes;
+static uint32_t flushes;
+
+static lv_disp_t *disp;
+static lv_obj_t *main_screen;
+static lv_obj_t *other_screen;
+static lv_obj_t *title;
+static lv_obj_t *buttons[3];
+static lv_obj_t *labels[3];
+static bool edit_on_load;
+
+static void to_panel(const lv_area_t *area, const lv_color_t *color_p) {
+    int32_t w = lv_area_get_width(area);
+    for (int32_t y = area->y1; y <= area->y2; y++) {
+        memcpy(&panel[y * LCD_W + area->x1], &color_p[(y - area->y1) * w], w * sizeof(lv_color_t));
+    }
+}
+
+void lv_port_push(const lv_area_t *area, const lv_color_t *color_p) {
+    to_panel(area, color_p);
+    pushes++;
+}
+
+static void flush(lv_disp_drv_t *disp_drv, const lv_area_t *area, lv_color_t *color_p) {
+    to_panel(area, color_p);
+    flushes++;
+    lv_disp_flush_ready(disp_drv);
+}
+
+static void make_display(void) {
+    static lv_disp_draw_buf_t draw_buf;
+    static lv_color_t buf[LCD_W * 80];
+    static lv_disp_drv_t disp_drv;
+    lv_disp_draw_buf_init(&draw_buf, buf, NULL, LCD_W * 80);
+    lv_disp_drv_init(&disp_drv);
+    disp_drv.hor_res = LCD_W;
+    disp_drv.ver_res = LCD_H;
+    disp_drv.flush_cb = flush;
+    disp_drv.draw_buf = &draw_buf;
+    disp_drv.invalidate_cb = lv_port_frame_invalidate_cb;
+    disp = lv_disp_drv_register(&disp_drv);
+}
+
+// A screen's load event handler changing it: that has to reach the panel too
+static void loaded_cb(lv_event_t *e) {
+    (void)e;
+    if (edit_on_load) {
+        edit_on_load = false;
+        lv_label_set_text(title, "Edited on load");
+    }
+}
+
+// Title and three rounded buttons, as main_screen.c builds them
+static void make_screens(void) {
+    static const uint32_t colors[3] = { 0x4CAF50, 0x2196F3, 0xFF9800 };
+    static const char *texts[3] = { "Stepper Control", "Time Settings", "History" };
+    main_screen = lv_obj_create(NULL);
+    lv_obj_set_style_bg_color(main_screen, lv_color_hex(0x1E1E1E), 0);
+    title = lv_label_create(main_screen);
+    lv_label_set_text(title, "PicoFlora");
+    lv_obj_set_style_text_color(title, lv_color_white(), 0);
+    lv_obj_set_style_text_font(title, &lv_font_montserrat_16, 0);
+    lv_obj_align(title, LV_ALIGN_TOP_MID, 0, 20);
+    for (int i = 0; i < 3; i++) {
+        buttons[i] = lv_btn_create(main_screen);
+        lv_obj_set_size(buttons[i], 200, 60);
+        lv_obj_align(buttons[i], LV_ALIGN_CENTER, 0, -70 + 70 * i);
+        lv_obj_set_style_bg_color(buttons[i], lv_color_hex(colors[i]), 0);
+        lv_obj_set_style_bg_color(buttons[i], lv_color_hex(0x1976D2), LV_STATE_PRESSED);
+        lv_obj_set_style_radius(buttons[i], 8, 0);
+        labels[i] = lv_label_create(buttons[i]);
+        lv_label_set_text(labels[i], texts[i]);
+        lv_obj_set_style_text_font(labels[i], &lv_font_montserrat_16, 0);
+        lv_obj_center(labels[i]);
+    }
+    lv_obj_add_event_cb(main_screen, loaded_cb, LV_EVENT_SCREEN_LOADED, NULL);
+
+    other_screen = lv_obj_create(NULL);
+    lv_obj_t *label = lv_label_create(other_screen);
+    lv_label_set_text(label, "Other screen");
+    lv_obj_center(label);
+}
+
+static void edit_main_screen(void) {
+    char text[32];
+    lv_obj_t *button = buttons[rand() % 3];
+    switch (rand() % 6) {
+    case 0:
+        if (lv_obj_has_state(button, LV_STATE_PRESSED)) {
+            lv_obj_clear_state(button, LV_STATE_PRESSED);
+        } else {
+            lv_obj_add_state(button, LV_STATE_PRESSED);
+        }
+        break;
+    case 1:
+        snprintf(text, sizeof(text), "Text %d", rand() % 100000);
+        lv_label_set_text(labels[rand() % 3], text);
+        break;
+    case 2:
+        snprintf(text, sizeof(text), "Title %d", rand() % 1000);
+        lv_label_set_text(title, text);
+        break;
+    case 3:
+        lv_obj_align(button, LV_ALIGN_CENTER, rand() % 40 - 20, -70 + 70 * (rand() % 3));
+        break;
+    case 4:
+        lv_obj_set_style_bg_color(button, lv_color_hex((uint32_t)rand() & 0xFFFFFF), 0);
+        break;
+    default:
+        if (rand() % 2) {
+            lv_obj_add_flag(button, LV_OBJ_FLAG_HIDDEN);
+        } else {
+            lv_obj_clear_flag(button, LV_OBJ_FLAG_HIDDEN);
+        }
+        break;
+    }
+}
+
+// Refresh, then compare the panel with the active screen rendered from scratch
+static bool panel_is_current(void) {
+    lv_refr_now(disp);
+    lv_area_t full = { 0, 0, LCD_W - 1, LCD_H - 1 };
+    lv_draw_sw_ctx_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    lv_draw_sw_init_ctx(disp->driver, &ctx.base_draw);
+    ctx.base_draw.buf = reference;
+    ctx.base_draw.buf_area = &full;
+    ctx.base_draw.clip_area = &full;
+    _lv_refr_set_disp_refreshing(disp);
+    lv_obj_redraw(&ctx.base_draw, lv_scr_act());
+    _lv_refr_set_disp_refreshing(NULL);
+    return memcmp(panel, reference, sizeof(panel)) == 0;
+}
+
+static void test_loads_show_the_current_screen(void) {
+    CHECK(lv_port_frame_retain(main_screen));
+    CHECK(lv_port_frame_retain(main_screen));           // Already retained
+    CHECK(!lv_port_frame_retain(other_screen));         // Every slot taken
+    CHECK(!lv_port_frame_load(other_screen));
+
+    lv_scr_load(other_screen);
+    CHECK(panel_is_current());
+
+    srand(99);
+    uint32_t loads = 0;
+    uint32_t mismatches = 0;
+    for (int step = 0; step < 2000; step++) {
+        int edits = rand() % 4;
+        for (int k = 0; k < edits; k++) {
+            edit_main_screen();
+        }
+        if (lv_scr_act() == other_screen) {
+            edit_on_load = rand() % 10 == 0;
+            pushes = 0;
+            CHECK(lv_port_frame_load(main_screen));
+            CHECK_EQ(pushes, 1);
+            loads++;
+        } else if (rand() % 2) {
+            lv_scr_load(other_screen);
+        }
+        mismatches += !panel_is_current();
+    }
+    printf("  %lu loads from the copy, %lu mismatches\n", (unsigned long)loads, (unsigned long)mismatches);
+    CHECK(loads > 500);
+    CHECK_EQ(mismatches, 0);
+}
+
+static void test_unchanged_screen_is_not_redrawn(void) {
+    // Back and forth with no edits: the whole frame comes from the copy, LVGL flushes nothing
+    lv_scr_load(other_screen);
+    CHECK(panel_is_current());
+    flushes = 0;
+    CHECK(lv_port_frame_load(main_screen));
+    CHECK(panel_is_current());
+    CHECK_EQ(flushes, 0);
+
+    // Already shown: nothing to do
+    CHECK(!lv_port_frame_load(main_screen));
+}
+
+static void test_refused_while_layers_or_animations_are_in_use(void) {
+    lv_scr_load(other_screen);
+    lv_refr_now(disp);
+
+    // Something on the top layer is not in the copy
+    lv_obj_t *popup = lv_label_create(lv_layer_top());
+    lv_label_set_text(popup, "Alarm");
+    CHECK(!lv_port_frame_load(main_screen));
+    lv_obj_del(popup);
+
+    // A screen load animation is running
+    lv_obj_t *third = lv_obj_create(NULL);
+    lv_scr_load_anim(third, LV_SCR_LOAD_ANIM_FADE_ON, 300, 0, false);
+    CHECK(!lv_port_frame_load(main_screen));
+    lv_tick_inc(1000);
+    lv_timer_handler();
+    CHECK(lv_scr_act() == third);
+
+    CHECK(lv_port_frame_load(main_screen));
+    CHECK(panel_is_current());
+    lv_obj_del(third);
+}
+
+static void test_deleted_screen_frees_its_slot(void) {
+    lv_scr_load(other_screen);
+    lv_obj_del(main_screen);
+    CHECK(lv_port_frame_retain(other_screen));
+}
+
+int main(void) {
+    lv_init();
+    make_display();
+    make_screens();
+
+    TEST_RUN(test_loads_show_the_current_screen);
+    TEST_RUN(test_unchanged_screen_is_not_redrawn);
+    TEST_RUN(test_refused_while_layers_or_animations_are_in_use);
+    TEST_RUN(test_deleted_screen_frees_its_slot);
+    TEST_EXIT();
+}
@@ -0,0 +1,220 @@
+/**
+ * Host tests for the glyph cache (lvgl/lv_port/lv_port_glyph.c)
+ *
+ * Random labels (ASCII, accented letters, symbols, a glyph no font has,
+ * more fonts than the direct-mapped tables, a font with a fallback) are
+ * drawn with LVGL's letter renderer and with the cache, opaque and
+ * translucent, with and without a rounded clip mask; the pixels must be
+ * identical. Bitmap requests to a counting font show what the cache saves.
+ * The DMA backend is faked out: every fill and copy stays on the CPU.
+ */
+
+#include "test_support.h"
+#include "lv_port_blend.h"
+#include "lv_port_dma.h"
+#include "lv_port_glyph.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define BUF_W 240
+#define BUF_H 80
+
+static lv_color_t expect[BUF_W * BUF_H];
+static lv_color_t actual[BUF_W * BUF_H];
+
+static const char *pieces[] = {
+    "a", "W", "@", "0", "9", ":", " ", "\n", "g", "j", "%", "Q", "\xc3\xa9", "\xc3\xbc",
+    LV_SYMBOL_OK, LV_SYMBOL_WIFI, LV_SYMBOL_SETTINGS, "\xe4\xb8\xad",
+};
+
+bool lv_port_dma_fill(lv_color_t *dest, lv_coord_t dest_stride, int32_t w, int32_t h, lv_color_t color) {
+    (void)dest;
+    (void)dest_stride;
+    (void)w;
+    (void)h;
+    (void)color;
+    return false;
+}
+
+bool lv_port_dma_copy(lv_color_t *dest, lv_coord_t dest_stride, const lv_color_t *src, lv_coord_t src_stride,
+                      int32_t w, int32_t h) {
+    (void)dest;
+    (void)dest_stride;
+    (void)src;
+    (void)src_stride;
+    (void)w;
+    (void)h;
+    return false;
+}
+
+void lv_port_dma_wait(void) {
+}
+
+// Montserrat 14 with its bitmap requests counted
+static lv_font_t counting_font;
+static uint32_t bitmap_requests;
+
+static const uint8_t *counting_bitmap(const lv_font_t *font, uint32_t letter) {
+    (void)font;
+    bitmap_requests++;
+    return lv_font_montserrat_14.get_glyph_bitmap(&lv_font_montserrat_14, letter);
+}
+
+static void flush(lv_disp_drv_t *disp_drv, const lv_area_t *area, lv_color_t *color_p) {
+    (void)area;
+    (void)color_p;
+    lv_disp_flush_ready(disp_drv);
+}
+
+static lv_disp_t *make_display(void) {
+    static lv_disp_draw_buf_t draw_buf;
+    static lv_color_t buf[240 * 10];
+    static lv_disp_drv_t disp_drv;
+    lv_disp_draw_buf_init(&draw_buf, buf, NULL, 240 * 10);
+    lv_disp_drv_init(&disp_drv);
+    disp_drv.hor_res = 240;
+    disp_drv.ver_res = 320;
+    disp_drv.flush_cb = flush;
+    disp_drv.draw_buf = &draw_buf;
+    disp_drv.draw_ctx_init = lv_port_blend_init_ctx;
+    return lv_disp_drv_register(&disp_drv);
+}
+
+static int32_t random_in(int32_t n) {
+    return (int32_t)((((uint32_t)rand() << 16) ^ (uint32_t)rand()) % (uint32_t)n);
+}
+
+// The label through LVGL's renderer into 'expect' and through the cache into 'actual'; true if they match
+static bool draw_both(const lv_draw_label_dsc_t *dsc, const lv_area_t *coords, const lv_area_t *clip,
+                      const char *text) {
+    for (int32_t i = 0; i < BUF_W * BUF_H; i++) {
+        expect[i].full = (uint16_t)(i * 0x9E37u);
+    }
+    memcpy(actual, expect, sizeof(actual));
+
+    lv_area_t buf_area = { 0, 0, BUF_W - 1, BUF_H - 1 };
+    lv_draw_sw_ctx_t ctx;
+    lv_port_blend_init_ctx(lv_disp_get_default()->driver, &ctx.base_draw);
+    ctx.base_draw.buf_area = &buf_area;
+    ctx.base_draw.clip_area = clip;
+    ctx.base_draw.buf = expect;
+    ctx.base_draw.draw_letter = lv_draw_sw_letter;
+    lv_draw_label(&ctx.base_draw, dsc, coords, text, NULL);
+    ctx.base_draw.buf = actual;
+    ctx.base_draw.draw_letter = lv_port_glyph_draw_letter;
+    lv_draw_label(&ctx.base_draw, dsc, coords, text, NULL);
+    return memcmp(expect, actual, sizeof(actual)) == 0;
+}
+
+static void test_matches_lvgl_letters(void) {
+    // Six fonts: two past the direct-mapped tables, the last one falling back to another
+    static lv_font_t copy_12, copy_16, with_fallback;
+    copy_12 = lv_font_montserrat_12;
+    copy_16 = lv_font_montserrat_16;
+    with_fallback = lv_font_montserrat_14;
+    with_fallback.fallback = &copy_16;
+    const lv_font_t *fonts[] = { &lv_font_montserrat_12, &lv_font_montserrat_14, &lv_font_montserrat_16,
+                                 &copy_12, &copy_16, &with_fallback };
+
+    srand(99);
+    uint32_t mismatches = 0;
+    uint32_t labels = 3000;
+    for (uint32_t i = 0; i < labels; i++) {
+        char text[256] = "";
+        int32_t count = 1 + random_in(20);
+        for (int32_t p = 0; p < count; p++) {
+            strcat(text, pieces[random_in(sizeof(pieces) / sizeof(pieces[0]))]);
+        }
+
+        lv_draw_label_dsc_t dsc;
+        lv_draw_label_dsc_init(&dsc);
+        dsc.font = fonts[random_in(sizeof(fonts) / sizeof(fonts[0]))];
+        dsc.color.full = (uint16_t)rand();
+        dsc.opa = random_in(3) ? LV_OPA_COVER : (lv_opa_t)random_in(256);
+        lv_area_t coords = { random_in(BUF_W) - 20, random_in(BUF_H) - 10, 0, 0 };
+        coords.x2 = coords.x1 + random_in(260);
+        coords.y2 = coords.y1 + random_in(90);
+        lv_area_t clip = { random_in(20), random_in(20), BUF_W - 1 - random_in(20), BUF_H - 1 - random_in(20) };
+
+        // A rounded clip corner sends letters through LVGL's renderer with the stand-in font
+        bool rounded = random_in(4) == 0;
+        lv_draw_mask_radius_param_t radius;
+        int16_t mask_id = -1;
+        if (rounded) {
+            lv_area_t rect = { 10, 5, 200, 70 };
+            lv_draw_mask_radius_init(&radius, &rect, 20, false);
+            mask_id = lv_draw_mask_add(&radius, NULL);
+        }
+        mismatches += !draw_both(&dsc, &coords, &clip, text);
+        if (rounded) {
+            lv_draw_mask_remove_id(mask_id);
+            lv_draw_mask_free_param(&radius);
+        }
+    }
+    printf("  %lu labels, %lu mismatches\n", (unsigned long)labels, (unsigned long)mismatches);
+    CHECK_EQ(mismatches, 0);
+}
+
+static void test_repeated_text_is_cached(void) {
+    counting_font = lv_font_montserrat_14;
+    counting_font.get_glyph_bitmap = counting_bitmap;
+    lv_port_glyph_flush();
+
+    lv_draw_label_dsc_t dsc;
+    lv_draw_label_dsc_init(&dsc);
+    dsc.font = &counting_font;
+    dsc.color = lv_color_hex(0x202020);
+    lv_area_t coords = { 4, 4, BUF_W - 1, BUF_H - 1 };
+    lv_area_t clip = { 0, 0, BUF_W - 1, BUF_H - 1 };
+    const char *text = "1234 steps 12:34";
+
+    // LVGL's renderer fetches its 14 visible letters on every draw; the cache its 9 distinct glyphs, once
+    bitmap_requests = 0;
+    CHECK(draw_both(&dsc, &coords, &clip, text));
+    uint32_t first = bitmap_requests;
+    bitmap_requests = 0;
+    CHECK(draw_both(&dsc, &coords, &clip, text));
+    uint32_t again = bitmap_requests;
+    printf("  bitmap requests of both renderers: %lu on the first draw, %lu on the next\n",
+           (unsigned long)first, (unsigned long)again);
+    CHECK_EQ(first, 14 + 9);
+    CHECK_EQ(again, 14);
+
+    // Flushing forgets them
+    lv_port_glyph_flush();
+    bitmap_requests = 0;
+    CHECK(draw_both(&dsc, &coords, &clip, text));
+    CHECK_EQ(bitmap_requests, first);
+}
+
+static void test_eviction_keeps_output_exact(void) {
+    // Every printable ASCII glyph of three fonts: more than the slots, so glyphs keep being replaced
+    char text[96];
+    for (int c = 0; c < 95; c++) {
+        text[c] = (char)(0x20 + c);
+    }
+    text[95] = '\0';
+    const lv_font_t *fonts[] = { &lv_font_montserrat_12, &lv_font_montserrat_14, &lv_font_montserrat_16 };
+    lv_area_t clip = { 0, 0, BUF_W - 1, BUF_H - 1 };
+    uint32_t mismatches = 0;
+    for (int round = 0; round < 6; round++) {
+        lv_draw_label_dsc_t dsc;
+        lv_draw_label_dsc_init(&dsc);
+        dsc.font = fonts[round % 3];
+        dsc.color = lv_color_hex(0x0000FF);
+        lv_area_t coords = { -(round * 37), 0, BUF_W - 1, BUF_H - 1 };
+        mismatches += !draw_both(&dsc, &coords, &clip, text);
+    }
+    CHECK_EQ(mismatches, 0);
+}
+
+int main(void) {
+    lv_init();
+    lv_disp_t *disp = make_display();
+    _lv_refr_set_disp_refreshing(disp);
+
+    TEST_RUN(test_matches_lvgl_letters);
+    TEST_RUN(test_repeated_text_is_cached);
+    TEST_RUN(test_eviction_keeps_output_exact);
+    TEST_EXIT();
+}
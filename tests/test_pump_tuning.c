@@ -0,0 +1,392 @@
+/**
+ * Host tests for stall detection, stall retries and speed tuning
+ * (drivers/pump_tuning/pump_tuning.c)
+ *
+ * Runs dosing and the move planner on the stepper driver model. The TMC2209
+ * is replaced by its StallGuard reading, which the tests drop to a stall
+ * value at chosen positions or speeds. Noisy traces (reading noise, drift as
+ * the tubing warms, load steps, lone bad readings) check the detector for
+ * false stalls and for how fast it sees real ones.
+ */
+
+#include "test_support.h"
+#include "pump_tuning.h"
+#include "tmc2209.h"
+#include "dosing.h"
+#include "stepper_planner.h"
+#include "stepper_driver_sim.h"
+#include "settings_store.h"
+#include "storage_flash.h"
+#include "logging.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SG_NORMAL 300
+#define SG_STALLED 5
+#define PASS_STEPS 16               // About 2 ms of pumping at full speed per main-loop pass
+#define TRACES 400
+#define TRACE_SAMPLES 3000          // A minute at cruise each
+#define ONSET_SAMPLES 25            // Slow stalls take half a second to collapse
+#define ONSET_LAG_SAMPLES 10        // The baseline follows a slow collapse for a while
+
+static uint16_t sg_now = SG_NORMAL;
+static int32_t stall_from;          // Sequence position the load jams at, 0 = never
+static uint32_t stall_above_hz;     // Speeds above this stall, 0 = none
+static bool sg_noisy;               // Unjammed readings follow noisy_reading()
+static uint64_t jammed_us;          // When the pump first stepped into the jam
+
+static uint8_t started_zones[16];
+static uint32_t started_hz[16];
+static uint32_t starts;
+static uint32_t tuning_active;
+static bool tuning_zone_fails;      // The hook cannot open the tuning zone
+
+// StallGuard reading of the TMC2209, following the simulated load
+bool tmc2209_is_present(void) {
+    return true;
+}
+
+bool tmc2209_set_stealthchop(bool enable) {
+    (void)enable;
+    return true;
+}
+
+bool tmc2209_set_stallguard(uint8_t sgthrs, uint32_t tcoolthrs) {
+    (void)sgthrs;
+    (void)tcoolthrs;
+    return true;
+}
+
+bool tmc2209_get_sg_result(uint16_t *sg_result) {
+    *sg_result = sg_now;
+    return true;
+}
+
+static double uniform(double low, double high) {
+    return low + (high - low) * rand() / RAND_MAX;
+}
+
+// A cruising pump along a dose: load steps every 15000 steps, 25% drift over 200000, 12% reading noise
+static uint16_t noisy_reading(int32_t position) {
+    static const double loads[] = { 1.0, 0.72, 1.25, 0.9 };
+    double drift = 1.0 - 0.25 * (position < 200000 ? position : 200000) / 200000.0;
+    return (uint16_t)(SG_NORMAL * drift * loads[(position / 15000) % 4] * uniform(0.88, 1.12));
+}
+
+static void on_step(int32_t position, uint32_t freq_hz) {
+    bool jammed = stall_from > 0 && position >= stall_from;
+    bool too_fast = stall_above_hz > 0 && freq_hz > stall_above_hz;
+    if (jammed && jammed_us == 0) {
+        jammed_us = stub_time_us;
+    }
+    if (jammed || too_fast) {
+        sg_now = sg_noisy ? (uint16_t)(noisy_reading(position) * uniform(0.05, 0.3)) : SG_STALLED;
+    } else {
+        sg_now = sg_noisy ? noisy_reading(position) : SG_NORMAL;
+    }
+}
+
+static bool on_dose_start(const dosing_request_t *dose) {
+    if (dose && starts < sizeof(started_zones)) {
+        started_zones[starts] = dose->zone;
+        started_hz[starts] = dose->speed_hz;
+        starts++;
+    }
+    return true;
+}
+
+static bool on_tuning(bool active) {
+    if (active && tuning_zone_fails) {
+        return false;
+    }
+    tuning_active += active;
+    return true;
+}
+
+static void reset(void) {
+    storage_flash_init();
+    stub_time_us = 0;
+    settings_init();
+    stub_stepper_reset();
+    stub_stepper_on_step = on_step;
+    dosing_init();
+    dosing_set_start_callback(on_dose_start);
+    pump_tuning_init();
+    pump_tuning_set_callback(on_tuning);
+
+    sg_now = SG_NORMAL;
+    stall_from = 0;
+    stall_above_hz = 0;
+    sg_noisy = false;
+    jammed_us = 0;
+    starts = 0;
+    tuning_active = 0;
+    tuning_zone_fails = false;
+}
+
+static void loop_pass(void) {
+    stub_stepper_run(PASS_STEPS);
+    stepper_planner_process();
+    dosing_process();
+    pump_tuning_process();
+}
+
+static void test_detector_learns_each_speed(void) {
+    stall_detector_t detector;
+    stall_detector_reset(&detector, 0);
+
+    // Settling and learning never report, whatever the value
+    for (int i = 0; i < PUMP_TUNING_SETTLE_SAMPLES + PUMP_TUNING_LEARN_SAMPLES; i++) {
+        CHECK_EQ(stall_detector_sample(&detector, i < PUMP_TUNING_SETTLE_SAMPLES ? 20 : 200, 5000), STALL_NONE);
+    }
+    CHECK_EQ(detector.baseline_q4 >> 4, 200);
+
+    // Half the baseline is still load, a drop below 40% is a stall once confirmed
+    CHECK_EQ(stall_detector_sample(&detector, 100, 5000), STALL_NONE);
+    CHECK_EQ(stall_detector_sample(&detector, 70, 5000), STALL_SUSPECT);
+    CHECK_EQ(stall_detector_sample(&detector, 200, 5000), STALL_NONE);
+    CHECK_EQ(stall_detector_sample(&detector, 70, 5000), STALL_SUSPECT);
+    CHECK_EQ(stall_detector_sample(&detector, 60, 5000), STALL_DETECTED);
+
+    // Faster, and the new baseline collapsed against the previous speed's: stalling on arrival
+    stall_detector_reset(&detector, 0);
+    for (int i = 0; i < PUMP_TUNING_SETTLE_SAMPLES + PUMP_TUNING_LEARN_SAMPLES + 1; i++) {
+        stall_detector_sample(&detector, 200, 5000);
+    }
+    stall_verdict_t verdict = STALL_NONE;
+    for (int i = 0; i < PUMP_TUNING_SETTLE_SAMPLES + PUMP_TUNING_LEARN_SAMPLES; i++) {
+        verdict = stall_detector_sample(&detector, 50, 6000);
+    }
+    CHECK_EQ(verdict, STALL_DETECTED);
+}
+
+// A minute of noisy readings at cruise; a stall (if any) collapses them from 'stall_at', over 'onset' samples
+typedef struct {
+    double level;               // Reading without load changes, drifting
+    double drift;               // Per sample
+    double load;                // Changed in steps of up to 30% now and then
+    uint32_t next_change;
+    bool dipped;
+} sg_trace_t;
+
+static uint16_t trace_sample(sg_trace_t *trace, uint32_t i, uint32_t stall_at, uint32_t onset) {
+    if (i == trace->next_change) {
+        trace->load *= uniform(0.7, 1.3);
+        trace->load = trace->load < 0.6 ? 0.6 : trace->load > 1.5 ? 1.5 : trace->load;
+        trace->next_change = i + 100 + rand() % 400;
+    }
+    trace->level *= 1.0 + trace->drift;
+    double value = trace->level * trace->load * uniform(0.88, 1.12);
+
+    // One bad reading now and then, never two in a row
+    bool dip = !trace->dipped && rand() % 100 == 0;
+    trace->dipped = dip;
+    if (dip) {
+        value *= uniform(0.2, 0.4);
+    }
+    if (i >= stall_at) {
+        double collapse = uniform(0.05, 0.3);
+        if (i - stall_at < onset) {
+            double share = (double)(i - stall_at + 1) / onset;
+            collapse = 1.0 - share * (1.0 - collapse);
+        }
+        value *= collapse;
+    }
+    return (uint16_t)value;
+}
+
+static void test_noisy_traces(void) {
+    srand(36);
+    uint32_t false_stalls = 0;
+    uint32_t missed = 0;
+    uint32_t abrupt = 0;
+    uint32_t slow = 0;
+    uint32_t abrupt_max = 0;
+    uint32_t slow_max = 0;
+    double slow_sum = 0;
+    for (uint32_t t = 0; t < TRACES; t++) {
+        // A quarter run clean, a quarter stall slowly, the rest at once
+        uint32_t kind = t % 4;
+        uint32_t stall_at = kind == 0 ? UINT32_MAX : 500 + (uint32_t)rand() % 2000;
+        uint32_t onset = kind == 1 ? ONSET_SAMPLES : 1;
+        sg_trace_t trace = {
+            .level = uniform(120, 450),
+            .drift = pow(uniform(0.7, 1.3), 1.0 / TRACE_SAMPLES) - 1.0,
+            .load = 1.0,
+            .next_change = 200 + rand() % 300,
+        };
+
+        stall_detector_t detector;
+        stall_detector_reset(&detector, 0);
+        uint32_t detected_at = UINT32_MAX;
+        for (uint32_t i = 0; i < TRACE_SAMPLES && detected_at == UINT32_MAX; i++) {
+            if (stall_detector_sample(&detector, trace_sample(&trace, i, stall_at, onset), 5000) == STALL_DETECTED) {
+                detected_at = i;
+            }
+        }
+
+        if (detected_at == UINT32_MAX) {
+            missed += kind != 0;
+            continue;
+        }
+        if (detected_at < stall_at) {
+            false_stalls++;
+            continue;
+        }
+        uint32_t latency = detected_at - stall_at + 1;  // Samples from the first stalling one
+        if (kind == 1) {
+            slow++;
+            slow_sum += latency;
+            slow_max = latency > slow_max ? latency : slow_max;
+        } else {
+            abrupt++;
+            abrupt_max = latency > abrupt_max ? latency : abrupt_max;
+        }
+    }
+
+    printf("  %u traces: %lu false stalls, %lu missed; sudden stalls seen after at most %lu ms,"
+           " %u ms slow ones after %.0f ms (at most %lu ms)\n",
+           TRACES, (unsigned long)false_stalls, (unsigned long)missed,
+           (unsigned long)(abrupt_max * PUMP_TUNING_SAMPLE_MS), ONSET_SAMPLES * PUMP_TUNING_SAMPLE_MS,
+           slow_sum / slow * PUMP_TUNING_SAMPLE_MS, (unsigned long)(slow_max * PUMP_TUNING_SAMPLE_MS));
+    CHECK_EQ(false_stalls, 0);
+    CHECK_EQ(missed, 0);
+    CHECK_EQ(abrupt, TRACES / 2);
+    CHECK_EQ(slow, TRACES / 4);
+    CHECK_EQ(abrupt_max, PUMP_TUNING_CONFIRM_SAMPLES);
+    CHECK(slow_max <= ONSET_SAMPLES + ONSET_LAG_SAMPLES);
+}
+
+static void test_noisy_doses(void) {
+    // Load steps and drift along three doses are no stall
+    reset();
+    sg_noisy = true;
+    srand(360);
+    for (uint8_t zone = 0; zone < 3; zone++) {
+        CHECK(dosing_queue(0, zone, 20000, 0));
+    }
+    for (int pass = 0; pass < 1000000 && (dosing_is_busy() || stepper_planner_is_running()); pass++) {
+        loop_pass();
+    }
+    pump_tuning_stats_t stats;
+    pump_tuning_get_stats(&stats);
+    dosing_stats_t dosing_stats;
+    dosing_get_stats(&dosing_stats);
+    CHECK_EQ(stats.stalls, 0);
+    CHECK_EQ(dosing_stats.completed, 3);
+    CHECK(stats.samples > 500);
+    uint32_t clean_samples = stats.samples;
+
+    // A jam on the same noisy pump: seen within the confirming samples, a poll and a loop pass
+    reset();
+    sg_noisy = true;
+    CHECK(dosing_queue(0, 1, 20000, 0));
+    stall_from = 16000;
+    uint64_t detected_us = 0;
+    int32_t detected_at = 0;
+    for (int pass = 0; pass < 1000000 && (dosing_is_busy() || stepper_planner_is_running()); pass++) {
+        loop_pass();
+        pump_tuning_get_stats(&stats);
+        if (stats.stalls > 0 && detected_us == 0) {
+            detected_us = stub_time_us;
+            detected_at = stepper_driver_get_current_steps();
+            stall_from = 0;
+        }
+    }
+    uint64_t latency_us = detected_us - jammed_us;
+    printf("  %lu noisy samples over three doses without a stall; a jam seen after %.1f ms, %ld steps in\n",
+           (unsigned long)clean_samples, latency_us / 1000.0, (long)(detected_at - 16000));
+    CHECK_EQ(stats.stalls, 1);
+    CHECK(jammed_us > 0 && detected_us > jammed_us);
+    CHECK(latency_us <= (PUMP_TUNING_CONFIRM_SAMPLES + 1) * PUMP_TUNING_SAMPLE_MS * 1000ull + 2000);
+}
+
+static void test_stall_retries_the_dose_slower(void) {
+    reset();
+    settings_set_u32(SETTINGS_KEY_STEPPER_MAX_HZ, STEPPER_MAX_FREQ_HZ);
+    CHECK(dosing_queue(0, 1, 20000, 0));
+    CHECK(dosing_queue(0, 2, 10000, 0));
+
+    // Jams half way through the first dose, at cruise
+    stall_from = 16000;
+    for (int pass = 0; pass < 100000 && (dosing_is_busy() || stepper_planner_is_running()); pass++) {
+        loop_pass();
+        pump_tuning_stats_t stats;
+        pump_tuning_get_stats(&stats);
+        if (stats.stalls > 0) {
+            stall_from = 0;     // Cleared once the pump stopped
+        }
+    }
+
+    pump_tuning_stats_t stats;
+    pump_tuning_get_stats(&stats);
+    CHECK_EQ(stats.stalls, 1);
+    CHECK_EQ(stats.retries, 1);
+    CHECK_EQ(stats.last_stall_hz, STEPPER_MAX_FREQ_HZ);
+
+    // Zone 1 again for the rest, slower; zone 2 at its own speed
+    uint32_t retry_hz = STEPPER_MAX_FREQ_HZ * PUMP_TUNING_BACKOFF_PERCENT / 100;
+    CHECK_EQ(starts, 3);
+    CHECK_EQ(started_zones[0], 1);
+    CHECK_EQ(started_hz[0], STEPPER_MAX_FREQ_HZ);
+    CHECK_EQ(started_zones[1], 1);
+    CHECK_EQ(started_hz[1], retry_hz);
+    CHECK_EQ(started_zones[2], 2);
+    CHECK_EQ(started_hz[2], STEPPER_MAX_FREQ_HZ);
+
+    dosing_stats_t dosing_stats;
+    dosing_get_stats(&dosing_stats);
+    CHECK_EQ(dosing_stats.completed, 2);
+    CHECK_EQ(dosing_stats.retried, 1);
+    printf("  %llu of 30000 uL dispensed, retried at %lu Hz\n",
+           (unsigned long long)dosing_stats.dispensed_ul, (unsigned long)retry_hz);
+    CHECK(dosing_stats.dispensed_ul > 29500 && dosing_stats.dispensed_ul <= 30000);
+
+    // The limit belongs to tuning: neither the driver nor the stored setting changed
+    CHECK_EQ(stepper_driver_get_max_frequency(), STEPPER_MAX_FREQ_HZ);
+    CHECK_EQ(settings_get_u32(SETTINGS_KEY_STEPPER_MAX_HZ, 0), STEPPER_MAX_FREQ_HZ);
+}
+
+static void test_tuning_stores_the_limit(void) {
+    reset();
+    stall_above_hz = 6500;
+
+    // No open zone, no tuning
+    tuning_zone_fails = true;
+    CHECK(!pump_tuning_start());
+    CHECK_EQ(pump_tuning_get_state(), PUMP_TUNING_IDLE);
+    CHECK(!stepper_driver_is_running());
+    CHECK_EQ(stepper_driver_get_max_frequency(), STEPPER_MAX_FREQ_HZ);
+    tuning_zone_fails = false;
+
+    CHECK(pump_tuning_start());
+    CHECK(!pump_tuning_start());
+    for (int pass = 0; pass < 1000000 && pump_tuning_get_state() == PUMP_TUNING_RUNNING; pass++) {
+        loop_pass();
+    }
+
+    // 4, 5 and 6 kHz ran clean, 7 kHz stalled
+    uint32_t tuned_hz = 6000 * PUMP_TUNING_MARGIN_PERCENT / 100;
+    CHECK_EQ(pump_tuning_get_state(), PUMP_TUNING_DONE);
+    CHECK_EQ(tuning_active, 1);
+    CHECK_EQ(stepper_driver_get_max_frequency(), tuned_hz);
+    CHECK_EQ(settings_get_u32(SETTINGS_KEY_STEPPER_MAX_HZ, 0), tuned_hz);
+
+    pump_tuning_stats_t stats;
+    pump_tuning_get_stats(&stats);
+    CHECK_EQ(stats.tuned_hz, tuned_hz);
+    CHECK_EQ(stats.stalls, 0);              // Tuning stalls are not operating stalls
+}
+
+int main(void) {
+    log_init();
+    log_set_level(LOG_LEVEL_NONE);
+
+    TEST_RUN(test_detector_learns_each_speed);
+    TEST_RUN(test_noisy_traces);
+    TEST_RUN(test_noisy_doses);
+    TEST_RUN(test_stall_retries_the_dose_slower);
+    TEST_RUN(test_tuning_stores_the_limit);
+    TEST_EXIT();
+}
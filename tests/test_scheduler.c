@@ -0,0 +1,218 @@
+/**
+ * Host tests for the watering scheduler (drivers/scheduler/scheduler.c)
+ *
+ * Fast-forwards a virtual clock from one due event to the next over a year
+ * of random rules and checks every event against its rule.
+ */
+
+#include "test_support.h"
+#include "scheduler.h"
+#include "logging.h"
+#include <string.h>
+
+#define START_TIME 1735689600u      // 2025-01-01 00:00:00, a Wednesday
+#define YEAR_S (365u * SCHEDULER_SECONDS_PER_DAY)
+#define RANDOM_RULES 220
+
+static uint32_t last_due;
+static uint32_t rule_last_due[SCHEDULER_MAX_RULES];
+static uint32_t events;
+static uint32_t bad_events;
+static uint32_t alarm_value;
+static uint32_t alarm_calls;
+
+static uint32_t rng_state = 0x12345678u;
+
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static uint32_t weekday_of(uint32_t t) {
+    return (t / SCHEDULER_SECONDS_PER_DAY + 4) % 7;     // 1970-01-01 was a Thursday
+}
+
+static void check_event(int rule_id, const schedule_rule_t *rule, uint32_t due) {
+    bool ok = due >= last_due;
+
+    if (rule->type == SCHEDULE_WEEKLY) {
+        ok = ok && (rule->weekday_mask & (1u << weekday_of(due))) != 0 &&
+             due % SCHEDULER_SECONDS_PER_DAY == rule->time_of_day_s;
+    } else {
+        ok = ok && due >= rule->anchor && (due - rule->anchor) % rule->interval_s == 0;
+        if (rule_last_due[rule_id] != 0) {
+            ok = ok && due - rule_last_due[rule_id] == rule->interval_s;
+        }
+    }
+    if (!ok) {
+        bad_events++;
+    }
+    last_due = due;
+    rule_last_due[rule_id] = due;
+    events++;
+}
+
+static void alarm_callback(uint32_t next_due) {
+    alarm_value = next_due;
+    alarm_calls++;
+}
+
+static void reset(void) {
+    scheduler_init();
+    scheduler_set_event_callback(check_event);
+    scheduler_set_alarm_callback(alarm_callback);
+    memset(rule_last_due, 0, sizeof(rule_last_due));
+    last_due = 0;
+    events = 0;
+    bad_events = 0;
+    alarm_value = SCHEDULER_NEVER;
+    alarm_calls = 0;
+}
+
+static void test_next_occurrence(void) {
+    schedule_rule_t weekly = {
+        .type = SCHEDULE_WEEKLY,
+        .weekday_mask = SCHEDULE_MONDAY,
+        .time_of_day_s = 7 * 3600,
+    };
+    // Wednesday -> next Monday 07:00
+    CHECK_EQ(scheduler_next_occurrence(&weekly, START_TIME), START_TIME + 5 * SCHEDULER_SECONDS_PER_DAY + 7 * 3600);
+    // Monday 07:00 itself is not "after" it
+    uint32_t monday = START_TIME + 5 * SCHEDULER_SECONDS_PER_DAY + 7 * 3600;
+    CHECK_EQ(scheduler_next_occurrence(&weekly, monday), monday + 7 * SCHEDULER_SECONDS_PER_DAY);
+
+    schedule_rule_t interval = {
+        .type = SCHEDULE_INTERVAL,
+        .interval_s = 3600,
+        .anchor = START_TIME + 1800,
+    };
+    CHECK_EQ(scheduler_next_occurrence(&interval, START_TIME), START_TIME + 1800);
+    CHECK_EQ(scheduler_next_occurrence(&interval, START_TIME + 1800), START_TIME + 5400);
+}
+
+static void test_invalid_rules_rejected(void) {
+    reset();
+    schedule_rule_t no_days = { .type = SCHEDULE_WEEKLY, .weekday_mask = 0, .time_of_day_s = 0, .volume_ml = 100 };
+    schedule_rule_t bad_time = { .type = SCHEDULE_WEEKLY, .weekday_mask = 1, .time_of_day_s = SCHEDULER_SECONDS_PER_DAY,
+                                 .volume_ml = 100 };
+    schedule_rule_t no_interval = { .type = SCHEDULE_INTERVAL, .interval_s = 0, .volume_ml = 100 };
+    CHECK_EQ(scheduler_add_rule(&no_days, START_TIME), -1);
+    CHECK_EQ(scheduler_add_rule(&bad_time, START_TIME), -1);
+    CHECK_EQ(scheduler_add_rule(&no_interval, START_TIME), -1);
+
+    // Every event of these would be dropped by dosing, or overflow its volume in uL
+    schedule_rule_t rule = { .type = SCHEDULE_INTERVAL, .interval_s = 3600, .zone = 3, .volume_ml = 0 };
+    CHECK_EQ(scheduler_add_rule(&rule, START_TIME), -1);
+    rule.volume_ml = SCHEDULER_MAX_VOLUME_ML + 1;
+    CHECK_EQ(scheduler_add_rule(&rule, START_TIME), -1);
+    rule.volume_ml = 4294968;
+    CHECK_EQ(scheduler_add_rule(&rule, START_TIME), -1);
+
+    // Zones beyond the mapped ones
+    scheduler_set_zone_count(3);
+    rule.volume_ml = SCHEDULER_MAX_VOLUME_ML;
+    CHECK_EQ(scheduler_add_rule(&rule, START_TIME), -1);
+    CHECK_EQ(scheduler_get_rule_count(), 0);
+    rule.zone = 2;
+    int id = scheduler_add_rule(&rule, START_TIME);
+    CHECK(id >= 0);
+    rule.zone = 3;
+    CHECK(!scheduler_update_rule(id, &rule, START_TIME));
+    CHECK_EQ(scheduler_get_rule(id)->zone, 2);
+}
+
+static void test_year_fast_forward(void) {
+    reset();
+
+    for (int i = 0; i < RANDOM_RULES; i++) {
+        schedule_rule_t rule;
+        memset(&rule, 0, sizeof(rule));
+        rule.zone = (uint8_t)(rng() % 8);
+        rule.volume_ml = 50 + rng() % 500;
+        if (rng() % 2) {
+            rule.type = SCHEDULE_WEEKLY;
+            rule.weekday_mask = (uint8_t)(1 + rng() % SCHEDULE_EVERY_DAY);
+            rule.time_of_day_s = rng() % SCHEDULER_SECONDS_PER_DAY;
+        } else {
+            rule.type = SCHEDULE_INTERVAL;
+            rule.interval_s = 600 + rng() % (3 * SCHEDULER_SECONDS_PER_DAY);
+            rule.anchor = START_TIME + rng() % SCHEDULER_SECONDS_PER_DAY;
+        }
+        CHECK(scheduler_add_rule(&rule, START_TIME) >= 0);
+    }
+    CHECK_EQ(scheduler_get_rule_count(), RANDOM_RULES);
+    CHECK_EQ(alarm_value, scheduler_next_due());
+
+    // Jump straight to each due time, as the RTC alarm would wake the system
+    uint32_t now = START_TIME;
+    while (scheduler_next_due() <= START_TIME + YEAR_S) {
+        uint32_t next = scheduler_next_due();
+        CHECK(next >= now);
+        now = next;
+        CHECK(scheduler_process(now) > 0);
+        CHECK(alarm_value > now);
+        CHECK_EQ(alarm_value, scheduler_next_due());
+    }
+
+    printf("  %lu events in a year, %lu alarm updates\n", (unsigned long)events, (unsigned long)alarm_calls);
+    CHECK(events > 50000);
+    CHECK_EQ(bad_events, 0);
+}
+
+static void test_missed_occurrences_fire_once(void) {
+    reset();
+    schedule_rule_t hourly = {
+        .type = SCHEDULE_INTERVAL,
+        .interval_s = 3600,
+        .anchor = START_TIME + 3600,
+        .volume_ml = 100,
+    };
+    int id = scheduler_add_rule(&hourly, START_TIME);
+    CHECK(id >= 0);
+
+    // Off for a day and a half: one catch-up event, then back on the grid
+    uint32_t now = START_TIME + 36 * 3600 + 100;
+    CHECK_EQ(scheduler_process(now), 1);
+    CHECK_EQ(scheduler_next_due(), START_TIME + 37 * 3600);
+    CHECK_EQ(scheduler_process(now), 0);
+}
+
+static void test_remove_and_update(void) {
+    reset();
+    schedule_rule_t a = { .type = SCHEDULE_INTERVAL, .interval_s = 100, .anchor = START_TIME + 100, .volume_ml = 100 };
+    schedule_rule_t b = { .type = SCHEDULE_INTERVAL, .interval_s = 100, .anchor = START_TIME + 50, .volume_ml = 100 };
+    int id_a = scheduler_add_rule(&a, START_TIME);
+    int id_b = scheduler_add_rule(&b, START_TIME);
+    CHECK_EQ(scheduler_next_due(), START_TIME + 50);
+    CHECK_EQ(alarm_value, START_TIME + 50);
+
+    CHECK(scheduler_remove_rule(id_b));
+    CHECK_EQ(scheduler_next_due(), START_TIME + 100);
+    CHECK_EQ(alarm_value, START_TIME + 100);
+
+    // Freed ids are handed out again, lowest first
+    CHECK_EQ(scheduler_add_rule(&b, START_TIME), id_b);
+
+    a.anchor = START_TIME + 10;
+    CHECK(scheduler_update_rule(id_a, &a, START_TIME));
+    CHECK_EQ(scheduler_next_due(), START_TIME + 10);
+
+    CHECK(scheduler_remove_rule(id_a));
+    CHECK(scheduler_remove_rule(id_b));
+    CHECK(!scheduler_remove_rule(id_b));
+    CHECK_EQ(alarm_value, SCHEDULER_NEVER);
+}
+
+int main(void) {
+    log_init();
+    log_set_level(LOG_LEVEL_WARN);
+
+    TEST_RUN(test_next_occurrence);
+    TEST_RUN(test_invalid_rules_rejected);
+    TEST_RUN(test_year_fast_forward);
+    TEST_RUN(test_missed_occurrences_fire_once);
+    TEST_RUN(test_remove_and_update);
+    TEST_EXIT();
+}
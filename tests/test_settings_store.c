@@ -0,0 +1,337 @@
+/**
+ * Host tests for the settings store (drivers/storage/settings_store.c)
+ *
+ * Runs on the RAM flash model; a "reboot" is another settings_init() on the
+ * same flash contents. A seeded random run of sets, deletes, commits, torn
+ * commits and reboots is checked against a reference map, and the boot scan
+ * time is reported as the store fills.
+ */
+
+#include "test_support.h"
+#include "settings_store.h"
+#include "storage_flash.h"
+#include "logging.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define FUZZ_KEYS 40
+#define FUZZ_STEPS 20000
+#define FUZZ_LOAD_LIMIT_US 20000              // Boot scan limit on the host, at any fill level
+#define REGION_SIZE (STORAGE_SETTINGS_SECTORS * STORAGE_SECTOR_SIZE)
+
+extern uint8_t stub_flash[];
+extern uint32_t stub_flash_erases;
+extern uint32_t stub_flash_programs;
+
+static void mount_fresh(void) {
+    storage_flash_init();
+    stub_time_us = 0;
+    CHECK(settings_init());
+}
+
+static void test_defaults_when_unset(void) {
+    mount_fresh();
+    CHECK_EQ(settings_get_u32(SETTINGS_KEY_LCD_BRIGHTNESS, 80), 80);
+
+    uint8_t buffer[8];
+    CHECK_EQ(settings_get("missing", buffer, sizeof(buffer)), -1);
+}
+
+static void test_boot_keys_survive_reboot(void) {
+    mount_fresh();
+
+    // The keys main.c reads back at boot
+    CHECK(settings_set_u32(SETTINGS_KEY_LOG_LEVEL, LOG_LEVEL_WARN));
+    CHECK(settings_set_u32(SETTINGS_KEY_LCD_BRIGHTNESS, 35));
+    CHECK(settings_set_u32(SETTINGS_KEY_STEPPER_MIN_HZ, 2500));
+    CHECK(settings_set_u32(SETTINGS_KEY_STEPPER_MAX_HZ, 36000));
+
+    // Staged values are visible before they reach flash
+    CHECK_EQ(settings_get_u32(SETTINGS_KEY_LCD_BRIGHTNESS, 80), 35);
+    CHECK_EQ(stub_flash_programs, 0);
+
+    CHECK(settings_init());
+    CHECK_EQ(settings_get_u32(SETTINGS_KEY_LCD_BRIGHTNESS, 80), 80);    // Never committed
+
+    CHECK(settings_set_u32(SETTINGS_KEY_LOG_LEVEL, LOG_LEVEL_WARN));
+    CHECK(settings_set_u32(SETTINGS_KEY_LCD_BRIGHTNESS, 35));
+    CHECK(settings_set_u32(SETTINGS_KEY_STEPPER_MIN_HZ, 2500));
+    CHECK(settings_set_u32(SETTINGS_KEY_STEPPER_MAX_HZ, 36000));
+    CHECK(settings_commit());
+
+    CHECK(settings_init());
+    CHECK_EQ(settings_get_u32(SETTINGS_KEY_LOG_LEVEL, LOG_LEVEL_INFO), LOG_LEVEL_WARN);
+    CHECK_EQ(settings_get_u32(SETTINGS_KEY_LCD_BRIGHTNESS, 80), 35);
+    CHECK_EQ(settings_get_u32(SETTINGS_KEY_STEPPER_MIN_HZ, 0), 2500);
+    CHECK_EQ(settings_get_u32(SETTINGS_KEY_STEPPER_MAX_HZ, 0), 36000);
+
+    settings_stats_t stats;
+    settings_get_stats(&stats);
+    CHECK_EQ(stats.keys, 4);
+    CHECK_EQ(stats.pages_used, 1);
+}
+
+static void test_batch_commits_after_settling(void) {
+    mount_fresh();
+    settings_set_u32(SETTINGS_KEY_LCD_BRIGHTNESS, 10);
+    settings_set_u32(SETTINGS_KEY_LCD_BRIGHTNESS, 20);
+    settings_set_u32(SETTINGS_KEY_LOG_LEVEL, LOG_LEVEL_DEBUG);
+
+    settings_process();
+    CHECK_EQ(stub_flash_programs, 0);
+
+    stub_time_us += SETTINGS_COMMIT_DELAY_MS * 1000ull;
+    settings_process();
+    CHECK_EQ(stub_flash_programs, 1);
+
+    // Setting a key to its stored value costs nothing
+    settings_set_u32(SETTINGS_KEY_LCD_BRIGHTNESS, 20);
+    stub_time_us += SETTINGS_COMMIT_DELAY_MS * 1000ull;
+    settings_process();
+    CHECK_EQ(stub_flash_programs, 1);
+
+    CHECK(settings_init());
+    CHECK_EQ(settings_get_u32(SETTINGS_KEY_LCD_BRIGHTNESS, 80), 20);
+}
+
+static void test_delete(void) {
+    mount_fresh();
+    settings_set_u32("tmp.key", 7);
+    settings_commit();
+    CHECK(settings_delete("tmp.key"));
+    settings_commit();
+
+    CHECK(settings_init());
+    CHECK_EQ(settings_get_u32("tmp.key", 99), 99);
+}
+
+static void test_torn_commit_keeps_previous_value(void) {
+    mount_fresh();
+    settings_set_u32(SETTINGS_KEY_LCD_BRIGHTNESS, 40);
+    settings_commit();
+    settings_set_u32(SETTINGS_KEY_LCD_BRIGHTNESS, 90);
+    settings_commit();
+
+    // Power lost while the second page was programmed
+    stub_flash[STORAGE_SETTINGS_OFFSET + STORAGE_PAGE_SIZE + 20] = 0;
+
+    CHECK(settings_init());
+    CHECK_EQ(settings_get_u32(SETTINGS_KEY_LCD_BRIGHTNESS, 80), 40);
+    settings_stats_t stats;
+    settings_get_stats(&stats);
+    CHECK_EQ(stats.torn_pages, 1);
+}
+
+static void test_compaction_keeps_live_keys(void) {
+    mount_fresh();
+    settings_set_u32(SETTINGS_KEY_STEPPER_MIN_HZ, 2000);
+    settings_set_u32("gone", 1);
+    settings_commit();
+    settings_delete("gone");
+    settings_commit();
+
+    // Enough single-key commits to go round every sector several times
+    uint32_t commits = 3 * STORAGE_SETTINGS_SECTORS * STORAGE_PAGES_PER_SECTOR;
+    for (uint32_t i = 0; i < commits; i++) {
+        CHECK(settings_set_u32(SETTINGS_KEY_LCD_BRIGHTNESS, i % 101));
+        CHECK(settings_commit());
+    }
+    CHECK(stub_flash_erases > 0);
+
+    CHECK(settings_init());
+    CHECK_EQ(settings_get_u32(SETTINGS_KEY_STEPPER_MIN_HZ, 0), 2000);
+    CHECK_EQ(settings_get_u32(SETTINGS_KEY_LCD_BRIGHTNESS, 0), (commits - 1) % 101);
+    CHECK_EQ(settings_get_u32("gone", 5), 5);
+
+    settings_stats_t stats;
+    settings_get_stats(&stats);
+    CHECK_EQ(stats.keys, 2);
+    CHECK_EQ(stats.torn_pages, 0);
+}
+
+// Reference map entry: length 0 = not set
+typedef struct {
+    uint8_t length;
+    uint8_t value[SETTINGS_MAX_VALUE_LENGTH];
+} fuzz_value_t;
+
+static char fuzz_keys[FUZZ_KEYS][SETTINGS_MAX_KEY_LENGTH + 1];
+static fuzz_value_t staged[FUZZ_KEYS];          // What settings_get() must return
+static fuzz_value_t committed[FUZZ_KEYS];       // What must survive a reboot
+static uint8_t region_before[REGION_SIZE];
+
+static int32_t random_in(int32_t n) {
+    return (int32_t)((((uint32_t)rand() << 16) ^ (uint32_t)rand()) % (uint32_t)n);
+}
+
+static uint32_t store_commits(void) {
+    settings_stats_t stats;
+    settings_get_stats(&stats);
+    return stats.commits;
+}
+
+// Every key must read back as the reference has it; returns the number that do not
+static uint32_t fuzz_mismatches(void) {
+    uint32_t mismatches = 0;
+    for (int k = 0; k < FUZZ_KEYS; k++) {
+        uint8_t value[SETTINGS_MAX_VALUE_LENGTH];
+        int length = settings_get(fuzz_keys[k], value, sizeof(value));
+        if (staged[k].length == 0) {
+            mismatches += length != -1;
+        } else {
+            mismatches += length != staged[k].length || memcmp(value, staged[k].value, staged[k].length) != 0;
+        }
+    }
+    return mismatches;
+}
+
+// Commit, then cut the power part way through programming the staged page; false if nothing was staged
+static bool torn_commit(void) {
+    uint8_t* region = &stub_flash[STORAGE_SETTINGS_OFFSET];
+    memcpy(region_before, region, REGION_SIZE);
+    uint32_t programs = stub_flash_programs;
+    settings_commit();
+    if (stub_flash_programs == programs) {
+        return false;
+    }
+
+    // The staged page is the newly programmed one with the lowest sequence (compaction follows it)
+    uint32_t torn = 0;
+    uint32_t torn_seq = UINT32_MAX;
+    for (uint32_t offset = 0; offset < REGION_SIZE; offset += STORAGE_PAGE_SIZE) {
+        bool was_erased = true;
+        for (uint32_t i = 0; i < STORAGE_PAGE_SIZE && was_erased; i++) {
+            was_erased = region_before[offset + i] == 0xFF;
+        }
+        uint32_t seq;
+        memcpy(&seq, &region[offset + 4], sizeof(seq));
+        if (was_erased && !storage_flash_is_erased(STORAGE_SETTINGS_OFFSET + offset, STORAGE_PAGE_SIZE) &&
+            seq < torn_seq) {
+            torn = offset;
+            torn_seq = seq;
+        }
+    }
+    uint8_t page[STORAGE_PAGE_SIZE];
+    memcpy(page, &region[torn], STORAGE_PAGE_SIZE);
+
+    // Nothing after the cut happened: only the first bytes of that page reached the flash
+    memcpy(region, region_before, REGION_SIZE);
+    int32_t written = random_in(STORAGE_PAGE_SIZE);
+    memcpy(&region[torn], page, written);
+
+    // The bytes that never arrived may have been 0xFF anyway, then the page is complete
+    if (memcmp(&region[torn], page, STORAGE_PAGE_SIZE) == 0) {
+        memcpy(committed, staged, sizeof(committed));
+    }
+    return true;
+}
+
+static void test_random_operations_match_reference(void) {
+    mount_fresh();
+    memset(staged, 0, sizeof(staged));
+    memset(committed, 0, sizeof(committed));
+
+    // Keys of every length from 3 to the maximum
+    for (int k = 0; k < FUZZ_KEYS; k++) {
+        int length = 3 + k % (SETTINGS_MAX_KEY_LENGTH - 2);
+        snprintf(fuzz_keys[k], sizeof(fuzz_keys[k]), "k%02d", k);
+        memset(fuzz_keys[k] + 3, 'x', length - 3);
+        fuzz_keys[k][length] = '\0';
+    }
+
+    // Boot scan time by fill level: pages in use, in whole sectors
+    uint32_t max_load_us[STORAGE_SETTINGS_SECTORS] = { 0 };
+    uint32_t boots[STORAGE_SETTINGS_SECTORS] = { 0 };
+    uint32_t counts[5] = { 0 };
+    uint32_t mismatches = 0;
+    uint32_t batches_lost = 0;
+
+    srand(1234);
+    stub_time_from_host = true;
+    for (int step = 0; step < FUZZ_STEPS; step++) {
+        int k = random_in(FUZZ_KEYS);
+        int op = random_in(100);
+        uint32_t commits = store_commits();
+        fuzz_value_t before[FUZZ_KEYS];
+        memcpy(before, staged, sizeof(before));
+
+        if (op < 50) {
+            fuzz_value_t value;
+            value.length = (uint8_t)(1 + random_in(SETTINGS_MAX_VALUE_LENGTH));
+            for (int i = 0; i < value.length; i++) {
+                value.value[i] = (uint8_t)rand();
+            }
+            CHECK(settings_set(fuzz_keys[k], value.value, value.length));
+            staged[k] = value;
+            counts[0]++;
+        } else if (op < 65) {
+            CHECK(settings_delete(fuzz_keys[k]));
+            staged[k].length = 0;
+            counts[1]++;
+        } else if (op < 85) {
+            CHECK(settings_commit());
+            memcpy(committed, staged, sizeof(committed));
+            counts[2]++;
+        } else {
+            if (op < 90) {
+                // Power lost during a commit: a reboot follows
+                if (torn_commit()) {
+                    batches_lost += memcmp(committed, staged, sizeof(committed)) != 0;
+                }
+                counts[3]++;
+            } else {
+                counts[4]++;
+            }
+            // Whatever was only staged is gone
+            CHECK(settings_init());
+            memcpy(staged, committed, sizeof(staged));
+
+            settings_stats_t stats;
+            settings_get_stats(&stats);
+            uint32_t fill = stats.pages_used / STORAGE_PAGES_PER_SECTOR;
+            fill = fill < STORAGE_SETTINGS_SECTORS ? fill : STORAGE_SETTINGS_SECTORS - 1;
+            max_load_us[fill] = stats.load_us > max_load_us[fill] ? stats.load_us : max_load_us[fill];
+            boots[fill]++;
+        }
+
+        // A set or delete that overflowed the staged page committed everything staged before it
+        if (op < 65 && store_commits() != commits) {
+            memcpy(committed, before, sizeof(committed));
+        }
+        mismatches += fuzz_mismatches();
+    }
+    stub_time_from_host = false;
+
+    CHECK(settings_init());
+    memcpy(staged, committed, sizeof(staged));
+    mismatches += fuzz_mismatches();
+
+    printf("  %lu sets, %lu deletes, %lu commits, %lu torn commits (%lu lost a batch), %lu reboots, %lu mismatches\n",
+           (unsigned long)counts[0], (unsigned long)counts[1], (unsigned long)counts[2], (unsigned long)counts[3],
+           (unsigned long)batches_lost, (unsigned long)counts[4], (unsigned long)mismatches);
+    for (uint32_t f = 0; f < STORAGE_SETTINGS_SECTORS; f++) {
+        printf("  boot with %lu-%lu pages in use: %lu boots, load_us up to %lu\n",
+               (unsigned long)(f * STORAGE_PAGES_PER_SECTOR), (unsigned long)((f + 1) * STORAGE_PAGES_PER_SECTOR - 1),
+               (unsigned long)boots[f], (unsigned long)max_load_us[f]);
+        CHECK(max_load_us[f] <= FUZZ_LOAD_LIMIT_US);
+    }
+    // One sector is always kept erased: the store was as full as it gets
+    CHECK(boots[STORAGE_SETTINGS_SECTORS - 2] > 0);
+    CHECK_EQ(mismatches, 0);
+    CHECK(batches_lost > 0);
+    CHECK(stub_flash_erases > 0);
+}
+
+int main(void) {
+    log_init();
+    log_set_level(LOG_LEVEL_WARN);
+
+    TEST_RUN(test_defaults_when_unset);
+    TEST_RUN(test_boot_keys_survive_reboot);
+    TEST_RUN(test_batch_commits_after_settling);
+    TEST_RUN(test_delete);
+    TEST_RUN(test_torn_commit_keeps_previous_value);
+    TEST_RUN(test_compaction_keeps_live_keys);
+    TEST_RUN(test_random_operations_match_reference);
+    TEST_EXIT();
+}
@@ -0,0 +1,380 @@
+/**
+ * Host tests for the stepper driver's moves, stops and pause/resume
+ * (drivers/stepper/stepper_driver.c)
+ *
+ * The PIO state machine is modelled by its pulse rate and its chunk queue:
+ * time advances in 100 us ticks, the queued chunks are played at the rate
+ * the driver last set (each chunk's end running the driver's interrupt), and
+ * stepper_driver_update() runs every 2 ms as from the main loop.
+ */
+
+#include "test_support.h"
+#include "stepper_driver.h"
+#include "stepper.pio.h"
+#include "logging.h"
+#include <math.h>
+#include <stdlib.h>
+
+#define TICK_US 100
+#define UPDATE_US 2000
+
+bool stub_step_enabled = false;
+uint32_t stub_step_frequency = 0;
+uint32_t stub_step_fifo[STUB_STEP_FIFO];
+uint32_t stub_step_queued;
+uint32_t stub_step_left;
+uint32_t stub_step_finished;
+irq_handler_t stub_step_handler;
+
+static uint32_t pulses;
+static int32_t steps;                       // Logical steps: pulses times the step size they were sent at
+static double pulse_budget;
+static uint32_t profile_hz;
+static int32_t mark_steps[STEPPER_MAX_MARKS];
+static uint32_t marks_seen;
+static uint32_t refused_mark;               // Mark whose callback refuses to go on
+static uint32_t highest_hz;
+static bool ramp_rose;                      // Pulse rate went up since last cleared
+static uint32_t last_hz;
+static uint64_t last_pulse_us;
+
+// No enable pin in these tests; the abstraction is linked in, never called
+bool gpio_pin_init(gpio_pin_t *pin, bool is_output) {
+    (void)pin;
+    (void)is_output;
+    return true;
+}
+
+bool gpio_pin_set_high(gpio_pin_t *pin) {
+    (void)pin;
+    return true;
+}
+
+bool gpio_pin_set_low(gpio_pin_t *pin) {
+    (void)pin;
+    return true;
+}
+
+static void tick(void) {
+    uint32_t hz = stub_step_enabled ? stub_step_frequency : 0;
+    pulse_budget += hz * (TICK_US / 1e6);
+    while (pulse_budget >= 1) {
+        pulse_budget -= 1;
+        int32_t size = STEPPER_MICROSTEPS / stepper_driver_get_microsteps();
+        steps += size;                      // Counted before the pulse: a chunk end interrupts from inside it
+        if (!stub_step_pulse()) {
+            steps -= size;
+            pulse_budget = 0;               // Waiting for a chunk
+            break;
+        }
+        pulses++;
+        last_pulse_us = stub_time_us;
+    }
+    if (hz > highest_hz) {
+        highest_hz = hz;
+    }
+    if (hz > last_hz && last_hz != 0) {
+        ramp_rose = true;
+    }
+    last_hz = hz;
+    stub_time_us += TICK_US;
+    if (stub_time_us % UPDATE_US == 0) {
+        stepper_driver_update();
+    }
+}
+
+static void run_for_ms(uint32_t ms) {
+    for (uint32_t i = 0; i < ms * 1000 / TICK_US; i++) {
+        tick();
+    }
+}
+
+static void run_while_running(void) {
+    for (int i = 0; i < 10000000 && stepper_driver_is_running() && !stepper_driver_is_paused(); i++) {
+        tick();
+    }
+}
+
+static uint32_t constant_profile(int32_t position) {
+    (void)position;
+    return profile_hz;
+}
+
+static uint16_t driver_microsteps = STEPPER_MICROSTEPS;
+
+static bool switch_microsteps(uint16_t microsteps) {
+    driver_microsteps = microsteps;
+    return true;
+}
+
+// Runs from the chunk interrupt, i.e. inside stub_step_pulse()
+static bool on_mark(uint32_t mark) {
+    CHECK_EQ(mark, marks_seen);
+    mark_steps[marks_seen++] = steps;
+    return mark != refused_mark;
+}
+
+static void reset(void) {
+    stub_time_us = 0;
+    pulses = 0;
+    steps = 0;
+    pulse_budget = 0;
+    marks_seen = 0;
+    refused_mark = STEPPER_MAX_MARKS;
+    highest_hz = 0;
+    ramp_rose = false;
+    last_hz = 0;
+    stepper_driver_init();
+}
+
+static void test_move_completes(void) {
+    reset();
+    stepper_driver_start(20000);
+    CHECK(stepper_driver_is_running());
+    run_while_running();
+
+    CHECK_EQ(stepper_driver_get_state(), STEPPER_COMPLETED);
+    CHECK_EQ(stepper_driver_get_current_steps(), 20000);
+    CHECK(!stub_step_enabled);
+    CHECK(highest_hz <= STEPPER_MAX_FREQ_HZ);
+    // Counted chunks: exactly the steps asked for
+    CHECK_EQ(pulses, 20000);
+}
+
+static void test_smooth_stop_ramps_down(void) {
+    reset();
+    stepper_driver_start(60000);
+    run_for_ms(3000);
+    CHECK_EQ(stepper_driver_get_current_frequency(), STEPPER_MAX_FREQ_HZ);
+
+    int32_t at_command = stepper_driver_get_current_steps();
+    ramp_rose = false;
+    stepper_driver_stop_smooth();
+    CHECK_EQ(stepper_driver_get_state(), STEPPER_STOPPING);
+    CHECK(stepper_driver_is_running());
+    run_while_running();
+
+    // Down from cruise at the move's own slope: about one ramp length, never speeding up
+    int32_t ramp = (int32_t)stepper_driver_get_accel_steps(60000);
+    int32_t after = stepper_driver_get_current_steps() - at_command;
+    printf("  smooth stop: %ld steps after the command, ramp is %ld\n", (long)after, (long)ramp);
+    CHECK(after > ramp * 8 / 10 && after < ramp * 12 / 10);
+    CHECK(!ramp_rose);
+    CHECK_EQ(stepper_driver_get_state(), STEPPER_IDLE);
+    CHECK(!stub_step_enabled);
+    CHECK(stepper_driver_get_current_steps() < 60000);
+}
+
+static void test_emergency_stop_is_immediate(void) {
+    reset();
+    stepper_driver_start(60000);
+    run_for_ms(1000);
+    stepper_driver_stop();
+    CHECK(!stub_step_enabled);
+    CHECK_EQ(stepper_driver_get_state(), STEPPER_IDLE);
+    uint32_t at_stop = pulses;
+    CHECK_EQ(stepper_driver_get_current_steps(), (int32_t)pulses);
+    run_for_ms(100);
+    CHECK_EQ(pulses, at_stop);
+}
+
+static void test_pause_resume_keeps_the_steps(void) {
+    reset();
+    CHECK(!stepper_driver_resume());        // Nothing paused
+
+    stepper_driver_start(30000);
+    run_for_ms(2000);
+    stepper_driver_pause();
+    run_while_running();
+    CHECK(stepper_driver_is_paused());
+    CHECK(stepper_driver_is_running());     // A paused move still counts as running
+    CHECK(!stub_step_enabled);
+
+    int32_t paused_at = stepper_driver_get_current_steps();
+    CHECK_EQ(paused_at, (int32_t)pulses);
+    run_for_ms(1000);
+    CHECK_EQ(stepper_driver_get_current_steps(), paused_at);
+
+    CHECK(stepper_driver_resume());
+    CHECK(stub_step_frequency <= STEPPER_MIN_FREQ_HZ + 100);   // Ramps up again from the minimum
+    run_while_running();
+
+    CHECK_EQ(stepper_driver_get_state(), STEPPER_COMPLETED);
+    CHECK_EQ(stepper_driver_get_current_steps(), 30000);
+    printf("  paused at %ld, %lu pulses in total for 30000 steps\n", (long)paused_at, (unsigned long)pulses);
+    CHECK_EQ(pulses, 30000);
+}
+
+typedef enum { STOP_EMERGENCY, STOP_SMOOTH, STOP_PAUSE } stop_mode_t;
+
+// At cruise in a long move, then stopped: steps after the command, time until the last pulse, and
+// steps lost (reported position against steps made; for a pause, after resuming to the end)
+static void measure_stop(stop_mode_t mode, int32_t *after, uint32_t *duration_us, int32_t *lost) {
+    reset();
+    stepper_driver_start(60000);
+    run_for_ms(3000);
+    CHECK_EQ(stepper_driver_get_current_frequency(), STEPPER_MAX_FREQ_HZ);
+
+    int32_t at_command = steps;
+    uint64_t command_us = stub_time_us;
+    last_pulse_us = command_us;
+    if (mode == STOP_EMERGENCY) {
+        stepper_driver_stop();
+    } else if (mode == STOP_SMOOTH) {
+        stepper_driver_stop_smooth();
+    } else {
+        stepper_driver_pause();
+    }
+    run_while_running();
+    run_for_ms(100);                        // Nothing more once stopped
+
+    *after = steps - at_command;
+    *duration_us = (uint32_t)(last_pulse_us - command_us);
+    *lost = stepper_driver_get_current_steps() - steps;
+    CHECK_EQ(stepper_driver_get_state(), mode == STOP_PAUSE ? STEPPER_PAUSED : STEPPER_IDLE);
+    if (mode == STOP_PAUSE) {
+        CHECK_EQ(*lost, 0);
+        CHECK(stepper_driver_resume());
+        run_while_running();
+        CHECK_EQ(stepper_driver_get_state(), STEPPER_COMPLETED);
+        *lost = 60000 - steps;
+    }
+}
+
+static void test_stop_modes_side_by_side(void) {
+    static const char *const names[] = { "emergency stop", "smooth stop", "pause/resume" };
+    int32_t after[3];
+    uint32_t duration_us[3];
+    int32_t lost[3];
+    for (int mode = STOP_EMERGENCY; mode <= STOP_PAUSE; mode++) {
+        measure_stop((stop_mode_t)mode, &after[mode], &duration_us[mode], &lost[mode]);
+        printf("  %-14s %5ld steps after the command, %6.1f ms to stand still, %ld steps lost\n",
+               names[mode], (long)after[mode], duration_us[mode] / 1000.0, (long)lost[mode]);
+        CHECK_EQ(lost[mode], 0);
+    }
+
+    // Emergency: not a pulse more. The ramps down: about one ramp length, in the time a linear
+    // ramp over steps takes from cruise to the minimum (ramp / (max - min) * ln(max / min))
+    CHECK_EQ(after[STOP_EMERGENCY], 0);
+    CHECK_EQ(duration_us[STOP_EMERGENCY], 0);
+    double ramp = stepper_driver_get_accel_steps(60000);
+    double ramp_us = ramp / (STEPPER_MAX_FREQ_HZ - STEPPER_MIN_FREQ_HZ) *
+                     log((double)STEPPER_MAX_FREQ_HZ / STEPPER_MIN_FREQ_HZ) * 1e6;
+    for (int mode = STOP_SMOOTH; mode <= STOP_PAUSE; mode++) {
+        CHECK(after[mode] > ramp * 0.8 && after[mode] < ramp * 1.2);
+        CHECK(duration_us[mode] > ramp_us * 0.8 && duration_us[mode] < ramp_us * 1.2);
+    }
+}
+
+static void test_marks_fall_on_their_step(void) {
+    reset();
+    const int32_t marks[] = { 1, 700, 701, 1024, 5000, 12345, 19999 };
+    uint32_t count = sizeof(marks) / sizeof(marks[0]);
+    profile_hz = 6000;
+    CHECK(!stepper_driver_set_marks((const int32_t[]){ 5, 5 }, 2, on_mark));  // Not increasing
+    CHECK(stepper_driver_set_marks(marks, count, on_mark));
+    stepper_driver_start_profile(20000, constant_profile);
+    CHECK(!stepper_driver_set_marks(marks, count, on_mark));                  // Not while running
+    run_while_running();
+
+    CHECK_EQ(stepper_driver_get_state(), STEPPER_COMPLETED);
+    CHECK_EQ(marks_seen, count);
+    for (uint32_t i = 0; i < count; i++) {
+        CHECK_EQ(mark_steps[i], marks[i]);
+    }
+    CHECK_EQ(pulses, 20000);
+
+    // A plain move has none
+    reset();
+    stepper_driver_start(3000);
+    run_while_running();
+    CHECK_EQ(marks_seen, 0);
+}
+
+static void test_resize_moves_later_marks(void) {
+    reset();
+    const int32_t marks[] = { 4000, 9000, 15000 };
+    profile_hz = 6000;
+    CHECK(stepper_driver_set_marks(marks, 3, on_mark));
+    stepper_driver_start_profile(20000, constant_profile);
+    run_for_ms(100);
+
+    // The segment ending at 9000 grows by 700, the one ending at 15000 shrinks by 200
+    CHECK(stepper_driver_resize(9000, 700));
+    CHECK(stepper_driver_resize(15700, -200));
+    CHECK_EQ(stepper_driver_get_target_steps(), 20500);
+    // Steps already handed to the PIO cannot change
+    CHECK(!stepper_driver_resize(stepper_driver_get_current_steps() + 10, 50));
+    run_while_running();
+
+    CHECK_EQ(marks_seen, 3);
+    CHECK_EQ(mark_steps[0], 4000);
+    CHECK_EQ(mark_steps[1], 9700);
+    CHECK_EQ(mark_steps[2], 15500);
+    CHECK_EQ(pulses, 20500);
+    CHECK_EQ(stepper_driver_get_current_steps(), 20500);
+}
+
+static void test_marks_at_coarse_steps(void) {
+    // 1/4 steps above 8 kHz: two logical steps per pulse, marks land on the nearest pulse
+    reset();
+    CHECK(stepper_driver_set_microstep_switch(switch_microsteps, 4));
+    CHECK(stepper_driver_set_frequency_limits(STEPPER_MIN_FREQ_HZ, 2 * STEPPER_MAX_FREQ_HZ));
+    const int32_t marks[] = { 3001, 9000, 9001, 24000 };
+    profile_hz = 12000;
+    CHECK(stepper_driver_set_marks(marks, 4, on_mark));
+    stepper_driver_start_profile(30000, constant_profile);
+    run_while_running();
+
+    CHECK_EQ(marks_seen, 4);
+    for (uint32_t i = 0; i < 4; i++) {
+        printf("  mark at %ld reached at step %ld\n", (long)marks[i], (long)mark_steps[i]);
+        CHECK(abs(mark_steps[i] - marks[i]) <= 1);
+    }
+    CHECK(pulses < 30000);                  // Mostly coarse pulses
+    CHECK(abs(steps - 30000) <= 1);
+
+    // The move ended coarse; dropping the switch puts the driver back to full resolution
+    CHECK(stepper_driver_set_microstep_switch(NULL, 0));
+    CHECK_EQ(driver_microsteps, STEPPER_MICROSTEPS);
+}
+
+static void test_refused_mark_stops_there(void) {
+    // The hook for the second mark fails (e.g. a valve did not open): not a step further
+    reset();
+    const int32_t marks[] = { 3000, 7000, 12000 };
+    profile_hz = 6000;
+    refused_mark = 1;
+    CHECK(stepper_driver_set_marks(marks, 3, on_mark));
+    stepper_driver_start_profile(20000, constant_profile);
+    run_for_ms(2000);
+
+    CHECK_EQ(stepper_driver_get_state(), STEPPER_IDLE);
+    CHECK_EQ(marks_seen, 2);
+    CHECK_EQ(pulses, 7000);
+    CHECK_EQ(stepper_driver_get_current_steps(), 7000);
+    CHECK(!stepper_driver_resume());
+
+    // The next move is not affected
+    reset();
+    stepper_driver_start(3000);
+    run_while_running();
+    CHECK_EQ(stepper_driver_get_state(), STEPPER_COMPLETED);
+    CHECK_EQ(pulses, 3000);
+}
+
+int main(void) {
+    log_init();
+    log_set_level(LOG_LEVEL_NONE);
+
+    TEST_RUN(test_move_completes);
+    TEST_RUN(test_smooth_stop_ramps_down);
+    TEST_RUN(test_emergency_stop_is_immediate);
+    TEST_RUN(test_pause_resume_keeps_the_steps);
+    TEST_RUN(test_stop_modes_side_by_side);
+    TEST_RUN(test_marks_fall_on_their_step);
+    TEST_RUN(test_resize_moves_later_marks);
+    TEST_RUN(test_marks_at_coarse_steps);
+    TEST_RUN(test_refused_mark_stops_there);
+    TEST_EXIT();
+}
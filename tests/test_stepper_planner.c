@@ -0,0 +1,182 @@
+/**
+ * Host tests for the move planner (drivers/stepper/stepper_planner.c)
+ *
+ * Sequences run on the stepper driver model, which plays the planner's
+ * profile step by step.
+ */
+
+#include "test_support.h"
+#include "stepper_planner.h"
+#include "stepper_driver_sim.h"
+#include "logging.h"
+#include <string.h>
+
+static uint32_t ended_tags[STEPPER_PLANNER_MAX_SEGMENTS + 1];
+static bool ended_completed[STEPPER_PLANNER_MAX_SEGMENTS + 1];
+static uint32_t ended;
+static uint32_t lowest_inner_hz;            // Slowest step away from the sequence's own ramps
+static int32_t inner_from;
+static int32_t inner_to;
+
+static void on_segment(uint32_t tag, bool completed) {
+    if (ended <= STEPPER_PLANNER_MAX_SEGMENTS) {
+        ended_tags[ended] = tag;
+        ended_completed[ended] = completed;
+    }
+    ended++;
+}
+
+static void on_step(int32_t position, uint32_t freq_hz) {
+    if (position > inner_from && position < inner_to && freq_hz < lowest_inner_hz) {
+        lowest_inner_hz = freq_hz;
+    }
+}
+
+static void reset(void) {
+    stub_time_us = 0;
+    stub_stepper_reset();
+    stub_stepper_on_step = on_step;
+    stepper_planner_clear();
+    stepper_planner_set_segment_callback(on_segment);
+    memset(ended_tags, 0, sizeof(ended_tags));
+    ended = 0;
+    lowest_inner_hz = UINT32_MAX;
+    inner_from = 0;
+    inner_to = 0;
+}
+
+static void run_to_end(int32_t steps_per_pass) {
+    for (int pass = 0; pass < 100000 && stepper_planner_is_running(); pass++) {
+        stub_stepper_run(steps_per_pass);
+        stepper_planner_process();
+    }
+}
+
+static void test_junctions_hold_cruise(void) {
+    reset();
+    for (uint32_t i = 0; i < 4; i++) {
+        CHECK(stepper_planner_add(8000, 0, 10 + i));
+    }
+    stepper_planner_plan();
+
+    stepper_segment_shape_t first, inner, last;
+    CHECK(stepper_planner_get_shape(0, &first));
+    CHECK(stepper_planner_get_shape(1, &inner));
+    CHECK(stepper_planner_get_shape(3, &last));
+    CHECK_EQ(first.entry_hz, STEPPER_MIN_FREQ_HZ);
+    CHECK_EQ(first.exit_hz, STEPPER_MAX_FREQ_HZ);
+    CHECK_EQ(inner.entry_hz, STEPPER_MAX_FREQ_HZ);
+    CHECK_EQ(inner.accel_steps, 0);
+    CHECK_EQ(inner.decel_steps, 0);
+    CHECK_EQ(last.exit_hz, STEPPER_MIN_FREQ_HZ);
+
+    uint32_t blended_ms, separate_ms;
+    stepper_planner_get_estimate(&blended_ms, &separate_ms);
+    printf("  4 x 8000 steps: %lu ms blended, %lu ms as separate moves\n",
+           (unsigned long)blended_ms, (unsigned long)separate_ms);
+    CHECK(blended_ms < separate_ms);
+
+    // Only the ends of the whole sequence ramp
+    inner_from = first.accel_steps;
+    inner_to = 4 * 8000 - last.decel_steps;
+    uint64_t start_us = stub_time_us;
+    CHECK(stepper_planner_start());
+    run_to_end(50);
+    CHECK_EQ(lowest_inner_hz, STEPPER_MAX_FREQ_HZ);
+    uint32_t run_ms = (uint32_t)((stub_time_us - start_us) / 1000);
+    CHECK(run_ms + 20 >= blended_ms && run_ms <= blended_ms + 20);
+
+    CHECK_EQ(ended, 4);
+    for (uint32_t i = 0; i < 4; i++) {
+        CHECK_EQ(ended_tags[i], 10 + i);
+        CHECK(ended_completed[i]);
+    }
+    CHECK_EQ(stub_stepper_starts, 1);
+}
+
+static void test_slow_segment_limits_its_junctions(void) {
+    reset();
+    CHECK(stepper_planner_add(6000, 0, 0));
+    CHECK(stepper_planner_add(6000, 3000, 1));
+    CHECK(stepper_planner_add(6000, 0, 2));
+    stepper_planner_plan();
+
+    stepper_segment_shape_t shape;
+    CHECK(stepper_planner_get_shape(0, &shape));
+    CHECK_EQ(shape.exit_hz, 3000);
+    CHECK(stepper_planner_get_shape(1, &shape));
+    CHECK_EQ(shape.entry_hz, 3000);
+    CHECK_EQ(shape.peak_hz, 3000);
+    CHECK_EQ(shape.exit_hz, 3000);
+}
+
+static void test_short_segments_stay_reachable(void) {
+    reset();
+    CHECK(stepper_planner_add(200, 0, 0));
+    CHECK(stepper_planner_add(200, 0, 1));
+    stepper_planner_plan();
+
+    // Too short to reach cruise: triangles that still stop at the end
+    stepper_segment_shape_t a, b;
+    CHECK(stepper_planner_get_shape(0, &a));
+    CHECK(stepper_planner_get_shape(1, &b));
+    CHECK(a.peak_hz < STEPPER_MAX_FREQ_HZ);
+    CHECK_EQ(a.exit_hz, b.entry_hz);
+    CHECK_EQ(b.exit_hz, STEPPER_MIN_FREQ_HZ);
+    CHECK_EQ(a.accel_steps + a.decel_steps, 200);
+    CHECK_EQ(b.accel_steps + b.decel_steps, 200);
+}
+
+static void test_resize_while_running(void) {
+    reset();
+    CHECK(stepper_planner_add(20000, 0, 0));
+    CHECK(stepper_planner_add(20000, 0, 1));
+    CHECK(stepper_planner_start());
+    stub_stepper_run(5000);
+    stepper_planner_process();
+
+    uint32_t index;
+    int32_t offset;
+    CHECK(stepper_planner_get_progress(&index, &offset));
+    CHECK_EQ(index, 0);
+    CHECK_EQ(offset, 5000);
+
+    // The current segment grows, the next one shrinks; the sequence ends on the new total
+    CHECK(stepper_planner_adjust_steps(0, 22000));
+    CHECK(stepper_planner_adjust_steps(1, 15000));
+    CHECK(!stepper_planner_adjust_steps(0, 4900));     // Already past that
+    run_to_end(50);
+    CHECK_EQ(stepper_driver_get_current_steps(), 37000);
+    CHECK_EQ(ended, 2);
+}
+
+static void test_stop_reports_the_segment(void) {
+    reset();
+    CHECK(stepper_planner_add(5000, 0, 7));
+    CHECK(stepper_planner_add(5000, 0, 8));
+    CHECK(stepper_planner_start());
+    CHECK(!stepper_planner_add(100, 0, 9));            // Queue is fixed while running
+    stub_stepper_run(7000);
+    stepper_planner_process();
+    stepper_driver_stop();
+    stepper_planner_process();
+
+    CHECK(!stepper_planner_is_running());
+    CHECK_EQ(ended, 2);
+    CHECK_EQ(ended_tags[0], 7);
+    CHECK(ended_completed[0]);
+    CHECK_EQ(ended_tags[1], 8);
+    CHECK(!ended_completed[1]);
+}
+
+int main(void) {
+    log_init();
+    log_set_level(LOG_LEVEL_NONE);
+
+    TEST_RUN(test_junctions_hold_cruise);
+    TEST_RUN(test_slow_segment_limits_its_junctions);
+    TEST_RUN(test_short_segments_stay_reachable);
+    TEST_RUN(test_resize_while_running);
+    TEST_RUN(test_stop_reports_the_segment);
+    TEST_EXIT();
+}
@@ -0,0 +1,12 @@
+/**
+ * PicoFlora host test support - stub state shared by every test
+ */
+
+#include "test_support.h"
+#include "hardware/pio.h"
+
+int test_failures = 0;
+uint64_t stub_time_us = 0;
+bool stub_time_from_host = false;
+uint32_t stub_lock_depth = 0;
+pio_hw_t stub_pio_hw[2];
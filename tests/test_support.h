@@ -0,0 +1,51 @@
+/**
+ * PicoFlora host test support
+ *
+ * Each test is a plain executable: CHECK() records a failure and carries on,
+ * TEST_RUN() runs one case, and TEST_EXIT() turns the failure count into the
+ * exit status CTest looks at.
+ */
+
+#ifndef TEST_SUPPORT_H
+#define TEST_SUPPORT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+extern int test_failures;
+
+// Simulated time (pico/time.h stub; the host clock while stub_time_from_host is set) and lock nesting (hardware/sync.h stub)
+extern uint64_t stub_time_us;
+extern bool stub_time_from_host;
+extern uint32_t stub_lock_depth;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            test_failures++; \
+        } \
+    } while (0)
+
+#define CHECK_EQ(actual, expected) \
+    do { \
+        long long actual_ = (long long)(actual); \
+        long long expected_ = (long long)(expected); \
+        if (actual_ != expected_) { \
+            fprintf(stderr, "%s:%d: CHECK_EQ failed: %s == %lld, expected %lld\n", \
+                    __FILE__, __LINE__, #actual, actual_, expected_); \
+            test_failures++; \
+        } \
+    } while (0)
+
+#define TEST_RUN(test) \
+    do { \
+        int before_ = test_failures; \
+        test(); \
+        printf("%s %s\n", test_failures == before_ ? "PASS" : "FAIL", #test); \
+    } while (0)
+
+#define TEST_EXIT() return test_failures == 0 ? 0 : 1
+
+#endif // TEST_SUPPORT_H
@@ -0,0 +1,235 @@
+/**
+ * Host tests for the time-series store (drivers/storage/timeseries.c)
+ *
+ * Ten days of three series at 10 s intervals go into the RAM flash model,
+ * enough to wrap the raw and 1-minute rings. Whatever each tier still holds
+ * is checked point by point against rollups computed from the reference
+ * samples, before and after a remount.
+ */
+
+#include "test_support.h"
+#include "timeseries.h"
+#include "storage_flash.h"
+#include "logging.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define STEP_S 10
+#define T0 1767225600u                      // 2026-01-01 00:00:00
+#define DAYS 10
+#define SAMPLES (DAYS * 86400 / STEP_S)
+#define SERIES 3
+
+extern uint8_t stub_flash[PICO_FLASH_SIZE_BYTES];
+
+static int32_t reference[SERIES][SAMPLES];
+
+static void make_reference(void) {
+    srand(1);
+    int32_t moisture = 2000;
+    int32_t battery = 4100;
+    for (uint32_t i = 0; i < SAMPLES; i++) {
+        uint32_t second = (i * STEP_S) % 86400;
+        if (second == 6 * 3600) {
+            moisture = 2800;                                // Watered
+        }
+        if (i % 6 == 0 && moisture > 1500 && rand() % 3 == 0) {
+            moisture--;                                     // Drying out
+        }
+        if (rand() % 7 == 0 && --battery < 3400) {
+            battery = 4150;                                 // Recharged
+        }
+        int32_t daylight = (int32_t)second / 36;
+        int32_t temperature = 2200 + (daylight < 1200 ? daylight / 2 : (2400 - daylight) / 2);
+
+        reference[0][i] = moisture + rand() % 5 - 2;
+        reference[1][i] = battery;
+        reference[2][i] = temperature + rand() % 3 - 1;
+    }
+}
+
+static void insert_all(void) {
+    for (uint32_t i = 0; i < SAMPLES; i++) {
+        uint32_t time = T0 + i * STEP_S;
+        for (uint8_t series = 0; series < SERIES; series++) {
+            CHECK(timeseries_insert(series, time, reference[series][i]));
+        }
+        if (i % 360 == 0) {
+            timeseries_process(time);
+        }
+    }
+    timeseries_process(T0 + SAMPLES * STEP_S);
+}
+
+// Every raw point in [from, to] matches its sample, consecutive and through to 'to'
+static uint32_t check_raw(uint8_t series, uint32_t from, uint32_t to) {
+    timeseries_iter_t iter;
+    timeseries_point_t point;
+    uint32_t count = 0;
+    uint32_t mismatches = 0;
+    uint32_t expected = 0;
+    timeseries_query(&iter, TIMESERIES_TIER_RAW, series, from, to);
+    while (timeseries_next(&iter, &point)) {
+        uint32_t i = (point.time - T0) / STEP_S;
+        if (count > 0 && i != expected) {
+            mismatches++;
+        }
+        if (point.time < from || point.time > to || point.count != 1 ||
+            point.min != reference[series][i] || point.avg != point.min || point.max != point.min) {
+            mismatches++;
+        }
+        expected = i + 1;
+        count++;
+    }
+    CHECK_EQ(mismatches, 0);
+    CHECK_EQ(expected, (to - T0) / STEP_S + 1);
+    return count;
+}
+
+// Every rollup point matches min/avg/max/count over its bucket's samples; returns the points seen
+static uint32_t check_rollups(timeseries_tier_t tier, uint8_t series) {
+    uint32_t seconds = timeseries_tier_seconds(tier);
+    uint32_t per_bucket = seconds / STEP_S;
+    timeseries_iter_t iter;
+    timeseries_point_t point;
+    uint32_t count = 0;
+    uint32_t mismatches = 0;
+    uint32_t previous = 0;
+    timeseries_query(&iter, tier, series, 0, UINT32_MAX);
+    while (timeseries_next(&iter, &point)) {
+        uint32_t first = (point.time - T0) / STEP_S;
+        int32_t min = INT32_MAX;
+        int32_t max = INT32_MIN;
+        int64_t sum = 0;
+        for (uint32_t i = first; i < first + per_bucket; i++) {
+            int32_t value = reference[series][i];
+            min = value < min ? value : min;
+            max = value > max ? value : max;
+            sum += value;
+        }
+        int32_t avg = (int32_t)((sum + per_bucket / 2) / per_bucket);
+        if (point.time % seconds != 0 || (count > 0 && point.time != previous + seconds) ||
+            point.count != per_bucket || point.min != min || point.avg != avg || point.max != max) {
+            mismatches++;
+        }
+        previous = point.time;
+        count++;
+    }
+    CHECK_EQ(mismatches, 0);
+    if (count > 0) {
+        CHECK_EQ(previous, T0 + SAMPLES * STEP_S - seconds);     // Up to the last closed bucket
+    }
+    return count;
+}
+
+static void check_all_tiers(void) {
+    uint32_t end = T0 + (SAMPLES - 1) * STEP_S;
+    for (uint8_t series = 0; series < SERIES; series++) {
+        CHECK_EQ(check_raw(series, end - 86400 + STEP_S, end), 86400 / STEP_S);
+        check_raw(series, end - 3600 + 1, end - 1800 - 1);      // Bounds between samples
+        CHECK(check_rollups(TIMESERIES_TIER_1MIN, series) >= 5 * 1440);
+        CHECK_EQ(check_rollups(TIMESERIES_TIER_15MIN, series), DAYS * 96);
+        CHECK_EQ(check_rollups(TIMESERIES_TIER_DAY, series), DAYS);
+    }
+}
+
+static void test_tiers_hold_their_history(void) {
+    storage_flash_init();
+    CHECK(timeseries_init());
+    insert_all();
+    check_all_tiers();
+
+    timeseries_stats_t stats;
+    timeseries_get_stats(&stats);
+    printf("  raw %.2f bytes/sample, holds %.1f h; 1 min holds %.1f days\n",
+           (double)stats.payload_bytes[TIMESERIES_TIER_RAW] / stats.records[TIMESERIES_TIER_RAW],
+           (T0 + SAMPLES * STEP_S - stats.oldest[TIMESERIES_TIER_RAW]) / 3600.0,
+           (T0 + SAMPLES * STEP_S - stats.oldest[TIMESERIES_TIER_1MIN]) / 86400.0);
+    CHECK_EQ(stats.samples, SAMPLES * SERIES);
+    CHECK(stats.payload_bytes[TIMESERIES_TIER_RAW] < 4 * stats.records[TIMESERIES_TIER_RAW]);
+    CHECK(stats.oldest[TIMESERIES_TIER_RAW] > T0);                  // Wrapped
+    CHECK_EQ(stats.oldest[TIMESERIES_TIER_DAY], T0);
+    CHECK_EQ(stats.write_errors, 0);
+
+    // Unknown series and empty ranges
+    CHECK(!timeseries_insert(TIMESERIES_MAX_SERIES, T0, 1));
+    timeseries_iter_t iter;
+    timeseries_point_t point;
+    timeseries_query(&iter, TIMESERIES_TIER_DAY, TIMESERIES_DOSE_UL, 0, UINT32_MAX);
+    CHECK(!timeseries_next(&iter, &point));
+    timeseries_query(&iter, TIMESERIES_TIER_DAY, 0, T0 + 86400, T0);
+    CHECK(!timeseries_next(&iter, &point));
+}
+
+static void test_remount_keeps_everything(void) {
+    // Continues on the store from the previous test
+    timeseries_flush();
+    CHECK(timeseries_init());
+    check_all_tiers();
+
+    timeseries_stats_t stats;
+    timeseries_get_stats(&stats);
+    CHECK_EQ(stats.torn_pages, 0);
+
+    // Appends resume after the last page
+    uint32_t time = T0 + SAMPLES * STEP_S;
+    CHECK(timeseries_insert(0, time, 1234));
+    timeseries_flush();
+    CHECK(timeseries_init());
+    timeseries_iter_t iter;
+    timeseries_point_t point;
+    timeseries_query(&iter, TIMESERIES_TIER_RAW, 0, time, time);
+    CHECK(timeseries_next(&iter, &point));
+    CHECK_EQ(point.avg, 1234);
+    CHECK(!timeseries_next(&iter, &point));
+}
+
+// Raw points of a series, checking order and values on the way
+static uint32_t count_raw(uint8_t series) {
+    timeseries_iter_t iter;
+    timeseries_point_t point;
+    uint32_t count = 0;
+    uint32_t last = 0;
+    uint32_t mismatches = 0;
+    timeseries_query(&iter, TIMESERIES_TIER_RAW, series, 0, UINT32_MAX);
+    while (timeseries_next(&iter, &point)) {
+        if (point.time <= last || point.avg != reference[series][(point.time - T0) / STEP_S]) {
+            mismatches++;
+        }
+        last = point.time;
+        count++;
+    }
+    CHECK_EQ(mismatches, 0);
+    return count;
+}
+
+static void test_torn_page_is_skipped(void) {
+    uint32_t before = count_raw(1);
+
+    // A bit lost in one raw page (power cut while programming): that page goes, the rest stays
+    uint32_t page = STORAGE_TS_OFFSET + 5 * STORAGE_PAGE_SIZE;
+    CHECK(stub_flash[page] == (TIMESERIES_PAGE_MAGIC & 0xFF));
+    stub_flash[page + TIMESERIES_PAGE_HEADER_SIZE + 40] ^= 0x10;
+    CHECK(timeseries_init());
+
+    timeseries_stats_t stats;
+    timeseries_get_stats(&stats);
+    CHECK_EQ(stats.torn_pages, 1);
+
+    uint32_t after = count_raw(1);
+    printf("  %lu of %lu raw points of series 1 left after losing a page\n",
+           (unsigned long)after, (unsigned long)before);
+    CHECK(after < before);
+    CHECK(after > before - TIMESERIES_PAYLOAD_SIZE / 2);
+}
+
+int main(void) {
+    log_init();
+    log_set_level(LOG_LEVEL_NONE);
+    make_reference();
+
+    TEST_RUN(test_tiers_hold_their_history);
+    TEST_RUN(test_remount_keeps_everything);
+    TEST_RUN(test_torn_page_is_skipped);
+    TEST_EXIT();
+}
@@ -0,0 +1,185 @@
+/**
+ * Host benchmark of the time-series store (drivers/storage/timeseries.c)
+ *
+ * A simulated year goes into the RAM flash model: moisture, battery and
+ * temperature every 10 s, and two doses a day. It reports the encoded bytes
+ * per record of each tier, the flash written per sample, the insert cost
+ * (rollups, page writes and erase-ahead included) and how long a range query
+ * over what a history screen shows takes on each tier. Host times only
+ * compare builds; the counts and the daily tier are checked.
+ */
+
+#include "test_support.h"
+#include "timeseries.h"
+#include "storage_flash.h"
+#include "logging.h"
+#include "pico/time.h"
+#include <stdlib.h>
+
+#define STEP_S 10
+#define T0 1767225600u                      // 2026-01-01 00:00:00
+#define DAYS 365
+#define PER_DAY (86400 / STEP_S)
+#define SAMPLES (DAYS * PER_DAY)
+#define END (T0 + DAYS * 86400u)
+#define DOSE_TIMES { 6 * 3600, 18 * 3600 }
+
+extern uint32_t stub_flash_programs;
+
+// Daily min/sum/max of every series, to check the day tier against
+static int32_t day_min[TIMESERIES_MAX_SERIES][DAYS];
+static int32_t day_max[TIMESERIES_MAX_SERIES][DAYS];
+static int64_t day_sum[TIMESERIES_MAX_SERIES][DAYS];
+static uint32_t day_count[TIMESERIES_MAX_SERIES][DAYS];
+
+static uint64_t insert_us;
+static uint32_t inserted;
+
+static void insert(uint8_t series, uint32_t time, int32_t value) {
+    uint32_t day = (time - T0) / 86400;
+    if (day_count[series][day] == 0 || value < day_min[series][day]) day_min[series][day] = value;
+    if (day_count[series][day] == 0 || value > day_max[series][day]) day_max[series][day] = value;
+    day_sum[series][day] += value;
+    day_count[series][day]++;
+
+    stub_time_from_host = true;
+    uint64_t start_us = time_us_64();
+    CHECK(timeseries_insert(series, time, value));
+    insert_us += time_us_64() - start_us;
+    stub_time_from_host = false;
+    inserted++;
+}
+
+static void process(uint32_t now) {
+    stub_time_from_host = true;
+    uint64_t start_us = time_us_64();
+    timeseries_process(now);
+    insert_us += time_us_64() - start_us;
+    stub_time_from_host = false;
+}
+
+// Same shapes as test_timeseries.c: watering, drying, battery cycles, daylight
+static void insert_year(void) {
+    static const uint32_t dose_times[] = DOSE_TIMES;
+    srand(365);
+    int32_t moisture = 2000;
+    int32_t battery = 4100;
+    for (uint32_t i = 0; i < SAMPLES; i++) {
+        uint32_t time = T0 + i * STEP_S;
+        uint32_t second = (i * STEP_S) % 86400;
+        if (second == 6 * 3600) {
+            moisture = 2800;                                // Watered
+        }
+        if (i % 6 == 0 && moisture > 1500 && rand() % 3 == 0) {
+            moisture--;                                     // Drying out
+        }
+        if (rand() % 7 == 0 && --battery < 3400) {
+            battery = 4150;                                 // Recharged
+        }
+        int32_t daylight = (int32_t)second / 36;
+        int32_t temperature = 2200 + (daylight < 1200 ? daylight / 2 : (2400 - daylight) / 2);
+
+        insert(TIMESERIES_MOISTURE, time, moisture + rand() % 5 - 2);
+        insert(TIMESERIES_BATTERY_MV, time, battery);
+        insert(TIMESERIES_TEMPERATURE, time, temperature + rand() % 3 - 1);
+        for (uint32_t d = 0; d < sizeof(dose_times) / sizeof(dose_times[0]); d++) {
+            if (second == dose_times[d]) {
+                insert(TIMESERIES_DOSE_UL, time, 20000 + rand() % 500);
+            }
+        }
+        if (i % 360 == 0) {
+            process(time);
+        }
+    }
+    process(END);
+}
+
+// Every daily point matches the year's reference
+static void check_day_tier(uint8_t series) {
+    timeseries_iter_t iter;
+    timeseries_point_t point;
+    uint32_t count = 0;
+    uint32_t mismatches = 0;
+    timeseries_query(&iter, TIMESERIES_TIER_DAY, series, 0, UINT32_MAX);
+    while (timeseries_next(&iter, &point)) {
+        uint32_t day = (point.time - T0) / 86400;
+        uint32_t n = day_count[series][day];
+        if (point.time != T0 + count * 86400 || point.count != n || point.min != day_min[series][day] ||
+            point.max != day_max[series][day] || point.avg != (int32_t)((day_sum[series][day] + n / 2) / n)) {
+            mismatches++;
+        }
+        count++;
+    }
+    CHECK_EQ(mismatches, 0);
+    CHECK_EQ(count, DAYS);
+}
+
+// A range query run until it has taken some time; the host time of one and its points
+static double time_query(timeseries_tier_t tier, uint8_t series, uint32_t from, uint32_t to,
+                         uint32_t *points, uint32_t *first) {
+    timeseries_iter_t iter;
+    timeseries_point_t point;
+    uint32_t runs = 0;
+    stub_time_from_host = true;
+    uint64_t start_us = time_us_64();
+    uint64_t elapsed_us;
+    do {
+        *points = 0;
+        timeseries_query(&iter, tier, series, from, to);
+        while (timeseries_next(&iter, &point)) {
+            if (*points == 0) {
+                *first = point.time;
+            }
+            (*points)++;
+        }
+        runs++;
+        elapsed_us = time_us_64() - start_us;
+    } while (elapsed_us < 20000 && runs < 1000);
+    stub_time_from_host = false;
+    return (double)elapsed_us / runs;
+}
+
+static void test_year_of_history(void) {
+    storage_flash_init();
+    CHECK(timeseries_init());
+    insert_year();
+
+    timeseries_stats_t stats;
+    timeseries_get_stats(&stats);
+    printf("  %lu samples: %.0f ns each to insert, %.2f bytes/sample written to flash over all tiers\n",
+           (unsigned long)inserted, insert_us * 1000.0 / inserted,
+           (double)stub_flash_programs * STORAGE_PAGE_SIZE / inserted);
+    CHECK_EQ(stats.samples, inserted);
+    CHECK_EQ(stats.write_errors, 0);
+    CHECK_EQ(stats.torn_pages, 0);
+    CHECK(stats.payload_bytes[TIMESERIES_TIER_RAW] < 4 * stats.records[TIMESERIES_TIER_RAW]);
+
+    // What a history screen shows of each tier, for the moisture probe
+    static const uint32_t window_days[TIMESERIES_TIER_COUNT] = { 1, 7, 30, DAYS };
+    static const char *const names[TIMESERIES_TIER_COUNT] = { "raw", "1 min", "15 min", "day" };
+    for (uint32_t tier = 0; tier < TIMESERIES_TIER_COUNT; tier++) {
+        uint32_t from = END - window_days[tier] * 86400;
+        uint32_t points = 0;
+        uint32_t first = 0;
+        double us = time_query((timeseries_tier_t)tier, TIMESERIES_MOISTURE, from, END - 1, &points, &first);
+        printf("  %-6s %.2f bytes/record, holds %5.1f days; last %3lu days: %6lu points in %8.1f us (%.0f ns/point)\n",
+               names[tier], (double)stats.payload_bytes[tier] / stats.records[tier],
+               (END - stats.oldest[tier]) / 86400.0, (unsigned long)window_days[tier], (unsigned long)points, us,
+               us * 1000.0 / points);
+        uint32_t seconds = tier == TIMESERIES_TIER_RAW ? STEP_S : timeseries_tier_seconds((timeseries_tier_t)tier);
+        CHECK_EQ(points, window_days[tier] * 86400 / seconds);    // The whole window is still held
+        CHECK_EQ(first, from);
+    }
+
+    for (uint8_t series = 0; series < TIMESERIES_MAX_SERIES; series++) {
+        check_day_tier(series);
+    }
+}
+
+int main(void) {
+    log_init();
+    log_set_level(LOG_LEVEL_NONE);
+
+    TEST_RUN(test_year_of_history);
+    TEST_EXIT();
+}
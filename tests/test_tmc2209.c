@@ -0,0 +1,275 @@
+/**
+ * Host tests for the TMC2209 UART driver (drivers/tmc2209/tmc2209.c)
+ *
+ * The single-wire line is modelled with a register-level chip on it: every
+ * byte sent is echoed back to the receiver, read requests with a valid CRC
+ * get a reply datagram and valid writes land in the register file and bump
+ * IFCNT. Waiting on an empty receiver costs one byte time.
+ */
+
+#include "test_support.h"
+#include "tmc2209.h"
+#include "logging.h"
+#include <string.h>
+
+#define BYTE_TIME_US 87                     // 10 bits at 115200 baud
+
+struct uart_inst {
+    int unused;
+};
+
+static struct uart_inst line;
+uart_inst_t *stub_uart0 = &line;
+
+// Receiver as seen by the driver
+static uint8_t rx[256];
+static uint32_t rx_head;
+static uint32_t rx_tail;
+
+// Last datagram sent by the driver
+static uint8_t sent[8];
+static size_t sent_length;
+
+// The chip
+static struct {
+    uint32_t regs[128];
+    uint8_t ifcnt;
+    uint8_t address;
+    bool silent;                            // Not powered / not wired
+    bool corrupt_next;                      // Flip a bit in the next reply
+    uint8_t frame[8];
+    size_t frame_length;
+} chip;
+
+static uint8_t crc8(const uint8_t *data, size_t length) {
+    uint8_t crc = 0;
+    for (size_t i = 0; i < length; i++) {
+        uint8_t byte = data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = ((crc >> 7) ^ (byte & 1)) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+            byte >>= 1;
+        }
+    }
+    return crc;
+}
+
+static void rx_put(uint8_t byte) {
+    rx[rx_head++ & 0xFF] = byte;
+}
+
+static void chip_receive(uint8_t byte) {
+    rx_put(byte);                           // Own transmission echoed on the shared wire
+    if (chip.silent || (chip.frame_length == 0 && byte != 0x05)) {
+        return;
+    }
+    chip.frame[chip.frame_length++] = byte;
+
+    if (chip.frame_length == 4 && !(chip.frame[2] & 0x80)) {
+        chip.frame_length = 0;
+        if (chip.frame[1] != chip.address || crc8(chip.frame, 3) != chip.frame[3]) {
+            return;
+        }
+        uint8_t reg = chip.frame[2];
+        uint32_t value = reg == TMC2209_REG_IFCNT ? chip.ifcnt : chip.regs[reg];
+        uint8_t reply[8] = { 0x05, 0xFF, reg, (uint8_t)(value >> 24), (uint8_t)(value >> 16),
+                             (uint8_t)(value >> 8), (uint8_t)value, 0 };
+        reply[7] = crc8(reply, 7);
+        if (chip.corrupt_next) {
+            reply[5] ^= 1;
+            chip.corrupt_next = false;
+        }
+        for (int i = 0; i < 8; i++) {
+            rx_put(reply[i]);
+        }
+    } else if (chip.frame_length == 8) {
+        chip.frame_length = 0;
+        if (chip.frame[1] != chip.address || crc8(chip.frame, 7) != chip.frame[7]) {
+            return;
+        }
+        chip.regs[chip.frame[2] & 0x7F] = ((uint32_t)chip.frame[3] << 24) | ((uint32_t)chip.frame[4] << 16) |
+                                          ((uint32_t)chip.frame[5] << 8) | chip.frame[6];
+        chip.ifcnt++;
+    }
+}
+
+uint uart_init(uart_inst_t *uart, uint baudrate) {
+    (void)uart;
+    return baudrate;
+}
+
+void uart_write_blocking(uart_inst_t *uart, const uint8_t *src, size_t len) {
+    (void)uart;
+    memcpy(sent, src, len < sizeof(sent) ? len : sizeof(sent));
+    sent_length = len;
+    for (size_t i = 0; i < len; i++) {
+        stub_time_us += BYTE_TIME_US;
+        chip_receive(src[i]);
+    }
+}
+
+void uart_tx_wait_blocking(uart_inst_t *uart) {
+    (void)uart;
+}
+
+bool uart_is_readable(uart_inst_t *uart) {
+    (void)uart;
+    if (rx_head == rx_tail) {
+        stub_time_us += BYTE_TIME_US;
+        return false;
+    }
+    return true;
+}
+
+char uart_getc(uart_inst_t *uart) {
+    (void)uart;
+    return (char)rx[rx_tail++ & 0xFF];
+}
+
+static void power_up(void) {
+    memset(&chip, 0, sizeof(chip));
+    rx_head = rx_tail = 0;
+    chip.regs[TMC2209_REG_IOIN] = ((uint32_t)TMC2209_VERSION << 24) | 0x40;
+    chip.regs[TMC2209_REG_CHOPCONF] = TMC2209_CHOPCONF_DEFAULT;
+    chip.regs[TMC2209_REG_DRV_STATUS] = TMC2209_DRV_STATUS_STST | (1u << 30) | (0x11u << 16);
+    chip.regs[TMC2209_REG_MSCNT] = 0x123;
+    chip.regs[TMC2209_REG_SG_RESULT] = 0x2AB;
+    chip.regs[TMC2209_REG_TSTEP] = 0xFFFFF;
+}
+
+static uint32_t mres(void) {
+    return (chip.regs[TMC2209_REG_CHOPCONF] & TMC2209_CHOPCONF_MRES_MASK) >> TMC2209_CHOPCONF_MRES_SHIFT;
+}
+
+static void test_datagram_crc(void) {
+    power_up();
+    uint32_t value;
+    CHECK(tmc2209_init(uart0, 0, 1, 0));
+    CHECK(tmc2209_read_register(TMC2209_REG_GCONF, &value));
+
+    // Datasheet example: reading GCONF from address 0 is 05 00 00 48
+    CHECK_EQ(sent_length, 4);
+    CHECK_EQ(sent[0], 0x05);
+    CHECK_EQ(sent[1], 0x00);
+    CHECK_EQ(sent[2], 0x00);
+    CHECK_EQ(sent[3], 0x48);
+}
+
+static void test_absent_chip(void) {
+    power_up();
+    chip.silent = true;
+    uint64_t start_us = stub_time_us;
+    CHECK(!tmc2209_init(uart0, 0, 1, 0));
+    CHECK(!tmc2209_is_present());
+    CHECK(stub_time_us - start_us >= TMC2209_REPLY_TIMEOUT_US);
+
+    // Nothing but the STEP/EN path: configuration calls refuse
+    CHECK(!tmc2209_set_microsteps(16));
+    CHECK(!tmc2209_set_current(16, 8, 6));
+    CHECK(!tmc2209_set_stealthchop(true));
+
+    // Wrong chip on the line
+    power_up();
+    chip.regs[TMC2209_REG_IOIN] = 0x20u << 24;
+    CHECK(!tmc2209_init(uart0, 0, 1, 0));
+}
+
+static void test_init_configures_the_chip(void) {
+    power_up();
+    CHECK(tmc2209_init(uart0, 0, 1, 0));
+    CHECK(tmc2209_is_present());
+    CHECK_EQ(chip.regs[TMC2209_REG_GCONF],
+             TMC2209_GCONF_PDN_DISABLE | TMC2209_GCONF_MSTEP_REG_SELECT | TMC2209_GCONF_MULTISTEP_FILT);
+    CHECK_EQ(mres(), 5);
+    CHECK_EQ(tmc2209_get_microsteps(), TMC2209_DEFAULT_MICROSTEPS);
+    CHECK_EQ(chip.regs[TMC2209_REG_IHOLD_IRUN],
+             TMC2209_DEFAULT_IHOLD | (TMC2209_DEFAULT_IRUN << 8) | (TMC2209_DEFAULT_IHOLD_DELAY << 16));
+}
+
+static void test_microstep_resolution(void) {
+    power_up();
+    CHECK(tmc2209_init(uart0, 0, 1, 0));
+
+    for (uint32_t i = 0; i <= 8; i++) {
+        uint16_t microsteps = (uint16_t)(256u >> i);
+        CHECK(tmc2209_set_microsteps(microsteps));
+        CHECK_EQ(mres(), i);
+        CHECK_EQ(tmc2209_get_microsteps(), microsteps);
+    }
+    CHECK(!tmc2209_set_microsteps(3));
+    CHECK(!tmc2209_set_microsteps(512));
+
+    // The rest of CHOPCONF is left alone
+    CHECK_EQ(chip.regs[TMC2209_REG_CHOPCONF] & ~TMC2209_CHOPCONF_MRES_MASK,
+             TMC2209_CHOPCONF_DEFAULT & ~TMC2209_CHOPCONF_MRES_MASK);
+}
+
+static void test_modes_and_limits(void) {
+    power_up();
+    CHECK(tmc2209_init(uart0, 0, 1, 0));
+
+    CHECK(tmc2209_set_stealthchop(false));
+    CHECK(chip.regs[TMC2209_REG_GCONF] & TMC2209_GCONF_EN_SPREADCYCLE);
+    CHECK(tmc2209_set_stealthchop(true));
+    CHECK(!(chip.regs[TMC2209_REG_GCONF] & TMC2209_GCONF_EN_SPREADCYCLE));
+
+    CHECK(tmc2209_set_pwm_threshold(500));
+    CHECK_EQ(chip.regs[TMC2209_REG_TPWMTHRS], 500);
+    CHECK(!tmc2209_set_pwm_threshold(0x100000));
+    CHECK(!tmc2209_set_current(32, 0, 0));
+    CHECK(!tmc2209_set_current(16, 8, 16));
+
+    CHECK(tmc2209_set_stallguard(40, 2000));
+    CHECK_EQ(chip.regs[TMC2209_REG_SGTHRS], 40);
+    CHECK_EQ(chip.regs[TMC2209_REG_TCOOLTHRS], 2000);
+}
+
+static void test_status_read_back(void) {
+    power_up();
+    CHECK(tmc2209_init(uart0, 0, 1, 0));
+
+    tmc2209_status_t status;
+    CHECK(tmc2209_get_status(&status));
+    CHECK_EQ(status.mscnt, 0x123);
+    CHECK_EQ(status.sg_result, 0x2AB);
+    CHECK_EQ(status.tstep, 0xFFFFF);
+    CHECK_EQ(status.cs_actual, 0x11);
+    CHECK(status.stealthchop);
+    CHECK(status.drv_status & TMC2209_DRV_STATUS_STST);
+
+    uint16_t sg_result;
+    CHECK(tmc2209_get_sg_result(&sg_result));
+    CHECK_EQ(sg_result, 0x2AB);
+}
+
+static void test_bad_replies_are_rejected(void) {
+    power_up();
+    CHECK(tmc2209_init(uart0, 0, 1, 0));
+
+    uint32_t value = 0xDEADBEEF;
+    chip.corrupt_next = true;
+    CHECK(!tmc2209_read_register(TMC2209_REG_MSCNT, &value));
+    CHECK_EQ(value, 0xDEADBEEF);
+
+    // A chip strapped to another address stays quiet; the read times out
+    chip.address = 1;
+    CHECK(!tmc2209_read_register(TMC2209_REG_MSCNT, &value));
+    chip.address = 0;
+
+    // And the line recovers
+    CHECK(tmc2209_read_register(TMC2209_REG_MSCNT, &value));
+    CHECK_EQ(value, 0x123);
+}
+
+int main(void) {
+    log_init();
+    log_set_level(LOG_LEVEL_NONE);
+
+    TEST_RUN(test_datagram_crc);
+    TEST_RUN(test_absent_chip);
+    TEST_RUN(test_init_configures_the_chip);
+    TEST_RUN(test_microstep_resolution);
+    TEST_RUN(test_modes_and_limits);
+    TEST_RUN(test_status_read_back);
+    TEST_RUN(test_bad_replies_are_rejected);
+    TEST_EXIT();
+}
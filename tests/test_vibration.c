@@ -0,0 +1,253 @@
+/**
+ * Host tests for the Q15 FFT (drivers/vibration/fft_q15.c) and the pump
+ * vibration monitor on top of it (drivers/vibration/vibration.c)
+ *
+ * The FFT is checked against a direct DFT in double precision. For the
+ * monitor, the IMU service and the stepper driver are replaced by a pump
+ * cruising at a set speed whose vibration (shaft harmonics plus noise) is
+ * fed in 32-sample batches, as imu_process() would.
+ */
+
+#include "test_support.h"
+#include "fft_q15.h"
+#include "vibration.h"
+#include "imu.h"
+#include "stepper_driver.h"
+#include "settings_store.h"
+#include "storage_flash.h"
+#include "logging.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BATCH IMU_FIFO_WATERMARK
+
+static fft_q15_complex_t data[FFT_Q15_MAX_SIZE];
+static double input_re[FFT_Q15_MAX_SIZE];
+static double input_im[FFT_Q15_MAX_SIZE];
+
+// Simulated pump: vibration amplitude (LSB) per shaft harmonic, plus broadband noise
+static imu_batch_cb_t batch_callback;
+static stepper_state_t pump_state = STEPPER_RUNNING;
+static uint32_t pump_hz = 8000;
+static double harmonic_amplitude[VIBRATION_HARMONICS] = { 40, 25, 60, 15, 10 };
+static double noise_amplitude = 8;
+static double sample_time;
+
+bool imu_is_running(void) {
+    return true;
+}
+
+void imu_set_batch_callback(imu_batch_cb_t callback) {
+    batch_callback = callback;
+}
+
+stepper_state_t stepper_driver_get_state(void) {
+    return pump_state;
+}
+
+uint32_t stepper_driver_get_current_frequency(void) {
+    return pump_hz;
+}
+
+// Worst error against the direct DFT (scaled by 1/n like the kernel) for one input kind
+static double fft_error(uint32_t n, int kind) {
+    for (uint32_t i = 0; i < n; i++) {
+        int32_t re = 0;
+        int32_t im = 0;
+        if (kind == 0) {
+            do {                                        // Full-scale noise within unit magnitude
+                re = rand() % 65536 - 32768;
+                im = rand() % 65536 - 32768;
+            } while (re * re + im * im > 32767 * 32767);
+        } else if (kind == 1) {
+            re = lround(30000 * cos(2 * M_PI * 7.3 * i / n) + 1000 * sin(2 * M_PI * 40 * i / n));
+        } else if (kind == 2) {
+            re = i == 3 ? 32767 : 0;                    // Impulse
+        } else {
+            re = rand() % 65536 - 32768;                // Full scale on both parts, up to magnitude 1.41
+            im = rand() % 65536 - 32768;
+        }
+        data[i] = FFT_Q15_PACK(re, im);
+        input_re[i] = re;
+        input_im[i] = im;
+    }
+    CHECK(fft_q15_forward(data, n));
+
+    double worst = 0;
+    for (uint32_t k = 0; k < n; k++) {
+        double re = 0;
+        double im = 0;
+        for (uint32_t t = 0; t < n; t++) {
+            double angle = -2 * M_PI * (double)((uint64_t)k * t % n) / n;
+            re += input_re[t] * cos(angle) - input_im[t] * sin(angle);
+            im += input_re[t] * sin(angle) + input_im[t] * cos(angle);
+        }
+        double error_re = fabs(FFT_Q15_RE(data[k]) - re / n);
+        double error_im = fabs(FFT_Q15_IM(data[k]) - im / n);
+        worst = error_re > worst ? error_re : worst;
+        worst = error_im > worst ? error_im : worst;
+    }
+    return worst;
+}
+
+static void test_fft_matches_dft(void) {
+    srand(5);
+    for (uint32_t n = 16; n <= FFT_Q15_MAX_SIZE; n *= 4) {
+        double worst = 0;
+        for (int kind = 0; kind < 3; kind++) {
+            for (int rep = 0; rep < (n <= 256 ? 10 : 2); rep++) {
+                double error = fft_error(n, kind);
+                worst = error > worst ? error : worst;
+            }
+        }
+        // Past unit magnitude a twiddle product can clip, but must not wrap (thousands of LSB off)
+        double beyond = 0;
+        for (int rep = 0; rep < 10; rep++) {
+            double error = fft_error(n, 3);
+            beyond = error > beyond ? error : beyond;
+        }
+        printf("  n=%u max error %.2f LSB, %.2f LSB beyond unit magnitude\n", n, worst, beyond);
+        CHECK(worst <= 4.0);
+        CHECK(beyond <= 256.0);
+    }
+
+    // Sizes the radix-4 kernel cannot do
+    CHECK(!fft_q15_forward(data, 32));
+    CHECK(!fft_q15_forward(data, 4096));
+
+    CHECK_EQ(fft_q15_hann(0, 1024), 0);
+    CHECK_EQ(fft_q15_hann(512, 1024), 32767);
+    CHECK(abs(fft_q15_hann(256, 1024) - 16384) <= 1);
+    CHECK_EQ(fft_q15_power(FFT_Q15_PACK(-300, 400)), 250000);
+}
+
+// The pump cruises: settle, then a window and a bit of samples; the monitor analyses it
+static bool run_capture(vibration_result_t *result) {
+    qmi8658_sample_t samples[BATCH];
+    double shaft_hz = (double)pump_hz / STEPPER_STEPS_PER_REV;
+    memset(samples, 0, sizeof(samples));
+
+    vibration_process();
+    stub_time_us += (VIBRATION_SETTLE_MS + 100) * 1000ull;
+    vibration_process();
+    vibration_process();
+    for (uint32_t batch = 0; batch < VIBRATION_FFT_SIZE / BATCH + 8; batch++) {
+        for (uint32_t i = 0; i < BATCH; i++) {
+            double v = 0;
+            for (uint32_t h = 1; h <= VIBRATION_HARMONICS; h++) {
+                v += harmonic_amplitude[h - 1] * sin(2 * M_PI * h * shaft_hz * sample_time + h);
+            }
+            v += noise_amplitude * 1.732 * (2.0 * rand() / RAND_MAX - 1);
+            sample_time += 1.0 / IMU_ODR_HZ;
+            // Mostly along gravity, the board lying nearly flat
+            samples[i].acc[0] = (int16_t)lrint(300 + v * 0.1);
+            samples[i].acc[1] = -200;
+            samples[i].acc[2] = (int16_t)lrint(IMU_ACC_LSB_PER_G + v);
+        }
+        batch_callback(samples, BATCH);
+        stub_time_us += 1000000ull * BATCH / IMU_ODR_HZ;
+        vibration_process();
+    }
+
+    // Run over; the next one starts a fresh capture
+    pump_state = STEPPER_IDLE;
+    vibration_process();
+    pump_state = STEPPER_RUNNING;
+    return vibration_get_result(result);
+}
+
+static void print_levels(const char *label, const vibration_result_t *result) {
+    printf("  %-12s", label);
+    for (uint32_t b = 0; b < VIBRATION_BANDS; b++) {
+        printf(" %+5.1f", result->delta_db10[b] / 10.0);
+    }
+    printf(" dB%s\n", result->alarm ? "  alarm" : "");
+}
+
+static void test_monitor_against_baseline(void) {
+    storage_flash_init();
+    settings_init();
+    vibration_init();
+    srand(1);
+
+    // First capture becomes the baseline, and is stored
+    vibration_result_t result;
+    CHECK(!vibration_get_result(&result));
+    vibration_learn_baseline();
+    CHECK(run_capture(&result));
+    CHECK_EQ(result.step_hz, pump_hz);
+    CHECK_EQ(result.shaft_mhz, pump_hz * 1000 / STEPPER_STEPS_PER_REV);
+    for (uint32_t b = 0; b < VIBRATION_BANDS; b++) {
+        CHECK(result.level_db10[b] != VIBRATION_LEVEL_NONE);
+    }
+    // Harmonic 3 is the strongest line, all lines stand above the noise floor's bins
+    CHECK(result.level_db10[2] > result.level_db10[0]);
+    CHECK(result.level_db10[0] > result.level_db10[4]);
+
+    // Same pump again: within a dB or two everywhere
+    CHECK(run_capture(&result));
+    print_levels("same pump", &result);
+    CHECK(result.compared);
+    CHECK(!result.alarm);
+    for (uint32_t b = 0; b < VIBRATION_BANDS; b++) {
+        CHECK(abs(result.delta_db10[b]) <= 20);
+    }
+
+    // Worn roller: harmonic 3 up 2.5x (+8 dB), the rest unchanged
+    harmonic_amplitude[2] *= 2.5;
+    CHECK(run_capture(&result));
+    harmonic_amplitude[2] /= 2.5;
+    print_levels("harmonic 3", &result);
+    CHECK(result.alarm);
+    CHECK(abs(result.delta_db10[2] - 80) <= 15);
+    CHECK(abs(result.delta_db10[0]) <= 20);
+
+    // Running rough: broadband noise 3x (+9.5 dB)
+    noise_amplitude *= 3;
+    CHECK(run_capture(&result));
+    noise_amplitude /= 3;
+    print_levels("broadband", &result);
+    CHECK(result.alarm);
+    CHECK(result.delta_db10[VIBRATION_HARMONICS] > VIBRATION_ALARM_DB10);
+
+    // The baseline survives a restart through the settings store
+    vibration_init();
+    CHECK(run_capture(&result));
+    CHECK(result.compared);
+    CHECK(!result.alarm);
+}
+
+static void test_other_speed_is_not_compared(void) {
+    vibration_result_t result;
+    pump_hz = 9000;
+    CHECK(run_capture(&result));
+    CHECK_EQ(result.step_hz, 9000);
+    CHECK(!result.compared);
+    CHECK(!result.alarm);
+    for (uint32_t b = 0; b < VIBRATION_BANDS; b++) {
+        CHECK_EQ(result.delta_db10[b], 0);
+    }
+
+    // A speed change during the capture drops it: the result stays the last complete one
+    vibration_process();
+    stub_time_us += (VIBRATION_SETTLE_MS + 100) * 1000ull;
+    vibration_process();
+    vibration_process();
+    pump_hz = 8000;
+    vibration_process();
+    vibration_result_t after;
+    CHECK(vibration_get_result(&after));
+    CHECK_EQ(after.step_hz, 9000);
+}
+
+int main(void) {
+    log_init();
+    log_set_level(LOG_LEVEL_NONE);
+    fft_q15_init();
+
+    TEST_RUN(test_fft_matches_dft);
+    TEST_RUN(test_monitor_against_baseline);
+    TEST_RUN(test_other_speed_is_not_compared);
+    TEST_EXIT();
+}
@@ -0,0 +1,321 @@
+/**
+ * Host tests for the zone valve manager (drivers/zone_manager/zone_manager.c)
+ *
+ * The real MCP23017 driver talks to a model of the I2C bus: up to eight
+ * expanders with their direction and latch registers and sequential
+ * register addressing, and counters for the bytes, transactions and bit
+ * times on the wire. The firmware's largest layout is mapped (B0-B3 of the
+ * built-in expander, whose other pins drive the pump enable and status LED,
+ * plus seven 16-valve manifolds: 116 zones) and switched in order and at
+ * random. After every switch exactly the open zone's valve is on and the
+ * shared outputs are as they were; during a switch the valves never all
+ * close and at most two are open.
+ */
+
+#include "test_support.h"
+#include "zone_manager.h"
+#include "bsp_i2c.h"
+#include "logging.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define BUILTIN_ADDR 0x27
+#define MANIFOLD_ADDR 0x20
+#define MANIFOLDS 7
+#define ZONES (4 + 16 * MANIFOLDS)
+#define SHARED_A 0xA5               // Built-in expander outputs that are not valves: port A ...
+#define SHARED_B 0x50               // ... and B4-B7
+#define BUS_HZ 400000
+
+#define REG_IODIRA 0x00
+#define REG_OLATA 0x14
+#define REG_COUNT 0x16
+
+typedef struct {
+    bool present;
+    uint8_t regs[REG_COUNT];
+    uint8_t pointer;                // Register the next byte goes to or comes from
+} model_chip_t;
+
+static model_chip_t chips[8];
+
+static uint32_t bus_bytes;          // Address bytes included
+static uint32_t bus_transactions;   // Each ends with a stop
+static uint32_t bus_bits;           // Bit times, ACKs and start/stop conditions included
+static uint32_t lock_depth;
+static uint32_t unlocked_transfers;
+static uint32_t open_min;           // Fewest and most open valves after any latch write since cleared
+static uint32_t open_max;
+
+// The BSP's bus lock: only counted, every transfer must happen inside it
+void bsp_i2c_lock(void) {
+    lock_depth++;
+}
+
+void bsp_i2c_unlock(void) {
+    lock_depth--;
+}
+
+static uint16_t reg16(uint8_t addr, uint8_t reg) {
+    const uint8_t *regs = chips[addr - 0x20].regs;
+    return (uint16_t)(regs[reg] | (regs[reg + 1] << 8));
+}
+
+static uint16_t valve_pins(uint8_t addr) {
+    return addr == BUILTIN_ADDR ? 0x0F00 : 0xFFFF;
+}
+
+// Valve outputs driven high across the bus
+static uint32_t open_valves(void) {
+    uint32_t count = 0;
+    for (uint8_t addr = 0x20; addr < 0x28; addr++) {
+        if (chips[addr - 0x20].present) {
+            uint16_t outputs = (uint16_t)~reg16(addr, REG_IODIRA);
+            count += (uint32_t)__builtin_popcount(reg16(addr, REG_OLATA) & outputs & valve_pins(addr));
+        }
+    }
+    return count;
+}
+
+// One call on the wire: (repeated) start, address and data bytes with their ACKs, a stop unless 'nostop'
+static bool bus_transfer(uint8_t addr, size_t len, bool nostop) {
+    unlocked_transfers += lock_depth == 0;
+    bool present = addr >= 0x20 && addr < 0x28 && chips[addr - 0x20].present;
+    size_t bytes = present ? 1 + len : 1;
+    bus_bytes += (uint32_t)bytes;
+    bus_bits += 1 + 9 * (uint32_t)bytes;
+    if (!nostop || !present) {
+        bus_bits++;
+        bus_transactions++;
+    }
+    return present;
+}
+
+int i2c_write_timeout_us(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop,
+                         unsigned int timeout_us) {
+    (void)i2c;
+    (void)timeout_us;
+    if (!bus_transfer(addr, len, nostop)) {
+        return PICO_ERROR_GENERIC;
+    }
+    model_chip_t *chip = &chips[addr - 0x20];
+    chip->pointer = src[0];
+    for (size_t i = 1; i < len; i++, chip->pointer++) {
+        if (chip->pointer < REG_COUNT) {
+            chip->regs[chip->pointer] = src[i];
+        }
+    }
+    if (len > 1) {
+        uint32_t open = open_valves();
+        open_min = open < open_min ? open : open_min;
+        open_max = open > open_max ? open : open_max;
+    }
+    return (int)len;
+}
+
+int i2c_read_timeout_us(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop,
+                        unsigned int timeout_us) {
+    (void)i2c;
+    (void)timeout_us;
+    if (!bus_transfer(addr, len, nostop)) {
+        return PICO_ERROR_GENERIC;
+    }
+    model_chip_t *chip = &chips[addr - 0x20];
+    for (size_t i = 0; i < len; i++, chip->pointer++) {
+        dst[i] = chip->pointer < REG_COUNT ? chip->regs[chip->pointer] : 0;
+    }
+    return (int)len;
+}
+
+static void clear_bus_counts(void) {
+    bus_bytes = 0;
+    bus_transactions = 0;
+    bus_bits = 0;
+}
+
+static uint32_t bus_time_us(uint32_t bits) {
+    return (uint32_t)((uint64_t)bits * 1000000 / BUS_HZ);
+}
+
+// Expanders as at power-up, the built-in one already driving its other outputs; then the firmware's mapping
+static void make_layout(void) {
+    memset(chips, 0, sizeof(chips));
+    for (uint8_t addr = MANIFOLD_ADDR; addr < MANIFOLD_ADDR + MANIFOLDS; addr++) {
+        chips[addr - 0x20].present = true;
+        chips[addr - 0x20].regs[REG_IODIRA] = 0xFF;
+        chips[addr - 0x20].regs[REG_IODIRA + 1] = 0xFF;
+    }
+    chips[BUILTIN_ADDR - 0x20].present = true;
+    chips[BUILTIN_ADDR - 0x20].regs[REG_IODIRA] = 0x00;
+    chips[BUILTIN_ADDR - 0x20].regs[REG_IODIRA + 1] = 0x0F;
+    chips[BUILTIN_ADDR - 0x20].regs[REG_OLATA] = SHARED_A;
+    chips[BUILTIN_ADDR - 0x20].regs[REG_OLATA + 1] = SHARED_B;
+
+    zone_manager_init();
+    CHECK(zone_manager_add_valves(0, BUILTIN_ADDR, 8, 4));
+    for (uint8_t i = 0; i < MANIFOLDS; i++) {
+        CHECK(zone_manager_add_valves(4 + 16 * i, MANIFOLD_ADDR + i, 0, 16));
+    }
+    clear_bus_counts();
+}
+
+static bool shared_outputs_kept(void) {
+    uint16_t latches = reg16(BUILTIN_ADDR, REG_OLATA);
+    return reg16(BUILTIN_ADDR, REG_IODIRA) == 0x0000 && (latches & 0xF0FF) == (SHARED_A | (SHARED_B << 8));
+}
+
+// Exactly 'zone' open (or none), by the latches on the bus
+static bool only_open(uint8_t zone) {
+    if (zone == ZONE_MANAGER_NONE) {
+        return open_valves() == 0;
+    }
+    uint8_t addr = zone < 4 ? BUILTIN_ADDR : (uint8_t)(MANIFOLD_ADDR + (zone - 4) / 16);
+    uint8_t pin = zone < 4 ? (uint8_t)(8 + zone) : (uint8_t)((zone - 4) % 16);
+    return open_valves() == 1 && (reg16(addr, REG_OLATA) & (1u << pin)) != 0;
+}
+
+static void test_mapping_keeps_shared_outputs(void) {
+    make_layout();
+    CHECK_EQ(zone_manager_get_zone_count(), ZONES);
+    CHECK(only_open(ZONE_MANAGER_NONE));
+    CHECK(shared_outputs_kept());
+    CHECK_EQ(reg16(BUILTIN_ADDR, REG_IODIRA), 0x0000);     // B0-B3 now outputs, B4-B7 as they were
+    for (uint8_t i = 0; i < MANIFOLDS; i++) {
+        CHECK_EQ(reg16(MANIFOLD_ADDR + i, REG_IODIRA), 0x0000);
+    }
+    CHECK(!zone_manager_add_valves(10, MANIFOLD_ADDR + MANIFOLDS, 0, 4));     // Zones taken
+    CHECK(!zone_manager_add_valves(ZONES, BUILTIN_ADDR, 10, 2));             // Pins taken
+    CHECK_EQ(unlocked_transfers, 0);
+}
+
+static void test_walk_costs(void) {
+    // Every zone in order, then all closed; each switch type has a fixed cost on the wire
+    make_layout();
+    uint32_t wrong_cost = 0;
+    uint32_t wrong_valves = 0;
+    uint32_t max_bits = 0;
+    for (uint32_t zone = 0; zone < ZONES; zone++) {
+        uint32_t transactions = bus_transactions;
+        uint32_t bytes = bus_bytes;
+        uint32_t bits = bus_bits;
+        open_min = UINT32_MAX;
+        open_max = 0;
+        CHECK(zone_manager_open((uint8_t)zone));
+        transactions = bus_transactions - transactions;
+        bytes = bus_bytes - bytes;
+        bits = bus_bits - bits;
+        max_bits = bits > max_bits ? bits : max_bits;
+
+        // Built-in: latch read and write of port B. Manifold: one port write, both ports in one at B0.
+        // Onto another expander: the new valve, then the old expander's port
+        uint32_t want_transactions = 1;
+        uint32_t want_bytes = 3;
+        if (zone < 4) {
+            want_transactions = 2;
+            want_bytes = 4 + 3;
+        } else if (zone == 4) {
+            want_transactions = 1 + 2;
+            want_bytes = 3 + 4 + 3;
+        } else if ((zone - 4) % 16 == 0) {
+            want_transactions = 2;
+            want_bytes = 3 + 3;
+        } else if ((zone - 4) % 16 == 8) {
+            want_bytes = 4;
+        }
+        wrong_cost += transactions != want_transactions || bytes != want_bytes;
+        wrong_valves += !only_open((uint8_t)zone) || !shared_outputs_kept() ||
+                        (zone > 0 && open_min == 0) || open_max > 2;
+    }
+    CHECK(zone_manager_close_all());
+    CHECK(only_open(ZONE_MANAGER_NONE));
+    CHECK(shared_outputs_kept());
+
+    // Built-in 2 + 3 x 2, onto the first manifold 3, 15 switches within each, 6 manifold changes, closing 1
+    uint32_t total_transactions = 2 + 3 * 2 + 3 + MANIFOLDS * 15 + (MANIFOLDS - 1) * 2 + 1;
+    uint32_t total_bytes = 7 + 3 * 7 + 10 + MANIFOLDS * (14 * 3 + 4) + (MANIFOLDS - 1) * 6 + 3;
+    zone_manager_stats_t stats;
+    zone_manager_get_stats(&stats);
+    printf("  %u zones in order: %lu transactions, %lu bytes, %lu us of bus time at 400 kHz (at most %lu us a switch)\n",
+           ZONES, (unsigned long)bus_transactions, (unsigned long)bus_bytes,
+           (unsigned long)bus_time_us(bus_bits), (unsigned long)bus_time_us(max_bits));
+    CHECK_EQ(wrong_cost, 0);
+    CHECK_EQ(wrong_valves, 0);
+    CHECK_EQ(bus_transactions, total_transactions);
+    CHECK_EQ(bus_bytes, total_bytes);
+    CHECK_EQ(stats.transactions, bus_transactions);
+    CHECK_EQ(stats.transitions, ZONES + 1);
+    CHECK_EQ(stats.errors, 0);
+    CHECK(bus_time_us(max_bits) < 250);      // About two steps at full pump speed
+    CHECK_EQ(unlocked_transfers, 0);
+}
+
+static void test_random_switching(void) {
+    make_layout();
+    srand(116);
+    const uint32_t switches = 200000;
+    uint32_t wrong = 0;
+    uint32_t max_bits = 0;
+    uint64_t host_us = 0;
+    for (uint32_t i = 0; i < switches; i++) {
+        uint8_t before = zone_manager_get_open();
+        uint8_t zone = rand() % 10 == 0 ? ZONE_MANAGER_NONE : (uint8_t)(rand() % ZONES);
+        uint32_t bits = bus_bits;
+        open_min = UINT32_MAX;
+        open_max = 0;
+
+        stub_time_from_host = true;
+        uint64_t start_us = time_us_64();
+        bool ok = zone == ZONE_MANAGER_NONE ? zone_manager_close_all() : zone_manager_open(zone);
+        host_us += time_us_64() - start_us;
+        stub_time_from_host = false;
+
+        bits = bus_bits - bits;
+        max_bits = bits > max_bits ? bits : max_bits;
+        bool kept_one = zone == ZONE_MANAGER_NONE || before == ZONE_MANAGER_NONE || open_min >= 1;
+        wrong += !ok || zone_manager_get_open() != zone || !only_open(zone) || !shared_outputs_kept() ||
+                 !kept_one || open_max > 2 || lock_depth != 0;
+    }
+
+    zone_manager_stats_t stats;
+    zone_manager_get_stats(&stats);
+    printf("  %lu random switches: %.2f transactions and %.1f bytes each, at most %lu us of bus time;"
+           " %.2f us host time each\n",
+           (unsigned long)switches, (double)bus_transactions / switches, (double)bus_bytes / switches,
+           (unsigned long)bus_time_us(max_bits), (double)host_us / switches);
+    CHECK_EQ(wrong, 0);
+    CHECK_EQ(stats.transactions, bus_transactions);
+    CHECK(bus_time_us(max_bits) < 250);
+    CHECK_EQ(unlocked_transfers, 0);
+}
+
+static void test_missing_expander(void) {
+    make_layout();
+    CHECK(zone_manager_open(30));
+
+    // The third manifold stops answering: its zones fail, and nothing is left open
+    chips[MANIFOLD_ADDR + 2 - 0x20].present = false;
+    CHECK(!zone_manager_open(40));
+    CHECK_EQ(zone_manager_get_open(), ZONE_MANAGER_NONE);
+    CHECK(only_open(ZONE_MANAGER_NONE));
+    zone_manager_stats_t stats;
+    zone_manager_get_stats(&stats);
+    CHECK_EQ(stats.errors, 1);
+
+    // Zones elsewhere still switch
+    CHECK(zone_manager_open(2));
+    CHECK(only_open(2));
+    CHECK(shared_outputs_kept());
+    CHECK(!zone_manager_open(ZONES));           // No valve
+    CHECK_EQ(unlocked_transfers, 0);
+}
+
+int main(void) {
+    log_init();
+    log_set_level(LOG_LEVEL_NONE);
+
+    TEST_RUN(test_mapping_keeps_shared_outputs);
+    TEST_RUN(test_walk_costs);
+    TEST_RUN(test_random_switching);
+    TEST_RUN(test_missing_expander);
+    TEST_EXIT();
+}
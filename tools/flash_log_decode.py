@@ -0,0 +1,107 @@
+#!/usr/bin/env python3
+"""
+PicoFlora persistent flash log decoder
+
+Decodes the log store (drivers/storage/flash_log.c) from a raw flash image,
+for boards that can no longer run the 'f' USB stream command. Pages are
+validated with the same CRC as the firmware, so pages torn by a power loss
+are reported and skipped.
+
+Read the region with picotool while the board is in BOOTSEL mode:
+    picotool save -r 0x103BC000 0x103FC000 flash_log.bin
+    flash_log_decode.py flash_log.bin
+
+A full 4 MB flash dump is also accepted (the region sits just below the
+settings store at the top).
+
+Records written while the binary log backend was active hold the format
+string address instead of text; pass the matching firmware ELF to decode them:
+    flash_log_decode.py flash_log.bin build/PicoFlora.elf
+"""
+
+import struct
+import sys
+import zlib
+
+from log_decode import ElfImage, decode_flash_message
+
+SECTOR_SIZE = 4096
+PAGE_SIZE = 256
+LOG_SECTORS = 64
+SETTINGS_SECTORS = 4
+REGION_SIZE = LOG_SECTORS * SECTOR_SIZE
+FLASH_SIZE = 4 * 1024 * 1024
+
+PAGE_MAGIC = 0x474C4650
+PAGE_HEADER = struct.Struct("<IIHHI")
+RECORD_HEADER = struct.Struct("<IBBB")
+LEVEL_BINARY = 0x80
+LEVEL_MASK = 0x0F
+
+LEVELS = ["DEBUG", "INFO ", "WARN ", "ERROR", "FATAL"]
+CATEGORIES = ["SYS", "HW ", "STEP", "UI ", "PWR", "RTC"]
+
+
+def parse_page(page):
+    """Return (seq, boot_id, records) for a valid page, None if erased, False if torn."""
+    if page == b"\xff" * PAGE_SIZE:
+        return None
+    magic, seq, boot_id, length, crc = PAGE_HEADER.unpack_from(page)
+    payload = page[PAGE_HEADER.size:PAGE_HEADER.size + length]
+    if (magic != PAGE_MAGIC or seq == 0 or length > PAGE_SIZE - PAGE_HEADER.size or
+            zlib.crc32(page[4:12] + payload) != crc):
+        return False
+
+    records = []
+    pos = 0
+    while pos + RECORD_HEADER.size <= len(payload):
+        timestamp_ms, level, category, text_len = RECORD_HEADER.unpack_from(payload, pos)
+        pos += RECORD_HEADER.size
+        if pos + text_len > len(payload):
+            break
+        records.append((timestamp_ms, level, category, payload[pos:pos + text_len]))
+        pos += text_len
+    return seq, boot_id, records
+
+
+def main():
+    if len(sys.argv) < 2:
+        sys.exit(__doc__)
+    with open(sys.argv[1], "rb") as f:
+        image = f.read()
+    elf = ElfImage(sys.argv[2]) if len(sys.argv) > 2 else None
+    if len(image) == FLASH_SIZE:
+        end = FLASH_SIZE - SETTINGS_SECTORS * SECTOR_SIZE
+        image = image[end - REGION_SIZE:end]
+
+    pages, torn = [], 0
+    for offset in range(0, len(image) - PAGE_SIZE + 1, PAGE_SIZE):
+        result = parse_page(image[offset:offset + PAGE_SIZE])
+        if result is False:
+            torn += 1
+        elif result is not None:
+            pages.append(result)
+
+    pages.sort(key=lambda p: p[0])
+    count = 0
+    for seq, boot_id, records in pages:
+        for timestamp_ms, level, category, text in records:
+            if level & LEVEL_BINARY:
+                try:
+                    text = decode_flash_message(elf, text)
+                except struct.error as e:
+                    text = "<corrupt record: %s>" % e
+            else:
+                text = text.decode(errors="replace")
+            level &= LEVEL_MASK
+            level_str = LEVELS[level] if level < len(LEVELS) else "?????"
+            cat_str = CATEGORIES[category] if category < len(CATEGORIES) else "???"
+            print("boot=%u [%7d.%03d] [%s] [%s] %s" % (
+                boot_id, timestamp_ms // 1000, timestamp_ms % 1000, level_str, cat_str, text))
+            count += 1
+
+    print("# %d records in %d pages, %d torn pages skipped" % (count, len(pages), torn), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
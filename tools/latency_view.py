@@ -0,0 +1,100 @@
+#!/usr/bin/env python3
+"""
+PicoFlora latency histogram viewer
+
+Reads the "LAT ..." lines produced by latency_probe_dump() and prints one
+histogram per pipeline stage. Input is either a serial port (the device is
+asked for a dump by sending 'l') or a captured log file / stdin.
+
+Usage:
+    latency_view.py /dev/ttyACM0       # query a connected board (needs pyserial)
+    latency_view.py capture.log        # parse a saved USB log
+    cat capture.log | latency_view.py  # parse stdin
+"""
+
+import sys
+
+BAR_WIDTH = 40
+
+
+def parse_stage(line):
+    fields = dict(kv.split("=", 1) for kv in line.split()[1:] if "=" in kv)
+    return {
+        "stage": fields["stage"],
+        "count": int(fields["count"]),
+        "mean_us": int(fields["mean_us"]),
+        "max_us": int(fields["max_us"]),
+        "hist": [int(v) for v in fields["hist"].split(",")],
+    }
+
+
+def read_dump(lines):
+    """Return the stages of the last complete dump found in lines."""
+    stages, current, header = None, None, ""
+    for raw in lines:
+        line = raw.strip()
+        if line.startswith("LAT begin"):
+            current, header = [], line
+        elif line.startswith("LAT stage=") and current is not None:
+            current.append(parse_stage(line))
+        elif line.startswith("LAT end") and current is not None:
+            stages, current = current, None
+    return header, stages
+
+
+def bucket_label(index, last):
+    low = 1 << index if index else 0
+    if index == last:
+        return f">= {low} us"
+    return f"{low}-{(1 << (index + 1)) - 1} us"
+
+
+def print_stage(stage):
+    print(f"\n{stage['stage']}: n={stage['count']} mean={stage['mean_us']} us max={stage['max_us']} us")
+    hist = stage["hist"]
+    peak = max(hist) or 1
+    last = len(hist) - 1
+    for i, count in enumerate(hist):
+        if count == 0:
+            continue
+        bar = "#" * max(1, count * BAR_WIDTH // peak)
+        print(f"  {bucket_label(i, last):>18} | {bar} {count}")
+
+
+def read_serial(port):
+    import serial  # pyserial
+
+    with serial.Serial(port, 115200, timeout=1) as dev:
+        dev.reset_input_buffer()
+        dev.write(b"l")
+        lines = []
+        while True:
+            line = dev.readline().decode(errors="replace")
+            if not line:
+                break
+            lines.append(line)
+            if line.startswith("LAT end"):
+                break
+        return lines
+
+
+def main():
+    if len(sys.argv) > 1 and sys.argv[1].startswith("/dev/"):
+        lines = read_serial(sys.argv[1])
+    elif len(sys.argv) > 1:
+        with open(sys.argv[1], errors="replace") as f:
+            lines = f.readlines()
+    else:
+        lines = sys.stdin.readlines()
+
+    header, stages = read_dump(lines)
+    if not stages:
+        sys.exit("no complete LAT dump found")
+
+    print(header)
+    for stage in stages:
+        print_stage(stage)
+
+
+if __name__ == "__main__":
+    main()
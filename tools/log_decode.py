@@ -0,0 +1,189 @@
+#!/usr/bin/env python3
+"""
+PicoFlora binary log decoder
+
+Rebuilds log text from the '~<hex>' records produced by the binary logging
+backend (drivers/logging/log_binary.c). Format strings are looked up by
+address in the firmware ELF, so the ELF must match the running image.
+Lines that are not binary records are passed through unchanged, except the
+"FLOG ... ~<hex>" lines of the flash log stream ('f' command), whose binary
+message part is decoded in place.
+
+Usage:
+    log_decode.py build/PicoFlora.elf /dev/ttyACM0   # live (needs pyserial)
+    log_decode.py build/PicoFlora.elf capture.log
+    cat capture.log | log_decode.py build/PicoFlora.elf
+"""
+
+import re
+import struct
+import sys
+
+LEVELS = ["DEBUG", "INFO ", "WARN ", "ERROR", "FATAL", "NONE "]
+CATEGORIES = ["SYS", "HW ", "STEP", "UI ", "PWR", "RTC"]
+FLAG_TRUNCATED = 0x01
+HEADER = struct.Struct("<IIBBBB")
+FLASH_HEADER = struct.Struct("<IB")     # Binary flash log records: fmt flags args...
+
+CONVERSION = re.compile(
+    r"%(?P<flags>[-+ #0]*)(?P<width>\*|\d+)?(?:\.(?P<prec>\*|\d+))?"
+    r"(?P<length>hh|h|ll|l|j|z|t|L)?(?P<conv>[diuxXocpfFeEgGaAs%])"
+)
+
+
+class ElfImage:
+    """Minimal ELF32 reader: maps allocated section addresses to file bytes."""
+
+    def __init__(self, path):
+        with open(path, "rb") as f:
+            self.data = f.read()
+        if self.data[:4] != b"\x7fELF" or self.data[4] != 1:
+            raise ValueError(f"{path}: not an ELF32 file")
+        shoff, = struct.unpack_from("<I", self.data, 0x20)
+        shentsize, shnum = struct.unpack_from("<HH", self.data, 0x2E)
+        self.sections = []
+        for i in range(shnum):
+            (_, sh_type, sh_flags, sh_addr, sh_offset, sh_size) = struct.unpack_from(
+                "<IIIIII", self.data, shoff + i * shentsize)
+            alloc = sh_flags & 0x2
+            progbits = sh_type == 1
+            if alloc and progbits and sh_size:
+                self.sections.append((sh_addr, sh_size, sh_offset))
+        self.cache = {}
+
+    def string_at(self, addr):
+        if addr in self.cache:
+            return self.cache[addr]
+        for base, size, offset in self.sections:
+            if base <= addr < base + size:
+                start = offset + (addr - base)
+                end = self.data.index(b"\0", start)
+                text = self.data[start:end].decode(errors="replace")
+                self.cache[addr] = text
+                return text
+        return None
+
+
+def render(fmt, words, truncated):
+    """Apply a C format string to the raw argument words."""
+    out = []
+    pos = 0
+    idx = 0
+
+    def take():
+        nonlocal idx
+        if idx >= len(words):
+            raise IndexError
+        idx += 1
+        return words[idx - 1]
+
+    for m in CONVERSION.finditer(fmt):
+        out.append(fmt[pos:m.start()])
+        pos = m.end()
+        conv = m.group("conv")
+        if conv == "%":
+            out.append("%")
+            continue
+        try:
+            width = m.group("width")
+            prec = m.group("prec")
+            if width == "*":
+                width = str(struct.unpack("<i", struct.pack("<I", take()))[0])
+            if prec == "*":
+                prec = str(struct.unpack("<i", struct.pack("<I", take()))[0])
+            spec = "%" + m.group("flags") + (width or "") + ("." + prec if prec is not None else "")
+            wide = m.group("length") in ("ll", "j")
+
+            if conv in "diuxXoc":
+                value = take()
+                if wide:
+                    value |= take() << 32
+                if conv in "di":
+                    bits = 64 if wide else 32
+                    if value & (1 << (bits - 1)):
+                        value -= 1 << bits
+                    conv = "d"
+                elif conv == "u":
+                    conv = "d"
+                out.append((spec + conv) % value)
+            elif conv == "p":
+                out.append("0x%08x" % take())
+            elif conv in "fFeEgGaA":
+                lo = take()
+                hi = take()
+                value = struct.unpack("<d", struct.pack("<II", lo, hi))[0]
+                out.append((spec + ("f" if conv in "aA" else conv)) % value)
+            elif conv == "s":
+                length = take()
+                nwords = (length + 3) // 4
+                raw = b"".join(struct.pack("<I", take()) for _ in range(nwords))
+                out.append((spec + "s") % raw[:length].decode(errors="replace"))
+        except IndexError:
+            out.append("<?>" if truncated else "<missing>")
+    out.append(fmt[pos:])
+    return "".join(out)
+
+
+def decode_line(elf, line):
+    payload = bytes.fromhex(line[1:].strip())
+    fmt_addr, timestamp_us, level, category, nwords, flags = HEADER.unpack_from(payload)
+    words = list(struct.unpack_from("<%dI" % nwords, payload, HEADER.size))
+    fmt = elf.string_at(fmt_addr)
+    if fmt is None:
+        message = "<unknown format 0x%08x> %s" % (fmt_addr, " ".join("%08x" % w for w in words))
+    else:
+        message = render(fmt, words, flags & FLAG_TRUNCATED)
+    timestamp_ms = timestamp_us // 1000
+    level_str = LEVELS[level] if level < len(LEVELS) else "?????"
+    cat_str = CATEGORIES[category] if category < len(CATEGORIES) else "???"
+    return "[%7d.%03d] [%s] [%s] %s" % (timestamp_ms // 1000, timestamp_ms % 1000, level_str, cat_str, message)
+
+
+def decode_flash_message(elf, payload):
+    """Message text of a binary flash log record (fmt:u32 flags:u8 args:u32[])."""
+    fmt_addr, flags = FLASH_HEADER.unpack_from(payload)
+    nwords = (len(payload) - FLASH_HEADER.size) // 4
+    words = list(struct.unpack_from("<%dI" % nwords, payload, FLASH_HEADER.size))
+    fmt = elf.string_at(fmt_addr) if elf else None
+    if fmt is None:
+        return "<unknown format 0x%08x> %s" % (fmt_addr, " ".join("%08x" % w for w in words))
+    return render(fmt, words, flags & FLAG_TRUNCATED)
+
+
+def lines_from(source):
+    if source.startswith("/dev/"):
+        import serial  # pyserial
+
+        with serial.Serial(source, 115200, timeout=None) as dev:
+            while True:
+                yield dev.readline().decode(errors="replace")
+    elif source == "-":
+        yield from sys.stdin
+    else:
+        with open(source, errors="replace") as f:
+            yield from f
+
+
+def main():
+    if len(sys.argv) < 2:
+        sys.exit(__doc__)
+    elf = ElfImage(sys.argv[1])
+    source = sys.argv[2] if len(sys.argv) > 2 else "-"
+    for line in lines_from(source):
+        if line.startswith("~"):
+            try:
+                print(decode_line(elf, line))
+            except (ValueError, struct.error) as e:
+                print("<corrupt record: %s> %s" % (e, line.rstrip()))
+        elif line.startswith("FLOG ") and "] ~" in line:
+            prefix, _, record = line.rstrip().partition("] ~")
+            try:
+                print(prefix + "] " + decode_flash_message(elf, bytes.fromhex(record)))
+            except (ValueError, struct.error) as e:
+                print("<corrupt record: %s> %s" % (e, line.rstrip()))
+        else:
+            print(line, end="")
+
+
+if __name__ == "__main__":
+    main()